@@ -22,8 +22,19 @@ namespace fds {
 static constexpr fds_uint32_t Ki { 1024 };
 static constexpr fds_uint32_t Mi { 1024 * Ki };
 
+/// Object cache size for all volumes together, config is in terms of MiB
+static size_t
+objectCacheMaxData() {
+    FdsConfigAccessor conf(g_fdsprocess->get_fds_config(), "fds.am.");
+    return size_t(Mi) * conf.get<fds_uint32_t>("cache.max_data", 2048);
+}
+
+/// Object cache shards, each with its own lock so gets of different objects don't contend
+static constexpr size_t object_cache_shards { 16 };
+
 AmCache::AmCache(AmDataProvider* prev)
     : AmDataProvider(prev, new AmDispatcher(this)),
+      object_cache(objectCacheMaxData(), object_cache_shards),
       max_metadata_entries(0)
 {
     /**
@@ -36,7 +47,7 @@ AmCache::AmCache(AmDataProvider* prev)
     FdsConfigAccessor conf(g_fdsprocess->get_fds_config(), "fds.am.");
     max_metadata_entries = std::min((uint64_t)LLONG_MAX, (uint64_t)conf.get<int64_t>("cache.max_metadata_entries"));
     // This is in terms of MiB
-    max_volume_data = Mi * conf.get<fds_uint32_t>("cache.max_volume_data");
+    max_volume_data = size_t(Mi) * conf.get<fds_uint32_t>("cache.max_volume_data");
 }
 
 AmCache::~AmCache() = default;
@@ -217,7 +228,7 @@ AmCache::getObjectCb(AmRequest* amReq, Error const error) {
     for (auto objReq : *queue) {
         if (error.ok()) {
             objReq->obj_data = buf;
-            object_cache.add_dirty(objReq->io_vol_id, obj_id, objReq->obj_data);
+            object_cache.add(objReq->io_vol_id, obj_id, objReq->obj_data);
         }
         fds_uint64_t total_nano = io_done_ts - static_cast<GetObjectReq*>(objReq)->blobReq->enqueue_ts;
 
@@ -3,6 +3,7 @@
  */
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "fds_process.h"
@@ -46,6 +47,24 @@ enum class Serialization {
 static constexpr uint32_t DmDefaultPrimaryCnt { 2 };
 static const std::string DefaultSerialization { "volume" };
 
+/**
+ * Deserializes a batched GET/PUT response from one SM.
+ * @return null unless payload is a response with a status for each of cnt objects
+ */
+template<typename RspMsgT>
+static boost::shared_ptr<RspMsgT>
+batchResponse(boost::shared_ptr<std::string> const& payload, size_t const cnt) {
+    if (!payload) {
+        return nullptr;
+    }
+    Error err(ERR_OK);
+    auto rsp = deserializeFdspMsg<RspMsgT>(err, payload);
+    if (!rsp || (rsp->statuses.size() != cnt)) {
+        return nullptr;
+    }
+    return rsp;
+}
+
 struct ErrorHandler : public VolumeGroupHandleListener {
     bool isError(fpi::FDSPMsgTypeId const& msgType, Error const& e) override;
 };
@@ -131,6 +150,21 @@ AmDispatcher::start() {
                   << " IO timeout:" << message_timeout_io  << " ms"
                   << " Coordinator switch timeout: "
                   << VolumeGroupHandle::COORDINATOR_SWITCH_TIMEOUT_MS << " ms";
+
+        if (conf.get_abs<bool>("fds.am.svc.batch.enable", false) && !get_batcher) {
+            std::chrono::microseconds window(conf.get_abs<fds_uint32_t>("fds.am.svc.batch.window_us", 50));
+            auto max_objects = conf.get_abs<fds_uint32_t>("fds.am.svc.batch.max_objects", 32);
+            auto max_bytes = conf.get_abs<fds_uint32_t>("fds.am.svc.batch.max_bytes", 1024 * 1024);
+            get_batcher.reset(new get_batcher_type(window, max_objects, std::numeric_limits<size_t>::max(),
+                [this] (SmBatchKey const& key, std::vector<GetObjectReq*>&& batch) mutable -> void {
+                    getObjectBatch(key, std::move(batch)); }));
+            put_batcher.reset(new put_batcher_type(window, max_objects, max_bytes,
+                [this] (SmBatchKey const& key, std::vector<PutObjectReq*>&& batch) mutable -> void {
+                    putObjectBatch(key, std::move(batch)); }));
+            LOGNOTIFY << "AM SM object batching window:" << window.count() << " us"
+                      << " max objects:" << max_objects
+                      << " max bytes:" << max_bytes;
+        }
     }
 
     if (conf.get<bool>("standalone", false)) {
@@ -206,6 +240,10 @@ AmDispatcher::done() {
 
 void
 AmDispatcher::stop() {
+    if (get_batcher) {
+        get_batcher->stop();
+        put_batcher->stop();
+    }
     if (StatsCollector::singleton()->isStreaming()) {
         StatsCollector::singleton()->stopStreaming();
     }
@@ -259,21 +297,70 @@ AmDispatcher::addToVolumeGroup(const fpi::AddToVolumeGroupCtrlMsgPtr &addMsg,
  */
 void
 AmDispatcher::setSerialization(AmRequest* amReq, boost::shared_ptr<SvcRequestIf> svcReq) {
+    if (Serialization::SERIAL_NONE != serialization) {
+        svcReq->setTaskExecutorId(serializationExecutorId(amReq));
+    }
+}
+
+/**
+ * @brief Task executor the configured request serialization puts amReq on,
+ * 0 when requests aren't serialized.
+ */
+size_t
+AmDispatcher::serializationExecutorId(AmRequest* amReq) const {
     static std::hash<fds_volid_t> volIDHash;
     static std::hash<std::string> blobNameHash;
 
     switch (serialization) {
         case Serialization::SERIAL_VOLUME:
-            svcReq->setTaskExecutorId(volIDHash(amReq->io_vol_id));
-            break;
+            return volIDHash(amReq->io_vol_id);
 
         case Serialization::SERIAL_BLOB:
-            svcReq->setTaskExecutorId((volIDHash(amReq->io_vol_id) + blobNameHash(amReq->getBlobName())));
-            break;
+            return (volIDHash(amReq->io_vol_id) + blobNameHash(amReq->getBlobName()));
 
         default:
-            break;
+            return 0;
+    }
+}
+
+SmBatchKey
+AmDispatcher::smBatchKey(TableRoute const& token_group,
+                         size_t const executor_id) const {
+    SmBatchKey key;
+    key.dlt_version = token_group.version;
+    key.executor_id = executor_id;
+    key.sm_uuids.reserve(token_group.depth);
+    for (uint32_t i = 0; token_group.depth > i; ++i) {
+        key.sm_uuids.push_back(token_group.get(i).uuid_get_val());
+    }
+    return key;
+}
+
+Error
+AmDispatcher::getSmRoute(ObjectID const& objId, TableRoute& route) const {
+    if (dltMgr->getRoute(objId, route)) {
+        return ERR_OK;
+    }
+    // No flat copy: either no DLT yet or one deeper than a route holds
+    auto const dlt = dltMgr->getDLT();
+    if (nullptr == dlt) {
+        LOGWARN << "no DLT to route object: " << objId;
+        return ERR_NOT_READY;
+    }
+    route.assign(dlt->getVersion(), dlt->getNodes(objId));
+    return ERR_OK;
+}
+
+void
+AmDispatcher::getDmRoute(fds_volid_t const vol_id,
+                         fds_uint64_t const dmt_ver,
+                         TableRoute& route) const {
+    if (dmtMgr->getRoute(vol_id, dmt_ver, route)) {
+        return;
     }
+    // Not the committed version (a commit raced with us) or a DMT deeper
+    // than a route holds, take the lock
+    route.assign(dmt_ver, dmtMgr->getVersionNodeGroup(vol_id, dmt_ver));
 }
 
 /**
@@ -1138,6 +1225,26 @@ AmDispatcher::putObject(AmRequest* amReq) {
         return;
     }
 
+    if (put_batcher) {
+        TableRoute route;
+        auto err = getSmRoute(objReq->obj_id, route);
+        if (ERR_OK != err) {
+            AmDataProvider::putObjectCb(amReq, err);
+            return;
+        }
+        objReq->dlt_version = route.version;
+        put_batcher->add(smBatchKey(route, serializationExecutorId(objReq)),
+                         objReq,
+                         objReq->data_len);
+        return;
+    }
+    _putObject(amReq);
+}
+
+void
+AmDispatcher::_putObject(AmRequest* amReq) {
+    auto objReq = static_cast<PutObjectReq *>(amReq);
+
     auto message(boost::make_shared<fpi::PutObjectMsg>());
     message->volume_id          = objReq->io_vol_id.get();
     message->data_obj.assign(objReq->dataPtr->c_str(), objReq->data_len);
@@ -1176,6 +1283,25 @@ AmDispatcher::getObject(AmRequest* amReq)
                                      std::bind(&AmDispatcherMockCbs::getObjectCb, amReq)); \
                                      return;);
 
+    auto blobReq = static_cast<GetObjectReq *>(amReq);
+    if (get_batcher) {
+        TableRoute route;
+        auto err = getSmRoute(*blobReq->obj_id, route);
+        if (ERR_OK != err) {
+            AmDataProvider::getObjectCb(amReq, err);
+            return;
+        }
+        blobReq->dlt_version = route.version;
+        get_batcher->add(smBatchKey(route, 0),
+                         blobReq);
+        return;
+    }
+    _getObject(amReq);
+}
+
+void
+AmDispatcher::_getObject(AmRequest* amReq)
+{
     auto blobReq = static_cast<GetObjectReq *>(amReq);
     ObjectID const& objId = *blobReq->obj_id;
 
@@ -1219,6 +1345,204 @@ AmDispatcher::getObjectCb(AmRequest* amReq,
     AmDataProvider::getObjectCb(amReq, error);
 }
 
+/**
+ * Sends a coalesced batch of object PUTs to the token group in key.  All
+ * requests carry the same serialization executor, so the batch is serialized
+ * like any one of them would be.
+ */
+void
+AmDispatcher::putObjectBatch(SmBatchKey const& key, std::vector<PutObjectReq*>&& batch) {
+    if (1 == batch.size()) {
+        _putObject(batch.front());
+        return;
+    }
+
+    auto message(boost::make_shared<fpi::PutObjectBatchMsg>());
+    message->objects.resize(batch.size());
+    for (size_t i = 0; batch.size() > i; ++i) {
+        auto objReq = batch[i];
+        auto& objMsg = message->objects[i];
+        objMsg.volume_id          = objReq->io_vol_id.get();
+        objMsg.data_obj.assign(objReq->dataPtr->c_str(), objReq->data_len);
+        objMsg.data_obj_len       = objReq->data_len;
+        objMsg.data_obj_id.digest = std::string(
+            reinterpret_cast<const char*>(objReq->obj_id.GetId()),
+            objReq->obj_id.GetLen());
+    }
+
+    auto nodes = boost::make_shared<DltTokenGroup>(key.sm_uuids.size());
+    for (uint32_t i = 0; key.sm_uuids.size() > i; ++i) {
+        nodes->set(i, NodeUuid(key.sm_uuids[i]));
+    }
+    auto token_group = boost::make_shared<DltObjectIdEpProvider>(nodes);
+    auto num_nodes = token_group->getEps().size();
+
+    auto reqs = std::make_shared<std::vector<PutObjectReq*>>(std::move(batch));
+    auto requestPool = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
+    auto quorumReq = requestPool->newQuorumSvcRequest(token_group, key.dlt_version);
+    quorumReq->setTimeoutMs((0 < message_timeout_io) ? message_timeout_io : message_timeout_default);
+    quorumReq->setPayload(message_type_id(*message), message);
+    quorumReq->onResponseCb([reqs, this] (QuorumSvcRequest* svc,
+                                          const Error& error,
+                                          shared_str payload) mutable -> void {
+                                putObjectBatchCb(*reqs, svc, error, payload); });
+    quorumReq->setQuorumCnt((num_nodes / 3) + 1);
+    setSerialization(reqs->front(), quorumReq);
+    for (auto objReq : *reqs) {
+        PerfTracer::tracePointBegin(objReq->sm_perf_ctx);
+    }
+    LOGTRACE << "Writing batch of " << reqs->size() << " objects";
+    quorumReq->invoke();
+}
+
+void
+AmDispatcher::putObjectBatchCb(std::vector<PutObjectReq*> const& batch,
+                               QuorumSvcRequest* svcReq,
+                               const Error& error,
+                               shared_str payload) {
+    if ((ERR_OK == error) ||
+        (ERR_IO_DLT_MISMATCH == error) ||
+        (ERR_SVC_REQUEST_TIMEOUT == error)) {
+        // Same outcome for every object, handle as single object responses
+        for (auto objReq : batch) {
+            putObjectCb(objReq, svcReq, error, nullptr);
+        }
+        return;
+    }
+
+    // Some object failed on some SM.  The quorum only tells us the batch failed,
+    // so count per object how many SMs took it.  Objects a quorum of SMs took
+    // are done, only the rest are retried on the single object path.
+    std::vector<uint32_t> written(batch.size(), 0);
+    for (uint8_t i = 0; svcReq->epCount() > i; ++i) {
+        auto const& header = svcReq->responseHeader(i);
+        if (!header) {
+            // No response from this SM
+            continue;
+        }
+        if (ERR_OK == header->msg_code) {
+            for (auto& cnt : written) {
+                ++cnt;
+            }
+            continue;
+        }
+        auto rsp = batchResponse<fpi::PutObjectBatchRspMsg>(svcReq->responsePayload(i),
+                                                            batch.size());
+        if (!rsp) {
+            continue;
+        }
+        for (size_t j = 0; batch.size() > j; ++j) {
+            if (ERR_OK == rsp->statuses[j]) {
+                ++written[j];
+            }
+        }
+    }
+
+    size_t retried = 0;
+    for (size_t j = 0; batch.size() > j; ++j) {
+        auto objReq = batch[j];
+        if (written[j] >= svcReq->getQuorumCnt()) {
+            putObjectCb(objReq, svcReq, ERR_OK, nullptr);
+        } else {
+            PerfTracer::tracePointEnd(objReq->sm_perf_ctx);
+            _putObject(objReq);
+            ++retried;
+        }
+    }
+    LOGNOTIFY << "batch of " << batch.size() << " objects failed, err:" << error
+              << " retrying " << retried << " individually";
+}
+
+/**
+ * Sends a coalesced batch of object GETs to the token group in key.
+ */
+void
+AmDispatcher::getObjectBatch(SmBatchKey const& key, std::vector<GetObjectReq*>&& batch) {
+    if (1 == batch.size()) {
+        _getObject(batch.front());
+        return;
+    }
+
+    auto message(boost::make_shared<fpi::GetObjectBatchMsg>());
+    message->objects.resize(batch.size());
+    for (size_t i = 0; batch.size() > i; ++i) {
+        auto blobReq = batch[i];
+        ObjectID const& objId = *blobReq->obj_id;
+        auto& objMsg = message->objects[i];
+        objMsg.volume_id = blobReq->io_vol_id.get();
+        objMsg.data_obj_id.digest = std::string(reinterpret_cast<const char*>(objId.GetId()),
+                                                objId.GetLen());
+    }
+
+    auto nodes = boost::make_shared<DltTokenGroup>(key.sm_uuids.size());
+    for (uint32_t i = 0; key.sm_uuids.size() > i; ++i) {
+        nodes->set(i, NodeUuid(key.sm_uuids[i]));
+    }
+    auto provider = boost::make_shared<DltObjectIdEpProvider>(nodes);
+
+    auto reqs = std::make_shared<std::vector<GetObjectReq*>>(std::move(batch));
+    auto requestPool = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
+    auto failoverReq = requestPool->newFailoverSvcRequest(provider, key.dlt_version);
+    failoverReq->onResponseCb([reqs, this] (FailoverSvcRequest* svc,
+                                            const Error& error,
+                                            shared_str payload) mutable -> void {
+                                  getObjectBatchCb(*reqs, svc, error, payload); });
+    failoverReq->setTimeoutMs((0 < message_timeout_io) ? message_timeout_io : message_timeout_default);
+    failoverReq->setPayload(message_type_id(*message), message);
+    // Objects are immutable, any replica in the token group can serve the read
+    failoverReq->enableHedging();
+    for (auto blobReq : *reqs) {
+        PerfTracer::tracePointBegin(blobReq->sm_perf_ctx);
+    }
+    LOGTRACE << "Reading batch of " << reqs->size() << " objects";
+    failoverReq->invoke();
+}
+
+void
+AmDispatcher::getObjectBatchCb(std::vector<GetObjectReq*> const& batch,
+                               FailoverSvcRequest* svcReq,
+                               const Error& error,
+                               shared_str payload) {
+    Error err = error;
+    boost::shared_ptr<fpi::GetObjectBatchRspMsg> getObjRsp;
+    // A DLT mismatch retries every object like the single object path does,
+    // any other failure with per object statuses is settled per object.
+    if (ERR_IO_DLT_MISMATCH != error) {
+        getObjRsp = batchResponse<fpi::GetObjectBatchRspMsg>(payload, batch.size());
+        if (getObjRsp && (getObjRsp->objects.size() != batch.size())) {
+            getObjRsp.reset();
+        }
+        if (!getObjRsp && (ERR_OK == err)) {
+            LOGERROR << "batch response is not for " << batch.size() << " objects";
+            err = ERR_SERIALIZE_FAILED;
+        }
+    }
+    if (!getObjRsp) {
+        // Same outcome for every object, handle as single object responses
+        for (auto blobReq : batch) {
+            getObjectCb(blobReq, svcReq, err, nullptr);
+        }
+        return;
+    }
+
+    for (size_t i = 0; batch.size() > i; ++i) {
+        auto blobReq = batch[i];
+        PerfTracer::tracePointEnd(blobReq->sm_perf_ctx);
+        Error objErr(static_cast<fds_errno_t>(getObjRsp->statuses[i]));
+        if (ERR_OK == objErr) {
+            LOGTRACE << "objid:" << *blobReq->obj_id;
+            blobReq->obj_data = boost::make_shared<std::string>(
+                std::move(getObjRsp->objects[i].data_obj));
+            AmDataProvider::getObjectCb(blobReq, ERR_OK);
+        } else {
+            // The single object read fails over to the other replicas
+            LOGDEBUG << "objid:" << *blobReq->obj_id << " err:" << objErr
+                     << " retrying individually";
+            _getObject(blobReq);
+        }
+    }
+}
+
 fds_bool_t
 AmDispatcher::missingBlobStatusCb(AmRequest* amReq,
                                   const Error& error,
@@ -15,6 +15,7 @@ AmQoSCtrl::AmQoSCtrl(AmDataProvider* prev, uint32_t max_thrds, fds_log *log)
 {
     total_rate = 200000;
     htb_dispatcher = new QoSHTBDispatcher(this, qos_log, total_rate);
+    htb_dispatcher->loadCostModel("fds.am.qos.");
     dispatcher = htb_dispatcher;
 }
 
@@ -45,7 +46,10 @@ Error AmQoSCtrl::processIO(FDS_IOType *io) {
     LOGTRACE << "id:" << amReq->io_req_id << " scheduling request";
     auto vol_id = io->io_vol_id;
     threadPool->schedule([this] (FDS_IOType* io) mutable -> void
-                         { unknownTypeResume(static_cast<AmRequest*>(io)); }, io);
+                         {
+                             StageTracer::Scope traceScope(io->traceId);
+                             unknownTypeResume(static_cast<AmRequest*>(io));
+                         }, io);
     {
         ReadGuard rg(queue_lock);
         auto queue = getQueue(vol_id);
@@ -436,7 +436,9 @@ AmTxManager::putBlob(AmRequest *amReq) {
         blobReq->obj_id = ObjectID();
     } else {
         SCOPED_PERF_TRACEPOINT_CTX(amReq->hash_perf_ctx);
+        StageTracer::record(amReq->traceId, TraceStage::HASH_START, amReq->data_len);
         blobReq->obj_id = ObjIdGen::genObjectId(blobReq->dataPtr->c_str(), amReq->data_len);
+        StageTracer::record(amReq->traceId, TraceStage::HASH_END, amReq->data_len);
     }
 
     // Create the request to update SM with the new object
@@ -476,7 +478,9 @@ AmTxManager::putBlobOnce(AmRequest *amReq) {
         blobReq->obj_id = ObjectID();
     } else {
         SCOPED_PERF_TRACEPOINT_CTX(amReq->hash_perf_ctx);
+        StageTracer::record(amReq->traceId, TraceStage::HASH_START, amReq->data_len);
         blobReq->obj_id = ObjIdGen::genObjectId(blobReq->dataPtr->c_str(), amReq->data_len);
+        StageTracer::record(amReq->traceId, TraceStage::HASH_END, amReq->data_len);
     }
 
     blobReq->setTxId(randNumGen->genNumSafe());
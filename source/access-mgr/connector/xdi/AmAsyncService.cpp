@@ -15,6 +15,7 @@
 #include "AmProcessor.h"
 
 #include "connector/xdi/AmAsyncService.h"
+#include "connector/xdi/AmAsyncShmService.h"
 #include "connector/xdi/AmAsyncXdi.h"
 #include "connector/xdi/XdiRestfulInterface.h"
 
@@ -109,6 +110,15 @@ AsyncDataServer::AsyncDataServer(std::weak_ptr<AmProcessor> processor,
     // Timeout for flush request to xdi in ms
     XdiRestfulInterface::TIMEOUT = conf.get_abs<uint32_t>(
         "fds.am.svc.timeout.coordinator_switch", XdiRestfulInterface::TIMEOUT);
+
+    // Data requests from a local XDI can bypass Thrift
+    if (conf.get<bool>("xdi_shm.enable", false)) {
+        shmServer.reset(new AsyncShmDataServer(processor, port));
+    }
+}
+
+AsyncDataServer::~AsyncDataServer() {
+    stop();
 }
 
 /**
@@ -129,10 +139,17 @@ AsyncDataServer::start() {
         LOGERROR << "unable to start async data server:" << e.what();
         fds_panic("Unable to start async data server...bailing out");
     }
+
+    if (shmServer) {
+        shmServer->start();
+    }
 }
 
 void
 AsyncDataServer::stop() {
+    if (shmServer) {
+        shmServer->stop();
+    }
     ttServer->stop();
     if (listen_thread) {
         listen_thread->join();
@@ -0,0 +1,425 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <fds_process.h>
+#include <util/Log.h>
+
+#include "AmProcessor.h"
+#include "connector/xdi/AmAsyncShmService.h"
+
+namespace fds {
+
+/* Responses owed to a client that stopped draining its ring */
+static constexpr size_t response_backlog_max {16384};
+/* Polls of an empty request ring before sleeping on its doorbell */
+static constexpr uint32_t request_spin_polls {2000};
+/*
+ * The Java client can't ring the doorbell, so every wait ends in a timeout.
+ * Waits double from the shortest to the longest while the ring stays empty.
+ */
+static constexpr uint32_t request_wait_us {1000};
+static constexpr uint32_t request_wait_max_us {16000};
+
+void
+AmAsyncShmResponse::respond(ShmResponseDesc& resp) {
+    std::lock_guard<std::mutex> g(respLock);
+    if (0 < outstanding) {
+        --outstanding;
+    }
+    if (!closed) {
+        // Behind the backlog so responses keep their order. admit() keeps
+        // the backlog from growing past response_backlog_max.
+        if (backlog.empty() && channel.responses().push(resp)) {
+            return;
+        }
+        backlog.push_back(resp);
+        return;
+    }
+    // Nobody will pick this up, take the buffer back
+    if (0 <= resp.buffer) {
+        channel.buffers().free(resp.buffer);
+    }
+}
+
+bool
+AmAsyncShmResponse::admit() {
+    std::lock_guard<std::mutex> g(respLock);
+    if (backlog.size() + outstanding >= response_backlog_max) {
+        return false;
+    }
+    ++outstanding;
+    return true;
+}
+
+size_t
+AmAsyncShmResponse::drain() {
+    std::lock_guard<std::mutex> g(respLock);
+    while (!backlog.empty() && channel.responses().push(backlog.front())) {
+        backlog.pop_front();
+    }
+    return backlog.size();
+}
+
+void
+AmAsyncShmResponse::respond(XdiShmOp op,
+                            const api_type::error_type& error,
+                            api_type::handle_type const& requestId) {
+    ShmResponseDesc resp = {};
+    resp.handle = requestId.handle;
+    resp.op = op;
+    resp.status = ShmChannel::STATUS_OK;
+    resp.error = error;
+    resp.buffer = -1;
+    respond(resp);
+}
+
+void
+AmAsyncShmResponse::reject(uint64_t handle, uint32_t op, ShmChannel::Status status) {
+    ShmResponseDesc resp = {};
+    resp.handle = handle;
+    resp.op = op;
+    resp.status = status;
+    resp.error = fpi::BAD_REQUEST;
+    resp.buffer = -1;
+    respond(resp);
+}
+
+void
+AmAsyncShmResponse::close() {
+    std::lock_guard<std::mutex> g(respLock);
+    closed = true;
+    for (auto const& resp : backlog) {
+        if (0 <= resp.buffer) {
+            channel.buffers().free(resp.buffer);
+        }
+    }
+    backlog.clear();
+}
+
+void
+AmAsyncShmResponse::startBlobTxResp(const api_type::error_type &error,
+                                    api_type::handle_type const& requestId,
+                                    api_type::shared_tx_ctx_type& txDesc) {
+    ShmResponseDesc resp = {};
+    resp.handle = requestId.handle;
+    resp.op = XDI_SHM_START_BLOB_TX;
+    resp.status = ShmChannel::STATUS_OK;
+    resp.error = error;
+    resp.buffer = -1;
+    resp.txId = txDesc ? txDesc->txId : 0;
+    respond(resp);
+}
+
+void
+AmAsyncShmResponse::abortBlobTxResp(const api_type::error_type &error,
+                                    api_type::handle_type const& requestId) {
+    respond(XDI_SHM_ABORT_BLOB_TX, error, requestId);
+}
+
+void
+AmAsyncShmResponse::commitBlobTxResp(const api_type::error_type &error,
+                                     api_type::handle_type const& requestId) {
+    respond(XDI_SHM_COMMIT_BLOB_TX, error, requestId);
+}
+
+void
+AmAsyncShmResponse::updateBlobResp(const api_type::error_type &error,
+                                   api_type::handle_type const& requestId) {
+    respond(XDI_SHM_UPDATE_BLOB, error, requestId);
+}
+
+void
+AmAsyncShmResponse::updateBlobOnceResp(const api_type::error_type &error,
+                                       api_type::handle_type const& requestId) {
+    respond(XDI_SHM_UPDATE_BLOB_ONCE, error, requestId);
+}
+
+void
+AmAsyncShmResponse::deleteBlobResp(const api_type::error_type &error,
+                                   api_type::handle_type const& requestId) {
+    respond(XDI_SHM_DELETE_BLOB, error, requestId);
+}
+
+void
+AmAsyncShmResponse::getBlobResp(const api_type::error_type &error,
+                                api_type::handle_type const& requestId,
+                                api_type::shared_buffer_array_type const& bufs,
+                                api_type::size_type& length) {
+    if (fpi::OK != error) {
+        return respond(XDI_SHM_GET_BLOB, error, requestId);
+    }
+    // Same as the Thrift path: one object per read, a nullptr (with OK) is
+    // a zero'd out object
+    static const std::string empty_buffer;
+    auto const& buf = (bufs && !bufs->empty() && bufs->front()) ? *bufs->front() : empty_buffer;
+
+    ShmResponseDesc resp = {};
+    resp.handle = requestId.handle;
+    resp.op = XDI_SHM_GET_BLOB;
+    resp.error = error;
+    resp.buffer = -1;
+    if (buf.size() > channel.buffers().bufferSize() ||
+        0 > (resp.buffer = channel.buffers().allocate())) {
+        LOGDEBUG << "handle:" << requestId.handle << " length:" << buf.size()
+                 << " no shm buffer, client will retry";
+        resp.status = ShmChannel::STATUS_NO_BUFFER;
+        resp.buffer = -1;
+        return respond(resp);
+    }
+    memcpy(channel.buffers().buffer(resp.buffer), buf.data(), buf.size());
+    resp.status = ShmChannel::STATUS_OK;
+    resp.length = buf.size();
+    respond(resp);
+}
+
+// None of these are ever dispatched from the channel, see XdiShmOp
+void
+AmAsyncShmResponse::attachVolumeResp(const api_type::error_type &error,
+                                     api_type::handle_type const& requestId,
+                                     api_type::shared_vol_descriptor_type& volDesc,
+                                     api_type::shared_vol_mode_type& mode)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::detachVolumeResp(const api_type::error_type &error,
+                                     api_type::handle_type const& requestId)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::updateMetadataResp(const api_type::error_type &error,
+                                       api_type::handle_type const& requestId)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::renameBlobResp(const api_type::error_type &error,
+                                   api_type::handle_type const& requestId,
+                                   api_type::shared_descriptor_type& blobDesc)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::statBlobResp(const api_type::error_type &error,
+                                 api_type::handle_type const& requestId,
+                                 api_type::shared_descriptor_type& blobDesc)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::volumeStatusResp(const api_type::error_type &error,
+                                     api_type::handle_type const& requestId,
+                                     api_type::shared_status_type& volumeStatus)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::volumeContentsResp(const api_type::error_type &error,
+                                       api_type::handle_type const& requestId,
+                                       api_type::shared_descriptor_vec_type& volContents,
+                                       api_type::shared_string_vec_type& skippedPrefixes)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::setVolumeMetadataResp(const api_type::error_type &error,
+                                          api_type::handle_type const& requestId)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::getVolumeMetadataResp(const api_type::error_type &error,
+                                          api_type::handle_type const& requestId,
+                                          api_type::shared_meta_type& metadata)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+void
+AmAsyncShmResponse::getBlobWithMetaResp(const api_type::error_type &error,
+                                        api_type::handle_type const& requestId,
+                                        api_type::shared_buffer_array_type const& bufs,
+                                        api_type::size_type& length,
+                                        api_type::shared_descriptor_type& blobDesc)
+{ reject(requestId.handle, 0, ShmChannel::STATUS_UNSUPPORTED); }
+
+AsyncShmDataServer::AsyncShmDataServer(std::weak_ptr<AmProcessor> _processor,
+                                       fds_uint32_t port)
+        : processor(_processor),
+          segmentName("/fds-xdi-" + std::to_string(port)),
+          segmentSize(0),
+          stopping(false)
+{
+    FdsConfigAccessor conf(g_fdsprocess->get_fds_config(), "fds.am.xdi_shm.");
+    config.requestEntries = conf.get<int>("request_entries", config.requestEntries);
+    config.responseEntries = conf.get<int>("response_entries", config.responseEntries);
+    config.bufferCount = conf.get<int>("buffers", config.bufferCount);
+    config.bufferSize = conf.get<int>("buffer_size", config.bufferSize);
+    segmentSize = ShmChannel::segmentSize(config);
+}
+
+/**
+ * Create the segment and start serving the request ring
+ */
+void
+AsyncShmDataServer::start() {
+    auto amProcessor = processor.lock();
+    if (!amProcessor) {
+        LOGNORMAL << "no processing layer";
+        return;
+    }
+
+    // Left behind if the last AM on this port didn't exit cleanly
+    std::unique_ptr<FdsShmem> segment(new FdsShmem(segmentName.c_str(), segmentSize));
+    segment->shm_remove();
+    void* base = segment->shm_alloc();
+    ShmChannel channel;
+    auto generation = std::chrono::system_clock::now().time_since_epoch().count();
+    if (nullptr == base || MAP_FAILED == base ||
+        !channel.format(base, segmentSize, config, generation)) {
+        // Thrift still works, the client just won't find the segment
+        LOGERROR << "segment:" << segmentName << " size:" << segmentSize
+                 << " unable to create shared memory data plane";
+        if (nullptr != base && MAP_FAILED != base) {
+            segment->shm_detach();
+        }
+        segment->shm_remove();
+        return;
+    }
+
+    responseApi = boost::make_shared<AmAsyncShmResponse>(std::move(segment), channel);
+    dataApi.reset(new AmAsyncDataApi(amProcessor, responseApi));
+
+    LOGNORMAL << "segment:" << segmentName
+              << " size:" << segmentSize
+              << " buffers:" << config.bufferCount << "x" << config.bufferSize
+              << " starting shared memory data server";
+    stopping = false;
+    serve_thread.reset(new std::thread(&AsyncShmDataServer::serve, this));
+}
+
+void
+AsyncShmDataServer::stop() {
+    stopping = true;
+    if (serve_thread) {
+        serve_thread->join();
+        serve_thread.reset();
+    }
+    if (!responseApi) {
+        return;
+    }
+    // Requests still in the AM respond into the void from here on; the
+    // mapping goes away with the last of them
+    responseApi->close();
+    FdsShmem(segmentName.c_str(), segmentSize).shm_remove();
+    dataApi.reset();
+    responseApi.reset();
+}
+
+void
+AsyncShmDataServer::serve() {
+    auto& requests = responseApi->getChannel().requests();
+    uint32_t idle = 0;
+    uint32_t waitUs = request_wait_us;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        size_t waiting = responseApi->drain();
+        const ShmRequestDesc* req = requests.front();
+        if (nullptr == req) {
+            // Stay hot for a little while under load before sleeping, and
+            // keep polling while responses wait for the client to make room
+            if (0 < waiting) {
+                std::this_thread::yield();
+            } else if (++idle > request_spin_polls) {
+                requests.waitNotEmpty(waitUs);
+                waitUs = std::min(waitUs * 2, request_wait_max_us);
+            }
+            continue;
+        }
+        idle = 0;
+        waitUs = request_wait_us;
+        // Every request answers once; while the responses already owed could
+        // fill the backlog, leave the rest on the ring for the client to
+        // wait on
+        if (!responseApi->admit()) {
+            std::this_thread::yield();
+            continue;
+        }
+        dispatch(*req);
+        requests.release();
+    }
+}
+
+void
+AsyncShmDataServer::dispatch(const ShmRequestDesc& req) {
+    using api_type = AmAsyncDataApi;
+    auto& slab = responseApi->getChannel().buffers();
+
+    auto domainName = boost::make_shared<std::string>();
+    auto volumeName = boost::make_shared<std::string>();
+    auto blobName = boost::make_shared<std::string>();
+    ShmArgReader args(req);
+    args.get(*domainName).get(*volumeName).get(*blobName);
+
+    // Payload of a write, owned by us from here on
+    bool hasPayload = (XDI_SHM_UPDATE_BLOB == req.op || XDI_SHM_UPDATE_BLOB_ONCE == req.op);
+    bool payloadOk = (0 <= req.buffer && req.buffer < static_cast<int32_t>(slab.count()) &&
+                      req.length <= slab.bufferSize());
+    api_type::shared_buffer_type bytes;
+    if (hasPayload && payloadOk) {
+        bytes = boost::make_shared<std::string>(slab.buffer(req.buffer), req.length);
+        slab.free(req.buffer);
+    }
+
+    auto meta = boost::make_shared<std::map<std::string, std::string>>();
+    if (XDI_SHM_UPDATE_BLOB_ONCE == req.op) {
+        args.get(*meta);
+    }
+    if (!args.ok() || (hasPayload && !payloadOk) ||
+        (XDI_SHM_GET_BLOB == req.op && req.length > slab.bufferSize())) {
+        LOGWARN << "handle:" << req.handle << " op:" << req.op << " malformed request";
+        return responseApi->reject(req.handle, req.op, ShmChannel::STATUS_BAD_REQUEST);
+    }
+
+    LOGIO << "op:" << req.op << " handle:" << req.handle
+          << " vol:" << *volumeName << " blob:" << *blobName
+          << " offset:" << req.offset << " length:" << req.length;
+
+    api_type::handle_type handle { req.handle, 0 };
+    auto length = boost::make_shared<int32_t>(req.length);
+    auto offset = boost::make_shared<apis::ObjectOffset>();
+    offset->value = req.offset;
+    auto mode = boost::make_shared<int32_t>(req.mode);
+    auto txDesc = boost::make_shared<apis::TxDescriptor>();
+    txDesc->txId = req.txId;
+
+    switch (req.op) {
+        case XDI_SHM_GET_BLOB:
+            dataApi->getBlob(handle, domainName, volumeName, blobName, length, offset);
+            break;
+        case XDI_SHM_UPDATE_BLOB:
+            dataApi->updateBlob(handle, domainName, volumeName, blobName,
+                                txDesc, bytes, length, offset);
+            break;
+        case XDI_SHM_UPDATE_BLOB_ONCE:
+            dataApi->updateBlobOnce(handle, domainName, volumeName, blobName,
+                                    mode, bytes, length, offset, meta);
+            break;
+        case XDI_SHM_START_BLOB_TX:
+            dataApi->startBlobTx(handle, domainName, volumeName, blobName, mode);
+            break;
+        case XDI_SHM_COMMIT_BLOB_TX:
+            dataApi->commitBlobTx(handle, domainName, volumeName, blobName, txDesc);
+            break;
+        case XDI_SHM_ABORT_BLOB_TX:
+            dataApi->abortBlobTx(handle, domainName, volumeName, blobName, txDesc);
+            break;
+        case XDI_SHM_DELETE_BLOB:
+            dataApi->deleteBlob(handle, domainName, volumeName, blobName, txDesc);
+            break;
+        default:
+            responseApi->reject(req.handle, req.op, ShmChannel::STATUS_UNSUPPORTED);
+            break;
+    }
+}
+
+}  // namespace fds
@@ -9,6 +9,7 @@
 #include "AmAsyncDataApi.h"
 #include "AmDataProvider.h"
 #include <blob/BlobTypes.h>
+#include <cache/SharedContentCache.h>
 #include <cache/VolumeSharedKvCache.h>
 
 namespace fds {
@@ -36,7 +37,8 @@ class AmCache :
         descriptor_cache_type;
     typedef VolumeSharedCacheManager<BlobOffsetPair, ObjectID, BlobOffsetPairHash>
         offset_cache_type;
-    typedef VolumeSharedCacheManager<ObjectID, std::string, ObjectHash, std::true_type>
+    // Objects are content addressed, so one cache serves every volume
+    typedef SharedContentCache<ObjectID, std::string, ObjectHash>
         object_cache_type;
 
   public:
@@ -5,11 +5,14 @@
 #define SOURCE_ACCESS_MGR_INCLUDE_AMDISPATCHER_H_
 
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <tuple>
+#include <vector>
 #include "AmDataProvider.h"
 #include <net/SvcRequest.h>
+#include "concurrency/BatchCoalescer.h"
 #include "concurrency/RwLock.h"
 
 /* Forward declarations */
@@ -26,6 +29,7 @@ struct DeleteBlobReq;
 struct ErrorHandler;
 struct GetVolumeMetadataReq;
 struct GetBlobReq;
+struct GetObjectReq;
 struct DetachVolumeReq;
 struct RenameBlobReq;
 struct PutObjectReq;
@@ -85,6 +89,32 @@ struct VolumeDispatchTable {
     fds_rwlock table_lock;
 };
 
+/**
+ * Object requests that can share one batched SM message: same DLT version,
+ * same token group and, for writes, the same serialization executor.
+ */
+struct SmBatchKey {
+    fds_uint64_t dlt_version {0};
+    size_t executor_id {0};
+    std::vector<fds_uint64_t> sm_uuids;
+
+    bool operator==(SmBatchKey const& rhs) const {
+        return (dlt_version == rhs.dlt_version) &&
+               (executor_id == rhs.executor_id) &&
+               (sm_uuids == rhs.sm_uuids);
+    }
+};
+
+struct SmBatchKeyHash {
+    size_t operator()(SmBatchKey const& key) const {
+        size_t h = std::hash<fds_uint64_t>()(key.dlt_version) ^ (key.executor_id << 1);
+        for (auto const& uuid : key.sm_uuids) {
+            h = h * 31 + std::hash<fds_uint64_t>()(uuid);
+        }
+        return h;
+    }
+};
+
 /**
  * AM FDSP request dispatcher and reciever. The dispatcher
  * does the work to send and receive AM network messages over
@@ -160,6 +190,34 @@ struct AmDispatcher : public AmDataProvider
     std::mutex tx_map_lock;
     tx_map_barrier_type tx_map_barrier;
 
+    /**
+     * Concurrent object GETs/PUTs bound for the same SMs are coalesced within
+     * a short window into GetObjectBatchMsg/PutObjectBatchMsg.  Null unless
+     * fds.am.svc.batch.enable is set.
+     */
+    using get_batcher_type = BatchCoalescer<SmBatchKey, GetObjectReq*, SmBatchKeyHash>;
+    using put_batcher_type = BatchCoalescer<SmBatchKey, PutObjectReq*, SmBatchKeyHash>;
+    std::unique_ptr<get_batcher_type> get_batcher;
+    std::unique_ptr<put_batcher_type> put_batcher;
+
+    SmBatchKey smBatchKey(TableRoute const& token_group,
+                          size_t const executor_id) const;
+
+    /**
+     * Replica group of an object (current DLT) or volume (given DMT
+     * version), looked up without taking the table locks when the table
+     * has a flat copy. getSmRoute returns ERR_NOT_READY without a DLT.
+     */
+    Error getSmRoute(ObjectID const& objId, TableRoute& route) const;
+    void getDmRoute(fds_volid_t const vol_id,
+                    fds_uint64_t const dmt_ver,
+                    TableRoute& route) const;
+    size_t serializationExecutorId(AmRequest* amReq) const;
+    void _getObject(AmRequest* amReq);
+    void _putObject(AmRequest* amReq);
+    void getObjectBatch(SmBatchKey const& key, std::vector<GetObjectReq*>&& batch);
+    void putObjectBatch(SmBatchKey const& key, std::vector<PutObjectReq*>&& batch);
+
     template<typename CbMeth, typename MsgPtr, typename ReqPtr>
     void readFromDM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_t const timeout=0);
 
@@ -267,6 +325,16 @@ struct AmDispatcher : public AmDataProvider
                      const Error& error,
                      shared_str payload);
 
+    void putObjectBatchCb(std::vector<PutObjectReq*> const& batch,
+                          QuorumSvcRequest* svcReq,
+                          const Error& error,
+                          shared_str payload);
+
+    void getObjectBatchCb(std::vector<GetObjectReq*> const& batch,
+                          FailoverSvcRequest* svcReq,
+                          const Error& error,
+                          shared_str payload);
+
     void getQueryCatalogCb(GetBlobReq* amReq,
                            FailoverSvcRequest* svcReq,
                            const Error& error,
@@ -38,13 +38,10 @@ AmDispatcher::readFromDM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_
     fds_assert(DMT_VER_INVALID != dmt_ver);
     request->dmt_version = dmt_ver;
     // Take the group from a provided table version
-    auto dm_group = dmtMgr->getVersionNodeGroup(vol_id, dmt_ver);
-    auto numNodes = std::min(dm_group->getLength(), numPrimaries);
-    DmtColumnPtr dmPrimariesForVol = boost::make_shared<DmtColumn>(numNodes);
-    for (uint32_t i = 0; numNodes > i; ++i) {
-        dmPrimariesForVol->set(i, dm_group->get(i));
-    }
-    auto primary = boost::make_shared<DmtVolumeIdEpProvider>(dmPrimariesForVol);
+    TableRoute dm_group;
+    getDmRoute(vol_id, dmt_ver, dm_group);
+    dm_group.depth = std::min(dm_group.depth, numPrimaries);
+    auto primary = boost::make_shared<DmtVolumeIdEpProvider>(dm_group);
     auto requestPool = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
     auto failoverReq = requestPool->newFailoverSvcRequest(primary, dmt_ver);
     failoverReq->onResponseCb([cb_func, request, this] (FailoverSvcRequest* svc,
@@ -82,12 +79,13 @@ AmDispatcher::writeToDM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_t
     auto const& dmt_ver = request->dmt_version;
     fds_assert(DMT_VER_INVALID != dmt_ver);
     // Take the group from a provided table version
-    auto dm_group = dmtMgr->getVersionNodeGroup(vol_id, dmt_ver);
+    TableRoute dm_group;
+    getDmRoute(vol_id, dmt_ver, dm_group);
     // Assuming the first N (if any) nodes are the primaries and
     // the rest are backups.
     std::vector<fpi::SvcUuid> primaries, secondaries;
-    for (size_t i = 0; dm_group->getLength() > i; ++i) {
-        auto uuid = dm_group->get(i).toSvcUuid();
+    for (size_t i = 0; dm_group.depth > i; ++i) {
+        auto uuid = dm_group.get(i).toSvcUuid();
         if (numPrimaries > i) {
             primaries.push_back(uuid);
             continue;
@@ -131,22 +129,17 @@ AmDispatcher::writeToDM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_t
 template<typename CbMeth, typename MsgPtr, typename ReqPtr>
 void
 AmDispatcher::readFromSM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_t const timeout) {
-    // get DLT and add refcnt to account for in-flight IO sent with
-    // this DLT version; when DLT version changes, we don't ack to OM
-    // until all in-flight IO for the previous version complete
-    auto const dlt = dltMgr->getDLT();
-    auto dlt_version = dlt->getVersion();
-    request->dlt_version = dlt_version;
     auto const& objId = *request->obj_id;
-    auto token_group = dlt->getNodes(objId);
-
-    // Build a group of only the primaries for this read
-    auto numNodes = token_group->getLength();
-    auto nodes = boost::make_shared<DltTokenGroup>(numNodes);
-    for (uint32_t i = 0; numNodes > i; ++i) {
-       nodes->set(i, token_group->get(i));
+    TableRoute token_group;
+    auto err = getSmRoute(objId, token_group);
+    if (ERR_OK != err) {
+        AmDataProvider::unknownTypeCb(request, err);
+        return;
     }
-    auto provider = boost::make_shared<DltObjectIdEpProvider>(nodes);
+    auto dlt_version = token_group.version;
+    request->dlt_version = dlt_version;
+
+    auto provider = boost::make_shared<DltObjectIdEpProvider>(token_group);
     auto requestPool = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
     auto failoverReq = requestPool->newFailoverSvcRequest(provider, dlt_version);
     failoverReq->onResponseCb([cb_func, request, this] (FailoverSvcRequest* svc,
@@ -155,6 +148,8 @@ AmDispatcher::readFromSM(ReqPtr request, MsgPtr message, CbMeth cb_func, uint32_
                                      (this->*(cb_func))(request, svc, error, payload); });
     failoverReq->setTimeoutMs((0 < timeout) ? timeout : message_timeout_default);
     failoverReq->setPayload(message_type_id(*message), message);
+    // Objects are immutable, any replica in the token group can serve the read
+    failoverReq->enableHedging();
     PerfTracer::tracePointBegin(request->sm_perf_ctx);
     LOGTRACE << "Reading object: " << objId;
     failoverReq->invoke();
@@ -179,14 +174,16 @@ template<typename CbMeth, typename MsgPtr, typename ReqPtr>
 void
 AmDispatcher::writeToSM(ReqPtr request, MsgPtr payload, CbMeth cb_func, uint32_t const timeout) {
     auto const& objId = request->obj_id;
-    // get DLT and add refcnt to account for in-flight IO sent with
-    // this DLT version; when DLT version changes, we don't ack to OM
-    // until all in-flight IO for the previous version complete
-    auto const dlt = dltMgr->getDLT();
-    auto dlt_version = dlt->getVersion();
+    TableRoute route;
+    auto err = getSmRoute(objId, route);
+    if (ERR_OK != err) {
+        AmDataProvider::unknownTypeCb(request, err);
+        return;
+    }
+    auto dlt_version = route.version;
     request->dlt_version = dlt_version;
 
-    auto token_group = boost::make_shared<DltObjectIdEpProvider>(dlt->getNodes(objId));
+    auto token_group = boost::make_shared<DltObjectIdEpProvider>(route);
     auto num_nodes = token_group->getEps().size();
 
     auto requestPool = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
@@ -11,6 +11,7 @@
 #include "fds_volume.h"
 #include "PerfTrace.h"
 #include "AsyncResponseHandlers.h"
+#include "util/ObjectPool.h"
 
 namespace fds
 {
@@ -61,7 +62,13 @@ struct AmRequest : public FDS_IOType {
         io_module = ACCESS_MGR_IO;
         io_req_id = 0;
         io_type   = _op;
+        io_size   = _data_len;
         setVolId(_vol_id);
+        // Requests from the connectors may start a new trace, the ones made
+        // while processing another request continue its trace
+        if (0 == traceId) {
+            traceId = StageTracer::sample();
+        }
     }
 
     void setVolId(fds_volid_t const vol_id) {
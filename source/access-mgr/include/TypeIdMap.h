@@ -72,6 +72,12 @@ template<> fpi::FDSPMsgTypeId constexpr message_type_id(fpi::PutObjectMsg const&
 
 template<> fpi::FDSPMsgTypeId constexpr message_type_id(fpi::GetObjectMsg const& msg)
 { return FDSP_MSG_TYPEID(fpi::GetObjectMsg); }
+
+template<> fpi::FDSPMsgTypeId constexpr message_type_id(fpi::PutObjectBatchMsg const& msg)
+{ return FDSP_MSG_TYPEID(fpi::PutObjectBatchMsg); }
+
+template<> fpi::FDSPMsgTypeId constexpr message_type_id(fpi::GetObjectBatchMsg const& msg)
+{ return FDSP_MSG_TYPEID(fpi::GetObjectBatchMsg); }
 // =============
 
 }  // namespace fds
@@ -33,6 +33,7 @@ namespace xdi_atp = apache::thrift::protocol;
 namespace xdi_ats = apache::thrift::server;
 
 class AsyncAmServiceRequestIfCloneFactory;
+class AsyncShmDataServer;
 
 /**
  * RPC-based async server for XDI. Exposes AM data interface via
@@ -53,6 +54,9 @@ class AsyncDataServer {
 
     std::shared_ptr<std::thread>                 listen_thread;
 
+    // Optional shared memory data plane for a local XDI
+    std::unique_ptr<AsyncShmDataServer>          shmServer;
+
     std::weak_ptr<AmProcessor>                   _processor;
     fds_uint32_t                                 _pmPort;
 
@@ -60,8 +64,7 @@ class AsyncDataServer {
     AsyncDataServer(std::weak_ptr<AmProcessor> processor, fds_uint32_t pmPort);
     AsyncDataServer(AsyncDataServer const&) = delete;
     AsyncDataServer& operator=(AsyncDataServer const&) = delete;
-    virtual ~AsyncDataServer()
-        { stop(); }
+    virtual ~AsyncDataServer();
 
     void start();
     void stop();
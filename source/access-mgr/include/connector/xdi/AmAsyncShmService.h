@@ -0,0 +1,184 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_XDI_AMASYNCSHMSERVICE_H_
+#define SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_XDI_AMASYNCSHMSERVICE_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <platform/fds_shmem.h>
+#include <util/ShmChannel.h>
+#include <AmAsyncDataApi.h>
+
+namespace fds {
+
+struct AmProcessor;
+
+/**
+ * Operations carried over the shared memory channel.  Everything else
+ * (listings, volume metadata, stat with metadata...) stays on Thrift, and so
+ * does any request whose names don't fit in a request slot or whose payload
+ * doesn't fit in a slab buffer.
+ */
+enum XdiShmOp : uint32_t {
+    XDI_SHM_GET_BLOB            = 1,
+    XDI_SHM_UPDATE_BLOB         = 2,
+    XDI_SHM_UPDATE_BLOB_ONCE    = 3,
+    XDI_SHM_START_BLOB_TX       = 4,
+    XDI_SHM_COMMIT_BLOB_TX      = 5,
+    XDI_SHM_ABORT_BLOB_TX       = 6,
+    XDI_SHM_DELETE_BLOB         = 7,
+};
+
+/**
+ * Response path of the shared memory channel.  Responses come from any AM
+ * thread, so they take a lock to be the ring's single producer.  A response
+ * that doesn't fit in the ring is parked in a backlog that the serve thread
+ * pushes as the client makes room; AM threads never wait on the client.  The
+ * serve thread only takes a request once the backlog has room for every
+ * response owed, so a client that stops draining is pushed back on instead of
+ * losing responses.
+ * Owns the mapping, requests still in the AM keep it alive after the server
+ * stopped.
+ */
+class AmAsyncShmResponse : public AmAsyncResponseApi {
+    using api_type = AmAsyncResponseApi;
+
+    std::unique_ptr<FdsShmem>   segment;
+    ShmChannel                  channel;
+    std::mutex                  respLock;
+    /* Responses waiting for ring space, oldest first */
+    std::deque<ShmResponseDesc> backlog;
+    /* Requests taken off the ring that haven't responded yet */
+    size_t                      outstanding {0};
+    /* Set once the server stopped, late responses are dropped */
+    bool                        closed {false};
+
+    void respond(ShmResponseDesc& resp);
+    void respond(XdiShmOp op, const api_type::error_type& error,
+                 api_type::handle_type const& requestId);
+
+  public:
+    AmAsyncShmResponse(std::unique_ptr<FdsShmem> seg, ShmChannel const& chan)
+        : segment(std::move(seg)), channel(chan) {}
+    ~AmAsyncShmResponse()
+        { segment->shm_detach(); }
+
+    ShmChannel& getChannel()
+        { return channel; }
+
+    /**
+     * Counts a request in before it is dispatched, called by the serve thread
+     * @return false if its response might not find room in the backlog
+     */
+    bool admit();
+    /** Answers a request without running it, e.g. so it is resent over Thrift */
+    void reject(uint64_t handle, uint32_t op, ShmChannel::Status status);
+    /**
+     * Moves backlogged responses into the ring, called by the serve thread
+     * @return number of responses still waiting
+     */
+    size_t drain();
+    void close();
+
+    void attachVolumeResp(const api_type::error_type &error,
+                          api_type::handle_type const& requestId,
+                          api_type::shared_vol_descriptor_type& volDesc,
+                          api_type::shared_vol_mode_type& mode) override;
+    void detachVolumeResp(const api_type::error_type &error,
+                          api_type::handle_type const& requestId) override;
+    void startBlobTxResp(const api_type::error_type &error,
+                         api_type::handle_type const& requestId,
+                         api_type::shared_tx_ctx_type& txDesc) override;
+    void abortBlobTxResp(const api_type::error_type &error,
+                         api_type::handle_type const& requestId) override;
+    void commitBlobTxResp(const api_type::error_type &error,
+                          api_type::handle_type const& requestId) override;
+    void updateBlobResp(const api_type::error_type &error,
+                        api_type::handle_type const& requestId) override;
+    void updateBlobOnceResp(const api_type::error_type &error,
+                            api_type::handle_type const& requestId) override;
+    void updateMetadataResp(const api_type::error_type &error,
+                            api_type::handle_type const& requestId) override;
+    void renameBlobResp(const api_type::error_type &error,
+                        api_type::handle_type const& requestId,
+                        api_type::shared_descriptor_type& blobDesc) override;
+    void deleteBlobResp(const api_type::error_type &error,
+                        api_type::handle_type const& requestId) override;
+    void statBlobResp(const api_type::error_type &error,
+                      api_type::handle_type const& requestId,
+                      api_type::shared_descriptor_type& blobDesc) override;
+    void volumeStatusResp(const api_type::error_type &error,
+                          api_type::handle_type const& requestId,
+                          api_type::shared_status_type& volumeStatus) override;
+    void volumeContentsResp(const api_type::error_type &error,
+                            api_type::handle_type const& requestId,
+                            api_type::shared_descriptor_vec_type& volContents,
+                            api_type::shared_string_vec_type& skippedPrefixes) override;
+    void setVolumeMetadataResp(const api_type::error_type &error,
+                               api_type::handle_type const& requestId) override;
+    void getVolumeMetadataResp(const api_type::error_type &error,
+                               api_type::handle_type const& requestId,
+                               api_type::shared_meta_type& metadata) override;
+    void getBlobResp(const api_type::error_type &error,
+                     api_type::handle_type const& requestId,
+                     api_type::shared_buffer_array_type const& bufs,
+                     api_type::size_type& length) override;
+    void getBlobWithMetaResp(const api_type::error_type &error,
+                             api_type::handle_type const& requestId,
+                             api_type::shared_buffer_array_type const& bufs,
+                             api_type::size_type& length,
+                             api_type::shared_descriptor_type& blobDesc) override;
+};
+
+/**
+ * Shared memory data plane for an XDI running on the same host.
+ *
+ * Creates the segment /fds-xdi-<port> (port being the Thrift XDI service
+ * port) with request and response rings and a slab of data buffers (see
+ * ShmChannel), and serves requests from the ring on its own thread through
+ * the same AmAsyncDataApi the Thrift server uses.  A write's payload is
+ * copied once out of the slab buffer the client filled, a read's payload is
+ * copied into a slab buffer that the client frees; nothing is serialized or
+ * goes through a socket.  The client falls back to Thrift for anything the
+ * channel doesn't carry.
+ *
+ * The XDI side is com.formationds.xdi.shm.ShmDataClient, used by RealAsyncAm
+ * when the AM is on its host.  It can't ring the futex doorbell, so a request
+ * reaches a sleeping serve thread after at most one doorbell wait; the waits
+ * get longer while the ring stays empty so an idle AM rarely wakes up.
+ */
+class AsyncShmDataServer {
+    std::weak_ptr<AmProcessor>          processor;
+    std::string                         segmentName;
+    ShmChannel::Config                  config;
+    size_t                              segmentSize;
+
+    boost::shared_ptr<AmAsyncShmResponse> responseApi;
+    std::unique_ptr<AmAsyncDataApi>     dataApi;
+
+    std::atomic<bool>                   stopping;
+    std::unique_ptr<std::thread>        serve_thread;
+
+    void serve();
+    void dispatch(const ShmRequestDesc& req);
+
+  public:
+    AsyncShmDataServer(std::weak_ptr<AmProcessor> processor, fds_uint32_t port);
+    AsyncShmDataServer(AsyncShmDataServer const&) = delete;
+    AsyncShmDataServer& operator=(AsyncShmDataServer const&) = delete;
+    ~AsyncShmDataServer()
+        { stop(); }
+
+    void start();
+    void stop();
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_ACCESS_MGR_INCLUDE_CONNECTOR_XDI_AMASYNCSHMSERVICE_H_
@@ -15,7 +15,8 @@ namespace fds
 
 struct CommitBlobTxReq : 
     public AmRequest,
-    public AmTxReq
+    public AmTxReq,
+    public PooledObject<CommitBlobTxReq>
 {
     /**
      * Request constructor. Some of the fields
@@ -13,7 +13,7 @@
 namespace fds
 {
 
-struct GetBlobReq: public AmMultiReq {
+struct GetBlobReq: public AmMultiReq, public PooledObject<GetBlobReq> {
     fds_bool_t get_metadata;
 
     fds_bool_t metadata_cached;
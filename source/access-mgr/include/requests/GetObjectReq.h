@@ -15,7 +15,7 @@ namespace fds
 
 struct GetBlobReq;
 
-struct GetObjectReq: public AmRequest {
+struct GetObjectReq: public AmRequest, public PooledObject<GetObjectReq> {
     using buffer_type = boost::shared_ptr<std::string>;
 
     // ID for object
@@ -14,7 +14,8 @@ namespace fds
 
 struct PutBlobReq
     :   public AmMultiReq,
-        public AmTxReq
+        public AmTxReq,
+        public PooledObject<PutBlobReq>
 {
     // Calculated object id
     ObjectID obj_id;
@@ -13,7 +13,7 @@
 namespace fds
 {
 
-struct PutObjectReq: public AmRequest {
+struct PutObjectReq: public AmRequest, public PooledObject<PutObjectReq> {
     using buffer_type = boost::shared_ptr<std::string>;
 
     // ID for object
@@ -14,7 +14,8 @@ namespace fds
 
 struct StartBlobTxReq : 
     public AmRequest,
-    public AmTxReq
+    public AmTxReq,
+    public PooledObject<StartBlobTxReq>
 {
     fds_int32_t     blob_mode;
 
@@ -12,7 +12,7 @@
 namespace fds
 {
 
-class StatBlobReq : public AmRequest {
+class StatBlobReq : public AmRequest, public PooledObject<StatBlobReq> {
   public:
     /**
      * Request constructor. Some of the fields
@@ -15,7 +15,8 @@ namespace fds
 {
 
 struct UpdateCatalogReq: public AmRequest,
-                         public AmTxReq
+                         public AmTxReq,
+                         public PooledObject<UpdateCatalogReq>
 {
     using buffer_type = boost::shared_ptr<std::string>;
 
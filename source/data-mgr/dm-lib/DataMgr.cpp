@@ -1236,6 +1236,7 @@ void DataMgr::mod_enable_service() {
                                                              *this));
 
     LOGNORMAL << "Finished timevolCat creation";
+    refCountMgr->registerObjectRefTracking();
 
     // create stats aggregator that aggregates stats for vols for which
     // this DM is primary
@@ -2082,6 +2083,7 @@ DataMgr::dmQosCtrl::dmQosCtrl(DataMgr *_parent,
                                       parentDm->qosOutstandingTasks,
                                       false,
                                       log);
+    dispatcher->loadCostModel("fds.dm.qos.");
     serialExecutor = std::unique_ptr<SynchronizedTaskExecutor<size_t>>(
         new SynchronizedTaskExecutor<size_t>(*threadPool));
     if (parentDm->getModuleProvider()->get_cntrs_mgr()) {
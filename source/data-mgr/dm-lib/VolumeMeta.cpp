@@ -14,9 +14,11 @@
 #include <dmhandler.h>
 #include <json/json.h>
 #include <ObjectId.h>
+#include <catalogKeys/BlobExtentKey.h>
 #include <catalogKeys/BlobObjectKey.h>
 #include <catalogKeys/BlobMetadataKey.h>
 #include <catalogKeys/VolumeMetadataKey.h>
+#include <dm-vol-cat/DmExtentPage.h>
 
 namespace fds {
 
@@ -669,14 +671,27 @@ VolumeMeta::HashCalcContext::hashThisSlice(CatalogKVPair &pair) {
         }
         case CatalogKeyType::BLOB_OBJECTS:
         {
-            BlobObjectKey key {pair.first};
-            auto keyString = key.toString();
-            hasher.update(reinterpret_cast<const unsigned char *>(keyString.c_str()),
-                          keyString.size());
-            ObjectID value {pair.second.ToString()};
-            auto valueString = value.ToString();
-            hasher.update(reinterpret_cast<const unsigned char *>(valueString.c_str()),
-                          valueString.size());
+            hashObject(BlobObjectKey {pair.first}, ObjectID {pair.second.ToString()});
+            break;
+        }
+        case CatalogKeyType::BLOB_EXTENTS:
+        {
+            // Replicas may store the same volume in either layout, hash the
+            // objects a page holds as the object key layout would store them.
+            // Both sort after the blob metadata keys and by blob and offset.
+            BlobExtentKey key {pair.first};
+            DmExtentPage page;
+            Error err = page.loadSerialized(pair.second.data(), pair.second.size());
+            if (!err.ok()) {
+                LOGERROR << "Failed to load extent page " << key.getPageIndex()
+                         << " of blob " << key.getBlobName() << ": " << err;
+                contextErr = err;
+                break;
+            }
+            fds_uint32_t firstIndex = key.getPageIndex() * DmExtentPage::OBJECTS_PER_PAGE;
+            page.forEachObject([this, &key, firstIndex](fds_uint32_t slot, const ObjectID& obj) {
+                hashObject(BlobObjectKey {key.getBlobName(), firstIndex + slot}, obj);
+            });
             break;
         }
         case CatalogKeyType::VOLUME_METADATA:
@@ -693,6 +708,16 @@ VolumeMeta::HashCalcContext::hashThisSlice(CatalogKVPair &pair) {
     }
 }
 
+void
+VolumeMeta::HashCalcContext::hashObject(const BlobObjectKey& key, const ObjectID& obj) {
+    auto keyString = key.toString();
+    hasher.update(reinterpret_cast<const unsigned char *>(keyString.c_str()),
+                  keyString.size());
+    auto valueString = obj.ToString();
+    hasher.update(reinterpret_cast<const unsigned char *>(valueString.c_str()),
+                  valueString.size());
+}
+
 void
 VolumeMeta::HashCalcContext::computeCompleteHash() {
     hasher.final(hashResult);
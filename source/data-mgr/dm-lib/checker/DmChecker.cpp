@@ -3,8 +3,10 @@
 
 // Standard includes.
 #include <list>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 // System includes.
@@ -12,6 +14,7 @@
 #include <sys/stat.h>
 
 // Internal includes.
+#include "catalogKeys/BlobExtentKey.h"
 #include "catalogKeys/BlobMetadataKey.h"
 #include "catalogKeys/BlobObjectKey.h"
 #include "catalogKeys/CatalogKeyType.h"
@@ -19,6 +22,7 @@
 #include "catalogKeys/ObjectRankKey.h"
 #include <net/PlatNetSvcHandler.h>
 #include "checker/LeveldbDiffer.h"
+#include "dm-vol-cat/DmExtentPage.h"
 #include "dm-vol-cat/DmPersistVolDB.h"
 #include "fdsp/common_constants.h"
 #include "fdsp/ConfigurationService.h"
@@ -90,6 +94,128 @@ std::string DMOfflineCheckerEnv::getCatalogPath(const fds_volid_t &volId,
 
 }
 
+/**
+* @brief Presents a volume catalog in the object key layout.  The objects of
+* every BLOB_EXTENTS page come out as the BLOB_OBJECTS entries that layout
+* would hold for them, merged in key order with the other entries, the same
+* way VolumeMeta::HashCalcContext::hashThisSlice() sees them.  Replicas of one
+* volume may use either layout.
+* Only forward iteration from the start is supported, that is all the differ does.
+*/
+class ObjectKeyLayoutIterator : public leveldb::Iterator {
+ public:
+    ObjectKeyLayoutIterator(leveldb::DB *db, const leveldb::Comparator *cmp)
+        : rest(db->NewIterator(leveldb::ReadOptions())),
+          pages(db->NewIterator(leveldb::ReadOptions())),
+          cmp(cmp),
+          pageIdx(0),
+          restCurrent(true) {
+    }
+
+    bool Valid() const override {
+        return rest->Valid() || pageValid();
+    }
+
+    void SeekToFirst() override {
+        rest->SeekToFirst();
+        skipExtents();
+        pages->Seek(static_cast<leveldb::Slice>(BlobExtentKey(std::string())));
+        loadPage();
+        pick();
+    }
+
+    void SeekToLast() override {
+        throw std::runtime_error("Object key layout iterator only goes forward.");
+    }
+
+    void Seek(const leveldb::Slice&) override {
+        throw std::runtime_error("Object key layout iterator only goes forward.");
+    }
+
+    void Prev() override {
+        throw std::runtime_error("Object key layout iterator only goes forward.");
+    }
+
+    void Next() override {
+        if (restCurrent) {
+            rest->Next();
+            skipExtents();
+        } else if (++pageIdx == pageEntries.size()) {
+            loadPage();
+        }
+        pick();
+    }
+
+    leveldb::Slice key() const override {
+        return restCurrent ? rest->key() : leveldb::Slice(pageEntries[pageIdx].first);
+    }
+
+    leveldb::Slice value() const override {
+        return restCurrent ? rest->value() : leveldb::Slice(pageEntries[pageIdx].second);
+    }
+
+    leveldb::Status status() const override {
+        return rest->status().ok() ? pages->status() : rest->status();
+    }
+
+ private:
+    static bool isExtentPage(const leveldb::Slice &key) {
+        return *reinterpret_cast<CatalogKeyType const*>(key.data())
+               == CatalogKeyType::BLOB_EXTENTS;
+    }
+
+    bool pageValid() const {
+        return pageIdx < pageEntries.size();
+    }
+
+    void skipExtents() {
+        while (rest->Valid() && isExtentPage(rest->key())) {
+            rest->Next();
+        }
+    }
+
+    /* Expands the next page with objects */
+    void loadPage() {
+        pageEntries.clear();
+        pageIdx = 0;
+        for (; pageEntries.empty() && pages->Valid() && isExtentPage(pages->key());
+             pages->Next()) {
+            BlobExtentKey key {pages->key()};
+            DmExtentPage page;
+            if (!page.loadSerialized(pages->value().data(), pages->value().size()).ok()) {
+                /* Left as is, so it shows up as a mismatch */
+                pageEntries.emplace_back(pages->key().ToString(), pages->value().ToString());
+                continue;
+            }
+            fds_uint32_t firstIndex = key.getPageIndex() * DmExtentPage::OBJECTS_PER_PAGE;
+            page.forEachObject([this, &key, firstIndex](fds_uint32_t slot, const ObjectID &obj) {
+                BlobObjectKey objKey {key.getBlobName(), firstIndex + slot};
+                pageEntries.emplace_back(static_cast<leveldb::Slice>(objKey).ToString(),
+                                         std::string(reinterpret_cast<const char*>(obj.GetId()),
+                                                     obj.GetLen()));
+            });
+        }
+    }
+
+    void pick() {
+        if (!rest->Valid()) {
+            restCurrent = false;
+        } else if (!pageValid()) {
+            restCurrent = true;
+        } else {
+            leveldb::Slice pageKey {pageEntries[pageIdx].first};
+            restCurrent = cmp->Compare(rest->key(), pageKey) <= 0;
+        }
+    }
+
+    std::unique_ptr<leveldb::Iterator> rest;
+    std::unique_ptr<leveldb::Iterator> pages;
+    const leveldb::Comparator *cmp;
+    std::vector<std::pair<std::string, std::string>> pageEntries;
+    size_t pageIdx;
+    bool restCurrent;
+};
+
 /**
 * @brief Level db adpater specific to DmPersistVolDB used in diffing.
 * @see LevelDbDiffAdapter
@@ -153,6 +279,7 @@ struct DmPersistVolDBDiffAdapter : LevelDbDiffAdapter {
         case CatalogKeyType::BLOB_METADATA: return BlobMetadataKey{ itr->key() }.toString();
         case CatalogKeyType::JOURNAL_TIMESTAMP: return "JOURNAL_TIMESTAMP";
         case CatalogKeyType::BLOB_OBJECTS: return BlobObjectKey{ itr->key() }.toString();
+        case CatalogKeyType::BLOB_EXTENTS: return BlobExtentKey{ itr->key() }.toString();
         case CatalogKeyType::VOLUME_METADATA: return "VOLUME_METADATA";
         case CatalogKeyType::OBJECT_EXPUNGE: return ObjectExpungeKey{ itr->key() }.toString();
         case CatalogKeyType::OBJECT_RANK: return ObjectRankKey{ itr->key() }.toString();
@@ -168,6 +295,11 @@ struct DmPersistVolDBDiffAdapter : LevelDbDiffAdapter {
         return &comparator;
     }
 
+    /* Replicas may use different catalog layouts, compare them object by object */
+    leveldb::Iterator* newIterator(leveldb::DB *db) override {
+        return new ObjectKeyLayoutIterator(db, &comparator);
+    }
+
     static bool isTimestampEntry(leveldb::Iterator *itr) {
         return *reinterpret_cast<CatalogKeyType const*>(itr->key().data())
                == CatalogKeyType::JOURNAL_TIMESTAMP;
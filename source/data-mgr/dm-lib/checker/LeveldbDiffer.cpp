@@ -15,17 +15,20 @@ LevelDbDiffer::LevelDbDiffer(const std::string &path1, const std::string &path2,
     this->adapter = adapter;
 
     db1 = openDb_(path1);
-    itr1 = db1->NewIterator(leveldb::ReadOptions());
+    itr1 = adapter->newIterator(db1);
     itr1->SeekToFirst();
 
     db2 = openDb_(path2);
-    itr2 = db2->NewIterator(leveldb::ReadOptions());
+    itr2 = adapter->newIterator(db2);
     itr2->SeekToFirst();
 
     diffDone = false;
 }
 
 LevelDbDiffer::~LevelDbDiffer() {
+    /* Iterators must go before their db */
+    delete itr1;
+    delete itr2;
     if (db1) {
         delete db1;
         db1 = nullptr;
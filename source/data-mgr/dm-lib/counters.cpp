@@ -12,6 +12,8 @@ Counters::Counters(const std::string &id, FdsCountersMgr *mgr)
               refscanNumObjects("dm.refscan.num_objects", this),
               refscanLastRun("dm.refscan.lastrun.timestamp", this),
               refscanRunCount("dm.refscan.run.count", this),
+              refscanIncrRunCount("dm.refscan.incremental.run.count", this),
+              refscanIncrInvalidations("dm.refscan.incremental.invalidations", this),
 
               migrationLastRun("dm.migration.lastrun.timestamp", this),
               migrationDMTVersion("dm.migration.dmt.version", this),
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <cstring>
+#include <string>
+
+#include <fds_assert.h>
+#include <dm-vol-cat/DmExtentPage.h>
+
+namespace fds {
+
+/*
+ * Serialized page: a version byte, then runs in slot order. A run is
+ *   first slot (u16) | count (u16) | type (u8) | digests
+ * with count digests for RUN_OBJECTS and one for RUN_REPEAT.
+ */
+static const size_t RUN_HEADER_LEN = 2 * sizeof(fds_uint16_t) + sizeof(fds_uint8_t);
+
+Error DmExtentPage::loadSerialized(const char *data, size_t len) {
+    written_.reset();
+    if (len < sizeof(VERSION) || VERSION != static_cast<fds_uint8_t>(data[0])) {
+        return ERR_SERIALIZE_FAILED;
+    }
+
+    size_t pos = sizeof(VERSION);
+    while (pos < len) {
+        if (len - pos < RUN_HEADER_LEN) {
+            return ERR_SERIALIZE_FAILED;
+        }
+        fds_uint16_t first, count;
+        memcpy(&first, data + pos, sizeof(first));
+        memcpy(&count, data + pos + sizeof(first), sizeof(count));
+        fds_uint8_t type = static_cast<fds_uint8_t>(data[pos + 2 * sizeof(fds_uint16_t)]);
+        pos += RUN_HEADER_LEN;
+
+        if (0 == count || static_cast<fds_uint32_t>(first) + count > OBJECTS_PER_PAGE) {
+            return ERR_SERIALIZE_FAILED;
+        }
+        fds_uint8_t *dest = digests_ + first * OBJECTID_DIGESTLEN;
+        if (RUN_OBJECTS == type) {
+            size_t runLen = count * OBJECTID_DIGESTLEN;
+            if (len - pos < runLen) {
+                return ERR_SERIALIZE_FAILED;
+            }
+            memcpy(dest, data + pos, runLen);
+            pos += runLen;
+        } else if (RUN_REPEAT == type) {
+            if (len - pos < OBJECTID_DIGESTLEN) {
+                return ERR_SERIALIZE_FAILED;
+            }
+            for (fds_uint32_t i = 0; i < count; ++i) {
+                memcpy(dest + i * OBJECTID_DIGESTLEN, data + pos, OBJECTID_DIGESTLEN);
+            }
+            pos += OBJECTID_DIGESTLEN;
+        } else {
+            return ERR_SERIALIZE_FAILED;
+        }
+        for (fds_uint32_t i = first; i < static_cast<fds_uint32_t>(first) + count; ++i) {
+            written_.set(i);
+        }
+    }
+    return ERR_OK;
+}
+
+void DmExtentPage::putRun(std::string & buf, fds_uint32_t first, fds_uint32_t count,
+                          RunType type) const {
+    fds_uint16_t first16 = first, count16 = count;
+    buf.append(reinterpret_cast<const char *>(&first16), sizeof(first16));
+    buf.append(reinterpret_cast<const char *>(&count16), sizeof(count16));
+    buf.push_back(static_cast<char>(type));
+    buf.append(reinterpret_cast<const char *>(digest(first)),
+               (RUN_REPEAT == type ? 1 : count) * OBJECTID_DIGESTLEN);
+}
+
+void DmExtentPage::getSerialized(std::string & buf) const {
+    buf.clear();
+    buf.reserve(sizeof(VERSION) + RUN_HEADER_LEN + size() * OBJECTID_DIGESTLEN);
+    buf.push_back(static_cast<char>(VERSION));
+
+    fds_uint32_t slot = 0;
+    while (slot < OBJECTS_PER_PAGE) {
+        if (!written_.test(slot)) {
+            ++slot;
+            continue;
+        }
+        // Split the written range starting at slot into runs of distinct
+        // objects and runs of one repeated object
+        fds_uint32_t runStart = slot;
+        while (slot < OBJECTS_PER_PAGE && written_.test(slot)) {
+            fds_uint32_t repeatEnd = slot + 1;
+            while (repeatEnd < OBJECTS_PER_PAGE && written_.test(repeatEnd) &&
+                   sameObject(slot, repeatEnd)) {
+                ++repeatEnd;
+            }
+            if (repeatEnd - slot < MIN_REPEAT) {
+                slot = repeatEnd;
+                continue;
+            }
+            if (runStart < slot) {
+                putRun(buf, runStart, slot - runStart, RUN_OBJECTS);
+            }
+            putRun(buf, slot, repeatEnd - slot, RUN_REPEAT);
+            slot = runStart = repeatEnd;
+        }
+        if (runStart < slot) {
+            putRun(buf, runStart, slot - runStart, RUN_OBJECTS);
+        }
+    }
+}
+
+fds_bool_t DmExtentPage::sameObject(fds_uint32_t lhs, fds_uint32_t rhs) const {
+    return 0 == memcmp(digest(lhs), digest(rhs), OBJECTID_DIGESTLEN);
+}
+
+fds_bool_t DmExtentPage::getObject(fds_uint32_t slot, ObjectID & obj) const {
+    fds_assert(slot < OBJECTS_PER_PAGE);
+    if (!written_.test(slot)) {
+        return false;
+    }
+    obj.SetId(reinterpret_cast<const char *>(digest(slot)), OBJECTID_DIGESTLEN);
+    return true;
+}
+
+void DmExtentPage::putObject(fds_uint32_t slot, const ObjectID & obj) {
+    fds_assert(slot < OBJECTS_PER_PAGE);
+    memcpy(digests_ + slot * OBJECTID_DIGESTLEN, obj.GetId(), OBJECTID_DIGESTLEN);
+    written_.set(slot);
+}
+
+void DmExtentPage::deleteObjects(fds_uint32_t first, fds_uint32_t last) {
+    fds_assert(first <= last && last < OBJECTS_PER_PAGE);
+    for (fds_uint32_t slot = first; slot <= last; ++slot) {
+        written_.reset(slot);
+    }
+}
+
+void DmExtentPage::forEachObject(std::function<void(fds_uint32_t, const ObjectID &)> func,
+                                 fds_uint32_t first, fds_uint32_t last) const {
+    ObjectID obj;
+    for (fds_uint32_t slot = first; slot <= last && slot < OBJECTS_PER_PAGE; ++slot) {
+        if (written_.test(slot)) {
+            obj.SetId(reinterpret_cast<const char *>(digest(slot)), OBJECTID_DIGESTLEN);
+            func(slot, obj);
+        }
+    }
+}
+
+}  // namespace fds
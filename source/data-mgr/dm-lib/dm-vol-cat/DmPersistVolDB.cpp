@@ -3,11 +3,14 @@
  */
 
 // Standard includes.
+#include <catalogKeys/BlobExtentKey.h>
 #include <catalogKeys/BlobMetadataKey.h>
 #include <catalogKeys/BlobObjectKey.h>
 #include <catalogKeys/VolumeMetadataKey.h>
+#include <algorithm>
 #include <limits>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -37,6 +40,12 @@ const std::string DmPersistVolDB::CATALOG_WRITE_BUFFER_SIZE_STR("catalog_write_b
 const std::string DmPersistVolDB::CATALOG_CACHE_SIZE_STR("catalog_cache_size");
 const std::string DmPersistVolDB::CATALOG_MAX_LOG_FILES_STR("catalog_max_log_files");
 const std::string DmPersistVolDB::ENABLE_TIMELINE_STR("enable_timeline");
+const std::string DmPersistVolDB::CATALOG_EXTENT_MAP_STR("catalog_extent_map");
+const std::string DmPersistVolDB::CATALOG_SHARED_RESOURCES_STR("catalog_shared_resources");
+const std::string DmPersistVolDB::CATALOG_SHARED_CACHE_SIZE_STR("catalog_shared_cache_size");
+const std::string DmPersistVolDB::CATALOG_WRITE_BUFFER_BUDGET_STR("catalog_write_buffer_budget");
+const std::string DmPersistVolDB::CATALOG_MAX_OPEN_FILES_STR("catalog_max_open_files");
+const std::string DmPersistVolDB::CATALOG_SHARED_STORE_STR("catalog_shared_store");
 
 Error status2error(leveldb::Status s){
     if (s.ok()) {
@@ -52,8 +61,75 @@ Error status2error(leveldb::Status s){
     return ERR_INVALID;
 }
 
+namespace {
+
+fds_bool_t hasKeys(Catalog & catalog, const CatalogKey & firstKey) {
+    auto dbIt = catalog.NewIterator();
+    dbIt->Seek(static_cast<leveldb::Slice>(firstKey));
+    return dbIt->Valid() &&
+            *reinterpret_cast<CatalogKeyType const*>(dbIt->key().data()) == firstKey.getKeyType();
+}
+
+/**
+ * Writes the page to the batch, a page with no objects left is deleted
+ */
+void putExtentPage(CatWriteBatch & batch, const BlobExtentKey & key, const DmExtentPage & page) {
+    if (page.empty()) {
+        batch.Delete(static_cast<leveldb::Slice>(key));
+    } else {
+        std::string value;
+        page.getSerialized(value);
+        batch.Put(static_cast<leveldb::Slice>(key), value);
+    }
+}
+
+/**
+ * Splits a write batch with one key per object offset (as built by the commit
+ * log) into its object offset updates and everything else
+ */
+class ObjectBatchSplitter : public leveldb::WriteBatch::Handler {
+  public:
+    explicit ObjectBatchSplitter(CatWriteBatch & rest) : rest_(rest) {}
+
+    void Put(const leveldb::Slice & key, const leveldb::Slice & value) override {
+        if (*reinterpret_cast<CatalogKeyType const*>(key.data()) != CatalogKeyType::BLOB_OBJECTS) {
+            rest_.Put(key, value);
+            return;
+        }
+        BlobObjectKey const objKey {key};
+        puts[objKey.getObjectIndex()].SetId(value.data(), value.size());
+        deletes.erase(objKey.getObjectIndex());
+    }
+
+    void Delete(const leveldb::Slice & key) override {
+        if (*reinterpret_cast<CatalogKeyType const*>(key.data()) != CatalogKeyType::BLOB_OBJECTS) {
+            rest_.Delete(key);
+            return;
+        }
+        BlobObjectKey const objKey {key};
+        puts.erase(objKey.getObjectIndex());
+        deletes.insert(objKey.getObjectIndex());
+    }
+
+    std::map<fds_uint32_t, ObjectID> puts;
+    std::set<fds_uint32_t> deletes;
+
+  private:
+    CatWriteBatch & rest_;
+};
+
+}  // namespace
+
 
 DmPersistVolDB::~DmPersistVolDB() {
+    // Again, in case writes still in flight landed after markDeleted()
+    if (deleted_ && catalog_ && catalog_->IsShared()) {
+        Error err = catalog_->DeleteAll();
+        if (!err.ok()) {
+            LOGERROR << "vol:" << volId_ << " failed to delete its keys from the shared catalog store: "
+                     << err;
+        }
+    }
     catalog_.reset();
     if (deleted_) {
         const FdsRootDir* root = MODULEPROVIDER()->proc_fdsroot();
@@ -68,6 +144,78 @@ uint64_t DmPersistVolDB::getNumInMemorySnapshots() {
     return snapshotCount.load(std::memory_order_relaxed);
 }
 
+CatalogResources* DmPersistVolDB::catalogResources_() {
+    // Never freed, catalogs may still be closing when static objects are destroyed
+    static CatalogResources* resources = new CatalogResources(
+            configHelper_.get<fds_uint64_t>(CATALOG_SHARED_CACHE_SIZE_STR, 256 * 1024 * 1024),
+            configHelper_.get<fds_uint64_t>(CATALOG_WRITE_BUFFER_BUDGET_STR, 256 * 1024 * 1024),
+            configHelper_.get<fds_uint32_t>(CATALOG_MAX_OPEN_FILES_STR, 64));
+    return resources;
+}
+
+CatalogResources* DmPersistVolDB::sharedResources_() {
+    if (!configHelper_.get<bool>(CATALOG_SHARED_RESOURCES_STR, false)) {
+        return nullptr;
+    }
+    return catalogResources_();
+}
+
+SharedCatalogStore* DmPersistVolDB::sharedStore_() {
+    if (!configHelper_.get<bool>(CATALOG_SHARED_STORE_STR, false)) {
+        return nullptr;
+    }
+    // Never freed, like the resources it uses
+    static SharedCatalogStore* store = [this]() {
+        auto opened = new SharedCatalogStore(
+                MODULEPROVIDER()->proc_fdsroot()->dir_sys_repo_dm() + "shared_vcat.ldb",
+                *catalogResources_(),
+                configHelper_.get<fds_uint32_t>(CATALOG_WRITE_BUFFER_SIZE_STR,
+                                                Catalog::WRITE_BUFFER_SIZE));
+        sweepSharedStore_(*opened);
+        return opened;
+    }();
+    return store;
+}
+
+void DmPersistVolDB::sweepSharedStore_(SharedCatalogStore& store) {
+    std::vector<fds_uint64_t> volumes;
+    Error err = store.volumes(volumes);
+    if (!err.ok()) {
+        LOGERROR << "unable to list the volumes in the shared catalog store: " << err;
+        return;
+    }
+
+    // Volumes and clones are in the sys repo, snapshots under their volume in the user repo
+    const FdsRootDir* root = MODULEPROVIDER()->proc_fdsroot();
+    std::set<fds_uint64_t> catalogs;
+    std::vector<fds_volid_t> volIds;
+    dmutil::getVolumeIds(root, volIds);
+    for (auto const& volId : volIds) {
+        if (util::dirExists(dmutil::getLevelDBFile(root, volId))) {
+            catalogs.insert(volId.get());
+        }
+    }
+    std::vector<std::string> srcNames;
+    util::getSubDirectories(root->dir_user_repo_dm(), srcNames);
+    for (auto const& srcName : srcNames) {
+        fds_volid_t srcVolId(std::atoll(srcName.c_str()));
+        std::vector<std::string> snapNames;
+        util::getSubDirectories(dmutil::getSnapshotDir(root, srcVolId), snapNames);
+        for (auto const& snapName : snapNames) {
+            catalogs.insert(std::atoll(snapName.c_str()));
+        }
+    }
+
+    for (auto volume : volumes) {
+        if (catalogs.count(volume)) {
+            continue;
+        }
+        err = store.deleteRange(volume);
+        LOGNOTIFY << "vol:" << volume << " deleted orphaned keys from the shared catalog store: "
+                  << err;
+    }
+}
+
 Error DmPersistVolDB::activate() {
     const FdsRootDir* root = MODULEPROVIDER()->proc_fdsroot();
     std::string catName(snapshot_ ? root->dir_user_repo_dm() : root->dir_sys_repo_dm());
@@ -111,14 +259,25 @@ Error DmPersistVolDB::activate() {
 
     try
     {
-        catalog_.reset(new Catalog(catName,
-                                   writeBufferSize,
-                                   cacheSize,
-                                   logDirName,
-                                   logFilePrefix,
-                                   maxLogFiles,
-                                   archiveLogs_,
-                                   &cmp_));
+        SharedCatalogStore* store = sharedStore_();
+        if (store) {
+            if (archiveLogs_) {
+                LOGWARN << "vol:" << volId_ << " has no catalog journals for the timeline"
+                        << " in the shared catalog store";
+            }
+            // catName only marks that the volume's catalog exists
+            catalog_.reset(new Catalog(catName, *store, volId_.get()));
+        } else {
+            catalog_.reset(new Catalog(catName,
+                                       writeBufferSize,
+                                       cacheSize,
+                                       logDirName,
+                                       logFilePrefix,
+                                       maxLogFiles,
+                                       archiveLogs_,
+                                       &cmp_,
+                                       sharedResources_()));
+        }
     }
     catch(const CatalogException& e)
     {
@@ -133,6 +292,18 @@ Error DmPersistVolDB::activate() {
 
     catalog_->GetWriteOptions().sync = false;
 
+    // An existing catalog keeps the layout it was written with, a new
+    // one uses the extent map if it is a block volume's
+    if (hasKeys(*catalog_, BlobExtentKey(std::string()))) {
+        extentMap_ = true;
+    } else if (hasKeys(*catalog_, BlobObjectKey(std::string()))) {
+        extentMap_ = false;
+    } else {
+        extentMap_ = (fpi::FDSP_VOL_BLKDEV_TYPE == volType_ || fpi::FDSP_VOL_ISCSI_TYPE == volType_) &&
+                configHelper_.get<bool>(CATALOG_EXTENT_MAP_STR, false);
+    }
+    LOGDEBUG << "vol:" << volId_ << (extentMap_ ? " extent map" : " object key") << " layout";
+
     // Write out the initial superblock descriptor into the volume
     fpi::FDSP_MetaDataList emptyMetadataList;
     VolumeMetaDesc volMetaDesc(emptyMetadataList, 0);
@@ -144,7 +315,24 @@ Error DmPersistVolDB::activate() {
     return ERR_OK;
 }
 
-Error DmPersistVolDB::copyVolDir(const std::string & destName) {
+Error DmPersistVolDB::markDeleted() {
+    Error err = DmPersistVolCat::markDeleted();
+    if (err.ok() && catalog_ && catalog_->IsShared()) {
+        err = catalog_->DeleteAll();
+        if (!err.ok()) {
+            LOGERROR << "vol:" << volId_ << " failed to delete its keys from the shared catalog store: "
+                     << err;
+        }
+    }
+    return err;
+}
+
+Error DmPersistVolDB::copyVolDir(const std::string & destName, fds_volid_t destVolId) {
+    if (catalog_->IsShared()) {
+        // The copy is in the shared store too, its directory marks it exists
+        FdsRootDir::fds_mkdir(destName.c_str());
+        return catalog_->CopyTo(destVolId.get());
+    }
     return catalog_->DbSnap(destName);
 }
 
@@ -387,6 +575,20 @@ Error DmPersistVolDB::getObject(const std::string & blobName, fds_uint64_t offse
     auto objectIndex = offset / objSize_;
     if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
+    if (extentMap_) {
+        DmExtentPage page;
+        Error rc = getExtentPage_(blobName, DmExtentPage::pageIndex(objectIndex), page);
+        if (rc.ok() && !page.getObject(DmExtentPage::pageSlot(objectIndex), obj)) {
+            rc = ERR_CAT_ENTRY_NOT_FOUND;
+        }
+        if (!rc.ok()) {
+            LOGNOTIFY << "Failed to get oid for offset: '" << std::hex << offset << std::dec
+                      << "' blob: '" << blobName << "' volume: '" << std::hex << volId_ <<
+                    std::dec << "'";
+        }
+        return rc;
+    }
+
     BlobObjectKey key {blobName, static_cast<fds_uint32_t>(objectIndex)};
 
     std::string value;
@@ -413,6 +615,18 @@ Error DmPersistVolDB::getObject(const std::string & blobName, fds_uint64_t start
     fds_uint32_t startObjIndex = startOffset / objSize_;
     fds_uint32_t endObjIndex = endOffset / objSize_;
 
+    if (extentMap_) {
+        return getExtents_(blobName, startObjIndex, endObjIndex, snap,
+                           [this, &objList](fds_uint32_t objectIndex, const ObjectID & obj) {
+            fpi::FDSP_BlobObjectInfo blobInfo;
+            blobInfo.offset = static_cast<fds_uint64_t>(objectIndex) * objSize_;
+            blobInfo.size = objSize_;
+            blobInfo.data_obj_id.digest.assign(reinterpret_cast<const char *>(obj.GetId()),
+                                               obj.GetLen());
+            objList.push_back(std::move(blobInfo));
+        });
+    }
+
     BlobObjectKey startKey {blobName, startObjIndex};
     BlobObjectKey endKey {blobName, endObjIndex};
     leveldb::Slice endSlice {static_cast<leveldb::Slice>(endKey)};
@@ -458,6 +672,16 @@ Error DmPersistVolDB::getObject(const std::string & blobName, fds_uint64_t start
     fds_uint32_t startObjIndex = startOffset / objSize_;
     fds_uint32_t endObjIndex = endOffset / objSize_;
 
+    if (extentMap_) {
+        return getExtents_(blobName, startObjIndex, endObjIndex, NULL,
+                           [this, &objList](fds_uint32_t objectIndex, const ObjectID & obj) {
+            BlobObjInfo blobInfo;
+            blobInfo.size = getObjSize();
+            blobInfo.oid = obj;
+            objList[static_cast<fds_uint64_t>(objectIndex) * objSize_] = blobInfo;
+        });
+    }
+
     BlobObjectKey startKey {blobName, startObjIndex};
     BlobObjectKey endKey {blobName, endObjIndex};
     leveldb::Slice endSlice {static_cast<leveldb::Slice>(endKey)};
@@ -532,6 +756,14 @@ Error DmPersistVolDB::putObject(const std::string & blobName, fds_uint64_t offse
     auto objectIndex = offset / objSize_;
     if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
+    if (extentMap_) {
+        CatWriteBatch batch;
+        TIMESTAMP_OP(batch);
+        fds_mutex::scoped_lock l(extentLock_);
+        Error rc = updateExtents_(blobName, {{static_cast<fds_uint32_t>(objectIndex), obj}}, {}, batch);
+        return rc.ok() ? catalog_->Update(&batch) : rc;
+    }
+
     BlobObjectKey key {blobName, static_cast<fds_uint32_t>(objectIndex)};
     leveldb::Slice const valRec(reinterpret_cast<char const*>(obj.GetId()), obj.GetLen());
 
@@ -553,12 +785,18 @@ Error DmPersistVolDB::putObject(const std::string & blobName, const BlobObjList
 
     CatWriteBatch batch;
     TIMESTAMP_OP(batch);
+    std::map<fds_uint32_t, ObjectID> extentPuts;
     for (auto & it : objs) {
         fds_verify(0 == it.first % objSize_);
 
         auto objectIndex = it.first / objSize_;
         if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
+        if (extentMap_) {
+            extentPuts[static_cast<fds_uint32_t>(objectIndex)] = it.second.oid;
+            continue;
+        }
+
         BlobObjectKey const key {blobName, static_cast<fds_uint32_t>(objectIndex)};
         leveldb::Slice const valRec(reinterpret_cast<const char *>(it.second.oid.GetId()),
                                     it.second.oid.GetLen());
@@ -566,7 +804,15 @@ Error DmPersistVolDB::putObject(const std::string & blobName, const BlobObjList
         batch.Put(static_cast<leveldb::Slice>(key), valRec);
     }
 
-    rc = catalog_->Update(&batch);
+    if (extentMap_) {
+        fds_mutex::scoped_lock l(extentLock_);
+        rc = updateExtents_(blobName, extentPuts, {}, batch);
+        if (rc.ok()) {
+            rc = catalog_->Update(&batch);
+        }
+    } else {
+        rc = catalog_->Update(&batch);
+    }
     if (!rc.ok()) {
         LOGERROR << "Failed to put blob: '" << blobName << "' volume: '" << std::hex
                  << volId_ << std::dec << "'";
@@ -581,6 +827,8 @@ Error DmPersistVolDB::putBatch(const std::string & blobName, const BlobMetaDesc
 
     CatWriteBatch batch;
     TIMESTAMP_OP(batch);
+    std::map<fds_uint32_t, ObjectID> extentPuts;
+    std::set<fds_uint32_t> extentDeletes;
 
     for (auto & it : puts) {
         fds_verify(0 == it.first % objSize_);
@@ -588,6 +836,11 @@ Error DmPersistVolDB::putBatch(const std::string & blobName, const BlobMetaDesc
         auto objectIndex = it.first / objSize_;
         if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
+        if (extentMap_) {
+            extentPuts[static_cast<fds_uint32_t>(objectIndex)] = it.second.oid;
+            continue;
+        }
+
         BlobObjectKey const key {blobName, static_cast<fds_uint32_t>(objectIndex)};
         leveldb::Slice const valRec(reinterpret_cast<const char *>(it.second.oid.GetId()),
                                     it.second.oid.GetLen());
@@ -601,6 +854,11 @@ Error DmPersistVolDB::putBatch(const std::string & blobName, const BlobMetaDesc
         auto objectIndex = it / objSize_;
         if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
+        if (extentMap_) {
+            extentDeletes.insert(static_cast<fds_uint32_t>(objectIndex));
+            continue;
+        }
+
         BlobObjectKey const key {blobName, static_cast<fds_uint32_t>(objectIndex)};
         batch.Delete(static_cast<leveldb::Slice>(key));
     }
@@ -616,7 +874,15 @@ Error DmPersistVolDB::putBatch(const std::string & blobName, const BlobMetaDesc
     }
 
     batch.Put(static_cast<leveldb::Slice>(key), value);
-    rc = catalog_->Update(&batch);
+    if (extentMap_) {
+        fds_mutex::scoped_lock l(extentLock_);
+        rc = updateExtents_(blobName, extentPuts, extentDeletes, batch);
+        if (rc.ok()) {
+            rc = catalog_->Update(&batch);
+        }
+    } else {
+        rc = catalog_->Update(&batch);
+    }
     if (!rc.ok()) {
         LOGERROR << "Failed to put blob: '" << blobName << "' volume: '" << std::hex
                  << volId_ << std::dec << "'";
@@ -642,7 +908,22 @@ Error DmPersistVolDB::putBatch(const std::string & blobName, const BlobMetaDesc
     }
 
     wb.Put(static_cast<leveldb::Slice>(key), value);
-    rc = catalog_->Update(&wb);
+    if (extentMap_) {
+        // Object offsets in the batch have a key each, move them to their pages
+        CatWriteBatch batch;
+        ObjectBatchSplitter splitter(batch);
+        leveldb::Status status = wb.Iterate(&splitter);
+        if (!status.ok()) {
+            return status2error(status);
+        }
+        fds_mutex::scoped_lock l(extentLock_);
+        rc = updateExtents_(blobName, splitter.puts, splitter.deletes, batch);
+        if (rc.ok()) {
+            rc = catalog_->Update(&batch);
+        }
+    } else {
+        rc = catalog_->Update(&wb);
+    }
     if (!rc.ok()) {
         LOGERROR << "Failed to put blob: '" << blobName << "' volume: '" << std::hex
                  << volId_ << std::dec << "'";
@@ -657,12 +938,20 @@ Error DmPersistVolDB::deleteObject(const std::string & blobName, fds_uint64_t of
     auto objectIndex = offset / objSize_;
     if (objectIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
 
-    BlobObjectKey const key {blobName, static_cast<fds_uint32_t>(objectIndex)};
-
     CatWriteBatch batch;
     TIMESTAMP_OP(batch);
-    batch.Delete(static_cast<leveldb::Slice>(key));
-    Error rc = catalog_->Update(&batch);
+    Error rc;
+    if (extentMap_) {
+        fds_mutex::scoped_lock l(extentLock_);
+        rc = updateExtents_(blobName, {}, {static_cast<fds_uint32_t>(objectIndex)}, batch);
+        if (rc.ok()) {
+            rc = catalog_->Update(&batch);
+        }
+    } else {
+        BlobObjectKey const key {blobName, static_cast<fds_uint32_t>(objectIndex)};
+        batch.Delete(static_cast<leveldb::Slice>(key));
+        rc = catalog_->Update(&batch);
+    }
     if (!rc.ok()) {
         LOGERROR << "Failed to delete object at offset '" << std::hex << offset << std::dec
                  << "' of a blob: '" << blobName << "' volume: '" << std::hex << volId_ <<
@@ -676,6 +965,14 @@ Error DmPersistVolDB::deleteObject(const std::string & blobName, fds_uint64_t st
     // commenting this out to support snapshot delete
     // IS_OP_ALLOWED();
 
+    if (extentMap_) {
+        auto startObjIndex = startOffset / objSize_;
+        if (startObjIndex > std::numeric_limits<fds_uint32_t>::max()) {return ERR_DM_OFFSET_OUT_RANGE;}
+        auto endObjIndex = std::min<fds_uint64_t>(endOffset / objSize_,
+                                                  std::numeric_limits<fds_uint32_t>::max());
+        return deleteExtents_(blobName, startObjIndex, endObjIndex);
+    }
+
     BlobObjectKey key {blobName};
     Error rc(ERR_OK);
 
@@ -818,6 +1115,25 @@ void DmPersistVolDB::forEachObject(std::function<void(const ObjectID&)> func) {
     Error err;
     ObjectID objId;
     fds_assert(dbIt);
+    if (extentMap_) {
+        DmExtentPage page;
+        for (dbIt->Seek(BlobExtentKey(std::string()));
+             dbIt->Valid()
+                     && *reinterpret_cast<CatalogKeyType const*>(dbIt->key().data())
+                     == CatalogKeyType::BLOB_EXTENTS;
+             dbIt->Next())
+        {
+            err = page.loadSerialized(dbIt->value().data(), dbIt->value().size());
+            if (!err.ok()) {
+                LOGERROR << "Corrupt extent page " << BlobExtentKey(dbIt->key()).toString()
+                         << " volume: " << volId_;
+                continue;
+            }
+            page.forEachObject([&func](fds_uint32_t, const ObjectID & obj) { func(obj); });
+        }
+        fds_assert(dbIt->status().ok());  // check for any errors during the scan
+        return;
+    }
     for (dbIt->Seek(BlobObjectKey(std::string()));
          dbIt->Valid()
                  && *reinterpret_cast<CatalogKeyType const*>(dbIt->key().data())
@@ -845,11 +1161,171 @@ void DmPersistVolDB::getObjectIds(const uint32_t &maxObjs,
         dbItr->SeekToFirst();
     }
 
+    DmExtentPage page;
     for (; dbItr->Valid() && objects.size() < maxObjs; dbItr->Next()) {
-        if (*reinterpret_cast<CatalogKeyType const*>(dbItr->key().data()) == CatalogKeyType::BLOB_OBJECTS) {
+        auto keyType = *reinterpret_cast<CatalogKeyType const*>(dbItr->key().data());
+        if (keyType == CatalogKeyType::BLOB_OBJECTS) {
             objects.push_back(ObjectID(dbItr->value().ToString()));
+        } else if (keyType == CatalogKeyType::BLOB_EXTENTS &&
+                   page.loadSerialized(dbItr->value().data(), dbItr->value().size()).ok()) {
+            // A page is taken whole, objects may go past maxObjs by less than a page
+            page.forEachObject([&objects](fds_uint32_t, const ObjectID & obj) {
+                objects.push_back(obj);
+            });
+        }
+    }
+}
+
+Error DmPersistVolDB::getExtentPage_(const std::string & blobName, fds_uint32_t pageIndex,
+                                     DmExtentPage & page, Catalog::MemSnap snap) {
+    BlobExtentKey const key {blobName, pageIndex};
+
+    std::string value;
+    Error rc = catalog_->Query(key, &value, snap);
+    if (rc.ok()) {
+        rc = page.loadSerialized(value.data(), value.size());
+        if (!rc.ok()) {
+            LOGERROR << "Corrupt extent page " << key.toString() << " volume: " << volId_;
+        }
+    }
+    return rc;
+}
+
+Error DmPersistVolDB::updateExtents_(const std::string & blobName,
+                                     const std::map<fds_uint32_t, ObjectID> & puts,
+                                     const std::set<fds_uint32_t> & deletes,
+                                     CatWriteBatch & batch) {
+    std::set<fds_uint32_t> pageIndexes;
+    for (auto & it : puts) {
+        pageIndexes.insert(DmExtentPage::pageIndex(it.first));
+    }
+    for (auto & it : deletes) {
+        pageIndexes.insert(DmExtentPage::pageIndex(it));
+    }
+
+    DmExtentPage page;
+    for (auto pageIndex : pageIndexes) {
+        Error rc = getExtentPage_(blobName, pageIndex, page);
+        if (ERR_CAT_ENTRY_NOT_FOUND == rc) {
+            page = DmExtentPage();
+        } else if (!rc.ok()) {
+            return rc;
+        }
+
+        // Same as a batch of per offset keys: deletes win over puts
+        fds_uint32_t const first = pageIndex * DmExtentPage::OBJECTS_PER_PAGE;
+        fds_uint64_t const end = static_cast<fds_uint64_t>(first) + DmExtentPage::OBJECTS_PER_PAGE;
+        for (auto it = puts.lower_bound(first); puts.end() != it && it->first < end; ++it) {
+            page.putObject(DmExtentPage::pageSlot(it->first), it->second);
+        }
+        for (auto it = deletes.lower_bound(first); deletes.end() != it && *it < end; ++it) {
+            page.deleteObjects(DmExtentPage::pageSlot(*it), DmExtentPage::pageSlot(*it));
+        }
+
+        putExtentPage(batch, BlobExtentKey(blobName, pageIndex), page);
+    }
+    return ERR_OK;
+}
+
+Error DmPersistVolDB::getExtents_(const std::string & blobName, fds_uint32_t startObjIndex,
+                                  fds_uint32_t endObjIndex, Catalog::MemSnap snap,
+                                  std::function<void(fds_uint32_t, const ObjectID &)> func) {
+    fds_uint32_t const startPage = DmExtentPage::pageIndex(startObjIndex);
+    fds_uint32_t const endPage = DmExtentPage::pageIndex(endObjIndex);
+
+    BlobExtentKey startKey {blobName, startPage};
+    BlobExtentKey endKey {blobName, endPage};
+    leveldb::Slice endSlice {static_cast<leveldb::Slice>(endKey)};
+
+    auto dbIt = catalog_->NewIterator(snap);
+
+    if (!dbIt) {
+        LOGERROR << "Error creating iterator for ldb on volume " << volId_;
+        return ERR_INVALID;
+    }
+
+    DmExtentPage page;
+    for (dbIt->Seek(static_cast<leveldb::Slice>(startKey));
+         dbIt->Valid()
+                 && catalog_->GetOptions().comparator->Compare(dbIt->key(), endSlice) <= 0;
+         dbIt->Next()) {
+        BlobExtentKey key { dbIt->key() };
+
+        Error rc = page.loadSerialized(dbIt->value().data(), dbIt->value().size());
+        if (!rc.ok()) {
+            LOGERROR << "Corrupt extent page " << key.toString() << " volume: " << volId_;
+            return rc;
         }
+
+        fds_uint32_t const pageIndex = key.getPageIndex();
+        fds_uint32_t const base = pageIndex * DmExtentPage::OBJECTS_PER_PAGE;
+        page.forEachObject([base, &func](fds_uint32_t slot, const ObjectID & obj) {
+                               func(base + slot, obj);
+                           },
+                           (pageIndex == startPage) ? DmExtentPage::pageSlot(startObjIndex) : 0,
+                           (pageIndex == endPage) ? DmExtentPage::pageSlot(endObjIndex)
+                                                  : DmExtentPage::OBJECTS_PER_PAGE - 1);
     }
+
+    if (!dbIt->status().ok()) {
+        LOGERROR << "Error getting offsets for blob " << blobName << " for volume " << volId_
+                 << " : " << dbIt->status().ToString();
+
+        return status2error(dbIt->status());
+    }
+
+    return ERR_OK;
+}
+
+Error DmPersistVolDB::deleteExtents_(const std::string & blobName, fds_uint32_t startObjIndex,
+                                     fds_uint32_t endObjIndex) {
+    fds_uint32_t const startPage = DmExtentPage::pageIndex(startObjIndex);
+    fds_uint32_t const endPage = DmExtentPage::pageIndex(endObjIndex);
+
+    // Only pages that exist need updating
+    std::vector<fds_uint32_t> pageIndexes;
+    {
+        BlobExtentKey startKey {blobName, startPage};
+        BlobExtentKey endKey {blobName, endPage};
+        leveldb::Slice endSlice {static_cast<leveldb::Slice>(endKey)};
+
+        auto dbIt = catalog_->NewIterator();
+        fds_assert(dbIt);
+        for (dbIt->Seek(static_cast<leveldb::Slice>(startKey));
+             dbIt->Valid()
+                     && catalog_->GetOptions().comparator->Compare(dbIt->key(), endSlice) <= 0;
+             dbIt->Next()) {
+            pageIndexes.push_back(BlobExtentKey(dbIt->key()).getPageIndex());
+        }
+    }
+
+    for (auto pageIndex : pageIndexes) {
+        // One batch per page, same as one per object offset with a key each
+        CatWriteBatch batch;
+        TIMESTAMP_OP(batch);
+
+        fds_mutex::scoped_lock l(extentLock_);
+        DmExtentPage page;
+        Error rc = getExtentPage_(blobName, pageIndex, page);
+        if (ERR_CAT_ENTRY_NOT_FOUND == rc) {
+            continue;
+        } else if (!rc.ok()) {
+            return rc;
+        }
+        page.deleteObjects((pageIndex == startPage) ? DmExtentPage::pageSlot(startObjIndex) : 0,
+                           (pageIndex == endPage) ? DmExtentPage::pageSlot(endObjIndex)
+                                                  : DmExtentPage::OBJECTS_PER_PAGE - 1);
+        putExtentPage(batch, BlobExtentKey(blobName, pageIndex), page);
+
+        rc = catalog_->Update(&batch);
+        if (!rc.ok()) {
+            LOGERROR << "Failed to delete object for blob: '" << blobName << "' volume: '"
+                     << std::hex << volId_ << std::dec << "'";
+            return rc;
+        }
+    }
+
+    return ERR_OK;
 }
 
 int32_t DmPersistVolDB::updateVersion()
@@ -93,7 +93,7 @@ Error DmPersistVolFile::activate() {
     return ERR_OK;
 }
 
-Error DmPersistVolFile::copyVolDir(const std::string & destName) {
+Error DmPersistVolFile::copyVolDir(const std::string & destName, fds_volid_t destVolId) {
     fds_assert(!destName.empty());
     FdsRootDir::fds_mkdir(destName.c_str());
 
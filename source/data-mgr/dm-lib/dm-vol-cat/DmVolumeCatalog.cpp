@@ -58,6 +58,7 @@ DmVolumeCatalog::DmVolumeCatalog(CommonModuleProviderIf* modProvider,
     : HasModuleProvider(modProvider),
       Module(name),
       expungeCb_(0),
+      objRefDeltaCb_(0),
       _ft_newStats { false }
 {
     _ft_newStats = CONFIG_BOOL("fds.feature_toggle.common.send_to_new_stats_service", true);
@@ -95,7 +96,8 @@ Error DmVolumeCatalog::addCatalog(const VolumeDesc & voldesc) {
                     voldesc.volUUID, voldesc.maxObjSizeInBytes,
                                      voldesc.isSnapshot(), voldesc.isSnapshot(), voldesc.isClone(),
                                      fArchiveLogs,
-                                     voldesc.isSnapshot() ? voldesc.srcVolumeId : invalid_vol_id));
+                                     voldesc.isSnapshot() ? voldesc.srcVolumeId : invalid_vol_id,
+                                     voldesc.volType));
     /*
     } else {
         vol.reset(new DmPersistVolFile(voldesc.volUUID, voldesc.maxObjSizeInBytes,
@@ -148,7 +150,7 @@ Error DmVolumeCatalog::copyVolume(const VolumeDesc & voldesc) {
     synchronized(volMapLock_) {
         voldir = volMap_[voldesc.srcVolumeId];
     }
-    Error rc = voldir->copyVolDir(copyDir);
+    Error rc = voldir->copyVolDir(copyDir, voldesc.volUUID);
 
     if (rc.ok()) {
         DmPersistVolCat::ptr vol;
@@ -161,7 +163,8 @@ Error DmVolumeCatalog::copyVolume(const VolumeDesc & voldesc) {
 
             vol.reset(new DmPersistVolDB(MODULEPROVIDER(),
                                          voldesc.volUUID, objSize, voldesc.isSnapshot(),
-                                         voldesc.isSnapshot(), voldesc.isClone(), fArchiveLogs, voldesc.srcVolumeId));
+                                         voldesc.isSnapshot(), voldesc.isClone(), fArchiveLogs, voldesc.srcVolumeId,
+                                         volType));
         /*
         } else {
             vol.reset(new DmPersistVolFile(voldesc.volUUID, objSize, voldesc.isSnapshot(),
@@ -169,8 +172,11 @@ Error DmVolumeCatalog::copyVolume(const VolumeDesc & voldesc) {
         }
         */
 
-        FDSGUARD(volMapLock_);
-        volMap_[voldesc.volUUID] = vol;
+        {
+            FDSGUARD(volMapLock_);
+            volMap_[voldesc.volUUID] = vol;
+        }
+        notifyBulkRefChange(voldesc.volUUID);
     }
 
     return rc;
@@ -201,6 +207,7 @@ Error DmVolumeCatalog::reloadCatalog(const VolumeDesc & voldesc) {
     rc = activateCatalog(voldesc.volUUID);
 
     if (rc.ok()) {
+        notifyBulkRefChange(voldesc.volUUID);
         /*
         GET_VOL(volId);
         vol->resetVolSummary();
@@ -222,6 +229,16 @@ void DmVolumeCatalog::registerExpungeObjectsCb(expunge_objs_cb_t cb) {
     expungeCb_ = cb;
 }
 
+void DmVolumeCatalog::registerObjectRefDeltaCb(objref_delta_cb_t cb) {
+    objRefDeltaCb_ = cb;
+}
+
+void DmVolumeCatalog::notifyBulkRefChange(fds_volid_t volId) {
+    if (objRefDeltaCb_) {
+        objRefDeltaCb_(volId, std::vector<ObjectID>(), std::vector<ObjectID>(), true);
+    }
+}
+
 Error DmVolumeCatalog::markVolumeDeleted(fds_volid_t volId) {
     LOGDEBUG << "Will mark volume '" << std::hex << volId << std::dec << "' as deleted";
 
@@ -838,7 +855,9 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
         return rc;
     }
 
-    // std::vector<ObjectID> expungeList;
+    // object references gained and lost by this update, reported to GC
+    std::vector<ObjectID> addedList;
+    std::vector<ObjectID> expungeList;
 
     BlobObjList::const_iter firstIter = blobObjList->begin();
     fds_verify(blobObjList->end() != firstIter);
@@ -870,6 +889,10 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
     }
 
     for (BlobObjList::const_iter cit = blobObjList->begin(); blobObjList->end() != cit; ++cit) {
+        if (objRefDeltaCb_ && NullObjectID != cit->second.oid) {
+            addedList.push_back(cit->second.oid);
+        }
+
         BlobObjList::iterator oldIter = oldBlobObjList.find(cit->first);
         if (oldBlobObjList.end() == oldIter) {
             // new offset, update blob size
@@ -882,7 +905,7 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
 
         if (NullObjectID != oldIter->second.oid) {
             // null object does not physically exist
-            // expungeList.push_back(oldIter->second.oid);
+            expungeList.push_back(oldIter->second.oid);
         }
 
         // if we are updating last offset, adjust blob size
@@ -937,7 +960,7 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
         for (auto & i : truncateObjList) {
             if (NullObjectID != i.second.oid) {
                 delOffsetList.push_back(i.first);
-                // expungeList.push_back(i.second.oid);
+                expungeList.push_back(i.second.oid);
                 bytesRemoved += (i.first == oldLastOffset) ? oldLastObjSize : i.second.size;  // Data Object size is *not* correct here for the last one. Surprise!
             }
         }
@@ -971,6 +994,11 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
         return rc;
     }
 
+    // references are committed, report them before anything else can fail
+    if (objRefDeltaCb_) {
+        objRefDeltaCb_(volId, addedList, expungeList, false);
+    }
+
     /**
      * We have a concern, before we apply these deltas, about whether the volume's
      * stat cache has been initialized (although given that AM must confirm that
@@ -1106,6 +1134,8 @@ Error DmVolumeCatalog::putBlob(fds_volid_t volId, const std::string& blobName,
                 << volId << std::dec << "' error: '" << rc << "'";
         return rc;
     }
+    // the write batch doesn't tell us which objects it references
+    notifyBulkRefChange(volId);
 
 
     /**
@@ -1208,6 +1238,9 @@ Error DmVolumeCatalog::deleteBlob(fds_volid_t volId, const std::string& blobName
     bool fIsSnapshot = vol->isSnapshot();
     rc = vol->deleteObject(blobName, 0, endOffset);
     if (rc.ok()) {
+        if (objRefDeltaCb_) {
+            objRefDeltaCb_(volId, std::vector<ObjectID>(), expungeList, false);
+        }
         rc = vol->deleteBlobMetaDesc(blobName);
         if (!rc.ok()) {
             LOGWARN << "Failed to delete metadata for blob: '" << blobName << "'";
@@ -1273,7 +1306,9 @@ Error DmVolumeCatalog::deleteBlob(fds_volid_t volId, const std::string& blobName
 
 Error DmVolumeCatalog::syncCatalog(fds_volid_t volId, const NodeUuid& dmUuid) {
     GET_VOL_N_CHECK_DELETED(volId);
-    return vol->syncCatalog(dmUuid);
+    Error rc = vol->syncCatalog(dmUuid);
+    notifyBulkRefChange(volId);
+    return rc;
 }
 
 Error DmVolumeCatalog::migrateDescriptor(fds_volid_t volId,
@@ -1415,7 +1450,9 @@ Error DmVolumeCatalog::putObject(fds_volid_t volId,
                                  const BlobObjList & objs)
 {
     GET_VOL_N_CHECK_DELETED(volId);
-    return vol->putObject(blobName, objs);
+    Error rc = vol->putObject(blobName, objs);
+    notifyBulkRefChange(volId);
+    return rc;
 }
 
 Error DmVolumeCatalog::getVolumeSnapshot(fds_volid_t volId, Catalog::MemSnap &snap) {
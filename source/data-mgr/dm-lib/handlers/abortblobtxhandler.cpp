@@ -34,7 +34,7 @@ void AbortBlobTxHandler::handleRequest(boost::shared_ptr<fpi::AsyncHdr>& asyncHd
 
     fds_volid_t volId(message->volume_id);
     auto err = preEnqueueWriteOpHandling(volId, message->opId,
-                                         asyncHdr, PlatNetSvcHandler::threadLocalPayloadBuf);
+                                         asyncHdr, PlatNetSvcHandler::getThreadLocalPayloadBuf());
     if (!err.OK())
     {
         handleResponse(asyncHdr, message, err, nullptr);
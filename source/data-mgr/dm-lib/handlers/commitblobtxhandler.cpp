@@ -39,7 +39,7 @@ void CommitBlobTxHandler::handleRequest(boost::shared_ptr<fpi::AsyncHdr>& asyncH
 
     fds_volid_t volId(message->volume_id);
     auto err = preEnqueueWriteOpHandling(volId, message->opId,
-                                         asyncHdr, PlatNetSvcHandler::threadLocalPayloadBuf);
+                                         asyncHdr, PlatNetSvcHandler::getThreadLocalPayloadBuf());
     if (!err.OK())
     {
         handleResponse(asyncHdr, message, err, nullptr);
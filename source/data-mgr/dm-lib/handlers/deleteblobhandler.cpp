@@ -29,7 +29,7 @@ void DeleteBlobHandler::handleRequest(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr
 
     fds_volid_t volId(message->volume_id);
     auto err = preEnqueueWriteOpHandling(volId, message->opId,
-                                         asyncHdr, PlatNetSvcHandler::threadLocalPayloadBuf);
+                                         asyncHdr, PlatNetSvcHandler::getThreadLocalPayloadBuf());
     if (!err.OK())
     {
         handleResponse(asyncHdr, message, err, nullptr);
@@ -33,7 +33,9 @@ QueueHelper::QueueHelper(DataMgr& dataManager, DmRequest *dmRequest)
           cancelled(false),
           skipImplicitCb(false),
           dataManager_(dataManager)
-{}
+{
+    StageTracer::record(dmRequest->traceId, TraceStage::DISK_IO_START, dmRequest->io_type);
+}
 
 QueueHelper::~QueueHelper() {
     if (!cancelled) {
@@ -47,6 +49,7 @@ QueueHelper::~QueueHelper() {
 
 void QueueHelper::markIoDone() {
     if (!ioIsMarkedAsDone) {
+        StageTracer::record(dmRequest->traceId, TraceStage::DISK_IO_END, dmRequest->io_type);
         if (dataManager_.features.isQosEnabled()) dataManager_.qosCtrl->markIODone(*dmRequest);
         ioIsMarkedAsDone = true;
     }
@@ -60,6 +60,9 @@ void QueryCatalogHandler::handleQueueItem(DmRequest* dmRequest) {
         reinterpret_cast<fds_uint64_t *>(&typedRequest->queryMsg->byteCount));
     if (!helper.err.ok() && ERR_BLOB_OFFSET_INVALID != helper.err) {
         PerfTracer::incr(typedRequest->opReqFailedPerfEventType, typedRequest->getVolId());
+    } else {
+        // Only known now, QoS charges for it when the IO is marked done
+        typedRequest->io_size = blobObjectListBytes(typedRequest->queryMsg->obj_list);
     }
 }
 
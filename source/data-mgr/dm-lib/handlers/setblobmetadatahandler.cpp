@@ -39,7 +39,7 @@ void SetBlobMetaDataHandler::handleRequest(boost::shared_ptr<fpi::AsyncHdr>& asy
     }
 
     fds_volid_t volId(message->volume_id);
-    auto err = preEnqueueWriteOpHandling(volId, message->opId, asyncHdr, PlatNetSvcHandler::threadLocalPayloadBuf);
+    auto err = preEnqueueWriteOpHandling(volId, message->opId, asyncHdr, PlatNetSvcHandler::getThreadLocalPayloadBuf());
     if (!err.OK())
     {
         handleResponse(asyncHdr, message, err, nullptr);
@@ -33,7 +33,7 @@ void SetVolumeMetadataHandler::handleRequest(
              << volId;
 
     auto err = preEnqueueWriteOpHandling(volId, message->opId,
-                                         asyncHdr, PlatNetSvcHandler::threadLocalPayloadBuf);
+                                         asyncHdr, PlatNetSvcHandler::getThreadLocalPayloadBuf());
     if (!err.OK())
     {
         handleResponse(asyncHdr, message, err, nullptr);
@@ -139,7 +139,13 @@ ObjectRefScanMgr::ObjectRefScanMgr(CommonModuleProviderIf *moduleProvider, DataM
           state(STOPPED),
           qosHelper(*dm),
           scanCntr(0),
-          objectsScannedCntr(0)
+          objectsScannedCntr(0),
+          incrementalEnabled(false),
+          fullScanIntervalSecs(0),
+          bfSize(1*MB),
+          refTrackState(REFTRACK_INVALID),
+          refTrackTokenBits(0),
+          lastFullScanTs(0)
 {
     LOGNORMAL << "instantiating";
 }
@@ -148,9 +154,15 @@ void ObjectRefScanMgr::mod_startup() {
     auto config = MODULEPROVIDER()->get_conf_helper();
 
     maxEntriesToScan = config.get<int>("objectrefscan.entries_per_scan", 32768);
+    bfSize = util::getBytesFromHumanSize(config.get<std::string>("objectrefscan.bf_size", "1M"));
+    incrementalEnabled = config.get<bool>("objectrefscan.incremental.enable", false);
+    fullScanIntervalSecs = 60 * 60 *
+            config.get<int>("objectrefscan.incremental.full_scan_interval_hours", 24);
 
     LOGNORMAL << "refscan enabled:" << (dataMgr->features.isExpungeEnabled()?"true":"false")
-              << " scancount:" << maxEntriesToScan;
+              << " scancount:" << maxEntriesToScan
+              << " incremental:" << incrementalEnabled
+              << " fullscan.interval.secs:" << fullScanIntervalSecs;
 
 }
 
@@ -173,6 +185,27 @@ void ObjectRefScanMgr::scanOnce() {
     qosHelper.addToQueue(req);
 }
 
+void ObjectRefScanMgr::incrementalScanOnce() {
+    auto expectedState = STOPPED;
+    bool wasStopped = state.compare_exchange_strong(expectedState, INIT);
+    if (!wasStopped) {
+        GLOGWARN << "ignoring incremental refscan request as scanner is already running";
+        return;
+    }
+
+    auto req = new DmFunctor(FdsDmSysTaskId,
+                             std::bind(&ObjectRefScanMgr::incrementalScanStep, this));
+    qosHelper.addToQueue(req);
+}
+
+bool ObjectRefScanMgr::isIncrementalScanPossible() {
+    if (!incrementalEnabled || refTrackState != REFTRACK_VALID) {
+        return false;
+    }
+    ReadGuard rg(refTrackLock);
+    return util::getTimeStampSeconds() - lastFullScanTs < fullScanIntervalSecs;
+}
+
 void ObjectRefScanMgr::setScanDoneCb(const ObjectRefScanMgr::ScanDoneCb &cb) {
     fds_assert(!scandoneCb);
     scandoneCb = cb;
@@ -213,6 +246,17 @@ void ObjectRefScanMgr::scanStep() {
         qosHelper.addToQueue(req);
     } else {
         /* Scan finished */
+        if (refTrackState == REFTRACK_SEEDING) {
+            WriteGuard wg(refTrackLock);
+            /* Only volumes that were scanned successfully have all their references tracked */
+            refTrackVols.clear();
+            refTrackVols.insert(scanSuccessVols.begin(), scanSuccessVols.end());
+            lastFullScanTs = dataMgr->counters->refscanLastRun.value();
+            auto expected = REFTRACK_SEEDING;
+            if (refTrackState.compare_exchange_strong(expected, REFTRACK_VALID)) {
+                LOGNORMAL << "tracking object references for " << refTrackVols.size() << " volumes";
+            }
+        }
         bfStore->sync(true /* clear cache */);
         // stop from refcountmanager
         // state = STOPPED
@@ -275,19 +319,181 @@ void ObjectRefScanMgr::prescanInit()
     }
     currentItr = scanList.begin();
 
-    /* Init bloomfilter store */
-    auto dmUserRepo = MODULEPROVIDER()->proc_fdsroot()->dir_user_repo_dm();
-    auto config = MODULEPROVIDER()->get_conf_helper();
-    auto bfSize = util::getBytesFromHumanSize(
-        config.get<std::string>("objectrefscan.bf_size", "1M"));
+    if (incrementalEnabled) {
+        /* Start tracking references from scratch.  From here on additions are
+         * tracked and the scan adds whatever was there before.
+         */
+        WriteGuard wg(refTrackLock);
+        refTrackTokenBits = currentDlt->getNumBitsForToken();
+        tokenRefs.clear();
+        for (uint32_t token = 0; token < currentDlt->getNumTokens(); token++) {
+            tokenRefs.emplace_back(new TokenRefs());
+        }
+        refTrackVols.clear();
+        for (const auto &ctx : scanList) {
+            refTrackVols.insert(ctx.volId);
+        }
+        refTrackState = REFTRACK_SEEDING;
+    }
 
+    initBloomFilterStore();
+    state = RUNNING;
+}
+
+void ObjectRefScanMgr::initBloomFilterStore()
+{
+    auto dmUserRepo = MODULEPROVIDER()->proc_fdsroot()->dir_user_repo_dm();
     bfStore.reset(new BloomFilterStore(util::strformat("%s/bloomfilters/", dmUserRepo.c_str()), 5, bfSize));
 
     /* Scan cycle counters */
     scanCntr++;
     objectsScannedCntr = 0;
+}
+
+void ObjectRefScanMgr::incrementalScanStep()
+{
+    currentDlt = MODULEPROVIDER()->getSvcMgr()->getCurrentDLT();
+    if (currentDlt->getNumBitsForToken() != refTrackTokenBits) {
+        invalidateRefTracking("dlt token width changed");
+    }
+    if (refTrackState != REFTRACK_VALID) {
+        /* Tracking got invalidated since the request was made.  Fall back to full scan */
+        LOGNORMAL << "tracked references are not valid.  running full scan instead";
+        scanStep();
+        return;
+    }
+
+    dataMgr->counters->refscanLastRun.set(util::getTimeStampSeconds());
+    dataMgr->counters->refscanRunning.set(1);
+    dataMgr->counters->refscanNumVolumes.set(0);
+    dataMgr->counters->refscanNumTokenFiles.set(0);
+    dataMgr->counters->refscanRunCount.incr();
+    dataMgr->counters->refscanIncrRunCount.incr();
+
+    scanList.clear();
+    scanSuccessVols.clear();
+    initBloomFilterStore();
+
+    std::list<fds_volid_t> trackedVols;
+    {
+        ReadGuard rg(refTrackLock);
+        trackedVols.assign(refTrackVols.begin(), refTrackVols.end());
+    }
+
+    /* Generate token bloomfilters one token at a time to keep memory in check.
+     * Only the copy is taken under refTrackLock, catalog commits applying
+     * deltas shouldn't wait on bloomfilter writes.
+     */
+    for (uint32_t token = 0; ; token++) {
+        util::BloomFilterPtr bloomfilter;
+        {
+            ReadGuard rg(refTrackLock);
+            if (refTrackState != REFTRACK_VALID || token >= tokenRefs.size()) {
+                break;
+            }
+            std::lock_guard<std::mutex> tokenLock(tokenRefs[token]->lock);
+            if (!tokenRefs[token]->refs) continue;
+            bloomfilter = tokenRefs[token]->refs->toBloomFilter();
+        }
+        auto tokenbloomfilter = bfStore->get(tokenBloomFilterKey(token));
+        tokenbloomfilter->merge(*bloomfilter);
+        bfStore->sync(true /* clear cache */);
+    }
+    if (refTrackState != REFTRACK_VALID) {
+        /* What got published may miss references of the change that invalidated tracking */
+        LOGNORMAL << "tracked references got invalidated while publishing.  running full scan instead";
+        scanStep();
+        return;
+    }
+    scanSuccessVols.swap(trackedVols);
+    dataMgr->counters->refscanNumVolumes.set(scanSuccessVols.size());
 
     state = RUNNING;
+    dumpStats();
+    if (scandoneCb) {
+        scandoneCb(this);
+    }
+}
+
+void ObjectRefScanMgr::objectRefDeltaCb(fds_volid_t volId,
+                                        const std::vector<ObjectID>& added,
+                                        const std::vector<ObjectID>& removed,
+                                        bool bulkChange)
+{
+    if (!incrementalEnabled || refTrackState == REFTRACK_INVALID) {
+        return;
+    }
+
+    if (bulkChange) {
+        invalidateRefTracking(util::strformat("bulk reference change in vol:%ld", volId.get()));
+        return;
+    }
+
+    ReadGuard rg(refTrackLock);
+    if (refTrackState == REFTRACK_INVALID ||
+        refTrackVols.find(volId) == refTrackVols.end()) {
+        /* Not a volume we report */
+        return;
+    }
+
+    trackObjectRefs(added, true);
+    /* Ignore removals while seeding.  Removed reference may not have been counted yet */
+    if (refTrackState == REFTRACK_VALID) {
+        trackObjectRefs(removed, false);
+    }
+}
+
+void ObjectRefScanMgr::trackObjectRefs(const std::vector<ObjectID>& oids, bool fAdd)
+{
+    /* Caller holds refTrackLock */
+    for (const auto &oid : oids) {
+        auto token = DLT::getToken(oid, refTrackTokenBits);
+        if (token >= tokenRefs.size()) {
+            continue;
+        }
+        auto &tokRefs = *(tokenRefs[token]);
+        std::lock_guard<std::mutex> tokenLock(tokRefs.lock);
+        if (!tokRefs.refs) {
+            if (!fAdd) continue;
+            tokRefs.refs.reset(new util::CountingBloomFilter(bfSize));
+        }
+        if (fAdd) {
+            tokRefs.refs->add(oid);
+        } else {
+            tokRefs.refs->remove(oid);
+        }
+    }
+}
+
+void ObjectRefScanMgr::trackScannedObjectRefs(const fds_token_id &tokenId,
+                                              const std::list<ObjectID>& oids)
+{
+    ReadGuard rg(refTrackLock);
+    if (refTrackState != REFTRACK_SEEDING || tokenId >= tokenRefs.size()) {
+        return;
+    }
+    auto &tokRefs = *(tokenRefs[tokenId]);
+    std::lock_guard<std::mutex> tokenLock(tokRefs.lock);
+    if (!tokRefs.refs) {
+        tokRefs.refs.reset(new util::CountingBloomFilter(bfSize));
+    }
+    for (const auto &oid : oids) {
+        tokRefs.refs->add(oid);
+    }
+}
+
+void ObjectRefScanMgr::invalidateRefTracking(const std::string &reason)
+{
+    WriteGuard wg(refTrackLock);
+    if (refTrackState == REFTRACK_INVALID) {
+        return;
+    }
+    LOGNORMAL << "invalidating tracked object references. next refscan will be a full scan."
+              << " reason: " << reason;
+    refTrackState = REFTRACK_INVALID;
+    tokenRefs.clear();
+    refTrackVols.clear();
+    dataMgr->counters->refscanIncrInvalidations.incr();
 }
 
 VolumeRefScannerContext::VolumeRefScannerContext(ObjectRefScanMgr* m, fds_volid_t vId)
@@ -436,6 +642,7 @@ Error VolumeObjectRefScanner::scanStep() {
     for (const auto &kv : tokenObjects) {
         auto bloomfilter = bfStore->get(ObjectRefScanMgr::volTokBloomFilterKey(bfVolId, kv.first));
         auto &objects = kv.second;
+        objRefMgr->trackScannedObjectRefs(kv.first, objects);
         for (const auto &oid : objects) {
             // LOGNORMAL << "scanned obj:" << oid;
             bloomfilter->add(oid);
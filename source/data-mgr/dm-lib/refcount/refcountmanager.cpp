@@ -30,6 +30,20 @@ void RefCountManager::mod_shutdown() {
     scanner->mod_shutdown();
 }
 
+void RefCountManager::registerObjectRefTracking() {
+    dm->timeVolCat_->queryIface()->registerObjectRefDeltaCb(
+        std::bind(&ObjectRefScanMgr::objectRefDeltaCb, scanner.get(),
+                  PH_ARG1, PH_ARG2, PH_ARG3, std::placeholders::_4));
+}
+
+void RefCountManager::runScan() {
+    if (scanner->isIncrementalScanPossible()) {
+        scanner->incrementalScanOnce();
+    } else {
+        scanner->scanOnce();
+    }
+}
+
 void RefCountManager::scanActiveObjects(bool fFromSM, bool fSchedule) {
     static fds_mutex lock("refscan request");
     static TimeStamp timegap = 30*60;  // 30 minutes
@@ -52,11 +66,11 @@ void RefCountManager::scanActiveObjects(bool fFromSM, bool fSchedule) {
     if (fSchedule) {
         LOGNORMAL << "scheduling refscan fromsm:" << fFromSM;
         auto lambda = [this]() {
-            scanner->scanOnce();
+            runScan();
         };
         dm->addToQueue(lambda);
     } else {
-        scanner->scanOnce();
+        runScan();
     }
 }
 
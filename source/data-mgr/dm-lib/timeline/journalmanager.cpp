@@ -4,13 +4,16 @@
 
 extern "C" {
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/inotify.h>
 #include <dirent.h>
 }
 #include <DataMgr.h>
 #include <leveldb/cat_journal.h>
+#include <leveldb/journal_archive.h>
 #include <util/path.h>
 #include <dm-vol-cat/DmPersistVolDB.h>
+#include <timeline/journalreplayer.h>
 namespace fds { namespace timeline {
 
 static const fds_uint32_t POLL_WAIT_TIME_MS = 120000;
@@ -42,28 +45,12 @@ void JournalManager::stopMonitoring() {
 Error JournalManager::replayTransactions(Catalog& destCat,
                                          const std::vector<std::string> &files,
                                          util::TimeStamp fromTime,
-                                         util::TimeStamp toTime) {
-    Error err(ERR_DM_REPLAY_JOURNAL);
-
-    fds_uint64_t ts = 0;
-    for (const auto &f : files) {
-        for (leveldb::CatJournalIterator iter(f); iter.isValid(); iter.Next()) {
-            leveldb::WriteBatch & wb = iter.GetBatch();
-            ts = getWriteBatchTimestamp(wb);
-            if (!ts) {
-                LOGDEBUG << "Error getting the write batch time stamp";
-                break;
-            }
-            if (ts > toTime) {
-                // we don't care about further records.
-                break;
-            }
-            if (ts >= fromTime && ts <= toTime) {
-                err = destCat.Update(&wb);
-            }
-        }
-    }
-    return err;
+                                         util::TimeStamp toTime,
+                                         const std::vector<fds_uint64_t> &startOffsets) {
+    fds_uint32_t scanThreads = dm->getModuleProvider()->get_fds_config()->
+            get<fds_uint32_t>("fds.dm.journal_replay_threads", JournalReplayer::DEFAULT_SCAN_THREADS);
+    JournalReplayer replayer(fromTime, toTime, scanThreads);
+    return replayer.replay(destCat, files, startOffsets);
 }
 
 Error JournalManager::replayTransactions(fds_volid_t srcVolId,
@@ -113,7 +100,12 @@ Error JournalManager::replayTransactions(fds_volid_t srcVolId,
         return ERR_NOT_FOUND;
     }
 
-    return replayTransactions(*catalog, journalFiles, fromTime, toTime);
+    // Only the first file has write batches from before fromTime, its
+    // index tells where to start reading it
+    std::vector<fds_uint64_t> startOffsets(journalFiles.size(), 0);
+    dm->timelineMgr->getDB()->getJournalOffset(journalFiles.front(), fromTime, startOffsets.front());
+
+    return replayTransactions(*catalog, journalFiles, fromTime, toTime, startOffsets);
 }
 
 Error JournalManager::getJournalStartTime(const std::string &logfile,
@@ -127,30 +119,107 @@ Error JournalManager::getJournalStartTime(const std::string &logfile,
     return startTime ? ERR_OK : ERR_DM_JOURNAL_TIME;
 }
 
+Error JournalManager::archiveJournal(const std::string &volDirName, const std::string &fileName) {
+    const FdsRootDir *root = dm->getModuleProvider()->proc_fdsroot();
+    std::string srcFile = root->dir_sys_repo_dm() + volDirName + "/" + fileName;
+    fds_volid_t volId (std::atoll(volDirName.c_str()));
+    LOGDEBUG << "Found leveldb archive file '" << srcFile << "'";
+
+    // A journal can be seen both when listing the volume directory and from
+    // its inotify event, the first one archives it
+    struct stat st;
+    if (0 != stat(srcFile.c_str(), &st) && ENOENT == errno) {
+        LOGDEBUG << "journal [" << srcFile << "] already archived";
+        return ERR_OK;
+    }
+
+    float_t dm_user_repo_pct_used = dmutil::getUsedCapacityOfUserRepo(root);
+    if (dm_user_repo_pct_used >= dm->dmFullnessThreshold) {
+        // The journal is dropped and a hole recorded in its place. That is
+        // the outcome for this journal, nothing to retry.
+        LOGERROR << "ERROR: DM user-repo already used " << dm_user_repo_pct_used
+                 << "% of available storage space!"
+                 << " Not creating new journal files for vol: ." << volId
+                 << ERR_DM_DISK_CAPACITY_ERROR_THRESHOLD;
+
+        TimeStamp startTime = 0;
+        getJournalStartTime(srcFile, startTime);
+        if (0 != unlink(srcFile.c_str()) && ENOENT != errno) {
+            LOGWARN << "unable to remove journal [" << srcFile << "] error:" << errno;
+        }
+        dm->timelineMgr->getDB()->addJournalFile(volId, startTime, journalTableHole);
+        LOGNORMAL << "hole: " << journalTableHole << "srcFile: " << srcFile.c_str();
+        return ERR_OK;
+    }
+
+    std::string volTLPath = root->dir_timeline_dm() + volDirName + "/";
+    FdsRootDir::fds_mkdir(volTLPath.c_str());
+    std::string destFile = volTLPath + fileName + leveldb::JOURNAL_ARCHIVE_SUFFIX;
+
+    std::vector<leveldb::JournalIndexEntry> index;
+    leveldb::Status s = leveldb::archiveJournal(srcFile, destFile, &index);
+    if (!s.ok()) {
+        LOGWARN << "unable to archive journal [" << srcFile << "] error:" << s.ToString();
+        return ERR_DISK_WRITE_FAILED;
+    }
+
+    // The first write batch of the journal is in the index
+    TimeStamp startTime = index.empty() ? 0 : index.front().timestamp;
+    fds_verify(0 == unlink(srcFile.c_str()));
+    dm->timelineMgr->getDB()->addJournalFile(volId, startTime, destFile);
+    dm->timelineMgr->getDB()->addJournalIndex(volId, destFile, index);
+    return ERR_OK;
+}
+
+void JournalManager::watchVolumeDir(int fd, const std::string &volDirName) {
+    const FdsRootDir *root = dm->getModuleProvider()->proc_fdsroot();
+    std::string volPath = root->dir_sys_repo_dm() + volDirName + "/";
+
+    int wd = inotify_add_watch(fd, volPath.c_str(), IN_CREATE);
+    if (wd < 0) {
+        LOGCRITICAL << "Failed to add watch for directory '" << volPath << "'";
+        return;
+    }
+    LOGTRACE << "Watching directory [" << volPath << "]";
+    volumeWatches[wd] = volDirName;
+
+    // Journals archived before the watch was added
+    std::vector<std::string> catFiles;
+    util::getFiles(volPath, catFiles);
+    for (const auto & f : catFiles) {
+        if (0 == f.find(leveldb::DEFAULT_ARCHIVE_PREFIX) && !archiveJournal(volDirName, f).ok()) {
+            failedJournals.emplace_back(volDirName, f);
+        }
+    }
+}
+
 /**
  * This thread will monitor filesystem for archived files. Whenever catalog journal
- * files are archived, the thread will wake up and copy the file to timeline directory.
- * The timeline directory will hold all journal files for all volumes.
+ * files are archived, the thread will wake up and move the file, compressed, to
+ * the timeline directory. The timeline directory will hold all journal files for
+ * all volumes.
+ *
+ * The volume directories are only listed when monitoring starts (or inotify
+ * dropped events), after that the inotify events tell which volume directory
+ * was created and which journal was archived.
  */
 void JournalManager::monitorLogs() {
     LOGNORMAL << "journal log monitoring started";
     const FdsRootDir *root = dm->getModuleProvider()->proc_fdsroot();
     const std::string dmDir = root->dir_sys_repo_dm();
 
-    // initialize inotify
-    int inotifyFd = inotify_init();
+    // initialize inotify, non blocking so that all events can be read
+    int inotifyFd = inotify_init1(IN_NONBLOCK);
     if (inotifyFd < 0) {
         LOGCRITICAL << "Failed to initialize inotify, error= '" << errno << "'";
         return;
     }
 
-    std::set<std::string> watched;
-    int wd = inotify_add_watch(inotifyFd, dmDir.c_str(), IN_CREATE);
-    if (wd < 0) {
+    int dmWd = inotify_add_watch(inotifyFd, dmDir.c_str(), IN_CREATE);
+    if (dmWd < 0) {
         LOGCRITICAL << "Failed to add watch for directory '" << dmDir << "'";
         return;
     }
-    watched.insert(dmDir);
 
     // epoll related calls
     int efd = epoll_create(sizeof(inotifyFd));
@@ -166,140 +235,84 @@ void JournalManager::monitorLogs() {
         return;
     }
 
-    char buffer[BUF_LEN] = {0};
-    fds_bool_t processedEvent = false;
-    fds_bool_t eventReady = false;
-    std::string gzip = util::which("gzip");
-    Error diskErr = ERR_OK;
+    auto watchAllVolumeDirs = [this, &dmDir, inotifyFd]() {
+        std::vector<std::string> volDirs;
+        util::getSubDirectories(dmDir, volDirs);
+        LOGTRACE << "monitoring : " << dmDir << " subdirs:" << volDirs.size();
+        for (const auto & d : volDirs) {
+            watchVolumeDir(inotifyFd, d);
+        }
+    };
+    watchAllVolumeDirs();
 
-    if (gzip.empty()) {
-        LOGWARN << "unable to locate gzip binary, will skip gzipping";
-    }
+    char buffer[BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
 
     while (!fStopLogMonitoring) {
-        do {
-            processedEvent = false;
-            std::vector<std::string> volDirs;
-            util::getSubDirectories(dmDir, volDirs);
-            LOGTRACE << "monitoring : " << dmDir << " subdirs:" << volDirs.size();
-
-            for (const auto & d : volDirs) {
-		std::string volPath = dmDir + d + "/";
-                std::vector<std::string> catFiles;
-                util::getFiles(volPath, catFiles);
-                LOGTRACE << "processing:" << volPath << " with files:" << catFiles.size();
-
-                for (const auto & f : catFiles) {
-                    LOGTRACE << "file:" << f;
-                    if (0 == f.find(leveldb::DEFAULT_ARCHIVE_PREFIX)) {
-                        LOGDEBUG << "Found leveldb archive file '" << volPath << f << "'";
-
-			// Get source file info
-			std::string srcFile = volPath + f;
-			TimeStamp startTime = 0;
-			getJournalStartTime(srcFile, startTime);
-			fds_volid_t volId (std::atoll(d.c_str()));
-
-			float_t dm_user_repo_pct_used = dmutil::getUsedCapacityOfUserRepo(MODULEPROVIDER()->proc_fdsroot());
-			if (dm_user_repo_pct_used >= dm->dmFullnessThreshold) {
-				diskErr = ERR_DM_DISK_CAPACITY_ERROR_THRESHOLD;
-				LOGERROR << "ERROR: DM user-repo already used " << dm_user_repo_pct_used
-				<< "% of available storage space!"
-				<<" Not creating new journal files for vol: ." << volId
-				<< diskErr;
-
-				fds_verify(0 == unlink(srcFile.c_str()));
-				dm->timelineMgr->getDB()->addJournalFile(volId, startTime, journalTableHole);
-				LOGNORMAL << "hole: " << journalTableHole << "srcFile: " << srcFile.c_str();
-			} else {
-
-				// Create destination file
-				std::string volTLPath = root->dir_timeline_dm() + d + "/";
-				FdsRootDir::fds_mkdir(volTLPath.c_str());
-
-				std::string destFile = volTLPath + f;
-				if (!gzip.empty()) destFile += ".gz";
-
-				std::string cmd;
-				if (gzip.empty()) {
-					cmd  = "cp -f " + srcFile + " " + destFile;
-				} else {
-					cmd = "gzip  --stdout " + srcFile + " > " + destFile;
-				}
-				LOGDEBUG << "running command: [" << cmd << "]";
-				auto rc = std::system(cmd.c_str());
-
-				if (!rc) {
-					fds_verify(0 == unlink(srcFile.c_str()));
-					processedEvent = true;
-					dm->timelineMgr->getDB()->addJournalFile(volId, startTime, destFile);
-				} else {
-					LOGWARN << "command failed [" << cmd << "], error:" << rc << ":" << strerror(rc);
-				}
-			}
-                    }
-                }
-
-                std::set<std::string>::const_iterator iter = watched.find(volPath);
-                if (watched.end() == iter) {
-                    if ((wd = inotify_add_watch(inotifyFd, volPath.c_str(), IN_CREATE)) < 0) {
-                        LOGCRITICAL << "Failed to add watch for directory '" << volPath << "'";
-                        continue;
-                    } else {
-                        LOGTRACE << "Watching directory [" << volPath << "]";
-                        processedEvent = true;
-                        watched.insert(volPath);
-                    }
-                }
-
-            }
-
-            if (fStopLogMonitoring) {
-                return;
-            }
-        } while (processedEvent);
-
         // now check for each volume if the commit log time has been exceeded
         removeExpiredJournals();
 
-        do {
-            eventReady = false;
-            errno = 0;
-            fds_int32_t fdCount = epoll_wait(efd, &ev, MAX_POLL_EVENTS, POLL_WAIT_TIME_MS);
-            LOGTRACE << "fdcount:" << fdCount;
-            if (fStopLogMonitoring) {
+        errno = 0;
+        fds_int32_t fdCount = epoll_wait(efd, &ev, MAX_POLL_EVENTS, POLL_WAIT_TIME_MS);
+        LOGTRACE << "fdcount:" << fdCount;
+        if (fStopLogMonitoring) {
+            return;
+        }
+        if (fdCount < 0) {
+            if (EINTR != errno) {
+                LOGCRITICAL << "epoll_wait() failed, error= '" << errno << "'";
+                LOGCRITICAL << "Stopping commit log monitoring...";
                 return;
             }
-            if (fdCount < 0) {
-                if (EINTR != errno) {
-                    LOGCRITICAL << "epoll_wait() failed, error= '" << errno << "'";
-                    LOGCRITICAL << "Stopping commit log monitoring...";
-                    return;
-                }
-            } else if (0 == fdCount) {
-                // timeout, refresh
-                eventReady = true;
-            } else {
-                int len = read(inotifyFd, buffer, BUF_LEN);
-                if (len < 0) {
-                    LOGWARN << "Failed to read inotify event, error= '" << errno << "'";
-                    continue;
+            continue;
+        }
+        if (0 == fdCount) {
+            // timeout, retry what failed
+            std::vector<std::pair<std::string, std::string>> retry;
+            retry.swap(failedJournals);
+            for (const auto & journal : retry) {
+                if (!archiveJournal(journal.first, journal.second).ok()) {
+                    failedJournals.push_back(journal);
                 }
+            }
+            continue;
+        }
 
-                for (char * p = buffer; p < buffer + len; ) {
-                    struct inotify_event * event = reinterpret_cast<struct inotify_event *>(p);
-                    LOGTRACE << "event name:" << event->name;
-                    if (event->mask | IN_ISDIR
-                        || 0 == strncmp(event->name,
+        // edge triggered, read until there are no events left
+        int len;
+        while ((len = read(inotifyFd, buffer, BUF_LEN)) > 0) {
+            for (char * p = buffer; p < buffer + len; ) {
+                struct inotify_event * event = reinterpret_cast<struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                LOGTRACE << "event name:" << (event->len ? event->name : "");
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    LOGWARN << "inotify events were dropped, looking at all volume directories";
+                    watchAllVolumeDirs();
+                } else if (event->wd == dmWd) {
+                    if ((event->mask & IN_ISDIR) && event->len) {
+                        watchVolumeDir(inotifyFd, event->name);
+                    }
+                } else if (event->mask & IN_IGNORED) {
+                    // volume directory removed
+                    volumeWatches.erase(event->wd);
+                } else if (event->len &&
+                           0 == strncmp(event->name,
                                         leveldb::DEFAULT_ARCHIVE_PREFIX.c_str(),
-                                        strlen(leveldb::DEFAULT_ARCHIVE_PREFIX.c_str()))) {
-                        eventReady = true;
-                        break;
+                                        leveldb::DEFAULT_ARCHIVE_PREFIX.size())) {
+                    auto iter = volumeWatches.find(event->wd);
+                    if (volumeWatches.end() != iter &&
+                        !archiveJournal(iter->second, event->name).ok()) {
+                        failedJournals.emplace_back(iter->second, event->name);
                     }
-                    p += sizeof(struct inotify_event) + event->len;
                 }
             }
-        } while (!eventReady);
+            if (fStopLogMonitoring) {
+                return;
+            }
+        }
+        if (len < 0 && EAGAIN != errno && EINTR != errno) {
+            LOGWARN << "Failed to read inotify event, error= '" << errno << "'";
+        }
     }
 }
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <leveldb/cat_journal.h>
+#include <util/Log.h>
+#include <dm-vol-cat/DmPersistVolCat.h>
+#include <timeline/journalreplayer.h>
+namespace fds { namespace timeline {
+
+namespace {
+
+/**
+ * Keeps the last write of every key of the batches it iterates.  Timestamp
+ * records are left out, the replayer writes its own.
+ */
+template <typename Updates>
+class CollapseHandler : public leveldb::WriteBatch::Handler {
+  public:
+    explicit CollapseHandler(Updates &updates) : updates(updates) {}
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+        if (key == OP_TIMESTAMP_REC) {
+            return;
+        }
+        auto &update = updates[key.ToString()];
+        update.deleted = false;
+        update.value.assign(value.data(), value.size());
+    }
+
+    void Delete(const leveldb::Slice& key) override {
+        auto &update = updates[key.ToString()];
+        update.deleted = true;
+        update.value.clear();
+    }
+
+  private:
+    Updates &updates;
+};
+
+}  // namespace
+
+JournalReplayer::JournalReplayer(util::TimeStamp fromTime,
+                                 util::TimeStamp toTime,
+                                 fds_uint32_t scanThreads,
+                                 size_t batchBytes)
+        : fromTime(fromTime), toTime(toTime), scanThreads(std::max(scanThreads, 1u)),
+          batchBytes(batchBytes) {
+}
+
+fds_uint64_t JournalReplayer::scanFile(const std::string &file, fds_uint64_t startOffset,
+                                       KeyUpdates &updates, util::TimeStamp &lastTs) const {
+    CollapseHandler<KeyUpdates> handler(updates);
+    fds_uint64_t batches = 0;
+    for (leveldb::CatJournalIterator iter(file, startOffset); iter.isValid(); iter.Next()) {
+        leveldb::WriteBatch & wb = iter.GetBatch();
+        fds_uint64_t ts = leveldb::getWriteBatchTimestamp(wb);
+        if (!ts) {
+            LOGDEBUG << "Error getting the write batch time stamp in " << file;
+            break;
+        }
+        if (ts > toTime) {
+            // we don't care about further records.
+            break;
+        }
+        if (ts >= fromTime) {
+            wb.Iterate(&handler);
+            lastTs = std::max(lastTs, ts);
+            ++batches;
+        }
+    }
+    return batches;
+}
+
+Error JournalReplayer::write(Catalog& destCat, const KeyUpdates &updates,
+                             util::TimeStamp lastTs) {
+    // Every batch is stamped like the journaled ones: the catalog's own
+    // journal is replayed and archived by time too
+    const leveldb::Slice tsval(reinterpret_cast<const char *>(&lastTs), sizeof(lastTs));
+    CatWriteBatch batch;
+    batch.Put(OP_TIMESTAMP_REC, tsval);
+    size_t bytes = 0;
+    for (const auto &kv : updates) {
+        if (kv.second.deleted) {
+            batch.Delete(kv.first);
+        } else {
+            batch.Put(kv.first, kv.second.value);
+        }
+        bytes += kv.first.size() + kv.second.value.size();
+        ++keysWritten;
+
+        if (bytes >= batchBytes) {
+            Error err = destCat.Update(&batch, false);
+            if (!err.ok()) {
+                return err;
+            }
+            batch.Clear();
+            batch.Put(OP_TIMESTAMP_REC, tsval);
+            bytes = 0;
+        }
+    }
+    // The last write is synced, and with it everything written before
+    return destCat.Update(&batch, true);
+}
+
+Error JournalReplayer::replay(Catalog& destCat, const std::vector<std::string> &files,
+                              const std::vector<fds_uint64_t> &startOffsets) {
+    batchesReplayed = 0;
+    keysWritten = 0;
+
+    // Scan the files in parallel, each into its own updates
+    std::vector<KeyUpdates> fileUpdates(files.size());
+    std::vector<fds_uint64_t> fileBatches(files.size(), 0);
+    std::vector<util::TimeStamp> fileLastTs(files.size(), 0);
+    std::atomic<size_t> nextFile {0};
+    auto scanner = [&]() {
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            fds_uint64_t startOffset = (i < startOffsets.size()) ? startOffsets[i] : 0;
+            fileBatches[i] = scanFile(files[i], startOffset, fileUpdates[i], fileLastTs[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    size_t nThreads = std::min<size_t>(scanThreads, files.size());
+    for (size_t t = 1; t < nThreads; ++t) {
+        threads.emplace_back(scanner);
+    }
+    scanner();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    // Merge newest first, the first write seen of a key is its last one
+    KeyUpdates updates;
+    util::TimeStamp lastTs = 0;
+    for (size_t i = files.size(); i-- > 0; ) {
+        batchesReplayed += fileBatches[i];
+        lastTs = std::max(lastTs, fileLastTs[i]);
+        if (updates.empty()) {
+            updates.swap(fileUpdates[i]);
+            continue;
+        }
+        for (auto &kv : fileUpdates[i]) {
+            updates.emplace(kv.first, std::move(kv.second));
+        }
+        KeyUpdates().swap(fileUpdates[i]);
+    }
+
+    if (!batchesReplayed) {
+        return ERR_DM_REPLAY_JOURNAL;
+    }
+
+    Error err = write(destCat, updates, lastTs);
+    LOGNORMAL << "replayed " << batchesReplayed << " write batches from "
+              << files.size() << " journal files as " << keysWritten << " keys"
+              << " err:" << err;
+    return err;
+}
+
+}  // namespace timeline
+}  // namespace fds
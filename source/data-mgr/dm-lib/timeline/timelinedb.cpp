@@ -61,6 +61,20 @@ Error TimelineDB::open(const FdsRootDir *root) {
     rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
     CHECK_SQL_CODE("unable to create index on journal table");
 
+    /**
+     * Create the Journal Index Table
+     * Where write batches start in archived journal files, by time
+     */
+    sql = "create table if not exists journalindextbl"
+            " (volid integer, filename text not null, starttime integer not null,"
+            " offset integer not null)";
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to create journal index table");
+
+    sql = "create index if not exists filename_starttime on journalindextbl (filename, starttime)";
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to create index on journal index table");
+
     /**
      * Create the Snapshot Table
      * Contains the list of snapshots and the time of creation
@@ -99,6 +113,12 @@ Error TimelineDB::removeJournalFile(fds_volid_t volId, const std::string& journa
     rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
     CHECK_SQL_CODE("unable to add file to journal tbl");
 
+    sql = util::strformat("delete from journalindextbl where volid=%ld and filename = '%s'",
+                          volId.get(),
+                          journalFile.c_str());
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to remove file from journal index tbl");
+
     return ERR_OK;
 }
 
@@ -125,9 +145,51 @@ Error TimelineDB::removeOldJournalFiles(fds_volid_t volId, TimeStamp uptoTime,
         volId.get(), startTime);
     rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
     CHECK_SQL_CODE("unable to delete records from db");
+
+    sql = util::strformat(
+        "delete from journalindextbl where volid = %ld and "
+        "filename not in (select filename from journaltbl where volid = %ld)",
+        volId.get(), volId.get());
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to delete journal index records from db");
     return err;
 }
 
+Error TimelineDB::addJournalIndex(fds_volid_t volId, const std::string& journalFile,
+                                  const std::vector<leveldb::JournalIndexEntry>& index) {
+    DECLARE_DB_VARS();
+    sql = "begin transaction";
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to begin transaction");
+
+    for (const auto& entry : index) {
+        sql = util::strformat("insert into journalindextbl (volid, filename, starttime, offset) "
+                              "values (%ld, '%s', %ld, %ld)", volId.get(),
+                              journalFile.c_str(), entry.timestamp, entry.offset);
+        rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+        if (rc != SQLITE_OK) {
+            sqlite3_exec(db, "rollback", NULL, NULL, NULL);
+        }
+        CHECK_SQL_CODE("unable to add journal index entry");
+    }
+
+    sql = "commit";
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to commit journal index");
+    return ERR_OK;
+}
+
+Error TimelineDB::getJournalOffset(const std::string& journalFile, TimeStamp fromTime,
+                                   fds_uint64_t& offset) {
+    DECLARE_DB_VARS();
+    offset = 0;
+    // the last indexed write batch before fromTime, everything before it is older
+    sql = util::strformat("select offset from journalindextbl where filename = '%s' and "
+                          "starttime < %ld order by starttime desc limit 1",
+                          journalFile.c_str(), fromTime);
+    return getInt(sql, offset);
+}
+
 Error TimelineDB::getJournalFiles(fds_volid_t volId, TimeStamp fromTime, TimeStamp toTime,
                                   std::vector<JournalFileInfo>& vecJournalFiles) {
     DECLARE_DB_VARS();
@@ -285,6 +347,10 @@ Error TimelineDB::removeVolume(fds_volid_t volId) {
     rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
     CHECK_SQL_CODE("unable to remove volume from journal tbl");
 
+    sql = util::strformat("delete from journalindextbl where volid=%ld", volId.get());
+    rc = sqlite3_exec(db, sql.c_str(), NULL, NULL,  &zErrMsg);
+    CHECK_SQL_CODE("unable to remove volume from journal index tbl");
+
     return ERR_OK;
 }
 
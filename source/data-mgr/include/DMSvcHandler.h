@@ -176,6 +176,8 @@ class DMSvcHandler : virtual public fpi::DMSvcIf, public PlatNetSvcHandler {
     template <class DmVolumeReqT>
     void registerDmVolumeReqHandler()
     {
+        /* Requests from this process come in as bytes as well */
+        asyncReqMsgHandlers_.erase(DmVolumeReqT::reqMsgTypeId);
         asyncReqHandlers_[DmVolumeReqT::reqMsgTypeId] =
             [this] (SHPTR<fpi::AsyncHdr>& asyncHdr,
                     SHPTR<std::string>& payloadBuf)
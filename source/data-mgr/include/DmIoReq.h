@@ -23,6 +23,7 @@
 #include <net/PlatNetSvcHandler.h>
 #include <net/volumegroup_extensions.h>
 #include <PerfTrace.h>
+#include <util/ObjectPool.h>
 
 #define FdsDmSysTaskId      fds_volid_t(0x8fffffff)
 #define FdsDmSysTaskPrio    5
@@ -60,6 +61,18 @@ extern std::string logString(const fpi::CtrlNotifyFinishMigrationMsg &msg);
 extern std::string logString(const fpi::CheckVolumeMetaDataMsg &msg);
 // ======
 
+/**
+ * Blob bytes the objects of a catalog update or query cover.  Catalog IOs are
+ * priced in QoS tokens by it, the same as the AM prices the blob IO.
+ */
+inline fds_uint64_t blobObjectListBytes(const fpi::FDSP_BlobObjectList& objList) {
+    fds_uint64_t bytes = 0;
+    for (const auto& obj : objList) {
+        bytes += obj.size;
+    }
+    return bytes;
+}
+
 class DmRequest : public FDS_IOType {
   public:
     fds_volid_t  volId;
@@ -226,7 +239,7 @@ class DmIoMetaRecvd : public DmRequest {
 /**
  * Request to Commit Blob Tx
  */
-class DmIoCommitBlobTx : public DmRequest {
+class DmIoCommitBlobTx : public DmRequest, public PooledObject<DmIoCommitBlobTx> {
   public:
     typedef std::function<void (const Error &e, DmIoCommitBlobTx *blobTx)> CbType;
     fpi::CommitBlobTxRspMsg rspMsg;
@@ -285,16 +298,19 @@ class DmIoCommitBlobTx : public DmRequest {
 };
 
 template <typename T>
-class DmIoCommitBlobOnce : public  DmIoCommitBlobTx {
+class DmIoCommitBlobOnce : public  DmIoCommitBlobTx, public PooledObject<DmIoCommitBlobOnce<T>> {
   public:
     using DmIoCommitBlobTx::DmIoCommitBlobTx;
+    // Bigger than DmIoCommitBlobTx, needs a pool of its own
+    using PooledObject<DmIoCommitBlobOnce<T>>::operator new;
+    using PooledObject<DmIoCommitBlobOnce<T>>::operator delete;
     T *parent;
 };
 
 /**
  * Request to Abort Blob Tx
  */
-class DmIoAbortBlobTx : public DmRequest {
+class DmIoAbortBlobTx : public DmRequest, public PooledObject<DmIoAbortBlobTx> {
   public:
     typedef std::function<void (const Error &e, DmIoAbortBlobTx *blobTx)> CbType;
 
@@ -326,7 +342,7 @@ class DmIoAbortBlobTx : public DmRequest {
 /**
  * Request to Start Blob Tx
  */
-class DmIoStartBlobTx : public DmRequest {
+class DmIoStartBlobTx : public DmRequest, public PooledObject<DmIoStartBlobTx> {
   public:
     typedef std::function<void (const Error &e, DmIoStartBlobTx *blobTx)> CbType;
 
@@ -368,7 +384,7 @@ class DmIoStartBlobTx : public DmRequest {
 /**
  * Request to query catalog
  */
-class DmIoQueryCat : public DmRequest {
+class DmIoQueryCat : public DmRequest, public PooledObject<DmIoQueryCat> {
   public:
     typedef std::function<void (const Error &e, DmIoQueryCat *req)> CbType;
     boost::shared_ptr<fpi::QueryCatalogMsg> queryMsg;
@@ -430,7 +446,7 @@ class DmIoFwdCat : public DmRequest {
 /**
  * Request to update catalog
  */
-class DmIoUpdateCat : public DmRequest {
+class DmIoUpdateCat : public DmRequest, public PooledObject<DmIoUpdateCat> {
   public:
     typedef std::function<void (const Error &e, DmIoUpdateCat *req)> CbType;
 
@@ -443,6 +459,7 @@ class DmIoUpdateCat : public DmRequest {
         opReqFailedPerfEventType = PerfEventType::DM_TX_OP_REQ_ERR;
         opReqLatencyCtx.type = PerfEventType::DM_TX_UPDATE_REQ;
         setOpId(_updcatMsg->opId);
+        io_size = blobObjectListBytes(obj_list);
     }
 
     friend std::ostream& operator<<(std::ostream& out, const DmIoUpdateCat& io) {
@@ -467,7 +484,7 @@ class DmIoUpdateCat : public DmRequest {
 /**
  * Request to update catalog in a single request.
  */
-class DmIoUpdateCatOnce : public DmRequest {
+class DmIoUpdateCatOnce : public DmRequest, public PooledObject<DmIoUpdateCatOnce> {
   public:
     explicit DmIoUpdateCatOnce(
         boost::shared_ptr<fpi::UpdateCatalogOnceMsg>& _updcatMsg,
@@ -484,6 +501,7 @@ class DmIoUpdateCatOnce : public DmRequest {
         opReqFailedPerfEventType = PerfEventType::DM_TX_COMMIT_REQ_ERR;
         opReqLatencyCtx.type = PerfEventType::DM_UPDATE_ONCE_REQ;
         setOpId(_updcatMsg->opId);
+        io_size = blobObjectListBytes(_updcatMsg->obj_list);
     }
 
     friend std::ostream& operator<<(std::ostream& out, const DmIoUpdateCatOnce& io) {
@@ -510,7 +528,7 @@ class DmIoUpdateCatOnce : public DmRequest {
 /**
  * Request to set blob metadata
  */
-class DmIoSetBlobMetaData : public DmRequest {
+class DmIoSetBlobMetaData : public DmRequest, public PooledObject<DmIoSetBlobMetaData> {
   public:
     typedef std::function<void (const Error &e, DmIoSetBlobMetaData *req)> CbType;
 
@@ -566,7 +584,7 @@ class DmIoDeleteCat : public DmRequest {
     CbType dmio_deletecat_resp_cb;
 };
 
-class DmIoGetBlobMetaData : public DmRequest {
+class DmIoGetBlobMetaData : public DmRequest, public PooledObject<DmIoGetBlobMetaData> {
   public:
     typedef std::function<void (const Error &e, DmIoGetBlobMetaData *req)> CbType;
 
@@ -634,7 +652,7 @@ class DmIoRenameBlob : public DmRequest {
     CbType dmio_getmd_resp_cb;
 };
 
-struct DmIoStatVolume : DmRequest {
+struct DmIoStatVolume : DmRequest, PooledObject<DmIoStatVolume> {
     typedef std::function<void (const Error &e, DmIoStatVolume *req)> CbType;
 
     explicit DmIoStatVolume(boost::shared_ptr<fpi::StatVolumeMsg> message)
@@ -19,6 +19,17 @@ namespace fds {
 typedef std::function<Error (fds_volid_t volid,
                              const std::vector<ObjectID>& oids, bool)> expunge_objs_cb_t;
 
+/**
+ * Callback type to report object references gained (added) and dropped (removed)
+ * by a committed catalog update.  An object referenced at several offsets shows
+ * up once per offset.  bulkChange is set when the references of the volume changed
+ * without per object details, e.g. the catalog was copied or synced from a peer.
+ */
+typedef std::function<void (fds_volid_t volid,
+                            const std::vector<ObjectID>& added,
+                            const std::vector<ObjectID>& removed,
+                            bool bulkChange)> objref_delta_cb_t;
+
 /**
  * Interface to Volume Catalog for querying commited versions of
  * blob metadata in volume catalogs.
@@ -34,6 +45,11 @@ class VolumeCatalogQueryIface {
      */
     virtual void registerExpungeObjectsCb(expunge_objs_cb_t cb) = 0;
 
+    /**
+     * Callback to track object references added/removed by committed updates
+     */
+    virtual void registerObjectRefDeltaCb(objref_delta_cb_t cb) = 0;
+
     /**
      * Returns logical size of volume and number of blob in the volume 'volume_id'
      * @param[out] size logical size of volume in bytes
@@ -25,6 +25,7 @@
 #include <VolumeInitializer.h>
 #include <dm-vol-cat/DmPersistVolDB.h>
 #include <CatalogScanner.h>
+#include <catalogKeys/BlobObjectKey.h>
 #include <FdsCrypto.h>
 
 namespace fds {
@@ -389,6 +390,9 @@ struct VolumeMeta : HasLogger,  HasModuleProvider, StateProvider {
         // Given a slice, hash the data
         void hashThisSlice(CatalogKVPair &pair);
 
+        // Hashes an object of a blob, whatever the catalog layout
+        void hashObject(const BlobObjectKey& key, const ObjectID& obj);
+
         // Computes the hash and store the result in hashResult
         void computeCompleteHash();
     };
@@ -52,6 +52,10 @@ struct LevelDbDiffAdapter {
     virtual leveldb::Comparator* getComparator() {
         return nullptr;
     }
+    /* Iterator the differ walks, adapters may present the entries in a normalized form */
+    virtual leveldb::Iterator* newIterator(leveldb::DB *db) {
+        return db->NewIterator(leveldb::ReadOptions());
+    }
 };
 
 /**
@@ -17,6 +17,10 @@ struct Counters : FdsCounters {
     SimpleNumericCounter refscanLastRun;
     SimpleNumericCounter refscanNumObjects;
     SimpleNumericCounter refscanRunCount;
+    /* Refscans served from tracked references instead of a catalog scan */
+    SimpleNumericCounter refscanIncrRunCount;
+    /* Times tracked references had to be rebuilt by a full scan */
+    SimpleNumericCounter refscanIncrInvalidations;
 
     // Starting with VG mode, because migrations can happen at any time,
     // the total values are not reset, but active values are dynamically changed
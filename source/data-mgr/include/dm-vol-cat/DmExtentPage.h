@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_DATA_MGR_INCLUDE_DM_VOL_CAT_DMEXTENTPAGE_H_
+#define SOURCE_DATA_MGR_INCLUDE_DM_VOL_CAT_DMEXTENTPAGE_H_
+
+#include <bitset>
+#include <functional>
+#include <string>
+
+#include <fds_error.h>
+#include <fds_types.h>
+
+namespace fds {
+
+/**
+ * Object IDs of OBJECTS_PER_PAGE consecutive object offsets of a blob, stored
+ * under one catalog key (BlobExtentKey) by the extent map catalog layout.
+ *
+ * On disk a page is a list of runs of written offsets, offsets that were never
+ * written (or were deleted) are the gaps between runs and take no space. A run
+ * of offsets that all map to the same object, e.g. zeroed blocks, stores that
+ * object ID once.
+ */
+class DmExtentPage {
+  public:
+    static const fds_uint32_t OBJECTS_PER_PAGE = 128;
+
+    DmExtentPage() = default;
+
+    /**
+     * Object index of a blob to its page, and to its slot in that page
+     */
+    static inline fds_uint32_t pageIndex(fds_uint32_t objectIndex) {
+        return objectIndex / OBJECTS_PER_PAGE;
+    }
+    static inline fds_uint32_t pageSlot(fds_uint32_t objectIndex) {
+        return objectIndex % OBJECTS_PER_PAGE;
+    }
+
+    Error loadSerialized(const char *data, size_t len);
+    void getSerialized(std::string & buf) const;
+
+    /**
+     * @return false if the slot was not written
+     */
+    fds_bool_t getObject(fds_uint32_t slot, ObjectID & obj) const;
+
+    void putObject(fds_uint32_t slot, const ObjectID & obj);
+
+    /**
+     * Clears the slots from first to last, both included
+     */
+    void deleteObjects(fds_uint32_t first, fds_uint32_t last);
+
+    inline fds_bool_t empty() const {
+        return written_.none();
+    }
+
+    inline fds_uint32_t size() const {
+        return written_.count();
+    }
+
+    /**
+     * Calls func for every written slot from first to last, in slot order
+     */
+    void forEachObject(std::function<void(fds_uint32_t, const ObjectID &)> func,
+                       fds_uint32_t first = 0,
+                       fds_uint32_t last = OBJECTS_PER_PAGE - 1) const;
+
+  private:
+    static const fds_uint8_t VERSION = 1;
+    // A run is stored once per object ID, or once for all of its offsets
+    enum RunType : fds_uint8_t { RUN_OBJECTS = 0, RUN_REPEAT = 1 };
+    // Shortest run of a repeated object ID that is stored as such
+    static const fds_uint32_t MIN_REPEAT = 3;
+
+    inline const fds_uint8_t* digest(fds_uint32_t slot) const {
+        return digests_ + slot * OBJECTID_DIGESTLEN;
+    }
+    fds_bool_t sameObject(fds_uint32_t lhs, fds_uint32_t rhs) const;
+    void putRun(std::string & buf, fds_uint32_t first, fds_uint32_t count, RunType type) const;
+
+    std::bitset<OBJECTS_PER_PAGE> written_;
+    fds_uint8_t digests_[OBJECTS_PER_PAGE * OBJECTID_DIGESTLEN];
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_DATA_MGR_INCLUDE_DM_VOL_CAT_DMEXTENTPAGE_H_
@@ -117,7 +117,10 @@ class DmPersistVolCat : public HasModuleProvider {
     // creation and deletion
     virtual Error activate() = 0;
 
-    virtual Error copyVolDir(const std::string & destName) = 0;
+    /**
+     * Copies the catalog to destName, the catalog of volume destVolId
+     */
+    virtual Error copyVolDir(const std::string & destName, fds_volid_t destVolId) = 0;
 
     virtual Error markDeleted() {
         LOGNOTIFY << "Catalog for volume '" << volId_ << "' marked deleted";
@@ -6,12 +6,15 @@
 
 // Standard includes.
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <atomic>
 // Internal includes.
 #include "catalogKeys/CatalogKeyComparator.h"
 #include "concurrency/RwLock.h"
+#include "concurrency/Mutex.h"
+#include "dm-vol-cat/DmExtentPage.h"
 #include "dm-vol-cat/DmPersistVolCat.h"
 #include "lib/Catalog.h"
 #include "fds_config.hpp"
@@ -29,6 +32,12 @@ class DmPersistVolDB : public HasLogger, public DmPersistVolCat {
     static const std::string CATALOG_CACHE_SIZE_STR;
     static const std::string CATALOG_MAX_LOG_FILES_STR;
     static const std::string ENABLE_TIMELINE_STR;
+    static const std::string CATALOG_EXTENT_MAP_STR;
+    static const std::string CATALOG_SHARED_RESOURCES_STR;
+    static const std::string CATALOG_SHARED_CACHE_SIZE_STR;
+    static const std::string CATALOG_WRITE_BUFFER_BUDGET_STR;
+    static const std::string CATALOG_MAX_OPEN_FILES_STR;
+    static const std::string CATALOG_SHARED_STORE_STR;
 
     // ctor & dtor
     DmPersistVolDB(CommonModuleProviderIf *modProvider,
@@ -38,16 +47,18 @@ class DmPersistVolDB : public HasLogger, public DmPersistVolCat {
                    fds_bool_t readOnly,
                    fds_bool_t clone,
                    fds_bool_t archiveLogs,
-                   fds_volid_t srcVolId = invalid_vol_id)
+                   fds_volid_t srcVolId = invalid_vol_id,
+                   fpi::FDSP_VolType volType = fpi::FDSP_VOL_S3_TYPE)
             : DmPersistVolCat(modProvider,
                               volId,
                               objSize,
                               snapshot,
                               readOnly,
                               clone,
-                              fpi::FDSP_VOL_S3_TYPE,
+                              volType,
                               srcVolId),
-        configHelper_(modProvider->get_conf_helper()), snapshotCount(0), archiveLogs_(archiveLogs)
+        configHelper_(modProvider->get_conf_helper()), snapshotCount(0), archiveLogs_(archiveLogs),
+        extentMap_(false), extentLock_("DmPersistVolDB extent lock")
     {
         const FdsRootDir* root = modProvider->proc_fdsroot();
         timelineDir_ = root->dir_timeline_dm() + getVolIdStr() + "/";
@@ -57,7 +68,13 @@ class DmPersistVolDB : public HasLogger, public DmPersistVolCat {
     // methods
     virtual Error activate() override;
 
-    virtual Error copyVolDir(const std::string & destName) override;
+    virtual Error copyVolDir(const std::string & destName, fds_volid_t destVolId) override;
+
+    /**
+     * A catalog in the shared store drops its keys right away, they don't go
+     * with a directory of their own
+     */
+    virtual Error markDeleted() override;
     
     Error archive(const std::string& destDir, const std::string& filename);
     // gets
@@ -173,9 +190,53 @@ class DmPersistVolDB : public HasLogger, public DmPersistVolCat {
     void setVersion(int32_t version) override;
     int32_t updateVersion();
 
+    /**
+     * True if the volume's object offsets are stored in pages of
+     * consecutive offsets (BLOB_EXTENTS keys) rather than one key each
+     */
+    fds_bool_t isExtentMap() const {
+        return extentMap_;
+    }
+
   private:
     std::string getVersionFile_();
+    /**
+     * Block cache and write buffer budget shared by the catalogs of all
+     * volumes
+     */
+    CatalogResources* catalogResources_();
+    /**
+     * catalogResources_() if volume catalogs share them, null unless
+     * enabled in the config
+     */
+    CatalogResources* sharedResources_();
+    /**
+     * One leveldb for the catalogs of all volumes, null unless enabled in
+     * the config
+     */
+    SharedCatalogStore* sharedStore_();
+    /**
+     * Deletes the keys of volumes in the store whose catalog directory is
+     * gone, left behind if the DM went down while deleting a volume
+     */
+    void sweepSharedStore_(SharedCatalogStore& store);
     // methods
+    Error getExtentPage_(const std::string & blobName, fds_uint32_t pageIndex,
+                         DmExtentPage & page, Catalog::MemSnap snap = NULL);
+    /**
+     * Reads the pages of the object indexes in puts and deletes, applies them
+     * and adds the updated pages to batch. extentLock_ must be held until
+     * the batch is written.
+     */
+    Error updateExtents_(const std::string & blobName,
+                         const std::map<fds_uint32_t, ObjectID> & puts,
+                         const std::set<fds_uint32_t> & deletes,
+                         CatWriteBatch & batch);
+    Error getExtents_(const std::string & blobName, fds_uint32_t startObjIndex,
+                      fds_uint32_t endObjIndex, Catalog::MemSnap snap,
+                      std::function<void(fds_uint32_t, const ObjectID &)> func);
+    Error deleteExtents_(const std::string & blobName, fds_uint32_t startObjIndex,
+                         fds_uint32_t endObjIndex);
 
     // vars
     std::atomic<uint64_t> snapshotCount;
@@ -188,6 +249,10 @@ class DmPersistVolDB : public HasLogger, public DmPersistVolCat {
 
     std::string timelineDir_;
     fds_bool_t archiveLogs_;
+
+    // Extent map layout, see isExtentMap(). Page updates are read-modify-write.
+    fds_bool_t extentMap_;
+    fds_mutex extentLock_;
 };
 }  // namespace fds
 #endif  // SOURCE_DATA_MGR_INCLUDE_DM_VOL_CAT_DMPERSISTVOLDB_H_
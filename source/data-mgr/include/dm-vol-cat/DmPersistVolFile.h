@@ -36,7 +36,7 @@ class DmPersistVolFile : public HasLogger, public DmPersistVolCat {
     // methods
     virtual Error activate() override;
 
-    virtual Error copyVolDir(const std::string & destName) override;
+    virtual Error copyVolDir(const std::string & destName, fds_volid_t destVolId) override;
 
     // gets
     virtual Error getBlobMetaDesc(const std::string & blobName,
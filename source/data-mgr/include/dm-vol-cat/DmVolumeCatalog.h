@@ -98,6 +98,11 @@ class DmVolumeCatalog : public HasModuleProvider,
      */
     void registerExpungeObjectsCb(expunge_objs_cb_t cb) override;
 
+    /**
+     * Callback to track object references added/removed by committed updates
+     */
+    void registerObjectRefDeltaCb(objref_delta_cb_t cb) override;
+
     /**
      * Marks volume as deleted
      * @return ERR_OK
@@ -345,10 +350,17 @@ class DmVolumeCatalog : public HasModuleProvider,
     fds_mutex volMapLock_;
 
     expunge_objs_cb_t expungeCb_;
+    objref_delta_cb_t objRefDeltaCb_;
 
     bool _ft_newStats;
 
     // methods
+    /**
+     * Reports that references of volId changed in a way that isn't tracked
+     * per object (catalog copied, synced or reloaded)
+     */
+    void notifyBulkRefChange(fds_volid_t volId);
+
     Error statVolumeInternal(fds_volid_t volId, fds_uint64_t * volSize,
                              fds_uint64_t * blobCount, fds_uint64_t * objCount,
                              sequence_id_t * maxSeqId);
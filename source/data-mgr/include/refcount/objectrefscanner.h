@@ -6,11 +6,14 @@
 
 #include <list>
 #include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 #include <fds_module.h>
 #include <fds_module_provider.h>
 #include <dmhandler.h>
 #include <fds_timer.h>
+#include <concurrency/RwLock.h>
 #include <util/stringutils.h>
 #include <util/bloomfilter.h>
 
@@ -172,6 +175,19 @@ struct SnapshotRefScanner : ObjectRefScannerIf {
 * 3. Each scan step is executed on qos threadpool.
 * 4. During each scan step configured number of level db entries are scanned and 
 * appropriate bloom filter for the volume is update.
+*
+* Incremental mode (objectrefscan.incremental.enable):
+* A full scan also seeds a counting bloomfilter per token.  From then on object
+* references added/removed by committed catalog updates are applied to those
+* counting bloomfilters, and incrementalScanOnce() publishes token bloomfilters
+* straight from them instead of rescanning every catalog.  Tracking is only
+* conservative (an object may be reported live when it isn't, never the other way):
+* - removals seen while a full scan is running are ignored
+* - saturated counters are never decremented
+* - any catalog change that isn't reported per object invalidates tracking until
+*   the next full scan
+* A full scan is still run every objectrefscan.incremental.full_scan_interval_hours
+* to drop the garbage accumulated by the above.
 */
 struct ObjectRefScanMgr : HasModuleProvider, Module {
     TYPE_SHAREDPTR(ObjectRefScanMgr);
@@ -182,8 +198,27 @@ struct ObjectRefScanMgr : HasModuleProvider, Module {
     virtual void mod_shutdown();
     /* Use this to manually start scan. Don't use it when timer based scan is enabled */
     void scanOnce();
+    /**
+    * @brief Same as scanOnce() but token bloomfilters are generated from tracked
+    * object references.  Should only be called when isIncrementalScanPossible()
+    */
+    void incrementalScanOnce();
+    /**
+    * @brief Returns true when tracked object references are valid and a full scan
+    * isn't due
+    */
+    bool isIncrementalScanPossible();
     bool isRunning();
 
+    /**
+    * @brief Applies object references changed by a committed catalog update to
+    * the tracked references.  Registered with the volume catalog.
+    */
+    void objectRefDeltaCb(fds_volid_t volId,
+                          const std::vector<ObjectID>& added,
+                          const std::vector<ObjectID>& removed,
+                          bool bulkChange);
+
     void setScanDoneCb(const ScanDoneCb &cb);
 
     util::BloomFilterPtr getTokenBloomFilter(const fds_token_id &tokenId);
@@ -221,6 +256,31 @@ struct ObjectRefScanMgr : HasModuleProvider, Module {
     * snapshots to scan
     */
     void prescanInit();
+    /**
+    * @brief Resets bloomfilter store and scan counters for a new scan cycle
+    */
+    void initBloomFilterStore();
+    /**
+    * @brief Generates token bloomfilters from the tracked references
+    */
+    void incrementalScanStep();
+
+    /* Tracked references, one counting bloomfilter per token */
+    enum RefTrackState {
+        /* Not usable until a full scan seeds it */
+        REFTRACK_INVALID,
+        /* Full scan in progress.  Additions are applied, removals ignored */
+        REFTRACK_SEEDING,
+        /* Seeded, both additions and removals are applied */
+        REFTRACK_VALID
+    };
+    struct TokenRefs {
+        std::mutex                              lock;
+        util::CountingBloomFilterPtr            refs;
+    };
+    void trackObjectRefs(const std::vector<ObjectID>& oids, bool fAdd);
+    void trackScannedObjectRefs(const fds_token_id &tokenId, const std::list<ObjectID>& oids);
+    void invalidateRefTracking(const std::string &reason);
 
     enum State {
         STOPPED,
@@ -244,6 +304,21 @@ struct ObjectRefScanMgr : HasModuleProvider, Module {
     ScanDoneCb                                  scandoneCb;
     uint32_t                                    scanCntr;
     uint64_t                                    objectsScannedCntr;
+
+    bool                                        incrementalEnabled;
+    /* Maximum time between full scans when running incrementally */
+    uint64_t                                    fullScanIntervalSecs;
+    uint32_t                                    bfSize;
+    /* Write locked to reset tracked references.  Read locked to apply to them.
+     * Counting bloomfilter of a token is additionally protected by TokenRefs::lock
+     */
+    fds_rwlock                                  refTrackLock;
+    std::atomic<RefTrackState>                  refTrackState;
+    /* Volumes whose references are tracked.  Same as volumes covered by the seeding scan */
+    std::set<fds_volid_t>                       refTrackVols;
+    uint32_t                                    refTrackTokenBits;
+    std::vector<std::unique_ptr<TokenRefs>>     tokenRefs;
+    util::TimeStamp                             lastFullScanTs;
     friend class VolumeRefScannerContext;
     friend class VolumeObjectRefScanner;
 };
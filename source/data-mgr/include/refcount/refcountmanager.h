@@ -21,6 +21,11 @@ struct RefCountManager : Module {
     virtual void mod_startup();
     virtual void mod_shutdown();
 
+    /**
+    * @brief Hooks the scanner up with the volume catalog so that it can track
+    * object references in between full scans.  Call once the catalog exists.
+    */
+    void registerObjectRefTracking();
     void scanActiveObjects(bool fFromSM, bool fSchedule=true);
     void scanDoneCb(ObjectRefScanMgr*);
     void sendRefScanDoneMessage();
@@ -33,6 +38,11 @@ struct RefCountManager : Module {
                                      const Error& error,
                                      SHPTR<std::string> payload);
   protected:
+    /**
+    * @brief Runs an incremental refscan when tracked references allow it, else a full one
+    */
+    void runScan();
+
     SHPTR<ObjectRefScanMgr> scanner;
     DataMgr* dm;
     SvcMgr* svcMgr;
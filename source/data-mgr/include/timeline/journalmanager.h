@@ -5,7 +5,10 @@
 #ifndef SOURCE_DATA_MGR_INCLUDE_TIMELINE_JOURNALMANAGER_H_
 #define SOURCE_DATA_MGR_INCLUDE_TIMELINE_JOURNALMANAGER_H_
 #include <util/timeutils.h>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 namespace fds {
 struct DataMgr;
 namespace timeline {
@@ -16,7 +19,8 @@ struct JournalManager {
     Error replayTransactions(Catalog& destCat,
                              const std::vector<std::string> &files,
                              util::TimeStamp fromTime,
-                             util::TimeStamp toTime);
+                             util::TimeStamp toTime,
+                             const std::vector<fds_uint64_t> &startOffsets = {});
 
     Error replayTransactions(fds_volid_t srcVolId,
                              fds_volid_t destVolId,
@@ -30,10 +34,26 @@ struct JournalManager {
     SHPTR<std::thread> logMonitor;
     void monitorLogs();
     void removeExpiredJournals();
+    /**
+     * Watches a volume's catalog directory for archived journals, and
+     * archives the ones already there
+     */
+    void watchVolumeDir(int fd, const std::string &volDirName);
+    /**
+     * Moves a journal archived by the volume's catalog to the timeline
+     * directory, compressed and indexed by time.  A journal already gone,
+     * or dropped because the repo is full, is not an error.
+     * @return an error only if the journal is still there to retry
+     */
+    Error archiveJournal(const std::string &volDirName, const std::string &fileName);
   private:
     fds::DataMgr* dm;
     int inotifyFd;
     bool fStopLogMonitoring;
+    // volume directory watched by each inotify watch descriptor
+    std::map<int, std::string> volumeWatches;
+    // journals that failed to archive, retried when polling times out
+    std::vector<std::pair<std::string, std::string>> failedJournals;
 };
 }  // namespace timeline
 }  // namespace fds
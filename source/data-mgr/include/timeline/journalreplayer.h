@@ -0,0 +1,84 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_DATA_MGR_INCLUDE_TIMELINE_JOURNALREPLAYER_H_
+#define SOURCE_DATA_MGR_INCLUDE_TIMELINE_JOURNALREPLAYER_H_
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <util/timeutils.h>
+#include <fds_error.h>
+#include <lib/Catalog.h>
+namespace fds {
+namespace timeline {
+
+/**
+ * Replays catalog journals onto a catalog, e.g. to build a clone of a volume
+ * as of a point in time.
+ *
+ * Instead of applying every journaled write batch, the journal files are
+ * scanned in parallel and collapsed to the last write of every key up to
+ * toTime (a delete is kept as a tombstone), then the result is written in
+ * large unsynced batches followed by one synced write.  Every batch carries
+ * the timestamp record of the last write batch replayed.
+ *
+ * The collapsed keys of all files are held in memory until they are written.
+ */
+class JournalReplayer {
+  public:
+    static const fds_uint32_t DEFAULT_SCAN_THREADS = 4;
+    static const size_t BATCH_BYTES = 4 * 1024 * 1024;
+
+    JournalReplayer(util::TimeStamp fromTime,
+                    util::TimeStamp toTime,
+                    fds_uint32_t scanThreads = DEFAULT_SCAN_THREADS,
+                    size_t batchBytes = BATCH_BYTES);
+
+    /**
+     * @param files journal files, oldest first
+     * @param startOffsets where to start reading the files (e.g. the first
+     *        one at fromTime), from their start if not given
+     * @return ERR_DM_REPLAY_JOURNAL if no write batch was in the time range
+     */
+    Error replay(Catalog& destCat, const std::vector<std::string> &files,
+                 const std::vector<fds_uint64_t> &startOffsets = {});
+
+    /**
+     * Journaled write batches replayed and keys written by the last replay
+     */
+    inline fds_uint64_t getBatchesReplayed() const {
+        return batchesReplayed;
+    }
+    inline fds_uint64_t getKeysWritten() const {
+        return keysWritten;
+    }
+
+  private:
+    struct KeyUpdate {
+        fds_bool_t deleted;
+        std::string value;
+    };
+    typedef std::unordered_map<std::string, KeyUpdate> KeyUpdates;
+
+    /**
+     * Collapses the write batches of a journal file in the time range
+     * @param lastTs raised to the timestamp of the last batch collapsed
+     * @return the number of write batches collapsed
+     */
+    fds_uint64_t scanFile(const std::string &file, fds_uint64_t startOffset,
+                          KeyUpdates &updates, util::TimeStamp &lastTs) const;
+    Error write(Catalog& destCat, const KeyUpdates &updates, util::TimeStamp lastTs);
+
+    util::TimeStamp fromTime;
+    util::TimeStamp toTime;
+    fds_uint32_t scanThreads;
+    size_t batchBytes;
+
+    fds_uint64_t batchesReplayed {0};
+    fds_uint64_t keysWritten {0};
+};
+
+}  // namespace timeline
+}  // namespace fds
+
+#endif  // SOURCE_DATA_MGR_INCLUDE_TIMELINE_JOURNALREPLAYER_H_
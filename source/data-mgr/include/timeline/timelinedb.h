@@ -9,6 +9,7 @@
 #include <util/timeutils.h>
 #include <sqlite3.h>
 #include <fds_error.h>
+#include <leveldb/journal_archive.h>
 #include <ostream>
 namespace fds {
 using util::TimeStamp;
@@ -35,6 +36,17 @@ class TimelineDB : public HasLogger {
                                 std::vector<JournalFileInfo>& vecJournalFiles);
     Error getJournalFiles(fds_volid_t volId, TimeStamp fromTime, TimeStamp toTime,
                    std::vector<JournalFileInfo>& vecJournalFiles);
+    /**
+     * Time index of an archived journal, see leveldb::archiveJournal()
+     */
+    Error addJournalIndex(fds_volid_t volId, const std::string& journalFile,
+                          const std::vector<leveldb::JournalIndexEntry>& index);
+    /**
+     * Offset in the journal to read from to get the write batches from
+     * fromTime on, 0 if the journal has no index
+     */
+    Error getJournalOffset(const std::string& journalFile, TimeStamp fromTime,
+                           fds_uint64_t& offset);
     Error addSnapshot(fds_volid_t volId, fds_volid_t snapshotId, TimeStamp createTime);
     Error removeSnapshot(fds_volid_t snapshotId);
     Error getLatestSnapshotAt(fds_volid_t volId,
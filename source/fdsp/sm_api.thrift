@@ -124,6 +124,43 @@ struct PutObjectMsg {
 struct PutObjectRspMsg {
 }
 
+/**
+ * Retrieve a batch of objects with one message.  All objects map to the
+ * same DLT token group.
+ */
+struct GetObjectBatchMsg {
+  /** Objects to retrieve, each with its own volume. */
+  1: list<GetObjectMsg>         objects;
+}
+
+/**
+ * Batched object retrieval response.  Entries are in request order.
+ */
+struct GetObjectBatchRspMsg {
+  /** Per object error code. */
+  1: list<i32>                  statuses;
+  /** Object data.  Valid only where the status is ERR_OK. */
+  2: list<GetObjectResp>        objects;
+}
+
+/**
+ * Put a batch of objects with one message.  All objects map to the
+ * same DLT token group.
+ */
+struct PutObjectBatchMsg {
+  /** Objects to put, each with its own volume. */
+  1: list<PutObjectMsg>         objects;
+}
+
+/**
+ * Batched put response.  Message status is the first failed object's
+ * error so that quorum accounting sees any failure.
+ */
+struct PutObjectBatchRspMsg {
+  /** Per object error code, in request order. */
+  1: list<i32>                  statuses;
+}
+
 /* ------------------------------------------------------------
    Operations for Data Verification
    ------------------------------------------------------------*/
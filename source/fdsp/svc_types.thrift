@@ -348,6 +348,10 @@ enum  FDSPMsgTypeId {
   PrepareForShutdownMsgTypeId               = 10008;
   ActiveObjectsMsgTypeId                    = 10009;
   ActiveObjectsRspMsgTypeId                 = 10010;
+  GetObjectBatchMsgTypeId                   = 10011;
+  GetObjectBatchRspMsgTypeId                = 10012;
+  PutObjectBatchMsgTypeId                   = 10013;
+  PutObjectBatchRspMsgTypeId                = 10014;
 
   /** DM Type Ids */
   QueryCatalogMsgTypeId                     = 20000;
@@ -511,6 +515,8 @@ struct AsyncHdr {
   9: optional i32               replicaVersion = 0;
   /* Header specific for payload */
   10: optional binary           payloadHdr;
+  /* Sampled stage trace id, 0 when the request isn't traced.  See util/StageTrace.h */
+  11: optional i64              trace_id = 0;
 }
 
 
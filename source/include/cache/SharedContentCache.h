@@ -0,0 +1,370 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_CACHE_SHAREDCONTENTCACHE_H_
+#define SOURCE_INCLUDE_CACHE_SHAREDCONTENTCACHE_H_
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "boost/smart_ptr/make_shared.hpp"
+#include "boost/smart_ptr/shared_ptr.hpp"
+
+#include "concurrency/RwLock.h"
+#include "fds_error.h"
+#include "fds_types.h"
+#include "util/Log.h"
+#include "cache/SharedKvCache.h"
+
+namespace fds {
+
+/**
+ * A cache of content addressed values (the key is derived from the value, e.g.
+ * an object id) shared by all volumes. A value is cached once no matter how
+ * many volumes read or write it, and a hit from any volume counts.
+ *
+ * The cache has a global size limit, entries are evicted least recently used
+ * first once it is reached. On top of that every volume has a quota: an entry
+ * counts against the quota of each volume that added or read it. A volume over
+ * its quota lets go of the entries it used least recently, and an entry no
+ * volume holds on to is evicted.
+ *
+ * Sizes are in the terms of size_calc, same as SharedKvCache.
+ *
+ * Keys are spread over shards by hash, each with its own lock and LRU, so
+ * lookups of different objects don't serialize on one lock. The limits are
+ * split evenly between the shards.
+ *
+ * This class IS thread safe
+ */
+template<class K, class V, class _Hash = std::hash<K>>
+class SharedContentCache : boost::noncopyable {
+    public:
+     typedef K key_type;
+     typedef V mapped_type;
+     typedef _Hash hash_type;
+     typedef std::size_t size_type;
+     typedef boost::shared_ptr<mapped_type> value_type;
+
+    private:
+     /**
+      * One stripe of the cache: the keys that hash to it with their own
+      * lock, LRU and share of the size limit and volume quotas
+      */
+     class shard_type;
+
+    public:
+     /**
+      * @param[in] _max_size     Size limit of the whole cache
+      * @param[in] shard_count   Stripes the keys are spread over. The size
+      *                          limit and volume quotas are split evenly
+      *                          between them (rounded up) and entries are
+      *                          evicted least recently used per stripe.
+      */
+     explicit SharedContentCache(size_type const _max_size, size_type const shard_count = 1) {
+         size_type const count = std::max<size_type>(shard_count, 1);
+         shards.reserve(count);
+         for (size_type i = 0; i < count; ++i) {
+             shards.emplace_back(new shard_type(share_(_max_size, count)));
+         }
+     }
+
+     ~SharedContentCache() = default;
+
+     /**
+      * Starts accounting for a volume.
+      * @param[in] volId   Volume ID
+      * @param[in] quota   Most the volume's entries may add up to
+      *
+      * @return ERR_VOL_DUPLICATE if the volume is already known
+      */
+     Error addVolume(fds_volid_t const volId, size_type const quota) {
+         // The first shard decides, so only one caller adds the volume to the rest
+         size_type const shareOfQuota = share_(quota, shards.size());
+         Error err = shards.front()->addVolume(volId, shareOfQuota);
+         for (size_type i = 1; err.ok() && i < shards.size(); ++i) {
+             shards[i]->addVolume(volId, shareOfQuota);
+         }
+         return err;
+     }
+
+     /**
+      * Stops accounting for a volume. Entries only it held on to are evicted.
+      *
+      * @return ERR_NOT_FOUND if the volume isn't known
+      */
+     Error removeVolume(fds_volid_t const volId) {
+         Error err = shards.front()->removeVolume(volId);
+         for (size_type i = 1; err.ok() && i < shards.size(); ++i) {
+             shards[i]->removeVolume(volId);
+         }
+         return err;
+     }
+
+     /**
+      * Adds a value on behalf of a volume. If the key is already cached the
+      * cached value is kept, content addressed values for a key don't differ.
+      *
+      * @return true if entries were evicted
+      */
+     bool add(fds_volid_t const volId, key_type const& key, value_type const& value) {
+         return shardOf_(key).add(volId, key, value);
+     }
+
+     bool add(fds_volid_t const volId, key_type const& key, mapped_type const& value) {
+         return add(volId, key, boost::make_shared<mapped_type>(value));
+     }
+
+     /**
+      * Returns the cached value for the key, whichever volume cached it.
+      * The entry then counts against volume's quota as well.
+      *
+      * @return ERR_OK if a value is returned, ERR_NOT_FOUND otherwise
+      */
+     Error get(fds_volid_t const volId, key_type const& key, value_type& value_out) {
+         return shardOf_(key).get(volId, key, value_out);
+     }
+
+     /**
+      * Total size of the cached values
+      */
+     size_type getSize() const {
+         size_type size = 0;
+         for (auto& shard : shards) {
+             size += shard->getSize();
+         }
+         return size;
+     }
+
+     /**
+      * Size of the values a volume holds on to, shared ones count fully
+      */
+     size_type getVolumeSize(fds_volid_t const volId) const {
+         size_type size = 0;
+         for (auto& shard : shards) {
+             size += shard->getVolumeSize(volId);
+         }
+         return size;
+     }
+
+     /**
+      * Hits on entries the volume didn't hold on to: cached for other volumes
+      */
+     size_type getSharedHits() const {
+         size_type hits = 0;
+         for (auto& shard : shards) {
+             hits += shard->getSharedHits();
+         }
+         return hits;
+     }
+
+    private:
+     std::vector<std::unique_ptr<shard_type>> shards;
+     hash_type hash_fn;
+
+     static size_type share_(size_type const total, size_type const count) {
+         return (total + count - 1) / count;
+     }
+
+     shard_type& shardOf_(key_type const& key) {
+         return *shards[hash_fn(key) % shards.size()];
+     }
+};
+
+template<class K, class V, class _Hash>
+class SharedContentCache<K, V, _Hash>::shard_type : boost::noncopyable {
+    private:
+     struct entry_type;
+     typedef std::list<entry_type*> volume_lru_type;
+
+     struct entry_type {
+         entry_type(key_type const& k, value_type const& v, size_type const s)
+             : key(k), value(v), size(s) {}
+         key_type key;
+         value_type value;
+         size_type size;
+         // Volumes holding on to this entry, with its place in their LRU
+         std::vector<std::pair<fds_volid_t, typename volume_lru_type::iterator>> refs;
+     };
+     typedef std::list<entry_type> lru_type;
+
+     struct volume_type {
+         explicit volume_type(size_type const q) : quota(q) {}
+         size_type quota;
+         size_type size {0};
+         volume_lru_type lru;
+     };
+
+    public:
+     explicit shard_type(size_type const _max_size) :
+         max_size(_max_size) { }
+
+     Error addVolume(fds_volid_t const volId, size_type const quota) {
+         SCOPEDWRITE(cache_lock);
+         if (!volumes.emplace(volId, volume_type(quota)).second) {
+             return ERR_VOL_DUPLICATE;
+         }
+         return ERR_OK;
+     }
+
+     Error removeVolume(fds_volid_t const volId) {
+         SCOPEDWRITE(cache_lock);
+         auto volIt = volumes.find(volId);
+         if (volumes.end() == volIt) {
+             return ERR_NOT_FOUND;
+         }
+         auto& vol = volIt->second;
+         while (!vol.lru.empty()) {
+             release_(volId, vol, vol.lru.back());
+         }
+         volumes.erase(volIt);
+         return ERR_OK;
+     }
+
+     bool add(fds_volid_t const volId, key_type const& key, value_type const& value) {
+         SCOPEDWRITE(cache_lock);
+         auto volIt = volumes.find(volId);
+         if (volumes.end() == volIt) {
+             LOGDEBUG << "Failed to find volume: " << volId
+                      << " to insert element [" << key << "]";
+             return false;
+         }
+
+         entry_type* entry;
+         auto mapIt = cache_map.find(key);
+         if (cache_map.end() != mapIt) {
+             eviction_list.splice(eviction_list.begin(), eviction_list, mapIt->second);
+             entry = &*mapIt->second;
+         } else {
+             eviction_list.emplace_front(key, value, calc_size(value));
+             cache_map[key] = eviction_list.begin();
+             entry = &eviction_list.front();
+             current_size += entry->size;
+         }
+         hold_(volId, volIt->second, entry);
+
+         bool was_evicted = trimVolume_(volId, volIt->second);
+         while (current_size > max_size) {
+             evict_(&eviction_list.back());
+             was_evicted = true;
+         }
+         return was_evicted;
+     }
+
+     Error get(fds_volid_t const volId, key_type const& key, value_type& value_out) {
+         SCOPEDWRITE(cache_lock);
+         auto volIt = volumes.find(volId);
+         if (volumes.end() == volIt) {
+             return ERR_NOT_FOUND;
+         }
+         auto mapIt = cache_map.find(key);
+         if (cache_map.end() == mapIt) {
+             return ERR_NOT_FOUND;
+         }
+
+         eviction_list.splice(eviction_list.begin(), eviction_list, mapIt->second);
+         entry_type* entry = &*mapIt->second;
+         value_out = entry->value;
+         if (hold_(volId, volIt->second, entry)) {
+             ++shared_hits;
+         }
+         trimVolume_(volId, volIt->second);
+         return ERR_OK;
+     }
+
+     size_type getSize() const {
+         SCOPEDREAD(cache_lock);
+         return current_size;
+     }
+
+     size_type getVolumeSize(fds_volid_t const volId) const {
+         SCOPEDREAD(cache_lock);
+         auto volIt = volumes.find(volId);
+         return (volumes.end() == volIt) ? 0 : volIt->second.size;
+     }
+
+     size_type getSharedHits() const {
+         SCOPEDREAD(cache_lock);
+         return shared_hits;
+     }
+
+    private:
+     size_type max_size;
+     size_calc<value_type> calc_size;
+
+     lru_type eviction_list;
+     size_type current_size {0};
+     std::unordered_map<key_type, typename lru_type::iterator, hash_type> cache_map;
+     std::unordered_map<fds_volid_t, volume_type> volumes;
+     size_type shared_hits {0};
+
+     mutable fds_rwlock cache_lock;
+
+     /**
+      * Makes entry the volume's most recently used. Returns true if the volume
+      * didn't hold on to it before.
+      */
+     bool hold_(fds_volid_t const volId, volume_type& vol, entry_type* entry) {
+         for (auto& ref : entry->refs) {
+             if (ref.first == volId) {
+                 vol.lru.splice(vol.lru.begin(), vol.lru, ref.second);
+                 return false;
+             }
+         }
+         vol.lru.push_front(entry);
+         entry->refs.emplace_back(volId, vol.lru.begin());
+         vol.size += entry->size;
+         return true;
+     }
+
+     /**
+      * The volume lets go of entry, which is evicted if no other volume holds on to it
+      */
+     void release_(fds_volid_t const volId, volume_type& vol, entry_type* entry) {
+         for (auto it = entry->refs.begin(); entry->refs.end() != it; ++it) {
+             if (it->first == volId) {
+                 vol.lru.erase(it->second);
+                 vol.size -= entry->size;
+                 entry->refs.erase(it);
+                 break;
+             }
+         }
+         if (entry->refs.empty()) {
+             erase_(entry);
+         }
+     }
+
+     bool trimVolume_(fds_volid_t const volId, volume_type& vol) {
+         bool trimmed { false };
+         while (vol.size > vol.quota && !vol.lru.empty()) {
+             release_(volId, vol, vol.lru.back());
+             trimmed = true;
+         }
+         return trimmed;
+     }
+
+     void evict_(entry_type* entry) {
+         for (auto& ref : entry->refs) {
+             auto& vol = volumes.at(ref.first);
+             vol.lru.erase(ref.second);
+             vol.size -= entry->size;
+         }
+         entry->refs.clear();
+         erase_(entry);
+     }
+
+     void erase_(entry_type* entry) {
+         auto mapIt = cache_map.find(entry->key);
+         current_size -= entry->size;
+         eviction_list.erase(mapIt->second);
+         cache_map.erase(mapIt);
+     }
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CACHE_SHAREDCONTENTCACHE_H_
@@ -0,0 +1,58 @@
+///
+/// @copyright 2016 Formation Data Systems, Inc.
+///
+
+#ifndef SOURCE_INCLUDE_CATALOGKEYS_BLOBEXTENTKEY_H_
+#define SOURCE_INCLUDE_CATALOGKEYS_BLOBEXTENTKEY_H_
+
+// Standard includes.
+#include <string>
+#include <vector>
+
+// Internal includes.
+#include "CatalogKey.h"
+#include "fds_types.h"
+
+// Forward declarations.
+namespace leveldb {
+
+class Slice;
+
+}  // namespace leveldb
+
+namespace fds {
+
+///
+/// Key of a page of a blob's object offsets, used by the extent map catalog layout.
+///
+class BlobExtentKey : public CatalogKey
+{
+public:
+
+    explicit BlobExtentKey (leveldb::Slice const& leveldbKey);
+    explicit BlobExtentKey (std::string const& blobName);
+    BlobExtentKey (std::string const& blobName, fds_uint32_t pageIndex);
+
+    BlobExtentKey& operator= (BlobExtentKey const& other);
+    BlobExtentKey& operator= (BlobExtentKey&& other);
+
+    std::string getBlobName () const;
+
+    fds_uint32_t getPageIndex () const;
+
+    void setBlobName (std::string const& value);
+
+    void setPageIndex (fds_uint32_t value);
+
+protected:
+
+    std::string getClassName () const override;
+
+    std::vector<std::string> toStringMembers () const override;
+
+    static constexpr size_t getNewDataSize ();
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CATALOGKEYS_BLOBEXTENTKEY_H_
@@ -44,6 +44,11 @@ enum class CatalogKeyType : unsigned char
     ///
     OBJECT_RANK = 6,
 
+    ///
+    /// Objects in a blob, a page of consecutive object offsets per key.
+    ///
+    BLOB_EXTENTS = 7,
+
     ///
     /// Reserved for future use.
     ///
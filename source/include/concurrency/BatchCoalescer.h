@@ -0,0 +1,190 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_CONCURRENCY_BATCHCOALESCER_H_
+#define SOURCE_INCLUDE_CONCURRENCY_BATCHCOALESCER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fds {
+
+/**
+ * @brief Coalesces items added concurrently under the same key into batches.
+ *
+ * The first item added for a key opens a batch.  The batch is handed to the
+ * flush callback once it holds maxItems items or maxBytes bytes, or once window
+ * has passed since it was opened, whichever comes first.  Full batches are
+ * flushed on the thread that filled them, expired ones on the coalescer's own
+ * thread.  Callbacks are never invoked with the coalescer lock held.
+ *
+ * An item whose size alone exceeds maxBytes is flushed as a batch of one, and
+ * so is an item added after stop().
+ */
+template <typename Key, typename Item, typename Hash = std::hash<Key>>
+class BatchCoalescer {
+  public:
+    using Batch = std::vector<Item>;
+    using FlushCb = std::function<void (const Key&, Batch&&)>;
+    using Clock = std::chrono::steady_clock;
+
+    BatchCoalescer(std::chrono::microseconds window,
+                   size_t maxItems,
+                   size_t maxBytes,
+                   FlushCb flushCb)
+            : window_(window),
+              maxItems_(std::max<size_t>(maxItems, 1)),
+              maxBytes_(maxBytes),
+              flushCb_(flushCb),
+              stopping_(false) {
+        flusher_ = std::thread(&BatchCoalescer::run, this);
+    }
+
+    BatchCoalescer(const BatchCoalescer&) = delete;
+    BatchCoalescer& operator=(const BatchCoalescer&) = delete;
+
+    ~BatchCoalescer() {
+        stop();
+    }
+
+    /**
+     * Adds item to the open batch for key.
+     * @param bytes size the item contributes towards maxBytes
+     */
+    void add(const Key& key, Item item, size_t bytes = 0) {
+        std::vector<std::pair<Key, Batch>> ready;
+        bool opened = false;
+        {
+            std::lock_guard<std::mutex> l(lock_);
+            if (stopping_) {
+                /* Nobody would flush it, send it on its own */
+                ready.emplace_back(key, Batch());
+                ready.back().second.push_back(std::move(item));
+            } else {
+                auto itr = pending_.find(key);
+                if (itr != pending_.end() &&
+                    itr->second.bytes + bytes > maxBytes_) {
+                    /* Doesn't fit, send what we have and start over */
+                    ready.emplace_back(key, std::move(itr->second.items));
+                    pending_.erase(itr);
+                    itr = pending_.end();
+                }
+                if (itr == pending_.end()) {
+                    itr = pending_.emplace(key, PendingBatch()).first;
+                    itr->second.deadline = Clock::now() + window_;
+                    opened = true;
+                }
+                itr->second.items.push_back(std::move(item));
+                itr->second.bytes += bytes;
+                if (itr->second.items.size() >= maxItems_ ||
+                    itr->second.bytes >= maxBytes_) {
+                    ready.emplace_back(key, std::move(itr->second.items));
+                    pending_.erase(itr);
+                    opened = false;
+                }
+            }
+        }
+        if (opened) {
+            cv_.notify_one();
+        }
+        for (auto &r : ready) {
+            flushCb_(r.first, std::move(r.second));
+        }
+    }
+
+    /**
+     * Flushes every open batch on the calling thread
+     */
+    void flushAll() {
+        decltype(pending_) pending;
+        {
+            std::lock_guard<std::mutex> l(lock_);
+            pending.swap(pending_);
+        }
+        for (auto &kv : pending) {
+            flushCb_(kv.first, std::move(kv.second.items));
+        }
+    }
+
+    /**
+     * Stops the flusher thread and flushes what is still open
+     */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> l(lock_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (flusher_.joinable()) {
+            flusher_.join();
+        }
+        flushAll();
+    }
+
+  private:
+    struct PendingBatch {
+        Batch               items;
+        size_t              bytes {0};
+        Clock::time_point   deadline;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> l(lock_);
+        while (!stopping_) {
+            if (pending_.empty()) {
+                cv_.wait(l);
+                continue;
+            }
+
+            auto now = Clock::now();
+            auto nextDeadline = Clock::time_point::max();
+            std::vector<std::pair<Key, Batch>> ready;
+            for (auto itr = pending_.begin(); itr != pending_.end();) {
+                if (itr->second.deadline <= now) {
+                    ready.emplace_back(itr->first, std::move(itr->second.items));
+                    itr = pending_.erase(itr);
+                } else {
+                    nextDeadline = std::min(nextDeadline, itr->second.deadline);
+                    ++itr;
+                }
+            }
+
+            if (!ready.empty()) {
+                l.unlock();
+                for (auto &r : ready) {
+                    flushCb_(r.first, std::move(r.second));
+                }
+                l.lock();
+                continue;
+            }
+            cv_.wait_until(l, nextDeadline);
+        }
+    }
+
+    const std::chrono::microseconds                     window_;
+    const size_t                                        maxItems_;
+    const size_t                                        maxBytes_;
+    FlushCb                                             flushCb_;
+
+    std::mutex                                          lock_;
+    std::condition_variable                             cv_;
+    std::unordered_map<Key, PendingBatch, Hash>         pending_;
+    bool                                                stopping_;
+    std::thread                                         flusher_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CONCURRENCY_BATCHCOALESCER_H_
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_CONCURRENCY_RCUPTR_H_
+#define SOURCE_INCLUDE_CONCURRENCY_RCUPTR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <concurrency/ShardedCounter.h>
+
+namespace fds {
+
+/**
+ * @brief Process wide epoch state behind RcuPtr.
+ *
+ * Every thread that reads through an RcuPtr owns a slot in which it announces
+ * the epoch it entered its read section in (0 when it is outside of one).
+ * Writers advance the epoch when they unpublish an object; the object can be
+ * freed once no slot announces an epoch at or below the one it was retired in.
+ *
+ * Threads that find all MAX_READERS slots taken announce their epoch in a
+ * set under a lock instead, so their read sections still work but serialize
+ * on that lock.
+ */
+class RcuDomain {
+  public:
+    static const size_t MAX_READERS = 1024;
+
+    struct ReaderSlot {
+        alignas(FDS_CACHELINE_SIZE) std::atomic<uint64_t> epoch;
+        std::atomic<bool>                              inUse;
+    };
+
+    static RcuDomain& instance() {
+        static RcuDomain domain;
+        return domain;
+    }
+
+    void enter() {
+        SlotHandle& handle = threadHandle();
+        if (handle.nesting++ != 0) {
+            return;
+        }
+        if (handle.slot != nullptr) {
+            handle.slot->epoch.store(epoch_.load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+        } else {
+            std::lock_guard<std::mutex> l(overflowLock_);
+            handle.overflowEpoch = overflowEpochs_.insert(epoch_.load());
+            overflowReaders_.fetch_add(1);
+        }
+        /* Announcement must be visible before the reader loads any pointer */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void exit() {
+        SlotHandle& handle = threadHandle();
+        if (--handle.nesting != 0) {
+            return;
+        }
+        if (handle.slot != nullptr) {
+            handle.slot->epoch.store(0, std::memory_order_release);
+        } else {
+            std::lock_guard<std::mutex> l(overflowLock_);
+            overflowEpochs_.erase(handle.overflowEpoch);
+            overflowReaders_.fetch_sub(1);
+        }
+    }
+
+    /**
+     * Called after unpublishing an object.
+     * @return the epoch the object is retired in
+     */
+    uint64_t advance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    /**
+     * Objects retired in an epoch below this one can be freed
+     */
+    uint64_t minActiveEpoch() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t min = std::numeric_limits<uint64_t>::max();
+        size_t hwm = highWater_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < hwm; ++i) {
+            uint64_t e = slots_[i].epoch.load(std::memory_order_acquire);
+            if (e != 0 && e < min) {
+                min = e;
+            }
+        }
+        if (overflowReaders_.load() != 0) {
+            std::lock_guard<std::mutex> l(overflowLock_);
+            if (!overflowEpochs_.empty() && *overflowEpochs_.begin() < min) {
+                min = *overflowEpochs_.begin();
+            }
+        }
+        return min;
+    }
+
+    /**
+     * Number of threads in a read section without a slot of their own
+     */
+    size_t overflowReaders() const {
+        return overflowReaders_.load();
+    }
+
+  private:
+    /**
+     * The calling thread's slot, claimed on first use and given back when
+     * the thread exits.  No slot if they were all taken.
+     */
+    struct SlotHandle {
+        explicit SlotHandle(RcuDomain& d) : slot(d.claimSlot()), nesting(0) {}
+        ~SlotHandle() {
+            if (slot != nullptr) {
+                slot->epoch.store(0, std::memory_order_release);
+                slot->inUse.store(false, std::memory_order_release);
+            }
+        }
+        ReaderSlot*                         slot;
+        uint32_t                            nesting;
+        std::multiset<uint64_t>::iterator   overflowEpoch;
+    };
+
+    RcuDomain() : epoch_(1), highWater_(0), overflowReaders_(0) {
+        for (auto &s : slots_) {
+            s.epoch = 0;
+            s.inUse = false;
+        }
+    }
+
+    SlotHandle& threadHandle() {
+        static thread_local SlotHandle handle(*this);
+        return handle;
+    }
+
+    ReaderSlot* claimSlot() {
+        for (size_t i = 0; i < MAX_READERS; ++i) {
+            bool expected = false;
+            if (!slots_[i].inUse.load(std::memory_order_relaxed) &&
+                slots_[i].inUse.compare_exchange_strong(expected, true)) {
+                size_t hwm = highWater_.load();
+                while (hwm < i + 1 && !highWater_.compare_exchange_weak(hwm, i + 1)) {
+                }
+                return &slots_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    std::atomic<uint64_t>       epoch_;
+    std::atomic<size_t>         highWater_;
+    ReaderSlot                  slots_[MAX_READERS];
+
+    /* Read sections of threads without a slot */
+    std::atomic<size_t>         overflowReaders_;
+    mutable std::mutex          overflowLock_;
+    std::multiset<uint64_t>     overflowEpochs_;
+};
+
+/**
+ * @brief Marks a read side critical section for RcuPtr.  Objects loaded from
+ * any RcuPtr inside the section stay valid until the guard goes away.
+ * Sections nest and cost two thread local stores and a fence, no shared
+ * cache line is written.
+ */
+class RcuReadGuard {
+  public:
+    RcuReadGuard() { RcuDomain::instance().enter(); }
+    ~RcuReadGuard() { RcuDomain::instance().exit(); }
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+};
+
+/**
+ * @brief Pointer to an immutable object that is read lock free and replaced
+ * by publishing a new object (read-copy-update).
+ *
+ * Readers call get() inside an RcuReadGuard.  publish() swaps the pointer and
+ * retires the previous object, which is deleted once every read section that
+ * could have seen it has ended.  Writers serialize among themselves; reclaim
+ * is attempted on every publish, so retired objects linger at most until the
+ * next one after the last reader is done.
+ */
+template <typename T>
+class RcuPtr {
+  public:
+    RcuPtr() : ptr_(nullptr) {}
+    explicit RcuPtr(T* p) : ptr_(p) {}
+
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    /* Callers guarantee no reader is left */
+    ~RcuPtr() {
+        delete ptr_.load();
+        for (auto &r : retired_) {
+            delete r.second;
+        }
+    }
+
+    /**
+     * Read side.  Must be called within an RcuReadGuard and the result not
+     * used past it.
+     */
+    const T* get() const {
+        return ptr_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Makes p the current object, takes ownership of it
+     */
+    void publish(T* p) {
+        std::lock_guard<std::mutex> l(writeLock_);
+        T* old = ptr_.exchange(p, std::memory_order_seq_cst);
+        uint64_t retiredIn = RcuDomain::instance().advance();
+        if (old != nullptr) {
+            retired_.emplace_back(retiredIn, old);
+        }
+        reclaimLocked();
+    }
+
+    /**
+     * Frees what no reader can see anymore
+     */
+    void reclaim() {
+        std::lock_guard<std::mutex> l(writeLock_);
+        reclaimLocked();
+    }
+
+    /**
+     * Number of retired objects still waiting on readers
+     */
+    size_t pendingReclaim() const {
+        std::lock_guard<std::mutex> l(writeLock_);
+        return retired_.size();
+    }
+
+  private:
+    void reclaimLocked() {
+        if (retired_.empty()) {
+            return;
+        }
+        uint64_t minActive = RcuDomain::instance().minActiveEpoch();
+        size_t kept = 0;
+        for (size_t i = 0; i < retired_.size(); ++i) {
+            if (retired_[i].first < minActive) {
+                delete retired_[i].second;
+            } else {
+                retired_[kept++] = retired_[i];
+            }
+        }
+        retired_.resize(kept);
+    }
+
+    std::atomic<T*>                             ptr_;
+    mutable std::mutex                          writeLock_;
+    std::vector<std::pair<uint64_t, T*>>        retired_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CONCURRENCY_RCUPTR_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_CONCURRENCY_SEQUENCEIDALLOCATOR_H_
+#define SOURCE_INCLUDE_CONCURRENCY_SEQUENCEIDALLOCATOR_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include <concurrency/ShardedCounter.h>
+
+namespace fds {
+
+/**
+ * @brief Hands out unique 64 bit ids from a shared sequence.
+ *
+ * With a range size of 1 every id is a fetch_add on the shared sequence, which
+ * sits on a cache line of its own.  With a larger range size a thread takes
+ * that many ids from the sequence at a time and hands them out from a thread
+ * local range, so the shared line is only touched once per range.  Ids are then
+ * unique but no longer in allocation order across threads, and ids left in a
+ * thread's range when it exits are never used.
+ *
+ * A thread keeps the range of one allocator.  A thread alternating between
+ * allocators takes a new range each time it switches, which stays correct but
+ * loses the benefit.
+ */
+class SequenceIdAllocator {
+  public:
+    explicit SequenceIdAllocator(uint64_t start = 0, uint64_t rangeSize = 1)
+            : id_(nextAllocatorId()), rangeSize_(rangeSize ? rangeSize : 1), next_(start) {
+    }
+
+    SequenceIdAllocator(const SequenceIdAllocator&) = delete;
+    SequenceIdAllocator& operator=(const SequenceIdAllocator&) = delete;
+
+    /**
+     * @return an id greater than the start, modulo 2^64
+     */
+    inline uint64_t next() {
+        if (rangeSize_ == 1) {
+            return next_.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        Range &r = threadRange();
+        if (r.allocator != id_ || r.next == r.end) {
+            r.allocator = id_;
+            r.next = next_.fetch_add(rangeSize_, std::memory_order_relaxed) + 1;
+            r.end = r.next + rangeSize_;
+        }
+        return r.next++;
+    }
+
+    /**
+     * Ids handed out from the shared sequence so far, whole ranges included
+     */
+    inline uint64_t current() const {
+        return next_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Restarts the shared sequence.  Ranges threads already hold are still
+     * handed out.
+     */
+    inline void reset(uint64_t start) {
+        next_.store(start, std::memory_order_relaxed);
+    }
+
+    inline uint64_t getRangeSize() const {
+        return rangeSize_;
+    }
+
+  private:
+    struct Range {
+        uint64_t allocator;
+        uint64_t next;
+        uint64_t end;
+    };
+
+    static inline Range& threadRange() {
+        static thread_local Range range {0, 0, 0};
+        return range;
+    }
+
+    /* Never reused, so a range is not mistaken for the range of an allocator
+     * that was at the same address */
+    static inline uint64_t nextAllocatorId() {
+        static std::atomic<uint64_t> nextId {0};
+        return nextId.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    const uint64_t id_;
+    const uint64_t rangeSize_;
+    /* Aligning it also pads the object, nothing else shares its cache line */
+    alignas(FDS_CACHELINE_SIZE) std::atomic<uint64_t> next_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CONCURRENCY_SEQUENCEIDALLOCATOR_H_
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_CONCURRENCY_SHARDEDCOUNTER_H_
+#define SOURCE_INCLUDE_CONCURRENCY_SHARDEDCOUNTER_H_
+
+#include <stdlib.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace fds {
+
+/**
+ * Size of a cache line on the platforms we ship on.  Used to pad per-core
+ * state so that two shards never share a line.
+ */
+constexpr size_t FDS_CACHELINE_SIZE = 64;
+
+/**
+ * Mixin for classes that embed ShardedCounters.  Plain new only guarantees 16
+ * byte alignment, which would let neighbouring shards share a cache line.
+ */
+struct CacheAlignedNew {
+    static void* operator new(size_t size) {
+        void* p = nullptr;
+        if (posix_memalign(&p, FDS_CACHELINE_SIZE, size)) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+    static void operator delete(void* p) {
+        free(p);
+    }
+};
+
+/**
+ * Returns a small, stable per-thread shard index.  Threads are assigned shards
+ * round robin the first time they ask, so threads pinned to different cores
+ * (our IO threadpools) land on different shards without having to pay for
+ * sched_getcpu() on every update.
+ */
+inline size_t threadShardIndex() {
+    static std::atomic<size_t> nextShard {0};
+    static thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+
+/**
+ * @brief Counter whose value is spread over cache line padded shards.  Writers
+ * only touch their own shard; readers sum all of them.  Use this for counters
+ * that are updated from many threads on the IO path and read rarely (stats
+ * export).
+ *
+ * Values are kept modulo 2^64, so a decrement on one shard and an increment on
+ * another still sum to the right value.
+ */
+template <size_t NumShards = 16>
+class ShardedCounterT {
+  public:
+    static_assert(NumShards && !(NumShards & (NumShards - 1)),
+                  "Number of shards must be a power of two");
+
+    ShardedCounterT() {
+        reset();
+    }
+
+    /* Copying snapshots the aggregated value */
+    ShardedCounterT(const ShardedCounterT& rhs) {
+        set(rhs.value());
+    }
+
+    ShardedCounterT& operator=(const ShardedCounterT& rhs) {
+        if (this != &rhs) {
+            set(rhs.value());
+        }
+        return *this;
+    }
+
+    inline void add(uint64_t v) {
+        shards_[threadShardIndex() & (NumShards - 1)].val.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    inline void sub(uint64_t v) {
+        shards_[threadShardIndex() & (NumShards - 1)].val.fetch_sub(v, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t sum = 0;
+        for (auto &s : shards_) {
+            sum += s.val.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    /**
+     * Resetting while writers are active may lose the updates that race with
+     * it.  That is the same guarantee the single atomic counters gave.
+     */
+    void reset() {
+        set(0);
+    }
+
+    void set(uint64_t v) {
+        shards_[0].val.store(v, std::memory_order_relaxed);
+        for (size_t i = 1; i < NumShards; ++i) {
+            shards_[i].val.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    struct alignas(FDS_CACHELINE_SIZE) Shard {
+        std::atomic<uint64_t> val;
+    };
+    Shard shards_[NumShards];
+};
+
+typedef ShardedCounterT<> ShardedCounter;
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CONCURRENCY_SHARDEDCOUNTER_H_
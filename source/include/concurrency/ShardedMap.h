@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_CONCURRENCY_SHARDEDMAP_H_
+#define SOURCE_INCLUDE_CONCURRENCY_SHARDEDMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include <concurrency/ShardedCounter.h>
+
+namespace fds {
+
+/**
+ * @brief Hash map split in cache line padded shards, each with its own lock.
+ * Threads working on different keys almost never wait on each other or
+ * bounce the same cache line, unlike a single map behind one lock.
+ *
+ * Keys are spread over the shards by a multiplicative hash of their hash, so
+ * sequential integer keys (request ids) go round robin over the shards.
+ */
+template <typename K, typename V, size_t NumShards = 64, typename Hash = std::hash<K>>
+class ShardedMap {
+  public:
+    static_assert(NumShards && !(NumShards & (NumShards - 1)),
+                  "Number of shards must be a power of two");
+
+    /**
+     * @return false if the key is already in the map
+     */
+    bool insert(const K& key, const V& value) {
+        auto &s = shard(key);
+        std::lock_guard<std::mutex> l(s.lock);
+        return s.map.emplace(key, value).second;
+    }
+
+    /**
+     * @return true and the value of the key in value if it is in the map
+     */
+    bool find(const K& key, V& value) const {
+        auto &s = shard(key);
+        std::lock_guard<std::mutex> l(s.lock);
+        auto itr = s.map.find(key);
+        if (itr == s.map.end()) {
+            return false;
+        }
+        value = itr->second;
+        return true;
+    }
+
+    /**
+     * Removes the key
+     * @return true and the value it had in value if it was in the map
+     */
+    bool erase(const K& key, V& value) {
+        auto &s = shard(key);
+        std::lock_guard<std::mutex> l(s.lock);
+        auto itr = s.map.find(key);
+        if (itr == s.map.end()) {
+            return false;
+        }
+        value = std::move(itr->second);
+        s.map.erase(itr);
+        return true;
+    }
+
+    /**
+     * Not a snapshot: shards are counted one after the other
+     */
+    size_t size() const {
+        size_t sum = 0;
+        for (auto &s : shards_) {
+            std::lock_guard<std::mutex> l(s.lock);
+            sum += s.map.size();
+        }
+        return sum;
+    }
+
+  private:
+    struct alignas(FDS_CACHELINE_SIZE) Shard {
+        mutable std::mutex lock;
+        std::unordered_map<K, V, Hash> map;
+    };
+
+    inline Shard& shard(const K& key) {
+        return shards_[shardIndex(key)];
+    }
+
+    inline const Shard& shard(const K& key) const {
+        return shards_[shardIndex(key)];
+    }
+
+    static inline size_t shardIndex(const K& key) {
+        /* Fibonacci hashing, the top bits are the best mixed */
+        uint64_t h = static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ULL;
+        return NumShards == 1 ? 0 : static_cast<size_t>(h >> (64 - shardBits()));
+    }
+
+    static constexpr unsigned shardBits(size_t n = NumShards) {
+        return n <= 1 ? 0 : 1 + shardBits(n >> 1);
+    }
+
+    Shard shards_[NumShards];
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_CONCURRENCY_SHARDEDMAP_H_
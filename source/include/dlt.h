@@ -23,7 +23,9 @@
 #include <util/timeutils.h>
 #include <fds_placement_table.h>
 #include <concurrency/RwLock.h>
+#include <concurrency/RcuPtr.h>
 #include <fds_table.h>
+#include <fds_routing_table.h>
 
 namespace fds {
 #define DLT_VER_INVALID 0UL  /**< Defines 0 as invalid DLT version */
@@ -297,6 +299,14 @@ namespace fds {
         NodeUuid getPrimary(fds_token_id token) const;
         NodeUuid getPrimary(const ObjectID& objId) const;
 
+        /**
+         * Nodes for a token/objid in the current DLT, copied into route.
+         * Lock free and doesn't allocate, meant for the per IO path.
+         * @return false if there is no current DLT
+         */
+        bool getRoute(fds_token_id token, TableRoute& route) const;
+        bool getRoute(const ObjectID& objId, TableRoute& route) const;
+
         uint32_t virtual write(serialize::Serializer*  s) const;
         uint32_t virtual read(serialize::Deserializer* d);
 
@@ -311,6 +321,10 @@ namespace fds {
         DLT* curPtr = NULL;
         std::vector<DLT*> dltList;
         fds_rwlock mutable dltLock;  /**< lock protecting curPtr and dltList */
+        /** Flat copy of curPtr for getRoute(), republished whenever it changes */
+        RcuPtr<RoutingTable> curRoutes;
+        /** Makes dlt current, expects dltLock to be held for write */
+        void setCurrentLocked(DLT* dlt);
         void checkSize();
         fds_uint8_t maxDlts;
     };
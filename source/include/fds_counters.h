@@ -6,6 +6,7 @@
 #include <string>
 #include <iostream>
 #include <atomic>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include <ostream>
@@ -13,6 +14,8 @@
 #include <fds_types.h>
 #include <fds_assert.h>
 #include <concurrency/Mutex.h>
+#include <concurrency/ShardedCounter.h>
+#include <util/LatencyHistogram.h>
 #include <fds_timer.h>
 
 namespace fds {
@@ -175,9 +178,46 @@ struct SimpleNumericCounter : FdsBaseCounter {
 };
 
 /**
- * @brief Numeric counter
+ * @brief Unsharded latency counter for short lived, single owner uses such as
+ * a per-request PerfContext.  Long lived counters updated from IO threads
+ * should use LatencyCounter.
  */
-class NumericCounter : public FdsBaseCounter
+struct SimpleLatencyCounter : FdsBaseCounter {
+    SimpleLatencyCounter(const std::string &id, fds_volid_t volid,
+                         FdsCounters *export_parent);
+
+    uint64_t value() const;
+    void reset();
+
+    void update(const uint64_t val, uint64_t cnt = 1);
+
+    inline double latency() const {
+        uint64_t cnt = count();
+        if (!cnt) {
+            return 0;
+        }
+        return static_cast<double>(total_latency()) / cnt;
+    }
+
+    inline uint64_t total_latency() const {
+        return total_latency_.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t count() const {
+        return cnt_.load(std::memory_order_relaxed);
+    }
+
+  protected:
+    std::atomic<uint64_t> total_latency_;
+    std::atomic<uint64_t> cnt_;
+};
+
+/**
+ * @brief Numeric counter.  The value is sharded per core so that
+ * concurrent incr()/decr() from IO threads don't bounce a cache line;
+ * shards are summed on read.
+ */
+class NumericCounter : public FdsBaseCounter, public CacheAlignedNew
 {
 public:
     NumericCounter(const std::string &id, fds_volid_t volid,
@@ -197,25 +237,40 @@ public:
     void decr();
     void decr(const uint64_t v);
 
-    inline uint64_t min_value() const {
-        return min_value_.load();
+    /**
+     * Sums the shards and folds the result into the watermarks below.
+     * Tracking them on every update would need the aggregated value, so
+     * they only see the values observed here.
+     */
+    uint64_t sample();
+
+    /**
+     * Low/high watermarks of the values seen by sample().  Both take a
+     * sample first.
+     */
+    inline uint64_t sampled_min_value() {
+        sample();
+        return min_value_.load(std::memory_order_relaxed);
     }
 
-    inline uint64_t max_value() const {
-        return max_value_.load();
+    inline uint64_t sampled_max_value() {
+        sample();
+        return max_value_.load(std::memory_order_relaxed);
     }
 
 
 private:
-    std::atomic<uint64_t> val_;
+    ShardedCounter val_;
     std::atomic<uint64_t> min_value_;
     std::atomic<uint64_t> max_value_;
 };
 
 /**
- * @brief Latency Counter
+ * @brief Latency Counter.  Keeps total and count in per core shards.  Counters
+ * that call trackPercentiles() also keep a log-linear histogram of the samples
+ * so that tail percentiles can be exported alongside the average.
  */
-class LatencyCounter : public FdsBaseCounter
+class LatencyCounter : public FdsBaseCounter, public CacheAlignedNew
 {
 public:
     LatencyCounter(const std::string &id, fds_volid_t volid,
@@ -243,28 +298,56 @@ public:
     }
 
     inline uint64_t total_latency() const {
-        return total_latency_.load();
+        return total_latency_.value();
     }
 
     inline uint64_t count() const {
-        return cnt_.load();
+        return cnt_.value();
     }
 
     inline uint64_t min_latency() const {
-        return min_latency_.load();
+        return min_latency_.load(std::memory_order_relaxed);
     }
 
     inline uint64_t max_latency() const {
-        return max_latency_.load();
+        return max_latency_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Allocates the histogram behind percentile().  It is several KB, so
+     * only counters that export percentiles should ask for it.  Must be
+     * called before the counter is shared with updating threads.
+     */
+    void trackPercentiles();
+
+    inline bool tracksPercentiles() const {
+        return static_cast<bool>(histogram_);
+    }
+
+    /**
+     * Returns the pth percentile (0 < p <= 100) of the recorded latencies.
+     * Accurate to within 1/LatencyHistogram::SUB_BUCKETS of the true value.
+     * Returns 0 unless percentiles are tracked.
+     */
+    inline uint64_t percentile(double p) const {
+        return histogram_ ? histogram_->percentile(p) : 0;
     }
 
     void toMap(std::map<std::string, int64_t>& m) const;
 
+    /* Percentiles exported by toMap() and the counter manager */
+    static const std::vector<std::pair<std::string, double>> exportedPercentiles;
+
 private:
-    std::atomic<uint64_t> total_latency_;
-    std::atomic<uint64_t> cnt_;
+    void updateMin(uint64_t val);
+    void updateMax(uint64_t val);
+
+    ShardedCounter total_latency_;
+    ShardedCounter cnt_;
+    /* Watermarks only move on new extremes so the line stays shared */
     std::atomic<uint64_t> min_latency_;
     std::atomic<uint64_t> max_latency_;
+    std::unique_ptr<LatencyHistogram> histogram_;
 };
 
 struct ResourceUsageCounter : FdsBaseCounter {
@@ -277,6 +360,20 @@ struct ResourceUsageCounter : FdsBaseCounter {
     void toMap(std::map<std::string, int64_t>& m) const;
 };
 
+/**
+ * @brief Exports the reuse statistics of every ObjectPool in the process as
+ * objpool.<type>.{alloc,reuse,free,release,cached}
+ */
+struct ObjectPoolCounter : FdsBaseCounter {
+    ObjectPoolCounter(FdsCounters *export_parent);
+    ObjectPoolCounter(const ObjectPoolCounter& c) = default;
+
+    uint64_t value() const { return 0; };
+    // cannot be reset via thrift
+    void reset() {};
+    void toMap(std::map<std::string, int64_t>& m) const;
+};
+
 
 }  // namespace fds
 
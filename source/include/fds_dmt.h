@@ -17,6 +17,8 @@
 #include <util/Log.h>
 #include <fds_placement_table.h>
 #include <fds_table.h>
+#include <fds_routing_table.h>
+#include <concurrency/RcuPtr.h>
 
 namespace fds {
 
@@ -122,6 +124,7 @@ namespace fds {
 
   private:
         DmtTablePtr dmt_table;  /**< DMT table */
+        friend class DMTManager;
     };
 
     typedef enum {
@@ -197,6 +200,16 @@ namespace fds {
         DmtColumnPtr getVersionNodeGroup(fds_volid_t const volume_id,
                                          fds_uint64_t const version) const;
 
+        /**
+         * Lock free, allocation free version of getVersionNodeGroup() for
+         * the IO path. Only the committed DMT is kept in this form.
+         * @return false if 'version' is not the committed version, caller
+         * falls back to getVersionNodeGroup()
+         */
+        bool getRoute(fds_volid_t const volume_id,
+                      fds_uint64_t const version,
+                      TableRoute& route) const;
+
         /**
          * Returns DMT of given type, type must be either commited
          * or target. Asserts if there is no DMT of requested type.
@@ -217,6 +230,10 @@ namespace fds {
         fds_uint64_t target_version;  /**< version of target DMT or invalid */
         std::map<fds_uint64_t, DMTPtr> dmt_map;  /**< version to DMT map */
         mutable fds_rwlock dmt_lock;  /**< lock protecting dmt_map */
+        /** Flat copy of the committed DMT, republished on every commit */
+        RcuPtr<RoutingTable> committed_routes;
+        /** Expects dmt_lock to be held for write */
+        void publishCommittedLocked();
     };
     typedef boost::shared_ptr<DMTManager> DMTManagerPtr;
 
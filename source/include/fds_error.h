@@ -193,6 +193,7 @@ namespace fds {
     ADD(ERR_SVC_REQUEST_TIMEOUT, ,"  "), \
     ADD(ERR_SVC_SERVER_PORT_ALREADY_INUSE, ,"  "), \
     ADD(ERR_SVC_SERVER_CRASH, ,"  "), \
+    ADD(ERR_SVC_SEND_QUEUE_FULL, ,"Too many bytes queued for the peer service"), \
     \
     /* FDSN status errors */    \
     /* TODO(Rao"),: Change FDSN_Status prefix to ERR_ prefix */  \
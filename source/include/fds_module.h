@@ -216,6 +216,7 @@ class FdsRootDir
     inline const std::string &dir_fds_var_cores() const { return d_var_cores; }
     inline const std::string &dir_fds_var_tests() const { return d_var_tests; }
     inline const std::string &dir_fds_var_tools() const { return d_var_tools; }
+    inline const std::string &dir_fds_var_captures() const { return d_var_captures; }
     inline const std::string &dir_dev() const { return d_dev; }
     inline const std::string &dir_filetransfer() const { return d_filetransfer; }
     inline const std::string &dir_user_repo() const { return d_user_repo; }
@@ -246,6 +247,7 @@ class FdsRootDir
     std::string              d_var_inventory;
     std::string              d_var_tests;
     std::string              d_var_tools;
+    std::string              d_var_captures;
     std::string              d_dev;
     std::string              d_user_repo;
     std::string              d_user_repo_objs;
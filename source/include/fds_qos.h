@@ -11,11 +11,13 @@
 #include <concurrency/RwLock.h>
 #include <concurrency/Mutex.h>
 #include <unordered_map>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <util/timeutils.h>
 #include "qos_ctrl.h"
+#include "qos_cost.h"
 #include "PerfTrace.h"
 
 #include "EclipseWorkarounds.h"
@@ -33,6 +35,9 @@ namespace fds {
         float current_throttle_level;
         fds_int64_t total_svc_iops;
         fds_uint32_t max_outstanding_ios;
+        /* When non-zero, the limit services that adapt concurrency to their
+         * disks currently want; never above max_outstanding_ios */
+        std::atomic<fds_uint32_t> adaptive_outstanding_ios {0};
         fds_rwlock qda_lock;  // Protects queue_map (and any high level structures in derived class)
                               // from events like volumes being inserted or removed during
                               // enqueue IO or dispatchIO.
@@ -49,6 +54,9 @@ namespace fds {
         std::atomic_bool shuttingDown;
         fds_bool_t bypass_dispatcher;
 
+        /* Prices IOs in tokens; flat (one token per IO) unless configured */
+        IoCostModel cost_model;
+
         virtual fds_qid_t getNextQueueForDispatch() = 0;
 
 
@@ -82,6 +90,44 @@ namespace fds {
             shuttingDown = true;
         }
 
+        /* Call before queues are registered */
+        void setCostModel(const IoCostModel &model)
+        {
+            cost_model = model;
+            LOGNOTIFY << "Dispatcher: io cost model " << IoCostModel::tierName(model.tier)
+                      << " read bytes/token " << model.readBytesPerToken
+                      << " write bytes/token " << model.writeBytesPerToken
+                      << " burst credit ms " << model.burstCreditMs;
+        }
+
+        /**
+         * Reads the cost model from <prefix>cost_model ("flat", "hdd", "ssd" or
+         * "auto", which follows the all_ssd feature toggle), optionally
+         * overridden by <prefix>read_bytes_per_token, <prefix>write_bytes_per_token
+         * and <prefix>burst_credit_ms.
+         * @param prefix e.g. "fds.sm.qos."
+         */
+        void loadCostModel(const std::string &prefix)
+        {
+            FdsConfigAccessor config(g_fdsprocess->get_conf_helper());
+            std::string name = config.get_abs<std::string>(prefix + "cost_model", "flat");
+            IoCostModel::Tier tier = IoCostModel::FLAT;
+            if (name == "auto") {
+                tier = config.get_abs<bool>("fds.feature_toggle.common.all_ssd", false) ?
+                        IoCostModel::SSD : IoCostModel::HDD;
+            } else if (!IoCostModel::tierFromName(name, tier)) {
+                LOGWARN << "Dispatcher: unknown io cost model " << name << ", using flat";
+            }
+            IoCostModel model = IoCostModel::forTier(tier);
+            model.readBytesPerToken = config.get_abs<fds_uint64_t>(
+                prefix + "read_bytes_per_token", model.readBytesPerToken);
+            model.writeBytesPerToken = config.get_abs<fds_uint64_t>(
+                prefix + "write_bytes_per_token", model.writeBytesPerToken);
+            model.burstCreditMs = config.get_abs<fds_uint32_t>(
+                prefix + "burst_credit_ms", model.burstCreditMs);
+            setCostModel(model);
+        }
+
         Error registerQueueWithLockHeld(fds_qid_t queue_id, FDS_VolumeQueue *queue)
         {
             Error err(ERR_OK);
@@ -175,6 +221,18 @@ namespace fds {
             LOGTRACE << "Request " << io->io_req_id << " being enqueued at queue " << queue_id;
         }
 
+        // Assumes caller has the qda read lock
+        // Accounts a batch of IOs enqueued together at once; by default
+        // each IO is accounted on its own
+        virtual void ioProcessForEnqueueBatch(fds_qid_t queue_id,
+                                              FDS_IOType* const *ios,
+                                              size_t n_ios)
+        {
+            for (size_t i = 0; i < n_ios; ++i) {
+                ioProcessForEnqueue(queue_id, ios[i]);
+            }
+        }
+
         // Assumes caller has the qda read lock
         virtual void ioProcessForDispatch(fds_qid_t queue_id, FDS_IOType *io)
         {
@@ -183,6 +241,17 @@ namespace fds {
                      << std::hex << queue_id << std::dec;
         }
 
+        /**
+         * Charges a queue tokens beyond the one getNextQueueForDispatch() took for
+         * an IO, once the IO's cost is known.  Called by the dispatcher thread and
+         * by IO completion, so implementations must only record the charge and
+         * apply it on the dispatcher thread.
+         * Assumes caller has the qda read lock
+         */
+        virtual void chargeQueue(fds_qid_t queue_id, fds_uint32_t tokens)
+        {
+        }
+
         // Quiesce queued IOs on this queue & block any new IOs
         virtual void quiesceIOs(fds_qid_t queue_id)
         {
@@ -244,6 +313,8 @@ namespace fds {
             fds_uint32_t n_pios = 0;
 
             io->enqueue_ts = util::getTimeStampNanos();
+            io->qos_queue_id = queue_id;
+            StageTracer::record(io->traceId, TraceStage::QOS_ENQUEUE, io->io_type);
 
             qda_lock.read_lock();
             if (queue_map.count(queue_id) == 0) {
@@ -289,6 +360,77 @@ namespace fds {
             return err;
         }
 
+        /**
+         * Enqueues a batch of IOs on one queue.  The queue lookup, lock, QoS
+         * accounting (ioProcessForEnqueueBatch()) and pending count update are
+         * done once for the whole batch; only the queue push is per IO.
+         * @param nEnqueued number of IOs enqueued.  On error IOs from this index
+         * on were not enqueued.
+         */
+        virtual Error enqueueIOs(fds_qid_t queue_id,
+                                 const std::vector<FDS_IOType*> &ios,
+                                 size_t &nEnqueued)
+        {
+            Error err(ERR_OK);
+            nEnqueued = 0;
+
+            auto enqueue_ts = util::getTimeStampNanos();
+
+            qda_lock.read_lock();
+            if (queue_map.count(queue_id) == 0) {
+                qda_lock.read_unlock();
+                return Error(ERR_VOL_NOT_FOUND);
+            }
+
+            if (bypass_dispatcher == false) {
+                FDS_VolumeQueue *que = queue_map[queue_id];
+                for (auto io : ios) {
+                    io->enqueue_ts = enqueue_ts;
+                    io->qos_queue_id = queue_id;
+                    StageTracer::record(io->traceId, TraceStage::QOS_ENQUEUE, io->io_type);
+                    PerfTracer::tracePointBegin(io->opQoSWaitCtx);
+                    err = que->enqueueIO(io);
+                    if (!err.ok()) {
+                        break;
+                    }
+                    ++nEnqueued;
+                }
+                if (nEnqueued > 0) {
+                    ioProcessForEnqueueBatch(queue_id, ios.data(), nEnqueued);
+                    fds_uint32_t n_pios = atomic_fetch_add(&(num_pending_ios),
+                                                           (unsigned int)nEnqueued);
+                    LOGTRACE << "Dispatcher: enqueueIOs at queue - 0x"
+                             << std::hex << queue_id << std::dec
+                             << " : batch of " << nEnqueued
+                             << " # of pending ios = " << n_pios + nEnqueued;
+                }
+            }
+            qda_lock.read_unlock();
+
+            if (bypass_dispatcher == true) {
+                for (auto io : ios) {
+                    io->enqueue_ts = enqueue_ts;
+                    StageTracer::record(io->traceId, TraceStage::QOS_ENQUEUE, io->io_type);
+                    PerfTracer::tracePointBegin(io->opQoSWaitCtx);
+                    ++nEnqueued;
+                    try {
+                        parent_ctrlr->processIO(io);
+                    } catch (const std::exception &e) {
+                        LOGWARN << "exception:" << e.what()
+                            << " queue_id:" << queue_id
+                            << " type:" << io->io_type
+                            << " on processio.  ignoring...";
+                    } catch (...) {
+                        LOGWARN << "exception:unknown"
+                            << " queue_id:" << queue_id
+                            << " type:" << io->io_type
+                            << " on processio.  ignoring...";
+                    }
+                }
+            }
+            return err;
+        }
+
         void setSchedThreadPriority()
         {
             pthread_t this_thread = pthread_self();
@@ -377,7 +519,12 @@ namespace fds {
                         // Previous line was original.  Relaxing the memory order to relieve
                         // stress on memory bus.
                         n_oios = num_outstanding_ios.load(std::memory_order_relaxed);
-                        if (n_oios < max_outstanding_ios) {
+                        fds_uint32_t limit =
+                                adaptive_outstanding_ios.load(std::memory_order_relaxed);
+                        if (limit == 0 || limit > max_outstanding_ios) {
+                            limit = max_outstanding_ios;
+                        }
+                        if (n_oios < limit) {
                             break;
                         }
                         boost::this_thread::sleep(boost::posix_time::microseconds(100));
@@ -415,9 +562,17 @@ namespace fds {
 
                 ioProcessForDispatch(queue_id, io);
 
+                // Getting the queue cost one token, charge the rest of what the IO
+                // costs.  GETs only learn their size at completion, see markIODone()
+                io->io_cost = cost_model.cost(io);
+                if (io->io_cost > 1) {
+                    chargeQueue(queue_id, io->io_cost - 1);
+                }
+
                 qda_lock.read_unlock();
 
                 io->dispatch_ts = util::getTimeStampNanos();
+                StageTracer::record(io->traceId, TraceStage::QOS_DISPATCH, io->io_type);
 
                 n_pios = 0;
                 n_pios = atomic_fetch_sub(&(num_pending_ios), (unsigned int)1);
@@ -466,10 +621,24 @@ namespace fds {
                     */
                     fds_verify(n_oios < 2 * max_outstanding_ios);
                 }
+
+                // Charge what the IO turned out to cost beyond what it was charged
+                // at dispatch
+                if (io->io_cost > 0) {
+                    fds_uint32_t cost = cost_model.cost(io);
+                    if (cost > io->io_cost) {
+                        SCOPEDREAD(qda_lock);
+                        if (queue_map.count(io->qos_queue_id) != 0) {
+                            chargeQueue(io->qos_queue_id, cost - io->io_cost);
+                        }
+                        io->io_cost = cost;
+                    }
+                }
             }
             --n_oios;
 
             io->io_done_ts = util::getTimeStampNanos();
+            StageTracer::record(io->traceId, TraceStage::QOS_DONE, io->io_type);
             fds_uint64_t wait_nano = io->dispatch_ts - io->enqueue_ts;
             fds_uint64_t service_nano = io->io_done_ts - io->dispatch_ts;
             fds_uint64_t total_nano = io->io_done_ts - io->enqueue_ts;
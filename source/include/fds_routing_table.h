@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_FDS_ROUTING_TABLE_H_
+#define SOURCE_INCLUDE_FDS_ROUTING_TABLE_H_
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <fds_placement_table.h>
+
+namespace fds {
+
+    /**
+     * Nodes of one table column as handed out to the IO path.  Lives on
+     * the caller's stack, so a lookup doesn't allocate.
+     *
+     * Columns deeper than MAX_DEPTH (only seen from the locked lookups) are
+     * referenced through column instead of being copied into nodes; use
+     * get() to read either.
+     */
+    struct TableRoute {
+        static const fds_uint32_t MAX_DEPTH = 8;
+
+        fds_uint64_t version = 0;
+        fds_uint32_t depth = 0;
+        NodeUuid nodes[MAX_DEPTH];
+        boost::shared_ptr<TableColumn> column;
+
+        inline NodeUuid get(fds_uint32_t index) const {
+            return column ? column->get(index) : nodes[index];
+        }
+
+        /** Takes the nodes of a column from the locked lookups */
+        inline void assign(fds_uint64_t tableVersion,
+                           const boost::shared_ptr<TableColumn>& nodeGroup) {
+            version = tableVersion;
+            depth = nodeGroup->getLength();
+            if (depth > MAX_DEPTH) {
+                column = nodeGroup;
+                return;
+            }
+            column.reset();
+            for (fds_uint32_t i = 0; i < depth; ++i) {
+                nodes[i] = nodeGroup->get(i);
+            }
+        }
+    };
+
+    /**
+     * Immutable, flat copy of a DLT or DMT for lookups on the IO path.
+     *
+     * Cells are stored column after column as a contiguous
+     * columns x depth array of 16 bit indices into a small array of
+     * distinct service uuids, so looking up a column touches one or two
+     * cache lines and no shared_ptr.  Built whenever the manager's current
+     * table changes and published to readers through an RcuPtr.
+     */
+    class RoutingTable {
+  public:
+        typedef fds_uint16_t SvcIndex;
+
+        RoutingTable(fds_uint64_t version,
+                     fds_uint32_t width,
+                     fds_uint32_t depth,
+                     const std::vector<boost::shared_ptr<TableColumn>>& columns);
+
+        inline fds_uint64_t getVersion() const { return version; }
+        inline fds_uint32_t getWidth() const { return width; }
+        inline fds_uint32_t getDepth() const { return depth; }
+        inline fds_uint32_t getNumColumns() const { return numColumns; }
+        inline fds_uint32_t getNumSvcs() const { return svcs.size(); }
+
+        /** Service indices of a column, getColumnLength() entries */
+        inline const SvcIndex* getColumn(fds_uint32_t column) const {
+            return &cells[column * depth];
+        }
+        /** Columns may hold fewer nodes than the table depth */
+        inline fds_uint32_t getColumnLength(fds_uint32_t column) const {
+            return lengths[column];
+        }
+        inline const NodeUuid& getSvc(SvcIndex index) const {
+            return svcs[index];
+        }
+
+        /** Copies the nodes of a column into route */
+        inline void getRoute(fds_uint32_t column, TableRoute& route) const {
+            const SvcIndex* col = getColumn(column);
+            route.version = version;
+            route.depth = lengths[column];
+            route.column.reset();
+            for (fds_uint32_t i = 0; i < route.depth; ++i) {
+                route.nodes[i] = svcs[col[i]];
+            }
+        }
+
+  private:
+        fds_uint64_t version;
+        fds_uint32_t width;
+        fds_uint32_t depth;
+        fds_uint32_t numColumns;
+        std::vector<SvcIndex> cells;
+        std::vector<fds_uint8_t> lengths;
+        std::vector<NodeUuid> svcs;
+    };
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_FDS_ROUTING_TABLE_H_
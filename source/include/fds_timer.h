@@ -80,7 +80,8 @@ struct FdsTimerFunctionTask : FdsTimerTask {
  * repeated execution. Tasks are executed by the dedicated timer thread
  * sequentially.
  * IMPORTANT: Firing of the timer tasks isn't very accurate.  It's better to schedule
- * timer tasks in the granularity of seconds.
+ * timer tasks in the granularity of seconds.  Timers that need finer granularity can
+ * be constructed with a smaller timer thread sleep time.
  */
 class FdsTimer
 {
@@ -96,6 +97,13 @@ public:
      */
     explicit FdsTimer(const std::string &id);
 
+    /**
+     * Constructor
+     * @param timerThreadSleepMs - how often the timer thread looks for expired tasks.
+     * This is also the smallest delay a task can be scheduled with.
+     */
+    FdsTimer(const std::string &id, int timerThreadSleepMs);
+
     /**
      * Destructor
      */
@@ -168,7 +176,7 @@ private:
             const std::chrono::duration<Rep, Period>& time,
             const bool &repeated)
     {
-        fds_assert(time >= std::chrono::seconds(1));
+        fds_assert(time >= std::chrono::milliseconds(timerThreadSleepMs_));
 
         lock_.lock();
         task->durationMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(time);
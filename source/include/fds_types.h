@@ -31,6 +31,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <util/Log.h>
+#include <util/StageTrace.h>
 
 #include "EclipseWorkarounds.h"
 
@@ -311,6 +312,13 @@ class FDS_IOType {
     fds_uint64_t enqueue_ts {0};
     fds_uint64_t dispatch_ts {0};
     fds_uint64_t io_done_ts;
+    /* Sampled stage trace id, inherited from the request being worked on */
+    int64_t traceId {StageTracer::current()};
+    /* Bytes the IO moves, 0 if not known; prices the IO in QoS tokens */
+    fds_uint64_t io_size {0};
+    /* QoS queue the IO went through and the tokens charged for it so far */
+    fds_qid_t qos_queue_id {0};
+    fds_uint32_t io_cost {0};
 
     // performance data collection related structures
     PerfEventType opReqFailedPerfEventType;
@@ -34,7 +34,11 @@ extern fds_uint64_t getWriteBatchTimestamp(const leveldb::WriteBatch & batch);
 class CatJournalIterator {
   public:
     // ctor and dtor
-    explicit CatJournalIterator(const std::string & file);
+    /**
+     * Iterates the write batches of a journal, or of an archived journal,
+     * that start at or after initialOffset
+     */
+    explicit CatJournalIterator(const std::string & file, fds_uint64_t initialOffset = 0);
     virtual ~CatJournalIterator();
 
     // Iterator
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_LEVELDB_JOURNAL_ARCHIVE_H_
+#define SOURCE_INCLUDE_LEVELDB_JOURNAL_ARCHIVE_H_
+
+#include <string>
+#include <vector>
+#include <leveldb/env.h>
+#include <leveldb/status.h>
+#include <fds_types.h>
+
+namespace leveldb {
+
+/**
+ * Archived catalog journals are the journal (a leveldb log file) cut in
+ * frames of ARCHIVE_FRAME_SIZE bytes, each compressed on its own, followed
+ * by a table of where every frame starts:
+ *
+ *   magic | frames: raw length (u32) | compressed length (u32) | data |
+ *   frame offsets (u64 each) | frame count (u32) | frame size (u32) | magic
+ *
+ * so that reading can start at any offset of the journal without
+ * decompressing what comes before it.
+ */
+const std::string JOURNAL_ARCHIVE_SUFFIX(".fjz");
+const fds_uint32_t ARCHIVE_FRAME_SIZE = 256 * 1024;
+
+/**
+ * Journal offset of the first write batch starting in a frame, and its time
+ */
+struct JournalIndexEntry {
+    fds_uint64_t timestamp;
+    fds_uint64_t offset;
+};
+
+/**
+ * Compresses the journal file into an archive, and builds its time index
+ * (one entry per frame)
+ */
+Status archiveJournal(const std::string & journalFile,
+                      const std::string & archiveFile,
+                      std::vector<JournalIndexEntry> * index);
+
+/**
+ * Sequential reads of the journal in an archive
+ */
+Status newJournalArchiveFile(const std::string & archiveFile, SequentialFile ** result);
+
+}  // namespace leveldb
+#endif  // SOURCE_INCLUDE_LEVELDB_JOURNAL_ARCHIVE_H_
@@ -0,0 +1,120 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_NET_ENDPOINTLATENCYTRACKER_H_
+#define SOURCE_INCLUDE_NET_ENDPOINTLATENCYTRACKER_H_
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <concurrency/RwLock.h>
+#include <util/LatencyHistogram.h>
+#include <fdsp/svc_types_types.h>
+
+namespace fds {
+
+namespace fpi = FDS_ProtocolInterface;
+
+/**
+* @brief Settings for hedged reads.  A hedged read is sent to a second replica once
+* the first one hasn't responded within a delay derived from recently observed read
+* latencies.
+*/
+struct HedgeConfig {
+    /* Whether failover reads are hedged at all */
+    bool        enabled {false};
+    /* Percentile of observed read latencies after which we hedge */
+    double      percentile {95.0};
+    /* Bounds on the hedge delay */
+    uint32_t    minDelayMs {2};
+    uint32_t    maxDelayMs {1000};
+    /* Hedges allowed as a percentage of hedge eligible requests */
+    uint32_t    budgetPct {5};
+    /* Hedges that may be issued back to back before the budget kicks in */
+    uint32_t    budgetBurst {10};
+};
+
+/**
+* @brief Tracks response latency per endpoint (exponentially weighted moving average)
+* and across all tracked reads (log-linear histogram).  Used by failover style
+* requests to pick the replica that is likely to respond first and to decide when a
+* request should be hedged to another replica.
+* All methods are thread safe.
+*/
+struct EndpointLatencyTracker {
+    explicit EndpointLatencyTracker(const HedgeConfig &config);
+
+    /**
+    * @brief Records a response (or error/timeout) from svcUuid that took latencyUs
+    */
+    void recordLatency(const fpi::SvcUuid &svcUuid, uint64_t latencyUs);
+
+    /**
+    * @brief Returns the moving average latency of svcUuid.  0 when nothing has been
+    * recorded against it yet.
+    */
+    uint64_t getEwmaLatencyUs(const fpi::SvcUuid &svcUuid) const;
+
+    /**
+    * @brief Returns the index of the endpoint in svcUuids with the lowest moving
+    * average latency.  Endpoints we know nothing about win so that they get probed.
+    * Ties keep the caller's order.
+    */
+    uint32_t pickFastest(const std::vector<fpi::SvcUuid> &svcUuids) const;
+
+    /**
+    * @brief Delay after which an outstanding read should be hedged
+    */
+    uint32_t getHedgeDelayMs() const;
+
+    /**
+    * @brief Accounts a hedge eligible request against the hedge budget
+    */
+    void addHedgeEligibleRequest();
+
+    /**
+    * @brief Consumes one hedge from the budget.
+    * @return false if the budget is exhausted and the request shouldn't be hedged
+    */
+    bool tryAcquireHedge();
+
+    inline const HedgeConfig& getHedgeConfig() const { return config_; }
+    inline bool isHedgingEnabled() const { return config_.enabled; }
+
+    /* Weight of a new sample in the moving average, in 1/EWMA_SCALE units */
+    static const uint64_t EWMA_WEIGHT = 2;
+    static const uint64_t EWMA_SCALE = 10;
+    /* Hedge delay is recomputed every so many samples */
+    static const uint64_t HEDGE_DELAY_REFRESH_SAMPLES = 1024;
+    /* Latency histogram window is rotated every so many samples */
+    static const uint64_t WINDOW_SAMPLES = 64 * 1024;
+
+ protected:
+    struct EndpointStats {
+        std::atomic<uint64_t> ewmaUs {0};
+    };
+
+    EndpointStats* getEndpointStats_(const fpi::SvcUuid &svcUuid);
+    void refreshHedgeDelay_();
+
+    HedgeConfig                                 config_;
+    mutable fds_rwlock                          lock_;
+    std::unordered_map<int64_t, std::unique_ptr<EndpointStats>> endpoints_;
+
+    /* Two windows of read latencies.  Recording goes into curWindow_; the other one
+     * holds the previous window so that percentiles don't reset to nothing on rotation.
+     */
+    LatencyHistogram                            windows_[2];
+    std::atomic<uint32_t>                       curWindow_ {0};
+    std::atomic<uint64_t>                       samples_ {0};
+    std::atomic<uint32_t>                       hedgeDelayMs_;
+
+    /* Hedge budget in 1/100th of a hedge */
+    std::atomic<int64_t>                        hedgeTokens_;
+};
+using EndpointLatencyTrackerPtr = std::unique_ptr<EndpointLatencyTracker>;
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_NET_ENDPOINTLATENCYTRACKER_H_
@@ -13,6 +13,7 @@
 #include <fds_module.h>
 #include <concurrency/SynchronizedTaskExecutor.hpp>
 #include <fdsp/PlatNetSvc.h>
+#include <net/SvcMsgPayload.h>
 
 #define REGISTER_FDSP_MSG_HANDLER_GENERIC(platsvc, FDSPMsgT, func)  \
     platsvc->asyncReqHandlers_[FDSP_MSG_TYPEID(FDSPMsgT)] = \
@@ -25,6 +26,20 @@
         fds::deserializeFdspMsg(payloadBuf, payload); \
         func(header, payload); \
         PlatNetSvcHandler::threadLocalPayloadBuf = nullptr; \
+    }; \
+    platsvc->asyncReqMsgHandlers_[FDSP_MSG_TYPEID(FDSPMsgT)] = \
+    [this] (boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>& header, \
+        const fds::SvcMsgPayloadPtr& msgPayload) \
+    { \
+        DBG(fiu_do_on("svc.dropincoming."#FDSPMsgT, return;)); \
+        PlatNetSvcHandler::threadLocalPayload = msgPayload; \
+        /* Handlers may modify their message, never the sender's */ \
+        auto payload = msgPayload->copyMsg<FDSPMsgT>(); \
+        if (!payload) { \
+            fds::deserializeFdspMsg(msgPayload->getBuf(), payload); \
+        } \
+        func(header, payload); \
+        PlatNetSvcHandler::threadLocalPayload = nullptr; \
     }
 
 // get the global service request handler
@@ -75,6 +90,9 @@ struct PlatNetSvcHandler : HasModuleProvider,
 {
     typedef std::function<void (boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>&,
                                 boost::shared_ptr<std::string>&)> FdspMsgHandler;
+    /* Handler for a request from this process, gets a copy of the sender's message */
+    typedef std::function<void (boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>&,
+                                const SvcMsgPayloadPtr&)> FdspMsgObjHandler;
     /* Handler state */
     enum State {
         /* In thi state requests are queued up to be replayed when you
@@ -105,6 +123,12 @@ struct PlatNetSvcHandler : HasModuleProvider,
                    const std::string& payload) override;
     void asyncReqt(boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>& header,
                    boost::shared_ptr<std::string>& payload) override;
+    /**
+    * @brief Request from this process.  Hands the message to the handler registered
+    * for it without deserializing, falls back to the bytes when there isn't one.
+    */
+    void asyncReqt(boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>& header,
+                   const SvcMsgPayloadPtr& payload);
     void getSvcMap(std::vector<fpi::SvcInfo> & _return,
                            const int64_t nullarg) override;
     void getSvcMap(std::vector<fpi::SvcInfo> & _return,
@@ -239,10 +263,18 @@ struct PlatNetSvcHandler : HasModuleProvider,
 
     /* Request handlers */
     std::unordered_map<fpi::FDSPMsgTypeId, FdspMsgHandler, std::hash<int>> asyncReqHandlers_;
+    std::unordered_map<fpi::FDSPMsgTypeId, FdspMsgObjHandler, std::hash<int>> asyncReqMsgHandlers_;
     SynchronizedTaskExecutor<uint64_t>  * taskExecutor_;
 
     /* Incoming request message payload buffer */
     static thread_local StringPtr threadLocalPayloadBuf;
+    /* Incoming request payload when it came from this process */
+    static thread_local SvcMsgPayloadPtr threadLocalPayload;
+    /**
+    * @brief Serialized payload of the request being handled on this thread.  A
+    * request from this process is serialized by the first call.
+    */
+    static StringPtr getThreadLocalPayloadBuf();
 };
 
 using PlatNetSvcHandlerPtr = boost::shared_ptr<PlatNetSvcHandler>;
@@ -12,6 +12,7 @@
 // TODO(Rao): Do forward decl here
 #include <concurrency/SynchronizedTaskExecutor.hpp>
 #include <net/PlatNetSvcHandler.h>
+#include <net/SvcPeerSender.h>
 #include <boost/shared_ptr.hpp>
 #include <fdsp/OMSvc.h>
 
@@ -217,20 +218,33 @@ struct SvcMgr : HasModuleProvider, Module, StateProvider {
     void deleteFromSvcMap(fpi::SvcUuid svcUuid);
 
     /**
-    * @brief For sending async message via message passing
+    * @brief For sending async message via message passing.  Doesn't block on the
+    * network; failures are also posted as an error response to the request.
     *
     * @param header
     * @param payload
+    *
+    * @return ERR_SVC_SEND_QUEUE_FULL when too much is already queued for the
+    * destination
     */
-    void sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
+    Error sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
+
+    /**
+    * @brief Same as above.  A request to this service is handed to its handler as the
+    * message payload holds, without serializing it.
+    */
+    Error sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header, const SvcMsgPayloadPtr &payload);
 
     /**
     * @brief 
     *
     * @param header
     * @param payload
+    *
+    * @return ERR_SVC_SEND_QUEUE_FULL when too much is already queued for the
+    * destination
     */
-    void sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
+    Error sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
 
     /**
     * @brief Brodcasts the payload to all services matching predicate
@@ -247,7 +261,8 @@ struct SvcMgr : HasModuleProvider, Module, StateProvider {
     *
     * @param header
     */
-    void postSvcSendError(fpi::AsyncHdrPtr &header);
+    void postSvcSendError(fpi::AsyncHdrPtr &header,
+                          const Error &e = ERR_SVC_REQUEST_INVOCATION);
 
     /**
     * @brief  Returns property for service with svcUuid
@@ -567,6 +582,20 @@ struct SvcMgr : HasModuleProvider, Module, StateProvider {
     */
     static const int32_t MAX_CONN_RETRIES;
 
+    /**
+    * @brief Settings for the send path to every service (see SvcPeerSender)
+    */
+    inline const PeerSenderConfig& getPeerSenderConfig() const {
+        return peerSenderConfig_;
+    }
+
+    /**
+    * @brief Whether service messages are sent over a multiplexed protocol
+    */
+    inline bool useMultiplexedServices() const {
+        return multiplexedServices_;
+    }
+
     /* Debug query api to get state as kv pairs */
     std::string getStateProviderId() override;
     std::string getStateInfo() override;
@@ -596,6 +625,9 @@ struct SvcMgr : HasModuleProvider, Module, StateProvider {
     /* Manage for service requests */
     SvcRequestPool *svcRequestMgr_;
 
+    PeerSenderConfig peerSenderConfig_;
+    bool multiplexedServices_ {false};
+
     /* OM details */
     std::string omIp_;
     int omPort_;
@@ -618,7 +650,10 @@ struct SvcMgr : HasModuleProvider, Module, StateProvider {
 
 
 /**
-* @brief Wrapper around service information and service rpc client.
+* @brief Wrapper around service information and the send path to the service.
+* Messages are serialized by the sending thread and queued on a SvcPeerSender, so
+* no lock is held while they are written and a slow service only backs up its own
+* queue.
 */
 struct SvcHandle : HasModuleProvider {
     SvcHandle(CommonModuleProviderIf *moduleProvider,
@@ -634,8 +669,10 @@ struct SvcHandle : HasModuleProvider {
     *
     * @param header
     * @param payload
+    *
+    * @return ERR_SVC_SEND_QUEUE_FULL when too much is queued for the service
     */
-    void sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
+    Error sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
 
     /**
     * @brief Use it for sending async response messages.  This uses asynResp() interface for
@@ -643,8 +680,10 @@ struct SvcHandle : HasModuleProvider {
     *
     * @param header
     * @param payload
+    *
+    * @return ERR_SVC_SEND_QUEUE_FULL when too much is queued for the service
     */
-    void sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
+    Error sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header, StringPtr &payload);
 
     /**
     * @brief Use it for sending async request messages based on predicate.  This uses
@@ -665,8 +704,7 @@ struct SvcHandle : HasModuleProvider {
     * @param newInfo
     */
     void updateSvcHandle(const fpi::SvcInfo &newInfo,
-                         bool forceUpdate = false,
-                         const fpi::PlatNetSvcClientPtr &client = nullptr);
+                         bool forceUpdate = false);
 
     /**
     * @brief 
@@ -688,25 +726,34 @@ struct SvcHandle : HasModuleProvider {
     *
     * @return 
     */
-    bool sendAsyncSvcMessageCommon_(bool isAsyncReqt,
-                                    fpi::AsyncHdrPtr &header,
-                                    StringPtr &payload);
+    Error sendAsyncSvcMessageCommon_(bool isAsyncReqt,
+                                     fpi::AsyncHdrPtr &header,
+                                     StringPtr &payload);
+    /**
+    * @brief Opens a connection to the service for sender_
+    */
+    int connect_();
+    /**
+    * @brief Frames sender_ couldn't write.  Marks the service down and fails them
+    */
+    void onSendFailure_(std::vector<SvcPeerSender::FramePtr> &frames);
     /**
     * @brief Checks if service is down or not
     */
     bool isSvcDown_() const;
 
     /**
-    * @brief Marks the service down.  Set rpcClient_ to null
+    * @brief Marks the service down and drops the connections to it
     */
     void markSvcDown_();
 
-    /* Lock for protecting svcInfo_ and rpcClient_ */
+    /* Lock for protecting svcInfo_ */
     mutable fds_mutex lock_;
     /* Service information */
     fpi::SvcInfo svcInfo_;
-    /* Rpc client.  Typcially this is PlatNetSvcClient */
-    fpi::PlatNetSvcClientPtr svcClient_;
+    /* Connections and outbound queues to the service.  Connections are opened
+     * lazily by the sender */
+    std::unique_ptr<SvcPeerSender> sender_;
 };
 
 }  // namespace fds
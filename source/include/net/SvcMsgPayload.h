@@ -0,0 +1,90 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_NET_SVCMSGPAYLOAD_H_
+#define SOURCE_INCLUDE_NET_SVCMSGPAYLOAD_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <fdsp_utils.h>
+
+namespace fds {
+
+/**
+* @brief Payload of a svc request.  Kept as the FDSP message it was set from and
+* serialized the first time its bytes are asked for, which for a request to a service
+* in this process is never: the local handler is handed a copy of the message.
+*
+* The message is held const.  Endpoint requests sending the same payload share one
+* SvcMsgPayload, so it's serialized once no matter how many peers it goes to, and a
+* handler modifying its copy can't change what the others send.
+*/
+struct SvcMsgPayload {
+    template<class MsgT>
+    explicit SvcMsgPayload(const boost::shared_ptr<MsgT> &msg)
+        : msg_(boost::shared_ptr<const MsgT>(msg)),
+          msgType_(&typeid(MsgT)),
+          serialize_([msg]() { return fds::serializeFdspMsg(*msg); })
+    {
+    }
+
+    explicit SvcMsgPayload(const boost::shared_ptr<std::string> &buf)
+        : buf_(buf)
+    {
+        std::call_once(serialized_, []() {});
+    }
+
+    SvcMsgPayload(const SvcMsgPayload&) = delete;
+    SvcMsgPayload& operator=(const SvcMsgPayload&) = delete;
+
+    /**
+    * @brief The message, if the payload was set from a MsgT.  Null if it only exists
+    * as bytes or was set from a different type.
+    */
+    template<class MsgT>
+    boost::shared_ptr<const MsgT> getMsg() const {
+        if (msgType_ == nullptr || *msgType_ != typeid(MsgT)) {
+            return nullptr;
+        }
+        return boost::static_pointer_cast<const MsgT>(msg_);
+    }
+
+    /**
+    * @brief Copy of the message for a receiver that may modify it, cheaper than a
+    * serialize/deserialize round trip.  Null like getMsg().
+    */
+    template<class MsgT>
+    boost::shared_ptr<MsgT> copyMsg() const {
+        auto msg = getMsg<MsgT>();
+        if (!msg) {
+            return nullptr;
+        }
+        return boost::make_shared<MsgT>(*msg);
+    }
+
+    inline bool hasMsg() const { return msg_ != nullptr; }
+
+    /**
+    * @brief Serialized message.  The first caller serializes it; safe to call from
+    * any thread.
+    */
+    const boost::shared_ptr<std::string>& getBuf() {
+        std::call_once(serialized_, [this]() { buf_ = serialize_(); });
+        return buf_;
+    }
+
+ protected:
+    boost::shared_ptr<const void> msg_;
+    const std::type_info *msgType_ {nullptr};
+    std::function<boost::shared_ptr<std::string>()> serialize_;
+    std::once_flag serialized_;
+    boost::shared_ptr<std::string> buf_;
+};
+using SvcMsgPayloadPtr = boost::shared_ptr<SvcMsgPayload>;
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_NET_SVCMSGPAYLOAD_H_
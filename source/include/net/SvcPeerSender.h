@@ -0,0 +1,136 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_NET_SVCPEERSENDER_H_
+#define SOURCE_INCLUDE_NET_SVCPEERSENDER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/lockfree/queue.hpp>
+#include <fds_error.h>
+#include <fdsp/svc_types_types.h>
+
+namespace fds {
+
+namespace fpi = FDS_ProtocolInterface;
+
+/**
+* @brief Settings for the per peer send path
+*/
+struct PeerSenderConfig {
+    /* Bytes that may be queued for a peer before sends are refused */
+    uint64_t    maxQueuedBytes {64 * 1024 * 1024};
+    /* Frames written with one system call at most */
+    uint32_t    maxBatchFrames {64};
+};
+
+/**
+* @brief Outbound frames to one peer service.
+*
+* Callers serialize their message into a frame and queue it for the peer; they never
+* block on the network.  The peer has one connection with a lock free multi producer
+* queue and a writer thread that writes whatever queued up since its last write with
+* a single gathered write (sendmsg), so a busy peer gets large writes instead of one
+* system call per message.  Like the client connection this replaced, everything sent
+* to a peer goes out on that one connection in the order it was queued; the service
+* layer protocols (e.g. volume group sequencing, a delete behind the put of the same
+* object) rely on that.
+*
+* Once maxQueuedBytes are queued for the peer, send() refuses frames with
+* ERR_SVC_SEND_QUEUE_FULL, callers fail or retry the message instead of stalling
+* behind a slow peer.
+*
+* The connection is opened by the writer thread, on the first frame queued and again
+* after a write failed.  Frames that weren't completely written (connection can't be
+* opened or breaks) are handed to the failure callback.
+*/
+struct SvcPeerSender {
+    /**
+    * @brief A TFramedTransport frame plus the header it carries
+    */
+    struct Frame {
+        std::string         data;
+        fpi::AsyncHdrPtr    header;
+    };
+    using FramePtr = std::unique_ptr<Frame>;
+
+    /* Opens a connection to the peer.  Returns the socket, -1 on failure */
+    using ConnectFn = std::function<int()>;
+    /* Frames that couldn't be written.  Called from a writer thread */
+    using FailFn = std::function<void(std::vector<FramePtr>&)>;
+
+    SvcPeerSender(const PeerSenderConfig &config, ConnectFn connectFn, FailFn failFn);
+    ~SvcPeerSender();
+
+    /**
+    * @brief Queues frame behind the frames already queued for the peer.
+    * @return ERR_SVC_SEND_QUEUE_FULL if the peer already has maxQueuedBytes queued,
+    * in which case frame is left with the caller
+    */
+    Error send(FramePtr &frame);
+
+    /**
+    * @brief Closes the connection once the write in progress on it finishes,
+    * queued frames go out on a new one.  Doesn't block and may be called from the
+    * failure callback.
+    */
+    void disconnect();
+
+    uint64_t getQueuedBytes() const { return queuedBytes_; }
+    uint64_t getFramesSent() const { return framesSent_; }
+    uint64_t getWrites() const { return writes_; }
+
+    std::string logString() const;
+
+    /* Bytes reserved at the start of Frame::data for the frame length */
+    static const uint32_t FRAME_HDR_BYTES = 4;
+
+    /**
+    * @brief Fills in the frame length the way TFramedTransport does (big endian,
+    * in the first FRAME_HDR_BYTES of data, which the caller reserved)
+    */
+    static void setFrameLength(std::string &data);
+
+ protected:
+    struct Connection {
+        Connection() : frames(128) {}
+        boost::lockfree::queue<Frame*>  frames;
+        /* Frames in the queue; dips below 0 while a push is being counted */
+        std::atomic<int32_t>            queued {0};
+        std::mutex                      wakeLock;
+        std::condition_variable         wake;
+        /* Guards fd against disconnect() while the writer opens or closes it */
+        std::mutex                      fdLock;
+        int                             fd {-1};
+        bool                            reconnect {false};
+        std::thread                     writer;
+    };
+
+    void startWriter_();
+    void writerLoop_(Connection &conn);
+    /* Writes batch to fd.  Returns the number of frames completely written, less
+     * than the batch size on error */
+    size_t writeBatch_(int fd, std::vector<FramePtr> &batch);
+    void closeConnection_(Connection &conn);
+    void failFrames_(Connection &conn, std::vector<FramePtr> &batch);
+
+    PeerSenderConfig config_;
+    ConnectFn connectFn_;
+    FailFn failFn_;
+    std::once_flag writerStarted_;
+    std::atomic<bool> stopping_;
+    std::atomic<uint64_t> queuedBytes_;
+    std::atomic<uint64_t> framesSent_;
+    std::atomic<uint64_t> writes_;
+    Connection conn_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_NET_SVCPEERSENDER_H_
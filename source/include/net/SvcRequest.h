@@ -7,6 +7,7 @@
 #include <vector>
 #include <functional>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 
 #include <fds_timer.h>
 #include <fds_typedefs.h>
@@ -18,6 +19,8 @@
 #include <concurrency/taskstatus.h>
 #include <fds_counters.h>
 #include <fds_module_provider.h>
+#include <util/StageTrace.h>
+#include <net/SvcMsgPayload.h>
 
 namespace fds {
 /* Forward declarations */
@@ -79,6 +82,12 @@ class SvcRequestCounters : public FdsCounters
     NumericCounter      appsuccess;
     /* Number of responses that resulted in app rejections */
     NumericCounter      apperrors;
+    /* Number of requests hedged to another endpoint */
+    NumericCounter      hedged;
+    /* Number of hedged requests where the hedge responded first */
+    NumericCounter      hedgewins;
+    /* Number of hedges skipped because the hedge budget was exhausted */
+    NumericCounter      hedgedenied;
 };
 
 template <class ReqT, class RespMsgT>
@@ -128,6 +137,21 @@ struct SvcRequestTimer : HasModuleProvider, FdsTimerTask {
     boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr> header_;
 };
 
+/**
+* @brief Timer task that kicks off a hedged request.  Like responses, the hedge
+* is run on the synchronized task executor of the request it belongs to.  If the
+* request is already complete (no longer tracked) the timer does nothing.
+*/
+struct SvcRequestHedgeTimer : HasModuleProvider, FdsTimerTask {
+    SvcRequestHedgeTimer(CommonModuleProviderIf* provider,
+                         const SvcRequestId &id);
+
+    virtual void runTimerTask() override;
+
+ protected:
+    SvcRequestId id_;
+};
+
 struct EpIdProvider {
     virtual fpi::SvcUuid getNextEp() = 0;
     virtual std::vector<fpi::SvcUuid> getEps() = 0;
@@ -147,6 +171,13 @@ struct DltObjectIdEpProvider : EpIdProvider {
             epIds_.push_back(g[i].toSvcUuid());
         }
     }
+    explicit DltObjectIdEpProvider(const TableRoute &route)
+    {
+        epIds_.reserve(route.depth);
+        for (uint32_t i = 0; i < route.depth; i++) {
+            epIds_.push_back(route.get(i).toSvcUuid());
+        }
+    }
     virtual fpi::SvcUuid getNextEp() override
     {
         // TODO(Rao): Impl
@@ -180,6 +211,13 @@ struct DmtVolumeIdEpProvider : EpIdProvider {
             epIds_.push_back(g[i].toSvcUuid());
         }
     }
+    explicit DmtVolumeIdEpProvider(const TableRoute &route)
+    {
+        epIds_.reserve(route.depth);
+        for (uint32_t i = 0; i < route.depth; i++) {
+            epIds_.push_back(route.get(i).toSvcUuid());
+        }
+    }
     virtual fpi::SvcUuid getNextEp() override
     {
         // TODO(Rao): Impl
@@ -216,6 +254,7 @@ struct TrackableRequest : HasModuleProvider {
         completionCb_ = completionCb;
     }
     inline bool isComplete() const { return state_ == SVC_REQUEST_COMPLETE; }
+    inline SvcRequestState getState() const { return state_; }
 
     virtual std::string logString() = 0;
     virtual void handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header,
@@ -245,23 +284,31 @@ struct SvcRequestIf : TrackableRequest {
 
     virtual ~SvcRequestIf();
 
+    /**
+    * @brief Sets the message to send.  It's serialized only if it goes to another
+    * process; a handler in this process gets a copy.  It may be serialized any time
+    * after this call, so don't modify it once it's set.
+    */
     template<class PayloadT>
     void setPayload(const fpi::FDSPMsgTypeId &msgTypeId,
                     const boost::shared_ptr<PayloadT> &payload)
     {
-        boost::shared_ptr<std::string>buf;
-        /* NOTE: Doing the serialization on calling thread */
-        fds::serializeFdspMsg(*payload, buf);
-        setPayloadBuf(msgTypeId, buf);
+        setMsgPayload(msgTypeId, boost::make_shared<SvcMsgPayload>(payload));
     }
     void setPayloadBuf(const fpi::FDSPMsgTypeId &msgTypeId,
                        const boost::shared_ptr<std::string> &buf);
+    void setMsgPayload(const fpi::FDSPMsgTypeId &msgTypeId,
+                       const SvcMsgPayloadPtr &payload);
 
     template<class PayloadT>
     boost::shared_ptr<PayloadT> getRequestPayload(const fpi::FDSPMsgTypeId &msgTypeId) {
-        if (msgTypeId != msgTypeId_) return NULL;
+        if (msgTypeId != msgTypeId_ || !payload_) return NULL;
+        auto msg = payload_->copyMsg<PayloadT>();
+        if (msg) {
+            return msg;
+        }
         Error e;
-        return fds::deserializeFdspMsg<PayloadT>(e, payloadBuf_);
+        return fds::deserializeFdspMsg<PayloadT>(e, payload_->getBuf());
     }
 
     virtual void invoke();
@@ -289,6 +336,8 @@ struct SvcRequestIf : TrackableRequest {
 
     /* DLT Version (if applicable) */
     fds_uint64_t dlt_version_ { DLT_VER_INVALID };
+    /* Sampled stage trace id of the request this is sent on behalf of */
+    int64_t traceId_ { StageTracer::current() };
 
  protected:
     virtual void invokeWork_() = 0;
@@ -302,8 +351,8 @@ struct SvcRequestIf : TrackableRequest {
     fpi::SvcUuid myEpId_;
     /* Message type id */
     fpi::FDSPMsgTypeId msgTypeId_;
-    /* Payload buffer */
-    boost::shared_ptr<std::string> payloadBuf_;
+    /* Payload, shared with the endpoint requests sending it */
+    SvcMsgPayloadPtr payload_;
     /* Response header */
     fpi::AsyncHdrPtr respHeader_;
     /* Response payload */
@@ -335,6 +384,8 @@ struct EPSvcRequest : SvcRequestIf {
     virtual std::string logString() override;
 
     fpi::SvcUuid getPeerEpId() const;
+    /* Time (micros) the payload was sent out */
+    inline util::TimeStamp getInvocationTs() const { return invocationTs_; }
 
     void onResponseCb(EPSvcRequestRespCb cb);
     inline void set_minor(int minor) { minor_version = minor; }
@@ -353,6 +404,8 @@ struct EPSvcRequest : SvcRequestIf {
     fpi::SvcUuid                    peerEpId_;
     fpi::ReplicaId                  replicaId_;
     int32_t                         replicaVersion_;
+    /* Time (micros) the payload was sent out */
+    util::TimeStamp                 invocationTs_ {0};
     /* Reponse callback */
     EPSvcRequestRespCb              respCb_;
 
@@ -384,6 +437,23 @@ struct MultiEpSvcRequest : SvcRequestIf {
 
     void onEPAppStatusCb(EPAppStatusCb cb);
 
+    /**
+    * @brief Marks the request as a read that any of the endpoints can serve.  When
+    * hedging is enabled in config, the request is sent to the endpoint with the lowest
+    * observed latency first and hedged to the next one if it doesn't respond in time.
+    * NOTE: Only invoke during initialization.
+    */
+    inline void enableHedging() { hedgingEnabled_ = true; }
+    inline bool isHedgingEnabled() const { return hedgingEnabled_; }
+
+    /**
+    * @brief Sends the request to one more endpoint.  Invoked by SvcRequestHedgeTimer on
+    * the request's synchronized task executor.
+    */
+    virtual void hedge() {}
+
+    virtual void complete(const Error& error) override;
+
     inline const fpi::AsyncHdrPtr& responseHeader(uint8_t epIdx) const {
         return epReqs_[epIdx]->responseHeader();
     }
@@ -396,9 +466,14 @@ struct MultiEpSvcRequest : SvcRequestIf {
     inline const EPSvcRequestPtr& ep(uint8_t epIdx) const {
         return epReqs_[epIdx];
     }
+    inline uint8_t epCount() const { return epReqs_.size(); }
 
  protected:
     EPSvcRequestPtr getEpReq_(const fpi::SvcUuid &peerEpId);
+    bool isHedging_();
+    void scheduleHedge_();
+    uint32_t inFlightEpCnt_() const;
+    void recordEpLatency_(const EPSvcRequestPtr &epReq);
 
     /* Endpoint request collection */
     std::vector<EPSvcRequestPtr> epReqs_;
@@ -406,6 +481,12 @@ struct MultiEpSvcRequest : SvcRequestIf {
     EPAppStatusCb epAppStatusCb_;
     /* Keep track of the worst error we've seen */
     Error response_ {ERR_OK};
+    /* Whether request is eligible for hedging */
+    bool hedgingEnabled_ {false};
+    /* Timer that fires the hedge */
+    FdsTimerTaskPtr hedgeTimer_;
+    /* Endpoint the request was first sent to */
+    fpi::SvcUuid firstEpId_;
 };
 
 /**
@@ -436,6 +517,8 @@ struct FailoverSvcRequest : MultiEpSvcRequest {
     virtual void handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header,
             boost::shared_ptr<std::string>& payload) override;
 
+    virtual void hedge() override;
+
     virtual std::string logString() override;
 
     void onResponseCb(FailoverSvcRequestRespCb cb);
@@ -450,9 +533,12 @@ struct FailoverSvcRequest : MultiEpSvcRequest {
     virtual void invokeWork_() override;
 
     bool moveToNextHealthyEndpoint_();
+    int32_t getInFlightEpIdx_(const fpi::SvcUuid &peerEpId) const;
 
     /* Next endpoint to invoke the request on */
     uint32_t curEpIdx_;
+    /* Endpoint that responded last */
+    uint32_t lastRespEpIdx_;
 
     /* Response callback */
     FailoverSvcRequestRespCb respCb_;
@@ -491,6 +577,7 @@ struct QuorumSvcRequest : MultiEpSvcRequest {
     virtual std::string logString() override;
 
     void setQuorumCnt(const uint32_t cnt);
+    inline uint32_t getQuorumCnt() const { return quorumCnt_; }
 
     void setWaitForAllResponses(bool flag);
 
@@ -7,8 +7,10 @@
 #include <string>
 
 #include <concurrency/Mutex.h>
+#include <concurrency/SequenceIdAllocator.h>
 #include <net/SvcRequest.h>
 #include <net/SvcRequestTracker.h>
+#include <net/EndpointLatencyTracker.h>
 #include <concurrency/LFThreadpool.h>
 
 namespace FDS_ProtocolInterface {
@@ -83,6 +85,10 @@ class SvcRequestPool : HasModuleProvider {
 
     SvcRequestCounters* getSvcRequestCntrs() const;
     SvcRequestTracker* getSvcRequestTracker() const;
+    /* Per endpoint latencies used for hedging reads */
+    EndpointLatencyTracker* getEndpointLatencyTracker() const;
+    /* Fine grained timer for hedges.  Null when hedging is disabled */
+    FdsTimer* getHedgeTimer() const;
     /// Sets a DLT manager with the pool so that it
     /// be used to set DLT versions on created headers.
     /// If it's not set, the version will default to invalid.
@@ -96,10 +102,10 @@ class SvcRequestPool : HasModuleProvider {
 
  protected:
     inline SvcRequestId getNextAsyncReqId_() {
-        SvcRequestId id =  ++nextAsyncReqId_;
-        /* Ensure nextAsyncReqId_ isn't SVC_UNTRACKED_REQ_ID */
+        SvcRequestId id = reqIdAllocator_.next();
+        /* Ensure the id isn't SVC_UNTRACKED_REQ_ID */
         while (id == SVC_UNTRACKED_REQ_ID) {
-            id =  ++nextAsyncReqId_;
+            id = reqIdAllocator_.next();
         }
         return id;
     }
@@ -109,10 +115,12 @@ class SvcRequestPool : HasModuleProvider {
     template<typename T>
     T get_config(std::string const& option);
 
-    /* align it to 64, so atomic doesn't share with cacheline with other
-     * vars.  This is to prevent false-sharing and cache ping-pong.
+    /* Request ids.  The shared sequence is on a cache line of its own, to
+     * prevent false-sharing and cache ping-pong.  With fds.pm.svc.req_id_range
+     * above 1 threads take ids from ranges of their own and only go to the
+     * shared sequence once per range.
      */
-    alignas(64) std::atomic<SvcRequestId> nextAsyncReqId_;
+    SequenceIdAllocator reqIdAllocator_;
     /* Common completion callback for svc requests */
     SvcRequestCompletionCb finishTrackingCb_;
     /* Lock free threadpool on which svc requests are sent */
@@ -128,6 +136,12 @@ class SvcRequestPool : HasModuleProvider {
     SvcRequestTracker *svcRequestTracker_;
     /* Request counters */
     SvcRequestCounters *svcRequestCntrs_;
+    /* Endpoint latencies and hedge budget */
+    EndpointLatencyTrackerPtr epLatencyTracker_;
+    /* Hedge delays are in the order of milliseconds.  Regular module timer fires
+     * at second granularity.
+     */
+    std::unique_ptr<FdsTimer> hedgeTimer_;
     /* Svc request handler */
     PlatNetSvcHandlerPtr svcReqHandler_;
     /* DLT manager to use for setting/checking request routing */
@@ -3,10 +3,9 @@
 #ifndef SOURCE_INCLUDE_NET_SVCREQUESTTRACKER_H_
 #define SOURCE_INCLUDE_NET_SVCREQUESTTRACKER_H_
 
-#include <unordered_map>
 #include <string>
 
-#include <concurrency/Mutex.h>
+#include <concurrency/ShardedMap.h>
 #include <fds_counters.h>
 #include <net/SvcRequest.h>
 
@@ -16,7 +15,10 @@ namespace fds {
 struct CommonModuleProviderIf;
 
 /**
- * Tracker svc requests.  svc requests are tracked by their id
+ * Tracker svc requests.  svc requests are tracked by their id.
+ * Every request send, response and timeout on all IO threads goes through
+ * the tracker, so requests are kept in a sharded map rather than behind a
+ * single lock.
  */
 class SvcRequestTracker : HasModuleProvider {
  public:
@@ -27,8 +29,7 @@ class SvcRequestTracker : HasModuleProvider {
     uint64_t getOutstandingSvcReqsCount();
 
  protected:
-    fds_mutex svcReqMaplock_;
-    std::unordered_map<SvcRequestId, SvcRequestIfPtr> svcReqMap_;
+    ShardedMap<SvcRequestId, SvcRequestIfPtr> svcReqMap_;
 };
 
 }  // namespace fds
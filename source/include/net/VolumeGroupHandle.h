@@ -192,9 +192,12 @@ struct VolumeGroupFailoverRequest : VolumeGroupRequest {
     inline void setAvailableReplicas(const std::vector<VolumeReplicaHandle> &replicas) {
         availableReplicas_ = replicas;
     }
+    virtual void hedge() override;
 
  protected:
     virtual void invokeWork_() override;
+    std::vector<VolumeReplicaHandle> getUntriedReplicas_();
+    void sendToNextReplica_();
 
     std::vector<VolumeReplicaHandle>   availableReplicas_;
 };
@@ -458,6 +461,7 @@ void VolumeGroupHandle::sendReadMsg(const fpi::FDSPMsgTypeId &msgTypeId,
         if (!isCoordinator_) {
             req->setAvailableReplicas(functionalReplicas_);
         }
+        req->enableHedging();
         req->invoke();
     });
 }
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_INCLUDE_NET_WORKLOADCAPTURE_H_
+#define SOURCE_INCLUDE_NET_WORKLOADCAPTURE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <fds_error.h>
+#include <fdsp/svc_types_types.h>
+
+namespace fds {
+
+namespace fpi = FDS_ProtocolInterface;
+using StringPtr = boost::shared_ptr<std::string>;
+
+/**
+ * One captured message.  Fixed size and followed by storedSize bytes of
+ * payload when payloads are captured.
+ */
+struct WorkloadRecord {
+    enum Direction : uint8_t {
+        /* Request handed to a handler by PlatNetSvcHandler::asyncReqt */
+        REQUEST_IN = 0,
+        /* Response to a REQUEST_IN with the same reqId */
+        RESPONSE_OUT = 1,
+    };
+
+    /* Since the capture was started */
+    uint64_t    timestampNs;
+    int64_t     reqId;
+    int64_t     srcUuid;
+    int64_t     dstUuid;
+    int64_t     dltVersion;
+    int32_t     msgTypeId;
+    int32_t     msgCode;
+    uint32_t    payloadSize;
+    uint32_t    storedSize;
+    uint8_t     direction;
+    uint8_t     reserved[7];
+};
+static_assert(sizeof(WorkloadRecord) == 64, "capture record layout");
+
+struct WorkloadCaptureHeader {
+    static const uint64_t MAGIC = 0x4644534341505431ULL;   /* "FDSCAPT1" */
+    static const uint32_t VERSION = 1;
+
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    withPayloads;
+    /* Wall clock time the capture started at */
+    int64_t     startEpochUs;
+    int64_t     svcUuid;
+};
+
+/**
+ * @brief Records the service layer traffic of a process to a file so it can be
+ * replayed in the lab (see tools/workload_replay.cpp).
+ *
+ * Off by default.  Started and stopped at run time through setFault:
+ *
+ *     capture.start file=am.capture payload=false
+ *     capture.stop
+ *
+ * The file is always created in var/captures/ under fds-root; names with a
+ * path separator are rejected.
+ *
+ * Captured are the header fields, payload size and arrival time of every
+ * inbound request and the time its response went out; payload contents only
+ * when asked for, a replay otherwise synthesizes them.  Callers on the IO path
+ * serialize their record and hand it to a writer thread under a lock; the
+ * writer does the file IO.  A failed write stops the capture and closes the
+ * file.  When the writer falls behind by more than MAX_BUFFERED bytes records
+ * are dropped and counted rather than slowing the IO path down.
+ */
+class WorkloadCapture {
+  public:
+    static const size_t MAX_BUFFERED = 64 * 1024 * 1024;
+
+    static WorkloadCapture& instance();
+
+    /** Cheap check for the IO path */
+    static bool enabled() {
+        return instance().enabled_.load(std::memory_order_relaxed);
+    }
+
+    Error start(const std::string& path, bool withPayloads, int64_t svcUuid);
+    void stop();
+
+    void record(WorkloadRecord::Direction direction,
+                const fpi::AsyncHdr& header,
+                const StringPtr& payload);
+
+    uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    /**
+     * Reads a capture file back
+     */
+    class Reader {
+      public:
+        Reader() = default;
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        Error open(const std::string& path);
+        const WorkloadCaptureHeader& header() const { return header_; }
+        /**
+         * @return false at the end of the capture (or a truncated record)
+         */
+        bool next(WorkloadRecord& rec, std::string& payload);
+
+      private:
+        FILE*                   file_ {nullptr};
+        WorkloadCaptureHeader   header_ {};
+    };
+
+  private:
+    WorkloadCapture() = default;
+    ~WorkloadCapture();
+
+    void writerLoop();
+
+    std::atomic<bool>                       enabled_ {false};
+    bool                                    withPayloads_ {false};
+    std::chrono::steady_clock::time_point   startTime_;
+
+    std::mutex                              lock_;
+    std::condition_variable                 cond_;
+    /* Records waiting for the writer, and their total size */
+    std::vector<std::string>                buffered_;
+    size_t                                  bufferedBytes_ {0};
+    bool                                    stopping_ {false};
+    FILE*                                   file_ {nullptr};
+    std::unique_ptr<std::thread>            writer_;
+
+    std::atomic<uint64_t>                   recorded_ {0};
+    std::atomic<uint64_t>                   dropped_ {0};
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_NET_WORKLOADCAPTURE_H_
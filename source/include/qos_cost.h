@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_QOS_COST_H_
+#define SOURCE_INCLUDE_QOS_COST_H_
+
+#include <string>
+
+#include <fds_types.h>
+
+namespace fds {
+
+/**
+ * @brief Number of QoS tokens an IO costs.
+ *
+ * Volume min/max iops are expressed in tokens.  With the flat model every IO
+ * costs one token (the original behavior).  With the tiered models an IO
+ * costs one token for the operation plus one token per bytesPerToken of data
+ * it moves, so that a 1MB object GET is charged for the disk time it takes
+ * relative to a 4KB read instead of counting the same.
+ *
+ * The per tier numbers are calibrated against a 4KB random IO: on an HDD a
+ * seek costs about as much as transferring 512KB, on an SSD a 4KB read costs
+ * about as much as transferring 32KB (16KB for writes, which are slower).
+ *
+ * burstCreditMs is how long a volume may bank unused share to spend in a
+ * burst later.
+ */
+struct IoCostModel {
+    enum Tier {
+        FLAT,
+        HDD,
+        SSD
+    };
+
+    /* Caps the charge of a single IO so a misreported size can't stall a volume */
+    static const fds_uint32_t MAX_IO_COST = 1024;
+
+    Tier            tier {FLAT};
+    fds_uint64_t    readBytesPerToken {0};
+    fds_uint64_t    writeBytesPerToken {0};
+    fds_uint32_t    burstCreditMs {500};
+
+    static IoCostModel forTier(Tier tier) {
+        IoCostModel model;
+        model.tier = tier;
+        switch (tier) {
+            case HDD:
+                model.readBytesPerToken = 512 * 1024;
+                model.writeBytesPerToken = 512 * 1024;
+                break;
+            case SSD:
+                model.readBytesPerToken = 32 * 1024;
+                model.writeBytesPerToken = 16 * 1024;
+                break;
+            case FLAT:
+                break;
+        }
+        return model;
+    }
+
+    /**
+     * @param name "flat", "hdd" or "ssd"
+     * @return false if name is not a known tier
+     */
+    static bool tierFromName(const std::string& name, Tier& tier) {
+        if (name == "flat") {
+            tier = FLAT;
+        } else if (name == "hdd") {
+            tier = HDD;
+        } else if (name == "ssd") {
+            tier = SSD;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static const char* tierName(Tier tier) {
+        switch (tier) {
+            case HDD: return "hdd";
+            case SSD: return "ssd";
+            default: return "flat";
+        }
+    }
+
+    static bool isWrite(fds_io_op_t ioType) {
+        switch (ioType) {
+            case FDS_IO_WRITE:
+            case FDS_IO_OFFSET_WRITE:
+            case FDS_PUT_BLOB:
+            case FDS_PUT_BLOB_ONCE:
+            case FDS_SM_PUT_OBJECT:
+            case FDS_CAT_UPD:
+            case FDS_CAT_UPD_ONCE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** Tokens for an IO of ioType moving ioSize bytes (0 if not known) */
+    fds_uint32_t cost(fds_io_op_t ioType, fds_uint64_t ioSize) const {
+        if (tier == FLAT || ioSize == 0) {
+            return 1;
+        }
+        fds_uint64_t bytesPerToken = isWrite(ioType) ? writeBytesPerToken : readBytesPerToken;
+        if (bytesPerToken == 0) {
+            return 1;
+        }
+        fds_uint64_t tokens = 1 + ioSize / bytesPerToken;
+        if (tokens > MAX_IO_COST) {
+            tokens = MAX_IO_COST;
+        }
+        return static_cast<fds_uint32_t>(tokens);
+    }
+
+    fds_uint32_t cost(const FDS_IOType* io) const {
+        return cost(io->io_type, io->io_size);
+    }
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_QOS_COST_H_
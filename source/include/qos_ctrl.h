@@ -3,6 +3,7 @@
 #include <boost/thread/thread.hpp>
 #include <boost/lockfree/queue.hpp>
 #include <iostream>
+#include <vector>
 #include <boost/atomic.hpp>
 #include <util/Log.h>
 #include <concurrency/ThreadPool.h>
@@ -73,6 +74,9 @@ class FDS_QoSControl : public StateProvider {
    virtual Error markIODone(FDS_IOType* io);
    fds_uint32_t     waitForWorkers(); // Blocks until there is a threshold num of workers in threadpool
    virtual Error   enqueueIO(fds_volid_t volUUID, FDS_IOType *io);
+   virtual Error   enqueueIOs(fds_volid_t volUUID,
+                              const std::vector<FDS_IOType*> &ios,
+                              size_t &nEnqueued);
    void quieseceIOs(fds_volid_t volUUID);
    void quieseceIOs();
    void stopDequeue(fds_volid_t volUUID);
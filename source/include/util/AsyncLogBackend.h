@@ -0,0 +1,159 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_ASYNCLOGBACKEND_H_
+#define SOURCE_INCLUDE_UTIL_ASYNCLOGBACKEND_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/log/core/record_view.hpp>
+#include <boost/log/expressions/filter.hpp>
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/frontend_requirements.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <util/LogRing.h>
+
+namespace fds {
+
+/**
+ * @brief Boost.Log sink backend that keeps file IO off the logging threads.
+ *
+ * Meant to be used with an unlocked_sink frontend: each logging thread formats
+ * its own records (the frontend keeps a formatting context per thread) and
+ * copies them into a ring of its own.  Nothing on that path takes a lock.  A
+ * writer thread drains all rings with batched writev()s and rotates the file
+ * once it reaches the rotation size (checked after each drain pass, so a file
+ * overshoots by at most what was queued).  Records that don't fit in a full ring are
+ * dropped and counted instead of blocking the caller.
+ *
+ * Records are in order per thread.  Across threads they are only grouped by
+ * drain pass, the timestamp in each record tells the real order.
+ *
+ * File naming follows text_file_backend: records go to <fileName>_<N>.log and
+ * rotated files are moved to targetDir, N picks up after the highest
+ * number found there.
+ */
+class AsyncLogBackend :
+        public boost::log::sinks::basic_formatted_sink_backend<
+            char,
+            boost::log::sinks::combine_requirements<
+                boost::log::sinks::concurrent_feeding,
+                boost::log::sinks::flushing>::type> {
+  public:
+    typedef std::function<void (std::ostream&)> open_handler_type;
+
+    AsyncLogBackend(const std::string& fileName,
+                    const std::string& targetDir,
+                    uint64_t rotationSize,
+                    size_t ringSize = DEFAULT_RING_SIZE);
+    ~AsyncLogBackend();
+
+    /**
+     * Writes a header to every new file
+     */
+    void set_open_handler(const open_handler_type& handler);
+
+    /**
+     * Oldest rotated files are removed once the rotated files take more than
+     * maxSize bytes.  0 (default) keeps everything.
+     */
+    void set_max_dir_size(uint64_t maxSize);
+
+    /**
+     * Records passing the filter are written out before consume() returns, so
+     * the ones that matter most aren't lost if the process goes down.
+     */
+    void set_sync_filter(const boost::log::filter& filter);
+
+    /**
+     * Called by the frontend on the logging thread
+     */
+    void consume(const boost::log::record_view& rec, const string_type& formatted);
+
+    /**
+     * Writes out everything queued so far on the calling thread
+     */
+    void flush();
+
+    void rotate_file();
+
+    /**
+     * Drains what is queued and stops the writer thread
+     */
+    void stop();
+
+    /**
+     * Records dropped because their thread's ring was full
+     */
+    uint64_t dropped_records() const;
+
+    static const size_t DEFAULT_RING_SIZE = 256 * 1024;
+
+  private:
+    struct ThreadRing {
+        explicit ThreadRing(size_t size) : ring(size), orphaned(false) {}
+        LogRing                 ring;
+        /* Set when the owning thread exits, ring goes away once drained */
+        std::atomic<bool>       orphaned;
+    };
+
+    struct RingHolder {
+        explicit RingHolder(const std::shared_ptr<ThreadRing>& r) : ring(r) {}
+        ~RingHolder() { ring->orphaned = true; }
+        std::shared_ptr<ThreadRing> ring;
+    };
+
+    ThreadRing* threadRing();
+    void run();
+    /* The rest expect writeLock_ to be held */
+    size_t drainLocked();
+    void rotateLocked();
+    void openFileLocked();
+    void scanForFiles();
+    void writeOut(struct iovec* iov, int iovcnt);
+
+    const std::string                           fileName_;
+    const std::string                           targetDir_;
+    const uint64_t                              rotationSize_;
+    const size_t                                ringSize_;
+    open_handler_type                           openHandler_;
+    boost::log::filter                          syncFilter_;
+    bool                                        hasSyncFilter_;
+
+    boost::thread_specific_ptr<RingHolder>      ringHolder_;
+    mutable std::mutex                          ringsLock_;
+    std::vector<std::shared_ptr<ThreadRing>>    rings_;
+    /* Drops of rings that are gone */
+    std::atomic<uint64_t>                       retiredDrops_;
+
+    /* Serializes draining, rotation and everything about the file */
+    std::mutex                                  writeLock_;
+    int                                         fd_;
+    std::string                                 curPath_;
+    uint64_t                                    curSize_;
+    uint32_t                                    fileCounter_;
+    uint64_t                                    maxDirSize_;
+    std::deque<std::pair<std::string, uint64_t>> rotatedFiles_;
+    uint64_t                                    rotatedSize_;
+
+    std::mutex                                  runLock_;
+    std::condition_variable                     runCv_;
+    bool                                        stopping_;
+    std::thread                                 writer_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_ASYNCLOGBACKEND_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_FREQUENCYSKETCH_H_
+#define SOURCE_INCLUDE_UTIL_FREQUENCYSKETCH_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace fds {
+
+/**
+ * @brief Count-min sketch of access frequencies with periodic aging (TinyLFU style).
+ *
+ * Every key maps to one 8 bit counter in each of DEPTH rows.  An access increments
+ * only the counters holding the current minimum (conservative update) and the
+ * estimate is the minimum across rows, so estimates never undercount and
+ * overcount only on collisions.  Once sampleSize accesses have been recorded all
+ * counters are halved, so the sketch tracks recent popularity rather than all
+ * time popularity.
+ *
+ * Keys are 64 bit hashes; callers with well distributed keys (e.g. object ids)
+ * can pass a slice of the key directly.  Updates are relaxed atomics, racing
+ * increments may be lost which only lowers an estimate slightly.
+ */
+class FrequencySketch {
+  public:
+    static constexpr unsigned DEPTH = 4;
+    static constexpr uint8_t MAX_COUNT = 0xFF;
+
+    /**
+     * @param width counters per row.  Rounded up to a power of two.
+     * @param sampleSize accesses after which counters are aged.  0 means 10 * width.
+     */
+    explicit FrequencySketch(size_t width = 64 * 1024, uint64_t sampleSize = 0)
+            : width_(roundUpPow2(width)),
+              sampleSize_(sampleSize ? sampleSize : 10 * roundUpPow2(width)),
+              counters_(new std::atomic<uint8_t>[DEPTH * roundUpPow2(width)]) {
+        reset();
+    }
+
+    FrequencySketch(const FrequencySketch&) = delete;
+    FrequencySketch& operator=(const FrequencySketch&) = delete;
+
+    /**
+     * Records an access to key.  Returns the estimated frequency including this access.
+     */
+    uint32_t increment(uint64_t key) {
+        size_t idx[DEPTH];
+        uint8_t minCount = MAX_COUNT;
+        for (unsigned row = 0; row < DEPTH; ++row) {
+            idx[row] = index(key, row);
+            auto c = counters_[idx[row]].load(std::memory_order_relaxed);
+            if (c < minCount) {
+                minCount = c;
+            }
+        }
+        if (minCount < MAX_COUNT) {
+            for (unsigned row = 0; row < DEPTH; ++row) {
+                auto expected = minCount;
+                counters_[idx[row]].compare_exchange_strong(expected, minCount + 1,
+                                                            std::memory_order_relaxed);
+            }
+            ++minCount;
+        }
+
+        if (additions_.fetch_add(1, std::memory_order_relaxed) + 1 >= sampleSize_) {
+            age();
+        }
+        return minCount;
+    }
+
+    uint32_t estimate(uint64_t key) const {
+        uint8_t minCount = MAX_COUNT;
+        for (unsigned row = 0; row < DEPTH; ++row) {
+            auto c = counters_[index(key, row)].load(std::memory_order_relaxed);
+            if (c < minCount) {
+                minCount = c;
+            }
+        }
+        return minCount;
+    }
+
+    /**
+     * Halves every counter.  Called automatically every sampleSize accesses.
+     */
+    void age() {
+        bool expected = false;
+        if (!aging_.compare_exchange_strong(expected, true)) {
+            /* Somebody else is aging */
+            return;
+        }
+        for (size_t i = 0; i < DEPTH * width_; ++i) {
+            auto c = counters_[i].load(std::memory_order_relaxed);
+            counters_[i].store(c >> 1, std::memory_order_relaxed);
+        }
+        additions_.store(0, std::memory_order_relaxed);
+        agingCnt_.fetch_add(1, std::memory_order_relaxed);
+        aging_.store(false);
+    }
+
+    void reset() {
+        for (size_t i = 0; i < DEPTH * width_; ++i) {
+            counters_[i].store(0, std::memory_order_relaxed);
+        }
+        additions_.store(0, std::memory_order_relaxed);
+    }
+
+    inline size_t width() const { return width_; }
+    inline uint64_t sampleSize() const { return sampleSize_; }
+    inline uint64_t agingCount() const { return agingCnt_.load(std::memory_order_relaxed); }
+
+  private:
+    static inline size_t roundUpPow2(size_t v) {
+        size_t p = 1;
+        while (p < v) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    inline size_t index(uint64_t key, unsigned row) const {
+        static const uint64_t seeds[DEPTH] = {
+            0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+            0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+        };
+        uint64_t h = (key + row) * seeds[row];
+        h ^= h >> 32;
+        return row * width_ + (h & (width_ - 1));
+    }
+
+    const size_t                                width_;
+    const uint64_t                              sampleSize_;
+    std::unique_ptr<std::atomic<uint8_t>[]>     counters_;
+    std::atomic<uint64_t>                       additions_ {0};
+    std::atomic<uint64_t>                       agingCnt_ {0};
+    std::atomic<bool>                           aging_ {false};
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_FREQUENCYSKETCH_H_
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_LATENCYHISTOGRAM_H_
+#define SOURCE_INCLUDE_UTIL_LATENCYHISTOGRAM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace fds {
+
+/**
+ * @brief Lock free log-linear (HDR style) histogram of latencies.
+ *
+ * Values are bucketed by their power of two, and every power of two is split
+ * into SUB_BUCKETS linear sub-buckets.  This bounds the relative error of any
+ * reported percentile to 1/SUB_BUCKETS while keeping the bucket array small and
+ * fixed.  Recording is a single relaxed fetch_add on the target bucket so it is
+ * safe to call from any number of threads.  Values beyond MAX_VALUE are clamped
+ * into the last bucket.
+ *
+ * Unlike Histogram (Histogram.h) there is no range configuration; the same
+ * layout is used for nanosecond and microsecond latencies.
+ */
+class LatencyHistogram {
+  public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr unsigned MAX_VALUE_BITS = 40;
+    static constexpr uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    static constexpr uint64_t MAX_VALUE = (1ULL << MAX_VALUE_BITS) - 1;
+    static constexpr size_t NUM_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram() {
+        reset();
+    }
+
+    LatencyHistogram(const LatencyHistogram& rhs) {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            buckets_[i].store(rhs.buckets_[i].load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    inline void record(uint64_t val, uint64_t cnt = 1) {
+        buckets_[bucketIndex(val)].fetch_add(cnt, std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds all the samples of rhs to this histogram
+     */
+    void merge(const LatencyHistogram& rhs) {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            auto c = rhs.buckets_[i].load(std::memory_order_relaxed);
+            if (c) {
+                buckets_[i].fetch_add(c, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void reset() {
+        for (auto &b : buckets_) {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (auto &b : buckets_) {
+            total += b.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * Returns the highest value equivalent to the bucket holding the pth
+     * percentile (0 < p <= 100).  Returns 0 for an empty histogram.
+     */
+    uint64_t percentile(double p) const {
+        uint64_t counts[NUM_BUCKETS];
+        uint64_t total = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+        if (p > 100.0) {
+            p = 100.0;
+        }
+        uint64_t target = static_cast<uint64_t>((p / 100.0) * total + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                return bucketHighValue(i);
+            }
+        }
+        return MAX_VALUE;
+    }
+
+    static inline size_t bucketIndex(uint64_t val) {
+        if (val > MAX_VALUE) {
+            val = MAX_VALUE;
+        }
+        if (val < SUB_BUCKETS) {
+            return static_cast<size_t>(val);
+        }
+        unsigned msb = 63 - __builtin_clzll(val);
+        unsigned shift = msb - SUB_BUCKET_BITS;
+        /* Top SUB_BUCKET_BITS + 1 bits of the value, leading one stripped */
+        uint64_t sub = (val >> shift) - SUB_BUCKETS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + sub);
+    }
+
+    static inline uint64_t bucketLowValue(size_t idx) {
+        if (idx < SUB_BUCKETS) {
+            return idx;
+        }
+        unsigned shift = idx / SUB_BUCKETS - 1;
+        uint64_t sub = idx % SUB_BUCKETS + SUB_BUCKETS;
+        return sub << shift;
+    }
+
+    static inline uint64_t bucketHighValue(size_t idx) {
+        if (idx < SUB_BUCKETS) {
+            return idx;
+        }
+        unsigned shift = idx / SUB_BUCKETS - 1;
+        return bucketLowValue(idx) + (1ULL << shift) - 1;
+    }
+
+  private:
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_LATENCYHISTOGRAM_H_
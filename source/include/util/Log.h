@@ -15,11 +15,13 @@
 #undef test
 #endif
 
+#include <atomic>
 #include <fstream>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/log/core.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/unlocked_frontend.hpp>
 #include <boost/log/utility/setup/file.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/attributes/mutable_constant.hpp>
@@ -35,29 +37,25 @@
 
 #include <fds_defines.h>
 #include <util/attributes.h>
-#define FDS_LOG(lg) BOOST_LOG_STREAM_WITH_PARAMS((lg.get_slog()), \
-                                                 (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
-                                                 (boost::log::keywords::severity = fds::fds_log::debug) \
-                                                )
-#define FDS_PLOG(lg_ptr) BOOST_LOG_STREAM_WITH_PARAMS((lg_ptr->get_slog()), \
-                                                      (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
-                                                      (boost::log::keywords::severity = fds::fds_log::debug) \
-                                                     )
+#include <util/AsyncLogBackend.h>
+/*
+ * Severity is checked against the logger's level before any attribute work or
+ * record allocation.  The if/else form keeps a trailing else bound to the caller's if.
+ */
+#define FDS_LOG_STREAM(lg, sev) if (!(lg).isEnabled(sev)) {} else \
+                                    BOOST_LOG_STREAM_WITH_PARAMS(((lg).get_slog()), \
+                                                                 (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
+                                                                 (boost::log::keywords::severity = (sev)) \
+                                                                )
+#define FDS_LOG(lg) FDS_LOG_STREAM(lg, fds::fds_log::debug)
+#define FDS_PLOG(lg_ptr) FDS_LOG_STREAM(*(lg_ptr), fds::fds_log::debug)
 
 //If the build is a debug build we want source location exposed
-#define FDS_PLOG_SEV(lg_ptr, sev) BOOST_LOG_STREAM_WITH_PARAMS((lg_ptr->get_slog()), \
-                                                               (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
-                                                               (boost::log::keywords::severity = (sev)) \
-                                                              )
-#define FDS_LOG_SEV(lg_ptr, sev) BOOST_LOG_STREAM_WITH_PARAMS((lg_ptr.get_slog()), \
-                                                               (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
-                                                               (boost::log::keywords::severity = (sev)) \
-                                                              )
-
-#define FDS_PLOG_COMMON(lg_ptr, sev) BOOST_LOG_STREAM_WITH_PARAMS((lg_ptr->get_slog()), \
-                                                   (fds::set_get_attrib("Location", (__LOC__), (__func__))) \
-                                                   (boost::log::keywords::severity = (sev)) \
-                                                  ) << __FUNCTION__ << " " << __LINE__ << " " << log_string() << " "
+#define FDS_PLOG_SEV(lg_ptr, sev) FDS_LOG_STREAM(*(lg_ptr), sev)
+#define FDS_LOG_SEV(lg_ptr, sev) FDS_LOG_STREAM(lg_ptr, sev)
+
+#define FDS_PLOG_COMMON(lg_ptr, sev) FDS_LOG_STREAM(*(lg_ptr), sev) \
+                                     << __FUNCTION__ << " " << __LINE__ << " " << log_string() << " "
 #define FDS_PLOG_INFO(lg_ptr) FDS_PLOG_COMMON(lg_ptr, fds::fds_log::normal)
 #define FDS_PLOG_WARN(lg_ptr) FDS_PLOG_COMMON(lg_ptr, fds::fds_log::warning)
 #define FDS_PLOG_ERR(lg_ptr)  FDS_PLOG_COMMON(lg_ptr, fds::fds_log::error)
@@ -72,26 +70,26 @@
 #define LEVELCHECK(sev) if (LOGGERPTR->getSeverityLevel()<= fds::fds_log::sev)
 #define GLEVELCHECK(sev) if (GLOGGERPTR->getSeverityLevel()<= fds::fds_log::sev)
 
-#define LOGTRACE    LEVELCHECK(trace)        FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::trace)
-#define LOGDEBUG    LEVELCHECK(debug)        FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::debug)
-#define LOGMIGRATE  LEVELCHECK(migrate)      FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::migrate)
-#define LOGIO       LEVELCHECK(io)           FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::io)
-#define LOGNORMAL   LEVELCHECK(normal)       FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::normal)
-#define LOGNOTIFY   LEVELCHECK(notification) FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::notification)
-#define LOGWARN     LEVELCHECK(warning)      FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::warning)
-#define LOGERROR    LEVELCHECK(error)        FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::error)
-#define LOGCRITICAL LEVELCHECK(critical)     FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::critical)
+#define LOGTRACE    FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::trace)
+#define LOGDEBUG    FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::debug)
+#define LOGMIGRATE  FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::migrate)
+#define LOGIO       FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::io)
+#define LOGNORMAL   FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::normal)
+#define LOGNOTIFY   FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::notification)
+#define LOGWARN     FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::warning)
+#define LOGERROR    FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::error)
+#define LOGCRITICAL FDS_PLOG_SEV(LOGGERPTR, fds::fds_log::critical)
 
 // for static functions inside classes
-#define GLOGTRACE    GLEVELCHECK(trace)        FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::trace)
-#define GLOGDEBUG    GLEVELCHECK(debug)        FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::debug)
-#define GLOGMIGRATE  GLEVELCHECK(migrate)      FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::migrate)
-#define GLOGIO       GLEVELCHECK(io)           FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::io)
-#define GLOGNORMAL   GLEVELCHECK(normal)       FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::normal)
-#define GLOGNOTIFY   GLEVELCHECK(notification) FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::notification)
-#define GLOGWARN     GLEVELCHECK(warning)      FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::warning)
-#define GLOGERROR    GLEVELCHECK(error)        FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::error)
-#define GLOGCRITICAL GLEVELCHECK(critical)     FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::critical)
+#define GLOGTRACE    FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::trace)
+#define GLOGDEBUG    FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::debug)
+#define GLOGMIGRATE  FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::migrate)
+#define GLOGIO       FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::io)
+#define GLOGNORMAL   FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::normal)
+#define GLOGNOTIFY   FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::notification)
+#define GLOGWARN     FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::warning)
+#define GLOGERROR    FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::error)
+#define GLOGCRITICAL FDS_PLOG_SEV(GLOGGERPTR, fds::fds_log::critical)
 
 
 // #define FUNCTRACING
@@ -143,8 +141,12 @@ class fds_log {
   private:
     typedef boost::log::sinks::synchronous_sink< boost::log::sinks::text_ostream_backend > text_sink;
     typedef boost::log::sinks::synchronous_sink< boost::log::sinks::text_file_backend > file_sink;
+    typedef boost::log::sinks::unlocked_sink< AsyncLogBackend > async_sink;
 
+    /* Exactly one of sink/asyncSink is set, frontend points at it */
     boost::shared_ptr< file_sink > sink;
+    boost::shared_ptr< async_sink > asyncSink;
+    boost::shared_ptr< boost::log::sinks::basic_sink_frontend > frontend;
     boost::log::sources::severity_logger_mt< severity_level > slg;
 
     void init(const std::string& logfile,
@@ -155,30 +157,47 @@ class fds_log {
               bool pname,
               bool pid,
               bool tid,
-              bool record);
+              bool record,
+              bool async);
+    void initSync(const std::string& logfile, const std::string& logloc);
+    void initAsync(const std::string& logfile, const std::string& logloc);
 
   public:
 
     /*
      * Constructs new log in specific location.
+     * With async, records are queued per thread and written out by a
+     * background thread (see AsyncLogBackend).
      */
     explicit fds_log(const std::string& logfile = "fds",
                      const std::string& logloc  = "",
-                     severity_level level       = normal);
+                     severity_level level       = normal,
+                     bool async                 = false);
 
     ~fds_log();
 
     static severity_level getLevelFromName(std::string level);
 
     void setSeverityFilter(const severity_level &level);
-    inline severity_level getSeverityLevel() { return severityLevel; }
+    inline severity_level getSeverityLevel() const {
+        return severityLevel.load(std::memory_order_relaxed);
+    }
+    inline bool isEnabled(severity_level sev) const {
+        return BOOST_LIKELY(sev >= getSeverityLevel());
+    }
     boost::log::sources::severity_logger_mt<severity_level>& get_slog() { return slg; }
 
-    void flush() { sink->flush(); }
+    void flush() { frontend->flush(); }
     void rotate();
 
+    /*
+     * Records dropped by the async pipeline because a thread's queue was full.
+     * Always 0 for a synchronous log.
+     */
+    uint64_t droppedRecords() const;
+
   private :
-    severity_level severityLevel = normal;
+    std::atomic<severity_level> severityLevel {normal};
 };
 
 struct HasLogger {
@@ -200,7 +219,7 @@ typedef boost::shared_ptr<fds_log> fds_logPtr;
  * Adds and modifies attributes for the logger stream - helps logger see function, file, and line number as a
  * part of the attributes
  */
-std::string set_get_attrib(const char* name, std::string value, const char * function_name);
+const char* set_get_attrib(const char* name, const char* value, const char * function_name);
 
 }  // namespace fds
 #endif  // SOURCE_UTIL_LOG_H_
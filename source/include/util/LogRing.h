@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_LOGRING_H_
+#define SOURCE_INCLUDE_UTIL_LOGRING_H_
+
+#include <sys/uio.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace fds {
+
+/**
+ * @brief Single producer, single consumer byte ring for formatted log records.
+ *
+ * The producer appends whole records; a record is either copied in completely
+ * or dropped (and counted) when there isn't room, the producer never waits.
+ * Records are published one at a time, so the readable range handed to the
+ * consumer always ends on a record boundary and can be written out as is with
+ * a single writev() of at most two segments.
+ */
+class LogRing {
+  public:
+    explicit LogRing(size_t capacity)
+            : capacity_(roundUpPow2(capacity)),
+              mask_(capacity_ - 1),
+              buf_(new char[capacity_]),
+              head_(0),
+              tail_(0),
+              dropped_(0) {
+    }
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    /**
+     * Producer side.  Appends len bytes of data, plus a newline if requested.
+     * @return false if the record didn't fit and was dropped
+     */
+    bool push(const char* data, size_t len, bool newline = true) {
+        size_t total = len + (newline ? 1 : 0);
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        if (total > capacity_ - (head - tail)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        copyIn(head, data, len);
+        if (newline) {
+            buf_[(head + len) & mask_] = '\n';
+        }
+        head_.store(head + total, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side.  Fills iov with the readable range.
+     * @return number of readable bytes, iovcnt is set to 0, 1 or 2
+     */
+    size_t peek(struct iovec iov[2], int& iovcnt) const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        size_t avail = head - tail;
+        iovcnt = 0;
+        if (avail == 0) {
+            return 0;
+        }
+        size_t off = tail & mask_;
+        size_t first = std::min(avail, capacity_ - off);
+        iov[iovcnt].iov_base = &buf_[off];
+        iov[iovcnt++].iov_len = first;
+        if (first < avail) {
+            iov[iovcnt].iov_base = &buf_[0];
+            iov[iovcnt++].iov_len = avail - first;
+        }
+        return avail;
+    }
+
+    /**
+     * Consumer side.  Releases bytes previously returned by peek()
+     */
+    void consume(size_t bytes) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return capacity_; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  private:
+    static size_t roundUpPow2(size_t v) {
+        size_t p = 64;
+        while (p < v) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    void copyIn(uint64_t pos, const char* data, size_t len) {
+        size_t off = pos & mask_;
+        size_t first = std::min(len, capacity_ - off);
+        memcpy(&buf_[off], data, first);
+        memcpy(&buf_[0], data + first, len - first);
+    }
+
+    const size_t                    capacity_;
+    const size_t                    mask_;
+    std::unique_ptr<char[]>         buf_;
+    /* Producer and consumer positions live on their own cache lines */
+    alignas(64) std::atomic<uint64_t> head_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t>           dropped_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_LOGRING_H_
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_OBJECTPOOL_H_
+#define SOURCE_INCLUDE_UTIL_OBJECTPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <concurrency/ShardedCounter.h>
+
+namespace fds {
+
+/**
+ * Reuse statistics of one pool
+ */
+struct ObjectPoolStats {
+    explicit ObjectPoolStats(const std::string& poolName) : name(poolName), cached(0) {}
+
+    std::string             name;
+    /* Every allocation through the pool */
+    ShardedCounter          allocs;
+    /* Allocations served from a free list instead of malloc */
+    ShardedCounter          reuses;
+    ShardedCounter          frees;
+    /* Frees handed back to malloc because the pool was full */
+    ShardedCounter          releases;
+    /* Objects sitting in the shared depot */
+    std::atomic<int64_t>    cached;
+};
+
+/**
+ * Every pool in the process registers its stats here so they can be exported
+ * as counters (see ObjectPoolCounter).
+ */
+class ObjectPoolRegistry {
+  public:
+    static ObjectPoolRegistry& instance();
+
+    void add(ObjectPoolStats* stats);
+    void forEach(const std::function<void (const ObjectPoolStats&)>& f) const;
+
+    /**
+     * Counter friendly name for a type, e.g. "fds.SmIoPutObjectReq"
+     */
+    static std::string typeName(const std::type_info& type);
+
+  private:
+    mutable std::mutex              lock_;
+    std::vector<ObjectPoolStats*>   pools_;
+};
+
+/**
+ * @brief Type specific free lists for objects that are allocated and freed at
+ * IO rate.
+ *
+ * Each thread keeps a small free list per type; allocation and free touch only
+ * that list.  Requests are typically created on one thread and freed on
+ * another, so once a thread's list grows past two magazines one magazine moves
+ * to a shared depot, and a thread with an empty list takes a magazine from
+ * there.  That is the only point a lock is taken, once every MAGAZINE_SIZE
+ * operations.  When the depot is full the memory goes back to malloc, so the
+ * pool never holds more than MAX_DEPOT_MAGAZINES magazines plus what threads
+ * have cached.
+ *
+ * Only blocks of exactly sizeof(T) are pooled; derived classes that don't
+ * have a pool of their own fall through to malloc.
+ *
+ * Build with FDS_OBJECT_POOL_DISABLE to go straight to malloc, e.g. when
+ * running under valgrind or a sanitizer.
+ *
+ * @tparam NameT  type the pool is reported as, defaults to T
+ */
+template <typename T, typename NameT = T>
+class ObjectPool {
+  public:
+    static const size_t MAGAZINE_SIZE = 64;
+    static const size_t MAX_DEPOT_MAGAZINES = 64;
+
+    static void* allocate(size_t size) {
+#ifndef FDS_OBJECT_POOL_DISABLE
+        if (size == sizeof(T)) {
+            Stats& s = stats();
+            s.allocs.add(1);
+            ThreadCache& cache = threadCache();
+            if (cache.head == nullptr) {
+                cache.refill();
+            }
+            if (cache.head != nullptr) {
+                FreeBlock* block = cache.head;
+                cache.head = block->next;
+                --cache.count;
+                s.reuses.add(1);
+                return block;
+            }
+            return ::operator new(BLOCK_SIZE);
+        }
+#endif
+        return ::operator new(size);
+    }
+
+    static void deallocate(void* p, size_t size) {
+        if (p == nullptr) {
+            return;
+        }
+#ifndef FDS_OBJECT_POOL_DISABLE
+        if (size == sizeof(T)) {
+            stats().frees.add(1);
+            ThreadCache& cache = threadCache();
+            FreeBlock* block = static_cast<FreeBlock*>(p);
+            block->next = cache.head;
+            cache.head = block;
+            if (++cache.count >= 2 * MAGAZINE_SIZE) {
+                cache.spill();
+            }
+            return;
+        }
+#endif
+        ::operator delete(p);
+    }
+
+    static const ObjectPoolStats& getStats() {
+        return stats();
+    }
+
+  private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    static const size_t BLOCK_SIZE = sizeof(T) > sizeof(FreeBlock) ? sizeof(T) : sizeof(FreeBlock);
+
+    /* The depot holds magazines, free lists of MAGAZINE_SIZE blocks */
+    struct Stats : ObjectPoolStats {
+        Stats() : ObjectPoolStats(name()) {
+            ObjectPoolRegistry::instance().add(this);
+        }
+        static std::string name() {
+            std::string n = ObjectPoolRegistry::typeName(typeid(NameT));
+            return std::is_same<T, NameT>::value ? n : n + ".shared";
+        }
+        std::mutex                  depotLock;
+        std::vector<FreeBlock*>     depot;
+    };
+
+    static Stats& stats() {
+        /* Registered for the life of the process, never destroyed */
+        static Stats* s = new Stats();
+        return *s;
+    }
+
+    struct ThreadCache {
+        FreeBlock*  head = nullptr;
+        size_t      count = 0;
+
+        ~ThreadCache() {
+            /* Hand what is cached to the threads that stay around */
+            while (count >= MAGAZINE_SIZE) {
+                spill();
+            }
+            while (head != nullptr) {
+                FreeBlock* next = head->next;
+                ::operator delete(head);
+                stats().releases.add(1);
+                head = next;
+            }
+            count = 0;
+        }
+
+        /* Moves one magazine to the depot */
+        void spill() {
+            FreeBlock* magazine = head;
+            FreeBlock* last = head;
+            for (size_t i = 1; i < MAGAZINE_SIZE; ++i) {
+                last = last->next;
+            }
+            head = last->next;
+            last->next = nullptr;
+            count -= MAGAZINE_SIZE;
+
+            Stats& s = stats();
+            {
+                std::lock_guard<std::mutex> l(s.depotLock);
+                if (s.depot.size() < MAX_DEPOT_MAGAZINES) {
+                    s.depot.push_back(magazine);
+                    s.cached += MAGAZINE_SIZE;
+                    return;
+                }
+            }
+            while (magazine != nullptr) {
+                FreeBlock* next = magazine->next;
+                ::operator delete(magazine);
+                magazine = next;
+            }
+            s.releases.add(MAGAZINE_SIZE);
+        }
+
+        /* Takes a magazine from the depot, if there is one */
+        void refill() {
+            Stats& s = stats();
+            std::lock_guard<std::mutex> l(s.depotLock);
+            if (s.depot.empty()) {
+                return;
+            }
+            head = s.depot.back();
+            s.depot.pop_back();
+            count = MAGAZINE_SIZE;
+            s.cached -= MAGAZINE_SIZE;
+        }
+    };
+
+    static ThreadCache& threadCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+};
+
+/**
+ * @brief Mixin that routes new/delete of T through ObjectPool<T>.  Derive the
+ * concrete request type from it:
+ *
+ *     class SmIoPutObjectReq : public SmIoReq, public PooledObject<SmIoPutObjectReq>
+ *
+ * Call sites keep using plain new and delete.  Deleting through a base class
+ * pointer needs a virtual destructor, which is what passes the real size along.
+ */
+template <typename T>
+struct PooledObject {
+    static void* operator new(size_t size) {
+        return ObjectPool<T>::allocate(size);
+    }
+    static void operator delete(void* p, size_t size) {
+        ObjectPool<T>::deallocate(p, size);
+    }
+};
+
+/**
+ * Standard allocator on top of ObjectPool, single objects come from a pool of
+ * the rebound type (e.g. the control block and object of allocate_shared).
+ */
+template <typename T, typename NameT = T>
+struct ObjectPoolAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef ObjectPoolAllocator<U, NameT> other;
+    };
+
+    ObjectPoolAllocator() = default;
+    template <typename U>
+    ObjectPoolAllocator(const ObjectPoolAllocator<U, NameT>&) {}  // NOLINT
+
+    T* allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(ObjectPool<T, NameT>::allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        if (n == 1) {
+            ObjectPool<T, NameT>::deallocate(p, sizeof(T));
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const ObjectPoolAllocator<U, NameT>&) const { return true; }
+    template <typename U>
+    bool operator!=(const ObjectPoolAllocator<U, NameT>&) const { return false; }
+};
+
+/**
+ * boost::make_shared that takes the memory from a pool, for messages that
+ * are created per IO (e.g. responses).
+ */
+template <typename T, typename... Args>
+boost::shared_ptr<T> makePooledShared(Args&&... args) {
+    return boost::allocate_shared<T>(ObjectPoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_OBJECTPOOL_H_
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_SHMCHANNEL_H_
+#define SOURCE_INCLUDE_UTIL_SHMCHANNEL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace fds {
+
+/*
+ * Everything below lives in memory shared by two processes (possibly one of
+ * them not C++), so only fixed size, standard layout types are used and the
+ * atomics must not need a lock.
+ */
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shm channel needs lock free 64 bit atomics");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shm channel needs lock free 32 bit atomics");
+
+static const size_t SHM_CHANNEL_CACHELINE = 64;
+
+/**
+ * Request slot.  Small arguments (names, metadata) are packed into args with
+ * ShmArgWriter, the payload of a write sits in a slab buffer.
+ */
+struct ShmRequestDesc {
+    static const size_t ARGS_SIZE = 464;
+
+    uint64_t handle;        /* Chosen by the client, returned in the response */
+    uint32_t op;
+    uint32_t argLen;
+    int32_t  buffer;        /* Slab buffer holding the payload, or -1 */
+    uint32_t length;
+    int64_t  offset;
+    int64_t  txId;
+    int32_t  mode;
+    uint32_t reserved;
+    char     args[ARGS_SIZE];
+};
+static_assert(sizeof(ShmRequestDesc) % SHM_CHANNEL_CACHELINE == 0, "request slot size");
+
+/**
+ * Response slot.  The payload of a read is handed back in a slab buffer that
+ * the client frees once it has consumed it.
+ */
+struct ShmResponseDesc {
+    uint64_t handle;
+    uint32_t op;
+    uint32_t status;        /* ShmChannel::Status, transport level outcome */
+    int32_t  error;         /* Service error code of the operation */
+    int32_t  buffer;
+    uint32_t length;
+    uint32_t reserved;
+    int64_t  txId;
+    int64_t  blobSize;
+    uint64_t pad[2];
+};
+static_assert(sizeof(ShmResponseDesc) == SHM_CHANNEL_CACHELINE, "response slot size");
+
+/**
+ * Wakes up a consumer sleeping on a ring.  The consumer announces that it is
+ * about to sleep, rechecks the ring and then waits on the futex; producers
+ * only make the syscall when somebody is actually sleeping.
+ */
+struct ShmDoorbell {
+    std::atomic<uint32_t>   seq;
+    std::atomic<uint32_t>   sleepers;
+
+    void ring();
+    /**
+     * Waits for a ring() after seq was read as expected, at most timeoutUs
+     */
+    void wait(uint32_t expected, uint32_t timeoutUs);
+};
+
+/**
+ * @brief Single producer, single consumer ring of fixed size slots in shared
+ * memory.  Positions are free running, slots are indexed by position & mask.
+ * Both processes serialize their own producers (or consumers) if they have
+ * more than one.
+ */
+template <typename Entry>
+class ShmRing {
+  public:
+    struct Header {
+        alignas(SHM_CHANNEL_CACHELINE) std::atomic<uint64_t> head;
+        alignas(SHM_CHANNEL_CACHELINE) std::atomic<uint64_t> tail;
+        alignas(SHM_CHANNEL_CACHELINE) ShmDoorbell bell;
+        uint32_t    entries;
+    };
+
+    ShmRing() : hdr_(nullptr), slots_(nullptr), mask_(0) {}
+    ShmRing(Header* hdr, Entry* slots) : hdr_(hdr), slots_(slots), mask_(hdr->entries - 1) {}
+
+    static void format(Header* hdr, uint32_t entries) {
+        hdr->head.store(0, std::memory_order_relaxed);
+        hdr->tail.store(0, std::memory_order_relaxed);
+        hdr->bell.seq.store(0, std::memory_order_relaxed);
+        hdr->bell.sleepers.store(0, std::memory_order_relaxed);
+        hdr->entries = entries;
+    }
+
+    /**
+     * Producer side.  Slot to fill in, or nullptr when the ring is full.
+     * Nothing is visible to the consumer until commit().
+     */
+    Entry* reserve() {
+        uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+        if (head - hdr_->tail.load(std::memory_order_acquire) > mask_) {
+            return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+
+    void commit() {
+        hdr_->head.store(hdr_->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        hdr_->bell.ring();
+    }
+
+    bool push(const Entry& e) {
+        Entry* slot = reserve();
+        if (slot == nullptr) {
+            return false;
+        }
+        *slot = e;
+        commit();
+        return true;
+    }
+
+    /**
+     * Consumer side.  Oldest slot, or nullptr when empty; stays owned by the
+     * consumer until release().
+     */
+    const Entry* front() const {
+        uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+        if (tail == hdr_->head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+
+    void release() {
+        hdr_->tail.store(hdr_->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool pop(Entry& e) {
+        const Entry* slot = front();
+        if (slot == nullptr) {
+            return false;
+        }
+        e = *slot;
+        release();
+        return true;
+    }
+
+    /**
+     * Consumer side.  Sleeps until the ring is not empty or timeoutUs passed.
+     */
+    void waitNotEmpty(uint32_t timeoutUs) {
+        ShmDoorbell& bell = hdr_->bell;
+        uint32_t seq = bell.seq.load(std::memory_order_acquire);
+        bell.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (front() == nullptr) {
+            bell.wait(seq, timeoutUs);
+        }
+        bell.sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return hdr_->head.load(std::memory_order_acquire) - hdr_->tail.load(std::memory_order_acquire);
+    }
+    uint32_t capacity() const { return mask_ + 1; }
+
+  private:
+    Header*     hdr_;
+    Entry*      slots_;
+    uint64_t    mask_;
+};
+
+/**
+ * @brief Fixed size data buffers in shared memory with a bitmap allocator.
+ * Either process allocates and frees; a buffer is owned by whoever allocated
+ * it until it is handed over in a ring slot.
+ */
+class ShmSlab {
+  public:
+    struct Header {
+        uint32_t                count;
+        uint32_t                bufferSize;
+        alignas(SHM_CHANNEL_CACHELINE) std::atomic<uint32_t> hint;
+        /* Followed by the allocation bitmap, one bit per buffer */
+    };
+
+    ShmSlab() : hdr_(nullptr), data_(nullptr) {}
+    ShmSlab(Header* hdr, char* data) : hdr_(hdr), data_(data) {}
+
+    static size_t headerSize(uint32_t count) {
+        return sizeof(Header) + bitmapWords(count) * sizeof(uint64_t);
+    }
+    static void format(Header* hdr, uint32_t count, uint32_t bufferSize);
+
+    /**
+     * @return index of a free buffer, -1 if there is none
+     */
+    int32_t allocate();
+    void free(int32_t index);
+
+    char* buffer(int32_t index) const {
+        return data_ + static_cast<size_t>(index) * hdr_->bufferSize;
+    }
+    uint32_t bufferSize() const { return hdr_->bufferSize; }
+    uint32_t count() const { return hdr_->count; }
+    uint32_t inUse() const;
+
+  private:
+    static uint32_t bitmapWords(uint32_t count) { return (count + 63) / 64; }
+    std::atomic<uint64_t>* bitmap() const {
+        return reinterpret_cast<std::atomic<uint64_t>*>(hdr_ + 1);
+    }
+
+    Header*     hdr_;
+    char*       data_;
+};
+
+/**
+ * Packs length prefixed strings into ShmRequestDesc::args
+ */
+class ShmArgWriter {
+  public:
+    explicit ShmArgWriter(ShmRequestDesc& desc) : desc_(desc), pos_(0), ok_(true) {}
+
+    ShmArgWriter& put(const std::string& s);
+    ShmArgWriter& put(const std::map<std::string, std::string>& m);
+
+    /**
+     * @return false if the arguments did not fit, nothing should be sent
+     */
+    bool finish() {
+        desc_.argLen = pos_;
+        return ok_;
+    }
+
+  private:
+    ShmRequestDesc& desc_;
+    uint32_t        pos_;
+    bool            ok_;
+};
+
+class ShmArgReader {
+  public:
+    explicit ShmArgReader(const ShmRequestDesc& desc) : desc_(desc), pos_(0), ok_(true) {}
+
+    ShmArgReader& get(std::string& s);
+    ShmArgReader& get(std::map<std::string, std::string>& m);
+
+    /** False if any get() ran past the arguments */
+    bool ok() const { return ok_; }
+
+  private:
+    const ShmRequestDesc&   desc_;
+    uint32_t                pos_;
+    bool                    ok_;
+};
+
+/**
+ * @brief Request/response channel between two processes on one host.
+ *
+ * The segment holds a header, a request ring (client to server), a response
+ * ring (server to client) and a slab of data buffers.  The server formats a
+ * segment, the client attaches to it and checks magic, version and layout.
+ * Payloads move between the processes by slab buffer index instead of being
+ * serialized and copied through a socket.
+ */
+class ShmChannel {
+  public:
+    static const uint64_t MAGIC = 0x46445358444953ULL;     /* "FDSXDIS" */
+    static const uint32_t VERSION = 1;
+
+    /** Transport level status of a response */
+    enum Status : uint32_t {
+        STATUS_OK           = 0,
+        /* Not carried by the channel; the client resends over Thrift */
+        STATUS_UNSUPPORTED  = 1,
+        /* Payload didn't fit in a slab buffer or none was free; resend over Thrift */
+        STATUS_NO_BUFFER    = 2,
+        STATUS_BAD_REQUEST  = 3,
+    };
+
+    struct Config {
+        uint32_t requestEntries = 1024;
+        uint32_t responseEntries = 1024;
+        uint32_t bufferCount = 512;
+        uint32_t bufferSize = 2 * 1024 * 1024;
+    };
+
+    struct Header {
+        uint64_t    magic;
+        uint32_t    version;
+        uint32_t    headerSize;
+        uint64_t    segmentSize;
+        uint64_t    requestRingOffset;
+        uint64_t    requestSlotsOffset;
+        uint64_t    responseRingOffset;
+        uint64_t    responseSlotsOffset;
+        uint64_t    slabOffset;
+        uint64_t    slabDataOffset;
+        /* Bumped by the server each time it formats the segment */
+        std::atomic<uint64_t> generation;
+    };
+
+    typedef ShmRing<ShmRequestDesc> RequestRing;
+    typedef ShmRing<ShmResponseDesc> ResponseRing;
+
+    /**
+     * Bytes needed for a segment with the given layout; entry counts are
+     * rounded up to a power of two
+     */
+    static size_t segmentSize(const Config& cfg);
+
+    /**
+     * Server side.  Lays out a fresh channel in base, which must be at least
+     * segmentSize(cfg) bytes.
+     */
+    bool format(void* base, size_t size, const Config& cfg, uint64_t generation);
+
+    /**
+     * Client side.  Maps the rings of a segment formatted by the server.
+     */
+    bool attach(void* base, size_t size);
+
+    RequestRing& requests() { return requests_; }
+    ResponseRing& responses() { return responses_; }
+    ShmSlab& buffers() { return slab_; }
+    const Header* header() const { return hdr_; }
+
+  private:
+    void bind();
+
+    Header*         hdr_ = nullptr;
+    RequestRing     requests_;
+    ResponseRing    responses_;
+    ShmSlab         slab_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_SHMCHANNEL_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_INCLUDE_UTIL_STAGETRACE_H_
+#define SOURCE_INCLUDE_UTIL_STAGETRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace fds {
+
+/**
+ * Fixed points on a request's path where a sampled request is time stamped.
+ * Append only; the numeric value goes over the wire in the stage trace dump.
+ */
+enum class TraceStage : uint8_t {
+    /* Service layer, on the sending side */
+    SVC_SEND = 0,
+    SVC_RESP_RECV,
+    /* Service layer, on the receiving side */
+    HANDLER_START,
+    HANDLER_END,
+    RESP_SEND,
+    /* QoS dispatcher */
+    QOS_ENQUEUE,
+    QOS_DISPATCH,
+    QOS_DONE,
+    /* Object store (SM) and catalog (DM) work */
+    DISK_IO_START,
+    DISK_IO_END,
+    /* Object id computation (AM) */
+    HASH_START,
+    HASH_END,
+    MAX_STAGE
+};
+
+struct StageTraceEvent {
+    int64_t     traceId;
+    /* Wall clock so that events from different services line up */
+    uint64_t    tsNs;
+    /* Stage specific, message type id for the service layer stages */
+    int32_t     arg;
+    TraceStage  stage;
+};
+
+/**
+ * @brief Low overhead sampled tracing of where a request spends its time,
+ * available in release builds (unlike PerfTracer).
+ *
+ * One in sampleRate requests entering the system is given a non-zero trace id.
+ * The id follows the request in FDS_IOType::traceId within a process and in
+ * fpi::AsyncHdr::trace_id between processes, and every stage it passes is
+ * recorded as (traceId, stage, timestamp) into a ring owned by the recording
+ * thread.  Recording for an unsampled request (trace id 0) is a compare and
+ * return.  A full ring drops events rather than blocking.
+ *
+ * Events are collected with drain(); services hand them out through
+ * getCounters("stagetrace") and fdsconsole's "service stagetrace" assembles
+ * the traces of all services into per-stage latency percentiles.
+ *
+ * current() is the trace id of the request the calling thread is working on,
+ * set with a Scope by code that picks up a request (service handlers, QoS
+ * processIO); requests created while it is set inherit it.
+ */
+class StageTracer {
+  public:
+    /* Events per thread ring, power of 2 */
+    static const uint32_t RING_SIZE = 2048;
+
+    /** 0 turns sampling off */
+    static void setSampleRate(uint32_t oneIn);
+    static uint32_t sampleRate() {
+        return sampleRate_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Called where a request enters the system.
+     * @return new trace id for a request that is sampled, 0 otherwise
+     */
+    static int64_t sample() {
+        auto rate = sampleRate_.load(std::memory_order_relaxed);
+        if (rate == 0 || ++sampleCount_ < rate) {
+            return 0;
+        }
+        sampleCount_ = 0;
+        return newTraceId();
+    }
+
+    static int64_t current() {
+        return current_;
+    }
+
+    static void setCurrent(int64_t traceId) {
+        current_ = traceId;
+    }
+
+    static void record(int64_t traceId, TraceStage stage, int32_t arg = 0) {
+        if (traceId != 0) {
+            recordSampled(traceId, stage, arg);
+        }
+    }
+
+    /**
+     * Moves the events recorded so far by all threads into out
+     */
+    static void drain(std::vector<StageTraceEvent>& out);
+
+    /** Events dropped because a ring was full */
+    static uint64_t dropped();
+
+    static const char* stageName(TraceStage stage);
+
+    /**
+     * Sets current() for the lifetime of the scope
+     */
+    class Scope {
+      public:
+        explicit Scope(int64_t traceId)
+                : prev_(current_) {
+            current_ = traceId;
+        }
+        ~Scope() {
+            current_ = prev_;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        int64_t prev_;
+    };
+
+  private:
+    static int64_t newTraceId();
+    static void recordSampled(int64_t traceId, TraceStage stage, int32_t arg);
+
+    static std::atomic<uint32_t>    sampleRate_;
+    static thread_local uint32_t    sampleCount_;
+    static thread_local int64_t     current_;
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_INCLUDE_UTIL_STAGETRACE_H_
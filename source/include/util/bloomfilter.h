@@ -33,14 +33,60 @@ struct BloomFilter {
     uint32_t read(serialize::Deserializer* d);
     uint32_t getEstimatedSize() const;
 
+    inline uint32_t getTotalBits() const { return totalBits; }
+    inline uint32_t getBitsPerKey() const { return bitsPerKey; }
+
   protected:
     uint32_t bitsPerKey = 8;
     uint32_t totalBits = 1024;
     SHPTR<boost::dynamic_bitset<> > bits;
+
+    friend struct CountingBloomFilter;
 };
 
 using BloomFilterPtr = SHPTR<BloomFilter>;
 
+/**
+ * Bloom filter that supports removal.  Every bit position of BloomFilter is
+ * backed by a 4 bit counter.  Counters saturate at MAX_COUNT and stay saturated
+ * (an overflowed position can't be decremented safely), so a removal never
+ * turns a present key into an absent one.  Positions are generated the same
+ * way as BloomFilter with the same size, so toBloomFilter() output can be
+ * looked up by anyone holding a plain BloomFilter.
+ * This is a non- thread safe bloom filter
+ */
+struct CountingBloomFilter {
+    explicit CountingBloomFilter(uint32_t totalBits=1*MB, uint8_t bitsPerKey=8);
+    void add(const ObjectID& objID);
+    /* Removing a key that was never added leaves false negatives for other keys */
+    void remove(const ObjectID& objID);
+    bool lookup(const ObjectID& objID) const;
+
+    /**
+     * Returns a bloom filter with a bit set for every non-zero counter
+     */
+    BloomFilterPtr toBloomFilter() const;
+    void clear();
+
+    static const uint8_t MAX_COUNT = 0xF;
+
+  protected:
+    inline uint8_t getCount(uint32_t pos) const {
+        return (counters[pos >> 1] >> ((pos & 1) << 2)) & MAX_COUNT;
+    }
+    inline void setCount(uint32_t pos, uint8_t count) {
+        auto shift = (pos & 1) << 2;
+        counters[pos >> 1] = (counters[pos >> 1] & ~(MAX_COUNT << shift)) | (count << shift);
+    }
+
+    /* Used for generating positions */
+    BloomFilter shape;
+    /* Two counters per byte */
+    std::vector<uint8_t> counters;
+};
+
+using CountingBloomFilterPtr = SHPTR<CountingBloomFilter>;
+
 
 }  // namespace util
 }  // namespace fds
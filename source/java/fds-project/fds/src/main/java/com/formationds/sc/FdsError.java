@@ -144,6 +144,7 @@ public enum FdsError {
     ERR_SVC_REQUEST_TIMEOUT(4003, ""),
     ERR_SVC_SERVER_PORT_ALREADY_INUSE(4004, ""),
     ERR_SVC_SERVER_CRASH(4005, ""),
+    ERR_SVC_SEND_QUEUE_FULL(4006, "Too many bytes queued for the peer service"),
 
     FDSN_StatusCreated(5000, ""),
     FDSN_StatusNOTSET(5001, ""),
@@ -2,9 +2,11 @@ package com.formationds.xdi;
 
 import com.formationds.apis.*;
 import com.formationds.commons.togglz.feature.flag.FdsFeatureToggles;
+import com.formationds.protocol.ApiException;
 import com.formationds.protocol.BlobDescriptor;
 import com.formationds.protocol.BlobListOrder;
 import com.formationds.protocol.commonConstants;
+import com.formationds.protocol.ErrorCode;
 import com.formationds.protocol.PatternSemantics;
 import com.formationds.protocol.VolumeAccessMode;
 import com.formationds.security.FastUUID;
@@ -12,6 +14,9 @@ import com.formationds.util.ConsumerWithException;
 import com.formationds.util.Retry;
 import com.formationds.util.async.CompletableFutureUtility;
 import com.formationds.util.thrift.ThriftClientFactory;
+import com.formationds.xdi.shm.ShmChannel;
+import com.formationds.xdi.shm.ShmDataClient;
+import com.formationds.xdi.shm.ShmResponse;
 
 import org.apache.logging.log4j.LogManager;
 import org.apache.logging.log4j.Logger;
@@ -22,23 +27,35 @@ import org.apache.thrift.transport.TNonblockingServerSocket;
 import org.joda.time.Duration;
 
 import java.io.IOException;
+import java.net.InetAddress;
+import java.net.NetworkInterface;
 import java.nio.ByteBuffer;
 import java.util.Map;
 import java.util.UUID;
 import java.util.concurrent.CompletableFuture;
+import java.util.function.Function;
+import java.util.function.Supplier;
 
 public class RealAsyncAm implements AsyncAm {
     private static final Logger LOG = LogManager.getLogger(RealAsyncAm.class);
+    /* How often we look for the AM's shared memory segment when we have none */
+    private static final long SHM_ATTACH_INTERVAL_MS = 5000;
     private final AsyncAmResponseListener responseListener;
     private AsyncXdiServiceRequest.Iface oneWayAm;
     private String amHost;
     private int amPort;
     private int responsePort;
+    private Duration timeout;
+    /* Data path over shared memory when the AM is on this host and serves one */
+    private volatile ShmDataClient shm;
+    private volatile long nextShmAttach;
+    private boolean amIsLocal;
 
     public RealAsyncAm(String amHost, int amPort, int responsePort, Duration timeout) throws IOException {
         this.amHost = amHost;
         this.amPort = amPort;
         this.responsePort = responsePort;
+        this.timeout = timeout;
         responseListener = new AsyncAmResponseListener(timeout);
     }
 
@@ -104,6 +121,8 @@ public class RealAsyncAm implements AsyncAm {
 
             oneWayAm = factory.getClient();
 
+            InetAddress amAddress = InetAddress.getByName(amHost);
+            amIsLocal = amAddress.isLoopbackAddress() || NetworkInterface.getByInetAddress(amAddress) != null;
         } catch (Exception e) {
             LOG.error("Error starting async AM", e);
             throw new IOException(e);
@@ -122,6 +141,61 @@ public class RealAsyncAm implements AsyncAm {
         }
     }
 
+    /**
+     * @return the shared memory client, null while there is none to use
+     */
+    private ShmDataClient shm() {
+        ShmDataClient client = shm;
+        if (client != null && client.isOpen()) {
+            return client;
+        }
+        // The segment is named after the AM's port, only meaningful on its host
+        long now = System.currentTimeMillis();
+        if (!amIsLocal || now < nextShmAttach) {
+            return null;
+        }
+        synchronized (this) {
+            if (now >= nextShmAttach) {
+                nextShmAttach = now + SHM_ATTACH_INTERVAL_MS;
+                shm = ShmDataClient.attach(amPort, timeout);
+            }
+            return shm;
+        }
+    }
+
+    /**
+     * Sends a request over shared memory, or over Thrift when the channel
+     * can't carry it or the AM answers that it didn't
+     */
+    private <T> CompletableFuture<T> viaShm(Function<ShmDataClient, CompletableFuture<ShmResponse>> send,
+                                            Function<ShmResponse, T> result,
+                                            Supplier<CompletableFuture<T>> thrift) {
+        ShmDataClient client = shm();
+        CompletableFuture<ShmResponse> cf = client == null ? null : send.apply(client);
+        if (cf == null) {
+            return thrift.get();
+        }
+        return cf.<T>thenCompose(resp -> {
+            switch (resp.status) {
+                case ShmChannel.STATUS_OK:
+                    if (resp.error != ErrorCode.OK.getValue()) {
+                        ErrorCode error = ErrorCode.findByValue(resp.error);
+                        if (error == null) {
+                            error = ErrorCode.INTERNAL_SERVER_ERROR;
+                        }
+                        return CompletableFutureUtility.<T>exceptionFuture(new ApiException("AM returned " + error, error));
+                    }
+                    return CompletableFuture.completedFuture(result.apply(resp));
+                case ShmChannel.STATUS_UNSUPPORTED:
+                case ShmChannel.STATUS_NO_BUFFER:
+                    return thrift.get();
+                default:
+                    return CompletableFutureUtility.<T>exceptionFuture(
+                            new ApiException("AM rejected shared memory request", ErrorCode.BAD_REQUEST));
+            }
+        });
+    }
+
     public CompletableFuture<Void> handshake(int port) {
         return scheduleAsync(rid -> {
             oneWayAm.handshakeStart(rid, port);
@@ -189,29 +263,37 @@ public class RealAsyncAm implements AsyncAm {
     // This one
     @Override
     public CompletableFuture<TxDescriptor> startBlobTx(String domainName, String volumeName, String blobName, int blobMode) {
-        return scheduleAsync(rid ->
-                oneWayAm.startBlobTx(rid, domainName, volumeName, blobName, blobMode));
+        return viaShm(c -> c.startBlobTx(domainName, volumeName, blobName, blobMode),
+                resp -> new TxDescriptor(resp.txId),
+                () -> scheduleAsync(rid ->
+                        oneWayAm.startBlobTx(rid, domainName, volumeName, blobName, blobMode)));
     }
 
     @Override
     public CompletableFuture<Void> commitBlobTx(String domainName, String volumeName, String blobName, TxDescriptor txDescriptor) {
-        return scheduleAsync(rid -> {
-            oneWayAm.commitBlobTx(rid, domainName, volumeName, blobName, txDescriptor);
-        });
+        return viaShm(c -> c.commitBlobTx(domainName, volumeName, blobName, txDescriptor.getTxId()),
+                resp -> null,
+                () -> scheduleAsync(rid -> {
+                    oneWayAm.commitBlobTx(rid, domainName, volumeName, blobName, txDescriptor);
+                }));
     }
 
     @Override
     public CompletableFuture<Void> abortBlobTx(String domainName, String volumeName, String blobName, TxDescriptor txDescriptor) {
-        return scheduleAsync(rid -> {
-            oneWayAm.abortBlobTx(rid, domainName, volumeName, blobName, txDescriptor);
-        });
+        return viaShm(c -> c.abortBlobTx(domainName, volumeName, blobName, txDescriptor.getTxId()),
+                resp -> null,
+                () -> scheduleAsync(rid -> {
+                    oneWayAm.abortBlobTx(rid, domainName, volumeName, blobName, txDescriptor);
+                }));
     }
 
     @Override
     public CompletableFuture<ByteBuffer> getBlob(String domainName, String volumeName, String blobName, int length, ObjectOffset offset) {
-        return scheduleAsync(rid -> {
-            oneWayAm.getBlob(rid, domainName, volumeName, blobName, length, offset);
-        });
+        return viaShm(c -> c.getBlob(domainName, volumeName, blobName, length, offset.getValue()),
+                resp -> resp.data,
+                () -> scheduleAsync(rid -> {
+                    oneWayAm.getBlob(rid, domainName, volumeName, blobName, length, offset);
+                }));
     }
 
     @Override
@@ -225,31 +307,35 @@ public class RealAsyncAm implements AsyncAm {
     @Override
     public CompletableFuture<Void> updateBlob(String domainName, String volumeName, String blobName,
                                               TxDescriptor txDescriptor, ByteBuffer bytes, int length, ObjectOffset objectOffset, boolean isLast) {
-        return scheduleAsync(rid -> {
-            oneWayAm.updateBlob(rid, domainName, volumeName, blobName, txDescriptor, bytes, length, new ObjectOffset(objectOffset));
-        });
+        return viaShm(c -> c.updateBlob(domainName, volumeName, blobName, txDescriptor.getTxId(), bytes, length, objectOffset.getValue()),
+                resp -> null,
+                () -> scheduleAsync(rid -> {
+                    oneWayAm.updateBlob(rid, domainName, volumeName, blobName, txDescriptor, bytes, length, new ObjectOffset(objectOffset));
+                }));
     }
 
     @Override
     public CompletableFuture<Void> updateBlobOnce(String domainName, String volumeName, String blobName,
                                                   int blobMode, ByteBuffer bytes, int length, ObjectOffset offset, Map<String, String> metadata) {
-        return scheduleAsync(rid ->
-                oneWayAm.updateBlobOnce(rid, domainName, volumeName, blobName, blobMode, bytes, length, offset, metadata));
+        return viaShm(c -> c.updateBlobOnce(domainName, volumeName, blobName, blobMode, bytes, length, offset.getValue(), metadata),
+                resp -> null,
+                () -> scheduleAsync(rid ->
+                        oneWayAm.updateBlobOnce(rid, domainName, volumeName, blobName, blobMode, bytes, length, offset, metadata)));
     }
 
     @Override
     public CompletableFuture<Void> deleteBlob(String domainName, String volumeName, String blobName) {
-        CompletableFuture<TxDescriptor> startBlobCf = scheduleAsync(rid -> {
-            oneWayAm.startBlobTx(rid, domainName, volumeName, blobName, 1);
-        });
+        CompletableFuture<TxDescriptor> startBlobCf = startBlobTx(domainName, volumeName, blobName, 1);
 
-        CompletableFuture<Void> deleteCf = startBlobCf.thenCompose(tx -> scheduleAsync(rid -> {
-            oneWayAm.deleteBlob(rid, domainName, volumeName, blobName, tx);
-        }));
+        CompletableFuture<Void> deleteCf = startBlobCf.thenCompose(tx -> this.<Void>viaShm(
+                c -> c.deleteBlob(domainName, volumeName, blobName, tx.getTxId()),
+                resp -> null,
+                () -> scheduleAsync(rid -> {
+                    oneWayAm.deleteBlob(rid, domainName, volumeName, blobName, tx);
+                })));
 
-        return deleteCf.thenCompose(x -> startBlobCf.thenCompose(tx -> scheduleAsync(rid -> {
-            oneWayAm.commitBlobTx(rid, domainName, volumeName, blobName, tx);
-        })));
+        return deleteCf.thenCompose(x -> startBlobCf.thenCompose(tx ->
+                commitBlobTx(domainName, volumeName, blobName, tx)));
     }
 
     @Override
@@ -0,0 +1,466 @@
+package com.formationds.xdi.shm;
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+import sun.misc.Unsafe;
+import sun.nio.ch.DirectBuffer;
+
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.lang.reflect.Field;
+import java.nio.BufferOverflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+import java.nio.channels.FileLock;
+import java.nio.channels.OverlappingFileLockException;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Path;
+import java.nio.file.StandardOpenOption;
+import java.util.Map;
+
+/**
+ * Client end of the shared memory channel the AM serves to an XDI on the same
+ * host (source/include/util/ShmChannel.h, AsyncShmDataServer).  The segment
+ * holds a request ring, a response ring and a slab of data buffers; every
+ * offset below mirrors the C++ structs and must change with them.
+ *
+ * Rings are single producer, single consumer: requests are pushed under a
+ * lock, responses are only polled by one thread.  The segment is locked with
+ * a file lock so that only one process on the host is its client, the others
+ * stay on Thrift.
+ *
+ * Java can't make the futex call that rings the server's doorbell, so the
+ * sequence is bumped but a sleeping server only notices the request at the end
+ * of its doorbell wait.  The server only sleeps after it has been idle for a
+ * while, and then waits longer the longer it stays idle (1ms doubling up to
+ * 16ms), so the first request after an idle spell may wait that long.
+ */
+public class ShmChannel {
+    public static final long MAGIC = 0x46445358444953L;     /* "FDSXDIS" */
+    public static final int VERSION = 1;
+
+    /* ShmChannel::Status */
+    public static final int STATUS_OK = 0;
+    public static final int STATUS_UNSUPPORTED = 1;
+    public static final int STATUS_NO_BUFFER = 2;
+    public static final int STATUS_BAD_REQUEST = 3;
+
+    /* ShmChannel::Header */
+    private static final int HDR_MAGIC = 0;
+    private static final int HDR_VERSION = 8;
+    private static final int HDR_HEADER_SIZE = 12;
+    private static final int HDR_SEGMENT_SIZE = 16;
+    private static final int HDR_REQUEST_RING = 24;
+    private static final int HDR_REQUEST_SLOTS = 32;
+    private static final int HDR_RESPONSE_RING = 40;
+    private static final int HDR_RESPONSE_SLOTS = 48;
+    private static final int HDR_SLAB = 56;
+    private static final int HDR_SLAB_DATA = 64;
+    private static final int HDR_GENERATION = 72;
+    static final int HEADER_SIZE = 80;
+
+    /* ShmRing::Header, head tail and doorbell each on a cache line */
+    private static final int RING_HEAD = 0;
+    private static final int RING_TAIL = 64;
+    private static final int RING_SEQ = 128;
+    private static final int RING_ENTRIES = 136;
+    static final int RING_HEADER_SIZE = 192;
+
+    /* ShmRequestDesc */
+    static final int REQUEST_SIZE = 512;
+    private static final int REQ_HANDLE = 0;
+    private static final int REQ_OP = 8;
+    private static final int REQ_ARG_LEN = 12;
+    private static final int REQ_BUFFER = 16;
+    private static final int REQ_LENGTH = 20;
+    private static final int REQ_OFFSET = 24;
+    private static final int REQ_TX_ID = 32;
+    private static final int REQ_MODE = 40;
+    private static final int REQ_ARGS = 48;
+    public static final int ARGS_SIZE = 464;
+
+    /* ShmResponseDesc */
+    static final int RESPONSE_SIZE = 64;
+    private static final int RESP_HANDLE = 0;
+    private static final int RESP_OP = 8;
+    private static final int RESP_STATUS = 12;
+    private static final int RESP_ERROR = 16;
+    private static final int RESP_BUFFER = 20;
+    private static final int RESP_LENGTH = 24;
+    private static final int RESP_TX_ID = 32;
+    private static final int RESP_BLOB_SIZE = 40;
+
+    /* ShmSlab::Header, followed by the allocation bitmap */
+    private static final int SLAB_COUNT = 0;
+    private static final int SLAB_BUFFER_SIZE = 4;
+    private static final int SLAB_HINT = 64;
+    static final int SLAB_BITMAP = 128;
+
+    private static final Unsafe UNSAFE;
+
+    static {
+        try {
+            Field f = Unsafe.class.getDeclaredField("theUnsafe");
+            f.setAccessible(true);
+            UNSAFE = (Unsafe) f.get(null);
+        } catch (ReflectiveOperationException e) {
+            throw new ExceptionInInitializerError(e);
+        }
+    }
+
+    private final Path path;
+    private final FileChannel file;
+    private final FileLock lock;
+    /* Raw addresses below stay valid as long as this mapping is referenced */
+    private final MappedByteBuffer map;
+    private final long base;
+    private final long generation;
+
+    private final long requestRing;
+    private final long requestSlots;
+    private final long requestMask;
+    private final long responseRing;
+    private final long responseSlots;
+    private final long responseMask;
+    private final long slab;
+    private final int slabData;
+    private final int bufferCount;
+    private final int bufferSize;
+
+    private ShmChannel(Path path, FileChannel file, FileLock lock, MappedByteBuffer map) throws IOException {
+        this.path = path;
+        this.file = file;
+        this.lock = lock;
+        this.map = map;
+        this.base = ((DirectBuffer) map).address();
+
+        if (UNSAFE.getLongVolatile(null, base + HDR_MAGIC) != MAGIC
+                || UNSAFE.getInt(base + HDR_VERSION) != VERSION
+                || UNSAFE.getInt(base + HDR_HEADER_SIZE) != HEADER_SIZE
+                || UNSAFE.getLong(base + HDR_SEGMENT_SIZE) > map.capacity()) {
+            throw new IOException(path + ": not a channel this client understands");
+        }
+        generation = UNSAFE.getLongVolatile(null, base + HDR_GENERATION);
+        requestRing = base + UNSAFE.getLong(base + HDR_REQUEST_RING);
+        requestSlots = base + UNSAFE.getLong(base + HDR_REQUEST_SLOTS);
+        requestMask = UNSAFE.getInt(requestRing + RING_ENTRIES) - 1;
+        responseRing = base + UNSAFE.getLong(base + HDR_RESPONSE_RING);
+        responseSlots = base + UNSAFE.getLong(base + HDR_RESPONSE_SLOTS);
+        responseMask = UNSAFE.getInt(responseRing + RING_ENTRIES) - 1;
+        slab = base + UNSAFE.getLong(base + HDR_SLAB);
+        slabData = (int) UNSAFE.getLong(base + HDR_SLAB_DATA);
+        bufferCount = UNSAFE.getInt(slab + SLAB_COUNT);
+        bufferSize = UNSAFE.getInt(slab + SLAB_BUFFER_SIZE);
+    }
+
+    /**
+     * Maps a segment formatted by the AM and becomes its only client
+     *
+     * @throws IOException if there is no usable segment or another process is its client
+     */
+    public static ShmChannel attach(Path path) throws IOException {
+        return open(path, true);
+    }
+
+    private static ShmChannel open(Path path, boolean exclusive) throws IOException {
+        FileChannel file = FileChannel.open(path, StandardOpenOption.READ, StandardOpenOption.WRITE);
+        try {
+            FileLock lock = null;
+            if (exclusive) {
+                try {
+                    lock = file.tryLock();
+                } catch (OverlappingFileLockException e) {
+                    // Held by another client in this process
+                }
+                if (lock == null) {
+                    throw new IOException(path + ": already has a client");
+                }
+            }
+            long size = file.size();
+            if (size < HEADER_SIZE || size > Integer.MAX_VALUE) {
+                throw new IOException(path + ": unexpected segment size " + size);
+            }
+            return new ShmChannel(path, file, lock, file.map(FileChannel.MapMode.READ_WRITE, 0, size));
+        } catch (IOException | RuntimeException e) {
+            file.close();
+            throw e;
+        }
+    }
+
+    /**
+     * Releases the client lock.  The mapping goes away once nothing references
+     * this channel, so threads still polling it never touch unmapped memory.
+     */
+    public void close() {
+        try {
+            if (lock != null) {
+                lock.release();
+            }
+            file.close();
+        } catch (IOException e) {
+            // Nothing left to clean up
+        }
+    }
+
+    /**
+     * @return false once the AM removed the segment or formatted a new one
+     */
+    public boolean isCurrent() {
+        try (RandomAccessFile f = new RandomAccessFile(path.toFile(), "r")) {
+            ByteBuffer hdr = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.nativeOrder());
+            f.getChannel().read(hdr, 0);
+            return hdr.getLong(HDR_MAGIC) == MAGIC && hdr.getLong(HDR_GENERATION) == generation;
+        } catch (IOException e) {
+            return false;
+        }
+    }
+
+    public int bufferSize() {
+        return bufferSize;
+    }
+
+    /**
+     * Pushes a request.  Callers are serialized, the ring has a single producer.
+     *
+     * @param args   packed with {@link ArgWriter}
+     * @param buffer slab buffer holding the payload, handed over to the AM, or -1
+     * @return false if the ring is full
+     */
+    public synchronized boolean pushRequest(long handle, int op, byte[] args, int buffer, int length,
+                                            long offset, long txId, int mode) {
+        long head = UNSAFE.getLong(requestRing + RING_HEAD);
+        if (head - UNSAFE.getLongVolatile(null, requestRing + RING_TAIL) > requestMask) {
+            return false;
+        }
+        long slot = requestSlots + (head & requestMask) * REQUEST_SIZE;
+        UNSAFE.putLong(slot + REQ_HANDLE, handle);
+        UNSAFE.putInt(slot + REQ_OP, op);
+        UNSAFE.putInt(slot + REQ_ARG_LEN, args.length);
+        UNSAFE.putInt(slot + REQ_BUFFER, buffer);
+        UNSAFE.putInt(slot + REQ_LENGTH, length);
+        UNSAFE.putLong(slot + REQ_OFFSET, offset);
+        UNSAFE.putLong(slot + REQ_TX_ID, txId);
+        UNSAFE.putInt(slot + REQ_MODE, mode);
+        UNSAFE.copyMemory(args, Unsafe.ARRAY_BYTE_BASE_OFFSET, null, slot + REQ_ARGS, args.length);
+
+        // Release store: the slot is written before the server sees the head move
+        UNSAFE.putOrderedLong(null, requestRing + RING_HEAD, head + 1);
+        UNSAFE.getAndAddInt(null, requestRing + RING_SEQ, 1);
+        return true;
+    }
+
+    /**
+     * Pops the oldest response, only ever called from one thread
+     *
+     * @return null if the ring is empty
+     */
+    public ShmResponse pollResponse() {
+        long tail = UNSAFE.getLong(responseRing + RING_TAIL);
+        if (tail == UNSAFE.getLongVolatile(null, responseRing + RING_HEAD)) {
+            return null;
+        }
+        long slot = responseSlots + (tail & responseMask) * RESPONSE_SIZE;
+        ShmResponse resp = new ShmResponse(UNSAFE.getLong(slot + RESP_HANDLE),
+                                           UNSAFE.getInt(slot + RESP_OP),
+                                           UNSAFE.getInt(slot + RESP_STATUS),
+                                           UNSAFE.getInt(slot + RESP_ERROR),
+                                           UNSAFE.getInt(slot + RESP_BUFFER),
+                                           UNSAFE.getInt(slot + RESP_LENGTH),
+                                           UNSAFE.getLong(slot + RESP_TX_ID),
+                                           UNSAFE.getLong(slot + RESP_BLOB_SIZE));
+        UNSAFE.putOrderedLong(null, responseRing + RING_TAIL, tail + 1);
+        return resp;
+    }
+
+    /**
+     * @return index of a free slab buffer, -1 if there is none
+     */
+    public int allocate() {
+        int words = (bufferCount + 63) / 64;
+        int start = Integer.remainderUnsigned(UNSAFE.getIntVolatile(null, slab + SLAB_HINT), words);
+        for (int i = 0; i < words; i++) {
+            int w = (start + i) % words;
+            long word = slab + SLAB_BITMAP + w * 8L;
+            long cur = UNSAFE.getLongVolatile(null, word);
+            while (cur != ~0L) {
+                int bit = Long.numberOfTrailingZeros(~cur);
+                if (UNSAFE.compareAndSwapLong(null, word, cur, cur | (1L << bit))) {
+                    UNSAFE.putIntVolatile(null, slab + SLAB_HINT, w);
+                    return w * 64 + bit;
+                }
+                cur = UNSAFE.getLongVolatile(null, word);
+            }
+        }
+        return -1;
+    }
+
+    public void free(int index) {
+        long word = slab + SLAB_BITMAP + (index / 64) * 8L;
+        long bit = 1L << (index % 64);
+        long cur;
+        do {
+            cur = UNSAFE.getLongVolatile(null, word);
+        } while (!UNSAFE.compareAndSwapLong(null, word, cur, cur & ~bit));
+    }
+
+    /**
+     * Copies the remaining bytes of src into a slab buffer, src is left untouched
+     */
+    public void copyIn(int index, ByteBuffer src) {
+        ByteBuffer dst = map.duplicate();
+        dst.position(slabData + index * bufferSize);
+        dst.put(src.duplicate());
+    }
+
+    public ByteBuffer copyOut(int index, int length) {
+        ByteBuffer src = map.duplicate();
+        src.position(slabData + index * bufferSize);
+        src.limit(src.position() + length);
+        ByteBuffer dst = ByteBuffer.allocate(length);
+        dst.put(src);
+        dst.flip();
+        return dst;
+    }
+
+    /**
+     * Packs arguments the way ShmArgReader unpacks them: strings are a 16 bit
+     * length and UTF-8 bytes, maps a 16 bit count and then key and value of
+     * each entry.
+     */
+    public static class ArgWriter {
+        private final ByteBuffer args = ByteBuffer.allocate(ARGS_SIZE).order(ByteOrder.nativeOrder());
+        private boolean ok = true;
+
+        public ArgWriter put(String s) {
+            byte[] bytes = s.getBytes(StandardCharsets.UTF_8);
+            if (bytes.length > 0xffff) {
+                ok = false;
+                return this;
+            }
+            try {
+                args.putShort((short) bytes.length);
+                args.put(bytes);
+            } catch (BufferOverflowException e) {
+                ok = false;
+            }
+            return this;
+        }
+
+        public ArgWriter put(Map<String, String> m) {
+            if (m.size() > 0xffff) {
+                ok = false;
+                return this;
+            }
+            try {
+                args.putShort((short) m.size());
+            } catch (BufferOverflowException e) {
+                ok = false;
+                return this;
+            }
+            for (Map.Entry<String, String> e : m.entrySet()) {
+                put(e.getKey()).put(e.getValue());
+            }
+            return this;
+        }
+
+        /**
+         * @return the packed arguments, null if they didn't fit in a request slot
+         */
+        public byte[] finish() {
+            if (!ok) {
+                return null;
+            }
+            byte[] packed = new byte[args.position()];
+            System.arraycopy(args.array(), 0, packed, 0, packed.length);
+            return packed;
+        }
+    }
+
+    /**
+     * Lays out an empty segment the way ShmChannel::format does, for tests
+     * that stand in for the AM
+     */
+    static void format(Path path, int entries, int bufferCount, int bufferSize) throws IOException {
+        long requestRing = align(HEADER_SIZE, 64);
+        long requestSlots = requestRing + RING_HEADER_SIZE;
+        long responseRing = requestSlots + (long) entries * REQUEST_SIZE;
+        long responseSlots = responseRing + RING_HEADER_SIZE;
+        long slab = responseSlots + (long) entries * RESPONSE_SIZE;
+        long slabData = align(slab + SLAB_BITMAP + ((bufferCount + 63) / 64) * 8L, 4096);
+        long size = align(slabData + (long) bufferCount * bufferSize, 4096);
+
+        try (RandomAccessFile f = new RandomAccessFile(path.toFile(), "rw")) {
+            f.setLength(size);
+            ByteBuffer seg = f.getChannel().map(FileChannel.MapMode.READ_WRITE, 0, size)
+                    .order(ByteOrder.nativeOrder());
+            seg.putInt(HDR_VERSION, VERSION);
+            seg.putInt(HDR_HEADER_SIZE, HEADER_SIZE);
+            seg.putLong(HDR_SEGMENT_SIZE, size);
+            seg.putLong(HDR_REQUEST_RING, requestRing);
+            seg.putLong(HDR_REQUEST_SLOTS, requestSlots);
+            seg.putLong(HDR_RESPONSE_RING, responseRing);
+            seg.putLong(HDR_RESPONSE_SLOTS, responseSlots);
+            seg.putLong(HDR_SLAB, slab);
+            seg.putLong(HDR_SLAB_DATA, slabData);
+            seg.putLong(HDR_GENERATION, System.nanoTime());
+            seg.putInt((int) requestRing + RING_ENTRIES, entries);
+            seg.putInt((int) responseRing + RING_ENTRIES, entries);
+            seg.putInt((int) slab + SLAB_COUNT, bufferCount);
+            seg.putInt((int) slab + SLAB_BUFFER_SIZE, bufferSize);
+            for (int w = 0; w < (bufferCount + 63) / 64; w++) {
+                int first = w * 64;
+                long used = first + 64 > bufferCount ? ~0L << (bufferCount - first) : 0L;
+                seg.putLong((int) slab + SLAB_BITMAP + w * 8, used);
+            }
+            seg.putLong(HDR_MAGIC, MAGIC);
+        }
+    }
+
+    private static long align(long v, long alignment) {
+        return (v + alignment - 1) & ~(alignment - 1);
+    }
+
+    /**
+     * Maps a segment without becoming its client, for tests that stand in for the AM
+     */
+    static ShmChannel openForTest(Path path) throws IOException {
+        return open(path, false);
+    }
+
+    /**
+     * Server end of the rings, for tests that stand in for the AM.  Copies the
+     * oldest request out as {handle, op, buffer, length}, or null.
+     */
+    long[] pollRequestForTest() {
+        long tail = UNSAFE.getLong(requestRing + RING_TAIL);
+        if (tail == UNSAFE.getLongVolatile(null, requestRing + RING_HEAD)) {
+            return null;
+        }
+        long slot = requestSlots + (tail & requestMask) * REQUEST_SIZE;
+        long[] req = {UNSAFE.getLong(slot + REQ_HANDLE), UNSAFE.getInt(slot + REQ_OP),
+                      UNSAFE.getInt(slot + REQ_BUFFER), UNSAFE.getInt(slot + REQ_LENGTH)};
+        UNSAFE.putOrderedLong(null, requestRing + RING_TAIL, tail + 1);
+        return req;
+    }
+
+    boolean pushResponseForTest(ShmResponse resp) {
+        long head = UNSAFE.getLong(responseRing + RING_HEAD);
+        if (head - UNSAFE.getLongVolatile(null, responseRing + RING_TAIL) > responseMask) {
+            return false;
+        }
+        long slot = responseSlots + (head & responseMask) * RESPONSE_SIZE;
+        UNSAFE.putLong(slot + RESP_HANDLE, resp.handle);
+        UNSAFE.putInt(slot + RESP_OP, resp.op);
+        UNSAFE.putInt(slot + RESP_STATUS, resp.status);
+        UNSAFE.putInt(slot + RESP_ERROR, resp.error);
+        UNSAFE.putInt(slot + RESP_BUFFER, resp.buffer);
+        UNSAFE.putInt(slot + RESP_LENGTH, resp.length);
+        UNSAFE.putLong(slot + RESP_TX_ID, resp.txId);
+        UNSAFE.putLong(slot + RESP_BLOB_SIZE, resp.blobSize);
+        UNSAFE.putOrderedLong(null, responseRing + RING_HEAD, head + 1);
+        return true;
+    }
+}
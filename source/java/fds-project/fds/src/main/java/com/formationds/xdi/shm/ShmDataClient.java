@@ -0,0 +1,283 @@
+package com.formationds.xdi.shm;
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+import com.formationds.protocol.ApiException;
+import com.formationds.protocol.ErrorCode;
+import org.apache.logging.log4j.LogManager;
+import org.apache.logging.log4j.Logger;
+import org.joda.time.Duration;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.file.Path;
+import java.nio.file.Paths;
+import java.util.Collections;
+import java.util.Iterator;
+import java.util.Map;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.locks.LockSupport;
+
+/**
+ * Sends the data path operations the AM carries over shared memory
+ * (XdiShmOp in AmAsyncShmService.h) and matches the responses to them.
+ *
+ * Every operation returns null when the request can't go over the channel
+ * (names too long, payload bigger than a slab buffer, no free buffer, ring
+ * full, channel closed), so the caller sends it over Thrift instead.  The same
+ * goes for a response with status UNSUPPORTED or NO_BUFFER.
+ */
+public class ShmDataClient {
+    private static final Logger LOG = LogManager.getLogger(ShmDataClient.class);
+
+    /* XdiShmOp */
+    public static final int GET_BLOB = 1;
+    public static final int UPDATE_BLOB = 2;
+    public static final int UPDATE_BLOB_ONCE = 3;
+    public static final int START_BLOB_TX = 4;
+    public static final int COMMIT_BLOB_TX = 5;
+    public static final int ABORT_BLOB_TX = 6;
+    public static final int DELETE_BLOB = 7;
+
+    /* Polls of an empty response ring before parking between polls */
+    private static final int SPIN_POLLS = 1000;
+    /* Parks between polls start short and double up to the longest */
+    private static final long PARK_NANOS = TimeUnit.MICROSECONDS.toNanos(20);
+    private static final long MAX_PARK_NANOS = TimeUnit.MILLISECONDS.toNanos(1);
+    /* How often timeouts and the segment itself are checked */
+    private static final long CHECK_INTERVAL_NANOS = TimeUnit.MILLISECONDS.toNanos(500);
+
+    private static class Pending {
+        final CompletableFuture<ShmResponse> future = new CompletableFuture<>();
+        final long deadline;
+
+        Pending(long deadline) {
+            this.deadline = deadline;
+        }
+    }
+
+    private final ShmChannel channel;
+    private final long timeoutNanos;
+    private final Map<Long, Pending> pending = new ConcurrentHashMap<>();
+    private final AtomicLong nextHandle = new AtomicLong();
+    /* Completions run here, not on the thread polling the ring */
+    private final ExecutorService executor = Executors.newCachedThreadPool();
+    private volatile boolean closed = false;
+    /* Nothing is pending, the poller sleeps until a request is sent */
+    private volatile boolean pollerIdle = false;
+    private final Thread poller;
+
+    private ShmDataClient(ShmChannel channel, Duration timeout) {
+        this.channel = channel;
+        this.timeoutNanos = TimeUnit.MILLISECONDS.toNanos(timeout.getMillis());
+        poller = new Thread(this::poll, "AM shared memory response poller");
+        poller.setDaemon(true);
+        poller.start();
+    }
+
+    /**
+     * Attaches to the segment the AM serving the given XDI port created
+     *
+     * @return null if there is none, or another process on this host uses it
+     */
+    public static ShmDataClient attach(int xdiPort, Duration timeout) {
+        Path path = Paths.get("/dev/shm", "fds-xdi-" + xdiPort);
+        if (!path.toFile().exists()) {
+            return null;
+        }
+        try {
+            ShmDataClient client = new ShmDataClient(ShmChannel.attach(path), timeout);
+            LOG.info("Using AM shared memory data plane " + path);
+            return client;
+        } catch (IOException e) {
+            LOG.info("Not using AM shared memory data plane: " + e.getMessage());
+            return null;
+        }
+    }
+
+    public boolean isOpen() {
+        return !closed;
+    }
+
+    public CompletableFuture<ShmResponse> getBlob(String domainName, String volumeName, String blobName,
+                                                  int length, long offset) {
+        if (length > channel.bufferSize()) {
+            return null;
+        }
+        return send(GET_BLOB, args(domainName, volumeName, blobName).finish(), null, length, offset, 0, 0);
+    }
+
+    public CompletableFuture<ShmResponse> updateBlob(String domainName, String volumeName, String blobName,
+                                                     long txId, ByteBuffer bytes, int length, long offset) {
+        return send(UPDATE_BLOB, args(domainName, volumeName, blobName).finish(), bytes, length, offset, txId, 0);
+    }
+
+    public CompletableFuture<ShmResponse> updateBlobOnce(String domainName, String volumeName, String blobName,
+                                                         int blobMode, ByteBuffer bytes, int length, long offset,
+                                                         Map<String, String> metadata) {
+        byte[] packed = args(domainName, volumeName, blobName)
+                .put(metadata == null ? Collections.<String, String>emptyMap() : metadata)
+                .finish();
+        return send(UPDATE_BLOB_ONCE, packed, bytes, length, offset, 0, blobMode);
+    }
+
+    public CompletableFuture<ShmResponse> startBlobTx(String domainName, String volumeName, String blobName,
+                                                      int blobMode) {
+        return send(START_BLOB_TX, args(domainName, volumeName, blobName).finish(), null, 0, 0, 0, blobMode);
+    }
+
+    public CompletableFuture<ShmResponse> commitBlobTx(String domainName, String volumeName, String blobName,
+                                                       long txId) {
+        return send(COMMIT_BLOB_TX, args(domainName, volumeName, blobName).finish(), null, 0, 0, txId, 0);
+    }
+
+    public CompletableFuture<ShmResponse> abortBlobTx(String domainName, String volumeName, String blobName,
+                                                      long txId) {
+        return send(ABORT_BLOB_TX, args(domainName, volumeName, blobName).finish(), null, 0, 0, txId, 0);
+    }
+
+    public CompletableFuture<ShmResponse> deleteBlob(String domainName, String volumeName, String blobName,
+                                                     long txId) {
+        return send(DELETE_BLOB, args(domainName, volumeName, blobName).finish(), null, 0, 0, txId, 0);
+    }
+
+    private static ShmChannel.ArgWriter args(String domainName, String volumeName, String blobName) {
+        return new ShmChannel.ArgWriter().put(domainName).put(volumeName).put(blobName);
+    }
+
+    /**
+     * @param payload written from its position to its limit, which must be length bytes
+     */
+    private CompletableFuture<ShmResponse> send(int op, byte[] args, ByteBuffer payload, int length,
+                                                long offset, long txId, int mode) {
+        if (closed || args == null) {
+            return null;
+        }
+        int buffer = -1;
+        if (payload != null) {
+            if (payload.remaining() != length || length > channel.bufferSize()) {
+                return null;
+            }
+            buffer = channel.allocate();
+            if (buffer < 0) {
+                return null;
+            }
+            channel.copyIn(buffer, payload);
+        }
+
+        // Registered first, the response may come back before the push returns
+        long handle = nextHandle.incrementAndGet();
+        Pending p = new Pending(System.nanoTime() + timeoutNanos);
+        pending.put(handle, p);
+        if (closed) {
+            // Lost the race with close(), nothing would ever answer it
+            pending.remove(handle);
+            if (buffer >= 0) {
+                channel.free(buffer);
+            }
+            return null;
+        }
+        if (!channel.pushRequest(handle, op, args, buffer, length, offset, txId, mode)) {
+            pending.remove(handle);
+            if (buffer >= 0) {
+                channel.free(buffer);
+            }
+            return null;
+        }
+        if (pollerIdle) {
+            LockSupport.unpark(poller);
+        }
+        return p.future;
+    }
+
+    /**
+     * Polls the response ring while requests are pending, backing off the
+     * longer none come back.  With nothing pending there is nothing to poll
+     * for: the thread sleeps until send() wakes it or the next check is due.
+     */
+    private void poll() {
+        int idle = 0;
+        long parkNanos = PARK_NANOS;
+        long nextCheck = System.nanoTime() + CHECK_INTERVAL_NANOS;
+        while (!closed) {
+            ShmResponse resp = channel.pollResponse();
+            if (resp != null) {
+                idle = 0;
+                parkNanos = PARK_NANOS;
+                complete(resp);
+            } else if (pending.isEmpty()) {
+                // Set before the recheck: a request sent after it unparks us,
+                // one sent before it is seen here
+                pollerIdle = true;
+                if (pending.isEmpty()) {
+                    LockSupport.parkNanos(Math.max(0, nextCheck - System.nanoTime()));
+                }
+                pollerIdle = false;
+                idle = 0;
+                parkNanos = PARK_NANOS;
+            } else if (++idle > SPIN_POLLS) {
+                LockSupport.parkNanos(parkNanos);
+                parkNanos = Math.min(parkNanos * 2, MAX_PARK_NANOS);
+            }
+
+            long now = System.nanoTime();
+            if (now - nextCheck >= 0) {
+                nextCheck = now + CHECK_INTERVAL_NANOS;
+                expire(now);
+                if (!channel.isCurrent()) {
+                    LOG.warn("AM shared memory segment went away, back to Thrift");
+                    close(new ApiException("AM restarted", ErrorCode.SERVICE_NOT_READY));
+                }
+            }
+        }
+    }
+
+    private void complete(ShmResponse resp) {
+        if (resp.buffer >= 0) {
+            resp.data = channel.copyOut(resp.buffer, resp.length);
+            channel.free(resp.buffer);
+        }
+        Pending p = pending.remove(resp.handle);
+        if (p == null) {
+            LOG.warn("Shared memory response for handle " + resp.handle + " had no pending request");
+            return;
+        }
+        executor.execute(() -> p.future.complete(resp));
+    }
+
+    private void expire(long now) {
+        Iterator<Map.Entry<Long, Pending>> it = pending.entrySet().iterator();
+        while (it.hasNext()) {
+            Pending p = it.next().getValue();
+            if (now - p.deadline > 0) {
+                it.remove();
+                executor.execute(() -> p.future.completeExceptionally(
+                        new ApiException("Request timed out", ErrorCode.TIMEOUT)));
+            }
+        }
+    }
+
+    /**
+     * Stops using the channel, requests still waiting for a response fail with reason
+     */
+    public void close(ApiException reason) {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        LockSupport.unpark(poller);
+        channel.close();
+        for (Long handle : pending.keySet()) {
+            Pending p = pending.remove(handle);
+            if (p != null) {
+                executor.execute(() -> p.future.completeExceptionally(reason));
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+package com.formationds.xdi.shm;
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+import java.nio.ByteBuffer;
+
+/**
+ * A ShmResponseDesc popped off the response ring
+ */
+public class ShmResponse {
+    public final long handle;
+    public final int op;
+    /* Transport level outcome, ShmChannel.STATUS_* */
+    public final int status;
+    /* ErrorCode of the operation */
+    public final int error;
+    public final int buffer;
+    public final int length;
+    public final long txId;
+    public final long blobSize;
+    /* Payload of a read, copied out of the slab buffer */
+    public ByteBuffer data;
+
+    public ShmResponse(long handle, int op, int status, int error, int buffer, int length, long txId, long blobSize) {
+        this.handle = handle;
+        this.op = op;
+        this.status = status;
+        this.error = error;
+        this.buffer = buffer;
+        this.length = length;
+        this.txId = txId;
+        this.blobSize = blobSize;
+    }
+}
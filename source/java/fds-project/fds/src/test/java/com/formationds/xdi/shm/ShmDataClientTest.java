@@ -0,0 +1,133 @@
+package com.formationds.xdi.shm;
+
+import com.formationds.protocol.ApiException;
+import org.joda.time.Duration;
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Test;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.Paths;
+import java.util.HashMap;
+import java.util.Map;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.TimeUnit;
+
+import static org.junit.Assert.*;
+
+public class ShmDataClientTest {
+    private static final int BUFFER_SIZE = 4096;
+    private int port;
+    private Path path;
+    /* Stands in for the AM */
+    private ShmChannel server;
+
+    @Before
+    public void setUp() throws Exception {
+        port = 40000 + (int) Math.floorMod(System.nanoTime(), 10000L);
+        path = Paths.get("/dev/shm", "fds-xdi-" + port);
+        ShmChannel.format(path, 16, 4, BUFFER_SIZE);
+        server = ShmChannel.openForTest(path);
+    }
+
+    @After
+    public void tearDown() throws Exception {
+        Files.deleteIfExists(path);
+    }
+
+    private long[] nextRequest() throws InterruptedException {
+        for (int i = 0; i < 1000; i++) {
+            long[] req = server.pollRequestForTest();
+            if (req != null) {
+                return req;
+            }
+            Thread.sleep(1);
+        }
+        fail("No request showed up");
+        return null;
+    }
+
+    @Test
+    public void testArgs() {
+        Map<String, String> meta = new HashMap<>();
+        meta.put("k", "v");
+        byte[] packed = new ShmChannel.ArgWriter().put("ab").put(meta).finish();
+        assertArrayEquals(new byte[] {2, 0, 'a', 'b', 1, 0, 1, 0, 'k', 1, 0, 'v'}, packed);
+
+        char[] longName = new char[ShmChannel.ARGS_SIZE];
+        assertNull(new ShmChannel.ArgWriter().put(new String(longName)).finish());
+    }
+
+    @Test
+    public void testRoundTrip() throws Exception {
+        ShmDataClient client = ShmDataClient.attach(port, Duration.standardSeconds(10));
+        assertNotNull(client);
+        /* Only one client per segment */
+        assertNull(ShmDataClient.attach(port, Duration.standardSeconds(10)));
+
+        /* The payload of a write travels in a slab buffer */
+        byte[] payload = "hello world".getBytes(StandardCharsets.UTF_8);
+        CompletableFuture<ShmResponse> write = client.updateBlob("d", "v", "b", 7, ByteBuffer.wrap(payload), payload.length, 0);
+        long[] req = nextRequest();
+        assertEquals(ShmDataClient.UPDATE_BLOB, req[1]);
+        assertEquals(payload.length, req[3]);
+        assertEquals(ByteBuffer.wrap(payload), server.copyOut((int) req[2], (int) req[3]));
+        server.free((int) req[2]);
+        assertTrue(server.pushResponseForTest(new ShmResponse(req[0], (int) req[1], ShmChannel.STATUS_OK, 0, -1, 0, 0, 0)));
+        assertEquals(ShmChannel.STATUS_OK, write.get(5, TimeUnit.SECONDS).status);
+
+        /* The payload of a read comes back in a slab buffer that the client frees */
+        CompletableFuture<ShmResponse> read = client.getBlob("d", "v", "b", payload.length, 0);
+        req = nextRequest();
+        int buffer = server.allocate();
+        server.copyIn(buffer, ByteBuffer.wrap(payload));
+        server.pushResponseForTest(new ShmResponse(req[0], (int) req[1], ShmChannel.STATUS_OK, 0, buffer, payload.length, 0, 0));
+        assertEquals(ByteBuffer.wrap(payload), read.get(5, TimeUnit.SECONDS).data);
+        for (int i = 0; i < 4; i++) {
+            assertTrue(server.allocate() >= 0);
+        }
+        assertEquals(-1, server.allocate());
+
+        /* No free buffer, the caller goes to Thrift */
+        assertNull(client.updateBlob("d", "v", "b", 7, ByteBuffer.wrap(payload), payload.length, 0));
+        /* Too big for a buffer */
+        assertNull(client.getBlob("d", "v", "b", BUFFER_SIZE + 1, 0));
+
+        /* Transport status is handed back, RealAsyncAm decides to resend */
+        CompletableFuture<ShmResponse> start = client.startBlobTx("d", "v", "b", 0);
+        req = nextRequest();
+        server.pushResponseForTest(new ShmResponse(req[0], (int) req[1], ShmChannel.STATUS_UNSUPPORTED, 0, -1, 0, 0, 0));
+        assertEquals(ShmChannel.STATUS_UNSUPPORTED, start.get(5, TimeUnit.SECONDS).status);
+        client.close(new ApiException());
+    }
+
+    @Test
+    public void testTimeoutAndRestart() throws Exception {
+        ShmDataClient client = ShmDataClient.attach(port, Duration.millis(1));
+        CompletableFuture<ShmResponse> commit = client.commitBlobTx("d", "v", "b", 1);
+        try {
+            commit.get(5, TimeUnit.SECONDS);
+            fail("Should have timed out");
+        } catch (ExecutionException e) {
+            assertEquals(ApiException.class, e.getCause().getClass());
+        }
+
+        /* The AM went away, pending requests fail and the client closes */
+        CompletableFuture<ShmResponse> abort = client.abortBlobTx("d", "v", "b", 1);
+        Files.delete(path);
+        try {
+            abort.get(5, TimeUnit.SECONDS);
+            fail("Should have failed");
+        } catch (ExecutionException e) {
+            assertEquals(ApiException.class, e.getCause().getClass());
+        }
+        for (int i = 0; i < 100 && client.isOpen(); i++) {
+            Thread.sleep(10);
+        }
+        assertFalse(client.isOpen());
+    }
+}
@@ -9,10 +9,13 @@
 #include <string>
 #include <cstdint>
 #include <cstdio>
+#include <mutex>
+#include <vector>
 
 // Internal includes.
 #include "catalogKeys/CatalogKey.h"
 #include "catalogKeys/CatalogKeyComparator.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
@@ -34,6 +37,126 @@ struct CopyDetails {
     const std::string destPath;
 };
 
+/**
+ * Resources shared by the catalogs of a process, e.g. the catalogs of all
+ * volumes of a DM. Instead of a block cache and a full size write buffer
+ * each, catalogs use one block cache and split a write buffer budget.
+ *
+ * The budget is soft: a catalog gets at most its configured write buffer
+ * size and at least MIN_WRITE_BUFFER_SIZE, however many are open, so N
+ * catalogs may use up to N * MIN_WRITE_BUFFER_SIZE past the budget. A
+ * SharedCatalogStore has a single write buffer instead.
+ */
+class CatalogResources {
+  public:
+    static const fds_uint32_t MIN_WRITE_BUFFER_SIZE;
+
+    CatalogResources(fds_uint64_t cacheSize,
+                     fds_uint64_t writeBufferBudget,
+                     fds_uint32_t maxOpenFiles);
+
+    inline leveldb::Cache* blockCache() {
+        return cache.get();
+    }
+
+    inline fds_uint32_t maxOpenFiles() const {
+        return max_open_files;
+    }
+
+    /**
+     * Write buffer size for a catalog being opened, a share of what is left
+     * of the budget
+     */
+    fds_uint32_t acquireWriteBuffer(fds_uint32_t maxSize);
+
+    /**
+     * A catalog using a write buffer of the size is closed
+     */
+    void releaseWriteBuffer(fds_uint32_t size);
+
+    fds_uint64_t getWriteBufferUsed() const;
+
+  private:
+    std::unique_ptr<leveldb::Cache> cache;
+    fds_uint64_t write_buffer_budget;
+    fds_uint32_t max_open_files;
+
+    mutable std::mutex lock;
+    fds_uint64_t write_buffer_used {0};
+};
+
+/**
+ * One leveldb holding the catalogs of many volumes, e.g. all those of a DM,
+ * for a single block cache, write buffer, set of open files and compaction
+ * stream instead of one per volume. A volume's keys are prefixed with its
+ * id, big endian so they are contiguous, and a Catalog opened on the store
+ * sees only its own. Copying or deleting a volume's catalog is a range
+ * operation.
+ *
+ * Volumes in the store have no leveldb of their own: there are no per
+ * volume journals for the timeline, and tools opening a volume's catalog
+ * directory (e.g. DmChecker) find it empty.
+ */
+class SharedCatalogStore {
+  public:
+    static const fds_uint32_t PREFIX_SIZE = sizeof(fds_uint64_t);
+
+    SharedCatalogStore(const std::string& file,
+                       CatalogResources& resources,
+                       fds_uint32_t writeBufferSize);
+    ~SharedCatalogStore();
+
+    /** Prefix of the keys of volume */
+    static std::string prefix(fds_uint64_t volume);
+
+    inline leveldb::DB* GetDB() {
+        return db.get();
+    }
+
+    inline const leveldb::Options & GetOptions() const {
+        return options;
+    }
+
+    /** Comparator of the keys without their prefix */
+    inline const leveldb::Comparator* catalogComparator() const {
+        return &catalog_cmp;
+    }
+
+    /**
+     * Copies the catalog of volume from, as it is now, to volume to
+     */
+    fds::Error copyRange(fds_uint64_t from, fds_uint64_t to);
+
+    /**
+     * Copies the catalog of volume to a leveldb of its own at file
+     */
+    fds::Error exportRange(fds_uint64_t volume, const std::string& file);
+
+    /**
+     * Deletes the catalog of volume
+     */
+    fds::Error deleteRange(fds_uint64_t volume);
+
+    /**
+     * Volumes that have keys in the store, in order
+     */
+    fds::Error volumes(std::vector<fds_uint64_t>& volumesOut);
+
+  private:
+    class PrefixComparator;
+
+    /** Calls fn with every key and value of volume, as it is now */
+    template <typename Fn>
+    fds::Error forEachInRange(fds_uint64_t volume, Fn fn);
+
+    CatalogKeyComparator catalog_cmp;
+    std::unique_ptr<PrefixComparator> cmp;
+    std::unique_ptr<leveldb::FilterPolicy const> filter_policy;
+    leveldb::Options options;
+    leveldb::WriteOptions write_options;
+    std::unique_ptr<leveldb::DB> db;
+};
+
 /**
  * Just use leveldb's slice. We should consider our
  * own class in the future.
@@ -74,6 +197,34 @@ class Catalog {
 
     std::unique_ptr<leveldb::FilterPolicy const> filter_policy;
 
+    /*
+     * Block cache of this catalog, unless it uses the shared resources
+     */
+    std::unique_ptr<leveldb::Cache> cache;
+    CatalogResources* resources;
+
+    /*
+     * Set if this catalog is a volume's range of a shared store, db is
+     * then null and ldb the store's
+     */
+    SharedCatalogStore* shared;
+    fds_uint64_t volume;
+    std::string prefix;
+    leveldb::DB* ldb;
+
+    /** key as stored: with the volume prefix if shared, buf holds it */
+    inline leveldb::Slice storeKey(const leveldb::Slice& key, std::string& buf) const {
+        if (!shared) {
+            return key;
+        }
+        buf = prefix;
+        buf.append(key.data(), key.size());
+        return buf;
+    }
+
+    /** batch as stored: with the volume prefix on keys if shared, buf holds it */
+    CatWriteBatch* storeBatch(CatWriteBatch* batch, CatWriteBatch& buf) const;
+
     static const std::string empty;
 
   public:
@@ -84,7 +235,11 @@ class Catalog {
     Catalog(const std::string& _file, fds_uint32_t writeBufferSize = WRITE_BUFFER_SIZE,
             fds_uint32_t cacheSize = CACHE_SIZE, const std::string& logDirName = empty,
             const std::string& logFilePrefix = empty, fds_uint32_t maxLogFiles = 0,
-            fds_bool_t archiveLogs = false,leveldb::Comparator * cmp = 0);
+            fds_bool_t archiveLogs = false,leveldb::Comparator * cmp = 0,
+            CatalogResources* sharedResources = nullptr);
+
+    /** The catalog of volume in store, named _file */
+    Catalog(const std::string& _file, SharedCatalogStore& store, fds_uint64_t volume);
 
     ~Catalog();
 
@@ -98,13 +253,7 @@ class Catalog {
      * @param[in] m the snapshot to use, NULL for latest data
      * @return Pointer to catalog iterator
      */
-    std::unique_ptr<catalog_iterator_t> NewIterator(MemSnap m = NULL) {
-        leveldb::ReadOptions ro{read_options};
-
-        ro.snapshot = m;
-
-        return std::unique_ptr<catalog_iterator_t>(db->NewIterator(ro));
-    }
+    std::unique_ptr<catalog_iterator_t> NewIterator(MemSnap m = NULL);
 
     inline const leveldb::Options & GetOptions() const {
         return options;
@@ -116,6 +265,10 @@ class Catalog {
 
     fds::Error Update(const CatalogKey& key, const leveldb::Slice& val);
     fds::Error Update(CatWriteBatch* batch);
+    /**
+     * Writes the batch synced or not, whatever the catalog's write options
+     */
+    fds::Error Update(CatWriteBatch* batch, fds_bool_t sync);
     fds::Error Query(const CatalogKey& key, std::string* val, MemSnap m = NULL);
     fds::Error Delete(const CatalogKey& key);
 
@@ -128,19 +281,36 @@ class Catalog {
      * pointers are zeroed by ReleaseSnapshot
      */
     void GetSnapshot(MemSnap &m) {
-        m = db->GetSnapshot();
+        m = ldb->GetSnapshot();
     }
 
     /*
      * after this call, m must not be used
      */
     void ReleaseSnapshot(MemSnap &m) {
-        db->ReleaseSnapshot(m);
+        ldb->ReleaseSnapshot(m);
         m = NULL;
     }
 
+    /**
+     * Copies the catalog to a leveldb of its own at fileName
+     */
     fds::Error DbSnap(const std::string& fileName);
 
+    inline fds_bool_t IsShared() const {
+        return shared != nullptr;
+    }
+
+    /**
+     * Copies a catalog of a shared store to the range of destVolume
+     */
+    fds::Error CopyTo(fds_uint64_t destVolume);
+
+    /**
+     * Deletes the range of a catalog of a shared store
+     */
+    fds::Error DeleteAll();
+
     inline void clearLogRotate() {
         fds_assert(env);
         env->logRotate() = false;
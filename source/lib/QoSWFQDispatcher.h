@@ -1,6 +1,7 @@
 #include "fds_qos.h"
 #include <map>
 #include <atomic>
+#include <functional>
 
 #include "EclipseWorkarounds.h"
 
@@ -24,6 +25,10 @@ namespace fds {
     fds_uint32_t num_priority_based_ios_dispatched; // number of ios dispatched in the current round of priority based WFQ;
     fds_uint32_t num_rate_based_credits;
     fds_uint32_t max_rate_based_credits;
+    // Dispatch slots owed for IOs that cost more than one token; pending_charge
+    // is added by IO completion and folded into debt by the dispatcher thread
+    fds_uint64_t debt;
+    alignas(64) std::atomic<unsigned int> pending_charge;
 
     FDS_VolumeQueue *queue;
     alignas(64) std::atomic<unsigned int> num_pending_ios;
@@ -42,6 +47,8 @@ namespace fds {
       num_outstanding_ios = ATOMIC_VAR_INIT(0);
       num_rate_based_credits = 0;
       max_rate_based_credits = 0;
+      debt = 0;
+      pending_charge = ATOMIC_VAR_INIT(0);
     }
 
     /**
@@ -73,6 +80,8 @@ namespace fds {
     fds_uint64_t num_ios_dispatched;
     fds_uint64_t num_rate_based_slots_serviced;
     fds_uint64_t last_reset_time;
+    /* Microseconds, rate based slots are paced by it */
+    std::function<fds_uint64_t()> clock;
 
     fds_uint32_t priority_to_wfq_weight(fds_uint32_t priority) {
       assert((priority >= 0) && (priority <= 10));
@@ -102,8 +111,12 @@ namespace fds {
 
     fds_qid_t get_non_empty_queue_with_highest_credits();
     void ioProcessForEnqueue(fds_qid_t queue_id, FDS_IOType *io);
+    void ioProcessForEnqueueBatch(fds_qid_t queue_id, FDS_IOType* const *ios, size_t n_ios);
     void ioProcessForDispatch(fds_qid_t queue_id, FDS_IOType *io);
     fds_qid_t getNextQueueForDispatch();
+    fds_qid_t pickNextQueue();
+    void chargeQueue(fds_qid_t queue_id, fds_uint32_t tokens);
+    fds_uint32_t maxRateBasedCredits(fds_uint64_t queue_rate) const;
     void inc_num_ios_dispatched(unsigned int io_dispatch_type);
     Error assignSpotsToQueue(WFQQueueDesc *qd);
     Error revokeSpotsFromQueue(WFQQueueDesc *qd);
@@ -115,6 +128,11 @@ namespace fds {
              bool bypass_dispatcher,
              fds_log *parent_log);
     ~QoSWFQDispatcher() {}
+    /**
+     * Replaces the wall clock rate based slots are paced by, for simulations.
+     * Has to be set before any IO is dispatched.
+     */
+    void setClock(const std::function<fds_uint64_t()>& microsClock);
     Error registerQueue(fds_qid_t queue_id, FDS_VolumeQueue *queue);
     Error deregisterQueue(fds_qid_t queue_id);
 
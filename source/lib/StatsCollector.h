@@ -5,6 +5,10 @@
 #ifndef SOURCE_INCLUDE_STATSCOLLECTOR_H_
 #define SOURCE_INCLUDE_STATSCOLLECTOR_H_
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <PerfHistory.h>
 #include <fds_timer.h>
 
@@ -13,6 +17,7 @@
 namespace fds {
 
 struct SvcMgr;
+struct ThreadVolStats;
 
 /**
  * A callback to a service (DM/SM/AM) that will be called periodically
@@ -84,6 +89,10 @@ class StatsCollector : public boost::noncopyable {
 
     /**
      * Record one event for volume 'volume_id'
+     *
+     * Events are added to this thread's own counters for the volume and
+     * merged into the volume's history by the merge timer (and before the
+     * history is printed or streamed), so recording doesn't lock.
      * @param[in] volume_id volume ID
      * @param[in] timestamp timestamp in nanoseconds
      * @param[in] event_type type of the event
@@ -105,9 +114,24 @@ class StatsCollector : public boost::noncopyable {
      */
     void sampleStats();
 
+    /**
+     * Merges events threads recorded since the last merge into the
+     * volume histories. Called on timer every qos slot.
+     */
+    void mergeThreadStats();
+
   private:  // methods
     VolumePerfHistory::ptr getQosHistory(fds_volid_t volid);
     VolumePerfHistory::ptr getStatHistory(fds_volid_t volid);
+    /**
+     * Records into the volume histories directly, under their locks
+     */
+    void recordEventLocked(fds_volid_t volume_id,
+                           fds_uint64_t timestamp,
+                           FdsVolStatType event_type,
+                           const GenericCounter& counter);
+    ThreadVolStats* getThreadStats();
+    void startMergeTimer();
     void openQosFile(const std::string& name);
 
   private:
@@ -171,6 +195,24 @@ class StatsCollector : public boost::noncopyable {
     FdsTimerPtr qosTimer;
     FdsTimerTaskPtr qosTimerTask;
 
+    /**
+     * Per thread counters recordEvent() fills in, merged into the
+     * histories by mergeTimer
+     */
+    fds_uint64_t collector_id_;  // tells this collector's thread stats apart
+    std::vector<std::shared_ptr<ThreadVolStats>> thread_stats_;
+    std::mutex thread_stats_lock_;  // protects thread_stats_
+    std::mutex merge_lock_;  // one merge at a time
+    std::once_flag merge_started_;
+    FdsTimerPtr mergeTimer;
+    FdsTimerTaskPtr mergeTimerTask;
+    /**
+     * Which events go to qos and stat histories, and which are disabled,
+     * by FdsVolStatType
+     */
+    bool qos_stat_type_[STAT_MAX_TYPE];
+    bool stream_stat_type_[STAT_MAX_TYPE];
+
     /* Reference to service manager mostly for dmt */
      SvcMgr *svcMgr_;
 };
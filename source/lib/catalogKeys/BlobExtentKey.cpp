@@ -0,0 +1,112 @@
+///
+/// @copyright 2016 Formation Data Systems, Inc.
+///
+
+// Standard includes.
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Internal includes.
+#include "leveldb/db.h"
+#include "CatalogKeyType.h"
+
+// Class include.
+#include "BlobExtentKey.h"
+
+using std::invalid_argument;
+using std::move;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace fds {
+
+BlobExtentKey::BlobExtentKey (leveldb::Slice const& leveldbKey)
+        : CatalogKey{string(leveldbKey.data(), leveldbKey.size())}
+{
+    auto const dataLength = leveldbKey.size();
+    if (dataLength < getNewDataSize())
+    {
+        throw invalid_argument{"Key of " + to_string(dataLength) + " bytes is not large enough to "
+                               "be a BlobExtentKey."};
+    }
+}
+
+BlobExtentKey::BlobExtentKey (string const& blobName)
+        : BlobExtentKey{blobName, 0}
+{ }
+
+BlobExtentKey::BlobExtentKey (string const& blobName, fds_uint32_t pageIndex)
+        : CatalogKey{CatalogKeyType::BLOB_EXTENTS,
+                     string(CatalogKey::getNewDataSize(), '\0')
+                     + string{reinterpret_cast<char*>(&pageIndex), sizeof(pageIndex)}
+                     + blobName}
+{ }
+
+BlobExtentKey& BlobExtentKey::operator= (BlobExtentKey const& other)
+{
+    if (&other != this)
+    {
+        getData() = other.getData();
+    }
+
+    return *this;
+}
+
+BlobExtentKey& BlobExtentKey::operator= (BlobExtentKey&& other)
+{
+    if (&other != this)
+    {
+        getData() = move(other.getData());
+    }
+
+    return *this;
+}
+
+string BlobExtentKey::getBlobName () const
+{
+    auto& data = getData();
+    return string{data.data() + getNewDataSize(), data.size() - getNewDataSize()};
+}
+
+fds_uint32_t BlobExtentKey::getPageIndex () const
+{
+    return *reinterpret_cast<fds_uint32_t const*>(getData().data() + CatalogKey::getNewDataSize());
+}
+
+void BlobExtentKey::setBlobName (string const& value)
+{
+    auto& data = getData();
+    data = data.substr(0, getNewDataSize()) + value;
+}
+
+void BlobExtentKey::setPageIndex (fds_uint32_t value)
+{
+    getData().replace(CatalogKey::getNewDataSize(),
+                      sizeof(value),
+                      reinterpret_cast<char const*>(&value),
+                      sizeof(value));
+}
+
+string BlobExtentKey::getClassName () const
+{
+    return "BlobExtentKey";
+}
+
+vector<string> BlobExtentKey::toStringMembers () const
+{
+    auto retval = CatalogKey::toStringMembers();
+
+    retval.push_back("blobName: " + getBlobName());
+    retval.push_back("pageIndex: " + to_string(getPageIndex()));
+
+    return retval;
+}
+
+constexpr size_t BlobExtentKey::getNewDataSize ()
+{
+    return CatalogKey::getNewDataSize() + sizeof(fds_uint32_t);
+}
+
+}  // namespace fds
@@ -68,6 +68,7 @@ vector<string> CatalogKey::toStringMembers () const
 #pragma GCC diagnostic error "-Wswitch-enum"
     switch (getKeyType())
     {
+    case CatalogKeyType::BLOB_EXTENTS: retval += "BLOB_EXTENTS"; break;
     case CatalogKeyType::BLOB_METADATA: retval += "BLOB_METADATA"; break;
     case CatalogKeyType::BLOB_OBJECTS: retval += "BLOB_OBJECTS"; break;
     case CatalogKeyType::EXTENDED: retval += "EXTENDED"; break;
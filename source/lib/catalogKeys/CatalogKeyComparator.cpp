@@ -9,6 +9,7 @@
 
 // Internal includes.
 #include "leveldb/db.h"
+#include "BlobExtentKey.h"
 #include "BlobMetadataKey.h"
 #include "BlobObjectKey.h"
 #include "CatalogKeyType.h"
@@ -72,6 +73,23 @@ int CatalogKeyComparator::Compare (Slice const& lhs, Slice const& rhs) const
             }
         }
 
+        case CatalogKeyType::BLOB_EXTENTS:
+        {
+            BlobExtentKey typedLhs { lhs };
+            BlobExtentKey typedRhs { rhs };
+
+            int blobNameResult = _compareWithOperators(typedLhs.getBlobName(),
+                                                       typedRhs.getBlobName());
+            if (blobNameResult == 0)
+            {
+                return _compareWithOperators(typedLhs.getPageIndex(), typedRhs.getPageIndex());
+            }
+            else
+            {
+                return blobNameResult;
+            }
+        }
+
         case CatalogKeyType::EXTENDED:
             throw domain_error("EXTENDED key type is unsupported.");
 
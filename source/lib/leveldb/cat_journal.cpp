@@ -18,6 +18,7 @@
 #include "leveldb/cat_journal.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/journal_archive.h"
 #include "leveldb/options.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
@@ -69,7 +70,8 @@ fds_uint64_t getWriteBatchTimestamp(const leveldb::WriteBatch & batch) {
     return handler.getJournalTimeStamp();
 }
 
-CatJournalIterator::CatJournalIterator(const std::string & file) : file_(file),
+CatJournalIterator::CatJournalIterator(const std::string & file,
+                                       fds_uint64_t initialOffset) : file_(file),
         valid_(false), env_(leveldb::Env::Default()), sfile_(0) {
     fds_verify(!file_.empty());
     if (!env_->FileExists(file_)) {
@@ -95,9 +97,16 @@ CatJournalIterator::CatJournalIterator(const std::string & file) : file_(file),
         }
     }
 
-    Status s = env_->NewSequentialFile(file_, &sfile_);
+    Status s;
+    if (file_.size() > JOURNAL_ARCHIVE_SUFFIX.size() &&
+        0 == file_.compare(file_.size() - JOURNAL_ARCHIVE_SUFFIX.size(),
+                           JOURNAL_ARCHIVE_SUFFIX.size(), JOURNAL_ARCHIVE_SUFFIX)) {
+        s = newJournalArchiveFile(file_, &sfile_);
+    } else {
+        s = env_->NewSequentialFile(file_, &sfile_);
+    }
     if (!s.ok()) {
-        LOGERROR << "Failed to open file '" << file_ << "'";
+        LOGERROR << "Failed to open file '" << file_ << "': " << s.ToString();
         return;
     }
 
@@ -105,7 +114,7 @@ CatJournalIterator::CatJournalIterator(const std::string & file) : file_(file),
         unlink(file_.c_str());
     }
 
-    reader_.reset(new log::Reader(sfile_, &reporter_, true, 0));
+    reader_.reset(new log::Reader(sfile_, &reporter_, true, initialOffset));
     batch_.Clear();
     valid_ = true;
 
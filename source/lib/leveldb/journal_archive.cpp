@@ -0,0 +1,287 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+// Standard includes.
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Internal includes.
+#include "db/dbformat.h"
+#include "db/log_reader.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/cat_journal.h"
+#include "leveldb/journal_archive.h"
+#include "util/Log.h"
+
+namespace leveldb {
+
+namespace {
+
+const char ARCHIVE_MAGIC[] = "FDSJRNL1";
+const size_t MAGIC_LEN = sizeof(ARCHIVE_MAGIC) - 1;
+const size_t FRAME_HEADER_LEN = 2 * sizeof(fds_uint32_t);
+const size_t FOOTER_LEN = 2 * sizeof(fds_uint32_t) + MAGIC_LEN;
+
+template <typename T>
+void appendFixed(std::string & buf, T value) {
+    buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T decodeFixed(const char * data) {
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/**
+ * Time of the first write batch starting in every frame of the journal
+ */
+Status buildIndex(const std::string & journalFile, std::vector<JournalIndexEntry> * index) {
+    SequentialFile * file;
+    Status s = Env::Default()->NewSequentialFile(journalFile, &file);
+    if (!s.ok()) {
+        return s;
+    }
+    std::unique_ptr<SequentialFile> fileGuard(file);
+    CorruptionReporter reporter;
+    log::Reader reader(file, &reporter, true, 0);
+
+    Slice record;
+    std::string scratch;
+    WriteBatch batch;
+    while (reader.ReadRecord(&record, &scratch)) {
+        fds_uint64_t offset = reader.LastRecordOffset();
+        if (!index->empty() &&
+            offset / ARCHIVE_FRAME_SIZE == index->back().offset / ARCHIVE_FRAME_SIZE) {
+            continue;
+        }
+        if (record.size() < 12) {
+            break;
+        }
+        WriteBatchInternal::SetContents(&batch, record);
+        fds_uint64_t ts = getWriteBatchTimestamp(batch);
+        if (ts) {
+            index->push_back({ts, offset});
+        }
+    }
+    return s;
+}
+
+/**
+ * Journal in an archive, decompressed a frame at a time
+ */
+class JournalArchiveFile : public SequentialFile {
+  public:
+    explicit JournalArchiveFile(const std::string & fname)
+            : fname_(fname), fd_(-1), frameSize_(0), frame_(-1), pos_(0) {}
+
+    ~JournalArchiveFile() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    Status open() {
+        fd_ = ::open(fname_.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) < 0) {
+            return Status::IOError(fname_, strerror(errno));
+        }
+        char footer[FOOTER_LEN];
+        if (static_cast<size_t>(st.st_size) < MAGIC_LEN + FOOTER_LEN ||
+            FOOTER_LEN != pread(fd_, footer, FOOTER_LEN, st.st_size - FOOTER_LEN) ||
+            0 != memcmp(footer + 2 * sizeof(fds_uint32_t), ARCHIVE_MAGIC, MAGIC_LEN)) {
+            return Status::Corruption(fname_, "not a journal archive");
+        }
+        fds_uint32_t frames = decodeFixed<fds_uint32_t>(footer);
+        frameSize_ = decodeFixed<fds_uint32_t>(footer + sizeof(fds_uint32_t));
+
+        size_t tableLen = frames * sizeof(fds_uint64_t);
+        if (0 == frameSize_ ||
+            static_cast<size_t>(st.st_size) < MAGIC_LEN + tableLen + FOOTER_LEN) {
+            return Status::Corruption(fname_, "bad frame table");
+        }
+        std::string table(tableLen, '\0');
+        off_t tableStart = st.st_size - FOOTER_LEN - tableLen;
+        if (static_cast<ssize_t>(tableLen) != pread(fd_, &table[0], tableLen, tableStart)) {
+            return Status::IOError(fname_, strerror(errno));
+        }
+        for (fds_uint32_t i = 0; i < frames; ++i) {
+            frameOffsets_.push_back(decodeFixed<fds_uint64_t>(table.data() + i * sizeof(fds_uint64_t)));
+        }
+        // End of the last frame
+        frameOffsets_.push_back(tableStart);
+        return Status::OK();
+    }
+
+    Status Read(size_t n, Slice * result, char * scratch) override {
+        size_t read = 0;
+        while (read < n) {
+            size_t frame = pos_ / frameSize_;
+            if (frame + 1 >= frameOffsets_.size()) {
+                break;
+            }
+            Status s = loadFrame(frame);
+            if (!s.ok()) {
+                return s;
+            }
+            size_t inFrame = pos_ % frameSize_;
+            if (inFrame >= raw_.size()) {
+                break;
+            }
+            size_t len = std::min(n - read, raw_.size() - inFrame);
+            memcpy(scratch + read, raw_.data() + inFrame, len);
+            read += len;
+            pos_ += len;
+        }
+        *result = Slice(scratch, read);
+        return Status::OK();
+    }
+
+    Status Skip(uint64_t n) override {
+        pos_ += n;
+        return Status::OK();
+    }
+
+  private:
+    Status loadFrame(size_t frame) {
+        if (static_cast<ssize_t>(frame) == frame_) {
+            return Status::OK();
+        }
+        fds_uint64_t start = frameOffsets_[frame];
+        fds_uint64_t end = frameOffsets_[frame + 1];
+        if (end < start + FRAME_HEADER_LEN) {
+            return Status::Corruption(fname_, "bad frame");
+        }
+        std::string data(end - start, '\0');
+        if (static_cast<ssize_t>(data.size()) != pread(fd_, &data[0], data.size(), start)) {
+            return Status::IOError(fname_, strerror(errno));
+        }
+        fds_uint32_t rawLen = decodeFixed<fds_uint32_t>(data.data());
+        fds_uint32_t compressedLen = decodeFixed<fds_uint32_t>(data.data() + sizeof(fds_uint32_t));
+        if (rawLen > frameSize_ || FRAME_HEADER_LEN + compressedLen != data.size()) {
+            return Status::Corruption(fname_, "bad frame");
+        }
+        raw_.resize(rawLen);
+        uLongf len = rawLen;
+        if (Z_OK != uncompress(reinterpret_cast<Bytef *>(&raw_[0]), &len,
+                               reinterpret_cast<const Bytef *>(data.data() + FRAME_HEADER_LEN),
+                               compressedLen) ||
+            len != rawLen) {
+            frame_ = -1;
+            return Status::Corruption(fname_, "frame does not decompress");
+        }
+        frame_ = frame;
+        return Status::OK();
+    }
+
+    std::string fname_;
+    int fd_;
+    fds_uint32_t frameSize_;
+    std::vector<fds_uint64_t> frameOffsets_;
+    ssize_t frame_;
+    std::string raw_;
+    fds_uint64_t pos_;
+};
+
+}  // namespace
+
+Status archiveJournal(const std::string & journalFile,
+                      const std::string & archiveFile,
+                      std::vector<JournalIndexEntry> * index) {
+    index->clear();
+    Status s = buildIndex(journalFile, index);
+    if (!s.ok()) {
+        return s;
+    }
+
+    Env * env = Env::Default();
+    SequentialFile * src;
+    s = env->NewSequentialFile(journalFile, &src);
+    if (!s.ok()) {
+        return s;
+    }
+    std::unique_ptr<SequentialFile> srcGuard(src);
+
+    // Written under a temporary name, an archive is complete once it has its name
+    std::string tmpFile = archiveFile + ".tmp";
+    WritableFile * dest;
+    s = env->NewWritableFile(tmpFile, &dest);
+    if (!s.ok()) {
+        return s;
+    }
+    std::unique_ptr<WritableFile> destGuard(dest);
+
+    std::unique_ptr<char[]> raw(new char[ARCHIVE_FRAME_SIZE]);
+    std::string frame(FRAME_HEADER_LEN + compressBound(ARCHIVE_FRAME_SIZE), '\0');
+    std::vector<fds_uint64_t> frameOffsets;
+    fds_uint64_t offset = MAGIC_LEN;
+    s = dest->Append(Slice(ARCHIVE_MAGIC, MAGIC_LEN));
+
+    while (s.ok()) {
+        Slice data;
+        s = src->Read(ARCHIVE_FRAME_SIZE, &data, raw.get());
+        if (!s.ok() || data.empty()) {
+            break;
+        }
+        uLongf compressedLen = frame.size() - FRAME_HEADER_LEN;
+        if (Z_OK != compress2(reinterpret_cast<Bytef *>(&frame[FRAME_HEADER_LEN]), &compressedLen,
+                              reinterpret_cast<const Bytef *>(data.data()), data.size(),
+                              Z_BEST_SPEED)) {
+            s = Status::IOError(journalFile, "compression failed");
+            break;
+        }
+        fds_uint32_t rawLen = data.size();
+        fds_uint32_t frameLen = compressedLen;
+        memcpy(&frame[0], &rawLen, sizeof(rawLen));
+        memcpy(&frame[sizeof(rawLen)], &frameLen, sizeof(frameLen));
+
+        frameOffsets.push_back(offset);
+        s = dest->Append(Slice(frame.data(), FRAME_HEADER_LEN + compressedLen));
+        offset += FRAME_HEADER_LEN + compressedLen;
+    }
+
+    if (s.ok()) {
+        std::string footer;
+        for (auto frameOffset : frameOffsets) {
+            appendFixed<fds_uint64_t>(footer, frameOffset);
+        }
+        appendFixed<fds_uint32_t>(footer, frameOffsets.size());
+        appendFixed<fds_uint32_t>(footer, ARCHIVE_FRAME_SIZE);
+        footer.append(ARCHIVE_MAGIC, MAGIC_LEN);
+        s = dest->Append(footer);
+    }
+    if (s.ok()) {
+        s = dest->Sync();
+    }
+    if (s.ok()) {
+        s = dest->Close();
+    }
+    if (s.ok()) {
+        s = env->RenameFile(tmpFile, archiveFile);
+    }
+    if (!s.ok()) {
+        LOGERROR << "Failed to archive journal '" << journalFile << "': " << s.ToString();
+        env->DeleteFile(tmpFile);
+    }
+    return s;
+}
+
+Status newJournalArchiveFile(const std::string & archiveFile, SequentialFile ** result) {
+    std::unique_ptr<JournalArchiveFile> file(new JournalArchiveFile(archiveFile));
+    Status s = file->open();
+    *result = s.ok() ? file.release() : nullptr;
+    return s;
+}
+
+}  // namespace leveldb
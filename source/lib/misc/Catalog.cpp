@@ -2,6 +2,8 @@
  * Copyright 2013 Formation Data Systems, Inc.
  */
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <fstream>
 
@@ -38,6 +40,99 @@ int doCopyFile(void * arg, const char* fname, fds_uint64_t length) {
     return 0;
 }
 
+/** Iterates over the keys of one volume of a shared store, without their prefix */
+class PrefixIterator : public leveldb::Iterator {
+  public:
+    PrefixIterator(leveldb::Iterator* base, const std::string& prefix, fds_uint64_t volume)
+            : base(base), prefix(prefix), volume(volume) {
+    }
+
+    bool Valid() const override {
+        return base->Valid() && base->key().starts_with(prefix);
+    }
+
+    void SeekToFirst() override {
+        base->Seek(prefix);
+    }
+
+    void SeekToLast() override {
+        // Last key before the next volume's
+        if (volume == UINT64_MAX) {
+            base->SeekToLast();
+            return;
+        }
+        base->Seek(fds::SharedCatalogStore::prefix(volume + 1));
+        if (base->Valid()) {
+            base->Prev();
+        } else {
+            base->SeekToLast();
+        }
+    }
+
+    void Seek(const leveldb::Slice& target) override {
+        std::string key(prefix);
+        key.append(target.data(), target.size());
+        base->Seek(key);
+    }
+
+    void Next() override {
+        base->Next();
+    }
+
+    void Prev() override {
+        base->Prev();
+    }
+
+    leveldb::Slice key() const override {
+        leveldb::Slice k = base->key();
+        k.remove_prefix(prefix.size());
+        return k;
+    }
+
+    leveldb::Slice value() const override {
+        return base->value();
+    }
+
+    leveldb::Status status() const override {
+        return base->status();
+    }
+
+  private:
+    std::unique_ptr<leveldb::Iterator> base;
+    const std::string prefix;
+    const fds_uint64_t volume;
+};
+
+/** Copies a write batch, prefixing its keys */
+class PrefixBatch : public leveldb::WriteBatch::Handler {
+  public:
+    PrefixBatch(const std::string& prefix, leveldb::WriteBatch& out)
+            : prefix(prefix), out(out) {
+    }
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+        out.Put(prefixed(key), value);
+    }
+
+    void Delete(const leveldb::Slice& key) override {
+        out.Delete(prefixed(key));
+    }
+
+  private:
+    leveldb::Slice prefixed(const leveldb::Slice& key) {
+        buf = prefix;
+        buf.append(key.data(), key.size());
+        return buf;
+    }
+
+    const std::string& prefix;
+    leveldb::WriteBatch& out;
+    std::string buf;
+};
+
+/* Bytes of keys and values written per batch by range copies and deletes */
+const size_t RANGE_BATCH_BYTES = 1024 * 1024;
+
 }  // namespace
 
 namespace fds {
@@ -49,6 +144,245 @@ const fds_uint32_t Catalog::CACHE_SIZE = 8 * 1024 * 1024;
 
 const std::string Catalog::empty;
 
+const fds_uint32_t CatalogResources::MIN_WRITE_BUFFER_SIZE = 256 * 1024;
+
+CatalogResources::CatalogResources(fds_uint64_t cacheSize,
+                                   fds_uint64_t writeBufferBudget,
+                                   fds_uint32_t maxOpenFiles)
+        : cache(leveldb::NewLRUCache(cacheSize)),
+          write_buffer_budget(writeBufferBudget),
+          max_open_files(maxOpenFiles) {
+}
+
+fds_uint32_t
+CatalogResources::acquireWriteBuffer(fds_uint32_t maxSize) {
+    std::lock_guard<std::mutex> l(lock);
+    // A quarter of what is left: the first catalogs get their full size,
+    // the many that follow an ever smaller share
+    fds_uint64_t left = (write_buffer_used < write_buffer_budget) ?
+            write_buffer_budget - write_buffer_used : 0;
+    fds_uint32_t size = std::max<fds_uint64_t>(std::min<fds_uint64_t>(left / 4, maxSize),
+                                               std::min(MIN_WRITE_BUFFER_SIZE, maxSize));
+    write_buffer_used += size;
+    return size;
+}
+
+void
+CatalogResources::releaseWriteBuffer(fds_uint32_t size) {
+    std::lock_guard<std::mutex> l(lock);
+    fds_assert(write_buffer_used >= size);
+    write_buffer_used -= size;
+}
+
+fds_uint64_t
+CatalogResources::getWriteBufferUsed() const {
+    std::lock_guard<std::mutex> l(lock);
+    return write_buffer_used;
+}
+
+/**
+ * Orders keys of a shared store by volume, then by the catalog comparator
+ */
+class SharedCatalogStore::PrefixComparator : public leveldb::Comparator {
+  public:
+    explicit PrefixComparator(const leveldb::Comparator& catalogCmp)
+            : catalogCmp(catalogCmp) {
+    }
+
+    int Compare(const leveldb::Slice& lhs, const leveldb::Slice& rhs) const override {
+        int result = leveldb::Slice(lhs.data(), std::min<size_t>(lhs.size(), PREFIX_SIZE)).compare(
+            leveldb::Slice(rhs.data(), std::min<size_t>(rhs.size(), PREFIX_SIZE)));
+        if (result != 0) {
+            return result;
+        }
+        // A bare prefix is where a volume's range starts
+        if (lhs.size() <= PREFIX_SIZE || rhs.size() <= PREFIX_SIZE) {
+            return static_cast<int>(lhs.size() > PREFIX_SIZE) - static_cast<int>(rhs.size() > PREFIX_SIZE);
+        }
+        return catalogCmp.Compare(leveldb::Slice(lhs.data() + PREFIX_SIZE, lhs.size() - PREFIX_SIZE),
+                                  leveldb::Slice(rhs.data() + PREFIX_SIZE, rhs.size() - PREFIX_SIZE));
+    }
+
+    const char* Name() const override {
+        return "VolumePrefixCatalogKeyComparator";
+    }
+
+    void FindShortestSeparator(std::string* start, const leveldb::Slice& limit) const override {
+        // No-op.
+    }
+
+    void FindShortSuccessor(std::string* key) const override {
+        // No-op.
+    }
+
+  private:
+    const leveldb::Comparator& catalogCmp;
+};
+
+const fds_uint32_t SharedCatalogStore::PREFIX_SIZE;
+
+SharedCatalogStore::SharedCatalogStore(const std::string& file,
+                                       CatalogResources& resources,
+                                       fds_uint32_t writeBufferSize)
+        : cmp(new PrefixComparator(catalog_cmp)),
+          filter_policy(leveldb::NewBloomFilterPolicy(FILTER_BITS_PER_KEY)) {
+    options.create_if_missing = 1;
+    options.filter_policy = filter_policy.get();
+    options.comparator = cmp.get();
+    options.write_buffer_size = writeBufferSize;
+    options.block_cache = resources.blockCache();
+    options.max_open_files = resources.maxOpenFiles();
+    write_options.sync = true;
+
+    leveldb::DB* db_out;
+    leveldb::Status status = leveldb::DB::Open(options, file, &db_out);
+    if (!status.ok()) {
+        throw CatalogException(std::string(__FILE__) + ":" + std::to_string(__LINE__) +
+                               " :leveldb::DB::Open(): " + status.ToString());
+    }
+    db.reset(db_out);
+}
+
+SharedCatalogStore::~SharedCatalogStore() {
+    db.reset();
+}
+
+std::string
+SharedCatalogStore::prefix(fds_uint64_t volume) {
+    std::string p(PREFIX_SIZE, '\0');
+    for (fds_uint32_t i = 0; i < PREFIX_SIZE; ++i) {
+        p[PREFIX_SIZE - 1 - i] = static_cast<char>(volume & 0xff);
+        volume >>= 8;
+    }
+    return p;
+}
+
+template <typename Fn>
+Error
+SharedCatalogStore::forEachInRange(fds_uint64_t volume, Fn fn) {
+    leveldb::ReadOptions ro;
+    ro.fill_cache = false;
+    ro.snapshot = db->GetSnapshot();
+    Error err(ERR_OK);
+    {
+        std::string volPrefix = prefix(volume);
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(ro));
+        for (it->Seek(volPrefix); err.ok() && it->Valid() && it->key().starts_with(volPrefix); it->Next()) {
+            leveldb::Slice key = it->key();
+            key.remove_prefix(PREFIX_SIZE);
+            err = fn(key, it->value());
+        }
+        if (err.ok() && !it->status().ok()) {
+            err = ERR_DISK_READ_FAILED;
+        }
+    }
+    db->ReleaseSnapshot(ro.snapshot);
+    return err;
+}
+
+Error
+SharedCatalogStore::copyRange(fds_uint64_t from, fds_uint64_t to) {
+    std::string toPrefix = prefix(to);
+    leveldb::WriteBatch batch;
+    size_t batchBytes = 0;
+    auto flush = [this, &batch, &batchBytes]() -> Error {
+        leveldb::Status status = db->Write(write_options, &batch);
+        batch.Clear();
+        batchBytes = 0;
+        return status.ok() ? ERR_OK : ERR_DISK_WRITE_FAILED;
+    };
+
+    std::string key;
+    Error err = forEachInRange(from, [&](const leveldb::Slice& k, const leveldb::Slice& v) {
+        key = toPrefix;
+        key.append(k.data(), k.size());
+        batch.Put(key, v);
+        batchBytes += key.size() + v.size();
+        return (batchBytes >= RANGE_BATCH_BYTES) ? flush() : Error(ERR_OK);
+    });
+    if (err.ok() && batchBytes > 0) {
+        err = flush();
+    }
+    return err;
+}
+
+Error
+SharedCatalogStore::exportRange(fds_uint64_t volume, const std::string& file) {
+    std::unique_ptr<Catalog> out;
+    try {
+        out.reset(new Catalog(file));
+    } catch(const CatalogException& e) {
+        GLOGERROR << "Failed to create catalog copy: " << e.what();
+        return ERR_DISK_WRITE_FAILED;
+    }
+
+    CatWriteBatch batch;
+    size_t batchBytes = 0;
+    auto flush = [&out, &batch, &batchBytes]() {
+        Error err = out->Update(&batch);
+        batch.Clear();
+        batchBytes = 0;
+        return err;
+    };
+
+    Error err = forEachInRange(volume, [&](const leveldb::Slice& k, const leveldb::Slice& v) {
+        batch.Put(k, v);
+        batchBytes += k.size() + v.size();
+        return (batchBytes >= RANGE_BATCH_BYTES) ? flush() : Error(ERR_OK);
+    });
+    if (err.ok() && batchBytes > 0) {
+        err = flush();
+    }
+    return err;
+}
+
+Error
+SharedCatalogStore::deleteRange(fds_uint64_t volume) {
+    leveldb::WriteBatch batch;
+    size_t batchBytes = 0;
+    auto flush = [this, &batch, &batchBytes]() -> Error {
+        leveldb::Status status = db->Write(write_options, &batch);
+        batch.Clear();
+        batchBytes = 0;
+        return status.ok() ? ERR_OK : ERR_DISK_WRITE_FAILED;
+    };
+
+    std::string volPrefix = prefix(volume);
+    std::string key;
+    Error err = forEachInRange(volume, [&](const leveldb::Slice& k, const leveldb::Slice&) {
+        key = volPrefix;
+        key.append(k.data(), k.size());
+        batch.Delete(key);
+        batchBytes += key.size();
+        return (batchBytes >= RANGE_BATCH_BYTES) ? flush() : Error(ERR_OK);
+    });
+    if (err.ok() && batchBytes > 0) {
+        err = flush();
+    }
+    return err;
+}
+
+Error
+SharedCatalogStore::volumes(std::vector<fds_uint64_t>& volumesOut) {
+    leveldb::ReadOptions ro;
+    ro.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(ro));
+    // One seek per volume, past the end of its range
+    for (it->SeekToFirst(); it->Valid(); ) {
+        leveldb::Slice key = it->key();
+        fds_uint64_t volume = 0;
+        for (fds_uint32_t i = 0; i < PREFIX_SIZE && i < key.size(); ++i) {
+            volume = (volume << 8) | static_cast<unsigned char>(key[i]);
+        }
+        volumesOut.push_back(volume);
+        if (std::numeric_limits<fds_uint64_t>::max() == volume) {
+            break;
+        }
+        it->Seek(prefix(volume + 1));
+    }
+    return it->status().ok() ? ERR_OK : ERR_DISK_READ_FAILED;
+}
+
 CatalogKeyComparator const Catalog::_DEFAULT_COMPARATOR;
 
 /** Catalog constructor
@@ -60,7 +394,9 @@ Catalog::Catalog(const std::string& _file,
                  const std::string& logFilePrefix /* = empty */,
                  fds_uint32_t maxLogFiles /* = 0 */,
                  fds_bool_t archiveLogs_,
-                 leveldb::Comparator * cmp /* = 0 */) : backing_file(_file)
+                 leveldb::Comparator * cmp /* = 0 */,
+                 CatalogResources* sharedResources /* = nullptr */)
+        : backing_file(_file), resources(sharedResources), shared(nullptr), volume(0), ldb(nullptr)
 {
     filter_policy.reset(leveldb::NewBloomFilterPolicy(FILTER_BITS_PER_KEY));
 
@@ -69,8 +405,15 @@ Catalog::Catalog(const std::string& _file,
      */
     options.create_if_missing = 1;
     options.filter_policy     = filter_policy.get();
-    options.write_buffer_size = writeBufferSize;
-    options.block_cache = leveldb::NewLRUCache(cacheSize);
+    if (resources) {
+        options.write_buffer_size = resources->acquireWriteBuffer(writeBufferSize);
+        options.block_cache = resources->blockCache();
+        options.max_open_files = resources->maxOpenFiles();
+    } else {
+        options.write_buffer_size = writeBufferSize;
+        cache.reset(leveldb::NewLRUCache(cacheSize));
+        options.block_cache = cache.get();
+    }
     if (cmp)
     {
         options.comparator = cmp;
@@ -104,16 +447,39 @@ Catalog::Catalog(const std::string& _file,
     if (!status.ok())
     {
         db.release();
+        if (resources) {
+            resources->releaseWriteBuffer(options.write_buffer_size);
+        }
         throw CatalogException(std::string(__FILE__) + ":" + std::to_string(__LINE__) +
                                " :leveldb::DB::Open(): " + status.ToString());
     }
+    ldb = db.get();
+}
+
+Catalog::Catalog(const std::string& _file, SharedCatalogStore& store, fds_uint64_t volume)
+        : backing_file(_file),
+          options(store.GetOptions()),
+          resources(nullptr),
+          shared(&store),
+          volume(volume),
+          prefix(SharedCatalogStore::prefix(volume)),
+          ldb(store.GetDB())
+{
+    // Callers compare the keys they iterate over, which come without prefix
+    options.comparator = store.catalogComparator();
+    // Only there for the log accessors, the store has no per volume logs
+    env.reset(new leveldb::CopyEnv(*leveldb::Env::Default()));
+    write_options.sync = true;
 }
 
 Catalog::~Catalog()
 {
-    // Order is important here, db references env.
+    // Order is important here, db references env and the block cache.
     db.reset();
     env.reset();
+    if (resources) {
+        resources->releaseWriteBuffer(options.write_buffer_size);
+    }
 }
 
 /** Updates the catalog
@@ -125,7 +491,9 @@ Error
 Catalog::Update(const CatalogKey& key, const leveldb::Slice& val) {
     Error err(ERR_OK);
 
-    leveldb::Status status = db->Put(write_options, static_cast<leveldb::Slice>(key), val);
+    std::string buf;
+    leveldb::Status status = ldb->Put(write_options,
+                                      storeKey(static_cast<leveldb::Slice>(key), buf), val);
     if (!status.ok()) {
         err = Error(ERR_DISK_WRITE_FAILED);
     }
@@ -137,7 +505,8 @@ Error
 Catalog::Update(CatWriteBatch* batch) {
     Error err(ERR_OK);
 
-    leveldb::Status status = db->Write(write_options, batch);
+    CatWriteBatch buf;
+    leveldb::Status status = ldb->Write(write_options, storeBatch(batch, buf));
     if (!status.ok()) {
         err = Error(ERR_DISK_WRITE_FAILED);
     }
@@ -145,6 +514,19 @@ Catalog::Update(CatWriteBatch* batch) {
     return err;
 }
 
+Error
+Catalog::Update(CatWriteBatch* batch, fds_bool_t sync) {
+    leveldb::WriteOptions options(write_options);
+    options.sync = sync;
+
+    CatWriteBatch buf;
+    leveldb::Status status = ldb->Write(options, storeBatch(batch, buf));
+    if (!status.ok()) {
+        return ERR_DISK_WRITE_FAILED;
+    }
+    return ERR_OK;
+}
+
 /** Queries the catalog
  * @param[in]  key   the key to read to
  * @param[out] value the data found
@@ -157,7 +539,8 @@ Catalog::Query(const CatalogKey& key, std::string* value, MemSnap m) {
     leveldb::ReadOptions ro{read_options};
     ro.snapshot = m;
 
-    leveldb::Status status = db->Get(ro, static_cast<leveldb::Slice>(key), value);
+    std::string buf;
+    leveldb::Status status = ldb->Get(ro, storeKey(static_cast<leveldb::Slice>(key), buf), value);
     if (status.IsNotFound()) {
         err = fds::Error(fds::ERR_CAT_ENTRY_NOT_FOUND);
         return err;
@@ -177,7 +560,9 @@ Error
 Catalog::Delete(const CatalogKey& key) {
     Error err(ERR_OK);
 
-    leveldb::Status status = db->Delete(write_options, static_cast<leveldb::Slice>(key));
+    std::string buf;
+    leveldb::Status status = ldb->Delete(write_options,
+                                         storeKey(static_cast<leveldb::Slice>(key), buf));
     if (!status.ok()) {
         err = Error(ERR_DISK_WRITE_FAILED);
     }
@@ -185,9 +570,47 @@ Catalog::Delete(const CatalogKey& key) {
     return err;
 }
 
+CatWriteBatch*
+Catalog::storeBatch(CatWriteBatch* batch, CatWriteBatch& buf) const {
+    if (!shared) {
+        return batch;
+    }
+    PrefixBatch prefixBatch(prefix, buf);
+    batch->Iterate(&prefixBatch);
+    return &buf;
+}
+
+std::unique_ptr<Catalog::catalog_iterator_t>
+Catalog::NewIterator(MemSnap m) {
+    leveldb::ReadOptions ro{read_options};
+
+    ro.snapshot = m;
+
+    if (shared) {
+        return std::unique_ptr<catalog_iterator_t>(
+            new PrefixIterator(ldb->NewIterator(ro), prefix, volume));
+    }
+    return std::unique_ptr<catalog_iterator_t>(ldb->NewIterator(ro));
+}
+
+Error
+Catalog::CopyTo(fds_uint64_t destVolume) {
+    fds_assert(shared);
+    return shared->copyRange(volume, destVolume);
+}
+
+Error
+Catalog::DeleteAll() {
+    fds_assert(shared);
+    return shared->deleteRange(volume);
+}
+
 Error
 Catalog::DbSnap(const std::string& fileName) {
     fds_assert(!fileName.empty());
+    if (shared) {
+        return shared->exportRange(volume, fileName);
+    }
     Error err(ERR_OK);
     leveldb::CopyEnv * env = static_cast<leveldb::CopyEnv*>(options.env);
     fds_assert(env);
@@ -2,6 +2,8 @@
  * Copyright 2013-2014 Formation Data Systems, Inc.
  */
 
+#include <algorithm>
+
 #include "QoSWFQDispatcher.h"
 
 namespace fds {
@@ -16,6 +18,15 @@ QoSWFQDispatcher::ioProcessForEnqueue(fds_qid_t queue_id, FDS_IOType *io)
     assert(n_pios >= 0);
 }
 
+// Caller needs to hold the qda read lock
+void
+QoSWFQDispatcher::ioProcessForEnqueueBatch(fds_qid_t queue_id, FDS_IOType* const *ios, size_t n_ios)
+{
+    LOGTRACE << "Batch of " << n_ios << " being enqueued at queue " << queue_id;
+    WFQQueueDesc *qd = queue_desc_map[queue_id];
+    atomic_fetch_add(&(qd->num_pending_ios), (unsigned int)n_ios);
+}
+
 // Caller needs to hold the qda read lock
 void
 QoSWFQDispatcher::ioProcessForDispatch(fds_qid_t queue_id, FDS_IOType *io)
@@ -34,10 +45,28 @@ QoSWFQDispatcher::inc_num_ios_dispatched(unsigned int io_dispatch_type)
     if (num_ios_dispatched >= total_capacity) {
         num_ios_dispatched = 0;
         num_rate_based_slots_serviced = 0;
-        last_reset_time = util::getTimeStampMicros();
+        last_reset_time = clock();
+    }
+}
+
+// Caller needs to hold the qda read lock
+void
+QoSWFQDispatcher::chargeQueue(fds_qid_t queue_id, fds_uint32_t tokens)
+{
+    auto it = queue_desc_map.find(queue_id);
+    if (it != queue_desc_map.end()) {
+        it->second->pending_charge.fetch_add(tokens, std::memory_order_relaxed);
     }
 }
 
+// Credits a queue can bank while it has nothing queued, burst_credit_ms worth
+// of its assured rate
+fds_uint32_t
+QoSWFQDispatcher::maxRateBasedCredits(fds_uint64_t queue_rate) const
+{
+    return queue_rate * cost_model.burstCreditMs / 1000 + 1;
+}
+
 fds_qid_t
 QoSWFQDispatcher::get_non_empty_queue_with_highest_credits()
 {
@@ -68,10 +97,39 @@ QoSWFQDispatcher::get_non_empty_queue_with_highest_credits()
 }
 
 // Requires the caller to hold the qda read lock while calling this.
+// Each slot picked is worth one token.  A queue charged for IOs that cost more
+// pays its debt with the slots it gets next, first out of its banked credits,
+// so volumes share the server in tokens rather than in IOs.
 fds_qid_t
 QoSWFQDispatcher::getNextQueueForDispatch()
 {
-    fds_uint64_t current_time = util::getTimeStampMicros();
+    while (true) {
+        fds_qid_t next_queue = pickNextQueue();
+        if (next_queue == 0) {
+            return 0;
+        }
+        WFQQueueDesc *qd = queue_desc_map[next_queue];
+        qd->debt += qd->pending_charge.exchange(0, std::memory_order_relaxed);
+        if (qd->debt == 0) {
+            return next_queue;
+        }
+        fds_uint64_t from_credits = std::min<fds_uint64_t>(qd->debt, qd->num_rate_based_credits);
+        qd->num_rate_based_credits -= from_credits;
+        qd->debt -= from_credits;
+        if (qd->debt == 0) {
+            return next_queue;
+        }
+        --qd->debt;
+        LOGTRACE << "Dispatcher: queue " << next_queue << " paying for slot, debt "
+                 << qd->debt;
+    }
+}
+
+// Requires the caller to hold the qda read lock while calling this.
+fds_qid_t
+QoSWFQDispatcher::pickNextQueue()
+{
+    fds_uint64_t current_time = clock();
     fds_uint64_t elapsed_usecs = current_time - last_reset_time;                                    // O(1)
     // ios per second that we have been able to achieve since last reset time.
     // float current_rate = ((float)num_ios_dispatched * 1000000)/ elapsed_usecs;
@@ -236,7 +294,8 @@ QoSWFQDispatcher::QoSWFQDispatcher(FDS_QoSControl *ctrlr,
 
     num_ios_dispatched = 0;
     num_rate_based_slots_serviced = 0;
-    last_reset_time = util::getTimeStampMicros();
+    clock = util::getTimeStampMicros;
+    last_reset_time = clock();
 
     cur_total_min_rate = 0;
     total_capacity = total_svc_iops = total_server_iops;
@@ -253,6 +312,13 @@ QoSWFQDispatcher::QoSWFQDispatcher(FDS_QoSControl *ctrlr,
     next_priority_based_queue = 0;
 }
 
+void
+QoSWFQDispatcher::setClock(const std::function<fds_uint64_t()>& microsClock)
+{
+    clock = microsClock;
+    last_reset_time = clock();
+}
+
 Error
 QoSWFQDispatcher::assignSpotsToQueue(WFQQueueDesc *qd)
 {
@@ -319,8 +385,7 @@ QoSWFQDispatcher::registerQueue(fds_qid_t queue_id, FDS_VolumeQueue *queue)
     qd->num_outstanding_ios = ATOMIC_VAR_INIT(0);
     qd->num_priority_based_ios_dispatched = 0;
     qd->num_rate_based_credits = 0;
-    // Can accumulate up to half a second worth of spots.
-    qd->max_rate_based_credits = queue->iops_assured / 2 + 1;
+    qd->max_rate_based_credits = maxRateBasedCredits(queue->iops_assured);
 
     qda_lock.write_lock();
     // do not allow registering the queue that will exceed total
@@ -417,8 +482,7 @@ QoSWFQDispatcher::modifyQueueQosParams(fds_qid_t queue_id,
     qd->queue_priority = prio;
     qd->rate_based_weight = q_min_rate;
     qd->priority_based_weight = priority_to_wfq_weight(prio);
-    // Can accumulate up to half a second worth of spots.
-    qd->max_rate_based_credits = q_min_rate / 2 + 1;
+    qd->max_rate_based_credits = maxRateBasedCredits(q_min_rate);
 
     // Now fill the vacant spots in the rate based qlist based on the new queue_rate
     // Start at the first vacant spot and fill at intervals of capacity/queue_rate.
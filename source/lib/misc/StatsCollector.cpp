@@ -2,7 +2,11 @@
  * Copyright 2014 Formation Data Systems, Inc.
  */
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <fds_process.h>
 #include <net/SvcRequestPool.h>
@@ -14,12 +18,65 @@ namespace fds {
 
 StatsCollector* glStatsCollector = nullptr;
 
+/**
+ * One thread's events for a volume since the last merge, by second and
+ * FdsVolStatType. The thread records into one bank while the merge drains
+ * the other.
+ */
+struct VolStatBuffer {
+    static const fds_uint32_t ROWS = 2;
+    struct Row {
+        fds_uint64_t rel_sec {std::numeric_limits<fds_uint64_t>::max()};  // max if unused
+        GenericCounter counters[STAT_MAX_TYPE];
+    };
+
+    explicit VolStatBuffer(fds_volid_t id) : volid(id) {}
+
+    fds_volid_t volid;
+    Row banks[2][ROWS];
+    std::atomic<fds_uint32_t> active {0};
+    /* Bank the owning thread is recording into plus one, 0 if none */
+    std::atomic<fds_uint32_t> writing {0};
+};
+
+/**
+ * Stat buffers of the volumes one thread recorded events for
+ */
+struct ThreadVolStats {
+    /* Only the owning thread adds volumes, under vols_lock so the merge can walk them */
+    std::unordered_map<fds_volid_t, std::unique_ptr<VolStatBuffer>> vols;
+    std::mutex vols_lock;
+    /* Consecutive events are usually for the same volume */
+    fds_volid_t last_volid;
+    VolStatBuffer *last_vol {nullptr};
+    /* Set once the thread exits, the merge drains and drops these stats */
+    std::atomic<bool> exited {false};
+};
+
+namespace {
+
+std::atomic<fds_uint64_t> nextCollectorId(0);
+
+/* Stats this thread records into, for each collector */
+struct ThreadStatsRefs {
+    ~ThreadStatsRefs() {
+        for (auto &ref : refs) {
+            ref.second->exited = true;
+        }
+    }
+    std::vector<std::pair<fds_uint64_t, std::shared_ptr<ThreadVolStats>>> refs;
+};
+thread_local ThreadStatsRefs threadStatsRefs;
+
+}  // namespace
+
 class CollectorTimerTask : public FdsTimerTask {
   public:
     typedef enum {
         TM_PUSH_STATS,
         TM_SAMPLE_STATS,
-        TM_PRINT_QOS
+        TM_PRINT_QOS,
+        TM_MERGE_STATS
     } collector_timer_t;
 
     StatsCollector* collector_;
@@ -53,7 +110,11 @@ StatsCollector::StatsCollector(fds_uint32_t push_sec,
                                               CollectorTimerTask::TM_PRINT_QOS)),
           sampleTimer(new FdsTimer()),
           sampleTimerTask(new CollectorTimerTask(*sampleTimer, this,
-                                                 CollectorTimerTask::TM_SAMPLE_STATS))
+                                                 CollectorTimerTask::TM_SAMPLE_STATS)),
+          collector_id_(nextCollectorId++),
+          mergeTimer(new FdsTimer()),
+          mergeTimerTask(new CollectorTimerTask(*mergeTimer, this,
+                                                CollectorTimerTask::TM_MERGE_STATS))
 {
     // stats are disabled by default
     qos_enabled_ = ATOMIC_VAR_INIT(false);
@@ -78,6 +139,28 @@ StatsCollector::StatsCollector(fds_uint32_t push_sec,
     svcMgr_ = nullptr;
     record_stats_cb_ = NULL;
     stream_stats_cb_ = NULL;
+
+    /**
+     * AM latencies and queue stats go to the qos history, everything but
+     * the AM queue wait and blob metadata latencies is streamed
+     */
+    for (fds_uint32_t type = 0; type < STAT_MAX_TYPE; ++type) {
+        qos_stat_type_[type] = false;
+        stream_stat_type_[type] = true;
+    }
+    for (auto type : {STAT_AM_PUT_OBJ, STAT_AM_GET_OBJ, STAT_AM_QUEUE_BACKLOG,
+                      STAT_AM_QUEUE_WAIT, STAT_AM_GET_BMETA, STAT_AM_PUT_BMETA}) {
+        qos_stat_type_[type] = true;
+    }
+    for (auto type : {STAT_AM_QUEUE_WAIT, STAT_AM_GET_BMETA, STAT_AM_PUT_BMETA}) {
+        stream_stat_type_[type] = false;
+    }
+    for (auto type : StatConstants::singleton()->disabledVolStats) {
+        if (type < STAT_MAX_TYPE) {
+            qos_stat_type_[type] = false;
+            stream_stat_type_[type] = false;
+        }
+    }
 }
 
 void StatsCollector::openQosFile(const std::string& name) {
@@ -116,6 +199,7 @@ StatsCollector::~StatsCollector() {
     pushTimer->destroy();
     qosTimer->destroy();
     sampleTimer->destroy();
+    mergeTimer->destroy();
     if (statfile_.is_open()){
         statfile_.close();
     }
@@ -142,6 +226,7 @@ void StatsCollector::startStreaming(record_svc_stats_t record_stats_cb,
     if (!was_enabled) {
         LOGDEBUG << "Start pushing stats to DMs: Start time " << start_time_;
         stream_stats_cb_ = stream_stats_cb;
+        startMergeTimer();
         // start periodic timer to push stats to primary DM
         fds_bool_t ret = pushTimer->scheduleRepeated(pushTimerTask,
                                                      std::chrono::seconds(push_interval_));
@@ -187,6 +272,7 @@ void StatsCollector::enableQosStats(const std::string& name) {
     if (!was_enabled) {
         LOGDEBUG << "Enabled Qos stats output: Start time " << start_time_;
         openQosFile(name);
+        startMergeTimer();
 
         // start periodic timer to push stats to primary DM
         fds_bool_t ret = qosTimer->scheduleRepeated(qosTimerTask,
@@ -214,46 +300,157 @@ fds_bool_t StatsCollector::isQosStatsEnabled() const {
     return std::atomic_load(&qos_enabled_);
 }
 
+void StatsCollector::startMergeTimer() {
+    std::call_once(merge_started_, [this]() {
+        fds_bool_t ret = mergeTimer->scheduleRepeated(mergeTimerTask,
+                                                      std::chrono::seconds(slotsec_qos_));
+        if (!ret) {
+            LOGERROR << "Failed to schedule timer to merge stats; "
+                     << " stats will only be merged when printed or streamed";
+        }
+    });
+}
+
+ThreadVolStats* StatsCollector::getThreadStats() {
+    for (auto &ref : threadStatsRefs.refs) {
+        if (ref.first == collector_id_) {
+            return ref.second.get();
+        }
+    }
+
+    // first event this thread records
+    std::shared_ptr<ThreadVolStats> stats(new ThreadVolStats());
+    {
+        std::lock_guard<std::mutex> l(thread_stats_lock_);
+        thread_stats_.push_back(stats);
+    }
+    threadStatsRefs.refs.emplace_back(collector_id_, stats);
+    return stats.get();
+}
+
 void StatsCollector::recordEvent(fds_volid_t volume_id,
                                  fds_uint64_t timestamp,
                                  FdsVolStatType event_type,
                                  fds_uint64_t value) {
     /**
-     * For disabled Volume stats, just exit.
+     * For disabled Volume stats, and histories that aren't collected, just exit.
      */
-    if (StatConstants::singleton()->disabledVolStats.find(event_type) !=
-            StatConstants::singleton()->disabledVolStats.end()) {
+    if (static_cast<fds_uint32_t>(event_type) >= STAT_MAX_TYPE) {
+        return;
+    }
+    if (!(qos_stat_type_[event_type] && isQosStatsEnabled()) &&
+        !(stream_stat_type_[event_type] && isStreaming())) {
         return;
     }
 
-    switch (event_type) {
-        case STAT_AM_PUT_OBJ:       // end-to-end put in AM in usec
-        case STAT_AM_GET_OBJ:       // end-to-end get in AM in usec
-        case STAT_AM_QUEUE_BACKLOG:    // que size (recorded when que size > threshold)
-            if (isQosStatsEnabled()) {
-                getQosHistory(volume_id)->recordEvent(timestamp,
-                                                      event_type, value);
-            }
-            if (isStreaming()) {
-                getStatHistory(volume_id)->recordEvent(timestamp,
-                                                       event_type, value);
-            }
+    GenericCounter counter;
+    if (timestamp < start_time_) {
+        counter.add(value);
+        recordEventLocked(volume_id, timestamp, event_type, counter);
+        return;
+    }
+    fds_uint64_t rel_sec = (timestamp - start_time_) / NANOS_IN_SECOND;
+
+    ThreadVolStats *stats = getThreadStats();
+    VolStatBuffer *buf = stats->last_vol;
+    if (!buf || stats->last_volid != volume_id) {
+        auto it = stats->vols.find(volume_id);
+        if (it == stats->vols.end()) {
+            std::lock_guard<std::mutex> l(stats->vols_lock);
+            it = stats->vols.emplace(volume_id, std::unique_ptr<VolStatBuffer>(
+                new VolStatBuffer(volume_id))).first;
+        }
+        buf = it->second.get();
+        stats->last_volid = volume_id;
+        stats->last_vol = buf;
+    }
+
+    /* Claim the active bank; if the merge switched banks meanwhile, claim the new one */
+    fds_uint32_t bank;
+    do {
+        bank = buf->active.load();
+        buf->writing.store(bank + 1);
+    } while (buf->active.load() != bank);
+
+    /* Rows are used in order, the first unused row ends the search */
+    VolStatBuffer::Row *row = nullptr;
+    for (auto &r : buf->banks[bank]) {
+        if (r.rel_sec == rel_sec || r.rel_sec == std::numeric_limits<fds_uint64_t>::max()) {
+            row = &r;
             break;
+        }
+    }
+    if (row) {
+        row->rel_sec = rel_sec;
+        row->counters[event_type].add(value);
+    }
+    buf->writing.store(0, std::memory_order_release);
 
-        case STAT_AM_QUEUE_WAIT:    // wait time in queue in usec
-        case STAT_AM_GET_BMETA:
-        case STAT_AM_PUT_BMETA:
-            if (isQosStatsEnabled()) {
-                getQosHistory(volume_id)->recordEvent(timestamp,
-                                                      event_type, value);
+    if (!row) {
+        // event for a second older than the rows hold, rare
+        counter.add(value);
+        recordEventLocked(volume_id, timestamp, event_type, counter);
+    }
+}
+
+void StatsCollector::recordEventLocked(fds_volid_t volume_id,
+                                       fds_uint64_t timestamp,
+                                       FdsVolStatType event_type,
+                                       const GenericCounter& counter) {
+    if (qos_stat_type_[event_type] && isQosStatsEnabled()) {
+        getQosHistory(volume_id)->recordPerfCounter(timestamp, event_type, counter);
+    }
+    if (stream_stat_type_[event_type] && isStreaming()) {
+        getStatHistory(volume_id)->recordPerfCounter(timestamp, event_type, counter);
+    }
+}
+
+void StatsCollector::mergeThreadStats() {
+    std::lock_guard<std::mutex> merge_guard(merge_lock_);
+
+    std::vector<std::shared_ptr<ThreadVolStats>> thread_stats;
+    {
+        std::lock_guard<std::mutex> l(thread_stats_lock_);
+        thread_stats = thread_stats_;
+    }
+
+    for (auto &stats : thread_stats) {
+        // read before draining, so the thread's last events are in this merge
+        bool exited = stats->exited;
+        std::lock_guard<std::mutex> l(stats->vols_lock);
+        for (auto &kv : stats->vols) {
+            VolStatBuffer *buf = kv.second.get();
+
+            /* Switch banks and wait for the thread to finish the event it's recording */
+            fds_uint32_t bank = buf->active.load();
+            buf->active.store(1 - bank);
+            while (buf->writing.load() == bank + 1) {
+                std::this_thread::yield();
             }
-            break;
-        default:
-            if (isStreaming()) {
-                getStatHistory(volume_id)->recordEvent(timestamp,
-                                                       event_type, value);
+
+            for (auto &row : buf->banks[bank]) {
+                if (row.rel_sec == std::numeric_limits<fds_uint64_t>::max()) {
+                    break;
+                }
+                fds_uint64_t ts = start_time_ + row.rel_sec * NANOS_IN_SECOND;
+                for (fds_uint32_t type = 0; type < STAT_MAX_TYPE; ++type) {
+                    if (row.counters[type].count() > 0) {
+                        recordEventLocked(buf->volid, ts,
+                                          static_cast<FdsVolStatType>(type),
+                                          row.counters[type]);
+                        row.counters[type].reset();
+                    }
+                }
+                row.rel_sec = std::numeric_limits<fds_uint64_t>::max();
             }
-    };
+        }
+
+        if (exited) {
+            std::lock_guard<std::mutex> l(thread_stats_lock_);
+            thread_stats_.erase(std::remove(thread_stats_.begin(), thread_stats_.end(), stats),
+                                thread_stats_.end());
+        }
+    }
 }
 
 VolumePerfHistory::ptr StatsCollector::getQosHistory(fds_volid_t volid)
@@ -306,6 +503,7 @@ VolumePerfHistory::ptr StatsCollector::getStatHistory(fds_volid_t volid)
 void StatsCollector::print()
 {
     if (!isQosStatsEnabled()) return;
+    mergeThreadStats();
 
     std::unordered_map<fds_volid_t, VolumePerfHistory::ptr> snap_map;
     std::unordered_map<fds_volid_t, VolumePerfHistory::ptr>::const_iterator cit;
@@ -348,6 +546,7 @@ void StatsCollector::sampleStats() {
 //
 void StatsCollector::sendStatStream() {
     if (!isStreaming()) return;
+    mergeThreadStats();
     std::unordered_map<fds_volid_t, VolumePerfHistory::ptr> snap_map;
     std::unordered_map<fds_volid_t, VolumePerfHistory::ptr>::const_iterator cit;
 
@@ -453,6 +652,8 @@ void CollectorTimerTask::runTimerTask()
         collector_->sendStatStream();
     } else if (timer_type_ == TM_PRINT_QOS) {
         collector_->print();
+    } else if (timer_type_ == TM_MERGE_STATS) {
+        collector_->mergeThreadStats();
     } else {
         fds_verify(timer_type_ == TM_SAMPLE_STATS);
         collector_->sampleStats();
@@ -759,7 +759,7 @@ Error DLTManager::add(const DLT& _newDlt,
 
     if (dltList.empty()) {
         dltList.push_back(pNewDlt);
-        curPtr = pNewDlt;
+        setCurrentLocked(pNewDlt);
         // TODO(prem): checkSize();
         return err;
     }
@@ -789,7 +789,7 @@ Error DLTManager::add(const DLT& _newDlt,
     // TODO(prem): checkSize();
 
     // switch this to current ???
-    curPtr = &newDlt;
+    setCurrentLocked(&newDlt);
 
     return err;
 }
@@ -914,7 +914,7 @@ Error DLTManager::setCurrent(fds_uint64_t version) {
     SCOPEDWRITE(dltLock);
     for (iter = dltList.begin(); iter != dltList.end(); ++iter) {
         if (version == (*iter)->version) {
-            curPtr = *iter;
+            setCurrentLocked(*iter);
             return ERR_OK;
         }
     }
@@ -967,6 +967,39 @@ NodeUuid DLTManager::getPrimary(const ObjectID& objId) const {
     return getPrimary(objId);
 }
 
+void DLTManager::setCurrentLocked(DLT* dlt) {
+    curPtr = dlt;
+    // DLTs in the list are not modified after this point, so the flat copy
+    // stays in sync until the current one changes again. Deeper tables than
+    // a route holds are left to the locked lookups.
+    curRoutes.publish((dlt->depth <= TableRoute::MAX_DEPTH) ?
+                      new RoutingTable(dlt->version,
+                                       dlt->width,
+                                       dlt->depth,
+                                       *(dlt->distList)) :
+                      nullptr);
+}
+
+bool DLTManager::getRoute(fds_token_id token, TableRoute& route) const {
+    RcuReadGuard guard;
+    const RoutingTable* table = curRoutes.get();
+    if (table == nullptr || token >= table->getNumColumns()) {
+        return false;
+    }
+    table->getRoute(token, route);
+    return true;
+}
+
+bool DLTManager::getRoute(const ObjectID& objId, TableRoute& route) const {
+    RcuReadGuard guard;
+    const RoutingTable* table = curRoutes.get();
+    if (table == nullptr) {
+        return false;
+    }
+    table->getRoute(DLT::getToken(objId, table->getWidth()), route);
+    return true;
+}
+
 uint32_t DLTManager::write(serialize::Serializer*  s) const {
     LOGTRACE << " serializing dltmgr  ";
     uint32_t bytes = 0;
@@ -360,6 +360,9 @@ Error DMTManager::add(DMT* dmt,
     }
 
     dmt_map[add_version] = DMTPtr(dmt);
+    if (dmt_type == DMT_COMMITTED) {
+        publishCommittedLocked();
+    }
 
     // check refcnt of the current DLT, if 0
     if (DMT_VER_INVALID != old_version) {
@@ -406,6 +409,7 @@ Error DMTManager::commitDMT(fds_bool_t rmTarget) {
         if (rmTarget) {
             target_version = DMT_VER_INVALID;
         }
+        publishCommittedLocked();
     } else {
         err = ERR_NOT_FOUND;
     }
@@ -432,6 +436,7 @@ Error DMTManager::commitDMT(fds_uint64_t version, fds_bool_t rmTarget) {
         committed_version = DMT_VER_INVALID;
         target_version = DMT_VER_INVALID;
     }
+    publishCommittedLocked();
     dmt_lock.write_unlock();
     return err;
 }
@@ -503,6 +508,29 @@ DmtColumnPtr DMTManager::getVersionNodeGroup(fds_volid_t const volume_id,
     return it->second->getNodeGroup(volume_id);
 }
 
+bool DMTManager::getRoute(fds_volid_t const volume_id,
+                          fds_uint64_t const version,
+                          TableRoute& route) const {
+    RcuReadGuard guard;
+    const RoutingTable* table = committed_routes.get();
+    if (table == nullptr || table->getVersion() != version || table->getNumColumns() == 0) {
+        return false;
+    }
+    table->getRoute(DMT::getNodeGroupIndex(volume_id, table->getNumColumns()), route);
+    return true;
+}
+
+void DMTManager::publishCommittedLocked() {
+    RoutingTable* table = nullptr;
+    if (committed_version != DMT_VER_INVALID) {
+        const DMTPtr& dmt = dmt_map.at(committed_version);
+        if (dmt->depth <= TableRoute::MAX_DEPTH) {
+            table = new RoutingTable(dmt->version, dmt->width, dmt->depth, *(dmt->dmt_table));
+        }
+    }
+    committed_routes.publish(table);
+}
+
 DMTPtr DMTManager::getDMT(fds_uint64_t version) {
     dmt_lock.read_lock();
     if (dmt_map.count(version) > 0) {
@@ -8,6 +8,7 @@
 #include <chrono>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <util/ObjectPool.h>
 
 
 namespace fds {
@@ -104,10 +105,17 @@ std::string FdsCountersMgr::export_as_graphite()
             oss << id_ << "." << counters_id << "." << strId << " " << c->value() << " "
                     << ts << std::endl;
             if (lat) {
-                strId = c->id() + "." + std::to_string(c->volid().get()) + ".count";
-                oss << id_ << "." << counters_id << "." << strId << " " <<
-                    dynamic_cast<LatencyCounter*>(c)->count()
-                        << " " << ts << std::endl;
+                auto lc = dynamic_cast<LatencyCounter*>(c);
+                strId = c->id() + "." + std::to_string(c->volid().get());
+                oss << id_ << "." << counters_id << "." << strId << ".count " <<
+                    lc->count() << " " << ts << std::endl;
+                if (!lc->tracksPercentiles()) {
+                    continue;
+                }
+                for (auto &p : LatencyCounter::exportedPercentiles) {
+                    oss << id_ << "." << counters_id << "." << strId << "." << p.first << " "
+                        << lc->percentile(p.second) << " " << ts << std::endl;
+                }
             }
         }
         counters->reset();
@@ -133,9 +141,17 @@ void FdsCountersMgr::export_to_ostream(std::ostream &stream)  // NOLINT
             stream << id_ << "." << counters_id << "." << strId << "\t\t" << c->value()
                     << std::endl;
             if (lat) {
-                strId = c->id() + "." + volString + ".count";
-                stream << id_ << "." << counters_id << "." << strId << "\t\t" <<
-                        dynamic_cast<LatencyCounter*>(c)->count() << std::endl;
+                auto lc = dynamic_cast<LatencyCounter*>(c);
+                strId = c->id() + "." + volString;
+                stream << id_ << "." << counters_id << "." << strId << ".count\t\t" <<
+                        lc->count() << std::endl;
+                if (!lc->tracksPercentiles()) {
+                    continue;
+                }
+                for (auto &p : LatencyCounter::exportedPercentiles) {
+                    stream << id_ << "." << counters_id << "." << strId << "." << p.first
+                            << "\t\t" << lc->percentile(p.second) << std::endl;
+                }
             }
         }
         counters->reset();
@@ -449,6 +465,29 @@ void SimpleNumericCounter::set(const uint64_t v) {
     val_.store(v, std::memory_order_relaxed);
 }
 
+SimpleLatencyCounter::SimpleLatencyCounter(const std::string &id, fds_volid_t volid,
+                                           FdsCounters *export_parent) :
+        FdsBaseCounter(id, volid, export_parent), total_latency_(0), cnt_(0) {
+}
+
+uint64_t SimpleLatencyCounter::value() const {
+    uint64_t cnt = count();
+    if (cnt == 0) {
+        return 0;
+    }
+    return total_latency() / cnt;
+}
+
+void SimpleLatencyCounter::reset() {
+    total_latency_.store(0, std::memory_order_relaxed);
+    cnt_.store(0, std::memory_order_relaxed);
+}
+
+void SimpleLatencyCounter::update(const uint64_t val, uint64_t cnt /* = 1 */) {
+    total_latency_.fetch_add(val, std::memory_order_relaxed);
+    cnt_.fetch_add(cnt, std::memory_order_relaxed);
+}
+
 
 /*****************************************************************************
  * Numeric Counter
@@ -463,7 +502,6 @@ NumericCounter::NumericCounter(const std::string &id, fds_volid_t volid,
                                 FdsCounters *export_parent)
 :   FdsBaseCounter(id, volid, export_parent)
 {
-    val_ = 0;
     min_value_ = std::numeric_limits<uint64_t>::max();
     max_value_ = 0;
 }
@@ -471,7 +509,6 @@ NumericCounter::NumericCounter(const std::string &id, fds_volid_t volid,
 NumericCounter::NumericCounter(const std::string &id, FdsCounters *export_parent)
 : FdsBaseCounter(id, export_parent)
 {
-    val_ = 0;
     min_value_ = std::numeric_limits<uint64_t>::max();
     max_value_ = 0;
 }
@@ -481,7 +518,7 @@ NumericCounter::NumericCounter(const std::string &id, FdsCounters *export_parent
 NumericCounter::NumericCounter(const NumericCounter& c)
 : FdsBaseCounter(c)
 {
-    val_ = c.val_.load(std::memory_order_relaxed);
+    val_ = c.val_;
     min_value_ = c.min_value_.load(std::memory_order_relaxed);
     max_value_ = c.max_value_.load(std::memory_order_relaxed);
 }
@@ -489,14 +526,36 @@ NumericCounter::NumericCounter(const NumericCounter& c)
 /**
  *  Exposed for testing
  */
-NumericCounter::NumericCounter() {}
+NumericCounter::NumericCounter()
+{
+    min_value_ = std::numeric_limits<uint64_t>::max();
+    max_value_ = 0;
+}
 /**
  *
  * @return
  */
 uint64_t NumericCounter::value() const
 {
-    return val_.load(std::memory_order_relaxed);
+    return val_.value();
+}
+
+/**
+ * Sums the shards and moves the watermarks
+ * @return
+ */
+uint64_t NumericCounter::sample()
+{
+    auto val = val_.value();
+    auto cur = max_value_.load(std::memory_order_relaxed);
+    while (val > cur &&
+           !max_value_.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+    cur = min_value_.load(std::memory_order_relaxed);
+    while (val < cur &&
+           !min_value_.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+    return val;
 }
 
 /**
@@ -504,7 +563,7 @@ uint64_t NumericCounter::value() const
  */
 void NumericCounter::reset()
 {
-    val_.store(0, std::memory_order_relaxed);
+    val_.reset();
     min_value_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
     max_value_.store(0, std::memory_order_relaxed);;
 }
@@ -520,10 +579,7 @@ void NumericCounter::incr() {
  * @param v
  */
 void NumericCounter::incr(const uint64_t v) {
-    auto val = val_.fetch_add(v, std::memory_order_relaxed) + v;
-    auto old_max = max_value_.load(std::memory_order_consume);
-    if (old_max < val)
-        { max_value_.store(val, std::memory_order_release); }
+    val_.add(v);
 }
 
 /**
@@ -538,27 +594,26 @@ void NumericCounter::decr() {
  * @param v
  */
 void NumericCounter::decr(const uint64_t v) {
-    auto val = val_.fetch_sub(v, std::memory_order_relaxed) - v;
-    auto old_min = min_value_.load(std::memory_order_consume);
-    if (old_min > val)
-        { min_value_.store(val, std::memory_order_release); }
+    val_.sub(v);
 }
 
 /*****************************************************************************
  * Latency Counter
  ****************************************************************************/
+const std::vector<std::pair<std::string, double>> LatencyCounter::exportedPercentiles = {
+    {"p50", 50.0},
+    {"p99", 99.0},
+    {"p999", 99.9}
+};
+
 LatencyCounter::LatencyCounter(const std::string &id, fds_volid_t volid,
                                 FdsCounters *export_parent)
     :   FdsBaseCounter(id, volid, export_parent),
-        total_latency_(0),
-        cnt_(0),
         min_latency_(std::numeric_limits<uint64_t>::max()),
         max_latency_(0) {}
 
 LatencyCounter::LatencyCounter(const std::string &id, FdsCounters *export_parent)
     :   FdsBaseCounter(id, export_parent),
-        total_latency_(0),
-        cnt_(0),
         min_latency_(std::numeric_limits<uint64_t>::max()),
         max_latency_(0) {}
 
@@ -568,19 +623,18 @@ LatencyCounter::LatencyCounter(const std::string &id, FdsCounters *export_parent
  */
 LatencyCounter::LatencyCounter(const LatencyCounter &c)
     :   FdsBaseCounter(c),
-        total_latency_(c.total_latency_.load()),
-        cnt_(c.cnt_.load()),
+        total_latency_(c.total_latency_),
+        cnt_(c.cnt_),
         min_latency_(c.min_latency_.load()),
-        max_latency_(c.max_latency_.load()) {}
+        max_latency_(c.max_latency_.load()),
+        histogram_(c.histogram_ ? new LatencyHistogram(*c.histogram_) : nullptr) {}
 
 
 /**
  * Exposed for testing
  */
 LatencyCounter::LatencyCounter()
-    :   total_latency_(0),
-        cnt_(0),
-        min_latency_(std::numeric_limits<uint64_t>::max()),
+    :   min_latency_(std::numeric_limits<uint64_t>::max()),
         max_latency_(0) {}
 
 /**
@@ -601,10 +655,22 @@ uint64_t LatencyCounter::value() const
  */
 void LatencyCounter::reset()
 {
-    total_latency_ = 0;
-    cnt_ = 0;
+    total_latency_.reset();
+    cnt_.reset();
     min_latency_ = std::numeric_limits<uint64_t>::max();
     max_latency_ = 0;
+    if (histogram_) {
+        histogram_->reset();
+    }
+}
+
+/**
+ * Percentiles are only kept for counters that ask for them
+ */
+void LatencyCounter::trackPercentiles() {
+    if (!histogram_) {
+        histogram_.reset(new LatencyHistogram());
+    }
 }
 
 /**
@@ -613,31 +679,43 @@ void LatencyCounter::reset()
  * @param cnt
  */
 void LatencyCounter::update(const uint64_t &val, uint64_t cnt /* = 1 */) {
-    total_latency_.fetch_add(val);
-    cnt_.fetch_add(cnt);
+    total_latency_.add(val);
+    cnt_.add(cnt);
     if (1 == cnt) {
-        if (val < min_latency()) {
-            min_latency_.store(val);
-        }
-        if (val > max_latency()) {
-            max_latency_.store(val);
+        if (histogram_) {
+            histogram_->record(val);
         }
+        updateMin(val);
+        updateMax(val);
+    } else if (cnt && histogram_) {
+        /* Pre-aggregated samples; best we can do is record them at their mean */
+        histogram_->record(val / cnt, cnt);
     }
 }
 
-LatencyCounter & LatencyCounter::operator +=(const LatencyCounter & rhs) {
-    if (&rhs != this) {
-        update(rhs.total_latency(), rhs.count());
+void LatencyCounter::updateMin(uint64_t val) {
+    auto cur = min_latency_.load(std::memory_order_relaxed);
+    while (val < cur &&
+           !min_latency_.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+}
 
-        uint64_t rhs_min = rhs.min_latency();
-        if (rhs_min < min_latency()) {
-            min_latency_.store(rhs_min);
-        }
+void LatencyCounter::updateMax(uint64_t val) {
+    auto cur = max_latency_.load(std::memory_order_relaxed);
+    while (val > cur &&
+           !max_latency_.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+}
 
-        uint64_t rhs_max = rhs.max_latency();
-        if (rhs_max > max_latency()) {
-            max_latency_.store(rhs_max);
+LatencyCounter & LatencyCounter::operator +=(const LatencyCounter & rhs) {
+    if (&rhs != this) {
+        total_latency_.add(rhs.total_latency());
+        cnt_.add(rhs.count());
+        if (histogram_ && rhs.histogram_) {
+            histogram_->merge(*rhs.histogram_);
         }
+        updateMin(rhs.min_latency());
+        updateMax(rhs.max_latency());
     }
     return *this;
 }
@@ -648,6 +726,12 @@ void LatencyCounter::toMap(std::map<std::string, int64_t>& m) const {
     std::string strId = id() + (volid_enable()? "." + volString : "");
     m[strId + ".latency"] = static_cast<int64_t>(value());
     m[strId + ".count"] = static_cast<int64_t>(count());
+    if (!tracksPercentiles()) {
+        return;
+    }
+    for (auto &p : exportedPercentiles) {
+        m[strId + "." + p.first] = static_cast<int64_t>(percentile(p.second));
+    }
 }
 
 /*****************************************************************************
@@ -671,4 +755,22 @@ void ResourceUsageCounter::toMap(std::map<std::string, int64_t>& m) const {
     m["rusage.num.ctx.switch.voluntary"] = usage.ru_nvcsw;         /* voluntary context switches */
     m["rusage.num.ctx.switch.involuntary"] = usage.ru_nivcsw;        /* involuntary context switches */
 }
+
+/*****************************************************************************
+ * ObjectPool Counter
+ ****************************************************************************/
+
+ObjectPoolCounter::ObjectPoolCounter(FdsCounters *export_parent) : FdsBaseCounter("objpool", export_parent) {
+}
+
+void ObjectPoolCounter::toMap(std::map<std::string, int64_t>& m) const {
+    ObjectPoolRegistry::instance().forEach([&m](const ObjectPoolStats& stats) {
+        std::string prefix = "objpool." + stats.name;
+        m[prefix + ".alloc"] = static_cast<int64_t>(stats.allocs.value());
+        m[prefix + ".reuse"] = static_cast<int64_t>(stats.reuses.value());
+        m[prefix + ".free"] = static_cast<int64_t>(stats.frees.value());
+        m[prefix + ".release"] = static_cast<int64_t>(stats.releases.value());
+        m[prefix + ".cached"] = stats.cached.load(std::memory_order_relaxed);
+    });
+}
 }  // namespace fds
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <unordered_map>
+#include <fds_routing_table.h>
+
+namespace fds {
+
+RoutingTable::RoutingTable(fds_uint64_t version,
+                           fds_uint32_t width,
+                           fds_uint32_t depth,
+                           const std::vector<boost::shared_ptr<TableColumn>>& columns)
+        : version(version),
+          width(width),
+          depth(depth),
+          numColumns(columns.size()) {
+    fds_verify(depth <= TableRoute::MAX_DEPTH);
+    cells.resize(numColumns * depth);
+    lengths.resize(numColumns);
+
+    std::unordered_map<fds_uint64_t, SvcIndex> indexOf;
+    for (fds_uint32_t col = 0; col < numColumns; ++col) {
+        const TableColumn& column = *columns[col];
+        // Short columns keep their length, the cells past it are unused
+        lengths[col] = std::min(column.getLength(), depth);
+        for (fds_uint32_t i = 0; i < lengths[col]; ++i) {
+            NodeUuid uuid = column.get(i);
+            auto itr = indexOf.find(uuid.uuid_get_val());
+            if (itr == indexOf.end()) {
+                fds_verify(svcs.size() < (1U << (8 * sizeof(SvcIndex))));
+                itr = indexOf.emplace(uuid.uuid_get_val(), svcs.size()).first;
+                svcs.push_back(uuid);
+            }
+            cells[col * depth + i] = itr->second;
+        }
+    }
+}
+
+}  // namespace fds
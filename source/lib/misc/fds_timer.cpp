@@ -53,9 +53,17 @@ FdsTimer::FdsTimer()
  * Constructor
  */
 FdsTimer::FdsTimer(const std::string &id)
+: FdsTimer(id, 1000)
+{
+}
+
+/**
+ * Constructor
+ */
+FdsTimer::FdsTimer(const std::string &id, int timerThreadSleepMs)
 : id_(std::string("FdsTimer:") + id + std::string(": ")),
     abortCntr_(0),
-    timerThreadSleepMs_(1000),
+    timerThreadSleepMs_(timerThreadSleepMs),
     timerThread_(std::bind(&FdsTimer::runTimerThread_, this))
 {
 }
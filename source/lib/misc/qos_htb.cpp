@@ -4,6 +4,8 @@
  *  Hierarchical token bucket algorithm
  *
  */
+#include <algorithm>
+
 #include "qos_htb.h"
 
 namespace fds {
@@ -67,7 +69,8 @@ QoSHTBDispatcher::registerQueue(fds_qid_t queue_id,
                                                     q_throttle_rate,
                                                     queue->priority,
                                                     wait_time_microsec,
-                                                    default_que_burst_size));
+                                                    default_que_burst_size,
+                                                    cost_model.burstCreditMs));
     if (!qstate) {
         LOGERROR << "QoSHTBDispatcher: failed to allocate memory for queue state for queue: " << queue_id;
         return ERR_MAX;
@@ -339,6 +342,19 @@ QoSHTBDispatcher::ioProcessForEnqueue(fds_qid_t queue_id,
              << " ; # of queued_ios " << (queued_ios+1);
 }
 
+void
+QoSHTBDispatcher::ioProcessForEnqueueBatch(fds_qid_t queue_id,
+        FDS_IOType* const * /*ios*/,
+        size_t n_ios)
+{
+    auto& qstate = qstate_map[queue_id];
+    fds_assert(qstate);
+    fds_uint32_t queued_ios = qstate->handleIosEnqueue(n_ios);
+    LOGTRACE << "QoSHTBDispatcher: handling enqueue of " << n_ios
+             << " IOs to queue 0x" << std::hex << queue_id << std::dec
+             << " ; # of queued_ios " << queued_ios;
+}
+
 void
 QoSHTBDispatcher::ioProcessForDispatch(fds_qid_t queue_id,
         FDS_IOType *io)
@@ -350,6 +366,15 @@ QoSHTBDispatcher::ioProcessForDispatch(fds_qid_t queue_id,
     qstate->handleIoDispatch(io);
 }
 
+void
+QoSHTBDispatcher::chargeQueue(fds_qid_t queue_id, fds_uint32_t tokens)
+{
+    auto qstate_it = qstate_map.find(queue_id);
+    if (qstate_map.end() != qstate_it) {
+        qstate_it->second->chargeTokens(tokens);
+    }
+}
+
 /* find queue whose IO needs to be dispatched next */
 fds_qid_t
 QoSHTBDispatcher::getNextQueueForDispatch()
@@ -392,6 +417,11 @@ QoSHTBDispatcher::getNextQueueForDispatch()
                          << "queue 0x" << std::hex << qstate->queue_id
                          << std::dec << " to the pool of available tokens";
             }
+            /* IOs that cost more than the token they were dispatched with */
+            fds_uint64_t pool_charge = qstate->applyCharges();
+            if (pool_charge > 0) {
+                avail_pool.chargeTokens(pool_charge);
+            }
 
             /* try to see if we can serve the io from the head of queue with assured tokens */
             TBQueueState::tbStateType state = qstate->tryToConsumeAssuredTokens(1);
@@ -462,16 +492,21 @@ TBQueueState::TBQueueState(fds_qid_t _queue_id,
         fds_int64_t _throttle_rate,
         fds_uint32_t _priority,
         fds_uint64_t _assured_wait_microsec,
-        fds_uint64_t _burst_size)
+        fds_uint64_t _burst_size,
+        fds_uint32_t _burst_credit_ms)
     : queue_id(_queue_id),
     assured_rate(_assured_rate),
     throttle_rate(_throttle_rate),
     priority(_priority),
     tb_assured(_assured_rate, _burst_size, _assured_wait_microsec),
-    tb_throttle(_throttle_rate, _burst_size)
+    tb_throttle(_throttle_rate, _burst_size),
+    burst_credit_ms(_burst_credit_ms),
+    burst_credits(0),
+    max_burst_credits(_throttle_rate * _burst_credit_ms / 1000)
 {
     assert(_assured_rate <= _throttle_rate);
     queued_io_counter = ATOMIC_VAR_INIT(0);
+    pending_charge = ATOMIC_VAR_INIT(0);
     memset(recent_iops, 0, sizeof(fds_uint32_t) * HTB_WMA_LENGTH);
 
     /* align next_hist_ts to a second boundary, so that all volumes histories are aligned */
@@ -490,6 +525,12 @@ TBQueueState::handleIoEnqueue(FDS_IOType* /*io*/)
     return (queued_io_counter.fetch_add(1, std::memory_order_relaxed) + 1);
 }
 
+fds_uint32_t
+TBQueueState::handleIosEnqueue(fds_uint32_t n_ios)
+{
+    return (queued_io_counter.fetch_add(n_ios, std::memory_order_relaxed) + n_ios);
+}
+
 /* for now assuming constant IO cost */
 fds_uint32_t
 TBQueueState::handleIoDispatch(FDS_IOType* /*io*/)
@@ -543,10 +584,28 @@ fds_uint64_t TBQueueState::updateTokens(fds_uint64_t nowMicrosec)
      * to use chrono nanosec timers (cannot compile for some reason). */
     moveToNextHistTs(nowMicrosec);
 
-    tb_throttle.updateTBState(nowMicrosec);
+    /* bank what an idle queue could not use for IOs that cost more later */
+    burst_credits = std::min(burst_credits + tb_throttle.updateTBState(nowMicrosec),
+                             max_burst_credits);
     return tb_assured.updateTBState(nowMicrosec);
 }
 
+fds_uint64_t TBQueueState::applyCharges()
+{
+    fds_uint64_t charge = pending_charge.exchange(0, std::memory_order_relaxed);
+    if (charge == 0) {
+        return 0;
+    }
+
+    /* max rate: burst credits first, then go into debt */
+    fds_uint64_t from_credits = std::min(charge, burst_credits);
+    burst_credits -= from_credits;
+    tb_throttle.chargeTokens(charge - from_credits);
+
+    /* the queue's own assured tokens, then the shared pool */
+    return charge - tb_assured.consumeUpTo(charge);
+}
+
 /* will consume 'io_cost' tokens from tb_min if they are available, there is at
  * least one queued IO, and we are not over the max rate limit, otherwise
  * return one of the states */
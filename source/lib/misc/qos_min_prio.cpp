@@ -85,6 +85,17 @@ void QoSMinPrioDispatcher::ioProcessForEnqueue(fds_qid_t queue_id,
   qstate->handleIoEnqueue(io);
 }
 
+void QoSMinPrioDispatcher::ioProcessForEnqueueBatch(fds_qid_t queue_id,
+                                                    FDS_IOType* const * /*ios*/,
+                                                    size_t n_ios)
+{
+  auto& qstate = qstate_map[queue_id];
+  fds_assert(qstate);
+  FDS_PLOG(qda_log) << "QoSMinPrioDispatcher: handling enqueue of " << n_ios
+                    << " IOs to queue " << queue_id;
+  qstate->handleIosEnqueue(n_ios);
+}
+
 void QoSMinPrioDispatcher::ioProcessForDispatch(fds_qid_t queue_id,
 						FDS_IOType *io)
 {
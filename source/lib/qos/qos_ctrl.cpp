@@ -114,6 +114,12 @@ Error FDS_QoSControl::enqueueIO(fds_volid_t volUUID, FDS_IOType *io) {
     return err;
 }
 
+Error FDS_QoSControl::enqueueIOs(fds_volid_t volUUID,
+                                 const std::vector<FDS_IOType*> &ios,
+                                 size_t &nEnqueued) {
+    return dispatcher->enqueueIOs(volUUID.get(), ios, nEnqueued);
+}
+
 fds_uint32_t FDS_QoSControl::queueSize(fds_volid_t volId) {
     return dispatcher->count(volId.get());
 }
@@ -153,6 +159,7 @@ std::string FDS_QoSControl::getStateInfo()
     Json::Value state;
     state["total"] = static_cast<Json::Value::Int64>(dispatcher->total_svc_iops);
     state["max_outstanding_ios"] = dispatcher->max_outstanding_ios;
+    state["adaptive_outstanding_ios"] = dispatcher->adaptive_outstanding_ios.load(std::memory_order_relaxed);
     state["num_pending_ios"] = dispatcher->num_pending_ios.load(std::memory_order_relaxed);
     state["num_outstanding_ios"] = dispatcher->num_outstanding_ios.load(std::memory_order_relaxed); 
     state["queue_map_size"] = static_cast<Json::Value::UInt>(dispatcher->queue_map.size());
@@ -51,8 +51,10 @@ namespace fds {
    *              thrown away to ensure that there are never more than burstSize
    *              number of tokens that queue can consume.
    *
-   * This initial implementation assumes any IO costs 1 token (for IOPS control).
-   * Needs to be extended for variable IO cost.
+   * Getting an IO dispatched costs 1 token.  IOs that cost more (see IoCostModel)
+   * are charged the rest with chargeTokens() once their cost is known; the charge
+   * is paid from burst credits, tokens spilled from tb_throttle while the queue
+   * was idle, and otherwise put the queue into debt with tb_throttle.
    *
    * This class is thread-safe assuming that multiple threads call handleIoEnqueue()
    * and a single thread calling other methods -- basically multiple threads queueing
@@ -73,7 +75,8 @@ namespace fds {
                  fds_int64_t _throttle_rate,
                  fds_uint32_t _priority,
                  fds_uint64_t _assured_wait_microsec,
-                 fds_uint64_t _burst_size);
+                 fds_uint64_t _burst_size,
+                 fds_uint32_t _burst_credit_ms = 0);
     ~TBQueueState();
 
     /* Modify effective min and max rates  */
@@ -83,6 +86,7 @@ namespace fds {
       assert(_assured_rate <= _throttle_rate);
       tb_assured.modifyRate(_assured_rate, _assured_wait_microsec);
       tb_throttle.modifyRate(_throttle_rate);
+      max_burst_credits = _throttle_rate * burst_credit_ms / 1000;
     }
 
     inline fds_uint64_t getEffectiveMinRate() const { return tb_assured.getRate();}
@@ -92,6 +96,8 @@ namespace fds {
      * uses atomic operations to update state of the queue
      * both functions return resulting number of queued IOs */
     fds_uint32_t handleIoEnqueue(FDS_IOType * /*io*/);
+    /* Same as handleIoEnqueue() for n_ios IOs queued together */
+    fds_uint32_t handleIosEnqueue(fds_uint32_t n_ios);
     fds_uint32_t handleIoDispatch(FDS_IOType * /*io*/);
 
     /* returns moving average of IOPS performance */
@@ -100,6 +106,17 @@ namespace fds {
     /* Update number of tokens and returns the number of expired 'assured' tokens */
     fds_uint64_t updateTokens(fds_uint64_t nowMicrosec);
 
+    /* Records a charge of 'tokens' beyond what the IO was dispatched with.
+     * May be called from any thread; applied by applyCharges() */
+    inline void chargeTokens(fds_uint32_t tokens) {
+      pending_charge.fetch_add(tokens, std::memory_order_relaxed);
+    }
+
+    /* Applies recorded charges to the queue's token buckets; returns the part of
+     * the charge not covered by the queue's assured tokens, which the parent
+     * dispatcher takes from the pool of available tokens */
+    fds_uint64_t applyCharges();
+
     /* Uses the state from the last call to updateTokens().
      * For the IO at the head of the queue, try to consume tokens that were created with minRate
      * Otherwise, returns:
@@ -152,10 +169,17 @@ namespace fds {
     TokenBucket tb_assured;  /* token bucket to ensure assured_rate */
     TokenBucket tb_throttle; /* token bucket to control we do not exceed throttle_rate */
 
+    /* throttle tokens banked while idle, up to burst_credit_ms at the effective max rate */
+    fds_uint32_t burst_credit_ms;
+    fds_uint64_t burst_credits;
+    fds_uint64_t max_burst_credits;
+
     /*  For initial implementation where cost of IO is const, we just need
      *  to maintain a counter of queued IOs to keep track if queue is empty or not
      *  This value is the only variable of this class that is accessed by multiple threads  */
     alignas(64) std::atomic<unsigned int> queued_io_counter;
+    /* charges recorded by chargeTokens() and not yet applied */
+    alignas(64) std::atomic<unsigned int> pending_charge;
   };
 
 
@@ -191,6 +215,9 @@ namespace fds {
     /***** implementation of base class functions *****/
     /* handle notification that IO was just queued */
     void ioProcessForEnqueue(fds_qid_t queue_id, FDS_IOType *io) override;
+    void ioProcessForEnqueueBatch(fds_qid_t queue_id,
+                                  FDS_IOType* const *ios,
+                                  size_t n_ios) override;
 
     /* handle notification that IO will be dispatched */
     void ioProcessForDispatch(fds_qid_t queue_id, FDS_IOType *io) override;
@@ -199,6 +226,9 @@ namespace fds {
      * this implementation consumes tokens required to dispatch IO */
     fds_qid_t getNextQueueForDispatch() override;
 
+    /* records the charge on the queue state, applied when the queue is next visited */
+    void chargeQueue(fds_qid_t queue_id, fds_uint32_t tokens) override;
+
     /* this implementation calls based class registerQueue first */
     Error registerQueue(fds_qid_t queue_id, FDS_VolumeQueue *queue) override;
 
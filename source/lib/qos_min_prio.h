@@ -50,6 +50,11 @@ public:
   virtual void ioProcessForEnqueue(fds_qid_t queue_id,
 				   FDS_IOType *io);
 
+  /* handle notification that a batch of IOs was just queued */
+  virtual void ioProcessForEnqueueBatch(fds_qid_t queue_id,
+                                        FDS_IOType* const *ios,
+                                        size_t n_ios);
+
   /* handle notification that IO will be dispatched */
   virtual void ioProcessForDispatch(fds_qid_t queue_id,
 				    FDS_IOType *io);			    
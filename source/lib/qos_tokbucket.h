@@ -72,6 +72,7 @@ public:
         }
         t_last_update_ = util::getTimeStampMicros();  // current time in microseconds
         token_count_ = 0;
+        debt_ = 0;
     }
 
     ///
@@ -173,6 +174,39 @@ public:
         return false;
     }
 
+    ///
+    /// Charge tokens for work that was already done.
+    ///
+    /// Unlike tryToConsumeTokens() this always succeeds: tokens the bucket does not hold are
+    /// recorded as debt, which is repaid from tokens accumulated later before any of them become
+    /// available again.
+    ///
+    /// @param  num_tokens  The number of tokens to charge.
+    ///
+    inline void chargeTokens(fds_uint64_t num_tokens) {
+        debt_ += num_tokens - consumeUpTo(num_tokens);
+    }
+
+    ///
+    /// Consume as many of a specified number of tokens as this bucket holds.
+    ///
+    /// @param  num_tokens  The most tokens to consume.
+    ///
+    /// @return  The number of tokens consumed.
+    ///
+    inline fds_uint64_t consumeUpTo(fds_uint64_t num_tokens) {
+        fds_uint64_t consumed = std::min(num_tokens, token_count_);
+        token_count_ -= consumed;
+        return consumed;
+    }
+
+    ///
+    /// Get the number of tokens charged that have not been repaid yet.
+    ///
+    inline fds_uint64_t getDebt() const {
+        return debt_;
+    }
+
     ///
     /// Get the number of microseconds it will take for a specified number of tokens to be
     /// available.
@@ -227,11 +261,15 @@ protected:
             fds_verify(std::numeric_limits<fds_uint64_t>::max() / elapsed_microsec >= rate_);
             fds_uint64_t new_tokens = elapsed_microsec * rate_ / 1000000;
 
+            // Charged tokens are paid back first
+            fds_uint64_t repaid_tokens = std::min(debt_, new_tokens);
+            debt_ -= repaid_tokens;
+
             // Very low likelihood of an overflow here, but if a misconfiguration or other special
             // circumstances lead to > 100 years passing (see MAX_RATE), at least the error won't
             // cause something hard to debug.
             fds_verify(std::numeric_limits<fds_uint64_t>::max() - token_count_ >= new_tokens);
-            token_count_ += new_tokens;
+            token_count_ += new_tokens - repaid_tokens;
 
             // token_microsec will be strictly less than or equal to elapsed_microsec, which can't
             // possibly cause overflow since it's calculated as the difference between two unsigned
@@ -271,6 +309,8 @@ public:
     fds_uint64_t t_last_update_;  ///< Microseconds since epoch on which this bucket last
                                   ///< accumulated tokens.
     fds_uint64_t token_count_;    ///< Number of tokens currently in the bucket.
+    fds_uint64_t debt_;           ///< Tokens charged beyond what the bucket held, see
+                                  ///< chargeTokens().
     ///@}
 };
 
@@ -0,0 +1,124 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <limits>
+#include <net/EndpointLatencyTracker.h>
+
+namespace fds {
+
+EndpointLatencyTracker::EndpointLatencyTracker(const HedgeConfig &config)
+    : config_(config),
+    hedgeDelayMs_(config.maxDelayMs),
+    hedgeTokens_(static_cast<int64_t>(config.budgetBurst) * 100)
+{
+}
+
+EndpointLatencyTracker::EndpointStats*
+EndpointLatencyTracker::getEndpointStats_(const fpi::SvcUuid &svcUuid)
+{
+    {
+        ReadGuard rg(lock_);
+        auto itr = endpoints_.find(svcUuid.svc_uuid);
+        if (itr != endpoints_.end()) {
+            return itr->second.get();
+        }
+    }
+    WriteGuard wg(lock_);
+    auto &stats = endpoints_[svcUuid.svc_uuid];
+    if (!stats) {
+        stats.reset(new EndpointStats());
+    }
+    return stats.get();
+}
+
+void EndpointLatencyTracker::recordLatency(const fpi::SvcUuid &svcUuid, uint64_t latencyUs)
+{
+    /* Per endpoint moving average.  Racing updates may lose a sample, that's ok */
+    auto stats = getEndpointStats_(svcUuid);
+    uint64_t prev = stats->ewmaUs.load(std::memory_order_relaxed);
+    uint64_t next = (prev == 0) ? latencyUs :
+        (prev * (EWMA_SCALE - EWMA_WEIGHT) + latencyUs * EWMA_WEIGHT) / EWMA_SCALE;
+    stats->ewmaUs.store(std::max<uint64_t>(next, 1), std::memory_order_relaxed);
+
+    /* Latency distribution across all endpoints */
+    auto cur = curWindow_.load(std::memory_order_relaxed);
+    windows_[cur].record(latencyUs);
+
+    auto nSamples = samples_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (nSamples % WINDOW_SAMPLES == 0) {
+        /* Rotate: the previous window gets reused for new samples */
+        windows_[cur ^ 1].reset();
+        curWindow_.store(cur ^ 1, std::memory_order_relaxed);
+    }
+    if (nSamples % HEDGE_DELAY_REFRESH_SAMPLES == 0) {
+        refreshHedgeDelay_();
+    }
+}
+
+void EndpointLatencyTracker::refreshHedgeDelay_()
+{
+    LatencyHistogram combined(windows_[0]);
+    combined.merge(windows_[1]);
+    uint64_t delayMs = combined.percentile(config_.percentile) / 1000;
+    delayMs = std::max<uint64_t>(delayMs, config_.minDelayMs);
+    delayMs = std::min<uint64_t>(delayMs, config_.maxDelayMs);
+    hedgeDelayMs_.store(static_cast<uint32_t>(delayMs), std::memory_order_relaxed);
+}
+
+uint64_t EndpointLatencyTracker::getEwmaLatencyUs(const fpi::SvcUuid &svcUuid) const
+{
+    ReadGuard rg(lock_);
+    auto itr = endpoints_.find(svcUuid.svc_uuid);
+    if (itr == endpoints_.end()) {
+        return 0;
+    }
+    return itr->second->ewmaUs.load(std::memory_order_relaxed);
+}
+
+uint32_t EndpointLatencyTracker::pickFastest(const std::vector<fpi::SvcUuid> &svcUuids) const
+{
+    uint32_t fastestIdx = 0;
+    uint64_t fastestUs = std::numeric_limits<uint64_t>::max();
+
+    ReadGuard rg(lock_);
+    for (uint32_t i = 0; i < svcUuids.size(); i++) {
+        auto itr = endpoints_.find(svcUuids[i].svc_uuid);
+        uint64_t latencyUs = (itr == endpoints_.end()) ?
+            0 : itr->second->ewmaUs.load(std::memory_order_relaxed);
+        if (latencyUs < fastestUs) {
+            fastestUs = latencyUs;
+            fastestIdx = i;
+        }
+    }
+    return fastestIdx;
+}
+
+uint32_t EndpointLatencyTracker::getHedgeDelayMs() const
+{
+    return hedgeDelayMs_.load(std::memory_order_relaxed);
+}
+
+void EndpointLatencyTracker::addHedgeEligibleRequest()
+{
+    const int64_t maxTokens = static_cast<int64_t>(config_.budgetBurst) * 100;
+    auto tokens = hedgeTokens_.load(std::memory_order_relaxed);
+    while (tokens < maxTokens &&
+           !hedgeTokens_.compare_exchange_weak(tokens,
+                                               std::min(tokens + config_.budgetPct, maxTokens),
+                                               std::memory_order_relaxed)) {
+    }
+}
+
+bool EndpointLatencyTracker::tryAcquireHedge()
+{
+    auto tokens = hedgeTokens_.load(std::memory_order_relaxed);
+    while (tokens >= 100) {
+        if (hedgeTokens_.compare_exchange_weak(tokens, tokens - 100,
+                                               std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace fds
@@ -7,8 +7,10 @@
 #include <limits>
 #include <concurrency/Mutex.h>
 #include <arpa/inet.h>
+#include <unistd.h>
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
 #include "fdsp/common_constants.h"
 #include <fdsp/PlatNetSvc.h>
 #include <fdsp/health_monitoring_api_types.h>
@@ -27,6 +29,7 @@
 #include <fiu-control.h>
 #include <util/fiu_util.h>
 #include <util/always_call.h>
+#include <util/StageTrace.h>
 #include <json/json.h>
 #include <OmExtUtilApi.h>
 
@@ -163,6 +166,15 @@ SvcMgr::SvcMgr(CommonModuleProviderIf *moduleProvider,
     fds_assert(omSvcUuid_.svc_uuid != 0);
     fds_assert(omPort_ != 0);
 
+    StageTracer::setSampleRate(config.get_abs<int>("fds.common.stage_trace_sample_rate", 0));
+
+    peerSenderConfig_.maxQueuedBytes = config.get_abs<fds_uint64_t>(
+        "fds.pm.svc.send.max_queued_mb", peerSenderConfig_.maxQueuedBytes >> 20) << 20;
+    peerSenderConfig_.maxBatchFrames = config.get_abs<fds_uint32_t>(
+        "fds.pm.svc.send.max_batch_msgs", peerSenderConfig_.maxBatchFrames);
+    multiplexedServices_ = config.get_abs<bool>(
+        "fds.feature_toggle.common.enable_multiplexed_services", false);
+
     svcRequestHandler_ = asyncHandler;
     svcInfo_ = svcInfo;
 
@@ -398,8 +410,8 @@ bool SvcMgr::getSvcHandle_(const fpi::SvcUuid &svcUuid, SvcHandlePtr& handle) co
     return true;
 }
 
-void SvcMgr::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
-                                 StringPtr &payload)
+Error SvcMgr::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
+                                     StringPtr &payload)
 {
     LOGTRACE << "ASYNC_REQUEST_SEND  ["
              << static_cast<SvcRequestId>(header->msg_src_id) << "]: "
@@ -411,7 +423,7 @@ void SvcMgr::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
     if (svcUuid == getSelfSvcUuid()) {
         /* Routing local requests */
         svcRequestHandler_->asyncReqt(header, payload);
-        return;
+        return ERR_OK;
     }
 
     do {
@@ -422,15 +434,29 @@ void SvcMgr::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
         }
     } while (false);
 
-    if (svcHandle) {
-        svcHandle->sendAsyncSvcReqMessage(header, payload);
-    } else {
+    if (!svcHandle) {
         postSvcSendError(header);
+        return ERR_SVC_REQUEST_INVOCATION;
     }
+    return svcHandle->sendAsyncSvcReqMessage(header, payload);
 }
 
-void SvcMgr::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
-                                     StringPtr &payload)
+Error SvcMgr::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
+                                     const SvcMsgPayloadPtr &payload)
+{
+    if (header->msg_dst_uuid == getSelfSvcUuid() && payload->hasMsg()) {
+        LOGTRACE << "ASYNC_REQUEST_SEND  ["
+                 << static_cast<SvcRequestId>(header->msg_src_id) << "]: "
+                 << fds::logString(*header);
+        svcRequestHandler_->asyncReqt(header, payload);
+        return ERR_OK;
+    }
+    StringPtr buf = payload->getBuf();
+    return sendAsyncSvcReqMessage(header, buf);
+}
+
+Error SvcMgr::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
+                                      StringPtr &payload)
 {
 
     LOGTRACE << "ASYNC_RESPONSE_SEND  ["
@@ -443,7 +469,7 @@ void SvcMgr::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
     if (svcUuid == getSelfSvcUuid()) {
         /* Routing local responses */
         svcRequestHandler_->asyncResp(header, payload);
-        return;
+        return ERR_OK;
     }
 
     do {
@@ -454,12 +480,12 @@ void SvcMgr::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
         }
     } while (false);
 
-    if (svcHandle) {
-        svcHandle->sendAsyncSvcRespMessage(header, payload);
-    } else {
+    if (!svcHandle) {
         GLOGWARN << "Failed to get svc handle: " << fds::logString(*header)
                 << ".  Dropping the respone";
+        return ERR_SVC_REQUEST_INVOCATION;
     }
+    return svcHandle->sendAsyncSvcRespMessage(header, payload);
 }
 
 void SvcMgr::broadcastAsyncSvcReqMessage(fpi::AsyncHdrPtr &h,
@@ -483,10 +509,10 @@ void SvcMgr::broadcastAsyncSvcReqMessage(fpi::AsyncHdrPtr &h,
     }
 }
 
-void SvcMgr::postSvcSendError(fpi::AsyncHdrPtr &header)
+void SvcMgr::postSvcSendError(fpi::AsyncHdrPtr &header, const Error &e)
 {
     swapAsyncHdr(header);
-    header->msg_code = ERR_SVC_REQUEST_INVOCATION;
+    header->msg_code = e.GetErrno();
 
     svcRequestMgr_->postError(header);
 }
@@ -849,6 +875,10 @@ SvcHandle::SvcHandle(CommonModuleProviderIf *moduleProvider,
 : HasModuleProvider(moduleProvider)
 {
     svcInfo_ = info;
+    sender_.reset(new SvcPeerSender(MODULEPROVIDER()->getSvcMgr()->getPeerSenderConfig(),
+                                    std::bind(&SvcHandle::connect_, this),
+                                    std::bind(&SvcHandle::onSendFailure_,
+                                              this, std::placeholders::_1)));
     GLOGDEBUG << "Operation: new service handle";
     GLOGDEBUG << logString();
 }
@@ -858,96 +888,150 @@ SvcHandle::~SvcHandle()
     GLOGDEBUG << logString();
 }
 
-void SvcHandle::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
-                                    StringPtr &payload)
+Error SvcHandle::sendAsyncSvcReqMessage(fpi::AsyncHdrPtr &header,
+                                        StringPtr &payload)
 {
-    bool bSendSuccess = true;
-    {
-        fds_scoped_lock lock(lock_);
-        bSendSuccess  = sendAsyncSvcMessageCommon_(true, header, payload);
-    }
-    if (!bSendSuccess) {
-        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(header);
+    Error e = sendAsyncSvcMessageCommon_(true, header, payload);
+    if (!e.ok()) {
+        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(header, e);
     }
+    return e;
 }
 
-void SvcHandle::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
-                                        StringPtr &payload)
+Error SvcHandle::sendAsyncSvcRespMessage(fpi::AsyncHdrPtr &header,
+                                         StringPtr &payload)
 {
-    bool bSendSuccess = true;
-    {
-        fds_scoped_lock lock(lock_);
-        bSendSuccess  = sendAsyncSvcMessageCommon_(false, header, payload);
-    }
-    if (!bSendSuccess) {
-        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(header);
+    Error e = sendAsyncSvcMessageCommon_(false, header, payload);
+    if (!e.ok()) {
+        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(header, e);
     }
+    return e;
 }
 
 void SvcHandle::sendAsyncSvcReqMessageOnPredicate(fpi::AsyncHdrPtr &header,
                                                StringPtr &payload,
                                                const SvcInfoPredicate& predicate)
 {
-    bool bSendSuccess = true;
     {
         fds_scoped_lock lock(lock_);
         /* Only send to services matching predicate */
-        if (predicate(svcInfo_)) {
-            bSendSuccess  = sendAsyncSvcMessageCommon_(true, header, payload);
+        if (!predicate(svcInfo_)) {
+            return;
         }
     }
+    sendAsyncSvcReqMessage(header, payload);
+}
 
-    if (!bSendSuccess) {
-        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(header);
+/**
+ * Serializes the message into a TFramedTransport frame, the same bytes
+ * PlatNetSvcClient::asyncReqt()/asyncResp() write on a framed transport
+ */
+static SvcPeerSender::FramePtr encodeAsyncFrame(bool isAsyncReqt,
+                                                bool multiplexed,
+                                                fpi::AsyncHdrPtr &header,
+                                                StringPtr &payload)
+{
+    auto buf = bo::make_shared<tt::TMemoryBuffer>(SvcPeerSender::FRAME_HDR_BYTES +
+                                                  payload->size() + 256);
+    uint8_t frameHdr[SvcPeerSender::FRAME_HDR_BYTES] = {0};
+    buf->write(frameHdr, sizeof(frameHdr));
+    boost::shared_ptr<tp::TProtocol> proto = bo::make_shared<tp::TBinaryProtocol>(buf);
+    if (multiplexed) {
+        proto = bo::make_shared<tp::TMultiplexedProtocol>(
+            proto, fpi::commonConstants().PLATNET_SERVICE_NAME);
     }
+    fpi::PlatNetSvcClient client(proto);
+    if (isAsyncReqt) {
+        client.send_asyncReqt(*header, *payload);
+    } else {
+        client.send_asyncResp(*header, *payload);
+    }
+
+    SvcPeerSender::FramePtr frame(new SvcPeerSender::Frame());
+    frame->data = buf->getBufferAsString();
+    SvcPeerSender::setFrameLength(frame->data);
+    frame->header = header;
+    return frame;
 }
 
-bool SvcHandle::sendAsyncSvcMessageCommon_(bool isAsyncReqt,
-                                           fpi::AsyncHdrPtr &header,
-                                           StringPtr &payload)
+Error SvcHandle::sendAsyncSvcMessageCommon_(bool isAsyncReqt,
+                                            fpi::AsyncHdrPtr &header,
+                                            StringPtr &payload)
 {
-    /* NOTE: This code assumes lock is held */
-
-    if (isSvcDown_()) {
-        /* No point trying to send when service is down */
-        GLOGWARN << "No point in sending when service is down! ( "
-                  << fds::logString(svcInfo_) << ")";
-        return false;
+    {
+        fds_scoped_lock lock(lock_);
+        if (isSvcDown_()) {
+            /* No point trying to send when service is down */
+            GLOGWARN << "No point in sending when service is down! ( "
+                      << fds::logString(svcInfo_) << ")";
+            return ERR_SVC_REQUEST_INVOCATION;
+        }
     }
+
+    SvcPeerSender::FramePtr frame;
     try {
-        if (!svcClient_) {
-            GLOGDEBUG << "Allocating PlatNetSvcClient for: " << logString();
-            svcClient_ = allocRpcClient<fpi::PlatNetSvcClient>(svcInfo_.ip,
-                                                               svcInfo_.svc_port,
-                                                               SvcMgr::MIN_CONN_RETRIES,
-                                                               fpi::commonConstants().PLATNET_SERVICE_NAME,
-                                                               MODULEPROVIDER()->get_fds_config());
-        }
         if (isAsyncReqt) {
             /**
              * fault injection, if 'svc.fault.unreachable' is set the following lambda will execute
              */
             fiu_do_on("svc.fault.unreachable",
                       LOGNOTIFY << "Triggering unreachable fault"; throw "Fault injection unreachable";);
-
-            svcClient_->asyncReqt(*header, *payload);
-        } else {
-            svcClient_->asyncResp(*header, *payload);
         }
-        return true;
+        frame = encodeAsyncFrame(isAsyncReqt,
+                                 MODULEPROVIDER()->getSvcMgr()->useMultiplexedServices(),
+                                 header, payload);
     } catch (std::exception &e) {
-        GLOGWARN << "allocRpcClient failed.  Exception: " << e.what() << ".  "  << header
-                 << " SvcInfo ( " << fds::logString(svcInfo_) << " )";
-
+        GLOGWARN << "Failed to encode message.  Exception: " << e.what() << ".  "  << header
+                 << " SvcInfo ( " << logString() << " )";
+        fds_scoped_lock lock(lock_);
         markSvcDown_();
-
+        return ERR_SVC_REQUEST_INVOCATION;
     } catch (...) {
-        GLOGWARN << "allocRpcClient failed.  Unknown exception. " << header
-                 << " SvcInfo ( " << fds::logString(svcInfo_) << " )";
-
+        GLOGWARN << "Failed to encode message.  Unknown exception. " << header
+                 << " SvcInfo ( " << logString() << " )";
+        fds_scoped_lock lock(lock_);
         markSvcDown_();
+        return ERR_SVC_REQUEST_INVOCATION;
+    }
+
+    Error e = sender_->send(frame);
+    if (!e.ok()) {
+        GLOGDEBUG << "Not sending, " << sender_->getQueuedBytes() << " bytes already queued. "
+                  << header << " SvcInfo ( " << logString() << " )";
+    }
+    return e;
+}
+
+int SvcHandle::connect_()
+{
+    fpi::SvcInfo info;
+    getSvcInfo(info);
+    GLOGDEBUG << "Connecting to: " << fds::logString(info);
+
+    net::Socket sock(info.ip, info.svc_port);
+    if (!sock.connect(SvcMgr::MIN_CONN_RETRIES)) {
+        GLOGWARN << "Failed to connect to ip: " << info.ip << " port: " << info.svc_port;
+        return -1;
+    }
+    /* The sender owns the connection from here on */
+    int fd = ::dup(sock.getSocketFD());
+    sock.close();
+    return fd;
+}
+
+void SvcHandle::onSendFailure_(std::vector<SvcPeerSender::FramePtr> &frames)
+{
+    GLOGWARN << "Failed to send " << frames.size() << " messages.  SvcInfo ( "
+             << logString() << " )";
+    {
+        fds_scoped_lock lock(lock_);
+        if (!isSvcDown_()) {
+            markSvcDown_();
+        }
+    }
+    for (auto &frame : frames) {
+        MODULEPROVIDER()->getSvcMgr()->postSvcSendError(frame->header);
     }
-    return false;
 }
 
 bool
@@ -996,8 +1080,7 @@ SvcHandle::shouldUpdateSvcHandle(const fpi::SvcInfoPtr &current, const fpi::SvcI
 }
 
 void SvcHandle::updateSvcHandle(const fpi::SvcInfo &newInfo, 
-                                bool forceUpdate, 
-                                const fpi::PlatNetSvcClientPtr &client )
+                                bool forceUpdate)
 {
     fds_scoped_lock lock(lock_);
     auto currentPtr = boost::make_shared<fpi::SvcInfo>(svcInfo_);
@@ -1007,15 +1090,12 @@ void SvcHandle::updateSvcHandle(const fpi::SvcInfo &newInfo,
 
     if (forceUpdate) {
       svcInfo_ = newInfo;
-      svcClient_.reset( );
-      if (client) {
-        svcClient_ = client;
-      }
+      sender_->disconnect();
       GLOGNORMAL << "Operation Applied (Forced update!).";
     } else {
       if (OmExtUtilApi::isIncomingUpdateValid(*newPtr, *currentPtr, "SvcMgr")) {
          svcInfo_ = newInfo;
-         svcClient_.reset();
+         sender_->disconnect();
          GLOGDEBUG << "Operation Applied.";
       } else {
          GLOGDEBUG << "Operation not Applied.";
@@ -1067,7 +1147,7 @@ void SvcHandle::markSvcDown_()
                                               svcInfo_.svc_type) ) {
         /* NOTE: Assumes this function is invoked under lock */
         svcInfo_.svc_status = fpi::SVC_STATUS_INACTIVE_FAILED;
-        svcClient_.reset();
+        sender_->disconnect();
         GLOGDEBUG  << logString();
 
         // Don't report ON to it self.
@@ -1080,7 +1160,7 @@ void SvcHandle::markSvcDown_()
       }
     } else {
         svcInfo_.svc_status = fpi::SVC_STATUS_INACTIVE_FAILED;
-        svcClient_.reset();
+        sender_->disconnect();
         GLOGDEBUG << logString();
 
         // Don't report ON to it self.
@@ -0,0 +1,242 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <util/Log.h>
+#include <net/SvcPeerSender.h>
+
+namespace fds {
+
+const uint32_t SvcPeerSender::FRAME_HDR_BYTES;
+
+SvcPeerSender::SvcPeerSender(const PeerSenderConfig &config,
+                             ConnectFn connectFn,
+                             FailFn failFn)
+    : config_(config),
+      connectFn_(connectFn),
+      failFn_(failFn),
+      stopping_(false),
+      queuedBytes_(0),
+      framesSent_(0),
+      writes_(0)
+{
+    config_.maxBatchFrames = std::min(std::max(config_.maxBatchFrames, 1u),
+                                      static_cast<uint32_t>(IOV_MAX));
+}
+
+SvcPeerSender::~SvcPeerSender()
+{
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> l(conn_.fdLock);
+        if (conn_.fd >= 0) {
+            /* Unblocks a writer stuck on a peer that doesn't read */
+            ::shutdown(conn_.fd, SHUT_RDWR);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> l(conn_.wakeLock);
+        conn_.wake.notify_one();
+    }
+    if (conn_.writer.joinable()) {
+        conn_.writer.join();
+    }
+    closeConnection_(conn_);
+    Frame *frame;
+    while (conn_.frames.pop(frame)) {
+        delete frame;
+    }
+}
+
+void SvcPeerSender::startWriter_()
+{
+    conn_.writer = std::thread(&SvcPeerSender::writerLoop_, this, std::ref(conn_));
+}
+
+Error SvcPeerSender::send(FramePtr &frame)
+{
+    uint64_t bytes = frame->data.size();
+    /* A frame larger than the limit still goes out when nothing is queued */
+    uint64_t prevBytes = queuedBytes_.fetch_add(bytes);
+    if (prevBytes != 0 && prevBytes + bytes > config_.maxQueuedBytes) {
+        queuedBytes_ -= bytes;
+        return ERR_SVC_SEND_QUEUE_FULL;
+    }
+
+    std::call_once(writerStarted_, &SvcPeerSender::startWriter_, this);
+
+    conn_.frames.push(frame.release());
+    if (conn_.queued.fetch_add(1) == 0) {
+        std::lock_guard<std::mutex> l(conn_.wakeLock);
+        conn_.wake.notify_one();
+    }
+    return ERR_OK;
+}
+
+void SvcPeerSender::disconnect()
+{
+    /* The writer closes the connection before its next write, a write in
+     * progress isn't cut off half way */
+    std::lock_guard<std::mutex> l(conn_.fdLock);
+    if (conn_.fd >= 0) {
+        conn_.reconnect = true;
+    }
+}
+
+void SvcPeerSender::writerLoop_(Connection &conn)
+{
+    std::vector<FramePtr> batch;
+    batch.reserve(config_.maxBatchFrames);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> l(conn.wakeLock);
+            conn.wake.wait(l, [this, &conn]() { return stopping_ || conn.queued > 0; });
+        }
+        if (stopping_) {
+            break;
+        }
+
+        Frame *frame;
+        while (batch.size() < config_.maxBatchFrames && conn.frames.pop(frame)) {
+            batch.emplace_back(frame);
+        }
+        conn.queued -= static_cast<int32_t>(batch.size());
+        if (batch.empty()) {
+            continue;
+        }
+
+        int fd;
+        {
+            std::lock_guard<std::mutex> l(conn.fdLock);
+            if (conn.reconnect) {
+                ::close(conn.fd);
+                conn.fd = -1;
+                conn.reconnect = false;
+            }
+            fd = conn.fd;
+        }
+        if (fd < 0) {
+            fd = connectFn_();
+            if (fd < 0) {
+                failFrames_(conn, batch);
+                continue;
+            }
+            std::lock_guard<std::mutex> l(conn.fdLock);
+            conn.fd = fd;
+        }
+
+        size_t written = writeBatch_(fd, batch);
+        int writeErrno = errno;
+
+        /* Frames completely written are sent, even if a later one failed */
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < written; i++) {
+            bytes += batch[i]->data.size();
+        }
+        queuedBytes_ -= bytes;
+        framesSent_ += written;
+        writes_++;
+
+        if (written < batch.size()) {
+            batch.erase(batch.begin(), batch.begin() + written);
+            GLOGWARN << "Failed to write " << batch.size() << " frames: " << strerror(writeErrno);
+            closeConnection_(conn);
+            failFrames_(conn, batch);
+            continue;
+        }
+        batch.clear();
+    }
+}
+
+size_t SvcPeerSender::writeBatch_(int fd, std::vector<FramePtr> &batch)
+{
+    std::vector<struct iovec> iov(batch.size());
+    for (uint32_t i = 0; i < batch.size(); i++) {
+        iov[i].iov_base = const_cast<char*>(batch[i]->data.data());
+        iov[i].iov_len = batch[i]->data.size();
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = batch.size();
+    while (msg.msg_iovlen > 0) {
+        ssize_t written = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* The frame the iovec points into is the first one not written */
+            return batch.size() - msg.msg_iovlen;
+        }
+        /* Partial write, skip what went out */
+        while (msg.msg_iovlen > 0 && static_cast<size_t>(written) >= msg.msg_iov->iov_len) {
+            written -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + written;
+            msg.msg_iov->iov_len -= written;
+        }
+    }
+    return batch.size();
+}
+
+void SvcPeerSender::closeConnection_(Connection &conn)
+{
+    std::lock_guard<std::mutex> l(conn.fdLock);
+    if (conn.fd >= 0) {
+        ::close(conn.fd);
+        conn.fd = -1;
+    }
+    conn.reconnect = false;
+}
+
+void SvcPeerSender::failFrames_(Connection &conn, std::vector<FramePtr> &batch)
+{
+    /* Everything behind the failed frames would only fail the same way */
+    Frame *frame;
+    int32_t popped = 0;
+    while (conn.frames.pop(frame)) {
+        batch.emplace_back(frame);
+        popped++;
+    }
+    conn.queued -= popped;
+
+    uint64_t bytes = 0;
+    for (auto &f : batch) {
+        bytes += f->data.size();
+    }
+    queuedBytes_ -= bytes;
+
+    failFn_(batch);
+    batch.clear();
+}
+
+std::string SvcPeerSender::logString() const
+{
+    std::stringstream ss;
+    ss << "queued bytes: " << queuedBytes_
+       << " frames sent: " << framesSent_
+       << " writes: " << writes_;
+    return ss.str();
+}
+
+void SvcPeerSender::setFrameLength(std::string &data)
+{
+    uint32_t len = htonl(static_cast<uint32_t>(data.size() - FRAME_HDR_BYTES));
+    memcpy(&data[0], &len, FRAME_HDR_BYTES);
+}
+
+}  // namespace fds
@@ -17,6 +17,8 @@
 #include <net/SvcRequestTracker.h>
 #include <net/SvcRequestPool.h>
 #include <net/SvcMgr.h>
+#include <net/WorkloadCapture.h>
+#include <util/StageTrace.h>
 #include <concurrency/SynchronizedTaskExecutor.hpp>
 #include <util/fiu_util.h>
 #include <fiu-control.h>
@@ -26,6 +28,15 @@
 namespace fds {
 
 thread_local StringPtr PlatNetSvcHandler::threadLocalPayloadBuf;
+thread_local SvcMsgPayloadPtr PlatNetSvcHandler::threadLocalPayload;
+
+StringPtr PlatNetSvcHandler::getThreadLocalPayloadBuf()
+{
+    if (threadLocalPayload) {
+        return threadLocalPayload->getBuf();
+    }
+    return threadLocalPayloadBuf;
+}
 
 PlatNetSvcHandler::PlatNetSvcHandler(CommonModuleProviderIf *provider)
 : HasModuleProvider(provider),
@@ -107,6 +118,8 @@ void PlatNetSvcHandler::updateHandler(const fpi::FDSPMsgTypeId msgId,
                                       const FdspMsgHandler &handler)
 {
     asyncReqHandlers_[msgId] = handler;
+    /* Local requests go through handler as well, serialized */
+    asyncReqMsgHandlers_.erase(msgId);
 }
 
 /**
@@ -150,6 +163,12 @@ void PlatNetSvcHandler::asyncReqt(boost::shared_ptr<FDS_ProtocolInterface::Async
 
     fds_assert(state == ACCEPT_REQUESTS);
     // LOGDEBUG << logString(*header);
+    if (WorkloadCapture::enabled()) {
+        WorkloadCapture::instance().record(WorkloadRecord::REQUEST_IN, *header, payload);
+    }
+    /* Requests the handler creates inherit the trace id */
+    StageTracer::Scope traceScope(header->trace_id);
+    StageTracer::record(header->trace_id, TraceStage::HANDLER_START, header->msg_type_id);
     try
     {
         /* Deserialize the message and invoke the handler.  Deserialization is performed
@@ -172,6 +191,33 @@ void PlatNetSvcHandler::asyncReqt(boost::shared_ptr<FDS_ProtocolInterface::Async
         LOGWARN << "Unknown message type: " << static_cast<int32_t>(header->msg_type_id)
                 << " Ignoring";
     }
+    StageTracer::record(header->trace_id, TraceStage::HANDLER_END, header->msg_type_id);
+}
+
+void PlatNetSvcHandler::asyncReqt(boost::shared_ptr<FDS_ProtocolInterface::AsyncHdr>& header,
+                                  const SvcMsgPayloadPtr& payload)
+{
+    auto itr = asyncReqMsgHandlers_.find(header->msg_type_id);
+    if (itr == asyncReqMsgHandlers_.end() ||
+        handlerState_ != ACCEPT_REQUESTS ||
+        WorkloadCapture::enabled()) {
+        /* Deferred requests, captured requests and handlers that only take bytes */
+        StringPtr buf = payload->getBuf();
+        asyncReqt(header, buf);
+        return;
+    }
+
+    LOGTRACE << "ASYNC_REQUEST_RCVD   ["
+             << static_cast<SvcRequestId>(header->msg_src_id) << "]: "
+             << fds::logString(*header);
+
+    fiu_do_on("svc.uturn.asyncreqt", header->msg_code = ERR_INVALID;
+              sendAsyncResp(*header, fpi::EmptyMsgTypeId, fpi::EmptyMsg()); return; );
+
+    StageTracer::Scope traceScope(header->trace_id);
+    StageTracer::record(header->trace_id, TraceStage::HANDLER_START, header->msg_type_id);
+    itr->second(header, payload);
+    StageTracer::record(header->trace_id, TraceStage::HANDLER_END, header->msg_type_id);
 }
 
 /**
@@ -251,6 +297,9 @@ void PlatNetSvcHandler::asyncRespHandler(SvcRequestTracker* reqTracker,
               << static_cast<SvcRequestId>(header->msg_src_id) << "]: "
               << fds::logString(*header);
 
+     /* Response callbacks continue the traced request */
+     StageTracer::Scope traceScope(asyncReq->traceId_);
+     StageTracer::record(asyncReq->traceId_, TraceStage::SVC_RESP_RECV, header->msg_type_id);
      asyncReq->handleResponse(header, payload);
 }
 
@@ -262,6 +311,10 @@ void PlatNetSvcHandler::asyncRespHandler(SvcRequestTracker* reqTracker,
      auto respHdr = boost::make_shared<fpi::AsyncHdr>(
           std::move(SvcRequestPool::swapSvcReqHeader(reqHdr)));
      respHdr->msg_type_id = msgTypeId;
+     if (WorkloadCapture::enabled()) {
+         WorkloadCapture::instance().record(WorkloadRecord::RESPONSE_OUT, *respHdr, payload);
+     }
+     StageTracer::record(respHdr->trace_id, TraceStage::RESP_SEND, msgTypeId);
 
      MODULEPROVIDER()->getSvcMgr()->sendAsyncSvcRespMessage(respHdr, payload);
 }
@@ -505,6 +558,23 @@ void PlatNetSvcHandler::getCounters(std::map<std::string, int64_t> & _return,
         return;
     }
 
+    if (*id == "stagetrace")
+    {
+        /* Hands out (and forgets) the sampled stage trace events recorded so
+         * far as "<trace id>.<seq>.<stage>.<arg>" -> timestamp in ns
+         */
+        std::vector<StageTraceEvent> events;
+        StageTracer::drain(events);
+        for (size_t i = 0; i < events.size(); ++i) {
+            auto const& ev = events[i];
+            _return[std::to_string(ev.traceId) + "." + std::to_string(i) + "." +
+                    StageTracer::stageName(ev.stage) + "." + std::to_string(ev.arg)] =
+                static_cast<int64_t>(ev.tsNs);
+        }
+        _return["stagetrace.dropped"] = StageTracer::dropped();
+        return;
+    }
+
     auto    cntrs = MODULEPROVIDER()->get_cntrs_mgr()->get_counters(*id);
 
     if (cntrs == nullptr)
@@ -640,6 +710,44 @@ bool PlatNetSvcHandler::setFault(boost::shared_ptr<std::string>& cmdline)  // NO
         args[parts[0]] = parts[1];
     }
 
+    /* capture.start file=<name> [payload=true], capture.stop.  Files go to var/captures/ */
+    if (args["cmd"] == "capture.start")
+    {
+        const std::string &file = args["file"];
+        if (file.empty() || file == "." || file == ".." ||
+            file.find('/') != std::string::npos)
+        {
+            LOGWARN << "Rejecting capture file name '" << file << "'";
+            return false;
+        }
+        auto fdsroot = MODULEPROVIDER()->proc_fdsroot();
+        if (!fdsroot)
+        {
+            return false;
+        }
+        FdsRootDir::fds_mkdir(fdsroot->dir_fds_var_captures().c_str());
+        auto self = MODULEPROVIDER()->getSvcMgr()->getSelfSvcUuid();
+        Error err = WorkloadCapture::instance().start(fdsroot->dir_fds_var_captures() + file,
+                                                      args["payload"] == "true",
+                                                      self.svc_uuid);
+        return err.ok();
+    } else if (args["cmd"] == "capture.stop") {
+        WorkloadCapture::instance().stop();
+        return true;
+    }
+
+    /* stagetrace.rate n=<sample one in n requests, 0 turns it off> */
+    if (args["cmd"] == "stagetrace.rate")
+    {
+        if (args.count("n") == 0)
+        {
+            return false;
+        }
+        StageTracer::setSampleRate(strtoul(args["n"].c_str(), nullptr, 10));
+        LOGNORMAL << "Stage trace sample rate set to 1 in " << StageTracer::sampleRate();
+        return true;
+    }
+
     if (args.count("cmd") == 0 || args.count("name") == 0)
     {
         return false;
@@ -30,7 +30,10 @@ SvcRequestCounters::SvcRequestCounters(const std::string &id, FdsCountersMgr *mg
     timedout("timedout", this),
     invokeerrors("invokeerrors", this),
     appsuccess("appsuccess", this),
-    apperrors("apperrors", this)
+    apperrors("apperrors", this),
+    hedged("hedged", this),
+    hedgewins("hedgewins", this),
+    hedgedenied("hedgedenied", this)
 {
     (new SimpleNumericCounter("service.start.timestamp",this))->set(util::getTimeStampSeconds());
 }
@@ -68,6 +71,30 @@ void SvcRequestTimer::runTimerTask()
     MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->postError(header_);
 }
 
+SvcRequestHedgeTimer::SvcRequestHedgeTimer(CommonModuleProviderIf* provider,
+                                           const SvcRequestId &id)
+    : HasModuleProvider(provider),
+    id_(id)
+{
+}
+
+/**
+* @brief Schedules the hedge on the request's synchronized task executor so that it
+* doesn't race with response handling.  Note this call is executed on a threadpool
+*/
+void SvcRequestHedgeTimer::runTimerTask()
+{
+    auto svcMgr = MODULEPROVIDER()->getSvcMgr();
+    auto req = boost::dynamic_pointer_cast<MultiEpSvcRequest>(
+        svcMgr->getSvcRequestTracker()->getSvcRequest(id_));
+    if (!req) {
+        /* Request already completed */
+        return;
+    }
+    auto key = req->taskExecutorIdIsSet() ? req->getTaskExecutorId() : static_cast<size_t>(id_);
+    svcMgr->getTaskExecutor()->scheduleOnHashKey(key, [req]() { req->hedge(); });
+}
+
 TrackableRequest::TrackableRequest()
 : TrackableRequest(nullptr, SvcRequestPool::SVC_UNTRACKED_REQ_ID)
 {
@@ -130,9 +157,15 @@ SvcRequestIf::~SvcRequestIf()
 void SvcRequestIf::setPayloadBuf(const fpi::FDSPMsgTypeId &msgTypeId,
                                  const boost::shared_ptr<std::string> &buf)
 {
-    fds_assert(!payloadBuf_);
+    setMsgPayload(msgTypeId, boost::make_shared<SvcMsgPayload>(buf));
+}
+
+void SvcRequestIf::setMsgPayload(const fpi::FDSPMsgTypeId &msgTypeId,
+                                 const SvcMsgPayloadPtr &payload)
+{
+    fds_assert(!payload_);
     msgTypeId_ = msgTypeId;
-    payloadBuf_ = buf;
+    payload_ = payload;
 }
 
 
@@ -219,6 +252,9 @@ void EPSvcRequest::sendPayload_()
     getSvcRequestMgr()->newSvcRequestHeaderPtr(id_, msgTypeId_, myEpId_, peerEpId_,
                                                dlt_version_, replicaId_, replicaVersion_);
     header->msg_type_id = msgTypeId_;
+    if (traceId_ != 0) {
+        header->__set_trace_id(traceId_);
+    }
 
     DBG(GLOGDEBUG << fds::logString(*header));
 
@@ -227,7 +263,9 @@ void EPSvcRequest::sendPayload_()
         fiu_do_on("svc.fail.sendpayload_before",
                   throw util::FiuException("svc.fail.sendpayload_before"));
         /* send the payload */
-        MODULEPROVIDER()->getSvcMgr()->sendAsyncSvcReqMessage(header, payloadBuf_);
+        invocationTs_ = util::getTimeStampMicros();
+        StageTracer::record(traceId_, TraceStage::SVC_SEND, msgTypeId_);
+        MODULEPROVIDER()->getSvcMgr()->sendAsyncSvcReqMessage(header, payload_);
 
         /* For fire and forget message simulate dummy response from endpoint */
         if (fireAndForget_) {
@@ -461,6 +499,7 @@ void MultiEpSvcRequest::addEndpoint(const fpi::SvcUuid& peerEpId,
             new EPSvcRequest(MODULEPROVIDER(), id_, myEpId_, peerEpId)));
     // Tag this against a specific DLT
     epReqs_.back()->dlt_version_ = dlt_version;
+    epReqs_.back()->traceId_ = traceId_;
     epReqs_.back()->setReplicaId(replicaId);
     epReqs_.back()->setReplicaVersion(replicaVersion);
 }
@@ -507,6 +546,78 @@ EPSvcRequestPtr MultiEpSvcRequest::getEpReq_(const fpi::SvcUuid &peerEpId)
     return nullptr;
 }
 
+/**
+* @brief When hedging, endpoint requests that are still in flight are completed along
+* with the request so that their timers are cancelled
+*/
+void MultiEpSvcRequest::complete(const Error& error)
+{
+    if (hedgeTimer_) {
+        MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->getHedgeTimer()->cancel(hedgeTimer_);
+        hedgeTimer_.reset();
+        for (auto &ep : epReqs_) {
+            if (ep->getState() == INVOCATION_PROGRESS) {
+                ep->complete(ERR_SVC_REQUEST_USER_INTERRUPTED);
+            }
+        }
+    }
+    SvcRequestIf::complete(error);
+}
+
+/**
+* @brief Returns true when the request is eligible for hedging and hedging is
+* turned on in config
+*/
+bool MultiEpSvcRequest::isHedging_()
+{
+    return hedgingEnabled_ &&
+        MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->\
+        getEndpointLatencyTracker()->isHedgingEnabled();
+}
+
+/**
+* @brief Arms the hedge timer with the current hedge delay.  Hedge delay is
+* derived from recently observed read latencies.
+*/
+void MultiEpSvcRequest::scheduleHedge_()
+{
+    auto svcReqMgr = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr();
+    if (!hedgeTimer_) {
+        hedgeTimer_.reset(new SvcRequestHedgeTimer(MODULEPROVIDER(), id_));
+    } else {
+        /* Rearming after failover.  Timer may still be pending */
+        svcReqMgr->getHedgeTimer()->cancel(hedgeTimer_);
+    }
+    auto delayMs = svcReqMgr->getEndpointLatencyTracker()->getHedgeDelayMs();
+    bool ret = svcReqMgr->getHedgeTimer()->\
+               schedule(hedgeTimer_, std::chrono::milliseconds(delayMs));
+    fds_assert(ret == true);
+}
+
+/**
+* @brief Number of endpoint requests that have been sent and haven't responded
+*/
+uint32_t MultiEpSvcRequest::inFlightEpCnt_() const
+{
+    uint32_t cnt = 0;
+    for (const auto &ep : epReqs_) {
+        if (ep->getState() == INVOCATION_PROGRESS) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+void MultiEpSvcRequest::recordEpLatency_(const EPSvcRequestPtr &epReq)
+{
+    if (epReq->getInvocationTs() == 0) {
+        return;
+    }
+    auto elapsed = util::getTimeStampMicros() - epReq->getInvocationTs();
+    MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->\
+        getEndpointLatencyTracker()->recordLatency(epReq->getPeerEpId(), elapsed);
+}
+
 /**
  *
  */
@@ -529,7 +640,8 @@ FailoverSvcRequest::FailoverSvcRequest(CommonModuleProviderIf* provider,
                                        fds_uint64_t const dlt_version,
                                        const std::vector<fpi::SvcUuid>& peerEpIds)
     : MultiEpSvcRequest(provider, id, myEpId, dlt_version, peerEpIds),
-      curEpIdx_(0)
+      curEpIdx_(0),
+      lastRespEpIdx_(0)
 {
 }
 
@@ -571,11 +683,28 @@ void FailoverSvcRequest::invoke() {
  */
 void FailoverSvcRequest::invokeWork_()
 {
+    bool hedging = isHedging_() && epReqs_.size() > 1;
+    if (hedging) {
+        /* Try the endpoint with the lowest observed latency first */
+        std::vector<fpi::SvcUuid> svcUuids;
+        for (const auto &ep : epReqs_) {
+            svcUuids.push_back(ep->getPeerEpId());
+        }
+        auto tracker = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->\
+                       getEndpointLatencyTracker();
+        std::swap(epReqs_[0], epReqs_[tracker->pickFastest(svcUuids)]);
+        tracker->addHedgeEligibleRequest();
+    }
+
     bool healthyEpExists = moveToNextHealthyEndpoint_();
     state_ = INVOCATION_PROGRESS;
 
     if (healthyEpExists) {
+        firstEpId_ = epReqs_[curEpIdx_]->getPeerEpId();
         epReqs_[curEpIdx_]->invokeWork_();
+        if (hedging && curEpIdx_ + 1 < epReqs_.size()) {
+            scheduleHedge_();
+        }
     } else {
         DBG(GLOGDEBUG << logString() << " No healthy endpoints left");
         fds_assert(curEpIdx_ == epReqs_.size() - 1);
@@ -629,20 +758,26 @@ void FailoverSvcRequest::handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header
         return;
     }
 
-    if (header->msg_src_uuid != epReqs_[curEpIdx_]->peerEpId_) {
-        /* Response isn't from the last endpoint we issued the request against.
+    auto epIdx = getInFlightEpIdx_(header->msg_src_uuid);
+    if (epIdx < 0) {
+        /* Response isn't from an endpoint we are waiting on.
          * Don't do anything here
          */
         // TODO(Rao): We may need special handling for success case here
         return;
     }
 
-    if (epReqs_[curEpIdx_]->isComplete()) {
-        GLOGWARN << epReqs_[curEpIdx_]->logString() << " Already completed";
+    auto &epReq = epReqs_[epIdx];
+    if (epReq->isComplete()) {
+        GLOGWARN << epReq->logString() << " Already completed";
         return;
     }
 
-    epReqs_[curEpIdx_]->complete(header->msg_code);
+    if (isHedging_()) {
+        recordEpLatency_(epReq);
+    }
+    epReq->complete(header->msg_code);
+    lastRespEpIdx_ = epIdx;
 
     bool bSuccess = (header->msg_code == ERR_OK);
 
@@ -663,6 +798,10 @@ void FailoverSvcRequest::handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header
 
     /* Handle the case where response from this endpoint is considered success */
     if (bSuccess) {
+        if (hedgeTimer_ && header->msg_src_uuid != firstEpId_ && inFlightEpCnt_() > 0) {
+            /* Hedge beat the endpoint we went to first */
+            MODULEPROVIDER()->getSvcMgr()->getSvcRequestCntrs()->hedgewins.incr();
+        }
         complete(ERR_OK);
         if (respCb_) {
             /* NOTE: We are using last failure code in this case */
@@ -672,6 +811,11 @@ void FailoverSvcRequest::handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header
         return;
     }
 
+    if (inFlightEpCnt_() > 0) {
+        /* A hedged request is still outstanding.  Wait on it before failing over */
+        return;
+    }
+
     /* Move to the next healhy endpoint and invoke */
     bool healthyEpExists = moveToNextHealthyEndpoint_();
     if (!healthyEpExists) {
@@ -685,6 +829,36 @@ void FailoverSvcRequest::handleResponse(boost::shared_ptr<fpi::AsyncHdr>& header
     }
 
     epReqs_[curEpIdx_]->invokeWork_();
+    if (hedgeTimer_ && curEpIdx_ + 1 < epReqs_.size()) {
+        scheduleHedge_();
+    }
+}
+
+/**
+* @brief Sends the request to the next healthy endpoint while the endpoints already
+* tried are still outstanding.  Whichever responds first with success completes the
+* request.  Hedges are bounded by the hedge budget.
+* NOTE this function is exectued on SvcMgr::taskExecutor_ for synchronization
+*/
+void FailoverSvcRequest::hedge()
+{
+    if (isComplete() || curEpIdx_ + 1 >= epReqs_.size()) {
+        return;
+    }
+
+    auto svcMgr = MODULEPROVIDER()->getSvcMgr();
+    if (!svcMgr->getSvcRequestMgr()->getEndpointLatencyTracker()->tryAcquireHedge()) {
+        svcMgr->getSvcRequestCntrs()->hedgedenied.incr();
+        return;
+    }
+
+    if (!moveToNextHealthyEndpoint_()) {
+        /* No healthy endpoint to hedge to.  Keep waiting on outstanding ones */
+        return;
+    }
+    DBG(GLOGDEBUG << logString() << " Hedging to: " << epReqs_[curEpIdx_]->peerEpId_.svc_uuid);
+    svcMgr->getSvcRequestCntrs()->hedged.incr();
+    epReqs_[curEpIdx_]->invokeWork_();
 }
 
 /**
@@ -728,7 +902,7 @@ bool FailoverSvcRequest::moveToNextHealthyEndpoint_()
         #endif
 
         if (epStatus == ERR_OK) {
-            epReqs_[curEpIdx_]->setPayloadBuf(msgTypeId_, payloadBuf_);
+            epReqs_[curEpIdx_]->setMsgPayload(msgTypeId_, payload_);
             epReqs_[curEpIdx_]->setTimeoutMs(timeoutMs_);
             DBG(GLOGDEBUG << logString() << " Healthy endpoint: "
                 << epReqs_[curEpIdx_]->peerEpId_.svc_uuid << " idx: " << curEpIdx_);
@@ -757,6 +931,24 @@ bool FailoverSvcRequest::moveToNextHealthyEndpoint_()
     return false;
 }
 
+/**
+* @brief Returns index of endpoint with peerEpId among the endpoints the request has
+* been sent to.  Without hedging this is only the current endpoint.
+* @return -1 if the request wasn't sent to peerEpId
+*/
+int32_t FailoverSvcRequest::getInFlightEpIdx_(const fpi::SvcUuid &peerEpId) const
+{
+    for (int32_t i = curEpIdx_; i >= 0; i--) {
+        if (epReqs_[i]->peerEpId_ == peerEpId) {
+            return i;
+        }
+        if (!hedgeTimer_) {
+            break;
+        }
+    }
+    return -1;
+}
+
 /**
 * @brief
 *
@@ -769,7 +961,7 @@ void FailoverSvcRequest::onResponseCb(FailoverSvcRequestRespCb cb)
 
 fpi::SvcUuid FailoverSvcRequest::getLastRespondedSvcUuid() const
 {
-    return epReqs_[curEpIdx_]->peerEpId_;
+    return epReqs_[lastRespEpIdx_]->peerEpId_;
 }
 
 /**
@@ -859,7 +1051,7 @@ void QuorumSvcRequest::invoke() {
 void QuorumSvcRequest::invokeWork_()
 {
     for (auto &ep : epReqs_) {
-        ep->setPayloadBuf(msgTypeId_, payloadBuf_);
+        ep->setMsgPayload(msgTypeId_, payload_);
         ep->setTimeoutMs(timeoutMs_);
         ep->invokeWork_();
     }
@@ -998,7 +1190,7 @@ std::string MultiPrimarySvcRequest::logString()
 void MultiPrimarySvcRequest::invokeWork_()
 {
     for (auto &ep : epReqs_) {
-        ep->setPayloadBuf(msgTypeId_, payloadBuf_);
+        ep->setMsgPayload(msgTypeId_, payload_);
         ep->setTimeoutMs(timeoutMs_);
         ep->invokeWork_();
     }
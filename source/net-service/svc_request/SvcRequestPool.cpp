@@ -1,5 +1,6 @@
 /* Copyright 2014 Formation Data Systems, Inc.
  */
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <functional>
@@ -23,6 +24,9 @@ SvcRequestPool *gSvcRequestPool;
 
 SvcRequestId SvcRequestPool::SVC_UNTRACKED_REQ_ID = 0;
 
+/* Granularity at which hedges fire */
+static const uint32_t HEDGE_TIMER_RESOLUTION_MS = 1;
+
 template<typename T>
 T SvcRequestPool::get_config(std::string const& option)
 { return MODULEPROVIDER()->get_fds_config()->get<T>(option); }
@@ -33,7 +37,8 @@ T SvcRequestPool::get_config(std::string const& option)
 SvcRequestPool::SvcRequestPool(CommonModuleProviderIf *moduleProvider,
                                const fpi::SvcUuid &selfUuid,
                                PlatNetSvcHandlerPtr handler)
-: HasModuleProvider(moduleProvider)
+: HasModuleProvider(moduleProvider),
+  reqIdAllocator_(0, CONFIG_UINT32("fds.pm.svc.req_id_range", 1))
 {
     svcRequestTracker_ = new SvcRequestTracker(MODULEPROVIDER());
     svcRequestCntrs_ = new SvcRequestCounters("SvcReq",
@@ -47,9 +52,9 @@ SvcRequestPool::SvcRequestPool(CommonModuleProviderIf *moduleProvider,
      * issued from previous incarnation of this serivce
      */
     RandNumGenerator rgen(RandNumGenerator::getRandSeed());
-    nextAsyncReqId_ = rgen.genNum();
-    nextAsyncReqId_ = getNextAsyncReqId_();
-    LOGNOTIFY << "Starting service request id at: " << nextAsyncReqId_;
+    reqIdAllocator_.reset(rgen.genNum());
+    LOGNOTIFY << "Starting service request id at: " << reqIdAllocator_.current()
+              << " id range per thread: " << reqIdAllocator_.getRangeSize();
 
     finishTrackingCb_ = std::bind(&SvcRequestTracker::popFromTracking,
             svcRequestTracker_, std::placeholders::_1);
@@ -62,6 +67,29 @@ SvcRequestPool::SvcRequestPool(CommonModuleProviderIf *moduleProvider,
         fiu_enable("svc.use.lftp", 1, NULL, 0);
     }
     reqTimeout_ = get_config<uint32_t>("fds.pm.svc.timeout.thrift_message");
+
+    auto config = MODULEPROVIDER()->get_fds_config();
+    HedgeConfig hedgeConfig;
+    hedgeConfig.enabled = config->get<bool>("fds.pm.svc.hedge.enable", false);
+    hedgeConfig.percentile = config->get<double>("fds.pm.svc.hedge.percentile",
+                                                 hedgeConfig.percentile);
+    hedgeConfig.minDelayMs = config->get<uint32_t>("fds.pm.svc.hedge.min_delay_ms",
+                                                   hedgeConfig.minDelayMs);
+    hedgeConfig.maxDelayMs = config->get<uint32_t>("fds.pm.svc.hedge.max_delay_ms",
+                                                   hedgeConfig.maxDelayMs);
+    hedgeConfig.budgetPct = config->get<uint32_t>("fds.pm.svc.hedge.budget_pct",
+                                                  hedgeConfig.budgetPct);
+    hedgeConfig.budgetBurst = config->get<uint32_t>("fds.pm.svc.hedge.budget_burst",
+                                                    hedgeConfig.budgetBurst);
+    hedgeConfig.minDelayMs = std::max(hedgeConfig.minDelayMs, HEDGE_TIMER_RESOLUTION_MS);
+    hedgeConfig.maxDelayMs = std::max(hedgeConfig.maxDelayMs, hedgeConfig.minDelayMs);
+    epLatencyTracker_.reset(new EndpointLatencyTracker(hedgeConfig));
+    if (hedgeConfig.enabled) {
+        hedgeTimer_.reset(new FdsTimer("hedge", HEDGE_TIMER_RESOLUTION_MS));
+        LOGNOTIFY << "Hedged reads enabled.  percentile: " << hedgeConfig.percentile
+            << " delay ms: [" << hedgeConfig.minDelayMs << ", " << hedgeConfig.maxDelayMs
+            << "] budget pct: " << hedgeConfig.budgetPct;
+    }
 }
 
 /**
@@ -69,7 +97,7 @@ SvcRequestPool::SvcRequestPool(CommonModuleProviderIf *moduleProvider,
  */
 SvcRequestPool::~SvcRequestPool()
 {
-    nextAsyncReqId_ = SVC_UNTRACKED_REQ_ID;
+    reqIdAllocator_.reset(SVC_UNTRACKED_REQ_ID);
     delete svcRequestTracker_;
     delete svcRequestCntrs_;
 }
@@ -294,6 +322,17 @@ SvcRequestTracker* SvcRequestPool::getSvcRequestTracker() const
 {
     return svcRequestTracker_;
 }
+
+EndpointLatencyTracker* SvcRequestPool::getEndpointLatencyTracker() const
+{
+    return epLatencyTracker_.get();
+}
+
+FdsTimer* SvcRequestPool::getHedgeTimer() const
+{
+    return hedgeTimer_.get();
+}
+
 void SvcRequestPool::setDltManager(DLTManagerPtr dltManager) {
     dltMgr = dltManager;
 }
@@ -25,10 +25,7 @@ bool SvcRequestTracker::addForTracking(const SvcRequestId& id,
 {
     DBG(GLOGDEBUG << req->logString());
 
-    fds_scoped_lock l(svcReqMaplock_);
-    auto pair = std::make_pair(id, req);
-    auto ret = svcReqMap_.insert(pair);
-    return ret.second;
+    return svcReqMap_.insert(id, req);
 }
 
 /**
@@ -40,14 +37,9 @@ SvcRequestTracker::popFromTracking(const SvcRequestId& id)
 {
     DBG(GLOGDEBUG << "Req Id: " << id);
 
-    fds_scoped_lock l(svcReqMaplock_);
-    auto itr = svcReqMap_.find(id);
-    if (itr != svcReqMap_.end()) {
-        auto r = itr->second;
-        svcReqMap_.erase(itr);
-        return r;
-    }
-    return nullptr;
+    SvcRequestIfPtr r;
+    svcReqMap_.erase(id, r);
+    return r;
 }
 
 /**
@@ -58,12 +50,9 @@ SvcRequestTracker::popFromTracking(const SvcRequestId& id)
 SvcRequestIfPtr
 SvcRequestTracker::getSvcRequest(const SvcRequestId& id)
 {
-    fds_scoped_lock l(svcReqMaplock_);
-    auto itr = svcReqMap_.find(id);
-    if (itr != svcReqMap_.end()) {
-        return itr->second;
-    }
-    return nullptr;
+    SvcRequestIfPtr r;
+    svcReqMap_.find(id, r);
+    return r;
 }
 
 /**
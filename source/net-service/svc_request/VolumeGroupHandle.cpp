@@ -1157,7 +1157,7 @@ void VolumeGroupBroadcastRequest::invokeWork_()
                     groupHandle_->getGroupId(),
                     r->version);
         auto &ep = epReqs_.back();
-        ep->setPayloadBuf(msgTypeId_, payloadBuf_);
+        ep->setMsgPayload(msgTypeId_, payload_);
         ep->setTimeoutMs(timeoutMs_);
         ep->invokeWork_();
     }
@@ -1226,17 +1226,74 @@ void VolumeGroupBroadcastRequest::handleResponse(SHPTR<fpi::AsyncHdr>& header,
 }
 
 void VolumeGroupFailoverRequest::invokeWork_()
+{
+    bool hedging = isHedging_() && groupHandle_->size() > 1;
+    if (hedging) {
+        MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->\
+            getEndpointLatencyTracker()->addHedgeEligibleRequest();
+    }
+
+    sendToNextReplica_();
+
+    if (hedging && epReqs_.size() < groupHandle_->size()) {
+        scheduleHedge_();
+    }
+}
+
+/**
+* @brief Replicas the request can still be sent to.  When not coordinator these are
+* availableReplicas_.  Otherwise functional replicas we haven't sent to yet.
+*/
+std::vector<VolumeReplicaHandle> VolumeGroupFailoverRequest::getUntriedReplicas_()
+{
+    if (availableReplicas_.size() > 0) {
+        fds_assert(!groupHandle_->isCoordinator_);
+        return availableReplicas_;
+    }
+
+    std::vector<VolumeReplicaHandle> replicas;
+    if (groupHandle_->isCoordinator_) {
+        for (const auto &r : groupHandle_->functionalReplicas_) {
+            if (!getEpReq_(r.svcUuid)) {
+                replicas.push_back(r);
+            }
+        }
+    }
+    return replicas;
+}
+
+void VolumeGroupFailoverRequest::sendToNextReplica_()
 {
     /* First try and get the next replica from availableReplicas_,
      * otherwise check with VolumeGroupHandle
      */
+    uint32_t idx = 0;
+    if (isHedging_()) {
+        /* Pick the replica with lowest observed latency */
+        auto replicas = getUntriedReplicas_();
+        std::vector<fpi::SvcUuid> svcUuids;
+        for (const auto &r : replicas) {
+            svcUuids.push_back(r.svcUuid);
+        }
+        idx = MODULEPROVIDER()->getSvcMgr()->getSvcRequestMgr()->\
+              getEndpointLatencyTracker()->pickFastest(svcUuids);
+    }
+
     if (availableReplicas_.size() > 0) {
         fds_assert(!groupHandle_->isCoordinator_);
-        addEndpoint(availableReplicas_.front().svcUuid,
+        addEndpoint(availableReplicas_[idx].svcUuid,
+                    groupHandle_->getDmtVersion(),
+                    groupHandle_->getGroupId(),
+                    availableReplicas_[idx].version);
+        availableReplicas_.erase(availableReplicas_.begin() + idx);
+    } else if (isHedging_()) {
+        fds_assert(groupHandle_->isCoordinator_);
+        auto replicas = getUntriedReplicas_();
+        fds_assert(idx < replicas.size());
+        addEndpoint(replicas[idx].svcUuid,
                     groupHandle_->getDmtVersion(),
                     groupHandle_->getGroupId(),
-                    availableReplicas_.front().version);
-        availableReplicas_.erase(availableReplicas_.begin());
+                    replicas[idx].version);
     } else {
         fds_assert(groupHandle_->isCoordinator_);
         auto replica = groupHandle_->getFunctionalReplicaHandle();
@@ -1247,11 +1304,30 @@ void VolumeGroupFailoverRequest::invokeWork_()
     }
 
     auto &ep = epReqs_.back();
-    ep->setPayloadBuf(msgTypeId_, payloadBuf_);
+    ep->setMsgPayload(msgTypeId_, payload_);
     ep->setTimeoutMs(timeoutMs_);
     ep->invokeWork_();
 }
 
+/**
+* @brief Sends the read to another replica while the ones already tried are still
+* outstanding.  First success completes the request.
+*/
+void VolumeGroupFailoverRequest::hedge()
+{
+    if (isComplete() || getUntriedReplicas_().size() == 0) {
+        return;
+    }
+
+    auto svcMgr = MODULEPROVIDER()->getSvcMgr();
+    if (!svcMgr->getSvcRequestMgr()->getEndpointLatencyTracker()->tryAcquireHedge()) {
+        svcMgr->getSvcRequestCntrs()->hedgedenied.incr();
+        return;
+    }
+    svcMgr->getSvcRequestCntrs()->hedged.incr();
+    sendToNextReplica_();
+}
+
 void VolumeGroupFailoverRequest::handleResponse(SHPTR<fpi::AsyncHdr>& header,
                                                   SHPTR<std::string>& payload)
 {
@@ -1269,6 +1345,9 @@ void VolumeGroupFailoverRequest::handleResponse(SHPTR<fpi::AsyncHdr>& header,
         GLOGWARN << fds::logString(*header) << " Already completed";
         return;
     }
+    if (isHedging_()) {
+        recordEpLatency_(epReq);
+    }
     epReq->completeReq(header->msg_code, header, payload);
 
     ++nAcked_;
@@ -1285,17 +1364,28 @@ void VolumeGroupFailoverRequest::handleResponse(SHPTR<fpi::AsyncHdr>& header,
     if (successAcks_.size() == 1) {
         /* Atleast one replica succeeded */
         fds_assert(groupHandle_->getFunctionalReplicasCnt() > 0);
+        if (hedgeTimer_ && epReq != epReqs_.front() && inFlightEpCnt_() > 0) {
+            /* Hedge beat the replica we went to first */
+            MODULEPROVIDER()->getSvcMgr()->getSvcRequestCntrs()->hedgewins.incr();
+        }
         responseCb_(header->msg_code, payload); 
         responseCb_ = 0;
         complete(ERR_OK);
+    } else if (inFlightEpCnt_() > 0) {
+        /* A hedged read is still outstanding.  Wait on it */
+        return;
     } else {
         /* We continue as long as we haven't tried against all replicas (NOTE: When not
          * coordinator i.e read only, all replicas are considered functional)
          */
-        if (nAcked_ < groupHandle_->size() &&
-            groupHandle_->getFunctionalReplicasCnt() > 0) {
+        if (epReqs_.size() < groupHandle_->size() &&
+            groupHandle_->getFunctionalReplicasCnt() > 0 &&
+            (!isHedging_() || getUntriedReplicas_().size() > 0)) {
             /* Try against another replica */
-            invokeWork_();
+            sendToNextReplica_();
+            if (hedgeTimer_ && getUntriedReplicas_().size() > 0) {
+                scheduleHedge_();
+            }
         } else {
             /* All replicas have failed..return error */
             responseCb_(header->msg_code, payload); 
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <cstring>
+
+#include <net/WorkloadCapture.h>
+#include <util/Log.h>
+
+namespace fds {
+
+WorkloadCapture&
+WorkloadCapture::instance() {
+    static WorkloadCapture capture;
+    return capture;
+}
+
+WorkloadCapture::~WorkloadCapture() {
+    stop();
+}
+
+Error
+WorkloadCapture::start(const std::string& path, bool withPayloads, int64_t svcUuid) {
+    std::lock_guard<std::mutex> g(lock_);
+    if (file_ != nullptr) {
+        LOGWARN << "Workload capture already running";
+        return ERR_INVALID;
+    }
+    file_ = fopen(path.c_str(), "w");
+    if (file_ == nullptr) {
+        LOGERROR << "Failed to open capture file: " << path << " errno: " << errno;
+        return ERR_DISK_WRITE_FAILED;
+    }
+
+    WorkloadCaptureHeader hdr {};
+    hdr.magic = WorkloadCaptureHeader::MAGIC;
+    hdr.version = WorkloadCaptureHeader::VERSION;
+    hdr.withPayloads = withPayloads ? 1 : 0;
+    hdr.startEpochUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    hdr.svcUuid = svcUuid;
+    buffered_.clear();
+    buffered_.emplace_back(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    bufferedBytes_ = sizeof(hdr);
+
+    withPayloads_ = withPayloads;
+    startTime_ = std::chrono::steady_clock::now();
+    stopping_ = false;
+    recorded_ = 0;
+    dropped_ = 0;
+    writer_.reset(new std::thread(&WorkloadCapture::writerLoop, this));
+    enabled_.store(true, std::memory_order_release);
+
+    LOGNORMAL << "Started workload capture to: " << path
+              << " payloads: " << withPayloads;
+    return ERR_OK;
+}
+
+void
+WorkloadCapture::stop() {
+    std::unique_ptr<std::thread> writer;
+    {
+        std::lock_guard<std::mutex> g(lock_);
+        if (writer_ == nullptr) {
+            return;
+        }
+        enabled_.store(false, std::memory_order_relaxed);
+        stopping_ = true;
+        writer = std::move(writer_);
+    }
+    cond_.notify_one();
+    /* The writer drains what is buffered before it exits */
+    writer->join();
+
+    std::lock_guard<std::mutex> g(lock_);
+    /* Already closed if a write failed */
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    LOGNORMAL << "Stopped workload capture recorded: " << recorded_
+              << " dropped: " << dropped_;
+}
+
+void
+WorkloadCapture::record(WorkloadRecord::Direction direction,
+                        const fpi::AsyncHdr& header,
+                        const StringPtr& payload) {
+    WorkloadRecord rec {};
+    rec.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime_).count();
+    rec.reqId = header.msg_src_id;
+    rec.srcUuid = header.msg_src_uuid.svc_uuid;
+    rec.dstUuid = header.msg_dst_uuid.svc_uuid;
+    rec.dltVersion = header.dlt_version;
+    rec.msgTypeId = header.msg_type_id;
+    rec.msgCode = header.msg_code;
+    rec.payloadSize = payload ? payload->size() : 0;
+    rec.direction = direction;
+
+    /* Pairs with start(), withPayloads_ is set before the capture is enabled */
+    if (!enabled_.load(std::memory_order_acquire)) {
+        return;
+    }
+    rec.storedSize = withPayloads_ ? rec.payloadSize : 0;
+    /* Copied before taking the lock, IO threads only contend for a push */
+    std::string chunk;
+    chunk.reserve(sizeof(rec) + rec.storedSize);
+    chunk.append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+    if (rec.storedSize > 0) {
+        chunk.append(*payload);
+    }
+
+    std::unique_lock<std::mutex> g(lock_);
+    if (!enabled_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (bufferedBytes_ + chunk.size() > MAX_BUFFERED) {
+        ++dropped_;
+        return;
+    }
+    bool wasEmpty = buffered_.empty();
+    bufferedBytes_ += chunk.size();
+    buffered_.push_back(std::move(chunk));
+    ++recorded_;
+    g.unlock();
+    if (wasEmpty) {
+        cond_.notify_one();
+    }
+}
+
+void
+WorkloadCapture::writerLoop() {
+    std::vector<std::string> out;
+    std::unique_lock<std::mutex> g(lock_);
+    while (true) {
+        cond_.wait(g, [this] { return stopping_ || !buffered_.empty(); });
+        if (buffered_.empty() && stopping_) {
+            break;
+        }
+        out.swap(buffered_);
+        bufferedBytes_ = 0;
+        FILE* file = file_;
+        g.unlock();
+
+        bool ok = true;
+        for (auto const& chunk : out) {
+            if (fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size()) {
+                ok = false;
+                break;
+            }
+        }
+        out.clear();
+        g.lock();
+
+        if (!ok) {
+            LOGERROR << "Workload capture write failed errno: " << errno
+                     << ", stopping the capture recorded: " << recorded_
+                     << " dropped: " << dropped_;
+            /* Close up here so the capture can be started again */
+            enabled_.store(false, std::memory_order_relaxed);
+            buffered_.clear();
+            bufferedBytes_ = 0;
+            fclose(file_);
+            file_ = nullptr;
+            if (writer_ != nullptr) {
+                writer_->detach();
+                writer_.reset();
+            }
+            return;
+        }
+    }
+    fflush(file_);
+}
+
+WorkloadCapture::Reader::~Reader() {
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+Error
+WorkloadCapture::Reader::open(const std::string& path) {
+    file_ = fopen(path.c_str(), "r");
+    if (file_ == nullptr) {
+        return ERR_NOT_FOUND;
+    }
+    if (fread(&header_, sizeof(header_), 1, file_) != 1 ||
+        header_.magic != WorkloadCaptureHeader::MAGIC ||
+        header_.version != WorkloadCaptureHeader::VERSION) {
+        return ERR_INVALID;
+    }
+    return ERR_OK;
+}
+
+bool
+WorkloadCapture::Reader::next(WorkloadRecord& rec, std::string& payload) {
+    if (file_ == nullptr || fread(&rec, sizeof(rec), 1, file_) != 1) {
+        return false;
+    }
+    payload.resize(rec.storedSize);
+    if (rec.storedSize > 0 && fread(&payload[0], rec.storedSize, 1, file_) != 1) {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace fds
@@ -5,6 +5,7 @@
 #ifndef SOURCE_STOR_MGR_INCLUDE_HYBRIDTIERCTRLR_H_
 #define SOURCE_STOR_MGR_INCLUDE_HYBRIDTIERCTRLR_H_
 
+#include <atomic>
 #include <set>
 #include <fds_types.h>
 #include <SmIo.h>
@@ -20,11 +21,19 @@ class fds_threadpool;
 class SmIoReqHandler;
 class FdsTimerTask;
 class fds_mutex;
+class RankEngine;
 typedef boost::shared_ptr<FdsTimerTask> FdsTimerTaskPtr;
 
 /**
 * @brief Class responsible for enforching hybrid tiering policy
 * NOTE: This implementation is valid for beta-2 timeframe.
+*
+* Every FREQUENCY seconds all token metadata is scanned and objects older than
+* FREQUENCY are moved from flash to disk.
+* When the rank engine tracks candidates (see RankEngine::getObjectsToDemote) objects
+* are additionally promoted/demoted every SKETCH_INTERVAL seconds from the candidates
+* the rank engine collected on the IO path, without scanning metadata.  The full scan
+* then only cleans up what the bounded candidate tracking missed.
 */
 struct HybridTierCtrlr {
     enum HTCState {
@@ -50,12 +59,31 @@ struct HybridTierCtrlr {
                      std::shared_ptr<leveldb::DB> db);
     void moveObjsToTierCb(const Error& e,
                           SmIoMoveObjsToTier *req);
+
+    /**
+    * @brief Rank engine to take promotion/demotion candidates from
+    * @param flashFullThreshold % used at which flash no longer takes promotions
+    */
+    void setRankEngine(boost::shared_ptr<RankEngine> rankEngine,
+                       uint32_t flashFullThreshold);
+    /**
+    * @brief Moves candidates collected by the rank engine between tiers
+    */
+    void runCandidateMoves();
+    void candidateMovesCb(const Error& e,
+                          SmIoMoveObjsToTier *req);
  protected:
     void initMoveTierRequest_();
     void scheduleNextRun_(uint32_t nextRunInSeconds);
+    void scheduleCandidateMoves_();
+    bool isFlashFull_();
+    SmIoMoveObjsToTier* newCandidateMoveRequest_(diskio::DataTier fromTier,
+                                                 diskio::DataTier toTier,
+                                                 fds_bool_t relocate);
 
     static uint32_t BATCH_SZ;
     static uint32_t FREQUENCY;
+    static uint32_t SKETCH_INTERVAL;
 
     fds_mutex hybridTierLock;
     bool featureEnabled;
@@ -72,6 +100,12 @@ struct HybridTierCtrlr {
     SmIoSnapshotObjectDB snapRequest_;
     SmIoMoveObjsToTier *moveTierRequest_;
     uint64_t hybridMoveTs_;
+
+    boost::shared_ptr<RankEngine> rankEngine_;
+    uint32_t flashFullThreshold_;
+    FdsTimerTaskPtr candidateMovesTask_;
+    /* Candidate move requests outstanding.  Next round is scheduled when it drops to 0 */
+    std::atomic<uint32_t> candidateMovesPending_;
 };
 } // namespace fds
 #endif  // SOURCE_STOR_MGR_INCLUDE_HYBRIDTIERCTRLR_H_
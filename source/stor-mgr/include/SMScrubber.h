@@ -0,0 +1,184 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_STOR_MGR_INCLUDE_SMSCRUBBER_H_
+#define SOURCE_STOR_MGR_INCLUDE_SMSCRUBBER_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fds_types.h>
+#include <fds_timer.h>
+#include <concurrency/Mutex.h>
+#include <persistent-layer/dm_io.h>
+#include <SmIo.h>
+#include <object-store/SmDiskMap.h>
+
+namespace fds {
+
+/* Forward declaration */
+class ObjectStore;
+
+/**
+ * @brief Background data scrubber.
+ *
+ * Continuously reads object data back from disk and checks it hashes to its
+ * object id, marking corrupted objects in metadata the same way the
+ * datapath does (see ObjectStore::scrubObjectData).  With it running,
+ * fds.sm.data_verify can be turned off.
+ *
+ * Every disk is scrubbed on its own, so disks are verified in parallel, one
+ * SM token at a time: the token's metadata is snapshotted, live objects on
+ * the disk are sorted by token file and offset and read back in that order,
+ * batchBytes per system task QoS request.  Objects next to each other in a
+ * token file (or apart by no more than maxGapBytes of dead data) are read
+ * as one extent, with one disk read.  Requests are charged for the bytes
+ * they read, so scrubbing yields to volume IO, and a disk never scrubs
+ * faster than maxBytesPerSec.
+ *
+ * The last token each disk finished is persisted, a restarted SM resumes
+ * the pass from there.  A disk starts its next pass passInterval after it
+ * finished the previous one.  Disks added while SM runs are scrubbed after
+ * the next restart.
+ */
+class SMScrubber {
+  public:
+    SMScrubber(SmIoReqHandler *storMgr,
+               ObjectStore *objStore,
+               SmDiskMap::ptr diskMap);
+    ~SMScrubber();
+
+    typedef std::unique_ptr<SMScrubber> unique_ptr;
+
+    /**
+     * Loads persisted progress and schedules every disk's next pass
+     */
+    void start();
+
+    /**
+     * Stops scrubbing once the requests in flight complete
+     */
+    void stop();
+
+    std::string logString() const;
+
+    struct ScrubObject {
+        ObjectID        objId;
+        obj_phy_loc_t   loc;
+        fds_uint32_t    size;
+    };
+
+    /* Objects [begin, end) read with one disk read of len bytes at objects[begin].loc */
+    struct ScrubExtent {
+        size_t          begin;
+        size_t          end;
+        fds_uint32_t    len;
+    };
+
+    /* Per disk progress, persisted */
+    struct ScrubProgress {
+        bool            passInProgress {false};
+        /* Last token the pass in progress finished, -1 if none */
+        fds_int64_t     lastToken {-1};
+        fds_uint64_t    lastPassEndSecs {0};
+        fds_uint64_t    passes {0};
+    };
+    typedef std::map<DiskId, ScrubProgress> ProgressMap;
+
+    /**
+     * Plans the next batch of objects (sorted by file and offset) from begin
+     * on: extents of objects at most maxGapBytes apart in the same file,
+     * until they read batchBytes.  A batch has at least one object.
+     * @return bytes the batch reads
+     */
+    static fds_uint64_t planBatch(const std::vector<ScrubObject> &objects,
+                                  size_t begin,
+                                  fds_uint64_t batchBytes,
+                                  fds_uint64_t maxGapBytes,
+                                  std::vector<ScrubExtent> &extents);
+
+    /**
+     * @return how long to wait before the next batch so that reading
+     * batchBytes in elapsedUs doesn't exceed maxBytesPerSec (0: no limit)
+     */
+    static fds_uint64_t pacingDelayUs(fds_uint64_t batchBytes,
+                                      fds_uint64_t elapsedUs,
+                                      fds_uint64_t maxBytesPerSec);
+
+    /**
+     * @return seconds until a disk starts (or resumes) its pass
+     */
+    static fds_uint64_t startDelaySecs(const ScrubProgress &progress,
+                                       fds_uint64_t passIntervalSecs,
+                                       fds_uint64_t nowSecs);
+
+    /**
+     * @return first token of tokens the pass still has to scrub
+     */
+    static SmTokenSet::const_iterator resumeToken(const SmTokenSet &tokens,
+                                                  const ScrubProgress &progress);
+
+    /* Malformed lines are skipped, a missing file leaves progress empty */
+    static void loadProgress(const std::string &path, ProgressMap &progress);
+    /* Writes and renames, so a crash leaves either the old or the new progress */
+    static bool saveProgress(const std::string &path, const ProgressMap &progress);
+
+  private:
+    struct DiskScrub {
+        DiskId                      diskId;
+        diskio::DataTier            tier;
+        ScrubProgress               progress;
+
+        /* Pass in progress */
+        SmTokenSet                  tokens;
+        SmTokenSet::const_iterator  curToken;
+        std::vector<ScrubObject>    objects;
+        size_t                      nextObject {0};
+        std::vector<ScrubExtent>    extents;
+        fds_uint64_t                batchStartUs {0};
+        fds_uint64_t                batchBytes {0};
+        SmIoSnapshotObjectDB        snapRequest;
+        FdsTimerTaskPtr             passTask;
+        FdsTimerTaskPtr             batchTask;
+
+        std::atomic<fds_uint64_t>   objectsVerified {0};
+        std::atomic<fds_uint64_t>   bytesVerified {0};
+        std::atomic<fds_uint64_t>   corruptions {0};
+        std::atomic<fds_uint64_t>   readErrors {0};
+    };
+
+    void startPass(DiskScrub *disk);
+    void scrubToken(DiskScrub *disk);
+    void snapTokenCb(DiskScrub *disk,
+                     const Error& err,
+                     leveldb::ReadOptions& options,
+                     std::shared_ptr<leveldb::DB> db);
+    void enqueueBatch(DiskScrub *disk);
+    void scrubBatch(DiskScrub *disk);
+    void batchDone(DiskScrub *disk);
+    void finishToken(DiskScrub *disk);
+    void finishPass(DiskScrub *disk);
+
+    /* Caller holds progressLock */
+    void saveProgress_();
+
+    SmIoReqHandler *storMgr_;
+    ObjectStore *objStore_;
+    SmDiskMap::ptr diskMap_;
+
+    bool enabled_;
+    fds_uint64_t maxBytesPerSec_;
+    fds_uint64_t batchBytes_;
+    fds_uint64_t maxGapBytes_;
+    fds_uint64_t passIntervalSecs_;
+    std::string progressPath_;
+
+    std::atomic<bool> stopping_;
+    mutable fds_mutex progressLock_;
+    std::map<DiskId, std::unique_ptr<DiskScrub>> disks_;
+};
+
+}  // namespace fds
+#endif  // SOURCE_STOR_MGR_INCLUDE_SMSCRUBBER_H_
@@ -4,6 +4,9 @@
 #ifndef SOURCE_STOR_MGR_INCLUDE_SMSVCHANDLER_H_
 #define SOURCE_STOR_MGR_INCLUDE_SMSVCHANDLER_H_
 
+#include <functional>
+#include <map>
+#include <vector>
 #include <fdsp/svc_types_types.h>
 #include <net/PlatNetSvcHandler.h>
 #include <fdsp/SMSvc.h>
@@ -16,6 +19,7 @@ struct CtrlNotifyDMTUpdate;
 namespace fds {
 
 /* Forward declarations */
+class SmIoReq;
 class SmIoGetObjectReq;
 class SmIoPutObjectReq;
 class SmIoDeleteObjectReq;
@@ -50,6 +54,8 @@ class SMSvcHandler : virtual public fpi::SMSvcIf, public PlatNetSvcHandler {
     DECL_ASYNC_HANDLER(genericCommand         , GenericCommandMsg);
     DECL_ASYNC_HANDLER(getObject              , GetObjectMsg);
     DECL_ASYNC_HANDLER(putObject              , PutObjectMsg);
+    DECL_ASYNC_HANDLER(getObjectBatch         , GetObjectBatchMsg);
+    DECL_ASYNC_HANDLER(putObjectBatch         , PutObjectBatchMsg);
     DECL_ASYNC_HANDLER(deleteObject           , DeleteObjectMsg);
     DECL_ASYNC_HANDLER(notifySvcChange        , NodeSvcInfo);
     DECL_ASYNC_HANDLER(NotifyAddVol           , CtrlNotifyVolAdd);
@@ -107,6 +113,22 @@ class SMSvcHandler : virtual public fpi::SMSvcIf, public PlatNetSvcHandler {
                                Error &err);
     void initiateFirstRoundCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
                               const Error &err);
+
+  protected:
+    SmIoGetObjectReq* newGetObjectReq_(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                                       boost::shared_ptr<fpi::GetObjectMsg>& getObjMsg);
+    SmIoPutObjectReq* newPutObjectReq_(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                                       boost::shared_ptr<fpi::PutObjectMsg>& putObjMsg);
+    /**
+    * @brief True if the sender used a DLT older than our closed DLT
+    */
+    bool isDltVersionStale_(const fpi::AsyncHdr& asyncHdr);
+    /**
+    * @brief Enqueues batched requests one QoS enqueue per volume.  failCb is
+    * called for every request that couldn't be enqueued.
+    */
+    void enqueueBatch_(std::map<fds_volid_t, std::vector<SmIoReq*>>& volReqs,
+                       std::function<void (SmIoReq*, const Error&)> failCb);
 };
 
 }  // namespace fds
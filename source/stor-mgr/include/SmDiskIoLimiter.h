@@ -0,0 +1,145 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_STOR_MGR_INCLUDE_SMDISKIOLIMITER_H_
+#define SOURCE_STOR_MGR_INCLUDE_SMDISKIOLIMITER_H_
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fds_error.h>
+#include <fds_types.h>
+#include <persistent-layer/dm_io.h>
+#include <SmTypes.h>
+
+namespace fds {
+
+class SmIoReq;
+
+/**
+ * @brief Per disk limit on IOs outstanding in SM, adapted to disk latency.
+ *
+ * Every disk has a window of IOs that may be outstanding on it.  An IO
+ * submitted for a disk whose window is full is held until an IO on that disk
+ * completes, so a slow disk backs up only the IOs that target it.
+ *
+ * The window follows a gradient controller (in the spirit of TCP Vegas): it
+ * is scaled by minRtt / smoothedRtt, which drops below 1 as IOs start to
+ * queue in the disk, and grows by sqrt(window) of allowed queueing.  A disk
+ * that keeps its latency as load increases (SSD) opens up to maxWindow, one
+ * whose latency grows with the queue (HDD) settles near the depth it can
+ * actually serve.
+ *
+ * minRtt can't be learnt while the disk is kept busy, every IO then includes
+ * queueing.  So every MIN_RTT_PROBE_INTERVAL_US a disk briefly drops to
+ * minWindow and takes the fastest of PROBE_SAMPLES IOs issued meanwhile as
+ * its new minRtt, which lets the baseline follow the disk as it fills up or
+ * ages.
+ *
+ * IOs the limiter fails to issue, or still holds when it is shut down, are
+ * handed to the fail callback, which must answer them.
+ */
+class SmDiskIoLimiter {
+  public:
+    using IssueFn = std::function<Error(SmIoReq*)>;
+    using FailFn = std::function<void(SmIoReq*, const Error&)>;
+
+    static const fds_uint64_t MIN_RTT_PROBE_INTERVAL_US = 10 * 1000 * 1000;
+    static const fds_uint32_t PROBE_SAMPLES = 4;
+
+    /**
+     * @param issue called with an IO once the window of its disk lets it
+     * through; may run on the thread completing an earlier IO
+     * @param fail called with an IO that was not issued and the error to
+     * answer it with; the IO no longer counts against its disk's window
+     */
+    SmDiskIoLimiter(IssueFn issue,
+                    FailFn fail,
+                    fds_uint32_t minWindow,
+                    fds_uint32_t maxWindow);
+    ~SmDiskIoLimiter();
+
+    /**
+     * Issues io now if diskId has room in its window, otherwise holds it.
+     * Fails io if the limiter is shut down.
+     */
+    void submit(SmIoReq* io, DiskId diskId, diskio::DataTier tier);
+
+    /**
+     * io finished on its disk.  Adapts the disk's window to the latency of
+     * io and issues the held IOs the window now lets through.  IOs that were
+     * not submitted through the limiter are ignored.
+     */
+    void complete(SmIoReq* io);
+
+    /**
+     * Same as complete(io) with the latency measured by the caller
+     */
+    void complete(SmIoReq* io, fds_uint64_t latencyUs);
+
+    /**
+     * Number of IOs worth letting out of QoS queues: each disk's window on
+     * the disk and as many again held for it.  Holding more than that would
+     * only move the backlog from fair QoS queues into per disk FIFOs, and
+     * fewer would leave a busy disk idle between a completion and the next
+     * dispatch.
+     */
+    fds_uint32_t outstandingLimit() const;
+
+    /**
+     * Fails all held IOs with err and every IO submitted from now on.
+     * IOs already issued complete as usual.
+     */
+    void shutdown(const Error& err);
+
+    fds_uint32_t getWindow(DiskId diskId) const;
+    fds_uint32_t getInflight(DiskId diskId) const;
+    fds_uint32_t getHeld(DiskId diskId) const;
+
+    std::string toString() const;
+
+  private:
+    struct DiskWindow {
+        diskio::DataTier    tier;
+        double              limit;
+        fds_uint32_t        inflight {0};
+        double              smoothedRttUs {0};
+        double              minRttUs {0};
+        fds_uint32_t        samples {0};
+        /* Non-zero while re-learning minRtt */
+        fds_uint64_t        probeStartUs {0};
+        fds_uint64_t        lastProbeUs {0};
+        fds_uint32_t        probeSamples {0};
+        double              probeMinRttUs {0};
+        std::deque<SmIoReq*> held;
+    };
+
+    DiskWindow& window(DiskId diskId, diskio::DataTier tier);
+    /** IOs disk may have outstanding right now */
+    fds_uint32_t effectiveWindow(const DiskWindow& disk) const;
+    void adapt(DiskWindow& disk, fds_uint64_t latencyUs);
+    void probe(DiskWindow& disk, const SmIoReq* io, fds_uint64_t latencyUs, fds_uint64_t now);
+    /** Moves the held IOs disk's window lets through to ready */
+    void release(DiskWindow& disk, fds_uint64_t now, std::vector<SmIoReq*>& ready);
+    /** Issues ready, failing and replacing the IOs that don't issue */
+    void issueReady(std::vector<SmIoReq*> ready);
+
+    IssueFn issue;
+    FailFn fail;
+    fds_uint32_t minWindow;
+    fds_uint32_t maxWindow;
+
+    mutable std::mutex lock;
+    std::unordered_map<DiskId, DiskWindow> disks;
+    /* Set by shutdown() */
+    Error shutdownErr {ERR_OK};
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_STOR_MGR_INCLUDE_SMDISKIOLIMITER_H_
@@ -21,6 +21,7 @@
 #include <persistent-layer/dm_io.h>
 #include <SmTypes.h>
 #include <ObjMeta.h>
+#include <util/ObjectPool.h>
 
 using FDS_ProtocolInterface::FDSP_DeleteObjTypePtr;
 using FDS_ProtocolInterface::FDSP_GetObjTypePtr;
@@ -209,6 +210,11 @@ class SmIoReq : public FDS_IOType {
         return clientSvcId;
     }
 
+    /// Disk whose outstanding IO window this IO holds a slot of, and when
+    /// it was issued to it (see SmDiskIoLimiter)
+    DiskId limiterDiskId {SM_INVALID_DISK_ID};
+    fds_uint64_t diskIssueTs {0};
+
     virtual std::string log_string() {
         // TODO(Rao): Fill it up
         std::stringstream ret;
@@ -224,7 +230,7 @@ class SmIoReqHandler {
     virtual Error enqueueMsg(fds_volid_t volId, SmIoReq* ioReq) = 0;
 };  // class SmIoReqHandler
 
-class SmIoAddObjRefReq : public SmIoReq {
+class SmIoAddObjRefReq : public SmIoReq, public PooledObject<SmIoAddObjRefReq> {
   public:
     typedef std::function<void (const Error&, SmIoAddObjRefReq * resp)> CbType;
     virtual std::string log_string() override;
@@ -269,7 +275,7 @@ class SmIoAddObjRefReq : public SmIoReq {
 /**
  * @brief For DEL object data
  */
-class SmIoDeleteObjectReq : public SmIoReq {
+class SmIoDeleteObjectReq : public SmIoReq, public PooledObject<SmIoDeleteObjectReq> {
   public:
     typedef std::function<void (const Error&, SmIoDeleteObjectReq *resp)> CbType;
     virtual std::string log_string() override;
@@ -304,7 +310,7 @@ class SmIoDeleteObjectReq : public SmIoReq {
 /**
  * @brief For PUT object data
  */
-class SmIoPutObjectReq : public SmIoReq {
+class SmIoPutObjectReq : public SmIoReq, public PooledObject<SmIoPutObjectReq> {
  public:
     typedef std::function<void (const Error&, SmIoPutObjectReq *resp)> CbType;
     virtual std::string log_string() override;
@@ -339,14 +345,14 @@ class SmIoPutObjectReq : public SmIoReq {
 /**
  * @brief For GET object data
  */
-class SmIoGetObjectReq : public SmIoReq {
+class SmIoGetObjectReq : public SmIoReq, public PooledObject<SmIoGetObjectReq> {
  public:
     typedef std::function<void (const Error&, SmIoGetObjectReq *resp)> CbType;
     virtual std::string log_string() override;
 
     explicit SmIoGetObjectReq(boost::shared_ptr<fpi::GetObjectMsg> &msg)
             : getObjectNetReq(msg) {
-        getObjectNetResp = boost::make_shared<fpi::GetObjectResp>();
+        getObjectNetResp = makePooledShared<fpi::GetObjectResp>();
     }
 
     /* In/out: In is object id, out is object data */
@@ -44,7 +44,8 @@ enum sm_task_type {
     token_compactor,
     migration,
     tiering,
-    disk_change
+    disk_change,
+    scrubber
 };
 
 }  // namespace fds
@@ -10,6 +10,7 @@
 #include <queue>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "fdsp/FDSP_types.h"
 #include "fdsp/health_monitoring_types_types.h"
@@ -28,6 +29,7 @@
 #include "fds_config.hpp"
 #include "util/timeutils.h"
 #include "lib/StatsCollector.h"
+#include "SmDiskIoLimiter.h"
 
 /*
  * TODO: Move this header out of lib/
@@ -94,6 +96,10 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
      fds_uint32_t totalRate;
      fds_uint32_t qosThrds;
      fds_uint32_t qosOutNum;
+     /// Per disk outstanding IO windows adapted to disk latency
+     bool adaptiveDiskWindow {false};
+     fds_uint32_t minDiskWindow {1};
+     fds_uint32_t maxDiskWindow {32};
 
      // true if running SM standalone (for testing)
      fds_bool_t testStandalone;
@@ -122,6 +128,19 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
          /// executor.
          std::unique_ptr<SynchronizedTaskExecutor<size_t>> serialExecutor;
 
+         /// Holds object IOs for disks whose outstanding window is full
+         std::unique_ptr<SmDiskIoLimiter> diskLimiter;
+         std::atomic<fds_uint64_t> diskLimiterLogCounter {0};
+
+         /// Hands io to the thread pool
+         Error issueIO(SmIoReq* io);
+         /// Answers an object io the disk windows did not issue with err
+         void failIO(SmIoReq* io, const Error& err);
+         /// Frees io's slot in its disk window
+         void diskIODone(FDS_IOType& _io);
+         /// Matches the dispatcher's outstanding IOs to the disk windows
+         void updateOutstandingLimit();
+
         public:
          SmQosCtrl(ObjectStorMgr *_parent,
                    uint32_t _max_thrds,
@@ -143,11 +162,20 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
                                                    parentSm->qosOutNum,
                                                    false,
                                                    log);
+                 dispatcher->loadCostModel("fds.sm.qos.");
                  // dispatcher = new QoSHTBDispatcher(this, log, 150);
 
                  serialExecutor = std::unique_ptr<SynchronizedTaskExecutor<size_t>>(
                      new SynchronizedTaskExecutor<size_t>(*threadPool));
 
+                 if (parentSm->adaptiveDiskWindow) {
+                     diskLimiter.reset(new SmDiskIoLimiter(
+                         [this](SmIoReq* io) { return issueIO(io); },
+                         [this](SmIoReq* io, const Error& err) { failIO(io, err); },
+                         parentSm->minDiskWindow,
+                         parentSm->maxDiskWindow));
+                 }
+
                  if (parentSm->modProvider_->get_cntrs_mgr()) {
                      parentSm->modProvider_->get_cntrs_mgr()->add_for_export(this);
                  }
@@ -157,6 +185,9 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
                  parentSm->modProvider_->get_cntrs_mgr()->remove_from_export(this);
              }
 
+             if (diskLimiter) {
+                 diskLimiter->shutdown(ERR_SM_SHUTTING_DOWN);
+             }
              delete dispatcher;
              if (dispatcherThread) {
                  dispatcherThread->join();
@@ -167,6 +198,7 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
 
          Error markIODone(FDS_IOType& _io) {
              Error err(ERR_OK);
+             diskIODone(_io);
              dispatcher->markIODone(&_io);
              return err;
          }
@@ -175,6 +207,7 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
                           diskio::DataTier  tier,
                           fds_bool_t iam_primary = false) {
              Error err(ERR_OK);
+             diskIODone(_io);
              dispatcher->markIODone(&_io);
              if (iam_primary &&
                  (_io.io_type == FDS_SM_GET_OBJECT) &&
@@ -342,6 +375,14 @@ class ObjectStorMgr : public Module, public SmIoReqHandler {
      void storeCurrentDLT();
 
      virtual Error enqueueMsg(fds_volid_t volId, SmIoReq* ioReq) override;
+     /**
+      * Enqueues GET/PUT requests of one volume with a single QoS enqueue step.
+      * @param nEnqueued number of requests enqueued.  Requests from this index
+      * on were not enqueued and are still owned by the caller.
+      */
+     Error enqueueMsgs(fds_volid_t volId,
+                       const std::vector<SmIoReq*>& ioReqs,
+                       size_t& nEnqueued);
 
      /* Made virtual for google mock */
      TVIRTUAL const DLT* getDLT();
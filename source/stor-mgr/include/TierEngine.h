@@ -96,6 +96,17 @@ class TierEngine : public Module {
             const VolumeDesc& volDesc,
             diskio::DataTier tier);
 
+    /**
+    * Notifies the RankEngine that an object moved between tiers.
+    *
+    * @param objId[in] Object that was moved
+    * @param fromTier[in] The tier it moved from
+    * @param toTier[in] The tier it is on now
+    */
+    void notifyTierMove(const ObjectID& objId,
+                        diskio::DataTier fromTier,
+                        diskio::DataTier toTier);
+
     // FDS module methods
     int  mod_init(SysParams const *const param);
     void mod_startup();
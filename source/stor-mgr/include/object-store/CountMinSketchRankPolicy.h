@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_COUNTMINSKETCHRANKPOLICY_H_
+#define SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_COUNTMINSKETCHRANKPOLICY_H_
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include <fds_types.h>
+#include <concurrency/Mutex.h>
+#include <concurrency/RwLock.h>
+#include <util/FrequencySketch.h>
+#include <persistent-layer/dm_io.h>
+#include <object-store/RankEngine.h>
+#include <object-store/SmDiskMap.h>
+
+namespace fds {
+
+/**
+ * Configurable parameters of CountMinSketchRankPolicy
+ */
+struct SketchRankParams {
+    /* Counters per sketch row */
+    fds_uint32_t sketchWidth {1024 * 1024};
+    /* Estimated recent accesses for an object on HDD to become a promotion candidate */
+    fds_uint32_t promoteThreshold {4};
+    /* Flash resident objects with fewer estimated recent accesses get demoted */
+    fds_uint32_t demoteThreshold {2};
+    /* Objects stay on flash at least this long before they are considered for demotion */
+    fds_uint32_t minFlashResidencySecs {3600};
+    /* Bound on promotion candidates tracked per HDD */
+    fds_uint32_t maxPromoteCandidates {4096};
+    /* Bound on flash resident objects tracked per SSD */
+    fds_uint32_t maxFlashResident {256 * 1024};
+};
+
+/**
+ * Rank policy driven by an access frequency sketch that is updated on the IO path.
+ *
+ * Promotion: a GET served from HDD whose estimated frequency reaches promoteThreshold
+ * offers the object into a bounded per-disk candidate set that keeps the hottest
+ * objects.  getObjectsToPromote() drains the hottest candidates across disks.
+ *
+ * Demotion: objects written to flash, or copied there by a promotion
+ * (notifyTierMove), are queued per SSD in the order they arrived.
+ * getObjectsToDemote() looks at the oldest entries that have been on flash for
+ * at least minFlashResidencySecs: cold ones are handed out for demotion, hot
+ * ones go to the back of the queue (CLOCK style second chance).
+ *
+ * Neither requires scanning object metadata.  Tracking is bounded and in memory,
+ * so objects dropped from the bounds (or across restarts) are left to the periodic
+ * metadata scan of HybridTierCtrlr.
+ */
+class CountMinSketchRankPolicy : public RankEngine {
+  public:
+    CountMinSketchRankPolicy(const SmDiskMap::ptr& diskMap,
+                             const SketchRankParams& params);
+    ~CountMinSketchRankPolicy();
+
+    virtual void getObjectsToPromote(fds_uint32_t maxSize,
+                                     PromotionSet& oidSet) override;
+
+    virtual fds_bool_t getObjectsToDemote(fds_uint32_t maxSize,
+                                          PromotionSet& oidSet) override;
+
+    virtual fds_bool_t isObjectDemotable(const ObjectID& oid) override;
+
+    virtual fds_bool_t isObjectHot(const ObjectID& oid) override;
+
+    virtual void notifyTierMove(const ObjectID& oid,
+                                diskio::DataTier fromTier,
+                                diskio::DataTier toTier) override;
+
+    virtual void notifyDataPath(fds_io_op_t opType,
+                                const ObjectID& oid,
+                                diskio::DataTier tier) override;
+
+    /**
+     * Estimated number of recent accesses of oid
+     */
+    fds_uint32_t estimateFrequency(const ObjectID& oid) const;
+
+  private:
+    struct FlashEntry {
+        ObjectID            oid;
+        /* When the object got on flash (or was last found hot), in seconds */
+        fds_uint64_t        ts;
+    };
+
+    struct DiskCandidates {
+        fds_mutex                                           lock;
+        /* Promotion candidates (HDD) ordered by estimated frequency */
+        std::set<std::pair<fds_uint32_t, ObjectID>>         promoteRank;
+        std::unordered_map<ObjectID, fds_uint32_t, ObjectHash> promoteIndex;
+        /* Flash resident objects (SSD) in arrival order */
+        std::deque<FlashEntry>                              flashResident;
+    };
+
+    static inline uint64_t sketchKey(const ObjectID& oid) {
+        /* Object ids are content hashes, any slice is well distributed */
+        return ObjectHash()(oid);
+    }
+
+    DiskCandidates* getDiskCandidates(fds_uint16_t diskId);
+    void offerPromoteCandidate(const ObjectID& oid, fds_uint32_t freq);
+    void trackFlashResident(const ObjectID& oid);
+
+    SmDiskMap::ptr                                  diskMap;
+    SketchRankParams                                params;
+    FrequencySketch                                 sketch;
+
+    fds_rwlock                                      disksLock;
+    std::unordered_map<fds_uint16_t, std::unique_ptr<DiskCandidates>> disks;
+};
+
+}  // namespace fds
+#endif  // SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_COUNTMINSKETCHRANKPOLICY_H_
@@ -63,6 +63,16 @@ class LiveObjectsDB {
     Error setTokenStartTime(const fds_token_id &smToken, fds_uint16_t diskid,TimeStamp &ts);
     TimeStamp getTokenStartTime(const fds_token_id &smToken, fds_uint16_t diskid);
     bool hasNewObjectSets(const fds_token_id &smToken, fds_uint16_t diskid);
+
+    /**
+     * Live and reclaimable bytes of an SM token on a tier, see TokenSpaceStats.
+     * getTokenSpace returns ERR_NOT_FOUND if none were stored.
+     */
+    Error setTokenSpace(const fds_token_id &smToken, fds_uint16_t tier,
+                        fds_uint64_t liveBytes, fds_uint64_t reclaimBytes);
+    Error getTokenSpace(const fds_token_id &smToken, fds_uint16_t tier,
+                        fds_uint64_t &liveBytes, fds_uint64_t &reclaimBytes);
+    Error removeTokenSpace(const fds_token_id &smToken);
     void dropDB();
     ~LiveObjectsDB() { }
 };
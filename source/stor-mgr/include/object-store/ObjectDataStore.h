@@ -119,6 +119,18 @@ public:
                                                        Error &err,
                                                        diskio::DataTier *tier=nullptr);
 
+    /**
+     * Reads len bytes from a given location on a given tier, bypassing
+     * the cache, so callers see what is actually on disk.  objId is the
+     * object at loc; len may run past it into the objects after it in
+     * the same token file, to read them all with one disk read.
+     */
+    boost::shared_ptr<const std::string> readObjectDataFromDisk(const ObjectID &objId,
+                                                                diskio::DataTier tier,
+                                                                const obj_phy_loc_t& loc,
+                                                                fds_uint32_t len,
+                                                                Error &err);
+
     /**
      * Removes object from cache and notifies persistent layer
      * about that we deleted the object (to keep track of disk space
@@ -15,9 +15,11 @@
 #include <object-store/ObjectDataStore.h>
 #include <object-store/ObjectMetadataStore.h>
 #include <object-store/LiveObjectsDB.h>
+#include <object-store/TokenSpaceStats.h>
 #include <persistent-layer/dm_io.h>
 #include <utility>
 #include <SMCheckCtrl.h>
+#include <SMScrubber.h>
 #include <util/EventTracker.h>
 #include <util/bloomfilter.h>
 #include <util/always_call.h>
@@ -59,6 +61,9 @@ class ObjectStore : public Module, public boost::noncopyable {
   /// SM Checker
     SMCheckControl::unique_ptr SMCheckCtrl;
 
+    /// Background data scrubber
+    SMScrubber::unique_ptr scrubber;
+
     TokenLockFn tokenLockFn = { TokenLockFn() };
 
     enum ObjectStoreState {
@@ -161,6 +166,8 @@ class ObjectStore : public Module, public boost::noncopyable {
     typedef std::unique_ptr<ObjectStore> unique_ptr;
     typedef std::shared_ptr<ObjectStore> ptr;
     LiveObjectsDB::unique_ptr liveObjectsTable;
+    /// Live and reclaimable bytes per SM token, persisted in liveObjectsTable
+    TokenSpaceStats::unique_ptr tokenSpaceStats;
 
     /**
      * Returns the highest percentage of used capacity among all disks in non-all-SSD config.
@@ -289,6 +296,32 @@ class ObjectStore : public Module, public boost::noncopyable {
     Error verifyObjectData(const ObjectID& objId,
                            const fds_volid_t& volId = invalid_vol_id);
 
+    /**
+     * Reads len bytes from loc on disk, not from cache.  objId is the
+     * object at loc; len may cover the objects after it in the same token
+     * file, so they are read with one disk read.
+     */
+    boost::shared_ptr<const std::string> readDataExtent(const ObjectID& objId,
+                                                        diskio::DataTier tier,
+                                                        const obj_phy_loc_t& loc,
+                                                        fds_uint32_t len,
+                                                        Error& err);
+
+    /**
+     * Checks that data, objSize bytes read back from loc on disk, hashes
+     * to objId.  On mismatch the object is marked corrupted, unless its
+     * metadata no longer points at loc because GC or tiering moved it
+     * since the caller looked it up.
+     * @param data null if reading loc failed
+     * @return ERR_ONDISK_DATA_CORRUPT if the object is corrupted,
+     * ERR_DISK_READ_FAILED if data is null and the object is still at loc
+     */
+    Error scrubObjectData(const ObjectID& objId,
+                          diskio::DataTier tier,
+                          const obj_phy_loc_t& loc,
+                          const char* data,
+                          fds_uint32_t objSize);
+
     /**
      * Apply Object metadata/data from source SM
      * Object metadata and data may already exist, so may only
@@ -331,6 +364,17 @@ class ObjectStore : public Module, public boost::noncopyable {
      */
     fds_uint32_t getDiskCount() const;
 
+    /**
+     * Returns the disk an object IO of type opType mostly waits on, and
+     * its tier: the disk a PUT writes data to, the one holding the data a
+     * GET reads, the metadata disk for a DELETE.  SM_INVALID_DISK_ID if
+     * no disk owns the object's token.
+     */
+    DiskId getIoDiskId(fds_volid_t volId,
+                       const ObjectID& objId,
+                       fds_io_op_t opType,
+                       diskio::DataTier& tier) const;
+
     diskio::DataTier getMetadataTier();
 
     /**
@@ -417,6 +461,11 @@ class ObjectStore : public Module, public boost::noncopyable {
     Error SmCheckControlCmd(SmCheckCmd *checkCmd);
     void SmCheckUpdateDLT(const DLT *latestDLT);
 
+    /**
+     * Starts background data verification, if enabled
+     */
+    void startScrubber();
+
     /**
      * Sets this ObjectStore to the UNAVAILABLE state
      */
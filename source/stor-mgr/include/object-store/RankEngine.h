@@ -43,6 +43,43 @@ class RankEngine {
     */
     virtual fds_bool_t isObjectDemotable(const ObjectID& oid) = 0;
 
+    /**
+    * Calculate and return a set of flash resident objects that should be demoted.
+    *
+    * @param maxSize the maximum cardinality of the set to be returned.
+    * @param oidSet filled with as many ObjectIDs as possible.
+    *
+    * @returns false if the policy doesn't track demotion candidates, in which
+    * case the caller has to find them by scanning object metadata.
+    */
+    virtual fds_bool_t getObjectsToDemote(fds_uint32_t maxSize,
+                                          PromotionSet& oidSet) {
+        return false;
+    }
+
+    /**
+    * Determine if a particular object is hot enough to keep on flash.
+    * @param oid The ID of the object to check
+    *
+    * @returns True if the policy ranks the object hot.  Policies that don't
+    * track access frequency never do.
+    */
+    virtual fds_bool_t isObjectHot(const ObjectID& oid) {
+        return false;
+    }
+
+    /**
+    * Called after an object was moved (or copied) between tiers.
+    *
+    * @param oid The ID of the object that moved
+    * @param fromTier The tier it moved from
+    * @param toTier The tier it is on now
+    */
+    virtual void notifyTierMove(const ObjectID& oid,
+                                diskio::DataTier fromTier,
+                                diskio::DataTier toTier) {
+    }
+
     /**
     * Called on every IO to notify the rank policy of an IO. This method
     * should perform lightweight stats collection and tracking to enable
@@ -54,6 +91,8 @@ class RankEngine {
     */
     virtual void notifyDataPath(fds_io_op_t opType, const ObjectID& oid,
             diskio::DataTier tier) = 0;
+
+    virtual ~RankEngine() {}
 };
 }  // namespace fds
 #endif  // SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_RANKENGINE_H_
@@ -157,7 +157,8 @@ class DiskScavenger {
     /**
      * Re-builds tokenDb with a set of tokens we need to compact
      * Only includes those tokens whose percent of reclaimable space is
-     * >= token_reclaim_threshold
+     * >= token_reclaim_threshold, ordered so that tokens reclaiming the
+     * most space for the data they copy are compacted first
      */
     void findTokensToCompact(fds_uint32_t token_reclaim_threshold);
 
@@ -197,6 +198,11 @@ class DiskScavenger {
      * get it from the persistent layer
      */
     std::set<fds_token_id> tokenDb;
+    /**
+     * Tokens in tokenDb in the order we compact them, and index of
+     * the next one to compact
+     */
+    std::vector<fds_token_id> tokenOrder;
     fds_token_id next_token;
 
     /**
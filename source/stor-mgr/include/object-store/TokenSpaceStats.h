@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#ifndef SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_TOKENSPACESTATS_H_
+#define SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_TOKENSPACESTATS_H_
+
+#include <atomic>
+#include <memory>
+#include <fds_types.h>
+#include <concurrency/Mutex.h>
+#include <persistent-layer/dm_io.h>
+#include <SmTypes.h>
+
+namespace fds {
+
+class LiveObjectsDB;
+
+/**
+ * Live and reclaimable bytes in the data files of every SM token on every
+ * tier. Kept up to date as objects are written, expire or leave a tier, and
+ * as tokens get compacted, so that the scavenger can tell which tokens are
+ * worth compacting without walking their metadata.
+ *
+ * Counters are persisted in the live objects DB by flush(). Changes since
+ * the last flush are lost if SM goes down; compacting a token sets its
+ * counters from what is actually on disk again.
+ */
+class TokenSpaceStats {
+  public:
+    typedef std::unique_ptr<TokenSpaceStats> unique_ptr;
+
+    explicit TokenSpaceStats(LiveObjectsDB *db);
+
+    /**
+     * Loads the counters persisted by an earlier flush()
+     */
+    void load();
+
+    /**
+     * Persists the counters that changed since the last flush
+     */
+    void flush();
+
+    /**
+     * Object data was written to the token's file on the tier
+     */
+    void addLive(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes);
+
+    /**
+     * Object data in the token's file is not needed anymore, compaction
+     * would reclaim it
+     */
+    void addReclaimable(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes);
+
+    /**
+     * Object data counted as reclaimable is needed again (e.g. an expired
+     * object was put again before it was compacted away)
+     */
+    void reviveReclaimable(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes);
+
+    /**
+     * Token was compacted, its file on the tier holds liveBytes now
+     */
+    void setCompacted(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t liveBytes);
+
+    /**
+     * Sets the counters of a token that was not accounted for yet, e.g.
+     * data written before SM kept these counters or migrated from another SM
+     */
+    void setIfUnknown(fds_token_id smToken, diskio::DataTier tier,
+                      fds_uint64_t liveBytes, fds_uint64_t reclaimBytes);
+
+    /**
+     * SM does not own the token anymore
+     */
+    void removeToken(fds_token_id smToken);
+
+    /**
+     * @return false if the token's counters on the tier are not known
+     */
+    fds_bool_t get(fds_token_id smToken, diskio::DataTier tier,
+                   fds_uint64_t *liveBytes, fds_uint64_t *reclaimBytes) const;
+
+  private:
+    struct Counters {
+        std::atomic<fds_uint64_t> live {0};
+        std::atomic<fds_uint64_t> reclaim {0};
+        std::atomic<fds_bool_t> known {false};
+        std::atomic<fds_bool_t> dirty {false};
+    };
+    Counters* counters(fds_token_id smToken, diskio::DataTier tier);
+    static void subtract(std::atomic<fds_uint64_t> &counter, fds_uint64_t bytes);
+
+    LiveObjectsDB *db;
+    fds_mutex flushLock;
+    Counters tokens[SMTOKEN_COUNT][diskio::maxTier];
+};
+
+}  // namespace fds
+
+#endif  // SOURCE_STOR_MGR_INCLUDE_OBJECT_STORE_TOKENSPACESTATS_H_
@@ -2,11 +2,13 @@
  * Copyright 2015 Formation Data Systems, Inc.
  */
 #include <string>
+#include <vector>
 #include <fds_module_provider.h>
 #include <fds_timer.h>
 #include <concurrency/ThreadPool.h>
 #include <ObjMeta.h>
 #include <HybridTierCtrlr.h>
+#include <object-store/RankEngine.h>
 #include <concurrency/Mutex.h>
 #include <StorMgr.h>
 
@@ -14,6 +16,7 @@ namespace fds {
 
 uint32_t HybridTierCtrlr::BATCH_SZ = 1024;
 uint32_t HybridTierCtrlr::FREQUENCY = 10;
+uint32_t HybridTierCtrlr::SKETCH_INTERVAL = 60;
 
 // TODO(Rao):
 // -Handle unowned token case.
@@ -23,7 +26,9 @@ uint32_t HybridTierCtrlr::FREQUENCY = 10;
 HybridTierCtrlr::HybridTierCtrlr(SmIoReqHandler* storMgr,
                                  SmDiskMap::ptr diskMap)
     : featureEnabled(false),
-      hybridTierLock("HybridTierLock")
+      hybridTierLock("HybridTierLock"),
+      flashFullThreshold_(90),
+      candidateMovesPending_(0)
 {
     threadpool_ = MODULEPROVIDER()->proc_thrpool();
     storMgr_ = storMgr;
@@ -33,6 +38,8 @@ HybridTierCtrlr::HybridTierCtrlr(SmIoReqHandler* storMgr,
                        get<uint32_t>("fds.sm.tiering.hybrid.batchSz");
     FREQUENCY = MODULEPROVIDER()->get_fds_config()->\
                        get<uint32_t>("fds.sm.tiering.hybrid.frequency");
+    SKETCH_INTERVAL = MODULEPROVIDER()->get_fds_config()->\
+                       get<uint32_t>("fds.sm.tiering.hybrid.sketch.interval", 60);
 
     state_ = HTC_STOPPED;
     snapRequest_.io_type = FDS_SM_SNAPSHOT_TOKEN;
@@ -46,6 +53,18 @@ HybridTierCtrlr::HybridTierCtrlr(SmIoReqHandler* storMgr,
     runTask_.reset(
         new FdsTimerFunctionTask(
             std::bind(&HybridTierCtrlr::run, this)));
+    candidateMovesTask_.reset(
+        new FdsTimerFunctionTask(
+            std::bind(&HybridTierCtrlr::runCandidateMoves, this)));
+}
+
+void
+HybridTierCtrlr::setRankEngine(boost::shared_ptr<RankEngine> rankEngine,
+                               uint32_t flashFullThreshold)
+{
+    fds_mutex::scoped_lock l(hybridTierLock);
+    rankEngine_ = rankEngine;
+    flashFullThreshold_ = flashFullThreshold;
 }
 void
 HybridTierCtrlr::enableFeature()
@@ -86,6 +105,9 @@ void HybridTierCtrlr::start(bool manual)
         if (HTC_STOPPED == state_) {
             scheduleNextRun_(nextScheduleInSecs);
             GLOGNOTIFY << "Scheuduling Hybrid Tier Policy";
+            if (rankEngine_) {
+                scheduleCandidateMoves_();
+            }
         }
     }
 
@@ -99,6 +121,12 @@ void HybridTierCtrlr::scheduleNextRun_(uint32_t nextRunInSeconds)
         schedule(runTask_, std::chrono::seconds(nextRunInSeconds));
 }
 
+void HybridTierCtrlr::scheduleCandidateMoves_()
+{
+    MODULEPROVIDER()->getTimer()->\
+        schedule(candidateMovesTask_, std::chrono::seconds(SKETCH_INTERVAL));
+}
+
 void HybridTierCtrlr::run()
 {
     fds_assert(tokenSet_.empty() &&
@@ -209,9 +237,15 @@ void HybridTierCtrlr::constructTierMigrationList()
     for (; itr->Valid() && moveTierRequest_->oidList.size() < BATCH_SZ;
          itr->Next()) {
         omd.deserializeFrom(itr->value());
-        if (omd.onFlashTier() && omd.getCreationTime() < hybridMoveTs_) {
-            moveTierRequest_->oidList.push_back(ObjectID(itr->key().ToString()));
+        if (!omd.onFlashTier() || omd.getCreationTime() >= hybridMoveTs_) {
+            continue;
+        }
+        ObjectID oid(itr->key().ToString());
+        /* Old but still read a lot.  Leave it to the rank engine to demote once it cools */
+        if (rankEngine_ && rankEngine_->isObjectHot(oid)) {
+            continue;
         }
+        moveTierRequest_->oidList.push_back(oid);
     }
 
     /* Send message to move the objects */
@@ -265,4 +299,104 @@ void HybridTierCtrlr::initMoveTierRequest_()
                                                 std::placeholders::_1,
                                                 std::placeholders::_2);
 }
+
+void HybridTierCtrlr::runCandidateMoves()
+{
+    fds_assert(candidateMovesPending_ == 0);
+
+    PromotionSet demoteSet;
+    if (!rankEngine_->getObjectsToDemote(BATCH_SZ, demoteSet)) {
+        /* Rank engine doesn't track candidates.  Metadata scan does all the work */
+        GLOGNOTIFY << "Rank engine doesn't track tier candidates.  Stopping candidate moves";
+        return;
+    }
+
+    /* Promote only while flash has room, otherwise promotions would push flash
+     * into read only mode.  Demotions make the room.
+     */
+    PromotionSet promoteSet;
+    if (!isFlashFull_()) {
+        rankEngine_->getObjectsToPromote(BATCH_SZ, promoteSet);
+    }
+
+    GLOGDEBUG << "Candidate moves.  demote: " << demoteSet.size()
+              << " promote: " << promoteSet.size();
+
+    std::vector<SmIoMoveObjsToTier*> reqs;
+    if (demoteSet.size() > 0) {
+        /* Flash to disk is a metadata update, GC reclaims the flash space */
+        auto req = newCandidateMoveRequest_(diskio::flashTier, diskio::diskTier, true);
+        req->oidList.swap(demoteSet);
+        reqs.push_back(req);
+    }
+    if (promoteSet.size() > 0) {
+        /* Disk copy is left for GC as well */
+        auto req = newCandidateMoveRequest_(diskio::diskTier, diskio::flashTier, false);
+        req->oidList.swap(promoteSet);
+        reqs.push_back(req);
+    }
+
+    if (reqs.empty()) {
+        scheduleCandidateMoves_();
+        return;
+    }
+
+    candidateMovesPending_ = reqs.size();
+    for (auto req : reqs) {
+        Error err = storMgr_->enqueueMsg(FdsSysTaskQueueId, req);
+        if (!err.ok()) {
+            GLOGWARN << "Failed to enqueue candidate move request: err " << err;
+            candidateMovesCb(err, req);
+            delete req;
+        }
+    }
+}
+
+void HybridTierCtrlr::candidateMovesCb(const Error& e,
+                                       SmIoMoveObjsToTier *req)
+{
+    if (e != ERR_OK) {
+        LOGWARN << "Failed to move some candidate objects from tier: " << req->fromTier
+            << " to tier: " << req->toTier << " err: " << e;
+    } else {
+        LOGDEBUG << "Moved " << req->movedCnt << " candidate objects from tier: "
+            << req->fromTier << " to tier: " << req->toTier;
+    }
+
+    if (--candidateMovesPending_ == 0) {
+        scheduleCandidateMoves_();
+    }
+}
+
+bool HybridTierCtrlr::isFlashFull_()
+{
+    for (auto diskId : diskMap_->getDiskIds(diskio::flashTier)) {
+        auto capacity = diskMap_->getDiskConsumedSize(diskId);
+        if (capacity.totalCapacity == 0) {
+            continue;
+        }
+        if (capacity.usedCapacity * 100 / capacity.totalCapacity >= flashFullThreshold_) {
+            GLOGDEBUG << "Flash disk: " << diskId << " used: " << capacity.usedCapacity
+                << " total: " << capacity.totalCapacity << " is full. Skipping promotions";
+            return true;
+        }
+    }
+    return false;
+}
+
+SmIoMoveObjsToTier* HybridTierCtrlr::newCandidateMoveRequest_(diskio::DataTier fromTier,
+                                                              diskio::DataTier toTier,
+                                                              fds_bool_t relocate)
+{
+    auto req = new SmIoMoveObjsToTier();
+    req->io_type = FDS_SM_TIER_PROMOTE_OBJECTS;
+    req->fromTier = fromTier;
+    req->toTier = toTier;
+    req->relocate = relocate;
+    req->moveObjsRespCb = std::bind(&HybridTierCtrlr::candidateMovesCb,
+                                    this,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2);
+    return req;
+}
 }  // namespace fds
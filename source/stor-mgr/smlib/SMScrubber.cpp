@@ -0,0 +1,460 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <fds_module_provider.h>
+#include <fds_process.h>
+#include <util/timeutils.h>
+#include <ObjMeta.h>
+#include <object-store/ObjectStore.h>
+#include <SMScrubber.h>
+
+namespace fds {
+
+/* Delay before scrubbing starts, or retries after a token couldn't be snapped */
+static const fds_uint32_t SCRUB_DELAY_SECS = 60;
+
+SMScrubber::SMScrubber(SmIoReqHandler *storMgr,
+                       ObjectStore *objStore,
+                       SmDiskMap::ptr diskMap)
+    : storMgr_(storMgr),
+      objStore_(objStore),
+      diskMap_(diskMap),
+      stopping_(false),
+      progressLock_("Scrubber progress lock")
+{
+    auto conf = MODULEPROVIDER()->get_fds_config();
+    enabled_ = conf->get<bool>("fds.sm.data_verify_background", false);
+    maxBytesPerSec_ = conf->get<fds_uint64_t>("fds.sm.scrubber.max_mb_per_sec", 20) << 20;
+    batchBytes_ = std::max<fds_uint64_t>(
+        conf->get<fds_uint64_t>("fds.sm.scrubber.batch_kb", 4096) << 10, 1);
+    maxGapBytes_ = conf->get<fds_uint64_t>("fds.sm.scrubber.max_gap_kb", 64) << 10;
+    passIntervalSecs_ = conf->get<fds_uint64_t>("fds.sm.scrubber.pass_interval_hours", 24) * 3600;
+    progressPath_ = MODULEPROVIDER()->proc_fdsroot()->dir_user_repo() + "scrubber.progress";
+}
+
+SMScrubber::~SMScrubber()
+{
+}
+
+void
+SMScrubber::start()
+{
+    if (!enabled_ || !disks_.empty()) {
+        return;
+    }
+
+    for (auto diskId : diskMap_->getDiskIds()) {
+        std::unique_ptr<DiskScrub> disk(new DiskScrub());
+        disk->diskId = diskId;
+        disk->tier = diskMap_->diskMediaType(diskId);
+        disks_[diskId] = std::move(disk);
+    }
+    {
+        ProgressMap progress;
+        loadProgress(progressPath_, progress);
+        for (auto const &kv : progress) {
+            auto it = disks_.find(kv.first);
+            if (it != disks_.end()) {
+                it->second->progress = kv.second;
+            }
+        }
+    }
+
+    auto timer = MODULEPROVIDER()->getTimer();
+    fds_uint64_t now = util::getTimeStampSeconds();
+    for (auto &kv : disks_) {
+        DiskScrub *disk = kv.second.get();
+        disk->passTask.reset(
+            new FdsTimerFunctionTask(std::bind(&SMScrubber::startPass, this, disk)));
+        disk->batchTask.reset(
+            new FdsTimerFunctionTask(std::bind(&SMScrubber::enqueueBatch, this, disk)));
+        disk->snapRequest.io_type = FDS_SM_SNAPSHOT_TOKEN;
+        disk->snapRequest.smio_snap_resp_cb = std::bind(&SMScrubber::snapTokenCb,
+                                                        this,
+                                                        disk,
+                                                        std::placeholders::_1,
+                                                        std::placeholders::_3,
+                                                        std::placeholders::_4);
+
+        fds_uint64_t delaySecs = startDelaySecs(disk->progress, passIntervalSecs_, now);
+        LOGNOTIFY << "Scrubbing disk " << disk->diskId << " in " << delaySecs << " seconds"
+                  << (disk->progress.passInProgress ? ", resuming after token " : "")
+                  << (disk->progress.passInProgress ?
+                      std::to_string(disk->progress.lastToken) : "");
+        timer->schedule(disk->passTask, std::chrono::seconds(delaySecs));
+    }
+}
+
+void
+SMScrubber::stop()
+{
+    stopping_ = true;
+    auto timer = MODULEPROVIDER()->getTimer();
+    for (auto &kv : disks_) {
+        timer->cancel(kv.second->passTask);
+        timer->cancel(kv.second->batchTask);
+    }
+}
+
+void
+SMScrubber::startPass(DiskScrub *disk)
+{
+    if (stopping_) {
+        return;
+    }
+    {
+        fds_mutex::scoped_lock l(progressLock_);
+        if (!disk->progress.passInProgress) {
+            disk->progress.passInProgress = true;
+            disk->progress.lastToken = -1;
+            saveProgress_();
+        }
+    }
+
+    disk->tokens = diskMap_->getSmTokens(disk->diskId);
+    disk->curToken = resumeToken(disk->tokens, disk->progress);
+    LOGNOTIFY << "Scrubbing disk " << disk->diskId << ", "
+              << std::distance(disk->curToken, disk->tokens.end())
+              << " of " << disk->tokens.size() << " tokens left";
+    scrubToken(disk);
+}
+
+void
+SMScrubber::scrubToken(DiskScrub *disk)
+{
+    if (stopping_) {
+        return;
+    }
+    if (disk->curToken == disk->tokens.end()) {
+        finishPass(disk);
+        return;
+    }
+
+    disk->snapRequest.token_id = *disk->curToken;
+    Error err = storMgr_->enqueueMsg(FdsSysTaskQueueId, &disk->snapRequest);
+    if (!err.ok()) {
+        LOGWARN << "Failed to enqueue snapshot request for token " << *disk->curToken
+                << ", scrubbing disk " << disk->diskId << " later: " << err;
+        MODULEPROVIDER()->getTimer()->schedule(disk->passTask,
+                                               std::chrono::seconds(SCRUB_DELAY_SECS));
+    }
+}
+
+void
+SMScrubber::snapTokenCb(DiskScrub *disk,
+                        const Error& err,
+                        leveldb::ReadOptions& options,
+                        std::shared_ptr<leveldb::DB> db)
+{
+    if (!err.ok()) {
+        LOGWARN << "Failed to snap token " << *disk->curToken
+                << ", scrubbing disk " << disk->diskId << " later: " << err;
+        MODULEPROVIDER()->getTimer()->schedule(disk->passTask,
+                                               std::chrono::seconds(SCRUB_DELAY_SECS));
+        return;
+    }
+
+    /* Live objects whose data is on this disk */
+    ObjMetaData omd;
+    disk->objects.clear();
+    disk->nextObject = 0;
+    leveldb::Iterator *it = db->NewIterator(options);
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        omd.deserializeFrom(it->value());
+        if ((omd.getRefCnt() == 0UL) || omd.isObjCorrupted() || !omd.onTier(disk->tier)) {
+            continue;
+        }
+        const obj_phy_loc_t *loc = omd.getObjPhyLoc(disk->tier);
+        if (loc->obj_stor_loc_id != disk->diskId) {
+            continue;
+        }
+        disk->objects.push_back({ObjectID(it->key().ToString()), *loc,
+                                 static_cast<fds_uint32_t>(omd.getObjSize())});
+    }
+    delete it;
+    db->ReleaseSnapshot(options.snapshot);
+
+    /* Read the token files front to back */
+    std::sort(disk->objects.begin(), disk->objects.end(),
+              [](const ScrubObject &a, const ScrubObject &b) {
+                  return (a.loc.obj_file_id != b.loc.obj_file_id) ?
+                          (a.loc.obj_file_id < b.loc.obj_file_id) :
+                          (a.loc.obj_stor_offset < b.loc.obj_stor_offset);
+              });
+    LOGDEBUG << "Scrubbing " << disk->objects.size() << " objects of token "
+             << *disk->curToken << " on disk " << disk->diskId;
+    enqueueBatch(disk);
+}
+
+void
+SMScrubber::enqueueBatch(DiskScrub *disk)
+{
+    if (stopping_) {
+        return;
+    }
+    if (disk->nextObject >= disk->objects.size()) {
+        finishToken(disk);
+        return;
+    }
+
+    size_t begin = disk->nextObject;
+    fds_uint64_t bytes = planBatch(disk->objects, begin, batchBytes_, maxGapBytes_, disk->extents);
+    disk->nextObject = disk->extents.back().end;
+    disk->batchBytes = bytes;
+    disk->batchStartUs = util::getTimeStampMicros();
+
+    auto req = new SmIoGenericRequest(FdsSysTaskQueueId,
+                                      sm_task_type::scrubber,
+                                      std::bind(&SMScrubber::scrubBatch, this, disk),
+                                      std::bind(&SMScrubber::batchDone, this, disk));
+    /* Charged by size, so QoS makes scrubbing yield to volume IO */
+    req->io_size = bytes;
+    Error err = storMgr_->enqueueMsg(FdsSysTaskQueueId, req);
+    if (!err.ok()) {
+        LOGWARN << "Failed to enqueue scrub request for disk " << disk->diskId << ": " << err;
+        delete req;
+        disk->nextObject = begin;
+        MODULEPROVIDER()->getTimer()->schedule(disk->batchTask,
+                                               std::chrono::seconds(SCRUB_DELAY_SECS));
+    }
+}
+
+void
+SMScrubber::scrubBatch(DiskScrub *disk)
+{
+    fds_uint32_t shift = diskio::DataIO::disk_io_blk_shift();
+    for (auto const &extent : disk->extents) {
+        if (stopping_) {
+            break;
+        }
+        const ScrubObject &first = disk->objects[extent.begin];
+        Error readErr(ERR_OK);
+        boost::shared_ptr<const std::string> data =
+                objStore_->readDataExtent(first.objId, disk->tier, first.loc, extent.len, readErr);
+        fds_uint64_t extentStart = first.loc.obj_stor_offset << shift;
+
+        for (size_t i = extent.begin; i < extent.end; ++i) {
+            const ScrubObject &obj = disk->objects[i];
+            const char *objData = readErr.ok() ?
+                    data->data() + ((obj.loc.obj_stor_offset << shift) - extentStart) :
+                    nullptr;
+            Error err = objStore_->scrubObjectData(obj.objId, disk->tier, obj.loc,
+                                                   objData, obj.size);
+            if (err == ERR_ONDISK_DATA_CORRUPT) {
+                ++disk->corruptions;
+            } else if (!err.ok()) {
+                ++disk->readErrors;
+                continue;
+            }
+            ++disk->objectsVerified;
+            disk->bytesVerified += obj.size;
+        }
+    }
+}
+
+void
+SMScrubber::batchDone(DiskScrub *disk)
+{
+    if (stopping_) {
+        return;
+    }
+
+    /* Don't read the disk faster than maxBytesPerSec */
+    fds_uint64_t delayUs = pacingDelayUs(disk->batchBytes,
+                                         util::getTimeStampMicros() - disk->batchStartUs,
+                                         maxBytesPerSec_);
+    if (delayUs > 0) {
+        MODULEPROVIDER()->getTimer()->schedule(disk->batchTask,
+                                               std::chrono::microseconds(delayUs));
+        return;
+    }
+    enqueueBatch(disk);
+}
+
+void
+SMScrubber::finishToken(DiskScrub *disk)
+{
+    disk->objects.clear();
+    disk->extents.clear();
+    disk->nextObject = 0;
+    {
+        fds_mutex::scoped_lock l(progressLock_);
+        disk->progress.lastToken = *disk->curToken;
+        saveProgress_();
+    }
+    ++disk->curToken;
+    scrubToken(disk);
+}
+
+void
+SMScrubber::finishPass(DiskScrub *disk)
+{
+    {
+        fds_mutex::scoped_lock l(progressLock_);
+        disk->progress.passInProgress = false;
+        disk->progress.lastToken = -1;
+        disk->progress.lastPassEndSecs = util::getTimeStampSeconds();
+        ++disk->progress.passes;
+        saveProgress_();
+    }
+    LOGNOTIFY << "Finished scrubbing disk " << disk->diskId
+              << " objects verified " << disk->objectsVerified
+              << " bytes " << disk->bytesVerified
+              << " corrupted " << disk->corruptions
+              << " read errors " << disk->readErrors
+              << "; next pass in " << passIntervalSecs_ << " seconds";
+    MODULEPROVIDER()->getTimer()->schedule(disk->passTask,
+                                           std::chrono::seconds(passIntervalSecs_));
+}
+
+void
+SMScrubber::saveProgress_()
+{
+    ProgressMap progress;
+    for (auto const &kv : disks_) {
+        progress[kv.first] = kv.second->progress;
+    }
+    saveProgress(progressPath_, progress);
+}
+
+fds_uint64_t
+SMScrubber::planBatch(const std::vector<ScrubObject> &objects,
+                      size_t begin,
+                      fds_uint64_t batchBytes,
+                      fds_uint64_t maxGapBytes,
+                      std::vector<ScrubExtent> &extents)
+{
+    fds_uint32_t shift = diskio::DataIO::disk_io_blk_shift();
+    fds_uint64_t blkMask = diskio::DataIO::disk_io_blk_size() - 1;
+    fds_uint64_t bytes = 0;
+    fds_uint64_t extentStart = 0;
+    fds_uint64_t extentEnd = 0;
+    extents.clear();
+    for (size_t i = begin; (i < objects.size()) && (bytes < batchBytes); ++i) {
+        const ScrubObject &obj = objects[i];
+        fds_uint64_t start = static_cast<fds_uint64_t>(obj.loc.obj_stor_offset) << shift;
+        fds_uint64_t end = start + obj.size;
+        if (!extents.empty()) {
+            /* Grow the extent over the gap, when it's small enough.  Objects
+             * take whole blocks, padding up to the next one isn't a gap */
+            ScrubExtent &extent = extents.back();
+            fds_uint64_t paddedEnd = (extentEnd + blkMask) & ~blkMask;
+            if ((obj.loc.obj_file_id == objects[extent.begin].loc.obj_file_id) &&
+                (start >= paddedEnd) &&
+                (start - paddedEnd <= maxGapBytes) &&
+                (end - extentStart <= std::numeric_limits<fds_uint32_t>::max())) {
+                bytes += end - extentEnd;
+                extentEnd = end;
+                extent.end = i + 1;
+                extent.len = static_cast<fds_uint32_t>(end - extentStart);
+                continue;
+            }
+        }
+        extents.push_back({i, i + 1, obj.size});
+        extentStart = start;
+        extentEnd = end;
+        bytes += obj.size;
+    }
+    return bytes;
+}
+
+fds_uint64_t
+SMScrubber::pacingDelayUs(fds_uint64_t batchBytes,
+                          fds_uint64_t elapsedUs,
+                          fds_uint64_t maxBytesPerSec)
+{
+    if (maxBytesPerSec == 0) {
+        return 0;
+    }
+    fds_uint64_t minUs = batchBytes * 1000 * 1000 / maxBytesPerSec;
+    return (elapsedUs < minUs) ? (minUs - elapsedUs) : 0;
+}
+
+fds_uint64_t
+SMScrubber::startDelaySecs(const ScrubProgress &progress,
+                           fds_uint64_t passIntervalSecs,
+                           fds_uint64_t nowSecs)
+{
+    /* A pass that was interrupted resumes right away */
+    fds_uint64_t delaySecs = SCRUB_DELAY_SECS;
+    if (!progress.passInProgress && (progress.lastPassEndSecs + passIntervalSecs > nowSecs)) {
+        delaySecs = std::max<fds_uint64_t>(delaySecs,
+                                           progress.lastPassEndSecs + passIntervalSecs - nowSecs);
+    }
+    return delaySecs;
+}
+
+SmTokenSet::const_iterator
+SMScrubber::resumeToken(const SmTokenSet &tokens, const ScrubProgress &progress)
+{
+    if (!progress.passInProgress || (progress.lastToken < 0)) {
+        return tokens.begin();
+    }
+    return tokens.upper_bound(static_cast<fds_token_id>(progress.lastToken));
+}
+
+void
+SMScrubber::loadProgress(const std::string &path, ProgressMap &progress)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        DiskId diskId;
+        ScrubProgress disk;
+        if (!(fields >> diskId >> disk.passInProgress >> disk.lastToken
+                     >> disk.lastPassEndSecs >> disk.passes)) {
+            LOGWARN << "Ignoring malformed scrubber progress: " << line;
+            continue;
+        }
+        progress[diskId] = disk;
+    }
+}
+
+bool
+SMScrubber::saveProgress(const std::string &path, const ProgressMap &progress)
+{
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        for (auto const &kv : progress) {
+            const ScrubProgress &disk = kv.second;
+            out << kv.first << " " << disk.passInProgress << " " << disk.lastToken
+                << " " << disk.lastPassEndSecs << " " << disk.passes << "\n";
+        }
+        if (!out) {
+            LOGWARN << "Failed to write scrubber progress to " << tmpPath;
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOGWARN << "Failed to rename " << tmpPath << " to " << path;
+        return false;
+    }
+    return true;
+}
+
+std::string
+SMScrubber::logString() const
+{
+    std::stringstream ss;
+    fds_mutex::scoped_lock l(progressLock_);
+    for (auto const &kv : disks_) {
+        const DiskScrub *disk = kv.second.get();
+        ss << "disk " << disk->diskId
+           << " passes " << disk->progress.passes
+           << (disk->progress.passInProgress ? " scrubbing" : " idle")
+           << " verified " << disk->objectsVerified
+           << " corrupted " << disk->corruptions
+           << " read errors " << disk->readErrors << "; ";
+    }
+    return ss.str();
+}
+
+}  // namespace fds
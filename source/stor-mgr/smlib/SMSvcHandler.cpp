@@ -5,7 +5,9 @@
 #include <fdsp_utils.h>
 #include <fds_assert.h>
 #include <SMSvcHandler.h>
+#include <map>
 #include <string>
+#include <vector>
 #include <net/SvcMgr.h>
 #include <net/SvcRequest.h>
 #include <fiu-local.h>
@@ -34,6 +36,8 @@ SMSvcHandler::SMSvcHandler(CommonModuleProviderIf *provider)
     /* Data paths messages */
     REGISTER_FDSP_MSG_HANDLER(fpi::GetObjectMsg, getObject);
     REGISTER_FDSP_MSG_HANDLER(fpi::PutObjectMsg, putObject);
+    REGISTER_FDSP_MSG_HANDLER(fpi::GetObjectBatchMsg, getObjectBatch);
+    REGISTER_FDSP_MSG_HANDLER(fpi::PutObjectBatchMsg, putObjectBatch);
     REGISTER_FDSP_MSG_HANDLER(fpi::DeleteObjectMsg, deleteObject);
     REGISTER_FDSP_MSG_HANDLER(fpi::AddObjectRefMsg, addObjectRef);
 
@@ -531,26 +535,8 @@ void SMSvcHandler::getObject(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
 #endif
 
     Error err(ERR_OK);
-    ObjectID objId(getObjMsg->data_obj_id.digest);
-
-    auto getReq = new SmIoGetObjectReq(getObjMsg);
-    getReq->io_type = FDS_SM_GET_OBJECT;
-    fds_volid_t volId(getObjMsg->volume_id);
-    getReq->setVolId(volId);
-    getReq->setObjId(objId);
-    getReq->obj_data.obj_id = getObjMsg->data_obj_id;
-    // perf-trace related data
-    getReq->opReqFailedPerfEventType = PerfEventType::SM_GET_OBJ_REQ_ERR;
-    getReq->opReqLatencyCtx.type = PerfEventType::SM_E2E_GET_OBJ_REQ;
-    getReq->opReqLatencyCtx.reset_volid(volId);
-    getReq->opLatencyCtx.type = PerfEventType::SM_GET_IO;
-    getReq->opLatencyCtx.reset_volid(volId);
-    getReq->opQoSWaitCtx.type = PerfEventType::SM_GET_QOS_QUEUE_WAIT;
-    getReq->opQoSWaitCtx.reset_volid(volId);
-
-    // Set the client's ID to use to serialization
-    getReq->setClientSvcId(asyncHdr->msg_src_uuid);
 
+    auto getReq = newGetObjectReq_(asyncHdr, getObjMsg);
     getReq->response_cb = std::bind(&SMSvcHandler::getObjectCb,
                                     this,
                                     asyncHdr,
@@ -643,25 +629,7 @@ void SMSvcHandler::putObject(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
               return;);
 #endif
 
-    auto putReq = new SmIoPutObjectReq(putObjMsg);
-    putReq->io_type = FDS_SM_PUT_OBJECT;
-    putReq->setVolId(volId);
-    putReq->dltVersion = asyncHdr->dlt_version;
-    putReq->forwardedReq = putObjMsg->forwardedReq;
-    putReq->setObjId(objId);
-
-    // Set the client's ID to use to serialization
-    putReq->setClientSvcId(asyncHdr->msg_src_uuid);
-
-    // perf-trace related data
-    putReq->opReqFailedPerfEventType = PerfEventType::SM_PUT_OBJ_REQ_ERR;
-    putReq->opReqLatencyCtx.type = PerfEventType::SM_E2E_PUT_OBJ_REQ;
-    putReq->opReqLatencyCtx.reset_volid(volId);
-    putReq->opLatencyCtx.type = PerfEventType::SM_PUT_IO;
-    putReq->opLatencyCtx.reset_volid(volId);
-    putReq->opQoSWaitCtx.type = PerfEventType::SM_PUT_QOS_QUEUE_WAIT;
-    putReq->opQoSWaitCtx.reset_volid(volId);
-
+    auto putReq = newPutObjectReq_(asyncHdr, putObjMsg);
     putReq->response_cb= std::bind(&SMSvcHandler::putObjectCb,
                                    this,
                                    asyncHdr,
@@ -732,7 +700,8 @@ void SMSvcHandler::putObjectCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
         }
     }
 
-    auto resp = boost::make_shared<fpi::PutObjectRspMsg>();
+    // Only lives until it is serialized below, keep it off the heap
+    fpi::PutObjectRspMsg resp;
     asyncHdr->msg_code = static_cast<int32_t>(err.GetErrno());
 
     // Independent if error happend, check if this request matches
@@ -762,7 +731,7 @@ void SMSvcHandler::putObjectCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
         asyncHdr->msg_code = ERR_IO_DLT_MISMATCH;
     }
 
-    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::PutObjectRspMsg), *resp);
+    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::PutObjectRspMsg), resp);
 
     if ((objStorMgr->testUturnAll == true) ||
         (objStorMgr->testUturnPutObj == true)) {
@@ -773,6 +742,239 @@ void SMSvcHandler::putObjectCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
     delete putReq;
 }
 
+SmIoGetObjectReq*
+SMSvcHandler::newGetObjectReq_(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                               boost::shared_ptr<fpi::GetObjectMsg>& getObjMsg)
+{
+    ObjectID objId(getObjMsg->data_obj_id.digest);
+
+    auto getReq = new SmIoGetObjectReq(getObjMsg);
+    getReq->io_type = FDS_SM_GET_OBJECT;
+    fds_volid_t volId(getObjMsg->volume_id);
+    getReq->setVolId(volId);
+    getReq->setObjId(objId);
+    getReq->obj_data.obj_id = getObjMsg->data_obj_id;
+    // perf-trace related data
+    getReq->opReqFailedPerfEventType = PerfEventType::SM_GET_OBJ_REQ_ERR;
+    getReq->opReqLatencyCtx.type = PerfEventType::SM_E2E_GET_OBJ_REQ;
+    getReq->opReqLatencyCtx.reset_volid(volId);
+    getReq->opLatencyCtx.type = PerfEventType::SM_GET_IO;
+    getReq->opLatencyCtx.reset_volid(volId);
+    getReq->opQoSWaitCtx.type = PerfEventType::SM_GET_QOS_QUEUE_WAIT;
+    getReq->opQoSWaitCtx.reset_volid(volId);
+
+    // Set the client's ID to use to serialization
+    getReq->setClientSvcId(asyncHdr->msg_src_uuid);
+    return getReq;
+}
+
+SmIoPutObjectReq*
+SMSvcHandler::newPutObjectReq_(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                               boost::shared_ptr<fpi::PutObjectMsg>& putObjMsg)
+{
+    fds_volid_t volId(putObjMsg->volume_id);
+    ObjectID objId(putObjMsg->data_obj_id.digest);
+
+    auto putReq = new SmIoPutObjectReq(putObjMsg);
+    putReq->io_type = FDS_SM_PUT_OBJECT;
+    putReq->io_size = putObjMsg->data_obj.size();
+    putReq->setVolId(volId);
+    putReq->dltVersion = asyncHdr->dlt_version;
+    putReq->forwardedReq = putObjMsg->forwardedReq;
+    putReq->setObjId(objId);
+
+    // Set the client's ID to use to serialization
+    putReq->setClientSvcId(asyncHdr->msg_src_uuid);
+
+    // perf-trace related data
+    putReq->opReqFailedPerfEventType = PerfEventType::SM_PUT_OBJ_REQ_ERR;
+    putReq->opReqLatencyCtx.type = PerfEventType::SM_E2E_PUT_OBJ_REQ;
+    putReq->opReqLatencyCtx.reset_volid(volId);
+    putReq->opLatencyCtx.type = PerfEventType::SM_PUT_IO;
+    putReq->opLatencyCtx.reset_volid(volId);
+    putReq->opQoSWaitCtx.type = PerfEventType::SM_PUT_QOS_QUEUE_WAIT;
+    putReq->opQoSWaitCtx.reset_volid(volId);
+    return putReq;
+}
+
+/**
+ * Collects per object results of a batched GET/PUT.  The response is sent by
+ * whoever completes the last object.
+ */
+template <typename RspMsgT>
+struct SmBatchCtx {
+    SmBatchCtx(boost::shared_ptr<fpi::AsyncHdr>& hdr, size_t cnt)
+        : asyncHdr(hdr),
+          pending(cnt)
+    {
+        resp.statuses.resize(cnt, ERR_OK);
+    }
+
+    /* Returns true if this was the last object of the batch */
+    bool complete(size_t idx, const Error& err) {
+        resp.statuses[idx] = static_cast<int32_t>(err.GetErrno());
+        return (--pending == 0);
+    }
+
+    boost::shared_ptr<fpi::AsyncHdr> asyncHdr;
+    RspMsgT resp;
+    std::atomic<size_t> pending;
+};
+
+bool SMSvcHandler::isDltVersionStale_(const fpi::AsyncHdr& asyncHdr)
+{
+    // See getObjectCb()/putObjectCb() for why a closed newer DLT makes the
+    // sender's request suspect.
+    const DLT *curDlt = objStorMgr->getDLT();
+    return ((curDlt) &&
+            (curDlt->isClosed()) &&
+            (curDlt->getVersion() > (fds_uint64_t)asyncHdr.dlt_version));
+}
+
+void SMSvcHandler::enqueueBatch_(std::map<fds_volid_t, std::vector<SmIoReq*>>& volReqs,
+                                 std::function<void (SmIoReq*, const Error&)> failCb)
+{
+    for (auto &kv : volReqs) {
+        size_t nEnqueued = 0;
+        Error err = objStorMgr->enqueueMsgs(kv.first, kv.second, nEnqueued);
+        for (size_t i = nEnqueued; i < kv.second.size(); ++i) {
+            failCb(kv.second[i], err);
+        }
+    }
+}
+
+void SMSvcHandler::getObjectBatch(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                                  boost::shared_ptr<fpi::GetObjectBatchMsg>& batchMsg)
+{
+    DBG(GLOGDEBUG << fds::logString(*asyncHdr) << " objects: " << batchMsg->objects.size());
+
+    fiu_do_on("svc.drop.getobject", return);
+
+    auto cnt = batchMsg->objects.size();
+    auto ctx = std::make_shared<SmBatchCtx<fpi::GetObjectBatchRspMsg>>(asyncHdr, cnt);
+    ctx->resp.objects.resize(cnt);
+    if (cnt == 0) {
+        sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::GetObjectBatchRspMsg), ctx->resp);
+        return;
+    }
+
+    auto itemCb = [this, ctx](size_t idx, const Error& err, SmIoGetObjectReq* getReq) {
+        PerfTracer::tracePointEnd(getReq->opReqLatencyCtx);
+        if (!err.ok()) {
+            PerfTracer::incr(getReq->opReqFailedPerfEventType, getReq->getVolId());
+        } else {
+            ctx->resp.objects[idx] = std::move(*(getReq->getObjectNetResp));
+        }
+        delete getReq;
+
+        if (ctx->complete(idx, err)) {
+            ctx->asyncHdr->msg_code = ERR_OK;
+            if (isDltVersionStale_(*ctx->asyncHdr)) {
+                LOGDEBUG << "Returning DLT mismatch using version "
+                         << (fds_uint64_t)ctx->asyncHdr->dlt_version;
+                ctx->asyncHdr->msg_code = ERR_IO_DLT_MISMATCH;
+            }
+            sendAsyncResp(*ctx->asyncHdr, FDSP_MSG_TYPEID(fpi::GetObjectBatchRspMsg), ctx->resp);
+        }
+    };
+
+    std::map<fds_volid_t, std::vector<SmIoReq*>> volReqs;
+    for (size_t i = 0; i < cnt; ++i) {
+        /* Requests share the batch message rather than copying out each entry */
+        boost::shared_ptr<fpi::GetObjectMsg> getObjMsg(batchMsg, &batchMsg->objects[i]);
+        auto getReq = newGetObjectReq_(asyncHdr, getObjMsg);
+        getReq->response_cb = std::bind(itemCb, i, std::placeholders::_1, std::placeholders::_2);
+        PerfTracer::tracePointBegin(getReq->opReqLatencyCtx);
+        volReqs[getReq->getVolId()].push_back(getReq);
+    }
+
+    enqueueBatch_(volReqs, [](SmIoReq* ioReq, const Error& err) {
+        auto getReq = static_cast<SmIoGetObjectReq*>(ioReq);
+        getReq->response_cb(err, getReq);
+    });
+}
+
+void SMSvcHandler::putObjectBatch(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
+                                  boost::shared_ptr<fpi::PutObjectBatchMsg>& batchMsg)
+{
+    DBG(GLOGDEBUG << fds::logString(*asyncHdr) << " objects: " << batchMsg->objects.size());
+
+    fiu_do_on("svc.drop.putobject", return);
+
+    auto cnt = batchMsg->objects.size();
+    auto ctx = std::make_shared<SmBatchCtx<fpi::PutObjectBatchRspMsg>>(asyncHdr, cnt);
+    if ((cnt == 0) ||
+        (objStorMgr->testUturnAll == true) ||
+        (objStorMgr->testUturnPutObj == true)) {
+        asyncHdr->msg_code = ERR_OK;
+        sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::PutObjectBatchRspMsg), ctx->resp);
+        return;
+    }
+
+    auto sendResp = [this, ctx]() {
+        /* Status of the batch is the first failure, so quorum sees it */
+        ctx->asyncHdr->msg_code = ERR_OK;
+        for (auto status : ctx->resp.statuses) {
+            if (status != ERR_OK) {
+                ctx->asyncHdr->msg_code = status;
+                break;
+            }
+        }
+        if (isDltVersionStale_(*ctx->asyncHdr)) {
+            LOGCRITICAL << "Returning DLT mismatch using version "
+                        << (fds_uint64_t)ctx->asyncHdr->dlt_version;
+            ctx->asyncHdr->msg_code = ERR_IO_DLT_MISMATCH;
+        }
+        sendAsyncResp(*ctx->asyncHdr, FDSP_MSG_TYPEID(fpi::PutObjectBatchRspMsg), ctx->resp);
+    };
+
+    auto itemCb = [ctx, sendResp](size_t idx, const Error& err, SmIoPutObjectReq* putReq) {
+        PerfTracer::tracePointEnd(putReq->opReqLatencyCtx);
+        if (!err.ok()) {
+            PerfTracer::incr(putReq->opReqFailedPerfEventType, putReq->getVolId());
+        }
+        delete putReq;
+
+        if (ctx->complete(idx, err)) {
+            sendResp();
+        }
+    };
+
+    std::map<fds_volid_t, std::vector<SmIoReq*>> volReqs;
+    for (size_t i = 0; i < cnt; ++i) {
+        auto &putObjMsg = batchMsg->objects[i];
+        fds_volid_t volId(putObjMsg.volume_id);
+        ObjectID objId(putObjMsg.data_obj_id.digest);
+
+        Error err(ERR_OK);
+        if (!(objStorMgr->getVol(volId))) {
+            err = ERR_VOL_NOT_FOUND;
+        } else if (!putObjMsg.forwardedReq &&
+                   !objStorMgr->migrationMgr->isDltTokenReady(objId)) {
+            LOGDEBUG << "DLT token not ready, not going to do PUT for " << objId;
+            err = ERR_NOT_READY;
+        }
+        if (!err.ok()) {
+            if (ctx->complete(i, err)) {
+                sendResp();
+            }
+            continue;
+        }
+
+        /* Requests share the batch message rather than copying out each entry */
+        boost::shared_ptr<fpi::PutObjectMsg> putObjMsgPtr(batchMsg, &putObjMsg);
+        auto putReq = newPutObjectReq_(asyncHdr, putObjMsgPtr);
+        putReq->response_cb = std::bind(itemCb, i, std::placeholders::_1, std::placeholders::_2);
+        PerfTracer::tracePointBegin(putReq->opReqLatencyCtx);
+        volReqs[volId].push_back(putReq);
+    }
+
+    enqueueBatch_(volReqs, [](SmIoReq* ioReq, const Error& err) {
+        auto putReq = static_cast<SmIoPutObjectReq*>(ioReq);
+        putReq->response_cb(err, putReq);
+    });
+}
+
 void SMSvcHandler::deleteObject(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
                                 boost::shared_ptr<fpi::DeleteObjectMsg>& deleteObjMsg)
 {
@@ -854,7 +1056,7 @@ void SMSvcHandler::deleteObjectCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
         }
     }
 
-    auto resp = boost::make_shared<fpi::DeleteObjectRspMsg>();
+    fpi::DeleteObjectRspMsg resp;
     asyncHdr->msg_code = static_cast<int32_t>(err.GetErrno());
 
     // Independent if error happend, check if this request matches
@@ -884,7 +1086,7 @@ void SMSvcHandler::deleteObjectCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
         asyncHdr->msg_code = ERR_IO_DLT_MISMATCH;
     }
 
-    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::DeleteObjectRspMsg), *resp);
+    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::DeleteObjectRspMsg), resp);
 
     if (del_req) {
         delete del_req;
@@ -1104,7 +1306,7 @@ void SMSvcHandler::addObjectRefCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
                          addObjRefReq->getVolId());
     }
 
-    auto resp = boost::make_shared<fpi::AddObjectRefRspMsg>();
+    fpi::AddObjectRefRspMsg resp;
     asyncHdr->msg_code = static_cast<int32_t>(err.GetErrno());
 
     // Independent of error happend, check if this request matches
@@ -1134,7 +1336,7 @@ void SMSvcHandler::addObjectRefCb(boost::shared_ptr<fpi::AsyncHdr>& asyncHdr,
         asyncHdr->msg_code = ERR_IO_DLT_MISMATCH;
     }
 
-    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::AddObjectRefRspMsg), *resp);
+    sendAsyncResp(*asyncHdr, FDSP_MSG_TYPEID(fpi::AddObjectRefRspMsg), resp);
 
     delete addObjRefReq;
 }
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <util/Log.h>
+#include <util/timeutils.h>
+#include <SmIo.h>
+#include <SmDiskIoLimiter.h>
+
+namespace fds {
+
+const fds_uint64_t SmDiskIoLimiter::MIN_RTT_PROBE_INTERVAL_US;
+const fds_uint32_t SmDiskIoLimiter::PROBE_SAMPLES;
+
+/* Windows a disk starts with until it has latency samples */
+static const fds_uint32_t INITIAL_HDD_WINDOW = 2;
+static const fds_uint32_t INITIAL_SSD_WINDOW = 8;
+
+SmDiskIoLimiter::SmDiskIoLimiter(IssueFn issue,
+                                 FailFn fail,
+                                 fds_uint32_t minWindow,
+                                 fds_uint32_t maxWindow)
+        : issue(issue),
+          fail(fail),
+          minWindow(std::max(minWindow, 1u)),
+          maxWindow(std::max(maxWindow, std::max(minWindow, 1u))) {
+}
+
+SmDiskIoLimiter::~SmDiskIoLimiter() {
+    for (auto const& kv : disks) {
+        if (!kv.second.held.empty()) {
+            LOGWARN << "Disk " << kv.first << " has " << kv.second.held.size()
+                    << " held IOs at shutdown";
+        }
+    }
+}
+
+SmDiskIoLimiter::DiskWindow&
+SmDiskIoLimiter::window(DiskId diskId, diskio::DataTier tier) {
+    auto it = disks.find(diskId);
+    if (it == disks.end()) {
+        DiskWindow disk;
+        disk.tier = tier;
+        fds_uint32_t initial = (tier == diskio::flashTier) ? INITIAL_SSD_WINDOW :
+                                                             INITIAL_HDD_WINDOW;
+        disk.limit = std::min(std::max(initial, minWindow), maxWindow);
+        disk.lastProbeUs = util::getTimeStampMicros();
+        it = disks.emplace(diskId, std::move(disk)).first;
+        LOGNOTIFY << "Disk " << diskId << " outstanding io window " << it->second.limit;
+    }
+    return it->second;
+}
+
+fds_uint32_t
+SmDiskIoLimiter::effectiveWindow(const DiskWindow& disk) const {
+    return (disk.probeStartUs != 0) ? minWindow : static_cast<fds_uint32_t>(disk.limit);
+}
+
+void
+SmDiskIoLimiter::submit(SmIoReq* io, DiskId diskId, diskio::DataTier tier) {
+    Error err(ERR_OK);
+    {
+        std::lock_guard<std::mutex> g(lock);
+        if (!shutdownErr.ok()) {
+            err = shutdownErr;
+        } else {
+            auto& disk = window(diskId, tier);
+            io->limiterDiskId = diskId;
+            if (!disk.held.empty() || disk.inflight >= effectiveWindow(disk)) {
+                disk.held.push_back(io);
+                return;
+            }
+            disk.inflight++;
+            io->diskIssueTs = util::getTimeStampMicros();
+        }
+    }
+    if (!err.ok()) {
+        fail(io, err);
+        return;
+    }
+    issueReady({io});
+}
+
+void
+SmDiskIoLimiter::complete(SmIoReq* io) {
+    if (io->limiterDiskId == SM_INVALID_DISK_ID) {
+        return;
+    }
+    complete(io, util::getTimeStampMicros() - io->diskIssueTs);
+}
+
+void
+SmDiskIoLimiter::complete(SmIoReq* io, fds_uint64_t latencyUs) {
+    if (io->limiterDiskId == SM_INVALID_DISK_ID) {
+        return;
+    }
+    std::vector<SmIoReq*> ready;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        auto it = disks.find(io->limiterDiskId);
+        fds_assert(it != disks.end());
+        auto& disk = it->second;
+        fds_assert(disk.inflight > 0);
+
+        auto now = util::getTimeStampMicros();
+        if (disk.probeStartUs != 0) {
+            probe(disk, io, latencyUs, now);
+        } else {
+            adapt(disk, latencyUs);
+            if (now - disk.lastProbeUs >= MIN_RTT_PROBE_INTERVAL_US) {
+                disk.probeStartUs = now;
+                disk.probeSamples = 0;
+            }
+        }
+        disk.inflight--;
+        release(disk, now, ready);
+    }
+    io->limiterDiskId = SM_INVALID_DISK_ID;
+
+    issueReady(std::move(ready));
+}
+
+void
+SmDiskIoLimiter::release(DiskWindow& disk, fds_uint64_t now, std::vector<SmIoReq*>& ready) {
+    while (!disk.held.empty() && disk.inflight < effectiveWindow(disk)) {
+        auto next = disk.held.front();
+        disk.held.pop_front();
+        disk.inflight++;
+        next->diskIssueTs = now;
+        ready.push_back(next);
+    }
+}
+
+void
+SmDiskIoLimiter::issueReady(std::vector<SmIoReq*> ready) {
+    while (!ready.empty()) {
+        std::vector<std::pair<SmIoReq*, Error>> failed;
+        for (auto io : ready) {
+            Error err = issue(io);
+            if (!err.ok()) {
+                failed.emplace_back(io, err);
+            }
+        }
+        ready.clear();
+        if (failed.empty()) {
+            return;
+        }
+
+        /* A failed IO never reached its disk, its slot goes to the next held one */
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto now = util::getTimeStampMicros();
+            for (auto const& f : failed) {
+                auto it = disks.find(f.first->limiterDiskId);
+                fds_assert(it != disks.end());
+                it->second.inflight--;
+                f.first->limiterDiskId = SM_INVALID_DISK_ID;
+                release(it->second, now, ready);
+            }
+        }
+        for (auto const& f : failed) {
+            LOGWARN << "Failed to issue io held for its disk: " << f.second;
+            fail(f.first, f.second);
+        }
+    }
+}
+
+void
+SmDiskIoLimiter::shutdown(const Error& err) {
+    std::vector<SmIoReq*> held;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        shutdownErr = err;
+        for (auto& kv : disks) {
+            for (auto io : kv.second.held) {
+                io->limiterDiskId = SM_INVALID_DISK_ID;
+                held.push_back(io);
+            }
+            kv.second.held.clear();
+        }
+    }
+    if (!held.empty()) {
+        LOGNOTIFY << "Failing " << held.size() << " held IOs at shutdown";
+    }
+    for (auto io : held) {
+        fail(io, err);
+    }
+}
+
+void
+SmDiskIoLimiter::adapt(DiskWindow& disk, fds_uint64_t latencyUs) {
+    double rtt = std::max<fds_uint64_t>(latencyUs, 1);
+    if (disk.samples == 0) {
+        disk.smoothedRttUs = rtt;
+        disk.minRttUs = rtt;
+    } else {
+        disk.smoothedRttUs += (rtt - disk.smoothedRttUs) / 8;
+        disk.minRttUs = std::min(disk.minRttUs, rtt);
+    }
+    ++disk.samples;
+
+    /* A disk using less than half its window says nothing about a larger one */
+    if (2 * disk.inflight < disk.limit) {
+        return;
+    }
+
+    double gradient = std::min(1.0, std::max(0.5, disk.minRttUs / disk.smoothedRttUs));
+    double newLimit = disk.limit * gradient + std::sqrt(disk.limit);
+    newLimit = 0.8 * disk.limit + 0.2 * newLimit;
+    disk.limit = std::min<double>(std::max<double>(newLimit, minWindow), maxWindow);
+}
+
+void
+SmDiskIoLimiter::probe(DiskWindow& disk,
+                       const SmIoReq* io,
+                       fds_uint64_t latencyUs,
+                       fds_uint64_t now) {
+    /* IOs issued before the probe started queued behind the full window */
+    if (io->diskIssueTs < disk.probeStartUs) {
+        return;
+    }
+    double rtt = std::max<fds_uint64_t>(latencyUs, 1);
+    disk.probeMinRttUs = (disk.probeSamples == 0) ? rtt : std::min(disk.probeMinRttUs, rtt);
+    if (++disk.probeSamples < PROBE_SAMPLES) {
+        return;
+    }
+    LOGDEBUG << "Disk min latency " << static_cast<fds_uint64_t>(disk.minRttUs)
+             << "us -> " << static_cast<fds_uint64_t>(disk.probeMinRttUs) << "us";
+    disk.minRttUs = disk.probeMinRttUs;
+    disk.probeStartUs = 0;
+    disk.lastProbeUs = now;
+}
+
+fds_uint32_t
+SmDiskIoLimiter::outstandingLimit() const {
+    std::lock_guard<std::mutex> g(lock);
+    fds_uint32_t limit = 0;
+    for (auto const& kv : disks) {
+        limit += 2 * static_cast<fds_uint32_t>(kv.second.limit);
+    }
+    return limit;
+}
+
+fds_uint32_t
+SmDiskIoLimiter::getWindow(DiskId diskId) const {
+    std::lock_guard<std::mutex> g(lock);
+    auto it = disks.find(diskId);
+    return (it == disks.end()) ? 0 : static_cast<fds_uint32_t>(it->second.limit);
+}
+
+fds_uint32_t
+SmDiskIoLimiter::getInflight(DiskId diskId) const {
+    std::lock_guard<std::mutex> g(lock);
+    auto it = disks.find(diskId);
+    return (it == disks.end()) ? 0 : it->second.inflight;
+}
+
+fds_uint32_t
+SmDiskIoLimiter::getHeld(DiskId diskId) const {
+    std::lock_guard<std::mutex> g(lock);
+    auto it = disks.find(diskId);
+    return (it == disks.end()) ? 0 : it->second.held.size();
+}
+
+std::string
+SmDiskIoLimiter::toString() const {
+    std::lock_guard<std::mutex> g(lock);
+    std::stringstream ss;
+    for (auto const& kv : disks) {
+        auto const& disk = kv.second;
+        ss << "disk " << kv.first
+           << (disk.tier == diskio::flashTier ? " ssd" : " hdd")
+           << " window " << static_cast<fds_uint32_t>(disk.limit)
+           << " inflight " << disk.inflight
+           << " held " << disk.held.size()
+           << " rtt " << static_cast<fds_uint64_t>(disk.smoothedRttUs)
+           << "us min " << static_cast<fds_uint64_t>(disk.minRttUs) << "us; ";
+    }
+    return ss.str();
+}
+
+}  // namespace fds
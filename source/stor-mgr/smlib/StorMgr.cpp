@@ -206,6 +206,23 @@ void ObjectStorMgr::mod_startup()
     if (minOutstanding > qosOutNum) {
         qosOutNum = minOutstanding;
     }
+    // with adaptive disk windows, qosOutNum is only the ceiling of what
+    // the windows together may keep outstanding
+    adaptiveDiskWindow = modProvider_->get_fds_config()->get<bool>(
+        "fds.sm.qos.adaptive_disk_window", false);
+    if (adaptiveDiskWindow) {
+        minDiskWindow = modProvider_->get_fds_config()->get<int>(
+            "fds.sm.qos.min_disk_window", 1);
+        maxDiskWindow = modProvider_->get_fds_config()->get<int>(
+            "fds.sm.qos.max_disk_window", 32);
+        fds_uint32_t maxOutstanding = modProvider_->get_fds_config()->get<int>(
+            "fds.sm.qos.max_outstanding_io", 128);
+        fds_uint32_t windowsOutstanding = std::min(2 * maxDiskWindow * objectStore->getDiskCount() + 2,
+                                                   maxOutstanding);
+        if (windowsOutstanding > qosOutNum) {
+            qosOutNum = windowsOutstanding;
+        }
+    }
     // we should also have enough QoS threads to serve outstanding IO
     if (qosThrds <= qosOutNum) {
         qosThrds = qosOutNum + 1;   // one is used for dispatcher
@@ -308,6 +325,9 @@ void ObjectStorMgr::mod_enable_service()
 
             // Get the volume descriptors from OM
             getAllVolumeDescriptors();
+
+            // Verify data at rest in the background
+            objectStore->startScrubber();
         }
 
         // Enable stats collection in SM for stats streaming
@@ -811,6 +831,7 @@ ObjectStorMgr::putObjectInternal(SmIoPutObjectReq *putReq)
 
         // latency of ObjectStore layer
         PerfTracer::tracePointBegin(putReq->opLatencyCtx);
+        StageTracer::record(putReq->traceId, TraceStage::DISK_IO_START, putReq->io_type);
 
         // TODO(Andrew): Remove this copy. The network should allocated
         // a shared ptr structure so that we can directly store that, even
@@ -819,6 +840,7 @@ ObjectStorMgr::putObjectInternal(SmIoPutObjectReq *putReq)
                                      objId,
                                      boost::make_shared<std::string>(putReq->putObjectNetReq->data_obj),
                                      putReq->forwardedReq, useTier);
+        StageTracer::record(putReq->traceId, TraceStage::DISK_IO_END, putReq->io_type);
 
         qosCtrl->markIODone(*putReq);
 
@@ -991,12 +1013,16 @@ ObjectStorMgr::getObjectInternal(SmIoGetObjectReq *getReq)
         auto token_lock = getTokenLock(objId);
         PerfTracer::tracePointEnd(objWaitCtx);
 
+        StageTracer::record(getReq->traceId, TraceStage::DISK_IO_START, getReq->io_type);
         objData = objectStore->getObject(volId,
                                          objId,
                                          tierUsed,
                                          err);
+        StageTracer::record(getReq->traceId, TraceStage::DISK_IO_END, getReq->io_type);
     }
     if (err.ok()) {
+        // Size is only known now, QoS charges for it when the IO is marked done
+        getReq->io_size = objData->size();
         // TODO(Andrew): Remove this copy. The network should allocated
         // a shared ptr structure so that we can directly store that, even
         // after the network message is freed.
@@ -1090,6 +1116,34 @@ Error ObjectStorMgr::enqueueMsg(fds_volid_t volId, SmIoReq* ioReq)
     return err;
 }
 
+Error ObjectStorMgr::enqueueMsgs(fds_volid_t volId,
+                                 const std::vector<SmIoReq*>& ioReqs,
+                                 size_t& nEnqueued)
+{
+    nEnqueued = 0;
+
+    StorMgrVolume* smVol = volTbl->getVolume(volId);
+    if (NULL == smVol) {
+        return ERR_VOL_NOT_FOUND;
+    }
+
+    std::vector<FDS_IOType*> ios;
+    ios.reserve(ioReqs.size());
+    for (auto ioReq : ioReqs) {
+        fds_assert(ioReq->io_type == FDS_SM_GET_OBJECT ||
+                   ioReq->io_type == FDS_SM_PUT_OBJECT);
+        ioReq->setVolId(volId);
+        ios.push_back(static_cast<FDS_IOType*>(ioReq));
+    }
+
+    Error err = qosCtrl->enqueueIOs(smVol->getQueue()->getVolUuid(), ios, nEnqueued);
+    if (err != fds::ERR_OK) {
+        LOGERROR << "Failed to enqueue " << (ioReqs.size() - nEnqueued)
+                 << " of " << ioReqs.size() << " msgs for volume: " << volId << " " << err;
+    }
+    return err;
+}
+
 /**
  * Takes snapshot of sm object metadata db identifed by
  * token
@@ -1568,10 +1622,85 @@ const std::hash<int64_t> ObjectStorMgr::SmQosCtrl::svcIdHash;
 const ObjectStorMgr::SmQosCtrl::SerialKeyHash ObjectStorMgr::SmQosCtrl::keyHash;
 
 Error ObjectStorMgr::SmQosCtrl::processIO(FDS_IOType* _io) {
-    Error err(ERR_OK);
     SmIoReq *io = static_cast<SmIoReq*>(_io);
     PerfTracer::tracePointEnd(io->opQoSWaitCtx);
 
+    // Object IOs wait for room in the outstanding window of the disk
+    // serving them, other IOs go straight to the thread pool
+    if (diskLimiter) {
+        switch (io->io_type) {
+            case FDS_SM_GET_OBJECT:
+            case FDS_SM_PUT_OBJECT:
+            case FDS_SM_DELETE_OBJECT:
+                {
+                    diskio::DataTier tier;
+                    DiskId diskId = parentSm->objectStore->getIoDiskId(io->getVolId(),
+                                                                       io->getObjId(),
+                                                                       io->io_type,
+                                                                       tier);
+                    if (diskId != SM_INVALID_DISK_ID) {
+                        diskLimiter->submit(io, diskId, tier);
+                        updateOutstandingLimit();
+                        return ERR_OK;
+                    }
+                    break;
+                }
+            default:
+                break;
+        }
+    }
+    return issueIO(io);
+}
+
+void ObjectStorMgr::SmQosCtrl::diskIODone(FDS_IOType& _io) {
+    if (diskLimiter) {
+        diskLimiter->complete(static_cast<SmIoReq*>(&_io));
+        updateOutstandingLimit();
+    }
+}
+
+void ObjectStorMgr::SmQosCtrl::failIO(SmIoReq* io, const Error& err) {
+    LOGWARN << "Failing " << io->log_string() << " held for its disk: " << err;
+    dispatcher->markIODone(io);
+
+    switch (io->io_type) {
+        case FDS_SM_GET_OBJECT:
+            {
+                auto getReq = static_cast<SmIoGetObjectReq *>(io);
+                getReq->response_cb(err, getReq);
+                break;
+            }
+        case FDS_SM_PUT_OBJECT:
+            {
+                auto putReq = static_cast<SmIoPutObjectReq *>(io);
+                putReq->response_cb(err, putReq);
+                break;
+            }
+        case FDS_SM_DELETE_OBJECT:
+            {
+                auto delReq = static_cast<SmIoDeleteObjectReq *>(io);
+                delReq->response_cb(err, delReq);
+                break;
+            }
+        default:
+            fds_assert(!"Only object IOs go through disk windows");
+            break;
+    }
+}
+
+void ObjectStorMgr::SmQosCtrl::updateOutstandingLimit() {
+    // Leave a couple of slots for system tasks, which don't go
+    // through disk windows
+    dispatcher->adaptive_outstanding_ios.store(diskLimiter->outstandingLimit() + 2,
+                                               std::memory_order_relaxed);
+    if (diskLimiterLogCounter.fetch_add(1, std::memory_order_relaxed) % 100000 == 0) {
+        LOGNOTIFY << "Disk io windows: " << diskLimiter->toString();
+    }
+}
+
+Error ObjectStorMgr::SmQosCtrl::issueIO(SmIoReq* io) {
+    Error err(ERR_OK);
+
     // Create the key to use during serialization.
     SerialKey key(io->getVolId(), io->getClientSvcId());
 
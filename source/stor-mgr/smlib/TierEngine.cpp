@@ -8,6 +8,7 @@
 #include <object-store/RankEngine.h>
 #include <TierEngine.h>
 #include <object-store/RandomRankPolicy.h>
+#include <object-store/CountMinSketchRankPolicy.h>
 
 namespace fds {
 
@@ -22,13 +23,33 @@ TierEngine::TierEngine(const std::string &modName,
         case FDS_RANDOM_RANK_POLICY:
             rankEngine = boost::shared_ptr<RankEngine>(new RandomRankPolicy(storMgr, 50));
             break;
-        case FDS_BLOOM_FILTER_TIME_DECAY_RANK_POLICY:
         case FDS_COUNT_MIN_SKETCH_RANK_POLICY:
+            {
+                auto conf = MODULEPROVIDER()->get_fds_config();
+                SketchRankParams params;
+                params.sketchWidth = conf->get<uint32_t>("fds.sm.tiering.hybrid.sketch.width",
+                                                         params.sketchWidth);
+                params.promoteThreshold = conf->get<uint32_t>(
+                    "fds.sm.tiering.hybrid.sketch.promote_threshold", params.promoteThreshold);
+                params.demoteThreshold = conf->get<uint32_t>(
+                    "fds.sm.tiering.hybrid.sketch.demote_threshold", params.demoteThreshold);
+                params.minFlashResidencySecs = conf->get<uint32_t>(
+                    "fds.sm.tiering.hybrid.sketch.min_flash_residency", params.minFlashResidencySecs);
+                params.maxPromoteCandidates = conf->get<uint32_t>(
+                    "fds.sm.tiering.hybrid.sketch.max_promote_candidates", params.maxPromoteCandidates);
+                params.maxFlashResident = conf->get<uint32_t>(
+                    "fds.sm.tiering.hybrid.sketch.max_flash_resident", params.maxFlashResident);
+                rankEngine = boost::shared_ptr<RankEngine>(
+                    new CountMinSketchRankPolicy(diskMap, params));
+                break;
+            }
+        case FDS_BLOOM_FILTER_TIME_DECAY_RANK_POLICY:
         default:
             fds_panic("Invalid or unsupported rank policy provided!");
     }
 
     migrator = new SmTierMigration(storMgr);
+    hybridTierCtrlr.setRankEngine(rankEngine, migrator->flashFullThreshold());
 }
 
 
@@ -139,4 +160,11 @@ TierEngine::notifyIO(const ObjectID& objId, fds_io_op_t opType,
         migrator->notifyHybridVolFlashPut(objId);
     }
 }
+
+void
+TierEngine::notifyTierMove(const ObjectID& objId,
+                           diskio::DataTier fromTier,
+                           diskio::DataTier toTier) {
+    rankEngine->notifyTierMove(objId, fromTier, toTier);
+}
 }  // namespace fds
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <iterator>
+#include <vector>
+#include <SmTypes.h>
+#include <util/timeutils.h>
+#include <object-store/CountMinSketchRankPolicy.h>
+
+namespace fds {
+
+CountMinSketchRankPolicy::CountMinSketchRankPolicy(const SmDiskMap::ptr& diskMap,
+                                                   const SketchRankParams& params)
+    : diskMap(diskMap),
+      params(params),
+      sketch(params.sketchWidth)
+{
+    LOGNOTIFY << "sketch width: " << sketch.width()
+              << " promote threshold: " << params.promoteThreshold
+              << " demote threshold: " << params.demoteThreshold
+              << " min flash residency: " << params.minFlashResidencySecs
+              << " max promote candidates: " << params.maxPromoteCandidates
+              << " max flash resident: " << params.maxFlashResident;
+}
+
+CountMinSketchRankPolicy::~CountMinSketchRankPolicy()
+{
+}
+
+CountMinSketchRankPolicy::DiskCandidates*
+CountMinSketchRankPolicy::getDiskCandidates(fds_uint16_t diskId)
+{
+    {
+        ReadGuard rg(disksLock);
+        auto itr = disks.find(diskId);
+        if (itr != disks.end()) {
+            return itr->second.get();
+        }
+    }
+    WriteGuard wg(disksLock);
+    auto &candidates = disks[diskId];
+    if (!candidates) {
+        candidates.reset(new DiskCandidates());
+    }
+    return candidates.get();
+}
+
+fds_uint32_t
+CountMinSketchRankPolicy::estimateFrequency(const ObjectID& oid) const
+{
+    return sketch.estimate(sketchKey(oid));
+}
+
+void
+CountMinSketchRankPolicy::notifyDataPath(fds_io_op_t opType,
+                                         const ObjectID& oid,
+                                         diskio::DataTier tier)
+{
+    if (opType != FDS_SM_GET_OBJECT && opType != FDS_SM_PUT_OBJECT) {
+        return;
+    }
+
+    fds_uint32_t freq = sketch.increment(sketchKey(oid));
+
+    if (tier == diskio::flashTier) {
+        if (opType == FDS_SM_PUT_OBJECT) {
+            trackFlashResident(oid);
+        }
+    } else if (tier == diskio::diskTier &&
+               opType == FDS_SM_GET_OBJECT &&
+               freq >= params.promoteThreshold) {
+        offerPromoteCandidate(oid, freq);
+    }
+}
+
+void
+CountMinSketchRankPolicy::offerPromoteCandidate(const ObjectID& oid, fds_uint32_t freq)
+{
+    fds_uint16_t diskId = diskMap->getDiskId(oid, diskio::diskTier);
+    if (diskId == SM_INVALID_DISK_ID) {
+        return;
+    }
+    auto candidates = getDiskCandidates(diskId);
+
+    fds_mutex::scoped_lock l(candidates->lock);
+    auto itr = candidates->promoteIndex.find(oid);
+    if (itr != candidates->promoteIndex.end()) {
+        /* Already a candidate, refresh its rank */
+        candidates->promoteRank.erase(std::make_pair(itr->second, oid));
+        itr->second = freq;
+        candidates->promoteRank.insert(std::make_pair(freq, oid));
+        return;
+    }
+
+    if (candidates->promoteIndex.size() >= params.maxPromoteCandidates) {
+        /* Full.  Replace the coldest candidate if this one is hotter */
+        auto coldest = candidates->promoteRank.begin();
+        if (coldest->first >= freq) {
+            return;
+        }
+        candidates->promoteIndex.erase(coldest->second);
+        candidates->promoteRank.erase(coldest);
+    }
+    candidates->promoteIndex[oid] = freq;
+    candidates->promoteRank.insert(std::make_pair(freq, oid));
+}
+
+void
+CountMinSketchRankPolicy::trackFlashResident(const ObjectID& oid)
+{
+    fds_uint16_t diskId = diskMap->getDiskId(oid, diskio::flashTier);
+    if (diskId == SM_INVALID_DISK_ID) {
+        return;
+    }
+    auto candidates = getDiskCandidates(diskId);
+
+    fds_mutex::scoped_lock l(candidates->lock);
+    if (candidates->flashResident.size() >= params.maxFlashResident) {
+        /* Oldest entry is left for the metadata scan to demote */
+        candidates->flashResident.pop_front();
+    }
+    candidates->flashResident.push_back(FlashEntry{oid, util::getTimeStampSeconds()});
+}
+
+void
+CountMinSketchRankPolicy::getObjectsToPromote(fds_uint32_t maxSize,
+                                              PromotionSet& oidSet)
+{
+    std::vector<DiskCandidates*> diskList;
+    {
+        ReadGuard rg(disksLock);
+        for (auto &kv : disks) {
+            diskList.push_back(kv.second.get());
+        }
+    }
+
+    /* Take the hottest candidate of each disk in turn so one busy disk doesn't
+     * get all the flash
+     */
+    bool found = true;
+    while (oidSet.size() < maxSize && found) {
+        found = false;
+        for (auto candidates : diskList) {
+            if (oidSet.size() >= maxSize) {
+                break;
+            }
+            fds_mutex::scoped_lock l(candidates->lock);
+            if (candidates->promoteRank.empty()) {
+                continue;
+            }
+            auto hottest = std::prev(candidates->promoteRank.end());
+            ObjectID oid = hottest->second;
+            candidates->promoteIndex.erase(oid);
+            candidates->promoteRank.erase(hottest);
+            oidSet.push_back(oid);
+            found = true;
+        }
+    }
+}
+
+fds_bool_t
+CountMinSketchRankPolicy::getObjectsToDemote(fds_uint32_t maxSize,
+                                             PromotionSet& oidSet)
+{
+    std::vector<DiskCandidates*> diskList;
+    {
+        ReadGuard rg(disksLock);
+        for (auto &kv : disks) {
+            diskList.push_back(kv.second.get());
+        }
+    }
+
+    fds_uint64_t oldestAllowed = util::getTimeStampSeconds() - params.minFlashResidencySecs;
+    for (auto candidates : diskList) {
+        if (oidSet.size() >= maxSize) {
+            break;
+        }
+        fds_mutex::scoped_lock l(candidates->lock);
+        /* Look at each entry at most once per call */
+        size_t toExamine = candidates->flashResident.size();
+        while (toExamine-- > 0 && oidSet.size() < maxSize) {
+            auto &entry = candidates->flashResident.front();
+            if (entry.ts > oldestAllowed) {
+                /* Rest of the queue is younger */
+                break;
+            }
+            if (sketch.estimate(sketchKey(entry.oid)) >= params.demoteThreshold) {
+                /* Still hot.  Look at it again after another residency period */
+                FlashEntry again = entry;
+                again.ts = util::getTimeStampSeconds();
+                candidates->flashResident.pop_front();
+                candidates->flashResident.push_back(again);
+                continue;
+            }
+            oidSet.push_back(entry.oid);
+            candidates->flashResident.pop_front();
+        }
+    }
+    return true;
+}
+
+fds_bool_t
+CountMinSketchRankPolicy::isObjectDemotable(const ObjectID& oid)
+{
+    return sketch.estimate(sketchKey(oid)) < params.demoteThreshold;
+}
+
+fds_bool_t
+CountMinSketchRankPolicy::isObjectHot(const ObjectID& oid)
+{
+    return !isObjectDemotable(oid);
+}
+
+void
+CountMinSketchRankPolicy::notifyTierMove(const ObjectID& oid,
+                                         diskio::DataTier fromTier,
+                                         diskio::DataTier toTier)
+{
+    /* Only objects that actually made it to flash become flash resident,
+     * whoever promoted them
+     */
+    if (toTier == diskio::flashTier) {
+        trackFlashResident(oid);
+    }
+}
+
+}  // namespace fds
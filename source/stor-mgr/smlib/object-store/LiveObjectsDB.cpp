@@ -55,6 +55,15 @@ Error LiveObjectsDB::createLiveObjectsTblAndIdx() {
         return ERR_INVALID;
     }
 
+    query = "create table if not exists tokenspacetbl"
+            " (smtoken integer, tier integer, livebytes integer, reclaimbytes integer,"
+            " primary key(smtoken, tier))";
+
+    if (db->execute(query)) {
+        LOGERROR << "Failed to create tokenspacetbl";
+        return ERR_INVALID;
+    }
+
     return ERR_OK;
 }
 
@@ -280,4 +289,62 @@ bool LiveObjectsDB::hasNewObjectSets(const fds_token_id &smToken, fds_uint16_t d
     return count > 0;
 }
 
+Error LiveObjectsDB::setTokenSpace(const fds_token_id &smToken, fds_uint16_t tier,
+                                   fds_uint64_t liveBytes, fds_uint64_t reclaimBytes) {
+    SCOPEDWRITE(lock);
+    if (!db) { return ERR_INVALID; }
+    std::string query = util::strformat("insert or replace into tokenspacetbl "
+                                        "(smtoken, tier, livebytes, reclaimbytes) "
+                                        "values (%ld, %d, %ld, %ld)",
+                                        smToken, tier, liveBytes, reclaimBytes);
+
+    if (db->execute(query)) {
+        LOGERROR << "failed: " << query;
+        return ERR_INVALID;
+    }
+    return ERR_OK;
+}
+
+Error LiveObjectsDB::getTokenSpace(const fds_token_id &smToken, fds_uint16_t tier,
+                                   fds_uint64_t &liveBytes, fds_uint64_t &reclaimBytes) {
+    SCOPEDREAD(lock);
+    if (!db) { return ERR_INVALID; }
+
+    fds_uint64_t count = 0;
+    std::string query = util::strformat("select count(*) from tokenspacetbl "
+                                        "where smtoken=%ld and tier=%d", smToken, tier);
+    if (!(db->getIntValue(query, count))) {
+        LOGERROR << "failed: " << query;
+        return ERR_INVALID;
+    }
+    if (count == 0) {
+        return ERR_NOT_FOUND;
+    }
+
+    query = util::strformat("select livebytes from tokenspacetbl "
+                            "where smtoken=%ld and tier=%d", smToken, tier);
+    if (!(db->getIntValue(query, liveBytes))) {
+        LOGERROR << "failed: " << query;
+        return ERR_INVALID;
+    }
+    query = util::strformat("select reclaimbytes from tokenspacetbl "
+                            "where smtoken=%ld and tier=%d", smToken, tier);
+    if (!(db->getIntValue(query, reclaimBytes))) {
+        LOGERROR << "failed: " << query;
+        return ERR_INVALID;
+    }
+    return ERR_OK;
+}
+
+Error LiveObjectsDB::removeTokenSpace(const fds_token_id &smToken) {
+    SCOPEDWRITE(lock);
+    if (!db) { return ERR_INVALID; }
+    std::string query = util::strformat("delete from tokenspacetbl where smtoken=%ld", smToken);
+    if (db->execute(query)) {
+        LOGERROR << "failed: " << query;
+        return ERR_INVALID;
+    }
+    return ERR_OK;
+}
+
 } // end namespace fds
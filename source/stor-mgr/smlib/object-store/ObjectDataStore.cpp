@@ -181,6 +181,30 @@ ObjectDataStore::getObjectData(fds_volid_t volId,
     return NULL;
 }
 
+boost::shared_ptr<const std::string>
+ObjectDataStore::readObjectDataFromDisk(const ObjectID &objId,
+                                        diskio::DataTier tier,
+                                        const obj_phy_loc_t& loc,
+                                        fds_uint32_t len,
+                                        Error &err) {
+    meta_vol_io_t   vio;
+    meta_obj_id_t   oid;
+    ObjectBuf       objBuf;
+    memcpy(oid.metaDigest, objId.GetId(), objId.GetLen());
+    diskio::DiskRequest *plReq = new diskio::DiskRequest(vio, oid, &objBuf, true, tier);
+    plReq->set_phy_loc(&loc);
+    (objBuf.data)->resize(len, 0);
+
+    err = persistData->readObjectData(objId, plReq);
+    delete plReq;
+    if (!err.ok()) {
+        LOGWARN << "Failed to read " << objId << " from tier " << tier
+                << " disk " << loc.obj_stor_loc_id << ": " << err;
+        return nullptr;
+    }
+    return objBuf.data;
+}
+
 Error
 ObjectDataStore::removeObjectData(fds_volid_t volId,
                                   const ObjectID& objId,
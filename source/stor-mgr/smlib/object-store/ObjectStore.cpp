@@ -70,16 +70,22 @@ ObjectStore::ObjectStore(const std::string &modName,
                                                       std::placeholders::_2,
                                                       std::placeholders::_3))),
           tierEngine(new TierEngine("SM Tier Engine",
+                                    g_fdsprocess->get_fds_config()->get<bool>(
+                                        "fds.sm.tiering.hybrid.sketch.enable", false) ?
+                                    TierEngine::FDS_COUNT_MIN_SKETCH_RANK_POLICY :
                                     TierEngine::FDS_RANDOM_RANK_POLICY,
                                     diskMap, data_store)),
           SMCheckCtrl(new SMCheckControl("SM Checker",
                                          diskMap, data_store)),
+          scrubber(new SMScrubber(data_store, this, diskMap)),
           liveObjectsTable(new LiveObjectsDB(g_fdsprocess->proc_fdsroot()->dir_user_repo() + "liveobj.db")),
+          tokenSpaceStats(new TokenSpaceStats(liveObjectsTable.get())),
           currentState(OBJECT_STORE_INIT),
           lastCapacityMessageSentAt(0),
           sentPutToHddMsg(false)
 {
     liveObjectsTable->createLiveObjectsTblAndIdx();
+    tokenSpaceStats->load();
     nullary_always (ObjectStorMgr::*Lock)(ObjectID const&, bool) = &ObjectStorMgr::getTokenLock;
     if (data_store) {
         tokenLockFn = std::bind(Lock,
@@ -719,12 +725,24 @@ ObjectStore::putObject(fds_volid_t volId,
 
         // Now track capacity change
         capacityMap[diskId].usedCapacity += objData->size();
+        tokenSpaceStats->addLive(diskMap->smTokenId(objId), useTier, objData->size());
 
         // update physical location that we got from data store
         updatedMeta->updatePhysLocation(&objPhyLoc);
         doWriteBack = true;
     }
 
+    // An expired object that is put again before it is compacted away is live again
+    if (!doWriteBack && objMeta &&
+        objMeta->getDeleteCount() >= fds::objDelCountThresh) {
+        fds_token_id smToken = diskMap->smTokenId(objId);
+        for (auto tier : {diskio::diskTier, diskio::flashTier}) {
+            if (objMeta->onTier(tier)) {
+                tokenSpaceStats->reviveReclaimable(smToken, tier, objMeta->getObjSize());
+            }
+        }
+    }
+
     auto writtenToTier = useTier;
     updatedMeta->updateTimestamp();
     updatedMeta->resetDeleteCount();
@@ -838,10 +856,10 @@ ObjectStore::getObject(fds_volid_t volId,
         }
     }
 
-    // We are passing max_tier here, if we decide we
-    // care which tier GET is from we need to change this
+    // Rank policy uses the tier the GET was served from to find
+    // promotion candidates
     tierEngine->notifyIO(objId, FDS_SM_GET_OBJECT,
-            *volumeTbl->getVolume(volId)->voldesc, diskio::maxTier);
+            *volumeTbl->getVolume(volId)->voldesc, usedTier);
 
     return objData;
 }
@@ -1102,15 +1120,20 @@ ObjectStore::moveObjectToTier(const ObjectID& objId,
     } // update physical location that we got from data store
     ObjMetaData::ptr updatedMeta(new ObjMetaData(objMeta));
     updatedMeta->updatePhysLocation(&objPhyLoc);
+    fds_token_id smToken = diskMap->smTokenId(objId);
+    tokenSpaceStats->addLive(smToken, toTier, objData->size());
     if (relocateFlag) {
         // remove from fromTier
         updatedMeta->removePhyLocation(fromTier);
+        tokenSpaceStats->addReclaimable(smToken, fromTier, objData->size());
     }
 
     // write metadata to metadata store
     err = metaStore->putObjectMetadata(unknownVolId, objId, updatedMeta);
     if (!err.ok()) {
         LOGERROR << "Failed to update metadata for obj " << objId;
+    } else {
+        tierEngine->notifyTierMove(objId, fromTier, toTier);
     }
     return err;
 }
@@ -1137,6 +1160,9 @@ Error ObjectStore::updateLocationFromFlashToDisk(const ObjectID& objId,
     if (!err.ok()) {
         LOGERROR << "Failed to update metadata for obj " << objId;
     } else {
+        tokenSpaceStats->addReclaimable(diskMap->smTokenId(objId),
+                                        diskio::DataTier::flashTier,
+                                        objMeta->getObjSize());
         // TODO(Rao): Remove this log statement
         DBG(LOGDEBUG << "Moved object " << objId << "from flash to disk");
     }
@@ -1244,6 +1270,58 @@ ObjectStore::verifyObjectData(const ObjectID& objId,
     return ERR_OK;
 }
 
+boost::shared_ptr<const std::string>
+ObjectStore::readDataExtent(const ObjectID& objId,
+                            diskio::DataTier tier,
+                            const obj_phy_loc_t& loc,
+                            fds_uint32_t len,
+                            Error& err) {
+    return dataStore->readObjectDataFromDisk(objId, tier, loc, len, err);
+}
+
+Error
+ObjectStore::scrubObjectData(const ObjectID& objId,
+                             diskio::DataTier tier,
+                             const obj_phy_loc_t& loc,
+                             const char* data,
+                             fds_uint32_t objSize) {
+    if (data && (ObjIdGen::genObjectId(data, objSize) == objId)) {
+        return ERR_OK;
+    }
+
+    // The scrubber works from a metadata snapshot, make sure the object
+    // still lives where we read it from before blaming the disk
+    ScopedSynchronizer scopedLock(*taskSynchronizer, objId);
+    Error metaErr(ERR_OK);
+    ObjMetaData::const_ptr objMeta =
+            metaStore->getObjectMetadata(invalid_vol_id, objId, metaErr);
+    if (!metaErr.ok() ||
+        (objMeta->getRefCnt() == 0UL) ||
+        !objMeta->onTier(tier)) {
+        return ERR_OK;
+    }
+    const obj_phy_loc_t* curLoc = objMeta->getObjPhyLoc(tier);
+    if ((curLoc->obj_stor_loc_id != loc.obj_stor_loc_id) ||
+        (curLoc->obj_file_id != loc.obj_file_id) ||
+        (curLoc->obj_stor_offset != loc.obj_stor_offset)) {
+        LOGDEBUG << "Object " << objId << " moved while being scrubbed";
+        return ERR_OK;
+    }
+    if (!data) {
+        return ERR_DISK_READ_FAILED;
+    }
+
+    LOGCRITICAL << "On-disk corruption detected by scrubber: " << objId
+                << " ObjMetaData = " << objMeta->logString();
+    ObjMetaData::ptr updatedMeta(new ObjMetaData(objMeta));
+    updatedMeta->setObjCorrupted();
+    Error err = metaStore->putObjectMetadata(invalid_vol_id, objId, updatedMeta);
+    if (!err.ok()) {
+        LOGERROR << "Failed to update metadata for obj " << objId;
+    }
+    return ERR_ONDISK_DATA_CORRUPT;
+}
+
 // Used by GC to copy data over to new token file
 Error
 ObjectStore::copyObjectToNewLocation(const ObjectID& objId,
@@ -1659,6 +1737,13 @@ ObjectStore::SmCheckUpdateDLT(const DLT *latestDLT)
 {
     SMCheckCtrl->updateSMCheckDLT(latestDLT);
 }
+
+void
+ObjectStore::startScrubber()
+{
+    scrubber->start();
+}
+
 Error
 ObjectStore::SmCheckControlCmd(SmCheckCmd *checkCmd)
 {
@@ -1694,6 +1779,48 @@ ObjectStore::getDiskCount() const {
     return diskMap->getTotalDisks();
 }
 
+DiskId
+ObjectStore::getIoDiskId(fds_volid_t volId,
+                         const ObjectID& objId,
+                         fds_io_op_t opType,
+                         diskio::DataTier& tier) const {
+    tier = diskMap->isAllDisksSSD() ? diskio::flashTier : diskio::diskTier;
+    switch (opType) {
+        case FDS_SM_PUT_OBJECT:
+            {
+                // Same tier choice as putObject(), which may still find a
+                // duplicate and write no data at all
+                StorMgrVolume *vol = volumeTbl->getVolume(volId);
+                if (vol != NULL) {
+                    tier = tierEngine->selectTier(objId, *vol->voldesc);
+                }
+                if (diskMap->getTotalDisks(tier) == 0) {
+                    tier = (tier == diskio::flashTier) ? diskio::diskTier : diskio::flashTier;
+                }
+                break;
+            }
+        case FDS_SM_GET_OBJECT:
+            {
+                // Metadata is usually cached or on SSD, and getObject()
+                // reads it again anyway; an object it doesn't find costs
+                // a read on the default tier
+                Error err(ERR_OK);
+                ObjMetaData::const_ptr objMeta = metaStore->getObjectMetadata(volId, objId, err);
+                if (err.ok() && objMeta->onTier(diskio::flashTier)) {
+                    tier = diskio::flashTier;
+                }
+                break;
+            }
+        case FDS_SM_DELETE_OBJECT:
+            // Deletes only update metadata
+            tier = metaStore->getMetadataTier();
+            break;
+        default:
+            break;
+    }
+    return diskMap->getDiskId(objId, tier);
+}
+
 void
 ObjectStore::updateMediaTrackers(fds_token_id smTokId,
                                  diskio::DataTier tier,
@@ -1856,6 +1983,9 @@ ObjectStore::movedTokensFileCleanup(SmTokenSet lostTokens) {
         LOGNOTIFY << "Close and delete token files for smTokens ";
         dataStore->closeAndDeleteSmTokensStore(tokenSet, true);
     }
+    for (auto smToken : tokenSet) {
+        tokenSpaceStats->removeToken(smToken);
+    }
     if (lostTokens.size() == 0) {
         movedTokens.clear();
     }
@@ -2082,6 +2212,15 @@ ObjectStore::evaluateObjectSets(const fds_token_id& smToken,
                     if ((fds_uint16_t)objDelCnt == 0) OBJECTSTOREMGR(objStorMgr)->counters->inactiveObjectCount.incr();
                     if (updatedMeta->incrementDeleteCount() >= fds::objDelCountThresh) {
                         ++tokStats.tkn_reclaim_size;
+                        // Just expired, compaction will reclaim its data on every tier
+                        if (objDelCnt < fds::objDelCountThresh) {
+                            for (auto t : {diskio::diskTier, diskio::flashTier}) {
+                                if (objMeta->onTier(t)) {
+                                    tokenSpaceStats->addReclaimable(smToken, t,
+                                                                    objMeta->getObjSize());
+                                }
+                            }
+                        }
                     }
                     metaStore->putObjectMetadata(invalid_vol_id, oid, updatedMeta);
                 } else if (objDelCnt >= fds::objDelCountThresh && objTS > ts) {
@@ -2197,6 +2336,8 @@ ObjectStore::mod_startup() {
  */
 void
 ObjectStore::mod_shutdown() {
+    scrubber->stop();
+    tokenSpaceStats->flush();
     Module::mod_shutdown();
 }
 fds_bool_t ObjectStore::willPutSucceed(fds_uint16_t diskId, fds_uint64_t writeSize) {
@@ -3,6 +3,7 @@
  */
 
 #include <sys/statvfs.h>
+#include <algorithm>
 #include <set>
 #include <vector>
 #include <string>
@@ -108,6 +109,7 @@ void ScavControl::updateDiskStats()
     fds_bool_t sendRefScanReq = false;
 
     LOGNORMAL << "Checking disk usages";
+    OBJECTSTOREMGR(dataStoreReqHandler)->objectStore->tokenSpaceStats->flush();
     fds_mutex::scoped_lock l(scav_lock);
     // start first max_disks_compacting disk scavengers
     if (nextDiskToCompact != SM_INVALID_DISK_ID) {
@@ -720,21 +722,8 @@ fds_bool_t DiskScavenger::getNextCompactToken(fds_token_id* tok_id) {
     *tok_id = 0;
 
     fds_mutex::scoped_lock l(disk_scav_lock);
-    if (tokenDb.count(next_token) == 0) {
-        // if we don't have this tok id, find the closes id > tok_id
-        // since elements in the set are sorted, find first elm with id > tok_id
-        for (std::set<fds_token_id>::const_iterator cit = tokenDb.cbegin();
-             cit != tokenDb.cend();
-             ++cit) {
-            if (*cit > next_token) {
-                *tok_id = *cit;
-                next_token = (*tok_id)+1;
-                found = true;
-                break;
-            }
-        }
-    } else {
-        *tok_id = next_token;
+    if (next_token < tokenOrder.size()) {
+        *tok_id = tokenOrder[next_token];
         ++next_token;
         found = true;
     }
@@ -753,62 +742,135 @@ fds_bool_t DiskScavenger::isTokenCompacted(const fds_token_id& tok_id) {
     }
 }
 
-// Re-builds tokenDb with tokens that need to be scavenged
-// TODO(xxx) pass in policy which tokens need to be scavenged
-// for now all tokens we get from persistent layer
+// Re-builds tokenDb with tokens that need to be scavenged.
+// Live and reclaimable bytes of each token come from the counters SM keeps
+// as objects are written and expire; only tokens whose objects may have
+// expired since they were last looked at get their object sets evaluated.
 void DiskScavenger::findTokensToCompact(fds_uint32_t token_reclaim_threshold) {
-    fds_uint32_t reclaim_percent;
     // note that we are not using lock here, because updateTokenDb()
     // and getNextCompactToken are serialized
 
     // reset tokenDb
     tokenDb.clear();
+    tokenOrder.clear();
+
+    struct TokenSpace {
+        fds_token_id tok;
+        fds_uint64_t live;
+        fds_uint64_t reclaim;
+        fds_uint32_t reclaimPercent() const {
+            return (live + reclaim) ? (reclaim * 100) / (live + reclaim) : 0;
+        }
+    };
 
     // get all tokens that SM owns and that reside on this disk
     SmTokenSet diskToks = smDiskMap->getSmTokens(disk_id);
     ObjectStorMgr* storMgr = dynamic_cast<ObjectStorMgr*>(dataStoreReqHandler);
-    bool fRefscanMessageSent = false;
-    // add tokens to tokenDb that we need to compact
+    TokenSpaceStats* tokenSpaceStats = storMgr ? storMgr->objectStore->tokenSpaceStats.get() : nullptr;
+    std::vector<TokenSpace> tokens;
     for (SmTokenSet::const_iterator cit = diskToks.cbegin();
          cit != diskToks.cend();
          ++cit) {
-        diskio::TokenStat stat;
-
-        if (g_fdsprocess->get_fds_config()->\
-            get<bool>("fds.feature_toggle.common.periodic_expunge", false)){
-            /**
-             * Evaluate all bloom filters for this particular SM token.
-             * and calculate SM token threshold.
-             */
-            if (storMgr) {
-                TimeStamp now = util::getTimeStampSeconds() * 1000 * 1000 * 1000;
-                storMgr->objectStore->liveObjectsTable->setTokenStartTime(*cit, disk_id, now);
-            }
-            persistStoreGcHandler->evaluateSMTokenObjSets(*cit, tier, stat);
-        } else {
+        TokenSpace ts {*cit, 0, 0};
+        if (!tokenSpaceStats || !tokenSpaceStats->get(*cit, tier, &ts.live, &ts.reclaim)) {
+            // not accounted for yet, start from the size of the token file
+            diskio::TokenStat stat;
             persistStoreGcHandler->getSmTokenStats(disk_id, *cit, tier, &stat);
+            ts.reclaim = std::min(stat.tkn_reclaim_size, stat.tkn_tot_size);
+            ts.live = stat.tkn_tot_size - ts.reclaim;
+            if (tokenSpaceStats) {
+                tokenSpaceStats->setIfUnknown(*cit, tier, ts.live, ts.reclaim);
+            }
+        }
+        tokens.push_back(ts);
+    }
+
+    if (storMgr && tokenSpaceStats &&
+        g_fdsprocess->get_fds_config()->\
+        get<bool>("fds.feature_toggle.common.periodic_expunge", false)) {
+        /**
+         * Objects expire when their token's object sets are evaluated, which
+         * walks all of the token's metadata. Only tokens with object sets newer
+         * than their last evaluation can have objects expire. Evaluate those
+         * that are worth compacting already first, then those evaluated the
+         * longest ago, at most max_eval_tokens of them.
+         */
+        auto& liveObjectsTable = storMgr->objectStore->liveObjectsTable;
+        fds_uint32_t maxEvalTokens = g_fdsprocess->get_fds_config()->\
+                get<fds_uint32_t>("fds.sm.scavenger.max_eval_tokens", 32);
+        std::vector<std::pair<fds_bool_t, TimeStamp>> evalOrder(tokens.size());
+        std::vector<fds_uint32_t> toEval;
+        for (fds_uint32_t i = 0; i < tokens.size(); ++i) {
+            if (!liveObjectsTable->hasNewObjectSets(tokens[i].tok, disk_id)) {
+                continue;
+            }
+            evalOrder[i].first = (tokens[i].reclaim == 0 ||
+                                  tokens[i].reclaimPercent() < token_reclaim_threshold);
+            evalOrder[i].second = liveObjectsTable->getTokenStartTime(tokens[i].tok, disk_id);
+            toEval.push_back(i);
+        }
+        std::sort(toEval.begin(), toEval.end(),
+                  [&evalOrder](fds_uint32_t a, fds_uint32_t b) {
+                      return evalOrder[a] < evalOrder[b];
+                  });
+        if (toEval.size() > maxEvalTokens) {
+            LOGNORMAL << "Disk " << disk_id << " evaluating " << maxEvalTokens
+                      << " of " << toEval.size() << " tokens with new object sets";
+            toEval.resize(maxEvalTokens);
+        }
+
+        for (auto i : toEval) {
+            TokenSpace& ts = tokens[i];
+            diskio::TokenStat stat;
+            TimeStamp now = util::getTimeStampSeconds() * 1000 * 1000 * 1000;
+            liveObjectsTable->setTokenStartTime(ts.tok, disk_id, now);
+            persistStoreGcHandler->evaluateSMTokenObjSets(ts.tok, tier, stat);
+            // pick up the objects that expired
+            tokenSpaceStats->get(ts.tok, tier, &ts.live, &ts.reclaim);
+            LOGDEBUG << "Disk " << disk_id << " token " << ts.tok
+                     << " evaluated, total objects " << stat.tkn_tot_size
+                     << ", deleted objects " << stat.tkn_reclaim_size;
         }
-        double tot_size = stat.tkn_tot_size;
-        reclaim_percent = (stat.tkn_reclaim_size / tot_size) * 100;
-        OBJECTSTOREMGR(dataStoreReqHandler)->counters->setScavengeInfo(stat.tkn_id,
-                                                                       stat.tkn_tot_size,
-                                                                       stat.tkn_reclaim_size
-                                                                       );
-        LOGDEBUG << "Disk " << disk_id << " token " << stat.tkn_id
-                 << " total objects " << stat.tkn_tot_size
-                 << ", deleted objects " << stat.tkn_reclaim_size
+    }
+
+    // Compacting a token reads all of it and rewrites its live data, rank
+    // tokens by reclaimed bytes per byte read and written
+    std::vector<TokenSpace> candidates;
+    for (const auto& ts : tokens) {
+        fds_uint32_t reclaim_percent = ts.reclaimPercent();
+        OBJECTSTOREMGR(dataStoreReqHandler)->counters->setScavengeInfo(ts.tok,
+                                                                       ts.live + ts.reclaim,
+                                                                       ts.reclaim);
+        LOGDEBUG << "Disk " << disk_id << " token " << ts.tok
+                 << " live bytes " << ts.live
+                 << ", reclaimable bytes " << ts.reclaim
                  << " (" << reclaim_percent << "%)";
 
-        if (stat.tkn_reclaim_size > 0 &&
+        if (ts.reclaim > 0 &&
             reclaim_percent >= token_reclaim_threshold) {
-                tokenDb.insert(stat.tkn_id);
-                LOGNOTIFY << "TC will run for token:" << stat.tkn_id
-                          << " disk:" << disk_id
-                          << " [objects total:" << stat.tkn_tot_size
-                          << " deleted:" << stat.tkn_reclaim_size
-                          << " (" << reclaim_percent << "%)]";
+            candidates.push_back(ts);
         }
     }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const TokenSpace& a, const TokenSpace& b) {
+                  // a.reclaim / (a.reclaim + 2 * a.live) > b.reclaim / (b.reclaim + 2 * b.live)
+                  return static_cast<double>(a.reclaim) * (b.reclaim + 2 * b.live) >
+                         static_cast<double>(b.reclaim) * (a.reclaim + 2 * a.live);
+              });
+
+    for (const auto& ts : candidates) {
+        tokenDb.insert(ts.tok);
+        tokenOrder.push_back(ts.tok);
+        LOGNOTIFY << "TC will run for token:" << ts.tok
+                  << " disk:" << disk_id
+                  << " [bytes live:" << ts.live
+                  << " reclaimable:" << ts.reclaim
+                  << " (" << ts.reclaimPercent() << "%)]";
+    }
+
+    if (tokenSpaceStats) {
+        tokenSpaceStats->flush();
+    }
 }
 
 Error DiskScavenger::startScavenge(fds_bool_t verify,
@@ -883,22 +945,11 @@ DiskScavenger::getProgress(fds_uint32_t *toksCompacting,
         return;
     }
 
-    // we already got scavenger lock, and this map changes
-    fds_uint32_t count = 0;
-    fds_uint32_t nextTok = next_token;
     // TODO(Anna) make next_token atomic,.. ok here, because we do not
     // need to be super exact in progress reporting
-    for (std::set<fds_token_id>::const_iterator cit = tokenDb.cbegin();
-         cit != tokenDb.cend();
-         ++cit) {
-        if (*cit < nextTok) {
-            ++count;
-        } else {
-            break;
-        }
-    }
-    *toksCompacting = tokenDb.size();
-    *toksFinished = count;
+    fds_uint32_t nextTok = next_token;
+    *toksCompacting = tokenOrder.size();
+    *toksFinished = std::min(nextTok, *toksCompacting);
     LOGNORMAL << "Disk:" << disk_id << " progress: " << *toksCompacting
               << " total tokens compacting, " << *toksFinished
               << " total tokens finished compaction";
@@ -920,6 +971,15 @@ void DiskScavenger::compactionDoneCb(fds_token_id token_id, const Error& error)
               << " error: " << error;
 
     OBJECTSTOREMGR(dataStoreReqHandler)->counters->compactorRunning.decr();
+    if (error.ok()) {
+        // the token's file holds only live data now
+        ObjectStorMgr* storMgr = dynamic_cast<ObjectStorMgr*>(dataStoreReqHandler);
+        if (storMgr) {
+            diskio::TokenStat stat;
+            persistStoreGcHandler->getSmTokenStats(disk_id, token_id, tier, &stat);
+            storMgr->objectStore->tokenSpaceStats->setCompacted(token_id, tier, stat.tkn_tot_size);
+        }
+    }
     if (curState == SCAV_STATE_STOPPING) {
         // Scavenger was asked to stop, so not compacting any more tokens
         std::atomic_store(&state, SCAV_STATE_IDLE);
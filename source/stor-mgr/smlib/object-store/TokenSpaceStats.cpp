@@ -0,0 +1,152 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <fds_assert.h>
+#include <util/Log.h>
+#include <object-store/LiveObjectsDB.h>
+#include <object-store/TokenSpaceStats.h>
+
+namespace fds {
+
+TokenSpaceStats::TokenSpaceStats(LiveObjectsDB *db)
+        : db(db),
+          flushLock("TokenSpaceStats flush lock") {
+}
+
+void
+TokenSpaceStats::load() {
+    fds_uint32_t loaded = 0;
+    for (fds_token_id tok = 0; tok < SMTOKEN_COUNT; ++tok) {
+        for (fds_uint16_t tier = 0; tier < diskio::maxTier; ++tier) {
+            fds_uint64_t live = 0, reclaim = 0;
+            if (!db || !db->getTokenSpace(tok, tier, live, reclaim).ok()) {
+                continue;
+            }
+            Counters &c = tokens[tok][tier];
+            c.live = live;
+            c.reclaim = reclaim;
+            c.known = true;
+            ++loaded;
+        }
+    }
+    LOGNORMAL << "Loaded space stats of " << loaded << " token files";
+}
+
+void
+TokenSpaceStats::flush() {
+    fds_mutex::scoped_lock l(flushLock);
+    for (fds_token_id tok = 0; tok < SMTOKEN_COUNT; ++tok) {
+        for (fds_uint16_t tier = 0; tier < diskio::maxTier; ++tier) {
+            Counters &c = tokens[tok][tier];
+            // clear first, so changes made while persisting are flushed next time
+            if (!c.dirty.exchange(false) || !c.known) {
+                continue;
+            }
+            if (db && !db->setTokenSpace(tok, tier, c.live, c.reclaim).ok()) {
+                c.dirty = true;
+            }
+        }
+    }
+}
+
+TokenSpaceStats::Counters*
+TokenSpaceStats::counters(fds_token_id smToken, diskio::DataTier tier) {
+    fds_assert(smToken < SMTOKEN_COUNT);
+    if (smToken >= SMTOKEN_COUNT || tier < 0 || tier >= diskio::maxTier) {
+        return nullptr;
+    }
+    return &tokens[smToken][tier];
+}
+
+void
+TokenSpaceStats::subtract(std::atomic<fds_uint64_t> &counter, fds_uint64_t bytes) {
+    fds_uint64_t cur = counter.load();
+    while (!counter.compare_exchange_weak(cur, (cur > bytes) ? cur - bytes : 0)) {
+    }
+}
+
+void
+TokenSpaceStats::addLive(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes) {
+    Counters *c = counters(smToken, tier);
+    if (c) {
+        c->live += bytes;
+        c->dirty = true;
+    }
+}
+
+void
+TokenSpaceStats::addReclaimable(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes) {
+    Counters *c = counters(smToken, tier);
+    if (c) {
+        subtract(c->live, bytes);
+        c->reclaim += bytes;
+        c->dirty = true;
+    }
+}
+
+void
+TokenSpaceStats::reviveReclaimable(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t bytes) {
+    Counters *c = counters(smToken, tier);
+    if (c) {
+        subtract(c->reclaim, bytes);
+        c->live += bytes;
+        c->dirty = true;
+    }
+}
+
+void
+TokenSpaceStats::setCompacted(fds_token_id smToken, diskio::DataTier tier, fds_uint64_t liveBytes) {
+    Counters *c = counters(smToken, tier);
+    if (c) {
+        c->live = liveBytes;
+        c->reclaim = 0;
+        c->known = true;
+        c->dirty = true;
+    }
+}
+
+void
+TokenSpaceStats::setIfUnknown(fds_token_id smToken, diskio::DataTier tier,
+                              fds_uint64_t liveBytes, fds_uint64_t reclaimBytes) {
+    Counters *c = counters(smToken, tier);
+    fds_bool_t known = false;
+    if (c && c->known.compare_exchange_strong(known, true)) {
+        c->live = liveBytes;
+        c->reclaim = reclaimBytes;
+        c->dirty = true;
+    }
+}
+
+void
+TokenSpaceStats::removeToken(fds_token_id smToken) {
+    for (fds_uint16_t tier = 0; tier < diskio::maxTier; ++tier) {
+        Counters *c = counters(smToken, static_cast<diskio::DataTier>(tier));
+        if (!c) {
+            return;
+        }
+        c->known = false;
+        c->live = 0;
+        c->reclaim = 0;
+    }
+    if (db) {
+        db->removeTokenSpace(smToken);
+    }
+}
+
+fds_bool_t
+TokenSpaceStats::get(fds_token_id smToken, diskio::DataTier tier,
+                     fds_uint64_t *liveBytes, fds_uint64_t *reclaimBytes) const {
+    if (smToken >= SMTOKEN_COUNT || tier < 0 || tier >= diskio::maxTier) {
+        return false;
+    }
+    const Counters &c = tokens[smToken][tier];
+    if (!c.known) {
+        return false;
+    }
+    *liveBytes = c.live;
+    *reclaimBytes = c.reclaim;
+    return true;
+}
+
+}  // namespace fds
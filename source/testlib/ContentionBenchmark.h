@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#ifndef SOURCE_TESTLIB_CONTENTIONBENCHMARK_H_
+#define SOURCE_TESTLIB_CONTENTIONBENCHMARK_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace fds {
+namespace TestUtils {
+
+/**
+* @brief Runs work() once on each of nThreads threads.  The threads are
+* started first and released together so thread creation isn't timed.
+*
+* @param opsPerThread number of operations every work() call performs
+*
+* @return aggregate operations per second
+*/
+template <class Work>
+double runContended(unsigned nThreads, uint64_t opsPerThread, Work work)
+{
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&go, &work]() {
+            while (!go.load()) {
+            }
+            work();
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return (nThreads * opsPerThread) / elapsed.count();
+}
+
+/**
+* @brief Same as above for the common case of every thread calling op(i) for
+* i in [0, opsPerThread).
+*/
+template <class Op>
+double runContendedOps(unsigned nThreads, uint64_t opsPerThread, Op op)
+{
+    return runContended(nThreads, opsPerThread, [&op, opsPerThread]() {
+        for (uint64_t i = 0; i < opsPerThread; ++i) {
+            op(i);
+        }
+    });
+}
+
+}  // namespace TestUtils
+}  // namespace fds
+
+#endif  // SOURCE_TESTLIB_CONTENTIONBENCHMARK_H_
@@ -0,0 +1,66 @@
+#ifndef TESTSM_HPP_
+#define TESTSM_HPP_
+
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <fds_process.h>
+#include <fdsp/PlatNetSvc.h>
+#include <net/SvcMgr.h>
+#include <net/SvcProcess.h>
+#include <net/PlatNetSvcHandler.h>
+#include <StorMgr.h>
+#include <SMSvcHandler.h>
+#include <persistent-layer/dm_io.h>
+#include "fdsp/common_constants.h"
+#include <fdsp/SMSvc.h>
+
+namespace fds {
+
+/**
+* @brief SM that runs inside the test process.  Pass
+* --fds.sm.testing.standalone=true to run it without a DLT from OM.
+*/
+struct TestSm : SvcProcess {
+    TestSm(int argc, char *argv[], bool initAsModule);
+    virtual int run() override;
+    ObjectStorMgr* getStorMgr() { return sm; }
+
+    ObjectStorMgr *sm;
+    fds::Module *smVec[3];
+};
+
+TestSm::TestSm(int argc, char *argv[], bool initAsModule)
+{
+    sm = new ObjectStorMgr(this);
+    // TODO(Rao): Get rid of this singleton
+    objStorMgr = sm;
+    smVec[0] = &diskio::gl_dataIOMod;
+    smVec[1] = sm;
+    smVec[2] = nullptr;
+
+    auto handler = boost::make_shared<SMSvcHandler>(this);
+    auto processor = boost::make_shared<fpi::SMSvcProcessor>(handler);
+
+    TProcessorMap processors;
+    processors.insert(std::make_pair<std::string,
+        boost::shared_ptr<apache::thrift::TProcessor>>(
+            fpi::commonConstants().SM_SERVICE_NAME, processor));
+    processors.insert(std::make_pair<std::string,
+        boost::shared_ptr<apache::thrift::TProcessor>>(
+            fpi::commonConstants().PLATNET_SERVICE_NAME, processor));
+
+    init(argc, argv, initAsModule, "platform.conf",
+         "fds.sm.", "sm.log", smVec, handler, processors);
+}
+
+int TestSm::run() {
+    LOGNORMAL << "Doing work";
+    readyWaiter.done();
+    shutdownGate_.waitUntilOpened();
+    return 0;
+}
+
+}  // namespace fds
+
+#endif    // TESTSM_HPP_
@@ -566,3 +566,55 @@ class ServiceContext(Context):
             except Exception, e:
                 print "Failed to fetch state.  Either service is down or argument is incorrect"
         return
+
+    #--------------------------------------------------------------------------------------
+    @clidebugcmd
+    @arg('svcids', help= "services to collect traces from", type=str, nargs='*', default=['am', 'dm', 'sm'])
+    @arg('-r','--raw', help= "print every trace", action='store_true', default=False)
+    def stagetrace(self, svcids, raw=False):
+        'collect sampled stage traces (fds.common.stage_trace_sample_rate) and show per stage latencies'
+        traces = {}
+        dropped = 0
+        for pattern in svcids:
+            for uuid in self.getServiceIds(pattern):
+                try:
+                    name = self.getServiceName(uuid)
+                    events = ServiceMap.client(uuid).getCounters('stagetrace')
+                except Exception, e:
+                    log.exception(e)
+                    print 'unable to get stage traces from {}'.format(uuid)
+                    continue
+                for key, ts in events.iteritems():
+                    # <trace id>.<seq>.<stage>.<arg>, stage names hold dots
+                    parts = key.split('.')
+                    if not parts[0].isdigit():
+                        dropped += ts if key == 'stagetrace.dropped' else 0
+                        continue
+                    stage = '.'.join(parts[2:-1])
+                    traces.setdefault(parts[0], []).append((ts, name.split(':')[0], stage))
+
+        # Time between consecutive events of a trace, in the order they happened
+        steps = {}
+        for traceid, events in traces.iteritems():
+            events.sort()
+            if raw:
+                print ('{}\ntrace {}\n{}'.format('-'*40, traceid, '-'*40))
+                print tabulate([((ts - events[0][0]) / 1000, svc, stage) for ts, svc, stage in events],
+                               headers=['us', 'service', 'stage'], tablefmt=self.config.getTableFormat())
+            for prev, cur in zip(events, events[1:]):
+                step = '{}:{} -> {}:{}'.format(prev[1], prev[2], cur[1], cur[2])
+                steps.setdefault(step, []).append((cur[0] - prev[0]) / 1000)
+            steps.setdefault('end to end', []).append((events[-1][0] - events[0][0]) / 1000)
+
+        def pct(values, p):
+            return values[int(p / 100.0 * (len(values) - 1))]
+
+        data = []
+        for step, values in steps.iteritems():
+            values.sort()
+            data.append((step, len(values), pct(values, 50), pct(values, 90), pct(values, 99), values[-1]))
+        data.sort(key=itemgetter(1), reverse=True)
+        print 'traces: {} dropped events: {}'.format(len(traces), dropped)
+        if len(data) > 0:
+            print tabulate(data, headers=['step', 'count', 'p50 us', 'p90 us', 'p99 us', 'max us'],
+                           tablefmt=self.config.getTableFormat())
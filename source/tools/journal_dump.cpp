@@ -13,6 +13,7 @@
 #include <boost/scoped_ptr.hpp>
 
 // Internal includes.
+#include "catalogKeys/BlobExtentKey.h"
 #include "catalogKeys/BlobMetadataKey.h"
 #include "catalogKeys/BlobObjectKey.h"
 #include "catalogKeys/CatalogKeyType.h"
@@ -21,6 +22,7 @@
 #include "db/log_reader.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
+#include "dm-vol-cat/DmExtentPage.h"
 #include "dm-vol-cat/DmPersistVolCat.h"
 #include "leveldb/cat_journal.h"
 #include "leveldb/env.h"
@@ -83,6 +85,21 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
                           << "]\n";
                 break;
             }
+            case fds::CatalogKeyType::BLOB_EXTENTS: {
+                BlobExtentKey blobExtentKey { key };
+                fds::DmExtentPage page;
+                page.loadSerialized(value.data(), value.size());
+                std::cout << "=> put extents [blob=" << blobExtentKey.getBlobName()
+                          << " page=" << blobExtentKey.getPageIndex()
+                          << " objects=" << page.size()
+                          << "]\n";
+                uint64_t const base = static_cast<uint64_t>(blobExtentKey.getPageIndex())
+                        * fds::DmExtentPage::OBJECTS_PER_PAGE;
+                page.forEachObject([base](fds_uint32_t slot, const fds::ObjectID & obj) {
+                    std::cout << "  [index=" << base + slot << " obj=" << obj.ToHex() << "]\n";
+                });
+                break;
+            }
             case fds::CatalogKeyType::BLOB_METADATA: {
                 fds::BlobMetaDesc blobMeta;
                 blobMeta.loadSerialized(std::string{value.data(), value.size()});
@@ -156,6 +173,12 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
                           << " index=" << blobObjectKey.getObjectIndex() << "]\n";
                 break;
             }
+            case fds::CatalogKeyType::BLOB_EXTENTS: {
+                BlobExtentKey blobExtentKey { key };
+                std::cout << "=> del extents [blob=" << blobExtentKey.getBlobName()
+                          << " page=" << blobExtentKey.getPageIndex() << "]\n";
+                break;
+            }
             case fds::CatalogKeyType::BLOB_METADATA: {
                 BlobMetadataKey blobMetaKey { key };
                 std::cout << "=> del [blobmeta=" << blobMetaKey.getBlobName() << "]\n";
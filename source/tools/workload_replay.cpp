@@ -0,0 +1,322 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+/**
+ * Replays a workload captured with "capture.start" (see net/WorkloadCapture.h)
+ * through the service layer of an in-process fake domain.
+ *
+ * Every captured request is sent from one fake service to another with its
+ * original message type and payload size, at the original pace or sped up.
+ * The receiving side answers after the service time that was captured for the
+ * request (the gap between its REQUEST_IN and RESPONSE_OUT records), or right
+ * away with --no-service-time, so the numbers reported are those of the
+ * service layer under the production request mix.
+ *
+ *   workload-replay --capture am.capture --fds-root /fds --speed 4
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+
+#include <net/WorkloadCapture.h>
+#include <testlib/FakeSvcDomain.hpp>
+
+namespace po = boost::program_options;
+using namespace fds;  // NOLINT
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayRequest {
+    WorkloadRecord      request;
+    StringPtr           payload;
+    /* From the matching RESPONSE_OUT, zero when it wasn't captured */
+    uint64_t            serviceTimeNs {0};
+    int32_t             respTypeId {fpi::EmptyMsgTypeId};
+    uint32_t            respSize {0};
+};
+
+/**
+ * Answers the requests the fake server receives once their service time is up
+ */
+class DelayedResponder {
+  public:
+    explicit DelayedResponder(PlatNetSvcHandlerPtr handler)
+            : handler_(handler), thread_(&DelayedResponder::run, this) {
+    }
+    ~DelayedResponder() {
+        {
+            std::lock_guard<std::mutex> g(lock_);
+            stopping_ = true;
+        }
+        cond_.notify_one();
+        thread_.join();
+    }
+
+    void respond(Clock::time_point due, fpi::AsyncHdrPtr header,
+                 const ReplayRequest* req) {
+        if (due <= Clock::now()) {
+            send(*header, req);
+            return;
+        }
+        std::lock_guard<std::mutex> g(lock_);
+        pending_.push(Pending{due, header, req});
+        cond_.notify_one();
+    }
+
+  private:
+    struct Pending {
+        Clock::time_point       due;
+        fpi::AsyncHdrPtr        header;
+        const ReplayRequest*    req;
+        bool operator>(const Pending& rhs) const { return due > rhs.due; }
+    };
+
+    void send(const fpi::AsyncHdr& header, const ReplayRequest* req) {
+        auto payload = boost::make_shared<std::string>(req->respSize, '\0');
+        handler_->sendAsyncResp_(header, static_cast<fpi::FDSPMsgTypeId>(req->respTypeId),
+                                 payload);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> g(lock_);
+        while (!stopping_) {
+            if (pending_.empty()) {
+                cond_.wait(g);
+                continue;
+            }
+            auto due = pending_.top().due;
+            if (Clock::now() < due) {
+                cond_.wait_until(g, due);
+                continue;
+            }
+            Pending p = pending_.top();
+            pending_.pop();
+            g.unlock();
+            send(*p.header, p.req);
+            g.lock();
+        }
+    }
+
+    PlatNetSvcHandlerPtr                handler_;
+    std::mutex                          lock_;
+    std::condition_variable             cond_;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending_;
+    bool                                stopping_ {false};
+    std::thread                         thread_;
+};
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(pct / 100.0 * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+void printLatencies(const std::string& name, std::vector<uint64_t>& latUs) {
+    std::sort(latUs.begin(), latUs.end());
+    std::cout << std::left << std::setw(12) << name
+              << " p50: " << percentile(latUs, 50)
+              << " p90: " << percentile(latUs, 90)
+              << " p99: " << percentile(latUs, 99)
+              << " p99.9: " << percentile(latUs, 99.9)
+              << " max: " << (latUs.empty() ? 0 : latUs.back()) << " (us)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string capturePath;
+    std::string fdsRoot;
+    double speed = 1.0;
+    uint32_t window = 256;
+    uint32_t timeoutMs = 5000;
+    bool noServiceTime = false;
+    bool synthPayloads = false;
+
+    po::options_description desc("Replays a captured service layer workload");
+    desc.add_options()
+        ("help,h", "show this help")
+        ("capture,c", po::value<std::string>(&capturePath)->required(), "capture file")
+        ("fds-root", po::value<std::string>(&fdsRoot)->default_value("/fds"),
+         "fds root holding etc/platform.conf")
+        ("speed,s", po::value<double>(&speed)->default_value(1.0),
+         "pace relative to the capture, 0 sends as fast as the window allows")
+        ("window,w", po::value<uint32_t>(&window)->default_value(256),
+         "max outstanding requests")
+        ("timeout", po::value<uint32_t>(&timeoutMs)->default_value(5000),
+         "request timeout in ms")
+        ("no-service-time", po::bool_switch(&noServiceTime),
+         "respond right away instead of after the captured service time")
+        ("synth-payloads", po::bool_switch(&synthPayloads),
+         "send zeroed payloads even if the capture holds the originals");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        po::notify(vm);
+    } catch (const po::error& e) {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+
+    /* Load the capture, pairing each request with its response */
+    WorkloadCapture::Reader reader;
+    Error err = reader.open(capturePath);
+    if (!err.ok()) {
+        std::cerr << "Failed to open capture " << capturePath << ": " << err << std::endl;
+        return 1;
+    }
+    std::vector<ReplayRequest> requests;
+    std::unordered_map<int64_t, size_t> byReqId;
+    WorkloadRecord rec;
+    std::string payload;
+    while (reader.next(rec, payload)) {
+        if (rec.direction == WorkloadRecord::REQUEST_IN) {
+            ReplayRequest req;
+            req.request = rec;
+            req.payload = boost::make_shared<std::string>();
+            if (!synthPayloads && rec.storedSize == rec.payloadSize) {
+                req.payload->swap(payload);
+            } else {
+                req.payload->assign(rec.payloadSize, '\0');
+            }
+            byReqId[rec.reqId] = requests.size();
+            requests.push_back(std::move(req));
+        } else {
+            auto itr = byReqId.find(rec.reqId);
+            if (itr == byReqId.end()) {
+                continue;
+            }
+            ReplayRequest& req = requests[itr->second];
+            req.serviceTimeNs = rec.timestampNs - req.request.timestampNs;
+            req.respTypeId = rec.msgTypeId;
+            req.respSize = rec.payloadSize;
+            byReqId.erase(itr);
+        }
+    }
+    if (requests.empty()) {
+        std::cerr << "No requests in " << capturePath << std::endl;
+        return 1;
+    }
+
+    /* Client is service 1, server is service 2 */
+    FakeSyncSvcDomain domain(3, fdsRoot);
+    auto serverHandler = domain[2]->getSvcMgr()->getSvcRequestHandler();
+    auto serverUuid = domain.getFakeSvcUuid(2);
+    DelayedResponder responder(serverHandler);
+
+    /* Request id on the wire -> what is being replayed */
+    std::mutex inflightLock;
+    std::unordered_map<SvcRequestId, const ReplayRequest*> inflight;
+
+    PlatNetSvcHandler::FdspMsgHandler serve =
+        [&](fpi::AsyncHdrPtr& header, StringPtr&) {
+            const ReplayRequest* req;
+            {
+                std::lock_guard<std::mutex> g(inflightLock);
+                auto itr = inflight.find(header->msg_src_id);
+                if (itr == inflight.end()) {
+                    return;
+                }
+                req = itr->second;
+            }
+            header->msg_code = ERR_OK;
+            auto delay = std::chrono::nanoseconds(noServiceTime ? 0 : req->serviceTimeNs);
+            responder.respond(Clock::now() + delay, header, req);
+        };
+    for (auto const& req : requests) {
+        domain[2]->updateMsgHandler(static_cast<fpi::FDSPMsgTypeId>(req.request.msgTypeId),
+                                    serve);
+    }
+
+    std::mutex doneLock;
+    std::condition_variable doneCond;
+    uint32_t outstanding = 0;
+    std::vector<uint64_t> latUs;
+    std::vector<uint64_t> capturedUs;
+    latUs.reserve(requests.size());
+    uint64_t errors = 0;
+
+    auto svcReqMgr = domain[1]->getSvcMgr()->getSvcRequestMgr();
+    uint64_t firstTs = requests.front().request.timestampNs;
+    auto start = Clock::now();
+    for (auto const& req : requests) {
+        if (speed > 0) {
+            auto offset = std::chrono::nanoseconds(
+                static_cast<uint64_t>((req.request.timestampNs - firstTs) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+        {
+            std::unique_lock<std::mutex> g(doneLock);
+            doneCond.wait(g, [&] { return outstanding < window; });
+            ++outstanding;
+        }
+        if (req.serviceTimeNs > 0) {
+            capturedUs.push_back(req.serviceTimeNs / 1000);
+        }
+
+        auto sent = Clock::now();
+        auto asyncReq = svcReqMgr->newEPSvcRequest(serverUuid);
+        {
+            std::lock_guard<std::mutex> g(inflightLock);
+            inflight[asyncReq->getRequestId()] = &req;
+        }
+        asyncReq->setPayloadBuf(static_cast<fpi::FDSPMsgTypeId>(req.request.msgTypeId),
+                                req.payload);
+        asyncReq->setTimeoutMs(timeoutMs);
+        asyncReq->onResponseCb(
+            [&, sent](EPSvcRequest* r, const Error& e, StringPtr) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - sent).count();
+                {
+                    std::lock_guard<std::mutex> g(inflightLock);
+                    inflight.erase(r->getRequestId());
+                }
+                std::lock_guard<std::mutex> g(doneLock);
+                if (e.ok()) {
+                    latUs.push_back(elapsed);
+                } else {
+                    ++errors;
+                }
+                --outstanding;
+                doneCond.notify_all();
+            });
+        asyncReq->invoke();
+    }
+    {
+        std::unique_lock<std::mutex> g(doneLock);
+        doneCond.wait(g, [&] { return outstanding == 0; });
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    double capturedSecs = (requests.back().request.timestampNs - firstTs) / 1e9;
+
+    std::cout << "requests:   " << requests.size() << " errors: " << errors << std::endl;
+    std::cout << "duration:   " << elapsed.count() << "s (captured "
+              << capturedSecs << "s)" << std::endl;
+    std::cout << "throughput: " << static_cast<uint64_t>(requests.size() / elapsed.count())
+              << " req/s" << std::endl;
+    printLatencies("replayed", latUs);
+    printLatencies("captured", capturedUs);
+    return errors == 0 ? 0 : 2;
+}
@@ -35,11 +35,19 @@ void createLatencyCounter(fds::PerfContext & ctx) {
         ctx.start_cycle = ctx.end_cycle;
     }
 
-    fds::LatencyCounter * plc = new fds::LatencyCounter(ctx.name, ctx.volid, 0);
+    /* Only read back once below, the sharded LatencyCounter is for long lived counters */
+    fds::SimpleLatencyCounter * plc = new fds::SimpleLatencyCounter(ctx.name, ctx.volid, 0);
     plc->update(ctx.end_cycle - ctx.start_cycle);
     ctx.data.reset(plc);
 }
 
+/* Exported latency counters also report percentiles */
+void trackPercentiles(fds::LatencyCounter * plc) {
+    plc->trackPercentiles();
+}
+
+void trackPercentiles(fds::FdsBaseCounter *) {}
+
 // FIXME(matteo): ctx may be useless here
 template <typename T>
 void initializeCounter(fds::PerfContext * ctx, fds::FdsCounters * parent,
@@ -59,7 +67,11 @@ void initializeCounter(fds::PerfContext * ctx, fds::FdsCounters * parent,
         counterName += "." + name;
     }
 
-    ctx->data.reset(new T(counterName, volid, parent));
+    T * counter = new T(counterName, volid, parent);
+    if (parent) {
+        trackPercentiles(counter);
+    }
+    ctx->data.reset(counter);
 }
 
 void stringToEventsFilter(const std::string & str, std::bitset<fds_enum::get_size<fds::PerfEventType>()> & filter) {
@@ -404,8 +416,7 @@ void PerfTracer::tracePointEnd(PerfContext & ctx) {
     // Avoid creating a counter if counter has not been properly initialized. Print warning instead
     if (ctx.type != PerfEventType::TRACE) {
         createLatencyCounter(ctx);
-        LatencyCounter * plc = static_cast<LatencyCounter *>(ctx.data.get()); //NOLINT
-        incr(ctx.type, ctx.volid, plc->total_latency(), plc->count(), ctx.name);
+        incr(ctx.type, ctx.volid, ctx.end_cycle - ctx.start_cycle, 1, ctx.name);
     } else {
         GLOGTRACE << "Counter wothout a name or type -  name: "
                   << ctx.name << " type: " << ctx.type;
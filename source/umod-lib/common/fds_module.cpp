@@ -545,6 +545,7 @@ FdsRootDir::FdsRootDir(const std::string &root)
       d_var_inventory(root + std::string("var/inventory/")),
       d_var_tests(root     + std::string("var/tests/")),
       d_var_tools(root     + std::string("var/tools/")),
+      d_var_captures(root  + std::string("var/captures/")),
       d_dev(root           + std::string("dev/")),
       d_user_repo(root     + std::string("user-repo/")),
       d_filetransfer(root  + std::string("user-repo/filetransfer/")),
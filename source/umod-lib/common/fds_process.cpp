@@ -232,13 +232,19 @@ void FdsProcess::init(int argc, char *argv[],
          * Create a global logger.  Logger is created here because we need the file
          * name from config
          */
+        /* Async logging keeps log file IO off the IO threads */
+        bool logAsync = conf_helper_.get<bool>("log_async", false);
         if (def_log_file == "") {
             g_fdslog = new fds_log(proc_root->dir_fds_logs() +
                                    conf_helper_.get<std::string>("logfile"),
-                                   proc_root->dir_fds_logs());
+                                   proc_root->dir_fds_logs(),
+                                   fds_log::normal,
+                                   logAsync);
         } else {
             g_fdslog = new fds_log(proc_root->dir_fds_logs() + def_log_file,
-                                   proc_root->dir_fds_logs());
+                                   proc_root->dir_fds_logs(),
+                                   fds_log::normal,
+                                   logAsync);
         }
 
         /* Process wide counters setup */
@@ -289,7 +295,15 @@ void FdsProcess::init(int argc, char *argv[],
 
     /* Adding a timer task to periodically flush all buffered log data to files */
     timer_servicePtr_->scheduledFunctionRepeated(std::chrono::seconds(10),
-                                                 []() { g_fdslog->flush(); });
+                                                 []() {
+        g_fdslog->flush();
+        static uint64_t lastDropped = 0;
+        uint64_t dropped = g_fdslog->droppedRecords();
+        if (dropped != lastDropped) {
+            GLOGWARN << "log queues full, dropped " << dropped - lastDropped << " records";
+            lastDropped = dropped;
+        }
+    });
 
     auto& config = *conf_helper_.get_fds_config();
     const libconfig::Setting& fdsSettings = config.getConfig().getRoot();
@@ -799,6 +813,7 @@ void FdsProcess::setup_cntrs_mgr(const std::string &mgr_id)
     cntrs_mgrPtr_.reset(new FdsCountersMgr(mgr_id));
     g_cntrs_mgr = cntrs_mgrPtr_;
     new ResourceUsageCounter(g_cntrs_mgr->get_default_counters());
+    new ObjectPoolCounter(g_cntrs_mgr->get_default_counters());
 }
 
 void FdsProcess::setup_timer_service()
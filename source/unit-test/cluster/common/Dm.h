@@ -76,6 +76,7 @@ struct DmHandler: PlatNetSvcHandler {
 
     template <class QosVolumeIoT, typename F>
     void registerHandler(F volidFunc) {
+        asyncReqMsgHandlers_.erase(QosVolumeIoT::reqMsgTypeId);
         asyncReqHandlers_[QosVolumeIoT::reqMsgTypeId] =
             [this, volidFunc] (SHPTR<fpi::AsyncHdr>& asyncHdr,
                     SHPTR<std::string>& payloadBuf)
@@ -0,0 +1,394 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+
+/**
+ * End to end data path benchmark.  Stands up OM, AM, DM and SM in this
+ * process on a temp fds root, talking over the real service layer, and drives
+ * the messages AM sends for S3 and block IO:
+ *
+ *   PUT:  PutObjectMsg to SM, then UpdateCatalogOnceMsg to DM
+ *   GET:  QueryCatalogMsg to DM, then GetObjectMsg to SM
+ *   LIST: GetBucketMsg to DM
+ *
+ * Every stage is timed on its own as well as the whole operation, so one run
+ * tells which layer a regression is in.  Results go out as JSON:
+ *
+ *   datapath_bench_gtest --workloads=s3put,s3get,block4k-rand --obj-sizes=4096,1048576
+ *                          --ops=20000 --concurrency=32 --dedup-ratio=0.5 --json-out=out.json
+ */
+#define GTEST_USE_OWN_TR1_TUPLE 0
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <json/json.h>
+#include <ObjectId.h>
+#include <fdsp_utils.h>
+#include <fdsp/sm_api_types.h>
+#include <testlib/DmGroupFixture.hpp>
+#include <testlib/TestSm.hpp>
+
+using namespace fds;  // NOLINT
+using namespace fds::TestUtils;  // NOLINT
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsedNs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/**
+ * Latencies and bytes moved by one stage of a workload
+ */
+struct StageStats {
+    void record(uint64_t latNs, uint64_t bytes, const Error &e) {
+        std::lock_guard<std::mutex> g(lock);
+        if (!e.ok()) {
+            ++errors;
+            return;
+        }
+        latencies.push_back(latNs);
+        this->bytes += bytes;
+    }
+
+    Json::Value toJson(double seconds) {
+        std::lock_guard<std::mutex> g(lock);
+        std::sort(latencies.begin(), latencies.end());
+        auto pctUs = [this](double pct) -> Json::Value::UInt64 {
+            if (latencies.empty()) {
+                return 0;
+            }
+            return latencies[static_cast<size_t>(pct / 100.0 * (latencies.size() - 1))] / 1000;
+        };
+        Json::Value v;
+        v["ops"] = static_cast<Json::Value::UInt64>(latencies.size());
+        v["errors"] = static_cast<Json::Value::UInt64>(errors);
+        v["ops_per_sec"] = latencies.size() / seconds;
+        v["mb_per_sec"] = bytes / seconds / (1024 * 1024);
+        v["p50_us"] = pctUs(50);
+        v["p99_us"] = pctUs(99);
+        v["p999_us"] = pctUs(99.9);
+        return v;
+    }
+
+    std::mutex              lock;
+    std::vector<uint64_t>   latencies;
+    uint64_t                bytes {0};
+    uint64_t                errors {0};
+};
+
+struct WorkloadSpec {
+    std::string     name;
+    uint32_t        objSize;
+    uint64_t        ops;
+    uint32_t        concurrency;
+    double          dedupRatio;
+};
+
+}  // namespace
+
+struct DataPathBench : DmGroupFixture {
+    using SmHandle = ProcessHandle<TestSm>;
+
+    /* OM, AM, one DM and one SM on the same temp root, volume v1 open on AM */
+    void createDataPath() {
+        createCluster(1);
+        smHandle.start({"sm",
+                       roots[0],
+                       util::strformat("--fds.pm.platform_uuid=%d", getPlatformUuid(0)),
+                       util::strformat("--fds.pm.platform_port=%d", getPlatformPort(0)),
+                       "--fds.sm.testing.standalone=true"
+                       });
+        smUuid = smHandle.proc->getSvcMgr()->getSelfSvcUuid();
+        setupVolumeGroupHandleOnAm1(1);
+        Error e = ObjectStorMgr::registerVolume(v1Id, v1Desc.get(),
+                                                fpi::FDSP_NOTIFY_VOL_NO_FLAG, fpi::FDSP_ERR_OK);
+        ASSERT_TRUE(e == ERR_OK);
+    }
+
+    /* Object contents.  With dedupRatio of the puts repeating earlier contents */
+    StringPtr nextObject(uint32_t size, double dedupRatio) {
+        std::lock_guard<std::mutex> g(genLock);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        uint64_t stamp;
+        if (uniqueObjs > 0 && coin(rng) < dedupRatio) {
+            stamp = std::uniform_int_distribution<uint64_t>(0, uniqueObjs - 1)(rng);
+        } else {
+            stamp = uniqueObjs++;
+        }
+        if (baseData.size() < size) {
+            baseData = *RandAlphaNumStringF()(size);
+        }
+        auto data = boost::make_shared<std::string>(baseData, 0, size);
+        memcpy(&(*data)[0], &stamp, std::min<size_t>(sizeof(stamp), size));
+        return data;
+    }
+
+    void acquireSlot(uint32_t concurrency) {
+        std::unique_lock<std::mutex> g(slotLock);
+        slotCond.wait(g, [this, concurrency] { return outstanding < concurrency; });
+        ++outstanding;
+    }
+
+    void releaseSlot() {
+        std::lock_guard<std::mutex> g(slotLock);
+        --outstanding;
+        slotCond.notify_all();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> g(slotLock);
+        slotCond.wait(g, [this] { return outstanding == 0; });
+    }
+
+    StageStats& stage(const std::string &name) {
+        std::lock_guard<std::mutex> g(statsLock);
+        return stats[name];
+    }
+
+    void put(const std::string &blobName, uint64_t offset, StringPtr data) {
+        auto start = Clock::now();
+        auto objId = ObjIdGen::genObjectId(data->c_str(), data->length());
+        auto putMsg = SvcMsgFactory::newPutObjectToSmMsg(v1Id.get(), objId, data);
+        auto req = amHandle.proc->getSvcMgr()->getSvcRequestMgr()->newEPSvcRequest(smUuid);
+        req->setPayload(FDSP_MSG_TYPEID(fpi::PutObjectMsg), putMsg);
+        req->setTimeoutMs(10000);
+        req->onResponseCb([this, start, blobName, offset, objId, data]
+                          (EPSvcRequest*, const Error &e, StringPtr) {
+            stage("sm.put").record(elapsedNs(start), data->size(), e);
+            if (!e.ok()) {
+                stage("e2e").record(0, 0, e);
+                releaseSlot();
+                return;
+            }
+            auto updStart = Clock::now();
+            auto updMsg = SvcMsgFactory::newUpdateCatalogOnceMsg(v1Id.get(), blobName);
+            updMsg->txId = ++txId;
+            fpi::FDSP_BlobObjectInfo info;
+            info.offset = offset;
+            info.size = data->size();
+            fds::assign(info.data_obj_id, objId);
+            updMsg->obj_list.push_back(info);
+            v1->sendCommitMsg<fpi::UpdateCatalogOnceMsg>(
+                FDSP_MSG_TYPEID(fpi::UpdateCatalogOnceMsg),
+                updMsg,
+                [this, start, updStart, data](const Error &e, StringPtr) {
+                    stage("dm.update").record(elapsedNs(updStart), 0, e);
+                    stage("e2e").record(elapsedNs(start), data->size(), e);
+                    releaseSlot();
+                });
+        });
+        req->invoke();
+    }
+
+    void get(const std::string &blobName, uint64_t offset) {
+        auto start = Clock::now();
+        auto queryMsg = SvcMsgFactory::newQueryCatalogMsg(v1Id.get(), blobName, offset);
+        queryMsg->end_offset = offset;
+        v1->sendReadMsg<fpi::QueryCatalogMsg>(
+            FDSP_MSG_TYPEID(fpi::QueryCatalogMsg),
+            queryMsg,
+            [this, start](const Error &e, StringPtr payload) {
+                stage("dm.query").record(elapsedNs(start), 0, e);
+                fpi::QueryCatalogMsgPtr resp;
+                if (e.ok()) {
+                    Error err = e;
+                    resp = fds::deserializeFdspMsg<fpi::QueryCatalogMsg>(err, payload);
+                }
+                if (!resp || resp->obj_list.empty()) {
+                    stage("e2e").record(0, 0, e.ok() ? ERR_NOT_FOUND : e);
+                    releaseSlot();
+                    return;
+                }
+                ObjectID objId(resp->obj_list.front().data_obj_id.digest);
+                auto getStart = Clock::now();
+                auto getMsg = SvcMsgFactory::newGetObjectMsg(v1Id.get(), objId);
+                auto req = amHandle.proc->getSvcMgr()->getSvcRequestMgr()->newEPSvcRequest(smUuid);
+                req->setPayload(FDSP_MSG_TYPEID(fpi::GetObjectMsg), getMsg);
+                req->setTimeoutMs(10000);
+                req->onResponseCb([this, start, getStart]
+                                  (EPSvcRequest*, const Error &e, StringPtr payload) {
+                    uint64_t bytes = 0;
+                    if (e.ok()) {
+                        Error err = e;
+                        auto getResp = fds::deserializeFdspMsg<fpi::GetObjectResp>(err, payload);
+                        bytes = getResp ? getResp->data_obj.size() : 0;
+                    }
+                    stage("sm.get").record(elapsedNs(getStart), bytes, e);
+                    stage("e2e").record(elapsedNs(start), bytes, e);
+                    releaseSlot();
+                });
+                req->invoke();
+            });
+    }
+
+    void list() {
+        auto start = Clock::now();
+        auto listMsg = SvcMsgFactory::newGetBucketMsg(v1Id.get(), 0);
+        listMsg->count = 1000;
+        v1->sendReadMsg<fpi::GetBucketMsg>(
+            FDSP_MSG_TYPEID(fpi::GetBucketMsg),
+            listMsg,
+            [this, start](const Error &e, StringPtr payload) {
+                uint64_t bytes = payload ? payload->size() : 0;
+                stage("dm.list").record(elapsedNs(start), bytes, e);
+                stage("e2e").record(elapsedNs(start), bytes, e);
+                releaseSlot();
+            });
+    }
+
+    std::string s3BlobName(uint32_t objSize, uint64_t i) {
+        return util::strformat("s3-%u-%lu", objSize, i);
+    }
+
+    /* Runs one workload and returns its results */
+    Json::Value run(const WorkloadSpec &spec) {
+        stats.clear();
+        std::mt19937_64 offsets(42);
+        const uint64_t lunBlocks = 256 * 1024;     /* 1GB of 4K blocks */
+
+        /* Reads need something to read */
+        if (spec.name == "s3get" && s3Written[spec.objSize] < spec.ops) {
+            for (uint64_t i = s3Written[spec.objSize]; i < spec.ops; ++i) {
+                acquireSlot(spec.concurrency);
+                put(s3BlobName(spec.objSize, i), 0, nextObject(spec.objSize, spec.dedupRatio));
+            }
+            drain();
+            s3Written[spec.objSize] = spec.ops;
+            stats.clear();
+        }
+
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < spec.ops; ++i) {
+            acquireSlot(spec.concurrency);
+            if (spec.name == "s3put") {
+                put(s3BlobName(spec.objSize, i), 0, nextObject(spec.objSize, spec.dedupRatio));
+            } else if (spec.name == "s3get") {
+                get(s3BlobName(spec.objSize, i), 0);
+            } else if (spec.name == "block4k-seq") {
+                put("lun", (i % lunBlocks) * 4096, nextObject(4096, spec.dedupRatio));
+            } else if (spec.name == "block4k-rand") {
+                put("lun", (offsets() % lunBlocks) * 4096, nextObject(4096, spec.dedupRatio));
+            } else if (spec.name == "list") {
+                list();
+            } else {
+                releaseSlot();
+                ADD_FAILURE() << "Unknown workload: " << spec.name;
+                break;
+            }
+        }
+        drain();
+        double seconds = elapsedNs(start) / 1e9;
+        if (spec.name == "s3put") {
+            s3Written[spec.objSize] = std::max(s3Written[spec.objSize], spec.ops);
+        }
+
+        Json::Value result;
+        result["workload"] = spec.name;
+        result["object_size"] = spec.objSize;
+        result["ops"] = static_cast<Json::Value::UInt64>(spec.ops);
+        result["concurrency"] = spec.concurrency;
+        result["dedup_ratio"] = spec.dedupRatio;
+        result["seconds"] = seconds;
+        for (auto &kv : stats) {
+            result["stages"][kv.first] = kv.second.toJson(seconds);
+        }
+        return result;
+    }
+
+    SmHandle                                smHandle;
+    fpi::SvcUuid                            smUuid;
+    std::atomic<int64_t>                    txId {0};
+
+    std::mutex                              slotLock;
+    std::condition_variable                 slotCond;
+    uint32_t                                outstanding {0};
+
+    std::mutex                              statsLock;
+    std::map<std::string, StageStats>       stats;
+
+    std::mutex                              genLock;
+    std::mt19937_64                         rng {7};
+    std::string                             baseData;
+    uint64_t                                uniqueObjs {0};
+
+    /* s3 objects written so far, by object size */
+    std::map<uint32_t, uint64_t>            s3Written;
+};
+
+TEST_F(DataPathBench, workloads)
+{
+    createDataPath();
+
+    std::vector<std::string> workloads;
+    boost::split(workloads, getArg<std::string>("workloads"), boost::is_any_of(","));
+    std::vector<std::string> sizes;
+    boost::split(sizes, getArg<std::string>("obj-sizes"), boost::is_any_of(","));
+
+    Json::Value results(Json::arrayValue);
+    for (const auto &w : workloads) {
+        WorkloadSpec spec;
+        spec.name = w;
+        spec.ops = getArg<uint64_t>("ops");
+        spec.concurrency = getArg<uint32_t>("concurrency");
+        spec.dedupRatio = getArg<double>("dedup-ratio");
+        if (w == "s3put" || w == "s3get") {
+            for (const auto &s : sizes) {
+                spec.objSize = std::stoul(s);
+                results.append(run(spec));
+            }
+        } else {
+            spec.objSize = (w == "list") ? 0 : 4096;
+            results.append(run(spec));
+        }
+        EXPECT_EQ(results[results.size() - 1]["stages"]["e2e"]["errors"].asUInt64(), 0u)
+            << "workload: " << w;
+    }
+
+    Json::Value out;
+    out["benchmark"] = "datapath";
+    out["results"] = results;
+    auto jsonOut = getArg<std::string>("json-out");
+    if (jsonOut.empty()) {
+        std::cout << out << std::endl;
+    } else {
+        std::ofstream f(jsonOut);
+        f << out << std::endl;
+    }
+
+    waiter.reset(1);
+    v1->close([this]() { waiter.doneWith(ERR_OK); });
+    ASSERT_TRUE(waiter.awaitResult() == ERR_OK);
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    g_fdslog = new fds_log("datapathbench");
+    po::options_description opts("Allowed options");
+    opts.add_options()
+        ("help", "produce help message")
+        ("workloads", po::value<std::string>()->default_value("s3put,s3get,block4k-seq,block4k-rand,list"),
+         "comma separated: s3put, s3get, block4k-seq, block4k-rand, list")
+        ("obj-sizes", po::value<std::string>()->default_value("4096,65536,1048576"),
+         "comma separated s3 object sizes")
+        ("ops", po::value<uint64_t>()->default_value(10000), "ops per workload")
+        ("concurrency", po::value<uint32_t>()->default_value(16), "outstanding ops")
+        ("dedup-ratio", po::value<double>()->default_value(0.0),
+         "fraction of puts repeating earlier object contents")
+        ("json-out", po::value<std::string>()->default_value(""), "results file, stdout if empty");
+    DataPathBench::init(argc, argv, opts);
+    return RUN_ALL_TESTS();
+}
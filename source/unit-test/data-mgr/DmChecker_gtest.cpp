@@ -5,11 +5,16 @@
 
 // Standard includes.
 #include <cstdlib>
+#include <cstring>
+#include <map>
 
 // Internal includes.
+#include "catalogKeys/BlobExtentKey.h"
 #include "catalogKeys/BlobObjectKey.h"
+#include "catalogKeys/ObjectRankKey.h"
 #include <net/PlatNetSvcHandler.h>
 #include "checker/DmChecker.h"
+#include "dm-vol-cat/DmExtentPage.h"
 #include "dm-vol-cat/DmPersistVolDB.h"
 #include "fds_process.h"
 #include "gmock/gmock.h"
@@ -57,6 +62,31 @@ struct DMCheckerFixture : fds::DMCheckerEnv, BaseTestFixture {
     void putBlob(leveldb::DB* db, fds::BlobObjectKey const& key, const std::string &value) {
         db->Put(leveldb::WriteOptions(), static_cast<leveldb::Slice>(key), leveldb::Slice(value));
     }
+    /* Writes the objects in the object key layout to db1 and as extent pages to db2 */
+    void putObjectsBothLayouts(const std::string &blobName,
+                               const std::map<fds_uint32_t, ObjectID> &objects) {
+        std::map<fds_uint32_t, DmExtentPage> pages;
+        for (auto &it : objects) {
+            putBlob(db1, BlobObjectKey(blobName, it.first),
+                    std::string(reinterpret_cast<const char*>(it.second.GetId()),
+                                it.second.GetLen()));
+            pages[DmExtentPage::pageIndex(it.first)].putObject(DmExtentPage::pageSlot(it.first),
+                                                               it.second);
+        }
+        for (auto &it : pages) {
+            std::string value;
+            it.second.getSerialized(value);
+            db2->Put(leveldb::WriteOptions(),
+                     static_cast<leveldb::Slice>(BlobExtentKey(blobName, it.first)), value);
+        }
+    }
+    static ObjectID makeObject(fds_uint32_t n) {
+        ObjectID obj;
+        fds_uint8_t digest[OBJECTID_DIGESTLEN] = {0};
+        memcpy(digest, &n, sizeof(n));
+        obj.SetId(reinterpret_cast<const char *>(digest), sizeof(digest));
+        return obj;
+    }
     std::list<fds_volid_t> getVolumeIds() const override {
         return {fds_volid_t(1)};
     }
@@ -124,6 +154,40 @@ TEST_F(DMCheckerFixture, lotofmismatches) {
     ASSERT_EQ(mismatches, 3000);
 }
 
+TEST_F(DMCheckerFixture, mixedLayouts) {
+    /* Objects on two pages; a rank key sorts between the two layouts' keys */
+    std::map<fds_uint32_t, ObjectID> objects;
+    for (fds_uint32_t idx : {1u, 2u, DmExtentPage::OBJECTS_PER_PAGE + 2}) {
+        objects[idx] = makeObject(idx);
+    }
+    putObjectsBothLayouts("blob", objects);
+    for (auto db : {db1, db2}) {
+        db->Put(leveldb::WriteOptions(),
+                static_cast<leveldb::Slice>(ObjectRankKey(makeObject(1))), "1");
+    }
+
+    closeDbs();
+
+    fds::DMChecker checker(this);
+    ASSERT_EQ(checker.run(), 0);
+}
+
+TEST_F(DMCheckerFixture, mixedLayoutsMismatches) {
+    std::map<fds_uint32_t, ObjectID> objects;
+    for (fds_uint32_t idx : {1u, 2u, DmExtentPage::OBJECTS_PER_PAGE + 2}) {
+        objects[idx] = makeObject(idx);
+    }
+    putObjectsBothLayouts("blob", objects);
+    /* One object differs, one is only on the object key replica */
+    putBlob(db1, BlobObjectKey("blob", 2), "other");
+    putBlob(db1, BlobObjectKey("blob", 3), "extra");
+
+    closeDbs();
+
+    fds::DMChecker checker(this);
+    ASSERT_EQ(checker.run(), 2);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
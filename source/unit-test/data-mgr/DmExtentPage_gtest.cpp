@@ -0,0 +1,194 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+// Standard includes.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Internal includes.
+#include "catalogKeys/BlobExtentKey.h"
+#include "catalogKeys/BlobObjectKey.h"
+#include "catalogKeys/CatalogKeyComparator.h"
+#include "dm-vol-cat/DmExtentPage.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace fds;  // NOLINT
+
+static ObjectID makeObject(fds_uint32_t n) {
+    ObjectID obj;
+    fds_uint8_t digest[OBJECTID_DIGESTLEN] = {0};
+    memcpy(digest, &n, sizeof(n));
+    obj.SetId(reinterpret_cast<const char *>(digest), sizeof(digest));
+    return obj;
+}
+
+TEST(DmExtentPage, roundTrip) {
+    DmExtentPage page;
+    EXPECT_TRUE(page.empty());
+
+    // distinct objects, a gap, a run of one object (e.g. zeroed blocks), a single offset
+    for (fds_uint32_t slot = 0; slot < 10; ++slot) {
+        page.putObject(slot, makeObject(slot));
+    }
+    for (fds_uint32_t slot = 20; slot < 120; ++slot) {
+        page.putObject(slot, makeObject(0xffff));
+    }
+    page.putObject(DmExtentPage::OBJECTS_PER_PAGE - 1, makeObject(7));
+    EXPECT_EQ(111u, page.size());
+
+    std::string buf;
+    page.getSerialized(buf);
+    // The run of one object is stored once
+    EXPECT_LT(buf.size(), 20 * OBJECTID_DIGESTLEN);
+
+    DmExtentPage loaded;
+    ASSERT_EQ(ERR_OK, loaded.loadSerialized(buf.data(), buf.size()));
+    EXPECT_EQ(page.size(), loaded.size());
+    for (fds_uint32_t slot = 0; slot < DmExtentPage::OBJECTS_PER_PAGE; ++slot) {
+        ObjectID expected, obj;
+        fds_bool_t written = page.getObject(slot, expected);
+        EXPECT_EQ(written, loaded.getObject(slot, obj));
+        if (written) {
+            EXPECT_EQ(expected, obj);
+        }
+    }
+
+    loaded.deleteObjects(0, DmExtentPage::OBJECTS_PER_PAGE - 1);
+    EXPECT_TRUE(loaded.empty());
+}
+
+TEST(DmExtentPage, corrupt) {
+    DmExtentPage page;
+    page.putObject(3, makeObject(3));
+    page.putObject(4, makeObject(4));
+    std::string buf;
+    page.getSerialized(buf);
+
+    EXPECT_EQ(ERR_SERIALIZE_FAILED, page.loadSerialized(buf.data(), buf.size() - 1));
+    EXPECT_EQ(ERR_SERIALIZE_FAILED, page.loadSerialized(buf.data(), 0));
+    buf[0] = 0;
+    EXPECT_EQ(ERR_SERIALIZE_FAILED, page.loadSerialized(buf.data(), buf.size()));
+}
+
+/**
+ * Catalog of one blob of a block volume, in either layout: a key per object
+ * offset or a page of offsets per key.
+ */
+struct CatalogLayoutBench {
+    CatalogLayoutBench(const std::string & path, bool extents)
+            : path(path), extents(extents) {
+        auto res = std::system((std::string("rm -rf ") + path).c_str());
+        (void)res;
+        leveldb::Options options;
+        options.create_if_missing = true;
+        options.comparator = &cmp;
+        leveldb::DB* ldb;
+        EXPECT_TRUE(leveldb::DB::Open(options, path, &ldb).ok());
+        db.reset(ldb);
+    }
+    ~CatalogLayoutBench() {
+        db.reset();
+        auto res = std::system((std::string("rm -rf ") + path).c_str());
+        (void)res;
+    }
+
+    void put(fds_uint32_t objectIndex, const ObjectID & obj) {
+        leveldb::WriteBatch batch;
+        if (!extents) {
+            BlobObjectKey const key {blobName, objectIndex};
+            batch.Put(static_cast<leveldb::Slice>(key),
+                      leveldb::Slice(reinterpret_cast<const char *>(obj.GetId()), obj.GetLen()));
+        } else {
+            BlobExtentKey const key {blobName, DmExtentPage::pageIndex(objectIndex)};
+            DmExtentPage page;
+            std::string value;
+            if (db->Get(leveldb::ReadOptions(), static_cast<leveldb::Slice>(key), &value).ok()) {
+                EXPECT_EQ(ERR_OK, page.loadSerialized(value.data(), value.size()));
+            }
+            page.putObject(DmExtentPage::pageSlot(objectIndex), obj);
+            page.getSerialized(value);
+            batch.Put(static_cast<leveldb::Slice>(key), value);
+        }
+        EXPECT_TRUE(db->Write(leveldb::WriteOptions(), &batch).ok());
+    }
+
+    fds_uint64_t readAll() {
+        fds_uint64_t count = 0;
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+        ObjectID obj;
+        DmExtentPage page;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            if (!extents) {
+                obj.SetId(it->value().data(), it->value().size());
+                ++count;
+            } else {
+                EXPECT_EQ(ERR_OK, page.loadSerialized(it->value().data(), it->value().size()));
+                page.forEachObject([&count](fds_uint32_t, const ObjectID &) { ++count; });
+            }
+        }
+        return count;
+    }
+
+    std::string path;
+    bool extents;
+    std::string blobName {"blockvolume"};
+    CatalogKeyComparator cmp;
+    std::unique_ptr<leveldb::DB> db;
+};
+
+/**
+ * Random single offset writes then a sequential read of the whole blob, with
+ * a catalog key per object offset and with the extent map.
+ */
+static void runBenchmark(bool extents, const std::vector<fds_uint32_t> & writes,
+                           fds_uint32_t nObjects) {
+    CatalogLayoutBench bench("/tmp/dm_extent_bench." + std::to_string(getpid()) + ".ldb", extents);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto objectIndex : writes) {
+        bench.put(objectIndex, makeObject(objectIndex));
+    }
+    double writeSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    fds_uint64_t read = bench.readAll();
+    double readSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(nObjects, read);
+
+    std::cout << (extents ? "extent map" : "object key")
+              << " random writes/s: " << static_cast<uint64_t>(writes.size() / writeSecs)
+              << " sequential reads/s: " << static_cast<uint64_t>(read / readSecs)
+              << std::endl;
+}
+
+/* Timing only, run with --gtest_also_run_disabled_tests */
+TEST(DmExtentPage, DISABLED_benchmark) {
+    const fds_uint32_t nObjects = 256 * 1024;
+    std::vector<fds_uint32_t> writes(nObjects);
+    for (fds_uint32_t i = 0; i < nObjects; ++i) {
+        writes[i] = i;
+    }
+    std::shuffle(writes.begin(), writes.end(), std::mt19937(42));
+
+    runBenchmark(false, writes, nObjects);
+    runBenchmark(true, writes, nObjects);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,214 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+// Standard includes.
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Internal includes.
+#include "catalogKeys/BlobObjectKey.h"
+#include "catalogKeys/CatalogKeyComparator.h"
+#include "dm-vol-cat/DmPersistVolCat.h"
+#include "leveldb/cat_journal.h"
+#include "leveldb/db.h"
+#include "leveldb/journal_archive.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace fds;  // NOLINT
+
+static const std::string testDir("/tmp/journal_archive_gtest");
+
+/**
+ * Catalog journal of nBatches write batches, the nth one at time n
+ */
+static std::string writeJournal(fds_uint32_t nBatches) {
+    // The log of a leveldb that was never compacted is a journal
+    std::string dbDir = testDir + "/journal";
+    CatalogKeyComparator cmp;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.comparator = &cmp;
+    options.write_buffer_size = 1024 * 1024 * 1024;
+    leveldb::DB* db;
+    EXPECT_TRUE(leveldb::DB::Open(options, dbDir, &db).ok());
+
+    std::mt19937 rand(42);
+    for (fds_uint64_t ts = 1; ts <= nBatches; ++ts) {
+        leveldb::WriteBatch batch;
+        batch.Put(OP_TIMESTAMP_REC, leveldb::Slice(reinterpret_cast<const char *>(&ts), sizeof(ts)));
+        for (fds_uint32_t i = 0; i < 4; ++i) {
+            BlobObjectKey const key {"blob", static_cast<fds_uint32_t>(rand() % 4096)};
+            std::string value(OBJECTID_DIGESTLEN, static_cast<char>(rand() % 4));
+            batch.Put(static_cast<leveldb::Slice>(key), value);
+        }
+        EXPECT_TRUE(db->Write(leveldb::WriteOptions(), &batch).ok());
+    }
+    delete db;
+
+    std::vector<std::string> children;
+    leveldb::Env::Default()->GetChildren(dbDir, &children);
+    for (const auto &child : children) {
+        if (child.size() > 4 && 0 == child.compare(child.size() - 4, 4, ".log")) {
+            return dbDir + "/" + child;
+        }
+    }
+    return std::string();
+}
+
+static std::vector<fds_uint64_t> batchTimes(const std::string &file, fds_uint64_t offset = 0) {
+    std::vector<fds_uint64_t> times;
+    for (leveldb::CatJournalIterator iter(file, offset); iter.isValid(); iter.Next()) {
+        times.push_back(leveldb::getWriteBatchTimestamp(iter.GetBatch()));
+    }
+    return times;
+}
+
+/**
+ * Where TimelineDB::getJournalOffset() says to start reading for fromTime
+ */
+static fds_uint64_t offsetAt(const std::vector<leveldb::JournalIndexEntry> &index,
+                             fds_uint64_t fromTime) {
+    fds_uint64_t offset = 0;
+    for (const auto &entry : index) {
+        if (entry.timestamp < fromTime) {
+            offset = entry.offset;
+        }
+    }
+    return offset;
+}
+
+class JournalArchiveTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        auto res = std::system(("rm -rf " + testDir + " && mkdir -p " + testDir).c_str());
+        (void)res;
+    }
+    void TearDown() override {
+        auto res = std::system(("rm -rf " + testDir).c_str());
+        (void)res;
+    }
+};
+
+TEST_F(JournalArchiveTest, roundTrip) {
+    const fds_uint32_t nBatches = 20000;
+    std::string journal = writeJournal(nBatches);
+    ASSERT_FALSE(journal.empty());
+
+    std::string archive = testDir + "/archive" + leveldb::JOURNAL_ARCHIVE_SUFFIX;
+    std::vector<leveldb::JournalIndexEntry> index;
+    ASSERT_TRUE(leveldb::archiveJournal(journal, archive, &index).ok());
+
+    std::vector<fds_uint64_t> times = batchTimes(journal);
+    ASSERT_EQ(nBatches, times.size());
+    EXPECT_EQ(times, batchTimes(archive));
+
+    // One entry per frame, in time order, starting with the first batch
+    ASSERT_LT(1u, index.size());
+    EXPECT_EQ(1u, index.front().timestamp);
+    EXPECT_EQ(0u, index.front().offset);
+    for (size_t i = 1; i < index.size(); ++i) {
+        EXPECT_LT(index[i - 1].timestamp, index[i].timestamp);
+        EXPECT_EQ(i, index[i].offset / leveldb::ARCHIVE_FRAME_SIZE);
+    }
+
+    // Reading from fromTime on, the batches before it that are read are
+    // in the same frame
+    for (fds_uint64_t fromTime : {1u, 2u, nBatches / 3, nBatches / 2 + 1, nBatches}) {
+        std::vector<fds_uint64_t> fromTimes = batchTimes(archive, offsetAt(index, fromTime));
+        ASSERT_FALSE(fromTimes.empty());
+        EXPECT_LE(fromTimes.front(), fromTime);
+        EXPECT_EQ(nBatches, fromTimes.back());
+        EXPECT_GE(nBatches - fromTime + 1 + nBatches / index.size() * 2, fromTimes.size());
+        EXPECT_LE(nBatches - fromTime + 1, fromTimes.size());
+    }
+}
+
+TEST_F(JournalArchiveTest, corrupt) {
+    std::string journal = writeJournal(1000);
+    std::string archive = testDir + "/archive" + leveldb::JOURNAL_ARCHIVE_SUFFIX;
+    std::vector<leveldb::JournalIndexEntry> index;
+    ASSERT_TRUE(leveldb::archiveJournal(journal, archive, &index).ok());
+
+    // Without its frame table an archive can't be read
+    ASSERT_EQ(0, truncate(archive.c_str(), 100));
+    leveldb::CatJournalIterator iter(archive);
+    EXPECT_FALSE(iter.isValid());
+}
+
+static double cpuSecs(int who) {
+    struct rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Archiving with the gzip binary and in process, then reading the last
+ * tenth of the journal from either
+ */
+TEST_F(JournalArchiveTest, benchmark) {
+    const fds_uint32_t nBatches = 200000;
+    std::string journal = writeJournal(nBatches);
+    ASSERT_FALSE(journal.empty());
+    fds_uint64_t fromTime = nBatches - nBatches / 10;
+
+    std::string gzFile = testDir + "/archive.gz";
+    double cpu = cpuSecs(RUSAGE_CHILDREN);
+    auto start = std::chrono::steady_clock::now();
+    int rc = std::system(("gzip --stdout " + journal + " > " + gzFile).c_str());
+    double gzipSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double gzipCpu = cpuSecs(RUSAGE_CHILDREN) - cpu;
+    if (rc) {
+        std::cout << "no gzip, skipping the benchmark" << std::endl;
+        return;
+    }
+
+    std::string archive = testDir + "/archive" + leveldb::JOURNAL_ARCHIVE_SUFFIX;
+    std::vector<leveldb::JournalIndexEntry> index;
+    cpu = cpuSecs(RUSAGE_SELF);
+    start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(leveldb::archiveJournal(journal, archive, &index).ok());
+    double archiveSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double archiveCpu = cpuSecs(RUSAGE_SELF) - cpu;
+
+    start = std::chrono::steady_clock::now();
+    std::vector<fds_uint64_t> gzTimes = batchTimes(gzFile);
+    double gzSeekSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    std::vector<fds_uint64_t> archiveTimes = batchTimes(archive, offsetAt(index, fromTime));
+    double archiveSeekSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(gzTimes.back(), archiveTimes.back());
+    EXPECT_LE(archiveTimes.front(), fromTime);
+
+    leveldb::Env *env = leveldb::Env::Default();
+    uint64_t journalSize, gzSize, archiveSize;
+    env->GetFileSize(journal, &journalSize);
+    env->GetFileSize(gzFile, &gzSize);
+    env->GetFileSize(archive, &archiveSize);
+    std::cout << "journal MB: " << journalSize / (1024 * 1024)
+              << " gzip ms: " << static_cast<uint64_t>(gzipSecs * 1000)
+              << " cpu ms: " << static_cast<uint64_t>(gzipCpu * 1000)
+              << " MB: " << gzSize / (1024 * 1024)
+              << " read from time ms: " << static_cast<uint64_t>(gzSeekSecs * 1000) << std::endl
+              << "archive ms: " << static_cast<uint64_t>(archiveSecs * 1000)
+              << " cpu ms: " << static_cast<uint64_t>(archiveCpu * 1000)
+              << " MB: " << archiveSize / (1024 * 1024)
+              << " read from time ms: " << static_cast<uint64_t>(archiveSeekSecs * 1000)
+              << std::endl;
+    EXPECT_LT(archiveSeekSecs, gzSeekSecs);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
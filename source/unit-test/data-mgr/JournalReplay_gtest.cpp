@@ -0,0 +1,216 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+// Standard includes.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Internal includes.
+#include "catalogKeys/BlobObjectKey.h"
+#include "catalogKeys/CatalogKeyComparator.h"
+#include "dm-vol-cat/DmPersistVolCat.h"
+#include "leveldb/cat_journal.h"
+#include "leveldb/db.h"
+#include "lib/Catalog.h"
+#include "timeline/journalreplayer.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace fds;  // NOLINT
+
+static const std::string testDir("/tmp/journal_replay_gtest");
+
+/**
+ * Catalog journals of a busy volume: every write batch overwrites a few
+ * offsets of a small blob, and now and then deletes one.
+ */
+struct JournalSet {
+    JournalSet(fds_uint32_t nFiles, fds_uint32_t batchesPerFile, fds_uint32_t nOffsets) {
+        std::mt19937 rand(42);
+        util::TimeStamp ts = 1;
+        for (fds_uint32_t f = 0; f < nFiles; ++f) {
+            // The log of a leveldb that was never compacted is a journal
+            std::string dbDir = testDir + "/journal" + std::to_string(f);
+            leveldb::Options options;
+            options.create_if_missing = true;
+            options.comparator = &cmp;
+            options.write_buffer_size = 1024 * 1024 * 1024;
+            leveldb::DB* db;
+            EXPECT_TRUE(leveldb::DB::Open(options, dbDir, &db).ok());
+
+            for (fds_uint32_t b = 0; b < batchesPerFile; ++b, ++ts) {
+                leveldb::WriteBatch batch;
+                batch.Put(OP_TIMESTAMP_REC,
+                          leveldb::Slice(reinterpret_cast<const char *>(&ts), sizeof(ts)));
+                for (fds_uint32_t i = 0; i < 4; ++i) {
+                    BlobObjectKey const key {"blob", static_cast<fds_uint32_t>(rand() % nOffsets)};
+                    if (0 == rand() % 16) {
+                        batch.Delete(static_cast<leveldb::Slice>(key));
+                    } else {
+                        std::string value(OBJECTID_DIGESTLEN, static_cast<char>(rand()));
+                        batch.Put(static_cast<leveldb::Slice>(key), value);
+                    }
+                }
+                EXPECT_TRUE(db->Write(leveldb::WriteOptions(), &batch).ok());
+            }
+            delete db;
+
+            std::string log;
+            std::vector<std::string> children;
+            leveldb::Env::Default()->GetChildren(dbDir, &children);
+            for (const auto &child : children) {
+                if (child.size() > 4 && 0 == child.compare(child.size() - 4, 4, ".log")) {
+                    log = dbDir + "/" + child;
+                }
+            }
+            EXPECT_FALSE(log.empty());
+            files.push_back(log);
+        }
+        lastTime = ts - 1;
+    }
+
+    CatalogKeyComparator cmp;
+    std::vector<std::string> files;
+    util::TimeStamp lastTime;
+};
+
+static std::unique_ptr<Catalog> newCatalog(const std::string &name, CatalogKeyComparator *cmp) {
+    std::unique_ptr<Catalog> cat(new Catalog(testDir + "/" + name, Catalog::WRITE_BUFFER_SIZE,
+                                             Catalog::CACHE_SIZE, "", "", 5, false, cmp));
+    // What journal replay used to do: every write batch applied, synced
+    cat->GetWriteOptions().sync = true;
+    return cat;
+}
+
+/**
+ * Journal replay as it was, one write batch after the other
+ */
+static Error replayBatches(Catalog &destCat, const std::vector<std::string> &files,
+                           util::TimeStamp fromTime, util::TimeStamp toTime) {
+    Error err(ERR_DM_REPLAY_JOURNAL);
+    for (const auto &f : files) {
+        for (leveldb::CatJournalIterator iter(f); iter.isValid(); iter.Next()) {
+            leveldb::WriteBatch & wb = iter.GetBatch();
+            fds_uint64_t ts = leveldb::getWriteBatchTimestamp(wb);
+            if (!ts || ts > toTime) {
+                break;
+            }
+            if (ts >= fromTime) {
+                err = destCat.Update(&wb);
+            }
+        }
+    }
+    return err;
+}
+
+static void expectSameContents(Catalog &lhs, Catalog &rhs) {
+    auto lhsIt = lhs.NewIterator();
+    auto rhsIt = rhs.NewIterator();
+    fds_uint64_t keys = 0;
+    for (lhsIt->SeekToFirst(), rhsIt->SeekToFirst(); lhsIt->Valid(); lhsIt->Next(), rhsIt->Next()) {
+        ASSERT_TRUE(rhsIt->Valid());
+        ASSERT_EQ(lhsIt->key().ToString(), rhsIt->key().ToString());
+        ASSERT_EQ(lhsIt->value().ToString(), rhsIt->value().ToString());
+        ++keys;
+    }
+    EXPECT_FALSE(rhsIt->Valid());
+    EXPECT_LT(0u, keys);
+}
+
+class JournalReplayTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        auto res = std::system(("rm -rf " + testDir + " && mkdir -p " + testDir).c_str());
+        (void)res;
+    }
+    void TearDown() override {
+        auto res = std::system(("rm -rf " + testDir).c_str());
+        (void)res;
+    }
+};
+
+TEST_F(JournalReplayTest, sameAsBatchReplay) {
+    JournalSet journals(6, 500, 64);
+
+    // Up to the end, and up to a point in time in the middle of a file
+    for (util::TimeStamp toTime : {journals.lastTime, journals.lastTime / 2 + 7}) {
+        std::string suffix = std::to_string(toTime);
+        auto expected = newCatalog("expected" + suffix, &journals.cmp);
+        auto replayed = newCatalog("replayed" + suffix, &journals.cmp);
+
+        EXPECT_EQ(ERR_OK, replayBatches(*expected, journals.files, 0, toTime));
+        timeline::JournalReplayer replayer(0, toTime);
+        EXPECT_EQ(ERR_OK, replayer.replay(*replayed, journals.files));
+        EXPECT_EQ(toTime, replayer.getBatchesReplayed());
+        expectSameContents(*expected, *replayed);
+    }
+
+    // Nothing in the time range
+    auto empty = newCatalog("empty", &journals.cmp);
+    timeline::JournalReplayer replayer(journals.lastTime + 1, journals.lastTime + 2);
+    EXPECT_EQ(ERR_DM_REPLAY_JOURNAL, replayer.replay(*empty, journals.files));
+}
+
+/**
+ * The clone's own journal is scanned by time like any other, so every batch
+ * the replayer writes must carry the timestamp of the last batch replayed
+ */
+TEST_F(JournalReplayTest, everyBatchStamped) {
+    JournalSet journals(2, 500, 256);
+    auto replayed = newCatalog("stamped", &journals.cmp);
+    timeline::JournalReplayer replayer(0, journals.lastTime, 2, 1024);
+    EXPECT_EQ(ERR_OK, replayer.replay(*replayed, journals.files));
+
+    std::vector<std::string> children;
+    leveldb::Env::Default()->GetChildren(testDir + "/stamped", &children);
+    fds_uint64_t batches = 0;
+    for (const auto &child : children) {
+        if (child.size() <= 4 || 0 != child.compare(child.size() - 4, 4, ".log")) {
+            continue;
+        }
+        for (leveldb::CatJournalIterator iter(testDir + "/stamped/" + child); iter.isValid(); iter.Next()) {
+            EXPECT_EQ(journals.lastTime, leveldb::getWriteBatchTimestamp(iter.GetBatch()));
+            ++batches;
+        }
+    }
+    /* 256 keys of ~60 bytes in 1KB batches */
+    EXPECT_LT(1u, batches);
+}
+
+/**
+ * Clone of a busy volume from its journals, batch by batch and collapsed
+ */
+TEST_F(JournalReplayTest, benchmark) {
+    JournalSet journals(8, 2000, 1024);
+
+    auto batchCat = newCatalog("batches", &journals.cmp);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(ERR_OK, replayBatches(*batchCat, journals.files, 0, journals.lastTime));
+    double batchSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto collapsedCat = newCatalog("collapsed", &journals.cmp);
+    timeline::JournalReplayer replayer(0, journals.lastTime);
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(ERR_OK, replayer.replay(*collapsedCat, journals.files));
+    double collapsedSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    expectSameContents(*batchCat, *collapsedCat);
+    std::cout << replayer.getBatchesReplayed() << " write batches, "
+              << replayer.getKeysWritten() << " keys after collapsing"
+              << " batch replay ms: " << static_cast<uint64_t>(batchSecs * 1000)
+              << " collapsed replay ms: " << static_cast<uint64_t>(collapsedSecs * 1000)
+              << std::endl;
+    EXPECT_LT(collapsedSecs, batchSecs);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
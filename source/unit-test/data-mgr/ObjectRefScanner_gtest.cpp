@@ -115,6 +115,134 @@ TEST_F(DmUnitTest, ObjectRefMg) {
     dataMgr->features.setQosEnabled(false);
 }
 
+/**
+* Exposes the reference tracking internals of the scan manager
+*/
+struct TestRefScanMgr : refcount::ObjectRefScanMgr {
+    TestRefScanMgr() : ObjectRefScanMgr(dmTester, dataMgr) {}
+    void enableIncremental() {
+        incrementalEnabled = true;
+        fullScanIntervalSecs = 3600;
+    }
+    bool isTracked(const ObjectID &oid) {
+        ReadGuard rg(refTrackLock);
+        auto token = DLT::getToken(oid, refTrackTokenBits);
+        if (token >= tokenRefs.size() || !tokenRefs[token]->refs) {
+            return false;
+        }
+        return tokenRefs[token]->refs->lookup(oid);
+    }
+    void seedScannedObject(const ObjectID &oid) {
+        trackScannedObjectRefs(DLT::getToken(oid, refTrackTokenBits), {oid});
+    }
+    bool isSeeding() const { return refTrackState == REFTRACK_SEEDING; }
+    bool isTrackingValid() const { return refTrackState == REFTRACK_VALID; }
+    void finishSeeding() { refTrackState = REFTRACK_VALID; }
+    using ObjectRefScanMgr::prescanInit;
+};
+
+static ObjectID newObjectId(const std::string &name) {
+    return ObjIdGen::genObjectId(name.c_str(), name.size());
+}
+
+static void runScan(TestRefScanMgr &refMgr, concurrency::TaskStatus &waiter, bool incremental) {
+    waiter.reset(1);
+    if (incremental) {
+        refMgr.incrementalScanOnce();
+    } else {
+        refMgr.scanOnce();
+    }
+    ASSERT_TRUE(waiter.await(5000));
+    refMgr.setStateStopped();
+}
+
+TEST_F(DmUnitTest, RefTrackingSeeding) {
+    TestRefScanMgr refMgr;
+    refMgr.mod_startup();
+    refMgr.enableIncremental();
+    EXPECT_FALSE(refMgr.isIncrementalScanPossible());
+
+    refMgr.prescanInit();
+    ASSERT_TRUE(refMgr.isSeeding());
+    ObjectID scanned = newObjectId("seeding.scanned");
+    ObjectID added = newObjectId("seeding.added");
+    refMgr.seedScannedObject(scanned);
+
+    /* Removals may race with the scan counting the reference, they are dropped */
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {added}, {scanned}, false);
+    EXPECT_TRUE(refMgr.isTracked(scanned));
+    EXPECT_TRUE(refMgr.isTracked(added));
+
+    /* Volumes that weren't scanned aren't tracked */
+    ObjectID otherVolObj = newObjectId("seeding.othervol");
+    refMgr.objectRefDeltaCb(fds_volid_t(0xbad), {otherVolObj}, {}, false);
+    EXPECT_FALSE(refMgr.isTracked(otherVolObj));
+
+    /* Once seeded removals apply */
+    refMgr.finishSeeding();
+    EXPECT_TRUE(refMgr.isIncrementalScanPossible());
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {}, {scanned}, false);
+    EXPECT_FALSE(refMgr.isTracked(scanned));
+    EXPECT_TRUE(refMgr.isTracked(added));
+
+    /* A change not reported per object drops everything until the next full scan */
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {}, {}, true);
+    EXPECT_FALSE(refMgr.isTrackingValid());
+    EXPECT_FALSE(refMgr.isIncrementalScanPossible());
+    EXPECT_FALSE(refMgr.isTracked(added));
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {added}, {}, false);
+    EXPECT_FALSE(refMgr.isTracked(added));
+    refMgr.setStateStopped();
+}
+
+TEST_F(DmUnitTest, RefTrackingIncrementalScan) {
+    std::list<ObjectID> addedObjs;
+    issuePutBlobs(dmTester->TESTVOLID, NUM_BLOBS, addedObjs);
+    dataMgr->features.setQosEnabled(true);
+
+    concurrency::TaskStatus waiter;
+    TestRefScanMgr refMgr;
+    refMgr.mod_startup();
+    refMgr.enableIncremental();
+    refMgr.setScanDoneCb([&waiter](refcount::ObjectRefScanMgr *refMgr) {
+        waiter.done();
+    });
+
+    /* Full scan seeds tracking */
+    runScan(refMgr, waiter, false);
+    ASSERT_TRUE(refMgr.isTrackingValid());
+    ASSERT_TRUE(refMgr.isIncrementalScanPossible());
+    for (const auto &obj : addedObjs) {
+        EXPECT_TRUE(refMgr.isTracked(obj));
+    }
+
+    /* Incremental scan publishes scanned and newly added references */
+    ObjectID added = newObjectId("incremental.added");
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {added}, {}, false);
+    runScan(refMgr, waiter, true);
+    const auto dlt = dmTester->getSvcMgr()->getCurrentDLT();
+    addedObjs.push_back(added);
+    for (const auto &obj : addedObjs) {
+        auto bf = refMgr.getTokenBloomFilter(dlt->getToken(obj));
+        ASSERT_TRUE(bf.get() != nullptr);
+        EXPECT_TRUE(bf->lookup(obj));
+    }
+    EXPECT_LT(0u, refMgr.getScanSuccessVolsCnt());
+
+    /* Invalidated tracking falls back to a full scan, which seeds it again */
+    refMgr.objectRefDeltaCb(dmTester->TESTVOLID, {}, {}, true);
+    runScan(refMgr, waiter, true);
+    EXPECT_TRUE(refMgr.isTrackingValid());
+    EXPECT_FALSE(refMgr.isTracked(added));
+    for (const auto &obj : addedObjs) {
+        if (obj != added) {
+            EXPECT_TRUE(refMgr.isTracked(obj));
+        }
+    }
+
+    dataMgr->features.setQosEnabled(false);
+}
+
 int main(int argc, char** argv) {
     // The following line must be executed to initialize Google Mock
     // (and Google Test) before running the tests.
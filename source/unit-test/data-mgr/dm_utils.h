@@ -171,7 +171,8 @@ boost::shared_ptr<LatencyCounter> putCounter(new LatencyCounter("put", invalid_v
 boost::shared_ptr<LatencyCounter> getCounter(new LatencyCounter("get", invalid_vol_id, 0));
 boost::shared_ptr<LatencyCounter> deleteCounter(new LatencyCounter("delete", invalid_vol_id, 0));
 
-void generateVolumes(std::vector<boost::shared_ptr<VolumeDesc> > & volumes) {
+void generateVolumes(std::vector<boost::shared_ptr<VolumeDesc> > & volumes,
+                     fpi::FDSP_VolType volType = fpi::FDSP_VOL_S3_TYPE) {
     for (fds_uint32_t i = 1; i <= NUM_VOLUMES; ++i) {
         std::string name = "test" + std::to_string(i);
 
@@ -181,8 +182,7 @@ void generateVolumes(std::vector<boost::shared_ptr<VolumeDesc> > & volumes) {
         vdesc->localDomainId = i;
         vdesc->globDomainId = i;
 
-        vdesc->volType = fpi::FDSP_VOL_S3_TYPE;
-        // vdesc->volType = fpi::FDSP_VOL_BLKDEV_TYPE;
+        vdesc->volType = volType;
         vdesc->capacity = 10 * 1024;  // 10GB
         vdesc->maxQuota = 90;
         vdesc->redundancyCnt = 1;
@@ -5,10 +5,14 @@
 #include "./dm_mocks.h"
 #include "./dm_gtest.h"
 #include "./dm_utils.h"
+#include <map>
 #include <vector>
 #include <string>
 #include <thread>
 
+#include <catalogKeys/BlobObjectKey.h>
+#include <dm-vol-cat/DmExtentPage.h>
+#include <dm-vol-cat/DmPersistVolDB.h>
 #include <dm-vol-cat/DmVolumeCatalog.h>
 #include <util/color.h>
 #include <PerfTrace.h>
@@ -35,6 +39,20 @@ class DmVolumeCatalogTest : public ::testing::Test {
 
     void testDeleteBlob(fds_volid_t volId, const std::string blobName, blob_version_t version);
 
+    fds_volid_t addBlockVolume();
+
+    DmPersistVolDB::ptr getPersistVol(fds_volid_t volId);
+
+    void expectObjects(DmPersistVolCat & vol, const std::string & blobName,
+                       fds_uint64_t startOffset, fds_uint64_t endOffset,
+                       const std::map<fds_uint64_t, ObjectID> & expected,
+                       Catalog::MemSnap snap = NULL);
+
+    static ObjectID testObject(fds_uint64_t offset, const std::string & version = "") {
+        std::string data = "object" + std::to_string(offset) + version;
+        return ObjIdGen::genObjectId(data.c_str(), data.size());
+    }
+
     boost::shared_ptr<DmVolumeCatalog> volcat;
 
     std::vector<boost::shared_ptr<VolumeDesc> > volumes;
@@ -109,6 +127,50 @@ void DmVolumeCatalogTest::testDeleteBlob(fds_volid_t volId, const std::string bl
     taskCount.done();
 }
 
+/**
+ * Adds and activates a block volume that stores its object offsets in
+ * extent pages
+ */
+fds_volid_t DmVolumeCatalogTest::addBlockVolume() {
+    std::vector<boost::shared_ptr<VolumeDesc> > blockVolumes;
+    generateVolumes(blockVolumes, fpi::FDSP_VOL_BLKDEV_TYPE);
+    const VolumeDesc & vdesc = *blockVolumes.front();
+
+    // The layout is picked when an empty catalog is activated
+    const std::string key = "fds.dm." + DmPersistVolDB::CATALOG_EXTENT_MAP_STR;
+    mockDm->get_fds_config()->set(key, true);
+    volcat->addCatalog(vdesc);
+    Error rc = volcat->activateCatalog(vdesc.volUUID);
+    mockDm->get_fds_config()->set(key, false);
+    EXPECT_TRUE(rc.ok());
+
+    return vdesc.volUUID;
+}
+
+DmPersistVolDB::ptr DmVolumeCatalogTest::getPersistVol(fds_volid_t volId) {
+    return boost::dynamic_pointer_cast<DmPersistVolDB>(volcat->getVolume(volId));
+}
+
+void DmVolumeCatalogTest::expectObjects(DmPersistVolCat & vol, const std::string & blobName,
+                                        fds_uint64_t startOffset, fds_uint64_t endOffset,
+                                        const std::map<fds_uint64_t, ObjectID> & expected,
+                                        Catalog::MemSnap snap) {
+    fpi::FDSP_BlobObjectList objList;
+    Error rc = vol.getObject(blobName, startOffset, endOffset, objList, snap);
+    EXPECT_TRUE(rc.ok());
+
+    std::map<fds_uint64_t, ObjectID> found;
+    fds_uint64_t lastOffset = 0;
+    for (auto & it : objList) {
+        EXPECT_TRUE(found.empty() || static_cast<fds_uint64_t>(it.offset) > lastOffset);
+        lastOffset = it.offset;
+        found[it.offset] = ObjectID(it.data_obj_id.digest);
+    }
+    std::map<fds_uint64_t, ObjectID> inRange(expected.lower_bound(startOffset),
+                                              expected.upper_bound(endOffset));
+    EXPECT_EQ(inRange, found) << "offsets " << startOffset << " - " << endOffset;
+}
+
 void DmVolumeCatalogTest::TearDown() {
     volcat.reset();
 
@@ -287,6 +349,204 @@ TEST_F(DmVolumeCatalogTest, all_ops) {
     std::this_thread::yield();
 }
 
+TEST_F(DmVolumeCatalogTest, block_volume_range_reads) {
+    fds_volid_t volId = addBlockVolume();
+    DmPersistVolDB::ptr vol = getPersistVol(volId);
+    ASSERT_TRUE(vol->isExtentMap());
+
+    fds_uint64_t const objSize = vol->getObjSize();
+    fds_uint64_t const perPage = DmExtentPage::OBJECTS_PER_PAGE;
+    const std::string blobName = "block_range_reads";
+
+    // Both sides of the first two page boundaries, pages 3 and 5 have no objects
+    std::vector<fds_uint64_t> const indexes {0, 1, perPage - 1, perPage, perPage + 1,
+                                             2 * perPage - 1, 2 * perPage, 4 * perPage + 3};
+    std::map<fds_uint64_t, ObjectID> expected;
+    BlobObjList objs;
+    for (auto index : indexes) {
+        expected[index * objSize] = testObject(index * objSize);
+        objs[index * objSize] = BlobObjInfo(expected[index * objSize], objSize);
+    }
+    ASSERT_TRUE(vol->putObject(blobName, objs).ok());
+
+    std::vector<std::pair<fds_uint64_t, fds_uint64_t> > const ranges {
+        {0, 5 * perPage},
+        {1, perPage},
+        {perPage - 1, perPage + 1},
+        {perPage + 1, 2 * perPage - 1},
+        {2 * perPage + 1, 4 * perPage + 2},
+        {3 * perPage, 6 * perPage}};
+    for (auto & range : ranges) {
+        expectObjects(*vol, blobName, range.first * objSize, range.second * objSize, expected);
+    }
+
+    BlobObjList found;
+    ASSERT_TRUE(vol->getObject(blobName, (perPage - 1) * objSize, 2 * perPage * objSize,
+                               found).ok());
+    EXPECT_EQ(5u, found.size());
+    for (auto & it : found) {
+        EXPECT_EQ(expected[it.first], it.second.oid);
+    }
+
+    ObjectID obj;
+    EXPECT_TRUE(vol->getObject(blobName, perPage * objSize, obj).ok());
+    EXPECT_EQ(expected[perPage * objSize], obj);
+    EXPECT_EQ(ERR_CAT_ENTRY_NOT_FOUND, vol->getObject(blobName, 2 * objSize, obj).GetErrno());
+}
+
+TEST_F(DmVolumeCatalogTest, block_volume_delete_ranges) {
+    fds_volid_t volId = addBlockVolume();
+    DmPersistVolDB::ptr vol = getPersistVol(volId);
+    ASSERT_TRUE(vol->isExtentMap());
+
+    fds_uint64_t const objSize = vol->getObjSize();
+    fds_uint64_t const perPage = DmExtentPage::OBJECTS_PER_PAGE;
+    const std::string blobName = "block_delete_ranges";
+
+    // Every offset of four pages
+    std::map<fds_uint64_t, ObjectID> expected;
+    BlobObjList::ptr objs(new BlobObjList());
+    for (fds_uint64_t index = 0; index < 4 * perPage; ++index) {
+        expected[index * objSize] = testObject(index * objSize);
+        (*objs)[index * objSize] = BlobObjInfo(expected[index * objSize], objSize);
+    }
+    objs->setEndOfBlob();
+    BlobTxId::const_ptr txId(new BlobTxId(++txCount));
+    ASSERT_TRUE(volcat->putBlob(volId, blobName, nullptr, objs, txId, 1).ok());
+
+    // Ranges that start and end inside a page, within one page and across pages
+    std::vector<std::pair<fds_uint64_t, fds_uint64_t> > const ranges {
+        {5, 9},
+        {perPage + 10, 2 * perPage + 20},
+        {perPage - 1, perPage - 1}};
+    for (auto & range : ranges) {
+        ASSERT_TRUE(vol->deleteObject(blobName, range.first * objSize,
+                                      range.second * objSize).ok());
+        expected.erase(expected.lower_bound(range.first * objSize),
+                       expected.upper_bound(range.second * objSize));
+    }
+    ASSERT_TRUE(vol->deleteObject(blobName, 3 * perPage * objSize).ok());
+    expected.erase(3 * perPage * objSize);
+    expectObjects(*vol, blobName, 0, 4 * perPage * objSize, expected);
+
+    // Truncating inside page 2 deletes the rest of it and all of page 3
+    fds_uint64_t const lastOffset = (2 * perPage + 50) * objSize;
+    BlobObjList::ptr truncObjs(new BlobObjList());
+    (*truncObjs)[lastOffset] = BlobObjInfo(testObject(lastOffset, "v2"), objSize);
+    truncObjs->setEndOfBlob();
+    txId.reset(new BlobTxId(++txCount));
+    ASSERT_TRUE(volcat->putBlob(volId, blobName, nullptr, truncObjs, txId, 2).ok());
+    expected.erase(expected.upper_bound(lastOffset), expected.end());
+    expected[lastOffset] = testObject(lastOffset, "v2");
+    expectObjects(*vol, blobName, 0, 4 * perPage * objSize, expected);
+
+    // Deleting everything that is left removes the pages
+    ASSERT_TRUE(vol->deleteObject(blobName, 0, 4 * perPage * objSize).ok());
+    expectObjects(*vol, blobName, 0, 4 * perPage * objSize, {});
+    EXPECT_TRUE(vol->isExtentMap());
+}
+
+TEST_F(DmVolumeCatalogTest, block_volume_commit_batch) {
+    fds_volid_t volId = addBlockVolume();
+    DmPersistVolDB::ptr vol = getPersistVol(volId);
+    ASSERT_TRUE(vol->isExtentMap());
+
+    fds_uint64_t const objSize = vol->getObjSize();
+    fds_uint64_t const perPage = DmExtentPage::OBJECTS_PER_PAGE;
+    const std::string blobName = "block_commit_batch";
+
+    BlobObjList objs;
+    for (fds_uint64_t index : std::vector<fds_uint64_t> {1, 2, perPage}) {
+        objs[index * objSize] = BlobObjInfo(testObject(index * objSize), objSize);
+    }
+    ASSERT_TRUE(vol->putObject(blobName, objs).ok());
+
+    // A batch with a key per offset, as the commit log builds it
+    CatWriteBatch wb;
+    BlobObjectKey key {blobName};
+    auto put = [&wb, &key, objSize](fds_uint64_t index, const ObjectID & obj) {
+        key.setObjectIndex(index);
+        wb.Put(static_cast<leveldb::Slice>(key),
+               leveldb::Slice(reinterpret_cast<const char *>(obj.GetId()), obj.GetLen()));
+    };
+    auto del = [&wb, &key](fds_uint64_t index) {
+        key.setObjectIndex(index);
+        wb.Delete(static_cast<leveldb::Slice>(key));
+    };
+
+    // The last update of an offset wins, the same as with a key per offset
+    put(0, testObject(0, "a"));
+    del(0);
+    del(1);
+    put(1, testObject(objSize, "b"));
+    put(2, testObject(2 * objSize, "c"));
+    put(2, testObject(2 * objSize, "d"));
+    del(perPage);
+    put(perPage + 1, testObject((perPage + 1) * objSize, "e"));
+    del(perPage + 1);
+    put(perPage + 1, testObject((perPage + 1) * objSize, "f"));
+    ASSERT_TRUE(volcat->putBlob(volId, blobName, (perPage + 2) * objSize, nullptr, wb, 1).ok());
+
+    std::map<fds_uint64_t, ObjectID> const expected {
+        {objSize, testObject(objSize, "b")},
+        {2 * objSize, testObject(2 * objSize, "d")},
+        {(perPage + 1) * objSize, testObject((perPage + 1) * objSize, "f")}};
+    expectObjects(*vol, blobName, 0, 2 * perPage * objSize, expected);
+
+    BlobMetaDesc blobMeta;
+    ASSERT_TRUE(vol->getBlobMetaDesc(blobName, blobMeta).ok());
+    EXPECT_EQ((perPage + 2) * objSize, blobMeta.desc.blob_size);
+}
+
+TEST_F(DmVolumeCatalogTest, block_volume_snapshot_reads) {
+    fds_volid_t volId = addBlockVolume();
+    DmPersistVolDB::ptr vol = getPersistVol(volId);
+    ASSERT_TRUE(vol->isExtentMap());
+
+    fds_uint64_t const objSize = vol->getObjSize();
+    fds_uint64_t const perPage = DmExtentPage::OBJECTS_PER_PAGE;
+    const std::string blobName = "block_snapshot_reads";
+
+    std::map<fds_uint64_t, ObjectID> before;
+    BlobObjList objs;
+    for (fds_uint64_t index = 0; index < perPage + 10; ++index) {
+        before[index * objSize] = testObject(index * objSize);
+        objs[index * objSize] = BlobObjInfo(before[index * objSize], objSize);
+    }
+    ASSERT_TRUE(vol->putObject(blobName, objs).ok());
+
+    Catalog::MemSnap snap = NULL;
+    ASSERT_TRUE(vol->getInMemorySnapshot(snap).ok());
+
+    std::vector<boost::shared_ptr<VolumeDesc> > snapshots;
+    generateVolumes(snapshots, fpi::FDSP_VOL_BLKDEV_TYPE);
+    VolumeDesc & snapDesc = *snapshots.front();
+    snapDesc.fSnapshot = true;
+    snapDesc.srcVolumeId = volId;
+    ASSERT_TRUE(volcat->copyVolume(snapDesc).ok());
+    ASSERT_TRUE(volcat->activateCatalog(snapDesc.volUUID).ok());
+
+    // Overwrite across the page boundary, delete inside page 0, add a page
+    std::map<fds_uint64_t, ObjectID> after(before);
+    BlobObjList updates;
+    for (auto index : {perPage - 1, perPage, 2 * perPage}) {
+        after[index * objSize] = testObject(index * objSize, "v2");
+        updates[index * objSize] = BlobObjInfo(after[index * objSize], objSize);
+    }
+    ASSERT_TRUE(vol->putObject(blobName, updates).ok());
+    ASSERT_TRUE(vol->deleteObject(blobName, 3 * objSize, 5 * objSize).ok());
+    after.erase(after.lower_bound(3 * objSize), after.upper_bound(5 * objSize));
+
+    expectObjects(*vol, blobName, 0, 3 * perPage * objSize, before, snap);
+    expectObjects(*vol, blobName, 2 * objSize, (perPage + 1) * objSize, before, snap);
+    expectObjects(*vol, blobName, 0, 3 * perPage * objSize, after);
+    EXPECT_TRUE(vol->freeInMemorySnapshot(snap).ok());
+
+    DmPersistVolDB::ptr snapVol = getPersistVol(snapDesc.volUUID);
+    EXPECT_TRUE(snapVol->isExtentMap());
+    expectObjects(*snapVol, blobName, 0, 3 * perPage * objSize, before);
+}
+
 int main(int argc, char** argv) {
     // The following line must be executed to initialize Google Mock
     // (and Google Test) before running the tests.
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include <lib/Catalog.h>
+#include <catalogKeys/BlobObjectKey.h>
+#include <catalogKeys/CatalogKeyComparator.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static const std::string benchDir("/tmp/catalog_resources_gtest");
+
+static fds_uint64_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    fds_uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static fds_uint32_t openFiles() {
+    fds_uint32_t count = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir) {
+        while (readdir(dir)) {
+            ++count;
+        }
+        closedir(dir);
+    }
+    return count;
+}
+
+/**
+ * Opens nVolumes small catalogs, with a block cache and write buffer each,
+ * sharing resources or in one shared store, and writes then reads a few
+ * objects of each
+ */
+static void runBenchmark(fds_uint32_t nVolumes, CatalogResources *resources, bool sharedStore = false) {
+    auto res = std::system((std::string("rm -rf ") + benchDir + " && mkdir -p " + benchDir).c_str());
+    (void)res;
+    CatalogKeyComparator cmp;
+    fds_uint64_t rssBefore = residentBytes();
+    fds_uint32_t filesBefore = openFiles();
+
+    std::unique_ptr<SharedCatalogStore> store;
+    std::vector<std::unique_ptr<Catalog>> catalogs;
+    auto start = std::chrono::steady_clock::now();
+    if (sharedStore) {
+        store.reset(new SharedCatalogStore(benchDir + "/shared_vcat.ldb", *resources,
+                                           Catalog::WRITE_BUFFER_SIZE));
+    }
+    for (fds_uint32_t vol = 0; vol < nVolumes; ++vol) {
+        std::string name = benchDir + "/" + std::to_string(vol) + "_vcat.ldb";
+        if (store) {
+            catalogs.emplace_back(new Catalog(name, *store, vol + 1));
+        } else {
+            catalogs.emplace_back(new Catalog(name,
+                                              Catalog::WRITE_BUFFER_SIZE, Catalog::CACHE_SIZE,
+                                              "", "", 5, false,
+                                              &cmp, resources));
+        }
+        catalogs.back()->GetWriteOptions().sync = false;
+    }
+    double openSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const fds_uint32_t nObjects = 256;
+    std::string value(OBJECTID_DIGESTLEN, 'x');
+    start = std::chrono::steady_clock::now();
+    for (fds_uint32_t obj = 0; obj < nObjects; ++obj) {
+        for (auto &cat : catalogs) {
+            CatWriteBatch batch;
+            BlobObjectKey const key {"blob", obj};
+            batch.Put(static_cast<leveldb::Slice>(key), value);
+            ASSERT_TRUE(cat->Update(&batch).ok());
+        }
+    }
+    for (fds_uint32_t obj = 0; obj < nObjects; ++obj) {
+        for (auto &cat : catalogs) {
+            std::string read;
+            ASSERT_TRUE(cat->Query(BlobObjectKey("blob", obj), &read).ok());
+            ASSERT_EQ(value, read);
+        }
+    }
+    double opSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << (store ? "shared store" : resources ? "shared resources" : "private resources")
+              << ", " << nVolumes << " volumes"
+              << " open ms: " << static_cast<uint64_t>(openSecs * 1000)
+              << " rss MB: " << (residentBytes() - rssBefore) / (1024 * 1024)
+              << " fds: " << openFiles() - filesBefore
+              << " ops/s: " << static_cast<uint64_t>(2 * nObjects * nVolumes / opSecs)
+              << std::endl;
+
+    if (resources && !store) {
+        EXPECT_LE(resources->getWriteBufferUsed(),
+                  256 * 1024 * 1024 + nVolumes * CatalogResources::MIN_WRITE_BUFFER_SIZE);
+    }
+    catalogs.clear();
+    store.reset();
+    if (resources) {
+        EXPECT_EQ(0u, resources->getWriteBufferUsed());
+    }
+    res = std::system((std::string("rm -rf ") + benchDir).c_str());
+}
+
+TEST(CatalogResources, writeBufferBudget) {
+    const fds_uint32_t maxSize = 4 * 1024 * 1024;
+    CatalogResources resources(8 * 1024 * 1024, 16 * 1024 * 1024, 64);
+
+    std::vector<fds_uint32_t> grants;
+    for (fds_uint32_t i = 0; i < 100; ++i) {
+        grants.push_back(resources.acquireWriteBuffer(maxSize));
+        EXPECT_LE(grants.back(), maxSize);
+        EXPECT_GE(grants.back(), CatalogResources::MIN_WRITE_BUFFER_SIZE);
+    }
+    // The first catalogs get their full size, later ones a shrinking share
+    EXPECT_EQ(maxSize, grants.front());
+    EXPECT_EQ(CatalogResources::MIN_WRITE_BUFFER_SIZE, grants.back());
+    EXPECT_LE(resources.getWriteBufferUsed(),
+              16 * 1024 * 1024 + grants.size() * CatalogResources::MIN_WRITE_BUFFER_SIZE);
+
+    for (auto size : grants) {
+        resources.releaseWriteBuffer(size);
+    }
+    EXPECT_EQ(0u, resources.getWriteBufferUsed());
+}
+
+TEST(CatalogResources, benchmark) {
+    const fds_uint32_t nVolumes = 200;
+    runBenchmark(nVolumes, nullptr);
+
+    CatalogResources resources(256 * 1024 * 1024, 256 * 1024 * 1024, 64);
+    runBenchmark(nVolumes, &resources);
+    runBenchmark(nVolumes, &resources, true);
+}
+
+static std::string readBlob(Catalog& cat, fds_uint32_t obj) {
+    std::string value;
+    Error err = cat.Query(BlobObjectKey("blob", obj), &value);
+    return err.ok() ? value : std::string();
+}
+
+static std::vector<fds_uint32_t> listBlob(Catalog& cat) {
+    std::vector<fds_uint32_t> objs;
+    auto it = cat.NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        objs.push_back(BlobObjectKey(it->key()).getObjectIndex());
+    }
+    return objs;
+}
+
+TEST(SharedCatalogStore, volumeRanges) {
+    auto res = std::system((std::string("rm -rf ") + benchDir + " && mkdir -p " + benchDir).c_str());
+    (void)res;
+    CatalogResources resources(8 * 1024 * 1024, 8 * 1024 * 1024, 64);
+    SharedCatalogStore store(benchDir + "/shared_vcat.ldb", resources, Catalog::WRITE_BUFFER_SIZE);
+
+    /* Neighbouring volume ids, and one whose prefix is all ones */
+    Catalog vol1(benchDir + "/1", store, 1);
+    Catalog vol2(benchDir + "/2", store, 2);
+    Catalog volMax(benchDir + "/max", store, UINT64_MAX);
+    for (fds_uint32_t obj = 0; obj < 10; ++obj) {
+        ASSERT_TRUE(vol1.Update(BlobObjectKey("blob", obj), "one" + std::to_string(obj)).ok());
+        if (obj % 2) {
+            CatWriteBatch batch;
+            batch.Put(static_cast<leveldb::Slice>(BlobObjectKey("blob", obj)), "two");
+            ASSERT_TRUE(vol2.Update(&batch).ok());
+        }
+    }
+    ASSERT_TRUE(volMax.Update(BlobObjectKey("blob", 3), "max").ok());
+
+    /* A volume sees only its own keys, without their prefix */
+    EXPECT_EQ("one4", readBlob(vol1, 4));
+    EXPECT_EQ("", readBlob(vol2, 4));
+    EXPECT_EQ("two", readBlob(vol2, 5));
+    EXPECT_EQ(10u, listBlob(vol1).size());
+    EXPECT_EQ((std::vector<fds_uint32_t>{1, 3, 5, 7, 9}), listBlob(vol2));
+    EXPECT_EQ(std::vector<fds_uint32_t>{3}, listBlob(volMax));
+    {
+        auto it = vol1.NewIterator();
+        it->SeekToLast();
+        ASSERT_TRUE(it->Valid());
+        EXPECT_EQ(9u, BlobObjectKey(it->key()).getObjectIndex());
+        it->Seek(BlobObjectKey("blob", 7));
+        ASSERT_TRUE(it->Valid());
+        EXPECT_EQ(7u, BlobObjectKey(it->key()).getObjectIndex());
+        it = volMax.NewIterator();
+        it->SeekToLast();
+        ASSERT_TRUE(it->Valid());
+        EXPECT_EQ("max", it->value().ToString());
+    }
+
+    /* Copies are as of when they are taken */
+    Catalog::MemSnap snap;
+    vol2.GetSnapshot(snap);
+    ASSERT_TRUE(vol2.CopyTo(3).ok());
+    ASSERT_TRUE(vol2.Delete(BlobObjectKey("blob", 1)).ok());
+    Catalog vol3(benchDir + "/3", store, 3);
+    EXPECT_EQ((std::vector<fds_uint32_t>{1, 3, 5, 7, 9}), listBlob(vol3));
+    EXPECT_EQ("", readBlob(vol2, 1));
+    std::string value;
+    EXPECT_TRUE(vol2.Query(BlobObjectKey("blob", 1), &value, snap).ok());
+    vol2.ReleaseSnapshot(snap);
+
+    /* Exported volumes are catalogs of their own */
+    ASSERT_TRUE(vol3.DbSnap(benchDir + "/exported").ok());
+    {
+        Catalog exported(benchDir + "/exported");
+        EXPECT_EQ((std::vector<fds_uint32_t>{1, 3, 5, 7, 9}), listBlob(exported));
+    }
+
+    std::vector<fds_uint64_t> volumes;
+    ASSERT_TRUE(store.volumes(volumes).ok());
+    EXPECT_EQ((std::vector<fds_uint64_t>{1, 2, 3, UINT64_MAX}), volumes);
+
+    /* Deleting a volume leaves its neighbours alone */
+    ASSERT_TRUE(vol2.DeleteAll().ok());
+    EXPECT_TRUE(listBlob(vol2).empty());
+    EXPECT_EQ(10u, listBlob(vol1).size());
+    EXPECT_EQ(5u, listBlob(vol3).size());
+    EXPECT_EQ(1u, listBlob(volMax).size());
+    volumes.clear();
+    ASSERT_TRUE(store.volumes(volumes).ok());
+    EXPECT_EQ((std::vector<fds_uint64_t>{1, 3, UINT64_MAX}), volumes);
+    res = std::system((std::string("rm -rf ") + benchDir).c_str());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <concurrency/ShardedCounter.h>
+#include <fds_counters.h>
+#include <util/LatencyHistogram.h>
+#include <testlib/ContentionBenchmark.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static const uint64_t OpsPerThread = 2000000;
+
+TEST(LatencyHistogram, bucketing)
+{
+    /* Small values are recorded exactly */
+    for (uint64_t v = 0; v < LatencyHistogram::SUB_BUCKETS; ++v) {
+        EXPECT_EQ(LatencyHistogram::bucketIndex(v), v);
+        EXPECT_EQ(LatencyHistogram::bucketHighValue(v), v);
+    }
+
+    /* Every value falls within its bucket and buckets are contiguous */
+    uint64_t prevHigh = LatencyHistogram::SUB_BUCKETS - 1;
+    for (size_t i = LatencyHistogram::SUB_BUCKETS; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+        EXPECT_EQ(LatencyHistogram::bucketLowValue(i), prevHigh + 1);
+        prevHigh = LatencyHistogram::bucketHighValue(i);
+        EXPECT_EQ(LatencyHistogram::bucketIndex(LatencyHistogram::bucketLowValue(i)), i);
+        EXPECT_EQ(LatencyHistogram::bucketIndex(prevHigh), i);
+    }
+    EXPECT_EQ(prevHigh, static_cast<uint64_t>(LatencyHistogram::MAX_VALUE));
+
+    /* Out of range values are clamped */
+    EXPECT_EQ(LatencyHistogram::bucketIndex(~0ULL), LatencyHistogram::NUM_BUCKETS - 1);
+}
+
+TEST(LatencyHistogram, percentiles)
+{
+    LatencyHistogram h;
+    EXPECT_EQ(h.percentile(99), 0);
+
+    for (uint64_t v = 1; v <= 100000; ++v) {
+        h.record(v);
+    }
+    EXPECT_EQ(h.count(), 100000);
+
+    double maxError = 1.0 / LatencyHistogram::SUB_BUCKETS;
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        double expected = p * 1000;
+        double got = h.percentile(p);
+        EXPECT_GE(got, expected);
+        EXPECT_LE(got, expected * (1 + maxError));
+    }
+    EXPECT_GE(h.percentile(100), 100000);
+
+    LatencyHistogram h2;
+    h2.record(5000000, 100000);
+    h2.merge(h);
+    EXPECT_EQ(h2.count(), 200000);
+    EXPECT_GE(h2.percentile(99), 5000000);
+    EXPECT_LE(h2.percentile(25), 50000 * (1 + maxError));
+
+    h2.reset();
+    EXPECT_EQ(h2.count(), 0);
+}
+
+TEST(ShardedCounter, concurrentUpdates)
+{
+    ShardedCounter c;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&c]() {
+            for (uint64_t i = 0; i < 100000; ++i) {
+                c.add(2);
+                /* Cross shard decrements must still sum correctly */
+                c.sub(1);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(c.value(), 8 * 100000);
+
+    ShardedCounter copy(c);
+    EXPECT_EQ(copy.value(), c.value());
+    c.reset();
+    EXPECT_EQ(c.value(), 0);
+}
+
+TEST(NumericCounter, sampledWatermarks)
+{
+    NumericCounter c;
+    c.incr(10);
+    EXPECT_EQ(c.value(), 10);
+    EXPECT_EQ(c.sampled_max_value(), 10);
+    c.decr(7);
+    /* Reading the value doesn't move the watermarks */
+    EXPECT_EQ(c.value(), 3);
+    EXPECT_EQ(c.sampled_min_value(), 3);
+    EXPECT_EQ(c.sampled_max_value(), 10);
+}
+
+TEST(LatencyCounter, percentilesOnRequest)
+{
+    LatencyCounter plain;
+    plain.update(100);
+    EXPECT_FALSE(plain.tracksPercentiles());
+    EXPECT_EQ(plain.percentile(99), 0);
+
+    LatencyCounter tracked;
+    tracked.trackPercentiles();
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        tracked.update(v);
+    }
+    EXPECT_GE(tracked.percentile(99), 990);
+    LatencyCounter copy(tracked);
+    EXPECT_TRUE(copy.tracksPercentiles());
+    EXPECT_EQ(copy.percentile(50), tracked.percentile(50));
+
+    /* Heap allocated counters keep their shards on separate lines */
+    std::unique_ptr<LatencyCounter> heap(new LatencyCounter());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(heap.get()) % FDS_CACHELINE_SIZE, 0u);
+
+    /* Merging into a counter without percentiles only adds the totals */
+    plain += tracked;
+    EXPECT_EQ(plain.count(), 1001);
+    EXPECT_EQ(plain.percentile(99), 0);
+}
+
+/**
+ * Contention benchmark.  Compares a single shared atomic (what NumericCounter
+ * and LatencyCounter used to be) against the sharded counter and the latency
+ * histogram under an increasing number of updating threads.
+ */
+TEST(ShardedCounter, contentionBenchmark)
+{
+    unsigned maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "threads,\tatomic ops/s,\tsharded ops/s,\thistogram ops/s" << std::endl;
+    for (unsigned n = 1; n <= maxThreads; n *= 2) {
+        std::atomic<uint64_t> plain(0);
+        ShardedCounter sharded;
+        LatencyHistogram hist;
+
+        double atomicRate = TestUtils::runContendedOps(n, OpsPerThread, [&plain](uint64_t) {
+            plain.fetch_add(1, std::memory_order_relaxed);
+        });
+        double shardedRate = TestUtils::runContendedOps(n, OpsPerThread, [&sharded](uint64_t) {
+            sharded.add(1);
+        });
+        double histRate = TestUtils::runContendedOps(n, OpsPerThread, [&hist](uint64_t i) {
+            hist.record(1000 + (i & 0xfff));
+        });
+
+        EXPECT_EQ(plain.load(), n * OpsPerThread);
+        EXPECT_EQ(sharded.value(), n * OpsPerThread);
+        EXPECT_EQ(hist.count(), n * OpsPerThread);
+        std::cout << n << ",\t" << static_cast<uint64_t>(atomicRate)
+                  << ",\t" << static_cast<uint64_t>(shardedRate)
+                  << ",\t" << static_cast<uint64_t>(histRate) << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -135,7 +135,7 @@ void PerfTraceUTProc::task(int id) {
         std::cout << "end - task=" << jobs_[id].id << " type=" << jobs_[id].type <<
             " volid=" << jobs_[id].volid <<
             " delay=" << jobs_[id].delay << " latency=";
-        LatencyCounter * plc = dynamic_cast<LatencyCounter *>(pc ? pc->data.get() :
+        SimpleLatencyCounter * plc = dynamic_cast<SimpleLatencyCounter *>(pc ? pc->data.get() :
                 jobs_[id].ctx.data.get());
         std::cout << plc->latency() << std::endl;
     }
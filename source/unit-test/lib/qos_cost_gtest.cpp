@@ -0,0 +1,194 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "qos_cost.h"
+#include "QoSWFQDispatcher.h"
+
+using namespace fds;  // NOLINT
+
+TEST(IoCostModel, cost)
+{
+    auto flat = IoCostModel::forTier(IoCostModel::FLAT);
+    EXPECT_EQ(1u, flat.cost(FDS_SM_GET_OBJECT, 1024 * 1024));
+
+    auto hdd = IoCostModel::forTier(IoCostModel::HDD);
+    EXPECT_EQ(1u, hdd.cost(FDS_SM_GET_OBJECT, 0));
+    EXPECT_EQ(1u, hdd.cost(FDS_SM_GET_OBJECT, 4096));
+    EXPECT_EQ(3u, hdd.cost(FDS_SM_GET_OBJECT, 1024 * 1024));
+
+    auto ssd = IoCostModel::forTier(IoCostModel::SSD);
+    EXPECT_EQ(33u, ssd.cost(FDS_SM_GET_OBJECT, 1024 * 1024));
+    EXPECT_EQ(65u, ssd.cost(FDS_SM_PUT_OBJECT, 1024 * 1024));
+    EXPECT_EQ(IoCostModel::MAX_IO_COST, ssd.cost(FDS_SM_PUT_OBJECT, 1ULL << 40));
+
+    IoCostModel::Tier tier;
+    EXPECT_TRUE(IoCostModel::tierFromName("ssd", tier));
+    EXPECT_EQ(IoCostModel::SSD, tier);
+    EXPECT_FALSE(IoCostModel::tierFromName("tape", tier));
+}
+
+/**
+ * Closed loop simulation of a disk shared by a tenant doing 4KB reads and a
+ * tenant doing 1MB reads, both with the same QoS policy.  The disk serves one
+ * IO at a time; a 1MB read keeps it busy three times as long as a 4KB read.
+ * Time is simulated: serving an IO advances the clock the dispatcher paces
+ * by instead of sleeping, so results don't depend on how busy the host is.
+ */
+namespace {
+
+struct SimIo : FDS_IOType {
+    fds_qid_t queueId;
+};
+
+struct SimTenant {
+    fds_qid_t       queueId;
+    fds_uint64_t    ioSize;
+    fds_uint64_t    ios {0};
+    fds_uint64_t    busyUs {0};
+    std::vector<SimIo> queued;
+};
+
+class SimQoSCtrl : public FDS_QoSControl {
+  public:
+    static const fds_uint64_t SEEK_US = 500;
+    static const fds_uint64_t BYTES_PER_US = 1024;
+
+    explicit SimQoSCtrl(const IoCostModel& model) {
+        threadPool = nullptr;
+        auto wfq = new QoSWFQDispatcher(this, 2000, 1, false, fds::GetLog());
+        wfq->setClock([this] { return nowUs.load(); });
+        dispatcher = wfq;
+        dispatcher->setCostModel(model);
+        tenants[0].queueId = 1;
+        tenants[0].ioSize = 4096;
+        tenants[1].queueId = 2;
+        tenants[1].ioSize = 1024 * 1024;
+        for (auto& tenant : tenants) {
+            queues.emplace_back(new FDS_VolumeQueue(64, 0, 100, 5));
+            queues.back()->activate();
+            dispatcher->registerQueue(tenant.queueId, queues.back().get());
+            tenant.queued.resize(8);
+        }
+    }
+
+    ~SimQoSCtrl() {
+        delete dispatcher;
+    }
+
+    Error processIO(FDS_IOType* io) override {
+        std::lock_guard<std::mutex> g(lock);
+        disk.push_back(static_cast<SimIo*>(io));
+        cv.notify_one();
+        return ERR_OK;
+    }
+
+    void run(fds_uint64_t durationUs) {
+        for (auto& tenant : tenants) {
+            for (auto& io : tenant.queued) {
+                io.queueId = tenant.queueId;
+                io.io_type = FDS_SM_GET_OBJECT;
+                io.io_size = tenant.ioSize;
+                dispatcher->enqueueIO(tenant.queueId, &io);
+            }
+        }
+        std::atomic<bool> dispatching {true};
+        std::thread dispatchThread([this, &dispatching] {
+            dispatcher->dispatchIOs();
+            dispatching = false;
+        });
+
+        /* Starts past 0 so the dispatcher never sees no time elapsed */
+        nowUs = 1;
+        while (nowUs < durationUs) {
+            SimIo* io;
+            {
+                std::unique_lock<std::mutex> g(lock);
+                if (!cv.wait_for(g, std::chrono::milliseconds(10),
+                                 [this] { return !disk.empty(); })) {
+                    continue;
+                }
+                io = disk.front();
+                disk.pop_front();
+            }
+            auto& tenant = tenants[io->queueId - 1];
+            auto serviceUs = SEEK_US + io->io_size / BYTES_PER_US;
+            nowUs += serviceUs;
+            tenant.ios++;
+            tenant.busyUs += serviceUs;
+            dispatcher->markIODone(io);
+            dispatcher->enqueueIO(io->queueId, io);
+        }
+        /* The dispatcher may be waiting for an outstanding IO to complete */
+        dispatcher->stop();
+        while (dispatching) {
+            std::deque<SimIo*> inflight;
+            {
+                std::lock_guard<std::mutex> g(lock);
+                inflight.swap(disk);
+            }
+            for (auto io : inflight) {
+                dispatcher->markIODone(io);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        dispatchThread.join();
+    }
+
+    /* Share of disk time the small IO tenant got */
+    double smallShare() const {
+        return static_cast<double>(tenants[0].busyUs) /
+                (tenants[0].busyUs + tenants[1].busyUs);
+    }
+
+    SimTenant tenants[2];
+
+  private:
+    /* Simulated time */
+    std::atomic<fds_uint64_t> nowUs {0};
+    std::vector<std::unique_ptr<FDS_VolumeQueue>> queues;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<SimIo*> disk;
+};
+
+double simulate(IoCostModel::Tier tier) {
+    SimQoSCtrl ctrl(IoCostModel::forTier(tier));
+    /* Two seconds of disk time */
+    ctrl.run(2000 * 1000);
+    std::cout << IoCostModel::tierName(tier) << ": 4KB tenant " << ctrl.tenants[0].ios
+              << " ios, 1MB tenant " << ctrl.tenants[1].ios << " ios, 4KB tenant disk share "
+              << ctrl.smallShare() << std::endl;
+    return ctrl.smallShare();
+}
+
+}  // namespace
+
+TEST(IoCostModel, mixedWorkloadFairness)
+{
+    /* Counting IOs the 1MB tenant gets three quarters of the disk */
+    double flatShare = simulate(IoCostModel::FLAT);
+    EXPECT_LT(flatShare, 0.35);
+
+    /* Counting tokens the tenants split it */
+    double hddShare = simulate(IoCostModel::HDD);
+    EXPECT_GT(hddShare, 0.4);
+    EXPECT_GT(hddShare, flatShare + 0.1);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
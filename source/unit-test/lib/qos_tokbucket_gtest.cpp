@@ -162,6 +162,25 @@ TEST(TokenBucket, expireTokens) {
     EXPECT_EQ(expectedExpiredTokens, expiredTokens) << "incorrect number of tokens expired.";
 }
 
+TEST(TokenBucket, chargeTokens) {
+    fds_uint64_t const rate = 1000;
+    fds_uint64_t const initialTokens = 5;
+    fds_uint64_t const charge = 25;
+
+    TestingTokenBucket testObject(rate, 10);
+    testObject.token_count_ = initialTokens;
+
+    testObject.chargeTokens(charge);
+    EXPECT_EQ(0, testObject.token_count_) << "held tokens were not charged first.";
+    EXPECT_EQ(charge - initialTokens, testObject.getDebt()) << "debt was not recorded.";
+    EXPECT_FALSE(testObject.hasTokens(1)) << "tokens available while in debt.";
+
+    // 30 tokens accumulate, 20 of them repay the debt
+    testObject.updateTokensOnly(testObject.t_last_update_ + 30000);
+    EXPECT_EQ(0, testObject.getDebt()) << "debt was not repaid.";
+    EXPECT_EQ(10, testObject.token_count_) << "repaid tokens were made available.";
+}
+
 #if GTEST_HAS_PARAM_TEST
 struct TokenBucketState {
     fds_uint64_t rate;
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <concurrency/RcuPtr.h>
+#include <fds_routing_table.h>
+#include <dlt.h>
+#include <testlib/ContentionBenchmark.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static const uint64_t OpsPerThread = 1000000;
+static const fds_uint32_t DltWidth = 8;
+static const fds_uint32_t DltDepth = 4;
+
+struct Tracked {
+    static std::atomic<int> live;
+    explicit Tracked(int v) : value(v) { ++live; }
+    ~Tracked() { value = -1; --live; }
+    int value;
+};
+std::atomic<int> Tracked::live {0};
+
+TEST(RcuPtr, deferredReclaim)
+{
+    {
+        RcuPtr<Tracked> ptr(new Tracked(1));
+        {
+            RcuReadGuard guard;
+            const Tracked* seen = ptr.get();
+            ptr.publish(new Tracked(2));
+
+            /* The reader may still look at the old object */
+            EXPECT_EQ(seen->value, 1);
+            EXPECT_EQ(ptr.pendingReclaim(), 1);
+            EXPECT_EQ(Tracked::live, 2);
+        }
+        ptr.reclaim();
+        EXPECT_EQ(ptr.pendingReclaim(), 0);
+        EXPECT_EQ(Tracked::live, 1);
+
+        /* Nobody reading, goes away right on publish */
+        ptr.publish(new Tracked(3));
+        EXPECT_EQ(ptr.pendingReclaim(), 0);
+        RcuReadGuard guard;
+        EXPECT_EQ(ptr.get()->value, 3);
+    }
+    EXPECT_EQ(Tracked::live, 0);
+}
+
+TEST(RcuPtr, concurrentPublish)
+{
+    RcuPtr<Tracked> ptr(new Tracked(0));
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&ptr, &done]() {
+            int last = 0;
+            while (!done) {
+                RcuReadGuard guard;
+                const Tracked* obj = ptr.get();
+                /* Never freed under us, values only go up */
+                ASSERT_GE(obj->value, last);
+                last = obj->value;
+            }
+        });
+    }
+    for (int i = 1; i <= 100000; ++i) {
+        ptr.publish(new Tracked(i));
+    }
+    done = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    ptr.reclaim();
+    EXPECT_EQ(ptr.pendingReclaim(), 0);
+    EXPECT_EQ(Tracked::live, 1);
+}
+
+TEST(RcuPtr, moreReadersThanSlots)
+{
+    RcuPtr<Tracked> ptr(new Tracked(1));
+    const size_t nThreads = RcuDomain::MAX_READERS + 8;
+    std::atomic<size_t> inside(0);
+    std::atomic<bool> release(false);
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < nThreads; ++t) {
+        readers.emplace_back([&ptr, &inside, &release]() {
+            RcuReadGuard guard;
+            EXPECT_EQ(ptr.get()->value, 1);
+            ++inside;
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (inside < nThreads) {
+        std::this_thread::yield();
+    }
+    /* The threads that found no free slot read through the locked path */
+    EXPECT_GE(RcuDomain::instance().overflowReaders(), 8u);
+    ptr.publish(new Tracked(2));
+    EXPECT_EQ(ptr.pendingReclaim(), 1);
+
+    release = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(RcuDomain::instance().overflowReaders(), 0u);
+    ptr.reclaim();
+    EXPECT_EQ(ptr.pendingReclaim(), 0);
+}
+
+static void fillDlt(DLT& dlt, fds_uint64_t version) {
+    for (fds_uint32_t i = 0; i < dlt.getNumTokens(); ++i) {
+        for (fds_uint32_t j = 0; j < dlt.getDepth(); ++j) {
+            dlt.setNode(i, j, NodeUuid(1 + (i + j) % 16));
+        }
+    }
+    /* Every version moves one token somewhere else */
+    dlt.setNode(version % dlt.getNumTokens(), 0, NodeUuid(100 + version));
+}
+
+static std::vector<ObjectID> randomObjectIds(size_t count) {
+    std::vector<ObjectID> oids;
+    oids.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t digest[20];
+        for (auto &b : digest) {
+            b = rand() & 0xff;
+        }
+        oids.emplace_back(digest, sizeof(digest));
+    }
+    return oids;
+}
+
+TEST(DLTManager, routeMatchesNodes)
+{
+    DLTManager mgr;
+    TableRoute route;
+    EXPECT_FALSE(mgr.getRoute(ObjectID(), route));
+
+    for (fds_uint64_t version = 1; version <= 3; ++version) {
+        DLT dlt(DltWidth, DltDepth, version, true);
+        fillDlt(dlt, version);
+        mgr.add(dlt);
+
+        for (fds_token_id token = 0; token < dlt.getNumTokens(); ++token) {
+            ASSERT_TRUE(mgr.getRoute(token, route));
+            EXPECT_EQ(route.version, version);
+            ASSERT_EQ(route.depth, DltDepth);
+            DltTokenGroupPtr nodes = mgr.getNodes(token);
+            for (fds_uint32_t j = 0; j < DltDepth; ++j) {
+                EXPECT_EQ(route.nodes[j], nodes->get(j));
+            }
+        }
+        for (auto &oid : randomObjectIds(1000)) {
+            ASSERT_TRUE(mgr.getRoute(oid, route));
+            DltTokenGroupPtr nodes = mgr.getNodes(oid);
+            for (fds_uint32_t j = 0; j < DltDepth; ++j) {
+                EXPECT_EQ(route.nodes[j], nodes->get(j));
+            }
+        }
+    }
+
+    /* Going back to an older version republishes it */
+    ASSERT_EQ(mgr.setCurrent(1), ERR_OK);
+    ASSERT_TRUE(mgr.getRoute(fds_token_id(1), route));
+    EXPECT_EQ(route.version, 1);
+    EXPECT_EQ(route.nodes[0], NodeUuid(101));
+}
+
+TEST(RoutingTable, shortColumns)
+{
+    std::vector<boost::shared_ptr<TableColumn>> columns;
+    for (fds_uint32_t len : {3, 1, 0}) {
+        boost::shared_ptr<TableColumn> column(new TableColumn(len));
+        for (fds_uint32_t i = 0; i < len; ++i) {
+            column->set(i, NodeUuid(10 + i));
+        }
+        columns.push_back(column);
+    }
+    RoutingTable table(7, 2, 3, columns);
+
+    /* No invalid uuids padding the short columns */
+    TableRoute route;
+    for (fds_uint32_t col = 0; col < columns.size(); ++col) {
+        table.getRoute(col, route);
+        EXPECT_EQ(route.version, 7);
+        ASSERT_EQ(route.depth, columns[col]->getLength());
+        EXPECT_EQ(table.getColumnLength(col), columns[col]->getLength());
+        for (fds_uint32_t i = 0; i < route.depth; ++i) {
+            EXPECT_EQ(route.get(i), NodeUuid(10 + i));
+        }
+    }
+    EXPECT_EQ(table.getNumSvcs(), 3);
+}
+
+TEST(DLTManager, deepTableNotPublished)
+{
+    static const fds_uint32_t deepDepth = TableRoute::MAX_DEPTH + 2;
+    DLTManager mgr;
+    DLT dlt(DltWidth, deepDepth, 1, true);
+    fillDlt(dlt, 1);
+    mgr.add(dlt);
+
+    /* Left to the locked lookups, which a route can still carry */
+    TableRoute route;
+    ObjectID oid = randomObjectIds(1).front();
+    EXPECT_FALSE(mgr.getRoute(oid, route));
+    DltTokenGroupPtr nodes = mgr.getDLT()->getNodes(oid);
+    route.assign(mgr.getDLT()->getVersion(), nodes);
+    ASSERT_EQ(route.depth, deepDepth);
+    for (fds_uint32_t j = 0; j < deepDepth; ++j) {
+        EXPECT_EQ(route.get(j), nodes->get(j));
+    }
+
+    /* Shallow enough to be copied */
+    boost::shared_ptr<TableColumn> shallow(new TableColumn(2));
+    shallow->set(1, NodeUuid(5));
+    route.assign(2, shallow);
+    EXPECT_FALSE(route.column);
+    EXPECT_EQ(route.depth, 2);
+    EXPECT_EQ(route.get(1), NodeUuid(5));
+}
+
+/**
+ * Lookup benchmark.  Compares the locked shared_ptr lookup the IO path used
+ * to do (getNodes) against the RCU published flat table (getRoute), with a
+ * writer adding a new DLT version every millisecond.
+ */
+TEST(DLTManager, lookupBenchmark)
+{
+    DLTManager mgr;
+    std::atomic<fds_uint64_t> version(1);
+    {
+        DLT dlt(DltWidth, DltDepth, version, true);
+        fillDlt(dlt, version);
+        mgr.add(dlt);
+    }
+    std::vector<ObjectID> oids = randomObjectIds(4096);
+
+    std::atomic<bool> done(false);
+    std::thread writer([&mgr, &version, &done]() {
+        while (!done) {
+            DLT dlt(DltWidth, DltDepth, version + 1, true);
+            fillDlt(dlt, version + 1);
+            mgr.add(dlt);
+            ++version;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    unsigned maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "threads,\tgetNodes lookups/s,\tgetRoute lookups/s" << std::endl;
+    for (unsigned n = 1; n <= maxThreads; n *= 2) {
+        double lockedRate = TestUtils::runContendedOps(n, OpsPerThread, [&mgr, &oids](uint64_t i) {
+            DltTokenGroupPtr nodes = mgr.getNodes(oids[i & 4095]);
+            ASSERT_EQ(nodes->getLength(), DltDepth);
+        });
+        double rcuRate = TestUtils::runContendedOps(n, OpsPerThread, [&mgr, &oids](uint64_t i) {
+            TableRoute route;
+            ASSERT_TRUE(mgr.getRoute(oids[i & 4095], route));
+            ASSERT_EQ(route.depth, DltDepth);
+        });
+        std::cout << n << ",\t" << static_cast<uint64_t>(lockedRate)
+                  << ",\t" << static_cast<uint64_t>(rcuRate) << std::endl;
+    }
+    done = true;
+    writer.join();
+    std::cout << "dlt versions added: " << version - 1 << std::endl;
+}
+
+int
+main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
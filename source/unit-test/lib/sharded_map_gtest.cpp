@@ -0,0 +1,189 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <concurrency/Mutex.h>
+#include <concurrency/SequenceIdAllocator.h>
+#include <concurrency/ShardedMap.h>
+#include <testlib/ContentionBenchmark.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static const uint64_t OpsPerThread = 200000;
+
+typedef std::shared_ptr<uint64_t> ReqPtr;
+
+TEST(ShardedMap, basic)
+{
+    ShardedMap<uint64_t, ReqPtr> m;
+    ReqPtr r;
+    EXPECT_FALSE(m.find(1, r));
+    EXPECT_FALSE(m.erase(1, r));
+
+    for (uint64_t i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(m.insert(i, std::make_shared<uint64_t>(i)));
+    }
+    EXPECT_FALSE(m.insert(10, std::make_shared<uint64_t>(0)));
+    EXPECT_EQ(m.size(), 1000u);
+
+    ASSERT_TRUE(m.find(10, r));
+    EXPECT_EQ(*r, 10u);
+    ASSERT_TRUE(m.erase(10, r));
+    EXPECT_EQ(*r, 10u);
+    EXPECT_FALSE(m.find(10, r));
+    EXPECT_EQ(m.size(), 999u);
+
+    ShardedMap<uint64_t, ReqPtr, 1> single;
+    EXPECT_TRUE(single.insert(1, r));
+    EXPECT_TRUE(single.find(1, r));
+}
+
+TEST(SequenceIdAllocator, uniqueIds)
+{
+    /* A whole number of ranges, so the sequence ends up past all of them */
+    const uint64_t IdsPerThread = 160 * 64;
+    for (uint64_t rangeSize : {1, 64}) {
+        /* Start close to wrapping around */
+        uint64_t start = ~0ULL - 1000;
+        SequenceIdAllocator alloc(start, rangeSize);
+        std::vector<std::vector<uint64_t>> ids(8);
+        std::vector<std::thread> threads;
+        for (auto &threadIds : ids) {
+            threads.emplace_back([&alloc, &threadIds]() {
+                for (uint64_t i = 0; i < IdsPerThread; ++i) {
+                    threadIds.push_back(alloc.next());
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        std::vector<uint64_t> all;
+        for (auto &threadIds : ids) {
+            all.insert(all.end(), threadIds.begin(), threadIds.end());
+        }
+        std::sort(all.begin(), all.end());
+        EXPECT_EQ(std::unique(all.begin(), all.end()), all.end());
+        EXPECT_EQ(alloc.current(), start + 8 * IdsPerThread);
+    }
+
+    /* Without ranges, ids are handed out in order */
+    SequenceIdAllocator alloc(5);
+    EXPECT_EQ(alloc.next(), 6u);
+    EXPECT_EQ(alloc.next(), 7u);
+    alloc.reset(100);
+    EXPECT_EQ(alloc.next(), 101u);
+
+    /* A thread switching allocators still gets ids of the right one */
+    SequenceIdAllocator a(0, 16);
+    SequenceIdAllocator b(1000, 16);
+    EXPECT_EQ(a.next(), 1u);
+    EXPECT_EQ(b.next(), 1001u);
+    EXPECT_EQ(a.next(), 17u);
+}
+
+/**
+ * What SvcRequestTracker used to be: one map behind one lock
+ */
+struct LockedMap {
+    bool insert(uint64_t id, const ReqPtr& r) {
+        fds_scoped_lock l(lock);
+        return map.insert(std::make_pair(id, r)).second;
+    }
+    bool find(uint64_t id, ReqPtr& r) {
+        fds_scoped_lock l(lock);
+        auto itr = map.find(id);
+        if (itr == map.end()) {
+            return false;
+        }
+        r = itr->second;
+        return true;
+    }
+    bool erase(uint64_t id, ReqPtr& r) {
+        fds_scoped_lock l(lock);
+        auto itr = map.find(id);
+        if (itr == map.end()) {
+            return false;
+        }
+        r = itr->second;
+        map.erase(itr);
+        return true;
+    }
+    fds_mutex lock;
+    std::unordered_map<uint64_t, ReqPtr> map;
+};
+
+/**
+ * Every thread sends requests and completes them: allocates an id, tracks the
+ * request, looks it up as a response would and pops it.  A few requests per
+ * thread are outstanding at any time.
+ * @return requests per second
+ */
+template <class Ids, class Map>
+double runRequests(unsigned nThreads, Ids &ids, Map &map)
+{
+    static const size_t Outstanding = 16;
+    return TestUtils::runContended(nThreads, OpsPerThread, [&ids, &map]() {
+        ReqPtr req = std::make_shared<uint64_t>(0);
+        uint64_t inFlight[Outstanding] = {0};
+        for (uint64_t i = 0; i < OpsPerThread; ++i) {
+            uint64_t &slot = inFlight[i % Outstanding];
+            ReqPtr r;
+            if (slot) {
+                EXPECT_TRUE(map.find(slot, r));
+                EXPECT_TRUE(map.erase(slot, r));
+            }
+            slot = ids.next();
+            EXPECT_TRUE(map.insert(slot, req));
+        }
+        for (auto id : inFlight) {
+            ReqPtr r;
+            map.erase(id, r);
+        }
+    });
+}
+
+/**
+ * Contention benchmark.  Compares the single locked map with one shared id
+ * sequence (what SvcRequestTracker and SvcRequestPool used to be) against the
+ * sharded map, without and with per thread id ranges, from 1 to 64 threads.
+ */
+TEST(ShardedMap, contentionBenchmark)
+{
+    std::cout << "threads,\tlocked req/s,\tsharded req/s,\tsharded+ranges req/s" << std::endl;
+    for (unsigned n = 1; n <= 64; n *= 2) {
+        SequenceIdAllocator sharedIds(1000);
+        SequenceIdAllocator rangeIds(1000, 256);
+        LockedMap locked;
+        ShardedMap<uint64_t, ReqPtr> sharded;
+        ShardedMap<uint64_t, ReqPtr> shardedRanges;
+
+        double lockedRate = runRequests(n, sharedIds, locked);
+        sharedIds.reset(1000);
+        double shardedRate = runRequests(n, sharedIds, sharded);
+        double rangesRate = runRequests(n, rangeIds, shardedRanges);
+
+        EXPECT_EQ(locked.map.size(), 0u);
+        EXPECT_EQ(sharded.size(), 0u);
+        EXPECT_EQ(shardedRanges.size(), 0u);
+        std::cout << n << ",\t" << static_cast<uint64_t>(lockedRate)
+                  << ",\t" << static_cast<uint64_t>(shardedRate)
+                  << ",\t" << static_cast<uint64_t>(rangesRate) << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
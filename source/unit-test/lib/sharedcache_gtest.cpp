@@ -4,14 +4,18 @@
 
 #define GTEST_USE_OWN_TR1_TUPLE 0
 
+#include <atomic>
 #include <cstdio>
+#include <iostream>
 #include <string>
 #include <vector>
 #include <bitset>
 #include "boost/smart_ptr/make_shared.hpp"
 
 #include <fds_types.h>
+#include <cache/SharedContentCache.h>
 #include <cache/SharedKvCache.h>
+#include <testlib/ContentionBenchmark.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -95,6 +99,156 @@ TEST(SharedKvCache, eviction)
     EXPECT_TRUE(cacheManager.getSize() == cacheSz);
 }
 
+TEST(SharedContentCache, shared_across_volumes)
+{
+    SharedContentCache<fds_uint32_t, fds_uint32_t> cache(100);
+    fds_volid_t v1(1), v2(2);
+    EXPECT_TRUE(cache.addVolume(v1, 10) == ERR_OK);
+    EXPECT_TRUE(cache.addVolume(v2, 10) == ERR_OK);
+    EXPECT_TRUE(cache.addVolume(v2, 10) == ERR_VOL_DUPLICATE);
+
+    // Added by one volume, hit by the other
+    cache.add(v1, 7, 7);
+    decltype(cache)::value_type v;
+    EXPECT_TRUE(cache.get(v2, 7, v) == ERR_OK);
+    EXPECT_TRUE(*v == 7);
+    EXPECT_EQ(cache.getSharedHits(), 1u);
+
+    // Cached once, accounted to both
+    cache.add(v2, 7, 7);
+    EXPECT_EQ(cache.getSize(), 1u);
+    EXPECT_EQ(cache.getVolumeSize(v1), 1u);
+    EXPECT_EQ(cache.getVolumeSize(v2), 1u);
+
+    // Unknown volumes neither add nor hit
+    fds_volid_t v3(3);
+    cache.add(v3, 8, 8);
+    EXPECT_TRUE(cache.get(v3, 7, v) == ERR_NOT_FOUND);
+    EXPECT_EQ(cache.getSize(), 1u);
+
+    // Still held by v2 once v1 goes away
+    EXPECT_TRUE(cache.removeVolume(v1) == ERR_OK);
+    EXPECT_TRUE(cache.get(v2, 7, v) == ERR_OK);
+    EXPECT_TRUE(cache.removeVolume(v2) == ERR_OK);
+    EXPECT_EQ(cache.getSize(), 0u);
+}
+
+TEST(SharedContentCache, volume_quota)
+{
+    SharedContentCache<fds_uint32_t, fds_uint32_t> cache(100);
+    fds_volid_t v1(1), v2(2);
+    cache.addVolume(v1, 5);
+    cache.addVolume(v2, 20);
+
+    for (fds_uint32_t i = 0; i < 10; i++) {
+        cache.add(v2, i, i);
+    }
+    // v1 going over its quota lets go of what it used least recently, entries
+    // v2 holds stay cached
+    for (fds_uint32_t i = 0; i < 10; i++) {
+        cache.add(v1, i, i);
+    }
+    EXPECT_EQ(cache.getVolumeSize(v1), 5u);
+    EXPECT_EQ(cache.getVolumeSize(v2), 10u);
+    EXPECT_EQ(cache.getSize(), 10u);
+
+    // Entries only v1 holds are evicted
+    for (fds_uint32_t i = 10; i < 20; i++) {
+        cache.add(v1, i, i);
+    }
+    EXPECT_EQ(cache.getVolumeSize(v1), 5u);
+    EXPECT_EQ(cache.getSize(), 15u);
+    decltype(cache)::value_type v;
+    EXPECT_TRUE(cache.get(v1, 10, v) == ERR_NOT_FOUND);
+    EXPECT_TRUE(cache.get(v1, 19, v) == ERR_OK);
+}
+
+TEST(SharedContentCache, eviction)
+{
+    uint32_t cacheSz = 20;
+    SharedContentCache<fds_uint32_t, fds_uint32_t> cache(cacheSz);
+    fds_volid_t v1(1), v2(2);
+    cache.addVolume(v1, cacheSz);
+    cache.addVolume(v2, cacheSz);
+
+    uint32_t i;
+    for (i = 0; i < cacheSz; i++) {
+        EXPECT_FALSE(cache.add((i % 2) ? v1 : v2, i, i));
+    }
+    // Volumes are within quota, but the cache is full
+    EXPECT_TRUE(cache.add(v1, i, i));
+    EXPECT_EQ(cache.getSize(), cacheSz);
+    EXPECT_EQ(cache.getVolumeSize(v1) + cache.getVolumeSize(v2), cacheSz);
+    decltype(cache)::value_type v;
+    EXPECT_TRUE(cache.get(v2, 0, v) == ERR_NOT_FOUND);
+}
+
+TEST(SharedContentCache, shards)
+{
+    // Four shards of 10, every volume gets a quarter of its quota in each
+    SharedContentCache<fds_uint32_t, fds_uint32_t> cache(40, 4);
+    fds_volid_t v1(1), v2(2);
+    EXPECT_TRUE(cache.addVolume(v1, 400) == ERR_OK);
+    EXPECT_TRUE(cache.addVolume(v2, 8) == ERR_OK);
+    EXPECT_TRUE(cache.addVolume(v1, 400) == ERR_VOL_DUPLICATE);
+
+    for (fds_uint32_t i = 0; i < 100; i++) {
+        cache.add(v1, i, i);
+    }
+    EXPECT_EQ(cache.getSize(), 40u);
+    EXPECT_EQ(cache.getVolumeSize(v1), 40u);
+
+    // Hits in every shard count against v2's quota share there
+    decltype(cache)::value_type v;
+    for (fds_uint32_t i = 60; i < 100; i++) {
+        EXPECT_TRUE(cache.get(v2, i, v) == ERR_OK);
+        EXPECT_TRUE(*v == i);
+    }
+    EXPECT_EQ(cache.getSharedHits(), 40u);
+    EXPECT_EQ(cache.getVolumeSize(v2), 8u);
+
+    EXPECT_TRUE(cache.removeVolume(v1) == ERR_OK);
+    EXPECT_TRUE(cache.removeVolume(v1) == ERR_NOT_FOUND);
+    EXPECT_EQ(cache.getSize(), 8u);
+    EXPECT_TRUE(cache.removeVolume(v2) == ERR_OK);
+    EXPECT_EQ(cache.getSize(), 0u);
+}
+
+/**
+ * Contention benchmark. Every thread reads cached objects of its own volume,
+ * one lock for the whole cache against one per shard, from 1 to 64 threads.
+ */
+TEST(SharedContentCache, contentionBenchmark)
+{
+    static const fds_uint32_t Objects = 4096;
+    static const uint64_t OpsPerThread = 200000;
+    auto runGets = [](unsigned nThreads, size_t shards) {
+        SharedContentCache<fds_uint32_t, fds_uint32_t> cache(nThreads * Objects, shards);
+        for (unsigned t = 0; t < nThreads; ++t) {
+            fds_volid_t volId(t + 1);
+            cache.addVolume(volId, Objects);
+            for (fds_uint32_t i = 0; i < Objects; ++i) {
+                cache.add(volId, t * Objects + i, i);
+            }
+        }
+        std::atomic<unsigned> nextVolume(0);
+        return TestUtils::runContended(nThreads, OpsPerThread, [&cache, &nextVolume]() {
+            unsigned t = nextVolume++;
+            fds_volid_t volId(t + 1);
+            decltype(cache)::value_type v;
+            for (uint64_t i = 0; i < OpsPerThread; ++i) {
+                EXPECT_TRUE(cache.get(volId, t * Objects + i % Objects, v) == ERR_OK);
+            }
+        });
+    };
+
+    std::cout << "threads,	1 shard gets/s,	16 shards gets/s" << std::endl;
+    for (unsigned n = 1; n <= 64; n *= 2) {
+        std::cout << n << ",\t" << static_cast<uint64_t>(runGets(n, 1))
+                  << ",\t" << static_cast<uint64_t>(runGets(n, 16)) << std::endl;
+    }
+}
+
 int main(int argc, char** argv) {
     // The following line must be executed to initialize Google Mock
     // (and Google Test) before running the tests.
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <util/timeutils.h>
+#include <lib/StatsCollector.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+struct StreamedStats {
+    void add(fds_volid_t volid, const std::vector<StatSlot>& slots) {
+        for (const auto &slot : slots) {
+            GenericCounter c;
+            slot.getCounter(STAT_AM_PUT_OBJ, &c);
+            putCount[volid] += c.count();
+            putTotal[volid] += c.total();
+            c.reset();
+            slot.getCounter(STAT_AM_QUEUE_WAIT, &c);
+            queueWaitCount += c.count();
+        }
+    }
+    std::map<fds_volid_t, fds_uint64_t> putCount;
+    std::map<fds_volid_t, fds_uint64_t> putTotal;
+    fds_uint64_t queueWaitCount {0};
+};
+
+/**
+ * Every thread records events for every volume; streamed histories must
+ * hold all of them once the thread stats are merged.
+ */
+TEST(StatsCollector, mergesThreadStats)
+{
+    const fds_uint32_t nThreads = 8;
+    const fds_uint32_t nVolumes = 50;
+    const fds_uint32_t eventsPerVolume = 20000;
+
+    StatsCollector collector(60, 60, 1);
+    StreamedStats streamed;
+    collector.startStreaming(NULL,
+                             [&streamed](fds_uint64_t start_ts,
+                                         fds_volid_t volid,
+                                         const std::vector<StatSlot>& slots) {
+                                 streamed.add(volid, slots);
+                             });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (fds_uint32_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&collector]() {
+            for (fds_uint32_t i = 0; i < eventsPerVolume; i++) {
+                fds_uint64_t now = util::getTimeStampNanos();
+                for (fds_uint32_t v = 1; v <= nVolumes; v++) {
+                    collector.recordEvent(fds_volid_t(v), now, STAT_AM_PUT_OBJ, 2);
+                    /* Not streamed */
+                    collector.recordEvent(fds_volid_t(v), now, STAT_AM_QUEUE_WAIT, 1);
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "events/s: "
+              << static_cast<uint64_t>(2.0 * nThreads * nVolumes * eventsPerVolume / secs)
+              << std::endl;
+
+    collector.sendStatStream();
+    collector.stopStreaming();
+
+    ASSERT_EQ(streamed.putCount.size(), nVolumes);
+    for (fds_uint32_t v = 1; v <= nVolumes; v++) {
+        EXPECT_EQ(streamed.putCount[fds_volid_t(v)], nThreads * eventsPerVolume);
+        EXPECT_EQ(streamed.putTotal[fds_volid_t(v)], 2u * nThreads * eventsPerVolume);
+    }
+    EXPECT_EQ(streamed.queueWaitCount, 0u);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
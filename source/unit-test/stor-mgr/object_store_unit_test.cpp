@@ -22,6 +22,8 @@
 #include <fds_module.h>
 #include <fds_process.h>
 #include <object-store/ObjectStore.h>
+#include <object-store/SmDiskMap.h>
+#include <ObjMeta.h>
 #include <sm_dataset.h>
 #include <sm_ut_utils.h>
 
@@ -706,6 +708,65 @@ TEST_F(SmObjectStoreTest, findNewSrcSMRetryTwoTest) {
     delete dlt;
 }
 
+TEST_F(SmObjectStoreTest, scrub_recheck) {
+    Error err(ERR_OK);
+    ObjectID oid = (volume1->testdata_).dataset_[0];
+    boost::shared_ptr<std::string> data =
+            (volume1->testdata_).dataset_map_[oid].getObjectData();
+    err = objectStore->putObject((volume1->voldesc_).volUUID, oid, data, false, tier);
+    ASSERT_TRUE(err.ok());
+
+    // find where the scrubber would read it from
+    ObjMetaData omd;
+    SmIoSnapshotObjectDB snapReq;
+    snapReq.retryReq = false;
+    objectStore->snapshotMetadata(SmDiskMap::smTokenId(oid, 16),
+                                  [&omd, &oid](const Error& snapErr,
+                                               SmIoSnapshotObjectDB*,
+                                               leveldb::ReadOptions& options,
+                                               std::shared_ptr<leveldb::DB> db,
+                                               bool, fds_uint32_t) {
+        ASSERT_TRUE(snapErr.ok());
+        std::string value;
+        leveldb::Slice key(reinterpret_cast<const char*>(oid.GetId()), oid.getDigestLength());
+        ASSERT_TRUE(db->Get(options, key, &value).ok());
+        omd.deserializeFrom(value);
+        db->ReleaseSnapshot(options.snapshot);
+    }, &snapReq);
+    diskio::DataTier objTier = omd.onTier(diskio::flashTier) ? diskio::flashTier : diskio::diskTier;
+    ASSERT_TRUE(omd.onTier(objTier));
+    obj_phy_loc_t loc = *omd.getObjPhyLoc(objTier);
+    fds_uint32_t objSize = omd.getObjSize();
+
+    // good data, read back the way the scrubber does
+    boost::shared_ptr<const std::string> readData =
+            objectStore->readDataExtent(oid, objTier, loc, objSize, err);
+    ASSERT_TRUE(err.ok());
+    EXPECT_EQ(objectStore->scrubObjectData(oid, objTier, loc, readData->data(), objSize), ERR_OK);
+
+    // bad data read from where the object no longer lives is not corruption
+    std::string bogus(objSize, 'x');
+    obj_phy_loc_t oldLoc = loc;
+    oldLoc.obj_stor_offset += 1;
+    EXPECT_EQ(objectStore->scrubObjectData(oid, objTier, oldLoc, bogus.data(), objSize), ERR_OK);
+    EXPECT_EQ(objectStore->scrubObjectData(oid, objTier, oldLoc, nullptr, objSize), ERR_OK);
+    diskio::DataTier usedTier = diskio::maxTier;
+    objectStore->getObject((volume1->voldesc_).volUUID, oid, usedTier, err);
+    EXPECT_TRUE(err.ok());
+
+    // a failed read of the current location is reported, not marked
+    EXPECT_EQ(objectStore->scrubObjectData(oid, objTier, loc, nullptr, objSize),
+              ERR_DISK_READ_FAILED);
+    objectStore->getObject((volume1->voldesc_).volUUID, oid, usedTier, err);
+    EXPECT_TRUE(err.ok());
+
+    // bad data at the current location marks the object corrupted
+    EXPECT_EQ(objectStore->scrubObjectData(oid, objTier, loc, bogus.data(), objSize),
+              ERR_ONDISK_DATA_CORRUPT);
+    objectStore->getObject((volume1->voldesc_).volUUID, oid, usedTier, err);
+    EXPECT_FALSE(err.ok());
+}
+
 TEST_F(SmObjectStoreTest, concurrent_gets_fail) {
     // for gets, do num ops = 2*dataset size
     GLOGDEBUG << "Running concurrent_gets test";
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <SmIo.h>
+#include <SmDiskIoLimiter.h>
+
+using namespace fds;  // NOLINT
+
+namespace {
+
+struct LimiterHarness {
+    LimiterHarness(fds_uint32_t minWindow, fds_uint32_t maxWindow)
+            : limiter([this](SmIoReq* io) {
+                          if (io == failNext) {
+                              return Error(ERR_DISK_READ_FAILED);
+                          }
+                          issued.push_back(io);
+                          return Error(ERR_OK);
+                      },
+                      [this](SmIoReq* io, const Error& err) {
+                          failed.push_back(io);
+                          failErr = err;
+                      },
+                      minWindow, maxWindow) {
+    }
+
+    SmIoReq* newIo() {
+        ios.emplace_back(new SmIoReq());
+        return ios.back().get();
+    }
+
+    SmDiskIoLimiter limiter;
+    std::deque<SmIoReq*> issued;
+    std::vector<SmIoReq*> failed;
+    Error failErr {ERR_OK};
+    /* IO that fails to issue */
+    SmIoReq* failNext {nullptr};
+    std::vector<std::unique_ptr<SmIoReq>> ios;
+};
+
+/**
+ * Closed loop: keeps disk 0 loaded with more IOs than any window and
+ * completes the oldest issued IO with the latency latencyFn gives for the
+ * number of IOs outstanding on the disk.  Returns the window after ops IOs.
+ */
+template <typename LatencyFn>
+fds_uint32_t runDisk(diskio::DataTier tier, int ops, LatencyFn latencyFn) {
+    LimiterHarness h(1, 32);
+    for (int i = 0; i < 64; i++) {
+        h.limiter.submit(h.newIo(), 0, tier);
+    }
+    for (int i = 0; i < ops; i++) {
+        auto io = h.issued.front();
+        h.issued.pop_front();
+        h.limiter.complete(io, latencyFn(h.limiter.getInflight(0)));
+        h.limiter.submit(io, 0, tier);
+    }
+    std::cout << h.limiter.toString() << std::endl;
+    return h.limiter.getWindow(0);
+}
+
+}  // namespace
+
+TEST(SmDiskIoLimiter, holdsIosBeyondWindow)
+{
+    LimiterHarness h(2, 2);
+    std::vector<SmIoReq*> reqs;
+    for (int i = 0; i < 4; i++) {
+        reqs.push_back(h.newIo());
+        h.limiter.submit(reqs.back(), 1, diskio::diskTier);
+    }
+    ASSERT_EQ(2u, h.issued.size());
+    EXPECT_EQ(2u, h.limiter.getInflight(1));
+    EXPECT_EQ(2u, h.limiter.getHeld(1));
+
+    /* Completions let held IOs through in submit order */
+    h.limiter.complete(reqs[1], 100);
+    ASSERT_EQ(3u, h.issued.size());
+    EXPECT_EQ(reqs[2], h.issued[2]);
+    h.limiter.complete(reqs[0], 100);
+    ASSERT_EQ(4u, h.issued.size());
+    EXPECT_EQ(reqs[3], h.issued[3]);
+    EXPECT_EQ(0u, h.limiter.getHeld(1));
+
+    /* Completing twice or an IO the limiter never saw changes nothing */
+    h.limiter.complete(reqs[0], 100);
+    h.limiter.complete(h.newIo(), 100);
+    EXPECT_EQ(2u, h.limiter.getInflight(1));
+}
+
+TEST(SmDiskIoLimiter, disksAreIndependent)
+{
+    LimiterHarness h(1, 1);
+    h.limiter.submit(h.newIo(), 1, diskio::diskTier);
+    h.limiter.submit(h.newIo(), 1, diskio::diskTier);
+    EXPECT_EQ(1u, h.limiter.getHeld(1));
+
+    /* A full disk doesn't hold IOs for another one */
+    h.limiter.submit(h.newIo(), 2, diskio::diskTier);
+    EXPECT_EQ(2u, h.issued.size());
+    EXPECT_EQ(1u, h.limiter.getInflight(2));
+    EXPECT_EQ(0u, h.limiter.getHeld(2));
+
+    EXPECT_EQ(4u, h.limiter.outstandingLimit());
+}
+
+TEST(SmDiskIoLimiter, failedIssueIsAnswered)
+{
+    LimiterHarness h(1, 1);
+    std::vector<SmIoReq*> reqs;
+    for (int i = 0; i < 3; i++) {
+        reqs.push_back(h.newIo());
+        h.limiter.submit(reqs.back(), 1, diskio::diskTier);
+    }
+    ASSERT_EQ(1u, h.issued.size());
+
+    /* A held IO that fails to issue is answered and frees its slot */
+    h.failNext = reqs[1];
+    h.limiter.complete(reqs[0], 100);
+    ASSERT_EQ(1u, h.failed.size());
+    EXPECT_EQ(reqs[1], h.failed[0]);
+    EXPECT_EQ(ERR_DISK_READ_FAILED, h.failErr);
+    ASSERT_EQ(2u, h.issued.size());
+    EXPECT_EQ(reqs[2], h.issued[1]);
+    EXPECT_EQ(1u, h.limiter.getInflight(1));
+    EXPECT_EQ(0u, h.limiter.getHeld(1));
+
+    /* So is one failing to issue right away */
+    h.limiter.complete(reqs[2], 100);
+    h.failNext = h.newIo();
+    h.limiter.submit(h.failNext, 1, diskio::diskTier);
+    EXPECT_EQ(2u, h.failed.size());
+    EXPECT_EQ(0u, h.limiter.getInflight(1));
+}
+
+TEST(SmDiskIoLimiter, shutdownAnswersHeldIos)
+{
+    LimiterHarness h(1, 1);
+    std::vector<SmIoReq*> reqs;
+    for (int i = 0; i < 3; i++) {
+        reqs.push_back(h.newIo());
+        h.limiter.submit(reqs.back(), 1, diskio::diskTier);
+    }
+    h.limiter.shutdown(ERR_SM_SHUTTING_DOWN);
+    ASSERT_EQ(2u, h.failed.size());
+    EXPECT_EQ(reqs[1], h.failed[0]);
+    EXPECT_EQ(reqs[2], h.failed[1]);
+    EXPECT_EQ(ERR_SM_SHUTTING_DOWN, h.failErr);
+    EXPECT_EQ(0u, h.limiter.getHeld(1));
+
+    /* The issued IO still completes, later ones are failed right away */
+    h.limiter.complete(reqs[0], 100);
+    EXPECT_EQ(0u, h.limiter.getInflight(1));
+    h.limiter.submit(h.newIo(), 1, diskio::diskTier);
+    EXPECT_EQ(3u, h.failed.size());
+    EXPECT_EQ(1u, h.issued.size());
+}
+
+TEST(SmDiskIoLimiter, windowFollowsLatency)
+{
+    /* Latency independent of queue depth: parallel device, window opens up */
+    auto ssdWindow = runDisk(diskio::flashTier, 5000,
+                             [](fds_uint32_t) { return 100; });
+    EXPECT_EQ(32u, ssdWindow);
+
+    /* Latency grows with queue depth: one IO at a time, window stays small */
+    auto hddWindow = runDisk(diskio::diskTier, 5000,
+                             [](fds_uint32_t inflight) { return 5000 * inflight; });
+    EXPECT_GE(hddWindow, 2u);
+    EXPECT_LE(hddWindow, 8u);
+
+    /* Fixed seek cost and some parallelism settle in between */
+    auto mixedWindow = runDisk(diskio::diskTier, 5000, [](fds_uint32_t inflight) {
+        return 4000 + 500 * inflight;
+    });
+    EXPECT_GT(mixedWindow, hddWindow);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
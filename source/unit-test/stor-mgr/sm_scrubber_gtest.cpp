@@ -0,0 +1,194 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <SMScrubber.h>
+
+using namespace fds;  // NOLINT
+
+namespace {
+
+const fds_uint32_t Blk = diskio::DataIO::disk_io_blk_size();
+
+SMScrubber::ScrubObject scrubObject(fds_uint16_t fileId, fds_blk_t offsetBlks, fds_uint32_t size) {
+    SMScrubber::ScrubObject obj;
+    obj.loc.obj_stor_loc_id = 1;
+    obj.loc.obj_file_id = fileId;
+    obj.loc.obj_stor_offset = offsetBlks;
+    obj.size = size;
+    return obj;
+}
+
+std::string progressPath() {
+    return "/tmp/sm_scrubber_gtest." + std::to_string(getpid()) + ".progress";
+}
+
+}  // namespace
+
+TEST(SMScrubber, adjacentObjectsReadAsOneExtent)
+{
+    /* Object sizes are rounded up to blocks on disk */
+    std::vector<SMScrubber::ScrubObject> objects = {
+        scrubObject(1, 0, Blk),
+        scrubObject(1, 1, Blk + 100),
+        scrubObject(1, 3, 100),
+    };
+    std::vector<SMScrubber::ScrubExtent> extents;
+    fds_uint64_t bytes = SMScrubber::planBatch(objects, 0, 1 << 20, 0, extents);
+
+    ASSERT_EQ(1u, extents.size());
+    EXPECT_EQ(0u, extents[0].begin);
+    EXPECT_EQ(3u, extents[0].end);
+    EXPECT_EQ(3 * Blk + 100, extents[0].len);
+    /* The padding of the second object is read too */
+    EXPECT_EQ(3 * Blk + 100, bytes);
+}
+
+TEST(SMScrubber, gapsAndFilesSplitExtents)
+{
+    std::vector<SMScrubber::ScrubObject> objects = {
+        scrubObject(1, 0, Blk),
+        /* 2 dead blocks in between */
+        scrubObject(1, 3, Blk),
+        /* 20 dead blocks in between */
+        scrubObject(1, 24, Blk),
+        /* Same offset, another file */
+        scrubObject(2, 25, Blk),
+    };
+    std::vector<SMScrubber::ScrubExtent> extents;
+    fds_uint64_t bytes = SMScrubber::planBatch(objects, 0, 1 << 20, 4 * Blk, extents);
+
+    ASSERT_EQ(3u, extents.size());
+    EXPECT_EQ(0u, extents[0].begin);
+    EXPECT_EQ(2u, extents[0].end);
+    EXPECT_EQ(4 * Blk, extents[0].len);
+    EXPECT_EQ(2u, extents[1].begin);
+    EXPECT_EQ(3u, extents[1].end);
+    EXPECT_EQ(Blk, extents[1].len);
+    EXPECT_EQ(3u, extents[2].begin);
+    EXPECT_EQ(4u, extents[2].end);
+    EXPECT_EQ(6 * Blk, bytes);
+
+    /* Without gaps allowed, every object is its own extent */
+    SMScrubber::planBatch(objects, 0, 1 << 20, 0, extents);
+    EXPECT_EQ(4u, extents.size());
+}
+
+TEST(SMScrubber, batchesAreBoundedByBytes)
+{
+    std::vector<SMScrubber::ScrubObject> objects;
+    for (fds_blk_t i = 0; i < 10; i++) {
+        objects.push_back(scrubObject(1, i, Blk));
+    }
+    std::vector<SMScrubber::ScrubExtent> extents;
+
+    /* The object that crosses the limit is the last one of the batch */
+    fds_uint64_t bytes = SMScrubber::planBatch(objects, 0, 3 * Blk + 1, 0, extents);
+    ASSERT_EQ(1u, extents.size());
+    EXPECT_EQ(4u, extents[0].end);
+    EXPECT_EQ(4 * Blk, bytes);
+
+    /* The next batch starts where the last one ended */
+    bytes = SMScrubber::planBatch(objects, 4, 3 * Blk + 1, 0, extents);
+    ASSERT_EQ(1u, extents.size());
+    EXPECT_EQ(4u, extents[0].begin);
+    EXPECT_EQ(8u, extents[0].end);
+
+    /* A batch is never empty, even with an object larger than the limit */
+    objects[8].size = 10 * Blk;
+    bytes = SMScrubber::planBatch(objects, 8, Blk, 0, extents);
+    ASSERT_EQ(1u, extents.size());
+    EXPECT_EQ(9u, extents[0].end);
+    EXPECT_EQ(10 * Blk, bytes);
+}
+
+TEST(SMScrubber, pacing)
+{
+    /* 1MB at 10MB/s takes 100ms */
+    EXPECT_EQ(100000u, SMScrubber::pacingDelayUs(1 << 20, 0, 10 << 20));
+    EXPECT_EQ(40000u, SMScrubber::pacingDelayUs(1 << 20, 60000, 10 << 20));
+    /* Slower than the limit already */
+    EXPECT_EQ(0u, SMScrubber::pacingDelayUs(1 << 20, 200000, 10 << 20));
+    /* No limit */
+    EXPECT_EQ(0u, SMScrubber::pacingDelayUs(1 << 20, 0, 0));
+}
+
+TEST(SMScrubber, progressSurvivesRestart)
+{
+    std::string path = progressPath();
+    std::remove(path.c_str());
+
+    /* No progress file yet */
+    SMScrubber::ProgressMap progress;
+    SMScrubber::loadProgress(path, progress);
+    EXPECT_TRUE(progress.empty());
+
+    progress[1].passInProgress = true;
+    progress[1].lastToken = 17;
+    progress[1].passes = 3;
+    progress[2].lastPassEndSecs = 1000;
+    progress[2].passes = 4;
+    ASSERT_TRUE(SMScrubber::saveProgress(path, progress));
+
+    /* Malformed lines don't hide the good ones */
+    {
+        std::ofstream out(path, std::ios::app);
+        out << "garbage\n";
+    }
+    SMScrubber::ProgressMap loaded;
+    SMScrubber::loadProgress(path, loaded);
+    ASSERT_EQ(2u, loaded.size());
+    EXPECT_TRUE(loaded[1].passInProgress);
+    EXPECT_EQ(17, loaded[1].lastToken);
+    EXPECT_EQ(3u, loaded[1].passes);
+    EXPECT_FALSE(loaded[2].passInProgress);
+    EXPECT_EQ(-1, loaded[2].lastToken);
+    EXPECT_EQ(1000u, loaded[2].lastPassEndSecs);
+    EXPECT_EQ(4u, loaded[2].passes);
+    std::remove(path.c_str());
+}
+
+TEST(SMScrubber, resume)
+{
+    SmTokenSet tokens = {2, 5, 9, 12};
+    SMScrubber::ScrubProgress progress;
+
+    /* A new pass starts from the first token */
+    EXPECT_EQ(2u, *SMScrubber::resumeToken(tokens, progress));
+    progress.passInProgress = true;
+    EXPECT_EQ(2u, *SMScrubber::resumeToken(tokens, progress));
+
+    /* An interrupted pass continues after the last token it finished */
+    progress.lastToken = 5;
+    EXPECT_EQ(9u, *SMScrubber::resumeToken(tokens, progress));
+    /* Even if that token moved away from the disk meanwhile */
+    progress.lastToken = 10;
+    EXPECT_EQ(12u, *SMScrubber::resumeToken(tokens, progress));
+    progress.lastToken = 12;
+    EXPECT_TRUE(SMScrubber::resumeToken(tokens, progress) == tokens.end());
+
+    /* Interrupted passes resume without waiting for the pass interval */
+    const fds_uint64_t interval = 24 * 3600;
+    const fds_uint64_t now = 100000;
+    progress.lastPassEndSecs = now - 10;
+    EXPECT_EQ(60u, SMScrubber::startDelaySecs(progress, interval, now));
+
+    /* Finished passes wait out the interval */
+    progress.passInProgress = false;
+    EXPECT_EQ(interval - 10, SMScrubber::startDelaySecs(progress, interval, now));
+    progress.lastPassEndSecs = now - interval - 10;
+    EXPECT_EQ(60u, SMScrubber::startDelaySecs(progress, interval, now));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
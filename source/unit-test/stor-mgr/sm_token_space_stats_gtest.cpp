@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <object-store/LiveObjectsDB.h>
+#include <object-store/TokenSpaceStats.h>
+
+using namespace fds;  // NOLINT
+
+static const std::string dbPath = "/tmp/sm_token_space_stats_gtest.db";
+
+class TokenSpaceStatsTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        std::remove(dbPath.c_str());
+        db.reset(new LiveObjectsDB(dbPath));
+        ASSERT_TRUE(db->createLiveObjectsTblAndIdx().ok());
+    }
+    void TearDown() override {
+        db.reset();
+        std::remove(dbPath.c_str());
+    }
+
+    LiveObjectsDB::unique_ptr db;
+};
+
+TEST_F(TokenSpaceStatsTest, accounting) {
+    TokenSpaceStats stats(db.get());
+    stats.load();
+    fds_uint64_t live = 0, reclaim = 0;
+
+    // Nothing known until the token is seeded or compacted
+    stats.addLive(5, diskio::diskTier, 4096);
+    EXPECT_FALSE(stats.get(5, diskio::diskTier, &live, &reclaim));
+    stats.setIfUnknown(5, diskio::diskTier, 8192, 0);
+    stats.setIfUnknown(5, diskio::diskTier, 1, 1);
+    ASSERT_TRUE(stats.get(5, diskio::diskTier, &live, &reclaim));
+    EXPECT_EQ(live, 8192u);
+    EXPECT_EQ(reclaim, 0u);
+
+    stats.addLive(5, diskio::diskTier, 4096);
+    stats.addReclaimable(5, diskio::diskTier, 2048);
+    stats.get(5, diskio::diskTier, &live, &reclaim);
+    EXPECT_EQ(live, 10240u);
+    EXPECT_EQ(reclaim, 2048u);
+
+    stats.reviveReclaimable(5, diskio::diskTier, 1024);
+    stats.get(5, diskio::diskTier, &live, &reclaim);
+    EXPECT_EQ(live, 11264u);
+    EXPECT_EQ(reclaim, 1024u);
+
+    // Tiers are accounted separately
+    EXPECT_FALSE(stats.get(5, diskio::flashTier, &live, &reclaim));
+
+    stats.setCompacted(5, diskio::diskTier, 11000);
+    stats.get(5, diskio::diskTier, &live, &reclaim);
+    EXPECT_EQ(live, 11000u);
+    EXPECT_EQ(reclaim, 0u);
+}
+
+TEST_F(TokenSpaceStatsTest, persisted) {
+    {
+        TokenSpaceStats stats(db.get());
+        stats.load();
+        stats.setCompacted(7, diskio::flashTier, 1000);
+        stats.addReclaimable(7, diskio::flashTier, 400);
+        stats.setCompacted(9, diskio::diskTier, 50);
+        stats.flush();
+        // Not flushed, lost
+        stats.addReclaimable(9, diskio::diskTier, 50);
+    }
+
+    TokenSpaceStats stats(db.get());
+    stats.load();
+    fds_uint64_t live = 0, reclaim = 0;
+    ASSERT_TRUE(stats.get(7, diskio::flashTier, &live, &reclaim));
+    EXPECT_EQ(live, 600u);
+    EXPECT_EQ(reclaim, 400u);
+    ASSERT_TRUE(stats.get(9, diskio::diskTier, &live, &reclaim));
+    EXPECT_EQ(live, 50u);
+    EXPECT_EQ(reclaim, 0u);
+
+    // Tokens SM gives up are forgotten
+    stats.removeToken(7);
+    EXPECT_FALSE(stats.get(7, diskio::flashTier, &live, &reclaim));
+    TokenSpaceStats reloaded(db.get());
+    reloaded.load();
+    EXPECT_FALSE(reloaded.get(7, diskio::flashTier, &live, &reclaim));
+    EXPECT_TRUE(reloaded.get(9, diskio::diskTier, &live, &reclaim));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,137 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <thread>
+#include <vector>
+
+#include <net/EndpointLatencyTracker.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static fpi::SvcUuid svcUuid(int64_t id)
+{
+    fpi::SvcUuid uuid;
+    uuid.svc_uuid = id;
+    return uuid;
+}
+
+TEST(EndpointLatencyTracker, pickFastest)
+{
+    HedgeConfig config;
+    config.enabled = true;
+    EndpointLatencyTracker tracker(config);
+
+    std::vector<fpi::SvcUuid> svcs = {svcUuid(1), svcUuid(2), svcUuid(3)};
+
+    /* Nothing recorded, caller's order is kept */
+    EXPECT_EQ(tracker.pickFastest(svcs), 0);
+
+    for (int i = 0; i < 10; i++) {
+        tracker.recordLatency(svcs[0], 5000);
+        tracker.recordLatency(svcs[1], 500);
+    }
+    /* Endpoint we know nothing about gets probed */
+    EXPECT_EQ(tracker.pickFastest(svcs), 2);
+
+    tracker.recordLatency(svcs[2], 2000);
+    EXPECT_EQ(tracker.pickFastest(svcs), 1);
+    EXPECT_EQ(tracker.getEwmaLatencyUs(svcs[1]), 500);
+
+    /* Moving average follows the endpoint slowing down */
+    for (int i = 0; i < 50; i++) {
+        tracker.recordLatency(svcs[1], 10000);
+    }
+    EXPECT_GT(tracker.getEwmaLatencyUs(svcs[1]), 9000);
+    EXPECT_EQ(tracker.pickFastest(svcs), 2);
+}
+
+TEST(EndpointLatencyTracker, hedgeDelay)
+{
+    HedgeConfig config;
+    config.enabled = true;
+    config.percentile = 95;
+    config.minDelayMs = 2;
+    config.maxDelayMs = 100;
+    EndpointLatencyTracker tracker(config);
+
+    /* Until enough samples are seen hedge as late as allowed */
+    EXPECT_EQ(tracker.getHedgeDelayMs(), config.maxDelayMs);
+
+    /* 95% of reads take 10ms, rest 500ms */
+    for (uint64_t i = 0; i < EndpointLatencyTracker::HEDGE_DELAY_REFRESH_SAMPLES; i++) {
+        tracker.recordLatency(svcUuid(1), (i % 100) < 95 ? 10000 : 500000);
+    }
+    EXPECT_GE(tracker.getHedgeDelayMs(), 10);
+    EXPECT_LE(tracker.getHedgeDelayMs(), 11);
+
+    /* Delay is clamped */
+    EndpointLatencyTracker fastTracker(config);
+    EndpointLatencyTracker slowTracker(config);
+    for (uint64_t i = 0; i < EndpointLatencyTracker::HEDGE_DELAY_REFRESH_SAMPLES; i++) {
+        fastTracker.recordLatency(svcUuid(1), 100);
+        slowTracker.recordLatency(svcUuid(1), 5000000);
+    }
+    EXPECT_EQ(fastTracker.getHedgeDelayMs(), config.minDelayMs);
+    EXPECT_EQ(slowTracker.getHedgeDelayMs(), config.maxDelayMs);
+}
+
+TEST(EndpointLatencyTracker, hedgeBudget)
+{
+    HedgeConfig config;
+    config.enabled = true;
+    config.budgetPct = 10;
+    config.budgetBurst = 2;
+    EndpointLatencyTracker tracker(config);
+
+    /* Burst is available up front */
+    EXPECT_TRUE(tracker.tryAcquireHedge());
+    EXPECT_TRUE(tracker.tryAcquireHedge());
+    EXPECT_FALSE(tracker.tryAcquireHedge());
+
+    /* One hedge for every 10 eligible requests */
+    for (int i = 0; i < 9; i++) {
+        tracker.addHedgeEligibleRequest();
+    }
+    EXPECT_FALSE(tracker.tryAcquireHedge());
+    tracker.addHedgeEligibleRequest();
+    EXPECT_TRUE(tracker.tryAcquireHedge());
+
+    /* Budget doesn't accumulate beyond the burst */
+    for (int i = 0; i < 1000; i++) {
+        tracker.addHedgeEligibleRequest();
+    }
+    int hedges = 0;
+    while (tracker.tryAcquireHedge()) {
+        hedges++;
+    }
+    EXPECT_EQ(hedges, config.budgetBurst);
+}
+
+TEST(EndpointLatencyTracker, concurrentRecord)
+{
+    HedgeConfig config;
+    EndpointLatencyTracker tracker(config);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&tracker, t]() {
+            for (int i = 0; i < 100000; i++) {
+                tracker.recordLatency(svcUuid(i % 8), 1000 * (t + 1));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < 8; i++) {
+        EXPECT_GE(tracker.getEwmaLatencyUs(svcUuid(i)), 1000);
+        EXPECT_LE(tracker.getEwmaLatencyUs(svcUuid(i)), 4000);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <boost/make_shared.hpp>
+#include <fdsp/svc_api_types.h>
+#include <net/SvcMsgPayload.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static boost::shared_ptr<fpi::UpdateSvcMapMsg> makeMsg(uint32_t nSvcs)
+{
+    auto msg = boost::make_shared<fpi::UpdateSvcMapMsg>();
+    for (uint32_t i = 0; i < nSvcs; i++) {
+        fpi::SvcInfo info;
+        info.svc_id.svc_uuid.svc_uuid = 0x1000 + i;
+        info.svc_port = 7000 + i;
+        info.ip = "10.1.1." + std::to_string(i % 256);
+        info.name = "svc" + std::to_string(i);
+        info.props["uuid"] = std::to_string(0x1000 + i);
+        msg->updates.push_back(info);
+    }
+    return msg;
+}
+
+TEST(SvcMsgPayload, typedMsg)
+{
+    auto msg = makeMsg(4);
+    SvcMsgPayload payload(msg);
+    EXPECT_TRUE(payload.hasMsg());
+    EXPECT_EQ(payload.getMsg<fpi::UpdateSvcMapMsg>(), msg);
+    /* Asked for as another type there's no message, callers fall back to bytes */
+    EXPECT_TRUE(payload.getMsg<fpi::GetSvcStatusMsg>() == nullptr);
+    EXPECT_TRUE(payload.copyMsg<fpi::GetSvcStatusMsg>() == nullptr);
+}
+
+TEST(SvcMsgPayload, handlerGetsCopy)
+{
+    auto msg = makeMsg(4);
+    auto expected = *msg;
+    SvcMsgPayload payload(msg);
+
+    /* What a local handler gets: equal, but not the sender's message */
+    auto copy = payload.copyMsg<fpi::UpdateSvcMapMsg>();
+    ASSERT_TRUE(copy != nullptr);
+    EXPECT_NE(copy, msg);
+    EXPECT_EQ(*copy, *msg);
+
+    /* A handler modifying its message changes nothing another endpoint sends */
+    copy->updates.clear();
+    EXPECT_EQ(*msg, expected);
+    boost::shared_ptr<fpi::UpdateSvcMapMsg> out;
+    fds::deserializeFdspMsg(payload.getBuf(), out);
+    ASSERT_TRUE(out != nullptr);
+    EXPECT_EQ(*out, expected);
+}
+
+TEST(SvcMsgPayload, serializedOnce)
+{
+    auto msg = makeMsg(4);
+    SvcMsgPayload payload(msg);
+    auto buf = payload.getBuf();
+    ASSERT_TRUE(buf != nullptr);
+    EXPECT_EQ(payload.getBuf().get(), buf.get());
+
+    boost::shared_ptr<fpi::UpdateSvcMapMsg> out;
+    fds::deserializeFdspMsg(buf, out);
+    ASSERT_TRUE(out != nullptr);
+    EXPECT_EQ(*out, *msg);
+}
+
+TEST(SvcMsgPayload, bytesOnly)
+{
+    auto buf = fds::serializeFdspMsg(*makeMsg(4));
+    SvcMsgPayload payload(buf);
+    EXPECT_FALSE(payload.hasMsg());
+    EXPECT_TRUE(payload.getMsg<fpi::UpdateSvcMapMsg>() == nullptr);
+    EXPECT_EQ(payload.getBuf(), buf);
+}
+
+/**
+* @brief Round trips per second of a request to a handler in the same process: the
+* handler's copy of the message, against the previous path where it was serialized by
+* the sender and deserialized for the handler.
+*/
+static double runBenchmark(bool typed, uint32_t nSvcs, uint32_t iters)
+{
+    auto msg = makeMsg(nSvcs);
+    uint64_t seen = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iters; i++) {
+        boost::shared_ptr<fpi::UpdateSvcMapMsg> handlerMsg;
+        if (typed) {
+            auto payload = boost::make_shared<SvcMsgPayload>(msg);
+            handlerMsg = payload->copyMsg<fpi::UpdateSvcMapMsg>();
+        } else {
+            auto buf = fds::serializeFdspMsg(*msg);
+            fds::deserializeFdspMsg(buf, handlerMsg);
+        }
+        seen += handlerMsg->updates.size();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(seen, static_cast<uint64_t>(nSvcs) * iters);
+
+    std::cout << (typed ? "typed" : "serialized")
+              << " svcs: " << nSvcs
+              << " round trips/s: " << static_cast<uint64_t>(iters / secs) << std::endl;
+    return iters / secs;
+}
+
+TEST(SvcMsgPayload, benchmark)
+{
+    for (uint32_t nSvcs : {1u, 16u, 256u}) {
+        uint32_t iters = 2000000 / (nSvcs * 4 + 4);
+        double serialized = runBenchmark(false, nSvcs, iters);
+        double typed = runBenchmark(true, nSvcs, iters);
+        EXPECT_GT(typed, serialized);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,295 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <net/SvcPeerSender.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+/**
+* @brief Stands in for a peer service.  Every connection is one end of a socket pair
+* and a thread reading frames off the other end.
+*/
+struct TestPeer {
+    ~TestPeer() {
+        for (auto &t : readers) {
+            t.join();
+        }
+    }
+
+    int connect() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return -1;
+        }
+        std::lock_guard<std::mutex> l(lock);
+        readers.emplace_back(&TestPeer::readFrames, this, fds[1]);
+        return fds[0];
+    }
+
+    /* Reads frames until the sender closes its end */
+    void readFrames(int fd) {
+        std::vector<char> buf(1 << 20);
+        size_t have = 0;
+        uint32_t lastSeq = 0;
+        while (!hangUp) {
+            if (paused) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            ssize_t n = ::read(fd, &buf[have], buf.size() - have);
+            if (n <= 0) {
+                break;
+            }
+            have += n;
+            size_t off = 0;
+            while (have - off >= SvcPeerSender::FRAME_HDR_BYTES) {
+                uint32_t len;
+                memcpy(&len, &buf[off], sizeof(len));
+                len = ntohl(len);
+                if (have - off < SvcPeerSender::FRAME_HDR_BYTES + len) {
+                    break;
+                }
+                /* Frames carry a sequence number, they must arrive in order */
+                uint32_t seq;
+                memcpy(&seq, &buf[off + SvcPeerSender::FRAME_HDR_BYTES], sizeof(seq));
+                if (seq <= lastSeq) {
+                    outOfOrder++;
+                }
+                lastSeq = seq;
+                frames++;
+                off += SvcPeerSender::FRAME_HDR_BYTES + len;
+            }
+            memmove(&buf[0], &buf[off], have - off);
+            have -= off;
+        }
+        ::close(fd);
+    }
+
+    std::mutex lock;
+    std::vector<std::thread> readers;
+    std::atomic<bool> paused {false};
+    /* Closes the connections without reading what's left */
+    std::atomic<bool> hangUp {false};
+    std::atomic<uint64_t> frames {0};
+    std::atomic<uint64_t> outOfOrder {0};
+};
+
+static SvcPeerSender::FramePtr newFrame(uint32_t seq, uint32_t size)
+{
+    SvcPeerSender::FramePtr frame(new SvcPeerSender::Frame());
+    frame->data.resize(SvcPeerSender::FRAME_HDR_BYTES + std::max<uint32_t>(size, sizeof(seq)));
+    memcpy(&frame->data[SvcPeerSender::FRAME_HDR_BYTES], &seq, sizeof(seq));
+    SvcPeerSender::setFrameLength(frame->data);
+    return frame;
+}
+
+static void waitFor(std::function<bool()> cond)
+{
+    for (int i = 0; i < 5000 && !cond(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST(SvcPeerSender, framesArriveInOrder)
+{
+    TestPeer peer;
+    uint64_t failed = 0;
+    {
+        SvcPeerSender sender(PeerSenderConfig(),
+                             [&peer]() { return peer.connect(); },
+                             [&failed](std::vector<SvcPeerSender::FramePtr> &f) {
+                                 failed += f.size();
+                             });
+        for (uint32_t seq = 1; seq <= 10000; seq++) {
+            auto frame = newFrame(seq, 100);
+            ASSERT_TRUE(sender.send(frame).ok());
+        }
+        waitFor([&peer]() { return peer.frames == 10000; });
+        std::cout << sender.logString() << std::endl;
+        EXPECT_EQ(sender.getFramesSent(), 10000u);
+        EXPECT_EQ(sender.getQueuedBytes(), 0u);
+    }
+    EXPECT_EQ(peer.frames, 10000u);
+    EXPECT_EQ(peer.outOfOrder, 0u);
+    EXPECT_EQ(failed, 0u);
+}
+
+TEST(SvcPeerSender, queueFullInsteadOfBlocking)
+{
+    TestPeer peer;
+    peer.paused = true;
+    {
+        PeerSenderConfig config;
+        config.maxQueuedBytes = 1 << 20;
+        SvcPeerSender sender(config,
+                             [&peer]() { return peer.connect(); },
+                             [](std::vector<SvcPeerSender::FramePtr> &) {});
+
+        /* Peer doesn't read: socket buffers fill up, then the queue */
+        uint32_t seq = 1;
+        Error err;
+        auto start = std::chrono::steady_clock::now();
+        for (; seq < 100000 && err.ok(); seq++) {
+            auto frame = newFrame(seq, 4096);
+            err = sender.send(frame);
+            if (err == ERR_SVC_SEND_QUEUE_FULL) {
+                /* Refused frames stay with the caller */
+                EXPECT_TRUE(frame != nullptr);
+            }
+        }
+        EXPECT_EQ(err, ERR_SVC_SEND_QUEUE_FULL);
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+        /* Peer catches up, sends are accepted again */
+        peer.paused = false;
+        waitFor([&sender]() { return sender.getQueuedBytes() == 0; });
+        auto frame = newFrame(seq, 4096);
+        EXPECT_TRUE(sender.send(frame).ok());
+        waitFor([&sender]() { return sender.getQueuedBytes() == 0; });
+    }
+}
+
+TEST(SvcPeerSender, failedConnectFailsFrames)
+{
+    std::atomic<uint64_t> failed {0};
+    std::atomic<uint32_t> connects {0};
+    SvcPeerSender sender(PeerSenderConfig(),
+                         [&connects]() { connects++; return -1; },
+                         [&failed](std::vector<SvcPeerSender::FramePtr> &f) {
+                             failed += f.size();
+                         });
+    for (uint32_t seq = 1; seq <= 100; seq++) {
+        auto frame = newFrame(seq, 100);
+        ASSERT_TRUE(sender.send(frame).ok());
+    }
+    waitFor([&failed]() { return failed == 100; });
+    EXPECT_EQ(failed, 100u);
+    EXPECT_GE(connects, 1u);
+    EXPECT_EQ(sender.getQueuedBytes(), 0u);
+}
+
+TEST(SvcPeerSender, partialWriteFailsUnwrittenFrames)
+{
+    const uint32_t total = 256;
+    TestPeer peer;
+    peer.paused = true;
+    std::atomic<uint64_t> failed {0};
+    {
+        /* One write for all of them, more than the socket buffers take */
+        PeerSenderConfig config;
+        config.maxBatchFrames = total;
+        SvcPeerSender sender(config,
+                             [&peer]() { return peer.connect(); },
+                             [&failed](std::vector<SvcPeerSender::FramePtr> &f) {
+                                 failed += f.size();
+                             });
+        for (uint32_t seq = 1; seq <= total; seq++) {
+            auto frame = newFrame(seq, 8192);
+            ASSERT_TRUE(sender.send(frame).ok());
+        }
+
+        /* Writer is blocked part way through the batch when the peer goes away */
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        peer.hangUp = true;
+        waitFor([&sender, &failed, total]() {
+            return sender.getFramesSent() + failed == total;
+        });
+
+        /* What went into the socket is sent, only the rest failed */
+        EXPECT_GT(sender.getFramesSent(), 0u);
+        EXPECT_GT(failed, 0u);
+        EXPECT_EQ(sender.getFramesSent() + failed, total);
+        EXPECT_EQ(sender.getQueuedBytes(), 0u);
+    }
+}
+
+/**
+* @brief Messages per second from nThreads to one peer.  The baseline is the previous
+* send path: one connection, a lock held across a write per message.
+*/
+static double runBenchmark(bool baseline, uint32_t nThreads,
+                           uint32_t msgSize, uint32_t msgsPerThread)
+{
+    TestPeer peer;
+    PeerSenderConfig config;
+    std::unique_ptr<SvcPeerSender> sender;
+    int baselineFd = -1;
+    std::mutex baselineLock;
+    if (baseline) {
+        baselineFd = peer.connect();
+    } else {
+        sender.reset(new SvcPeerSender(config,
+                                       [&peer]() { return peer.connect(); },
+                                       [](std::vector<SvcPeerSender::FramePtr> &) {}));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([&]() {
+            for (uint32_t i = 1; i <= msgsPerThread; i++) {
+                auto frame = newFrame(i, msgSize);
+                if (baseline) {
+                    std::lock_guard<std::mutex> l(baselineLock);
+                    ssize_t n = ::write(baselineFd, frame->data.data(), frame->data.size());
+                    ASSERT_EQ(n, static_cast<ssize_t>(frame->data.size()));
+                    continue;
+                }
+                /* Back off while the peer is behind, like a caller retrying */
+                while (!sender->send(frame).ok()) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    uint64_t total = nThreads * msgsPerThread;
+    waitFor([&peer, total]() { return peer.frames == total; });
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(peer.frames, total);
+
+    std::cout << (baseline ? "locked write" : "peer sender")
+              << " threads: " << nThreads
+              << " msg size: " << msgSize << " msgs/s: " << static_cast<uint64_t>(total / secs);
+    if (sender) {
+        std::cout << " msgs per write: " << sender->getFramesSent() / sender->getWrites();
+    }
+    std::cout << std::endl;
+
+    if (baseline) {
+        ::shutdown(baselineFd, SHUT_RDWR);
+        ::close(baselineFd);
+    }
+    return total / secs;
+}
+
+TEST(SvcPeerSender, benchmark)
+{
+    const uint32_t nThreads = 8;
+    const uint32_t msgs = 20000;
+    for (uint32_t msgSize : {512u, 4096u, 65536u}) {
+        uint32_t n = (msgSize > 4096) ? msgs / 10 : msgs;
+        runBenchmark(true, nThreads, msgSize, n);
+        runBenchmark(false, nThreads, msgSize, n);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,117 @@
+/* Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <unistd.h>
+#include <string>
+
+#include <boost/make_shared.hpp>
+#include <net/WorkloadCapture.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static fpi::AsyncHdr makeHeader(int64_t reqId, fpi::FDSPMsgTypeId typeId)
+{
+    fpi::AsyncHdr hdr;
+    hdr.msg_src_id = reqId;
+    hdr.msg_type_id = typeId;
+    hdr.msg_src_uuid.svc_uuid = 0x1001;
+    hdr.msg_dst_uuid.svc_uuid = 0x2002;
+    hdr.dlt_version = 7;
+    return hdr;
+}
+
+static void captureSome(const std::string& path, bool withPayloads)
+{
+    auto& capture = WorkloadCapture::instance();
+    ASSERT_EQ(capture.start(path, withPayloads, 0x2002), ERR_OK);
+    /* Only one capture at a time */
+    EXPECT_NE(capture.start(path, withPayloads, 0x2002), ERR_OK);
+    EXPECT_TRUE(WorkloadCapture::enabled());
+
+    auto payload = boost::make_shared<std::string>(4096, 'x');
+    auto empty = boost::make_shared<std::string>();
+    for (int64_t i = 0; i < 100; i++) {
+        capture.record(WorkloadRecord::REQUEST_IN,
+                       makeHeader(i, fpi::GetSvcStatusMsgTypeId), payload);
+        capture.record(WorkloadRecord::RESPONSE_OUT,
+                       makeHeader(i, fpi::GetSvcStatusRespMsgTypeId), empty);
+    }
+    capture.stop();
+    EXPECT_FALSE(WorkloadCapture::enabled());
+    EXPECT_EQ(capture.recorded(), 200u);
+    EXPECT_EQ(capture.dropped(), 0u);
+}
+
+TEST(WorkloadCapture, roundTrip)
+{
+    for (bool withPayloads : {false, true}) {
+        std::string path = "/tmp/workload_capture_gtest." + std::to_string(getpid());
+        captureSome(path, withPayloads);
+
+        WorkloadCapture::Reader reader;
+        ASSERT_EQ(reader.open(path), ERR_OK);
+        EXPECT_EQ(reader.header().withPayloads, withPayloads ? 1u : 0u);
+        EXPECT_EQ(reader.header().svcUuid, 0x2002);
+
+        WorkloadRecord rec;
+        std::string payload;
+        uint64_t lastTs = 0;
+        for (int64_t i = 0; i < 200; i++) {
+            ASSERT_TRUE(reader.next(rec, payload));
+            EXPECT_EQ(rec.reqId, i / 2);
+            EXPECT_GE(rec.timestampNs, lastTs);
+            lastTs = rec.timestampNs;
+            if (i % 2 == 0) {
+                EXPECT_EQ(rec.direction, WorkloadRecord::REQUEST_IN);
+                EXPECT_EQ(rec.msgTypeId, fpi::GetSvcStatusMsgTypeId);
+                EXPECT_EQ(rec.payloadSize, 4096u);
+                EXPECT_EQ(payload, withPayloads ? std::string(4096, 'x') : std::string());
+            } else {
+                EXPECT_EQ(rec.direction, WorkloadRecord::RESPONSE_OUT);
+                EXPECT_EQ(rec.payloadSize, 0u);
+            }
+            EXPECT_EQ(rec.dltVersion, 7);
+        }
+        EXPECT_FALSE(reader.next(rec, payload));
+        unlink(path.c_str());
+    }
+}
+
+TEST(WorkloadCapture, writeFailure)
+{
+    auto& capture = WorkloadCapture::instance();
+    /* Every write fails once the stdio buffer is flushed */
+    ASSERT_EQ(capture.start("/dev/full", true, 0x2002), ERR_OK);
+    auto payload = boost::make_shared<std::string>(64 * 1024, 'x');
+    for (int64_t i = 0; i < 1000 && WorkloadCapture::enabled(); i++) {
+        capture.record(WorkloadRecord::REQUEST_IN,
+                       makeHeader(i, fpi::GetSvcStatusMsgTypeId), payload);
+        usleep(1000);
+    }
+    EXPECT_FALSE(WorkloadCapture::enabled());
+
+    /* The failed capture let go of its file, a new one can start */
+    std::string path = "/tmp/workload_capture_gtest." + std::to_string(getpid());
+    captureSome(path, false);
+    unlink(path.c_str());
+}
+
+TEST(WorkloadCapture, disabledRecordsNothing)
+{
+    auto& capture = WorkloadCapture::instance();
+    EXPECT_FALSE(WorkloadCapture::enabled());
+    auto before = capture.recorded();
+    capture.record(WorkloadRecord::REQUEST_IN,
+                   makeHeader(1, fpi::GetSvcStatusMsgTypeId), StringPtr());
+    EXPECT_EQ(capture.recorded(), before);
+
+    WorkloadCapture::Reader reader;
+    EXPECT_EQ(reader.open("/tmp/workload_capture_gtest.missing"), ERR_NOT_FOUND);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
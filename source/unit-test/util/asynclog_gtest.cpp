@@ -0,0 +1,222 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <stdlib.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <util/Log.h>
+#include <util/LogRing.h>
+#include <util/AsyncLogBackend.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+namespace bfs = boost::filesystem;
+
+static std::string readRing(LogRing& ring) {
+    struct iovec iov[2];
+    int cnt;
+    size_t bytes = ring.peek(iov, cnt);
+    std::string out;
+    for (int i = 0; i < cnt; ++i) {
+        out.append(static_cast<char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    ring.consume(bytes);
+    return out;
+}
+
+/* Lines containing match, over all files in dir */
+static size_t countLines(const std::string& dir, const std::string& match) {
+    size_t lines = 0;
+    for (bfs::directory_iterator itr(dir), end; itr != end; ++itr) {
+        std::ifstream in(itr->path().string());
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.find(match) != std::string::npos) {
+                lines++;
+            }
+        }
+    }
+    return lines;
+}
+
+struct TempDir {
+    TempDir() {
+        char tmpl[] = "/tmp/asynclog_gtest.XXXXXX";
+        path = mkdtemp(tmpl);
+    }
+    ~TempDir() {
+        bfs::remove_all(path);
+    }
+    std::string path;
+};
+
+TEST(LogRing, pushAndWrap)
+{
+    LogRing ring(64);
+    EXPECT_EQ(ring.capacity(), 64);
+    EXPECT_TRUE(ring.empty());
+
+    std::string rec(40, 'a');
+    ASSERT_TRUE(ring.push(rec.data(), rec.size()));
+    EXPECT_EQ(readRing(ring), rec + "\n");
+
+    /* Second record straddles the end of the buffer */
+    std::string rec2(30, 'b');
+    ASSERT_TRUE(ring.push(rec2.data(), rec2.size()));
+    struct iovec iov[2];
+    int cnt;
+    EXPECT_EQ(ring.peek(iov, cnt), 31);
+    EXPECT_EQ(cnt, 2);
+    EXPECT_EQ(readRing(ring), rec2 + "\n");
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(LogRing, dropWhenFull)
+{
+    LogRing ring(64);
+    std::string rec(31, 'x');
+    ASSERT_TRUE(ring.push(rec.data(), rec.size()));
+    ASSERT_TRUE(ring.push(rec.data(), rec.size()));
+    /* Full, nothing is partially written */
+    EXPECT_FALSE(ring.push("y", 1));
+    EXPECT_EQ(ring.dropped(), 1);
+    EXPECT_EQ(readRing(ring), rec + "\n" + rec + "\n");
+
+    /* Never fits */
+    std::string big(100, 'z');
+    EXPECT_FALSE(ring.push(big.data(), big.size()));
+    EXPECT_EQ(ring.dropped(), 2);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(LogRing, producerConsumer)
+{
+    LogRing ring(1024);
+    const int total = 100000;
+    std::thread producer([&ring, total]() {
+        for (int i = 0; i < total;) {
+            std::string rec = std::to_string(i);
+            if (ring.push(rec.data(), rec.size())) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    /* Records come out whole and in order */
+    int expected = 0;
+    std::string pending;
+    while (expected < total) {
+        pending += readRing(ring);
+        size_t pos;
+        while ((pos = pending.find('\n')) != std::string::npos) {
+            ASSERT_EQ(pending.substr(0, pos), std::to_string(expected));
+            pending.erase(0, pos + 1);
+            expected++;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(AsyncLogBackend, writesAndRotates)
+{
+    TempDir dir;
+    const int nThreads = 4;
+    const int perThread = 5000;
+    {
+        AsyncLogBackend backend(dir.path + "/test", dir.path, 16 * 1024);
+        backend.set_open_handler([](std::ostream& os) { os << "header" << std::endl; });
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&backend, t, perThread]() {
+                for (int i = 0; i < perThread; ++i) {
+                    backend.consume(boost::log::record_view(),
+                                    "record " + std::to_string(t) + " " + std::to_string(i));
+                    /* Rotation is checked after each drain pass */
+                    if (i % 500 == 0) {
+                        backend.flush();
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        backend.stop();
+        EXPECT_EQ(countLines(dir.path, "record") + backend.dropped_records(),
+                  nThreads * perThread);
+    }
+
+    /* Every file starts with the header */
+    size_t files = 0;
+    for (bfs::directory_iterator itr(dir.path), end; itr != end; ++itr) {
+        std::ifstream in(itr->path().string());
+        std::string first;
+        std::getline(in, first);
+        EXPECT_EQ(first, "header");
+        files++;
+    }
+    EXPECT_GT(files, 1);
+    EXPECT_EQ(countLines(dir.path, "header"), files);
+}
+
+TEST(AsyncLogBackend, dropsOversizedRecord)
+{
+    TempDir dir;
+    AsyncLogBackend backend(dir.path + "/test", dir.path, 0, 1024);
+    backend.consume(boost::log::record_view(), std::string(4096, 'x'));
+    backend.consume(boost::log::record_view(), "fits");
+    backend.flush();
+    EXPECT_EQ(backend.dropped_records(), 1);
+    EXPECT_EQ(countLines(dir.path, "fits"), 1);
+}
+
+static std::atomic<int> evaluated {0};
+static int sideEffect() {
+    return ++evaluated;
+}
+
+TEST(fds_log, asyncSeverityEarlyOut)
+{
+    TempDir dir;
+    fds_log log(dir.path + "/fds", dir.path, fds_log::normal, true);
+
+    /* Below the level, nothing in the statement is evaluated */
+    FDS_LOG_SEV(log, fds_log::debug) << "hidden " << sideEffect();
+    EXPECT_EQ(evaluated, 0);
+
+    /* A trailing else still belongs to the caller's if */
+    bool elseTaken = false;
+    if (evaluated != 0)
+        FDS_LOG_SEV(log, fds_log::normal) << "not reached";
+    else
+        elseTaken = true;
+    EXPECT_TRUE(elseTaken);
+
+    FDS_LOG_SEV(log, fds_log::normal) << "visible " << sideEffect();
+    EXPECT_EQ(evaluated, 1);
+    log.flush();
+    EXPECT_EQ(countLines(dir.path, "visible 1"), 1);
+    EXPECT_EQ(countLines(dir.path, "hidden"), 0);
+
+    log.setSeverityFilter(fds_log::debug);
+    FDS_LOG_SEV(log, fds_log::debug) << "now visible";
+    log.flush();
+    EXPECT_EQ(countLines(dir.path, "now visible"), 1);
+    EXPECT_EQ(log.droppedRecords(), 0);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <concurrency/BatchCoalescer.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+struct FlushRecorder {
+    void flush(const int& key, std::vector<int>&& batch) {
+        std::lock_guard<std::mutex> l(lock);
+        batches[key].push_back(batch);
+        flushed += batch.size();
+    }
+
+    std::mutex lock;
+    std::map<int, std::vector<std::vector<int>>> batches;
+    std::atomic<size_t> flushed {0};
+};
+
+TEST(BatchCoalescer, flushOnMaxItems)
+{
+    FlushRecorder rec;
+    BatchCoalescer<int, int> coalescer(std::chrono::seconds(60), 4, 1 << 20,
+                                       [&rec](const int& k, std::vector<int>&& b) {
+                                           rec.flush(k, std::move(b));
+                                       });
+    for (int i = 0; i < 8; ++i) {
+        coalescer.add(i % 2, i);
+    }
+    /* Full batches go out immediately on the adding thread */
+    ASSERT_EQ(rec.flushed, 8);
+    EXPECT_EQ(rec.batches[0].size(), 1);
+    EXPECT_EQ(rec.batches[0][0], std::vector<int>({0, 2, 4, 6}));
+    EXPECT_EQ(rec.batches[1][0], std::vector<int>({1, 3, 5, 7}));
+}
+
+TEST(BatchCoalescer, flushOnMaxBytes)
+{
+    FlushRecorder rec;
+    BatchCoalescer<int, int> coalescer(std::chrono::seconds(60), 100, 100,
+                                       [&rec](const int& k, std::vector<int>&& b) {
+                                           rec.flush(k, std::move(b));
+                                       });
+    coalescer.add(0, 1, 40);
+    coalescer.add(0, 2, 40);
+    EXPECT_EQ(rec.flushed, 0);
+
+    /* Doesn't fit, open batch is sent first */
+    coalescer.add(0, 3, 40);
+    ASSERT_EQ(rec.flushed, 2);
+    EXPECT_EQ(rec.batches[0][0], std::vector<int>({1, 2}));
+
+    /* Too big on its own goes alone */
+    coalescer.add(1, 4, 1000);
+    ASSERT_EQ(rec.batches[1].size(), 1);
+    EXPECT_EQ(rec.batches[1][0], std::vector<int>({4}));
+
+    coalescer.stop();
+    EXPECT_EQ(rec.flushed, 4);
+}
+
+TEST(BatchCoalescer, flushOnWindow)
+{
+    FlushRecorder rec;
+    BatchCoalescer<int, int> coalescer(std::chrono::microseconds(200), 100, 1 << 20,
+                                       [&rec](const int& k, std::vector<int>&& b) {
+                                           rec.flush(k, std::move(b));
+                                       });
+    coalescer.add(0, 1);
+    coalescer.add(0, 2);
+    coalescer.add(1, 3);
+
+    auto start = std::chrono::steady_clock::now();
+    while (rec.flushed < 3 &&
+           std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    ASSERT_EQ(rec.flushed, 3);
+    EXPECT_EQ(rec.batches[0][0], std::vector<int>({1, 2}));
+    EXPECT_EQ(rec.batches[1][0], std::vector<int>({3}));
+}
+
+TEST(BatchCoalescer, concurrentAdds)
+{
+    FlushRecorder rec;
+    const int nThreads = 4;
+    const int perThread = 20000;
+    {
+        BatchCoalescer<int, int> coalescer(std::chrono::microseconds(50), 16, 1 << 20,
+                                           [&rec](const int& k, std::vector<int>&& b) {
+                                               rec.flush(k, std::move(b));
+                                           });
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&coalescer, t, perThread]() {
+                for (int i = 0; i < perThread; ++i) {
+                    coalescer.add(i % 8, t * perThread + i);
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+    /* Destruction flushes whatever is still open; every item shows up once */
+    ASSERT_EQ(rec.flushed, nThreads * perThread);
+    std::vector<bool> seen(nThreads * perThread, false);
+    for (auto &kv : rec.batches) {
+        for (auto &batch : kv.second) {
+            EXPECT_LE(batch.size(), 16);
+            for (auto item : batch) {
+                EXPECT_EQ(item % perThread % 8, kv.first);
+                EXPECT_FALSE(seen[item]);
+                seen[item] = true;
+            }
+        }
+    }
+}
+
+TEST(BatchCoalescer, addAfterStop)
+{
+    FlushRecorder rec;
+    BatchCoalescer<int, int> coalescer(std::chrono::seconds(60), 100, 1 << 20,
+                                       [&rec](const int& k, std::vector<int>&& b) {
+                                           rec.flush(k, std::move(b));
+                                       });
+    coalescer.add(0, 1);
+    coalescer.stop();
+    ASSERT_EQ(rec.flushed, 1);
+
+    /* Nothing is left to flush it later, so it goes right away */
+    coalescer.add(0, 2);
+    ASSERT_EQ(rec.flushed, 2);
+    EXPECT_EQ(rec.batches[0][1], std::vector<int>({2}));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
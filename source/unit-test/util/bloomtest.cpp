@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <string>
 #include <iostream>
+#include <cstring>
 
 #include <util/bloomfilter.h>
 
@@ -62,6 +63,62 @@ TEST_F(BFTest, basic) {
 
 }
 
+static ObjectID makeOid(uint32_t i) {
+    uint8_t digest[20] = {0};
+    memcpy(digest, &i, sizeof(i));
+    return ObjectID(digest);
+}
+
+TEST_F(BFTest, counting) {
+    fds::util::CountingBloomFilter cbf(64 * 1024);
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        cbf.add(makeOid(i));
+    }
+    /* Second reference to the first 100 */
+    for (uint32_t i = 0; i < 100; i++) {
+        cbf.add(makeOid(i));
+    }
+    /* Drop every reference to 500..999 and one reference to 0..99 */
+    for (uint32_t i = 500; i < 1000; i++) {
+        cbf.remove(makeOid(i));
+    }
+    for (uint32_t i = 0; i < 100; i++) {
+        cbf.remove(makeOid(i));
+    }
+
+    /* No false negatives */
+    for (uint32_t i = 0; i < 500; i++) {
+        EXPECT_TRUE(cbf.lookup(makeOid(i)));
+    }
+    uint32_t falsePositives = 0;
+    for (uint32_t i = 500; i < 1000; i++) {
+        if (cbf.lookup(makeOid(i))) falsePositives++;
+    }
+    EXPECT_LT(falsePositives, 10);
+
+    /* Plain bloomfilter has the same membership */
+    auto bf = cbf.toBloomFilter();
+    EXPECT_EQ(bf->getTotalBits(), 64 * 1024);
+    for (uint32_t i = 0; i < 1000; i++) {
+        EXPECT_EQ(bf->lookup(makeOid(i)), cbf.lookup(makeOid(i)));
+    }
+
+    /* Saturated counters are never decremented */
+    fds::util::CountingBloomFilter small(1024);
+    auto oid = makeOid(7);
+    for (uint32_t i = 0; i < 2 * fds::util::CountingBloomFilter::MAX_COUNT; i++) {
+        small.add(oid);
+    }
+    for (uint32_t i = 0; i < 4 * fds::util::CountingBloomFilter::MAX_COUNT; i++) {
+        small.remove(oid);
+    }
+    EXPECT_TRUE(small.lookup(oid));
+
+    cbf.clear();
+    EXPECT_FALSE(cbf.lookup(makeOid(1)));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
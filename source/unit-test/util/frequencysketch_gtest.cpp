@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <util/FrequencySketch.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+TEST(FrequencySketch, estimates)
+{
+    FrequencySketch sketch(4096, 1000000);
+    EXPECT_EQ(sketch.width(), 4096);
+    EXPECT_EQ(sketch.estimate(42), 0);
+
+    /* Key i is accessed i times */
+    for (uint64_t key = 1; key <= 100; ++key) {
+        for (uint64_t i = 0; i < key; ++i) {
+            sketch.increment(key);
+        }
+    }
+    /* Never undercounts, and with a wide sketch rarely overcounts */
+    uint32_t overcounted = 0;
+    for (uint64_t key = 1; key <= 100; ++key) {
+        EXPECT_GE(sketch.estimate(key), key);
+        if (sketch.estimate(key) > key) overcounted++;
+    }
+    EXPECT_LT(overcounted, 5);
+
+    /* Counters saturate */
+    for (int i = 0; i < 1000; ++i) {
+        sketch.increment(7777);
+    }
+    EXPECT_EQ(sketch.estimate(7777), static_cast<uint32_t>(FrequencySketch::MAX_COUNT));
+}
+
+TEST(FrequencySketch, aging)
+{
+    FrequencySketch sketch(1024, 100);
+    for (int i = 0; i < 99; ++i) {
+        sketch.increment(1);
+    }
+    EXPECT_EQ(sketch.estimate(1), 99);
+    EXPECT_EQ(sketch.agingCount(), 0);
+
+    /* 100th access ages the sketch */
+    sketch.increment(1);
+    EXPECT_EQ(sketch.agingCount(), 1);
+    EXPECT_EQ(sketch.estimate(1), 50);
+
+    /* Popularity that stops decays away */
+    for (int i = 0; i < 1000; ++i) {
+        sketch.increment(2);
+    }
+    EXPECT_EQ(sketch.estimate(1), 0);
+    EXPECT_GT(sketch.estimate(2), 40);
+}
+
+TEST(FrequencySketch, skewedWorkload)
+{
+    /* Zipf like workload: hot keys should stand out from the long tail */
+    FrequencySketch sketch(16 * 1024);
+    std::mt19937_64 gen(1);
+    std::uniform_int_distribution<uint64_t> tail(1000, 1000000);
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 4 == 0) {
+            sketch.increment(i % 40);
+        } else {
+            sketch.increment(tail(gen));
+        }
+    }
+    uint32_t minHot = FrequencySketch::MAX_COUNT;
+    for (uint64_t key = 0; key < 10; ++key) {
+        minHot = std::min(minHot, sketch.estimate(key * 4));
+    }
+    uint32_t maxCold = 0;
+    for (int i = 0; i < 1000; ++i) {
+        maxCold = std::max(maxCold, sketch.estimate(tail(gen)));
+    }
+    EXPECT_GT(minHot, maxCold);
+}
+
+TEST(FrequencySketch, concurrentIncrements)
+{
+    FrequencySketch sketch(4096, 1ULL << 40);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&sketch]() {
+            for (int i = 0; i < 100000; ++i) {
+                sketch.increment(i % 16);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (uint64_t key = 0; key < 16; ++key) {
+        EXPECT_GT(sketch.estimate(key), 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <util/ObjectPool.h>
+#include <testlib/ContentionBenchmark.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+struct Base {
+    virtual ~Base() {}
+    uint64_t payload[8];
+};
+
+struct Pooled : Base, PooledObject<Pooled> {
+    explicit Pooled(int v) : value(v) {}
+    std::string name;
+    int value;
+};
+
+/* Bigger than Pooled, without a pool of its own */
+struct Unpooled : Pooled {
+    Unpooled() : Pooled(0) {}
+    char extra[100];
+};
+
+struct Message {
+    std::string data;
+};
+
+static const int MaxOutstanding = 1024;
+
+static const ObjectPoolStats& stats() {
+    return ObjectPool<Pooled>::getStats();
+}
+
+TEST(ObjectPool, reuseOnSameThread)
+{
+    uint64_t reuses = stats().reuses.value();
+    Pooled* a = new Pooled(1);
+    delete a;
+    /* Freed block comes right back */
+    Base* b = new Pooled(2);
+    EXPECT_EQ(static_cast<void*>(b), static_cast<void*>(a));
+    EXPECT_EQ(stats().reuses.value(), reuses + 1);
+    /* Deleting through the base still returns it to the pool */
+    uint64_t frees = stats().frees.value();
+    delete b;
+    EXPECT_EQ(stats().frees.value(), frees + 1);
+}
+
+TEST(ObjectPool, derivedFallsThrough)
+{
+    uint64_t allocs = stats().allocs.value();
+    uint64_t frees = stats().frees.value();
+    Pooled* p = new Unpooled();
+    delete p;
+    EXPECT_EQ(stats().allocs.value(), allocs);
+    EXPECT_EQ(stats().frees.value(), frees);
+}
+
+TEST(ObjectPool, crossThreadFrees)
+{
+    /* Producer allocates, consumer frees, like a request handed to a qos thread */
+    const int total = 200000;
+    std::vector<Pooled*> queue;
+    std::mutex lock;
+    std::atomic<int> outstanding(0);
+    uint64_t releases = stats().releases.value();
+
+    std::thread consumer([&]() {
+        int freed = 0;
+        std::vector<Pooled*> batch;
+        while (freed < total) {
+            {
+                std::lock_guard<std::mutex> l(lock);
+                batch.swap(queue);
+            }
+            for (auto p : batch) {
+                EXPECT_EQ(p->value, freed);
+                delete p;
+                freed++;
+            }
+            outstanding -= batch.size();
+            batch.clear();
+        }
+    });
+    for (int i = 0; i < total; ++i) {
+        /* In flight IO is bounded by qos */
+        while (outstanding.load() >= MaxOutstanding) {
+            std::this_thread::yield();
+        }
+        ++outstanding;
+        auto p = new Pooled(i);
+        std::lock_guard<std::mutex> l(lock);
+        queue.push_back(p);
+    }
+    consumer.join();
+
+    /* Memory went around through the depot instead of back to malloc */
+    EXPECT_GT(stats().reuses.value(), total / 2);
+    EXPECT_LE(stats().cached.load(),
+              static_cast<int64_t>(ObjectPool<Pooled>::MAGAZINE_SIZE *
+                                   ObjectPool<Pooled>::MAX_DEPOT_MAGAZINES));
+    EXPECT_LT(stats().releases.value() - releases, static_cast<uint64_t>(total / 10));
+}
+
+TEST(ObjectPool, pooledShared)
+{
+    auto msg = makePooledShared<Message>();
+    msg->data = "hello";
+    msg.reset();
+    auto msg2 = makePooledShared<Message>();
+    EXPECT_TRUE(msg2->data.empty());
+
+    bool found = false;
+    ObjectPoolRegistry::instance().forEach([&found](const ObjectPoolStats& s) {
+        if (s.name.find("Message") != std::string::npos) {
+            found = true;
+            EXPECT_GE(s.reuses.value(), 1);
+        }
+    });
+    EXPECT_TRUE(found);
+}
+
+TEST(ObjectPool, typeName)
+{
+    EXPECT_EQ(ObjectPoolRegistry::typeName(typeid(ObjectPoolStats)), "fds.ObjectPoolStats");
+    EXPECT_EQ(ObjectPoolRegistry::typeName(typeid(std::vector<int>)),
+              "std.vector_int_std.allocator_int");
+}
+
+/**
+ * Allocation benchmark.  Requests are allocated on one thread and freed on
+ * another; compares plain new/delete against the pool.
+ */
+template <class Alloc, class Free>
+double runHandoff(int nPairs, Alloc alloc, Free release)
+{
+    const int perPair = 200000;
+    return TestUtils::runContended(nPairs, perPair, [&]() {
+        std::vector<void*> queue;
+        std::mutex lock;
+        std::atomic<int> outstanding(0);
+        std::thread consumer([&]() {
+            int freed = 0;
+            std::vector<void*> batch;
+            while (freed < perPair) {
+                {
+                    std::lock_guard<std::mutex> l(lock);
+                    batch.swap(queue);
+                }
+                for (auto p : batch) {
+                    release(p);
+                }
+                freed += batch.size();
+                outstanding -= batch.size();
+                batch.clear();
+            }
+        });
+        for (int i = 0; i < perPair; ++i) {
+            while (outstanding.load() >= MaxOutstanding) {
+                std::this_thread::yield();
+            }
+            ++outstanding;
+            void* p = alloc();
+            std::lock_guard<std::mutex> l(lock);
+            queue.push_back(p);
+        }
+        consumer.join();
+    });
+}
+
+struct Plain : Base {
+    std::string name;
+    int value;
+};
+
+TEST(ObjectPool, handoffBenchmark)
+{
+    unsigned maxPairs = std::max(1u, std::thread::hardware_concurrency() / 2);
+    std::cout << "thread pairs,\tnew/delete ops/s,\tpool ops/s" << std::endl;
+    for (unsigned n = 1; n <= maxPairs; n *= 2) {
+        double plainRate = runHandoff(n,
+                                      []() -> void* { return new Plain(); },
+                                      [](void* p) { delete static_cast<Base*>(p); });
+        double poolRate = runHandoff(n,
+                                     []() -> void* { return static_cast<Base*>(new Pooled(0)); },
+                                     [](void* p) { delete static_cast<Base*>(p); });
+        std::cout << n << ",\t" << static_cast<uint64_t>(plainRate)
+                  << ",\t" << static_cast<uint64_t>(poolRate) << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <util/ShmChannel.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static const uint32_t OpPut = 1;
+static const uint32_t PayloadSize = 64 * 1024;
+
+/* Anonymous shared mapping, survives fork() like a named segment would */
+struct Segment {
+    explicit Segment(const ShmChannel::Config& cfg)
+            : size(ShmChannel::segmentSize(cfg)),
+              base(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) {
+    }
+    ~Segment() { munmap(base, size); }
+    size_t size;
+    void* base;
+};
+
+static ShmChannel::Config smallConfig() {
+    ShmChannel::Config cfg;
+    cfg.requestEntries = 60;        /* Rounded up to 64 */
+    cfg.responseEntries = 64;
+    cfg.bufferCount = 100;
+    cfg.bufferSize = PayloadSize;
+    return cfg;
+}
+
+TEST(ShmChannel, attachChecksFormat)
+{
+    Segment seg(smallConfig());
+    ShmChannel client;
+    EXPECT_FALSE(client.attach(seg.base, seg.size));
+
+    ShmChannel server;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 7));
+    ASSERT_TRUE(client.attach(seg.base, seg.size));
+    EXPECT_EQ(client.header()->generation.load(), 7u);
+    EXPECT_EQ(client.requests().capacity(), 64u);
+    EXPECT_EQ(client.buffers().count(), 100u);
+
+    /* Mapping smaller than what the server laid out */
+    ShmChannel truncated;
+    EXPECT_FALSE(truncated.attach(seg.base, seg.size / 2));
+    EXPECT_FALSE(server.format(seg.base, seg.size / 2, smallConfig(), 8));
+}
+
+TEST(ShmChannel, ringFullAndEmpty)
+{
+    Segment seg(smallConfig());
+    ShmChannel server, client;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 1));
+    ASSERT_TRUE(client.attach(seg.base, seg.size));
+
+    ShmRequestDesc req = {};
+    for (uint64_t i = 0; i < 64; ++i) {
+        req.handle = i;
+        ASSERT_TRUE(client.requests().push(req));
+    }
+    EXPECT_FALSE(client.requests().push(req));
+    EXPECT_EQ(server.requests().size(), 64u);
+
+    for (uint64_t i = 0; i < 64; ++i) {
+        ASSERT_TRUE(server.requests().pop(req));
+        EXPECT_EQ(req.handle, i);
+    }
+    EXPECT_FALSE(server.requests().pop(req));
+    EXPECT_EQ(server.requests().front(), nullptr);
+}
+
+TEST(ShmChannel, slabAllocator)
+{
+    Segment seg(smallConfig());
+    ShmChannel server;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 1));
+    ShmSlab& slab = server.buffers();
+
+    std::vector<int32_t> taken;
+    for (int i = 0; i < 100; ++i) {
+        int32_t idx = slab.allocate();
+        ASSERT_GE(idx, 0);
+        ASSERT_LT(idx, 100);
+        taken.push_back(idx);
+    }
+    /* Padding bits of the last bitmap word are never handed out */
+    EXPECT_EQ(slab.allocate(), -1);
+    EXPECT_EQ(slab.inUse(), 100u);
+
+    slab.free(taken[42]);
+    EXPECT_EQ(slab.allocate(), taken[42]);
+    for (auto idx : taken) {
+        slab.free(idx);
+    }
+    EXPECT_EQ(slab.inUse(), 0u);
+}
+
+TEST(ShmChannel, slabConcurrent)
+{
+    Segment seg(smallConfig());
+    ShmChannel server;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 1));
+    ShmSlab& slab = server.buffers();
+
+    /* Each buffer carries the owner's tag while held, catches double hand outs */
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&slab, &failures, t]() {
+            for (int i = 0; i < 100000; ++i) {
+                int32_t idx = slab.allocate();
+                if (idx < 0) {
+                    continue;
+                }
+                char* buf = slab.buffer(idx);
+                buf[0] = t;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (buf[0] != t) {
+                    ++failures;
+                }
+                slab.free(idx);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(slab.inUse(), 0u);
+}
+
+TEST(ShmChannel, args)
+{
+    ShmRequestDesc req = {};
+    std::map<std::string, std::string> meta = {{"Content-Type", "text/plain"}, {"etag", "abc"}};
+    ASSERT_TRUE(ShmArgWriter(req).put("domain").put("volume").put("blob").put(meta).finish());
+
+    std::string domain, volume, blob;
+    std::map<std::string, std::string> meta2;
+    ShmArgReader reader(req);
+    reader.get(domain).get(volume).get(blob).get(meta2);
+    ASSERT_TRUE(reader.ok());
+    EXPECT_EQ(domain, "domain");
+    EXPECT_EQ(volume, "volume");
+    EXPECT_EQ(blob, "blob");
+    EXPECT_EQ(meta2, meta);
+
+    /* Reading past what was written fails instead of returning garbage */
+    std::string extra;
+    EXPECT_FALSE(reader.get(extra).ok());
+
+    /* Too big for the slot; the client sends these over Thrift */
+    std::string longName(ShmRequestDesc::ARGS_SIZE, 'x');
+    EXPECT_FALSE(ShmArgWriter(req).put("domain").put(longName).finish());
+}
+
+/* Server side of the echo: takes each payload and returns it in a new buffer */
+static void echoServer(ShmChannel& chan, uint64_t total) {
+    ShmRequestDesc req;
+    for (uint64_t n = 0; n < total;) {
+        if (!chan.requests().pop(req)) {
+            chan.requests().waitNotEmpty(1000);
+            continue;
+        }
+        ShmResponseDesc resp = {};
+        resp.handle = req.handle;
+        resp.op = req.op;
+        resp.buffer = chan.buffers().allocate();
+        if (resp.buffer < 0) {
+            resp.status = ShmChannel::STATUS_NO_BUFFER;
+        } else {
+            memcpy(chan.buffers().buffer(resp.buffer), chan.buffers().buffer(req.buffer),
+                   req.length);
+            resp.length = req.length;
+        }
+        chan.buffers().free(req.buffer);
+        while (!chan.responses().push(resp)) {
+            std::this_thread::yield();
+        }
+        ++n;
+    }
+}
+
+/**
+ * Client side.  Keeps up to window requests in flight.
+ * @return number of responses that came back intact
+ */
+static uint64_t echoClient(ShmChannel& chan, uint64_t total, uint32_t window) {
+    std::string payload(PayloadSize, 'p');
+    uint64_t sent = 0, received = 0, intact = 0;
+    while (received < total) {
+        while (sent < total && sent - received < window) {
+            ShmRequestDesc* req = chan.requests().reserve();
+            int32_t buf = chan.buffers().allocate();
+            if (req == nullptr || buf < 0) {
+                if (buf >= 0) {
+                    chan.buffers().free(buf);
+                }
+                break;
+            }
+            payload[0] = static_cast<char>(sent);
+            memcpy(chan.buffers().buffer(buf), payload.data(), payload.size());
+            req->handle = sent;
+            req->op = OpPut;
+            req->buffer = buf;
+            req->length = payload.size();
+            chan.requests().commit();
+            ++sent;
+        }
+        ShmResponseDesc resp;
+        if (!chan.responses().pop(resp)) {
+            chan.responses().waitNotEmpty(1000);
+            continue;
+        }
+        if (resp.status == ShmChannel::STATUS_OK && resp.length == PayloadSize &&
+            chan.buffers().buffer(resp.buffer)[0] == static_cast<char>(resp.handle)) {
+            ++intact;
+        }
+        if (resp.buffer >= 0) {
+            chan.buffers().free(resp.buffer);
+        }
+        ++received;
+    }
+    return intact;
+}
+
+TEST(ShmChannel, crossProcessEcho)
+{
+    const uint64_t total = 20000;
+    Segment seg(smallConfig());
+    ShmChannel server;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 1));
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        ShmChannel client;
+        if (!client.attach(seg.base, seg.size)) {
+            _exit(2);
+        }
+        _exit(echoClient(client, total, 32) == total ? 0 : 1);
+    }
+    echoServer(server, total);
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(server.buffers().inUse(), 0u);
+}
+
+/**
+ * Echo benchmark.  Moves 64KB payloads through the channel between two
+ * threads, against writing and reading them back through a unix socket pair,
+ * which is a lower bound for what the loopback Thrift path costs.
+ */
+TEST(ShmChannel, echoBenchmark)
+{
+    const uint64_t total = 50000;
+    Segment seg(smallConfig());
+    ShmChannel server, client;
+    ASSERT_TRUE(server.format(seg.base, seg.size, smallConfig(), 1));
+    ASSERT_TRUE(client.attach(seg.base, seg.size));
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread srv([&server, total]() { echoServer(server, total); });
+    EXPECT_EQ(echoClient(client, total, 32), total);
+    srv.join();
+    std::chrono::duration<double> shmElapsed = std::chrono::steady_clock::now() - start;
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    auto xfer = [](int fd, char* buf, size_t len, bool out) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t rc = out ? write(fd, buf + done, len - done) : read(fd, buf + done, len - done);
+            if (rc <= 0) {
+                return false;
+            }
+            done += rc;
+        }
+        return true;
+    };
+    start = std::chrono::steady_clock::now();
+    std::thread echo([&fds, &xfer, total]() {
+        std::vector<char> buf(PayloadSize);
+        for (uint64_t i = 0; i < total; ++i) {
+            if (!xfer(fds[1], buf.data(), buf.size(), false) ||
+                !xfer(fds[1], buf.data(), buf.size(), true)) {
+                return;
+            }
+        }
+    });
+    std::vector<char> buf(PayloadSize, 'p');
+    for (uint64_t i = 0; i < total; ++i) {
+        ASSERT_TRUE(xfer(fds[0], buf.data(), buf.size(), true));
+        ASSERT_TRUE(xfer(fds[0], buf.data(), buf.size(), false));
+    }
+    echo.join();
+    std::chrono::duration<double> sockElapsed = std::chrono::steady_clock::now() - start;
+    close(fds[0]);
+    close(fds[1]);
+
+    std::cout << "transport,\t64KB round trips/s" << std::endl;
+    std::cout << "socketpair,\t" << static_cast<uint64_t>(total / sockElapsed.count()) << std::endl;
+    std::cout << "shm channel,\t" << static_cast<uint64_t>(total / shmElapsed.count()) << std::endl;
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <util/StageTrace.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using namespace fds;  // NOLINT
+
+static std::vector<StageTraceEvent> drainAll() {
+    std::vector<StageTraceEvent> events;
+    StageTracer::drain(events);
+    return events;
+}
+
+TEST(StageTracer, sampling)
+{
+    StageTracer::setSampleRate(0);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(StageTracer::sample(), 0);
+    }
+
+    StageTracer::setSampleRate(10);
+    std::set<int64_t> ids;
+    for (int i = 0; i < 1000; i++) {
+        auto id = StageTracer::sample();
+        if (id != 0) {
+            EXPECT_GT(id, 0);
+            ids.insert(id);
+        }
+    }
+    EXPECT_EQ(ids.size(), 100u);
+    StageTracer::setSampleRate(0);
+}
+
+TEST(StageTracer, recordAndDrain)
+{
+    drainAll();
+
+    /* Unsampled requests record nothing */
+    StageTracer::record(0, TraceStage::QOS_ENQUEUE);
+    EXPECT_TRUE(drainAll().empty());
+
+    StageTracer::record(42, TraceStage::QOS_ENQUEUE, 7);
+    StageTracer::record(42, TraceStage::QOS_DISPATCH, 7);
+    std::thread t([] { StageTracer::record(43, TraceStage::DISK_IO_START); });
+    t.join();
+
+    auto events = drainAll();
+    ASSERT_EQ(events.size(), 3u);
+    int found42 = 0;
+    for (auto const& ev : events) {
+        if (ev.traceId == 42) {
+            EXPECT_EQ(ev.arg, 7);
+            ++found42;
+        } else {
+            EXPECT_EQ(ev.traceId, 43);
+            EXPECT_EQ(ev.stage, TraceStage::DISK_IO_START);
+        }
+    }
+    EXPECT_EQ(found42, 2);
+    /* Drained events are handed out once */
+    EXPECT_TRUE(drainAll().empty());
+}
+
+TEST(StageTracer, fullRingDrops)
+{
+    drainAll();
+    auto dropped = StageTracer::dropped();
+    for (uint32_t i = 0; i < StageTracer::RING_SIZE + 10; i++) {
+        StageTracer::record(1, TraceStage::HASH_START);
+    }
+    EXPECT_EQ(StageTracer::dropped() - dropped, 10u);
+    EXPECT_EQ(drainAll().size(), StageTracer::RING_SIZE);
+}
+
+TEST(StageTracer, scope)
+{
+    EXPECT_EQ(StageTracer::current(), 0);
+    {
+        StageTracer::Scope outer(5);
+        EXPECT_EQ(StageTracer::current(), 5);
+        {
+            StageTracer::Scope inner(6);
+            EXPECT_EQ(StageTracer::current(), 6);
+        }
+        EXPECT_EQ(StageTracer::current(), 5);
+    }
+    EXPECT_EQ(StageTracer::current(), 0);
+}
+
+/* Cost of recording with tracing off and on */
+TEST(StageTracer, overhead)
+{
+    const int ops = 1000000;
+    auto time = [&](int64_t traceId) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ops; i++) {
+            StageTracer::record(traceId, TraceStage::QOS_ENQUEUE);
+            if ((i % 1024) == 0) {
+                drainAll();
+            }
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count() / ops;
+    };
+    std::cout << "unsampled: " << time(0) << " ns/record "
+              << "sampled: " << time(1) << " ns/record" << std::endl;
+    drainAll();
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleMock(&argc, argv);
+    return RUN_ALL_TESTS();
+}
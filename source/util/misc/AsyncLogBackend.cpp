@@ -0,0 +1,302 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#define BOOST_LOG_DYN_LINK 1
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <util/AsyncLogBackend.h>
+
+namespace fds {
+
+namespace bfs = boost::filesystem;
+
+/*
+ * How long the writer sleeps when there is nothing to write
+ */
+static const std::chrono::milliseconds WRITER_IDLE_WAIT(5);
+
+AsyncLogBackend::AsyncLogBackend(const std::string& fileName,
+                                 const std::string& targetDir,
+                                 uint64_t rotationSize,
+                                 size_t ringSize)
+        : fileName_(fileName),
+          targetDir_(targetDir.empty() ? "." : targetDir),
+          rotationSize_(rotationSize),
+          ringSize_(ringSize),
+          hasSyncFilter_(false),
+          retiredDrops_(0),
+          fd_(-1),
+          curSize_(0),
+          fileCounter_(0),
+          maxDirSize_(0),
+          rotatedSize_(0),
+          stopping_(false) {
+    scanForFiles();
+    writer_ = std::thread(&AsyncLogBackend::run, this);
+}
+
+AsyncLogBackend::~AsyncLogBackend() {
+    stop();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void AsyncLogBackend::set_open_handler(const open_handler_type& handler) {
+    std::lock_guard<std::mutex> l(writeLock_);
+    openHandler_ = handler;
+}
+
+void AsyncLogBackend::set_max_dir_size(uint64_t maxSize) {
+    std::lock_guard<std::mutex> l(writeLock_);
+    maxDirSize_ = maxSize;
+}
+
+void AsyncLogBackend::set_sync_filter(const boost::log::filter& filter) {
+    syncFilter_ = filter;
+    hasSyncFilter_ = true;
+}
+
+AsyncLogBackend::ThreadRing* AsyncLogBackend::threadRing() {
+    RingHolder* holder = ringHolder_.get();
+    if (holder == nullptr) {
+        auto ring = std::make_shared<ThreadRing>(ringSize_);
+        {
+            std::lock_guard<std::mutex> l(ringsLock_);
+            rings_.push_back(ring);
+        }
+        holder = new RingHolder(ring);
+        ringHolder_.reset(holder);
+    }
+    return holder->ring.get();
+}
+
+void AsyncLogBackend::consume(const boost::log::record_view& rec,
+                              const string_type& formatted) {
+    threadRing()->ring.push(formatted.data(), formatted.size());
+    if (hasSyncFilter_ && syncFilter_(rec.attribute_values())) {
+        flush();
+    }
+}
+
+void AsyncLogBackend::flush() {
+    std::lock_guard<std::mutex> l(writeLock_);
+    drainLocked();
+}
+
+void AsyncLogBackend::rotate_file() {
+    std::lock_guard<std::mutex> l(writeLock_);
+    drainLocked();
+    rotateLocked();
+}
+
+void AsyncLogBackend::stop() {
+    {
+        std::lock_guard<std::mutex> l(runLock_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    runCv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    flush();
+}
+
+uint64_t AsyncLogBackend::dropped_records() const {
+    uint64_t dropped = retiredDrops_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> l(ringsLock_);
+    for (const auto &r : rings_) {
+        dropped += r->ring.dropped();
+    }
+    return dropped;
+}
+
+void AsyncLogBackend::run() {
+    std::unique_lock<std::mutex> l(runLock_);
+    while (!stopping_) {
+        l.unlock();
+        size_t written;
+        {
+            std::lock_guard<std::mutex> wl(writeLock_);
+            written = drainLocked();
+        }
+        l.lock();
+        if (written == 0 && !stopping_) {
+            runCv_.wait_for(l, WRITER_IDLE_WAIT);
+        }
+    }
+}
+
+size_t AsyncLogBackend::drainLocked() {
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> l(ringsLock_);
+        rings = rings_;
+    }
+
+    /* Gather as many rings as fit in one writev() */
+    size_t total = 0;
+    struct iovec iov[IOV_MAX];
+    std::vector<std::pair<ThreadRing*, size_t>> batch;
+    int iovcnt = 0;
+    for (auto &r : rings) {
+        if (iovcnt + 2 > IOV_MAX) {
+            writeOut(iov, iovcnt);
+            for (auto &b : batch) {
+                b.first->ring.consume(b.second);
+            }
+            batch.clear();
+            iovcnt = 0;
+        }
+        int cnt;
+        size_t bytes = r->ring.peek(&iov[iovcnt], cnt);
+        if (bytes == 0) {
+            continue;
+        }
+        iovcnt += cnt;
+        batch.emplace_back(r.get(), bytes);
+        total += bytes;
+    }
+    if (iovcnt > 0) {
+        writeOut(iov, iovcnt);
+        for (auto &b : batch) {
+            b.first->ring.consume(b.second);
+        }
+    }
+
+    /* Let go of rings whose thread is gone and that have nothing left */
+    {
+        std::lock_guard<std::mutex> l(ringsLock_);
+        for (auto itr = rings_.begin(); itr != rings_.end();) {
+            if ((*itr)->orphaned && (*itr)->ring.empty()) {
+                retiredDrops_ += (*itr)->ring.dropped();
+                itr = rings_.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+    }
+
+    if (rotationSize_ > 0 && curSize_ >= rotationSize_) {
+        rotateLocked();
+    }
+    return total;
+}
+
+void AsyncLogBackend::writeOut(struct iovec* iov, int iovcnt) {
+    if (fd_ < 0) {
+        openFileLocked();
+        if (fd_ < 0) {
+            /* Nowhere to write, records are lost just like with a full ring */
+            return;
+        }
+    }
+    while (iovcnt > 0) {
+        ssize_t ret = writev(fd_, iov, iovcnt);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        curSize_ += ret;
+        /* Skip what went out on a short write */
+        size_t done = ret;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+}
+
+void AsyncLogBackend::openFileLocked() {
+    std::ostringstream name;
+    name << fileName_ << "_" << fileCounter_++ << ".log";
+    curPath_ = name.str();
+    curSize_ = 0;
+    fd_ = open(curPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0 || !openHandler_) {
+        return;
+    }
+    std::ostringstream header;
+    openHandler_(header);
+    std::string str = header.str();
+    struct iovec iov = { const_cast<char*>(str.data()), str.size() };
+    writeOut(&iov, 1);
+}
+
+void AsyncLogBackend::rotateLocked() {
+    if (fd_ < 0) {
+        return;
+    }
+    close(fd_);
+    fd_ = -1;
+
+    /* Same as text_file_backend's collector: rotated files live in targetDir_ */
+    boost::system::error_code ec;
+    bfs::path src(curPath_);
+    bfs::path dst = bfs::path(targetDir_) / src.filename();
+    if (!bfs::equivalent(src.parent_path().empty() ? bfs::path(".") : src.parent_path(),
+                         bfs::path(targetDir_), ec) || ec) {
+        bfs::rename(src, dst, ec);
+        if (ec) {
+            dst = src;
+        }
+    }
+    rotatedFiles_.emplace_back(dst.string(), curSize_);
+    rotatedSize_ += curSize_;
+    curSize_ = 0;
+
+    while (maxDirSize_ > 0 && rotatedSize_ > maxDirSize_ && !rotatedFiles_.empty()) {
+        bfs::remove(rotatedFiles_.front().first, ec);
+        rotatedSize_ -= rotatedFiles_.front().second;
+        rotatedFiles_.pop_front();
+    }
+}
+
+void AsyncLogBackend::scanForFiles() {
+    /* Pick up numbering where the last run left off */
+    std::string prefix = bfs::path(fileName_).filename().string() + "_";
+    std::map<uint32_t, std::pair<std::string, uint64_t>> found;
+    boost::system::error_code ec;
+    for (bfs::directory_iterator itr(targetDir_, ec), end; !ec && itr != end; itr.increment(ec)) {
+        std::string name = itr->path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0 ||
+            itr->path().extension() != ".log") {
+            continue;
+        }
+        std::string num = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+        if (num.empty() || num.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        uint32_t n = strtoul(num.c_str(), nullptr, 10);
+        boost::system::error_code sizeEc;
+        uint64_t size = bfs::file_size(itr->path(), sizeEc);
+        found[n] = std::make_pair(itr->path().string(), sizeEc ? 0 : size);
+        fileCounter_ = std::max(fileCounter_, n + 1);
+    }
+    for (auto &kv : found) {
+        rotatedFiles_.push_back(kv.second);
+        rotatedSize_ += kv.second.second;
+    }
+}
+
+}  // namespace fds
@@ -3,6 +3,10 @@
  */
 #define BOOST_LOG_DYN_LINK 1
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <boost/log/expressions.hpp>
 #include <boost/log/utility/exception_handler.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -59,17 +63,35 @@ __TRACER__::~__TRACER__() {
  * Adds and modifies attributes for the logger stream - helps logger see function, file, and line number as a
  * part of the attributes
  */
-std::string set_get_attrib(const char* name, std::string value, const char * function_name) {
-    value.append(function_name);
-    value.append("] - ");
-    auto attr = boost::log::attribute_cast<boost::log::attributes::mutable_constant<std::string>>(boost::log::core::get()->get_thread_attributes()[name]);
-    if (attr) {
-        attr.set(value);
-        return attr.get();
-    } else {
-        boost::log::core::get()->add_thread_attribute("Location",
-                                                      boost::log::attributes::mutable_constant<std::string>(value));
+const char* set_get_attrib(const char* name, const char* value, const char * function_name) {
+    typedef boost::log::attributes::mutable_constant<std::string> location_attr;
+    /*
+     * Looked up once per thread and name, get_thread_attributes() copies the
+     * whole set.  There are only a handful of names so a list is enough.
+     */
+    static thread_local std::vector<std::pair<std::string, location_attr>> cache;
+    location_attr *attr = nullptr;
+    for (auto &entry : cache) {
+        if (entry.first == name) {
+            attr = &entry.second;
+            break;
+        }
     }
+    if (!attr) {
+        auto attrs = boost::log::core::get()->get_thread_attributes();
+        auto existing = boost::log::attribute_cast<location_attr>(attrs[name]);
+        if (existing) {
+            cache.emplace_back(name, existing);
+        } else {
+            cache.emplace_back(name, location_attr(std::string()));
+            boost::log::core::get()->add_thread_attribute(name, cache.back().second);
+        }
+        attr = &cache.back().second;
+    }
+    std::string loc(value);
+    loc.append(function_name);
+    loc.append("] - ");
+    attr->set(std::move(loc));
     return value;
 }
 
@@ -146,54 +168,19 @@ void fds_log::init(const std::string& logfile,
                    bool Pname,
                    bool Pid,
                    bool Tid,
-                   bool Record) {
-    /*
-     * Create the with file name and rotation.
-     */
-    sink = boost::make_shared< file_sink >(boost::log::keywords::file_name = logfile + "_%N.log",
-                                           boost::log::keywords::rotation_size = ROTATION_SIZE);
-
-    /*
-     * Setup log sub-directory location
-     */
-#ifdef DEBUG
-    /*
-     * NOTE: From local testing MAX_DIR_SIZE and the collector will ONLY affect the matching fdslog files
-     * i.e. SM collector will only affect SM logs and DM collector will only affect DM logs. I am enclosing this
-     * in DEBUG for the time being to make sure that this does not
-     */
-    if (logloc.empty()) {
-        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
-            boost::log::keywords::target = ".", boost::log::keywords::max_size = MAX_DIR_SIZE));
-    } else {
-        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
-            boost::log::keywords::target = logloc, boost::log::keywords::max_size = MAX_DIR_SIZE));
-    }
-#else
-    if (logloc.empty()) {
-        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
-            boost::log::keywords::target = "."));
+                   bool Record,
+                   bool async) {
+    if (async) {
+        initAsync(logfile, logloc);
     } else {
-        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
-            boost::log::keywords::target = logloc));
+        initSync(logfile, logloc);
     }
-#endif
-
-    /*
-     * Set to defaulty scan for existing log files and
-     * pickup where it left previously off.
-     */
-    sink->locked_backend()->scan_for_files();
-
-#ifdef DEBUG
-    sink->locked_backend()->auto_flush(true);
-#endif
 
     /*
      * Set the filter to not print messages below
      * a certain level.
      */
-    sink->set_filter(
+    frontend->set_filter(
         boost::log::expressions::attr<severity_level>("Severity").or_default(normal) >= level);
     severityLevel = level;
 
@@ -216,7 +203,7 @@ void fds_log::init(const std::string& logfile,
     /*
      * Set the format
      */
-    sink->set_formatter(boost::log::expressions::stream
+    boost::log::formatter formatter = (boost::log::expressions::stream
                         << "["
                         << boost::log::expressions::format_date_time< boost::posix_time::ptime >("TimeStamp", "%d.%m.%Y %H:%M:%S.%f")
                         << "] [" << boost::log::expressions::attr< severity_level >("Severity")
@@ -230,11 +217,11 @@ void fds_log::init(const std::string& logfile,
                                                                 boost::log::keywords::iteration = boost::log::expressions::reverse)
                         << " "
                         << boost::log::expressions::smessage);
-
-    /*
-     * Set the log header.
-     */
-    sink->locked_backend()->set_open_handler(&writeHeader);
+    if (asyncSink) {
+        asyncSink->set_formatter(formatter);
+    } else {
+        sink->set_formatter(formatter);
+    }
 
     /*
      * If we are a DEBUG build we want a core dump if we get an exception,
@@ -249,12 +236,81 @@ void fds_log::init(const std::string& logfile,
     /*
      * Add the sink to the core.
      */
-    boost::log::core::get()->add_sink(sink);
+    boost::log::core::get()->add_sink(frontend);
+}
+
+void fds_log::initSync(const std::string& logfile, const std::string& logloc) {
+    /*
+     * Create the with file name and rotation.
+     */
+    sink = boost::make_shared< file_sink >(boost::log::keywords::file_name = logfile + "_%N.log",
+                                           boost::log::keywords::rotation_size = ROTATION_SIZE);
+    frontend = sink;
+
+    /*
+     * Setup log sub-directory location
+     */
+#ifdef DEBUG
+    /*
+     * NOTE: From local testing MAX_DIR_SIZE and the collector will ONLY affect the matching fdslog files
+     * i.e. SM collector will only affect SM logs and DM collector will only affect DM logs. I am enclosing this
+     * in DEBUG for the time being to make sure that this does not
+     */
+    if (logloc.empty()) {
+        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
+            boost::log::keywords::target = ".", boost::log::keywords::max_size = MAX_DIR_SIZE));
+    } else {
+        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
+            boost::log::keywords::target = logloc, boost::log::keywords::max_size = MAX_DIR_SIZE));
+    }
+#else
+    if (logloc.empty()) {
+        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
+            boost::log::keywords::target = "."));
+    } else {
+        sink->locked_backend()->set_file_collector(boost::log::sinks::file::make_collector(
+            boost::log::keywords::target = logloc));
+    }
+#endif
+
+    /*
+     * Set to defaulty scan for existing log files and
+     * pickup where it left previously off.
+     */
+    sink->locked_backend()->scan_for_files();
+
+#ifdef DEBUG
+    sink->locked_backend()->auto_flush(true);
+#endif
+
+    /*
+     * Set the log header.
+     */
+    sink->locked_backend()->set_open_handler(&writeHeader);
+}
+
+void fds_log::initAsync(const std::string& logfile, const std::string& logloc) {
+    /*
+     * Same file naming, rotation and header as the synchronous sink, only the
+     * file IO moves to the backend's writer thread.
+     */
+    auto backend = boost::make_shared<AsyncLogBackend>(logfile, logloc, ROTATION_SIZE);
+    backend->set_open_handler(&writeHeader);
+#ifdef DEBUG
+    backend->set_max_dir_size(MAX_DIR_SIZE);
+#endif
+    /* Don't lose what explains a crash */
+    backend->set_sync_filter(
+        boost::log::expressions::attr<severity_level>("Severity").or_default(normal) >= error);
+
+    asyncSink = boost::make_shared< async_sink >(backend);
+    frontend = asyncSink;
 }
 
 fds_log::fds_log(const std::string& logfile,
                  const std::string& logloc,
-                 severity_level level) {
+                 severity_level level,
+                 bool async) {
     init(logfile,
          logloc,
          true,   // timestamp
@@ -263,21 +319,38 @@ fds_log::fds_log(const std::string& logfile,
          false,  // process name
          false,  // process id
          true,   // thread id
-         false); // record id
+         false,  // record id
+         async);
 }
 
 fds_log::~fds_log() {
+    if (asyncSink) {
+        /* Nothing would drain records fed after this */
+        boost::log::core::get()->remove_sink(frontend);
+        asyncSink->locked_backend()->stop();
+    }
 }
 
 void fds_log::setSeverityFilter(const severity_level &level) {
-    sink->reset_filter();
-    sink->set_filter(
+    frontend->reset_filter();
+    frontend->set_filter(
         boost::log::expressions::attr<severity_level>("Severity").or_default(normal) >= level);
     severityLevel= level;
 }
 
 void fds_log::rotate() {
-    sink->locked_backend()->rotate_file();
+    if (asyncSink) {
+        asyncSink->locked_backend()->rotate_file();
+    } else {
+        sink->locked_backend()->rotate_file();
+    }
+}
+
+uint64_t fds_log::droppedRecords() const {
+    if (asyncSink) {
+        return asyncSink->locked_backend()->dropped_records();
+    }
+    return 0;
 }
 
 }  // namespace fds
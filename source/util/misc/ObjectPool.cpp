@@ -0,0 +1,55 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+#include <cxxabi.h>
+#include <cctype>
+#include <cstdlib>
+
+#include <util/ObjectPool.h>
+
+namespace fds {
+
+ObjectPoolRegistry& ObjectPoolRegistry::instance() {
+    /* Pools may register from static initializers and outlive main() */
+    static ObjectPoolRegistry* registry = new ObjectPoolRegistry();
+    return *registry;
+}
+
+void ObjectPoolRegistry::add(ObjectPoolStats* stats) {
+    std::lock_guard<std::mutex> l(lock_);
+    pools_.push_back(stats);
+}
+
+void ObjectPoolRegistry::forEach(const std::function<void (const ObjectPoolStats&)>& f) const {
+    std::lock_guard<std::mutex> l(lock_);
+    for (auto stats : pools_) {
+        f(*stats);
+    }
+}
+
+std::string ObjectPoolRegistry::typeName(const std::type_info& type) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    std::string raw = (status == 0 && demangled) ? demangled : type.name();
+    free(demangled);
+
+    /* Counter ids are dot separated, keep them free of "::", "<>" and spaces */
+    std::string name;
+    for (auto c : raw) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            name += c;
+        } else if (c == ':') {
+            if (!name.empty() && name.back() != '.') {
+                name += '.';
+            }
+        } else if (!name.empty() && name.back() != '_' && name.back() != '.') {
+            name += '_';
+        }
+    }
+    while (!name.empty() && (name.back() == '_' || name.back() == '.')) {
+        name.pop_back();
+    }
+    return name;
+}
+
+}  // namespace fds
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <util/ShmChannel.h>
+
+namespace fds {
+
+namespace {
+
+size_t alignUp(size_t v, size_t align) {
+    return (v + align - 1) & ~(align - 1);
+}
+
+uint32_t roundUpPow2(uint32_t v) {
+    uint32_t p = 2;
+    while (p < v) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/* Offsets of the areas within a segment */
+struct Layout {
+    size_t requestRing;
+    size_t requestSlots;
+    size_t responseRing;
+    size_t responseSlots;
+    size_t slab;
+    size_t slabData;
+    size_t total;
+
+    explicit Layout(const ShmChannel::Config& cfg) {
+        const size_t page = 4096;
+        size_t pos = alignUp(sizeof(ShmChannel::Header), SHM_CHANNEL_CACHELINE);
+        requestRing = pos;
+        pos = alignUp(pos + sizeof(ShmChannel::RequestRing::Header), SHM_CHANNEL_CACHELINE);
+        requestSlots = pos;
+        pos += roundUpPow2(cfg.requestEntries) * sizeof(ShmRequestDesc);
+        responseRing = pos;
+        pos = alignUp(pos + sizeof(ShmChannel::ResponseRing::Header), SHM_CHANNEL_CACHELINE);
+        responseSlots = pos;
+        pos += roundUpPow2(cfg.responseEntries) * sizeof(ShmResponseDesc);
+        slab = pos;
+        pos = alignUp(pos + ShmSlab::headerSize(cfg.bufferCount), page);
+        slabData = pos;
+        pos += static_cast<size_t>(cfg.bufferCount) * cfg.bufferSize;
+        total = alignUp(pos, page);
+    }
+};
+
+}  // namespace
+
+void
+ShmDoorbell::ring() {
+    seq.fetch_add(1, std::memory_order_release);
+    if (sleepers.load(std::memory_order_seq_cst) != 0) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAKE, INT32_MAX,
+                nullptr, nullptr, 0);
+    }
+}
+
+void
+ShmDoorbell::wait(uint32_t expected, uint32_t timeoutUs) {
+    struct timespec ts;
+    ts.tv_sec = timeoutUs / 1000000;
+    ts.tv_nsec = (timeoutUs % 1000000) * 1000;
+    /* Not FUTEX_PRIVATE_FLAG, the other side is another process */
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT, expected,
+            &ts, nullptr, 0);
+}
+
+void
+ShmSlab::format(Header* hdr, uint32_t count, uint32_t bufferSize) {
+    hdr->count = count;
+    hdr->bufferSize = bufferSize;
+    hdr->hint.store(0, std::memory_order_relaxed);
+    ShmSlab slab(hdr, nullptr);
+    uint32_t words = bitmapWords(count);
+    for (uint32_t w = 0; w < words; ++w) {
+        /* Bits past count are permanently taken */
+        uint64_t used = 0;
+        uint32_t first = w * 64;
+        if (first + 64 > count) {
+            used = ~0ULL << (count - first);
+        }
+        slab.bitmap()[w].store(used, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+int32_t
+ShmSlab::allocate() {
+    uint32_t words = bitmapWords(hdr_->count);
+    /* Start where the last allocation left off to spread out the contention */
+    uint32_t start = hdr_->hint.load(std::memory_order_relaxed) % words;
+    for (uint32_t i = 0; i < words; ++i) {
+        uint32_t w = (start + i) % words;
+        std::atomic<uint64_t>& word = bitmap()[w];
+        uint64_t cur = word.load(std::memory_order_relaxed);
+        while (cur != ~0ULL) {
+            uint32_t bit = __builtin_ctzll(~cur);
+            if (word.compare_exchange_weak(cur, cur | (1ULL << bit),
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                hdr_->hint.store(w, std::memory_order_relaxed);
+                return w * 64 + bit;
+            }
+        }
+    }
+    return -1;
+}
+
+void
+ShmSlab::free(int32_t index) {
+    bitmap()[index / 64].fetch_and(~(1ULL << (index % 64)), std::memory_order_release);
+}
+
+uint32_t
+ShmSlab::inUse() const {
+    uint32_t words = bitmapWords(hdr_->count);
+    uint32_t used = 0;
+    for (uint32_t w = 0; w < words; ++w) {
+        used += __builtin_popcountll(bitmap()[w].load(std::memory_order_relaxed));
+    }
+    /* Minus the padding bits of the last word */
+    return used - (words * 64 - hdr_->count);
+}
+
+ShmArgWriter&
+ShmArgWriter::put(const std::string& s) {
+    if (!ok_ || s.size() > UINT16_MAX ||
+        pos_ + sizeof(uint16_t) + s.size() > ShmRequestDesc::ARGS_SIZE) {
+        ok_ = false;
+        return *this;
+    }
+    uint16_t len = s.size();
+    memcpy(&desc_.args[pos_], &len, sizeof(len));
+    memcpy(&desc_.args[pos_ + sizeof(len)], s.data(), len);
+    pos_ += sizeof(len) + len;
+    return *this;
+}
+
+ShmArgWriter&
+ShmArgWriter::put(const std::map<std::string, std::string>& m) {
+    /* Entry count, then key and value of each entry */
+    uint16_t n = m.size();
+    if (!ok_ || m.size() > UINT16_MAX || pos_ + sizeof(n) > ShmRequestDesc::ARGS_SIZE) {
+        ok_ = false;
+        return *this;
+    }
+    memcpy(&desc_.args[pos_], &n, sizeof(n));
+    pos_ += sizeof(n);
+    for (auto const& kv : m) {
+        put(kv.first).put(kv.second);
+    }
+    return *this;
+}
+
+ShmArgReader&
+ShmArgReader::get(std::string& s) {
+    uint16_t len;
+    if (!ok_ || pos_ + sizeof(len) > desc_.argLen) {
+        ok_ = false;
+        return *this;
+    }
+    memcpy(&len, &desc_.args[pos_], sizeof(len));
+    if (pos_ + sizeof(len) + len > desc_.argLen) {
+        ok_ = false;
+        return *this;
+    }
+    s.assign(&desc_.args[pos_ + sizeof(len)], len);
+    pos_ += sizeof(len) + len;
+    return *this;
+}
+
+ShmArgReader&
+ShmArgReader::get(std::map<std::string, std::string>& m) {
+    uint16_t n;
+    if (!ok_ || pos_ + sizeof(n) > desc_.argLen) {
+        ok_ = false;
+        return *this;
+    }
+    memcpy(&n, &desc_.args[pos_], sizeof(n));
+    pos_ += sizeof(n);
+    for (uint16_t i = 0; i < n && ok_; ++i) {
+        std::string key, value;
+        get(key).get(value);
+        m[key] = value;
+    }
+    return *this;
+}
+
+size_t
+ShmChannel::segmentSize(const Config& cfg) {
+    return Layout(cfg).total;
+}
+
+bool
+ShmChannel::format(void* base, size_t size, const Config& cfg, uint64_t generation) {
+    Layout layout(cfg);
+    if (base == nullptr || size < layout.total || cfg.bufferCount == 0) {
+        return false;
+    }
+    char* seg = static_cast<char*>(base);
+    hdr_ = reinterpret_cast<Header*>(seg);
+    /* Invalidate first so a client can't attach to a half written segment */
+    hdr_->magic = 0;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    hdr_->version = VERSION;
+    hdr_->headerSize = sizeof(Header);
+    hdr_->segmentSize = layout.total;
+    hdr_->requestRingOffset = layout.requestRing;
+    hdr_->requestSlotsOffset = layout.requestSlots;
+    hdr_->responseRingOffset = layout.responseRing;
+    hdr_->responseSlotsOffset = layout.responseSlots;
+    hdr_->slabOffset = layout.slab;
+    hdr_->slabDataOffset = layout.slabData;
+    hdr_->generation.store(generation, std::memory_order_relaxed);
+
+    RequestRing::format(reinterpret_cast<RequestRing::Header*>(seg + layout.requestRing),
+                        roundUpPow2(cfg.requestEntries));
+    ResponseRing::format(reinterpret_cast<ResponseRing::Header*>(seg + layout.responseRing),
+                         roundUpPow2(cfg.responseEntries));
+    ShmSlab::format(reinterpret_cast<ShmSlab::Header*>(seg + layout.slab),
+                    cfg.bufferCount, cfg.bufferSize);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    hdr_->magic = MAGIC;
+    bind();
+    return true;
+}
+
+bool
+ShmChannel::attach(void* base, size_t size) {
+    if (base == nullptr || size < sizeof(Header)) {
+        return false;
+    }
+    Header* hdr = static_cast<Header*>(base);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (hdr->magic != MAGIC || hdr->version != VERSION ||
+        hdr->headerSize != sizeof(Header) || hdr->segmentSize > size) {
+        return false;
+    }
+    hdr_ = hdr;
+    bind();
+    return true;
+}
+
+void
+ShmChannel::bind() {
+    char* seg = reinterpret_cast<char*>(hdr_);
+    requests_ = RequestRing(reinterpret_cast<RequestRing::Header*>(seg + hdr_->requestRingOffset),
+                            reinterpret_cast<ShmRequestDesc*>(seg + hdr_->requestSlotsOffset));
+    responses_ = ResponseRing(
+        reinterpret_cast<ResponseRing::Header*>(seg + hdr_->responseRingOffset),
+        reinterpret_cast<ShmResponseDesc*>(seg + hdr_->responseSlotsOffset));
+    slab_ = ShmSlab(reinterpret_cast<ShmSlab::Header*>(seg + hdr_->slabOffset),
+                    seg + hdr_->slabDataOffset);
+}
+
+}  // namespace fds
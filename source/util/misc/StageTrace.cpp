@@ -0,0 +1,164 @@
+/*
+ * Copyright 2016 Formation Data Systems, Inc.
+ */
+
+#include <time.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <random>
+
+#include <util/StageTrace.h>
+
+namespace fds {
+
+namespace {
+
+/**
+ * Single producer (the owning thread), single consumer (drain() under the
+ * registry lock) ring of events
+ */
+struct StageTraceRing {
+    static const uint64_t MASK = StageTracer::RING_SIZE - 1;
+
+    std::array<StageTraceEvent, StageTracer::RING_SIZE> events;
+    std::atomic<uint64_t>   head {0};
+    std::atomic<uint64_t>   tail {0};
+    /* Owning thread exited, drop the ring once drained */
+    std::atomic<bool>       orphaned {false};
+};
+using StageTraceRingPtr = std::shared_ptr<StageTraceRing>;
+
+struct StageTraceRegistry {
+    std::mutex                      lock;
+    std::vector<StageTraceRingPtr>  rings;
+    std::atomic<uint64_t>           dropped {0};
+    std::atomic<uint64_t>           nextId;
+
+    StageTraceRegistry() {
+        /* Ids from different processes must not collide */
+        std::random_device rd;
+        nextId = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    static StageTraceRegistry& instance() {
+        static StageTraceRegistry registry;
+        return registry;
+    }
+};
+
+struct ThreadRing {
+    StageTraceRingPtr ring;
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->orphaned.store(true, std::memory_order_release);
+        }
+    }
+
+    StageTraceRing* get() {
+        if (!ring) {
+            ring = std::make_shared<StageTraceRing>();
+            auto& registry = StageTraceRegistry::instance();
+            std::lock_guard<std::mutex> g(registry.lock);
+            registry.rings.push_back(ring);
+        }
+        return ring.get();
+    }
+};
+thread_local ThreadRing threadRing;
+
+const char* const stageNames[] = {
+    "svc.send",
+    "svc.resp_recv",
+    "handler.start",
+    "handler.end",
+    "resp.send",
+    "qos.enqueue",
+    "qos.dispatch",
+    "qos.done",
+    "diskio.start",
+    "diskio.end",
+    "hash.start",
+    "hash.end",
+};
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) ==
+              static_cast<size_t>(TraceStage::MAX_STAGE), "stage name per stage");
+
+}  // namespace
+
+const uint32_t StageTracer::RING_SIZE;
+std::atomic<uint32_t> StageTracer::sampleRate_ {0};
+thread_local uint32_t StageTracer::sampleCount_ = 0;
+thread_local int64_t StageTracer::current_ = 0;
+
+void
+StageTracer::setSampleRate(uint32_t oneIn) {
+    sampleRate_.store(oneIn, std::memory_order_relaxed);
+}
+
+int64_t
+StageTracer::newTraceId() {
+    int64_t id;
+    do {
+        id = static_cast<int64_t>(StageTraceRegistry::instance().nextId.fetch_add(
+                1, std::memory_order_relaxed) & INT64_MAX);
+    } while (id == 0);
+    return id;
+}
+
+void
+StageTracer::recordSampled(int64_t traceId, TraceStage stage, int32_t arg) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    auto ring = threadRing.get();
+    auto head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+        StageTraceRegistry::instance().dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& ev = ring->events[head & StageTraceRing::MASK];
+    ev.traceId = traceId;
+    ev.tsNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    ev.arg = arg;
+    ev.stage = stage;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void
+StageTracer::drain(std::vector<StageTraceEvent>& out) {
+    auto& registry = StageTraceRegistry::instance();
+    std::lock_guard<std::mutex> g(registry.lock);
+    for (auto itr = registry.rings.begin(); itr != registry.rings.end();) {
+        auto& ring = **itr;
+        /* Read orphaned before head so no event recorded before exit is missed */
+        bool orphaned = ring.orphaned.load(std::memory_order_acquire);
+        auto head = ring.head.load(std::memory_order_acquire);
+        for (auto tail = ring.tail.load(std::memory_order_relaxed); tail != head; ++tail) {
+            out.push_back(ring.events[tail & StageTraceRing::MASK]);
+        }
+        ring.tail.store(head, std::memory_order_release);
+        if (orphaned) {
+            itr = registry.rings.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+}
+
+uint64_t
+StageTracer::dropped() {
+    return StageTraceRegistry::instance().dropped.load(std::memory_order_relaxed);
+}
+
+const char*
+StageTracer::stageName(TraceStage stage) {
+    if (stage >= TraceStage::MAX_STAGE) {
+        return "unknown";
+    }
+    return stageNames[static_cast<size_t>(stage)];
+}
+
+}  // namespace fds
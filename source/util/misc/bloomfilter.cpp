@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <hash/MurmurHash2.h>
 #include <util/bloomfilter.h>
 namespace fds { namespace util {
@@ -93,5 +94,54 @@ uint32_t BloomFilter::getEstimatedSize() const {
     bytes += bits->size() + 10*4 ;
     return bytes;
 }
+
+CountingBloomFilter::CountingBloomFilter(uint32_t totalBits, uint8_t bitsPerKey)
+        : shape(1, bitsPerKey),
+          counters((totalBits + 1) / 2, 0) {
+    /* shape is only used for generating positions.  Don't allocate its bits */
+    shape.totalBits = totalBits;
+}
+
+void CountingBloomFilter::add(const ObjectID& objID) {
+    auto positions = shape.generatePositions(objID.GetId(), objID.getDigestLength());
+    for (uint i = 0 ; i < shape.bitsPerKey ; i++) {
+        auto count = getCount(positions[i]);
+        if (count < MAX_COUNT) {
+            setCount(positions[i], count + 1);
+        }
+    }
+}
+
+void CountingBloomFilter::remove(const ObjectID& objID) {
+    auto positions = shape.generatePositions(objID.GetId(), objID.getDigestLength());
+    for (uint i = 0 ; i < shape.bitsPerKey ; i++) {
+        auto count = getCount(positions[i]);
+        if (count > 0 && count < MAX_COUNT) {
+            setCount(positions[i], count - 1);
+        }
+    }
+}
+
+bool CountingBloomFilter::lookup(const ObjectID& objID) const {
+    auto positions = shape.generatePositions(objID.GetId(), objID.getDigestLength());
+    for (uint i = 0 ; i < shape.bitsPerKey ; i++) {
+        if (getCount(positions[i]) == 0) return false;
+    }
+    return true;
+}
+
+BloomFilterPtr CountingBloomFilter::toBloomFilter() const {
+    BloomFilterPtr bloomfilter(new BloomFilter(shape.totalBits, shape.bitsPerKey));
+    for (uint32_t pos = 0; pos < shape.totalBits; pos++) {
+        if (getCount(pos)) {
+            bloomfilter->bits->set(pos, true);
+        }
+    }
+    return bloomfilter;
+}
+
+void CountingBloomFilter::clear() {
+    std::fill(counters.begin(), counters.end(), 0);
+}
 }  // namespace util
 }  // namespace fds